@@ -0,0 +1,114 @@
+//
+// Compares image decoder backends by loading glTF models repeatedly.
+//
+// Usage: image_bench [-n iterations] model.gltf [model2.glb ...]
+//
+// Backends are compiled in with TINYGLTF_ENABLE_LIBJPEG_TURBO and/or
+// TINYGLTF_ENABLE_SPNG. stb_image is always measured as the baseline.
+//
+
+// Define these only in *one* .cc file.
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "tiny_gltf.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct Backend {
+  std::string name;
+  std::string mime_type;  // empty = stb_image only
+  tinygltf::ImageDecodeFunction decode;
+};
+
+static bool EndsWith(const std::string &s, const std::string &suffix) {
+  return (s.size() >= suffix.size()) &&
+         (s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+static bool LoadModel(tinygltf::TinyGLTF &ctx, const std::string &filename,
+                      tinygltf::Model *model) {
+  std::string err;
+  std::string warn;
+  bool ret = false;
+  if (EndsWith(filename, ".glb")) {
+    ret = ctx.LoadBinaryFromFile(model, &err, &warn, filename);
+  } else {
+    ret = ctx.LoadASCIIFromFile(model, &err, &warn, filename);
+  }
+  if (!warn.empty()) {
+    printf("Warn: %s\n", warn.c_str());
+  }
+  if (!err.empty()) {
+    printf("Err: %s\n", err.c_str());
+  }
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 10;
+  std::vector<std::string> filenames;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "-n") && (i + 1 < argc)) {
+      iterations = atoi(argv[++i]);
+    } else {
+      filenames.push_back(arg);
+    }
+  }
+  if (filenames.empty()) {
+    filenames.push_back("../../models/Cube/Cube.gltf");
+  }
+  if (iterations < 1) {
+    iterations = 1;
+  }
+
+  std::vector<Backend> backends;
+  backends.push_back(Backend{"stb_image", "", nullptr});
+#ifdef TINYGLTF_ENABLE_LIBJPEG_TURBO
+  backends.push_back(Backend{"libjpeg-turbo", "image/jpeg",
+                             tinygltf::DecodeImageLibjpegTurbo});
+#endif
+#ifdef TINYGLTF_ENABLE_SPNG
+  backends.push_back(
+      Backend{"spng", "image/png", tinygltf::DecodeImageSpng});
+#endif
+
+  for (const std::string &filename : filenames) {
+    printf("%s\n", filename.c_str());
+    for (const Backend &backend : backends) {
+      tinygltf::TinyGLTF ctx;
+      if (!backend.mime_type.empty()) {
+        ctx.SetImageDecoder(backend.mime_type, backend.decode, nullptr);
+      }
+
+      size_t num_images = 0;
+      size_t pixel_bytes = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (int n = 0; n < iterations; n++) {
+        tinygltf::Model model;
+        if (!LoadModel(ctx, filename, &model)) {
+          return EXIT_FAILURE;
+        }
+        num_images = model.images.size();
+        pixel_bytes = 0;
+        for (const tinygltf::Image &image : model.images) {
+          pixel_bytes += image.image.size();
+        }
+      }
+      auto end = std::chrono::steady_clock::now();
+      double ms =
+          std::chrono::duration<double, std::milli>(end - start).count() /
+          double(iterations);
+
+      printf("  %-16s %10.3f ms/load  %zu images  %zu pixel bytes\n",
+             backend.name.c_str(), ms, num_images, pixel_bytes);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
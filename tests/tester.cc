@@ -1,4 +1,6 @@
 #define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_ENABLE_MESHOPT
+#define TINYGLTF_ENABLE_THREADS
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "tiny_gltf.h"
@@ -15,6 +17,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <set>
 
 static tinygltf::detail::JsonDocument JsonConstruct(const char* str)
 {
@@ -1247,3 +1250,2943 @@ TEST_CASE("empty-images-not-written", "[issue-495]") {
   // WriteImageData should be invoked for both images
   CHECK(counter == 2);
 }
+
+TEST_CASE("image-max-dimension", "[image]") {
+  std::string err;
+  std::string warn;
+  tinygltf::Model model;
+  tinygltf::TinyGLTF ctx;
+  ctx.SetMaxImageDimension(100);
+  ctx.SetImageTargetComponents(3);
+  bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+  REQUIRE(ok);
+  REQUIRE(err.empty());
+
+  REQUIRE(model.images.size() == 2);
+  for (const auto& image : model.images) {
+    // 512 / ceil(512 / 100)
+    CHECK(image.width == 86);
+    CHECK(image.height == 86);
+    CHECK(image.component == 3);
+    CHECK(image.image.size() == size_t(86 * 86 * 3));
+  }
+
+#ifndef TINYGLTF_NO_STB_IMAGE
+  // 3x3 grey image, downscaled to 2x2 with partial border blocks.
+  const unsigned char pixels[9] = {0, 10, 200, 20, 30, 100, 40, 50, 60};
+  int png_len = 0;
+  unsigned char *png = stbi_write_png_to_mem(pixels, 3, 3, 3, 1, &png_len);
+  REQUIRE(png != nullptr);
+
+  tinygltf::LoadImageDataOption option;
+  option.preserve_channels = true;
+  option.max_image_dimension = 2;
+  tinygltf::Image image;
+  ok = tinygltf::LoadImageData(&image, 0, &err, &warn, 0, 0, png, png_len,
+                               &option);
+  free(png);
+  REQUIRE(ok);
+  REQUIRE(image.width == 2);
+  REQUIRE(image.height == 2);
+  REQUIRE(image.image.size() == 4);
+  CHECK(image.image[0] == 15);   // (0 + 10 + 20 + 30) / 4
+  CHECK(image.image[1] == 150);  // (200 + 100) / 2
+  CHECK(image.image[2] == 45);   // (40 + 50) / 2
+  CHECK(image.image[3] == 60);
+#endif
+}
+
+TEST_CASE("image-target-pixel-format", "[image]") {
+  std::string err;
+  std::string warn;
+  tinygltf::TinyGLTF ctx;
+  ctx.SetImageTargetComponents(4);
+
+  tinygltf::Model ref;
+  bool ok = ctx.LoadASCIIFromFile(&ref, &err, &warn, "../models/Cube/Cube.gltf");
+  REQUIRE(ok);
+
+  tinygltf::Model model;
+  ctx.SetImageTargetPixelFormat(TINYGLTF_COMPONENT_TYPE_FLOAT, 32);
+  ctx.SetImageSRGBToLinear(true);
+  ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+  REQUIRE(ok);
+  REQUIRE(err.empty());
+  REQUIRE(model.images.size() == 2);
+
+  for (size_t i = 0; i < model.images.size(); i++) {
+    const tinygltf::Image &image = model.images[i];
+    CHECK(image.bits == 32);
+    CHECK(image.pixel_type == TINYGLTF_COMPONENT_TYPE_FLOAT);
+    REQUIRE(image.image.size() == ref.images[i].image.size() * sizeof(float));
+
+    // images[0] is the baseColor(sRGB) texture, images[1] is linear.
+    const bool srgb = (i == 0);
+    const float *f = reinterpret_cast<const float *>(image.image.data());
+    size_t mismatches = 0;
+    for (size_t k = 0; k < ref.images[i].image.size(); k++) {
+      float c = ref.images[i].image[k] / 255.0f;
+      if (srgb && ((k % 4) != 3)) {
+        c = (c <= 0.04045f) ? c / 12.92f
+                            : std::pow((c + 0.055f) / 1.055f, 2.4f);
+      }
+      if (std::fabs(f[k] - c) > 1.0e-6f) {
+        mismatches++;
+      }
+    }
+    CHECK(mismatches == 0);
+  }
+
+#ifndef TINYGLTF_NO_STB_IMAGE
+  // 3x1 16-bit grey image. stb_image_write does not write 16-bit PNG, so
+  // store it as PGM(byte symmetric values, for stb_image reads them in the
+  // native byte order).
+  const unsigned short pixels[3] = {0, 0x8080, 0xffff};
+  const std::string header = "P5 3 1 65535\n";
+  std::vector<unsigned char> pgm(header.begin(), header.end());
+  for (int k = 0; k < 3; k++) {
+    pgm.push_back(static_cast<unsigned char>(pixels[k] >> 8));
+    pgm.push_back(static_cast<unsigned char>(pixels[k] & 0xff));
+  }
+
+  tinygltf::LoadImageDataOption option;
+  option.preserve_channels = true;
+  option.target_pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  option.target_bits = 8;
+  tinygltf::Image image;
+  ok = tinygltf::LoadImageData(&image, 0, &err, &warn, 0, 0, pgm.data(),
+                               int(pgm.size()), &option);
+  REQUIRE(ok);
+  REQUIRE(image.bits == 8);
+  REQUIRE(image.image.size() == 3);
+  CHECK(image.image[0] == 0);
+  CHECK(image.image[1] == 128);
+  CHECK(image.image[2] == 255);
+
+  // Half float.
+  option.target_pixel_type = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  option.target_bits = 16;
+  ok = tinygltf::LoadImageData(&image, 0, &err, &warn, 0, 0, pgm.data(),
+                               int(pgm.size()), &option);
+  REQUIRE(ok);
+  REQUIRE(image.bits == 16);
+  REQUIRE(image.pixel_type == TINYGLTF_COMPONENT_TYPE_FLOAT);
+  REQUIRE(image.image.size() == 6);
+  unsigned short h[3];
+  memcpy(h, image.image.data(), 6);
+  CHECK(h[0] == 0x0000);  // 0.0
+  CHECK(h[1] == 0x3804);  // 0.50196
+  CHECK(h[2] == 0x3c00);  // 1.0
+#endif
+}
+
+TEST_CASE("images-header-only", "[image]") {
+  int whole_image_reads = 0;
+  int range_reads = 0;
+  auto is_image = [](const std::string &path) {
+    return path.size() > 4 && path.substr(path.size() - 4) == ".png";
+  };
+
+  tinygltf::FsCallbacks fs = {
+      &tinygltf::FileExists, &tinygltf::ExpandFilePath,
+      [&](std::vector<unsigned char> *out, std::string *err,
+          const std::string &path, void *user_data) {
+        if (is_image(path)) whole_image_reads++;
+        return tinygltf::ReadWholeFile(out, err, path, user_data);
+      },
+      &tinygltf::WriteWholeFile, &tinygltf::GetFileSizeInBytes, nullptr,
+      [&](std::vector<unsigned char> *out, std::string *err,
+          const std::string &path, size_t offset, size_t length,
+          void *user_data) {
+        range_reads++;
+        return tinygltf::ReadFileRange(out, err, path, offset, length,
+                                       user_data);
+      }};
+
+  for (int pass = 0; pass < 2; pass++) {
+    tinygltf::TinyGLTF ctx;
+    if (pass == 1) {
+      // Without range reads, the whole file is read instead.
+      fs.ReadFileRange = nullptr;
+    }
+    REQUIRE(ctx.SetFsCallbacks(fs));
+    ctx.SetImagesHeaderOnly(true);
+
+    whole_image_reads = 0;
+    range_reads = 0;
+    std::string err;
+    std::string warn;
+    tinygltf::Model model;
+    bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn,
+                                    "../models/Cube/Cube.gltf");
+    REQUIRE(ok);
+    REQUIRE(err.empty());
+    REQUIRE(model.images.size() == 2);
+    for (const auto &image : model.images) {
+      CHECK(image.width == 512);
+      CHECK(image.height == 512);
+      CHECK(image.bits == 8);
+      CHECK(image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+      CHECK(image.image.empty());
+      CHECK(image.as_is == false);
+    }
+    CHECK(model.images[0].component == 4);
+
+    if (pass == 0) {
+      CHECK(whole_image_reads == 0);
+      CHECK(range_reads == 2);
+    } else {
+      CHECK(whole_image_reads == 2);
+      CHECK(range_reads == 0);
+    }
+  }
+
+  // Range read past the end of file.
+  std::vector<unsigned char> data;
+  std::string err;
+  REQUIRE(tinygltf::ReadFileRange(&data, &err, "../models/Cube/Cube.bin", 1790,
+                                  100, nullptr));
+  CHECK(data.size() == 10);
+  REQUIRE(tinygltf::ReadFileRange(&data, &err, "../models/Cube/Cube.bin",
+                                  4096, 100, nullptr));
+  CHECK(data.empty());
+}
+
+// Path of a scratch file in the temporary directory(TMPDIR, TEMP on Windows).
+static std::string TemporaryPath(const std::string &name) {
+#ifdef _WIN32
+  const char *dir = std::getenv("TEMP");
+  const char *fallback = ".";
+#else
+  const char *dir = std::getenv("TMPDIR");
+  const char *fallback = "/tmp";
+#endif
+  return std::string((dir && dir[0]) ? dir : fallback) + "/" + name;
+}
+
+TEST_CASE("images-as-is-no-copy", "[image]") {
+  std::string err;
+  std::string warn;
+  tinygltf::TinyGLTF ctx;
+
+  // External images: the file buffer is adopted by the image.
+  tinygltf::Model model;
+  ctx.SetImagesAsIs(true);
+  bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+  REQUIRE(ok);
+  REQUIRE(model.images.size() == 2);
+  for (const auto& image : model.images) {
+    CHECK(image.as_is == true);
+    CHECK(image.width == 512);
+    CHECK_FALSE(image.image.empty());
+  }
+
+  // Move the encoded images into bufferViews and save as GLB.
+  tinygltf::Model bvModel = model;
+  for (auto& image : bvModel.images) {
+    tinygltf::Buffer &buffer = bvModel.buffers[0];
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = buffer.data.size();
+    view.byteLength = image.image.size();
+    buffer.data.insert(buffer.data.end(), image.image.begin(), image.image.end());
+    buffer.data.resize((buffer.data.size() + 3) / 4 * 4);
+    bvModel.bufferViews.push_back(view);
+    image.bufferView = int(bvModel.bufferViews.size() - 1);
+    image.mimeType = "image/png";
+    image.uri.clear();
+    image.image.clear();
+  }
+  bvModel.buffers[0].uri.clear();
+  const std::string glb_path = TemporaryPath("Cube_as_is_no_copy.glb");
+  ok = ctx.WriteGltfSceneToFile(&bvModel, glb_path, true, true, true, true);
+  REQUIRE(ok);
+
+  // Images in a bufferView: bytes are borrowed from the buffer.
+  tinygltf::Model glbModel;
+  ctx.SetImagesAsIsBorrowBufferView(true);
+  ok = ctx.LoadBinaryFromFile(&glbModel, &err, &warn, glb_path);
+  std::remove(glb_path.c_str());
+  REQUIRE(ok);
+  REQUIRE(err.empty());
+  REQUIRE(glbModel.images.size() == 2);
+  for (size_t i = 0; i < glbModel.images.size(); i++) {
+    const tinygltf::Image &image = glbModel.images[i];
+    CHECK(image.as_is == true);
+    CHECK(image.image.empty());
+    CHECK(image.width == 512);
+    REQUIRE(image.bufferView >= 0);
+    const tinygltf::BufferView &view = glbModel.bufferViews[size_t(image.bufferView)];
+    const tinygltf::Buffer &buffer = glbModel.buffers[size_t(view.buffer)];
+    REQUIRE(view.byteLength == model.images[i].image.size());
+    CHECK(std::equal(model.images[i].image.begin(), model.images[i].image.end(),
+                     buffer.data.begin() + std::ptrdiff_t(view.byteOffset)));
+  }
+}
+
+#ifndef TINYGLTF_NO_STB_IMAGE
+static bool DecodeImageWithStb(std::vector<unsigned char> *out, int *width,
+                               int *height, int *component, int *bits,
+                               int req_component, const unsigned char *bytes,
+                               int size, std::string * /* err */,
+                               void *user_data) {
+  int *counter = static_cast<int*>(user_data);
+  (*counter)++;
+  // Ignore req_component. The loader converts channels.
+  (void)req_component;
+  unsigned char *data = stbi_load_from_memory(bytes, size, width, height, component, 0);
+  if (!data) {
+    return false;
+  }
+  out->assign(data, data + (*width) * (*height) * (*component));
+  stbi_image_free(data);
+  *bits = 8;
+  return true;
+}
+#else
+// Decodes every image to 2x2 RGB pixels.
+static bool DecodeImageBlank(std::vector<unsigned char> *out, int *width,
+                             int *height, int *component, int *bits,
+                             int /* req_component */,
+                             const unsigned char * /* bytes */, int /* size */,
+                             std::string * /* err */, void *user_data) {
+  int *counter = static_cast<int*>(user_data);
+  (*counter)++;
+  out->assign(2 * 2 * 3, 128);
+  *width = *height = 2;
+  *component = 3;
+  *bits = 8;
+  return true;
+}
+#endif
+
+static bool DecodeImageFail(std::vector<unsigned char> * /* out */, int * /* width */,
+                            int * /* height */, int * /* component */, int * /* bits */,
+                            int /* req_component */, const unsigned char * /* bytes */,
+                            int /* size */, std::string *err, void * /* user_data */) {
+  (*err) += "not implemented";
+  return false;
+}
+
+TEST_CASE("image-decoder-backend", "[image]") {
+  const unsigned char png_sig[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+  const unsigned char jpeg_sig[4] = {0xFF, 0xD8, 0xFF, 0xE0};
+  CHECK(tinygltf::GetImageMimeType(png_sig, 8) == "image/png");
+  CHECK(tinygltf::GetImageMimeType(jpeg_sig, 4) == "image/jpeg");
+  CHECK(tinygltf::GetImageMimeType(png_sig, 4).empty());
+
+  std::string err;
+  std::string warn;
+  int counter = 0;
+#ifndef TINYGLTF_NO_STB_IMAGE
+  {
+    tinygltf::Model model;
+    tinygltf::TinyGLTF ctx;
+    ctx.SetImageDecoder("image/png", DecodeImageWithStb, &counter);
+    bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+    REQUIRE(ok);
+    REQUIRE(warn.empty());
+    CHECK(counter == 2);
+    for (const auto& image : model.images) {
+      // Expanded to RGBA by the loader.
+      CHECK(image.component == 4);
+      CHECK(image.image.size() == size_t(512 * 512 * 4));
+    }
+  }
+
+  {
+    // Failing backend falls back to stb_image with a warning.
+    tinygltf::Model model;
+    tinygltf::TinyGLTF ctx;
+    ctx.SetImageDecoder("image/png", DecodeImageFail, nullptr);
+    bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+    REQUIRE(ok);
+    CHECK(warn.find("not implemented") != std::string::npos);
+    for (const auto& image : model.images) {
+      CHECK(image.image.size() == size_t(512 * 512 * 4));
+    }
+
+    // Removed backend is not called.
+    warn.clear();
+    ctx.RemoveImageDecoder("image/png");
+    ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+    REQUIRE(ok);
+    CHECK(warn.empty());
+  }
+#else
+  {
+    // The backends are the only decoders.
+    tinygltf::Model model;
+    tinygltf::TinyGLTF ctx;
+    ctx.SetImageDecoder("image/png", DecodeImageBlank, &counter);
+    bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+    REQUIRE(ok);
+    CHECK(counter == 2);
+    for (const auto& image : model.images) {
+      CHECK(image.width == 2);
+      CHECK(image.component == 4);
+      CHECK(image.image.size() == size_t(2 * 2 * 4));
+    }
+
+    ctx.SetImageDecoder("image/png", DecodeImageFail, nullptr);
+    err.clear();
+    CHECK(!ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf"));
+    CHECK(err.find("No image decoder") != std::string::npos);
+  }
+#endif
+}
+
+TEST_CASE("accessor-view", "[accessor]") {
+  tinygltf::Model model;
+  tinygltf::TinyGLTF ctx;
+  std::string err;
+  std::string warn;
+  bool ok = ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf");
+  REQUIRE(ok);
+
+  const tinygltf::Primitive &prim = model.meshes[0].primitives[0];
+  const int pos_idx = prim.attributes.at("POSITION");
+  const tinygltf::Accessor &accessor = model.accessors[size_t(pos_idx)];
+  const tinygltf::BufferView &view = model.bufferViews[size_t(accessor.bufferView)];
+  const unsigned char *base = model.buffers[size_t(view.buffer)].data.data() +
+                              view.byteOffset + accessor.byteOffset;
+
+  tinygltf::AccessorView<std::array<float, 3>> positions(model, pos_idx, &err);
+  REQUIRE(positions.valid());
+  REQUIRE(err.empty());
+  REQUIRE(positions.size() == accessor.count);
+  CHECK(positions.byte_stride() == 12);
+  size_t i = 0;
+  for (const std::array<float, 3> &p : positions) {
+    float expected[3];
+    memcpy(expected, base + 12 * i, sizeof(expected));
+    CHECK(p[0] == expected[0]);
+    CHECK(p[1] == expected[1]);
+    CHECK(p[2] == expected[2]);
+    i++;
+  }
+  CHECK(i == accessor.count);
+  CHECK(positions.end() - positions.begin() == ptrdiff_t(accessor.count));
+
+  // Widen 16-bit indices.
+  tinygltf::AccessorView<uint32_t, uint16_t> indices(model, prim.indices, &err);
+  REQUIRE(indices.valid());
+  uint32_t max_index = 0;
+  for (uint32_t idx : indices) {
+    max_index = (std::max)(max_index, idx);
+  }
+  CHECK(max_index == 35);
+
+  // Type mismatches are rejected.
+  CHECK_FALSE((tinygltf::AccessorView<std::array<float, 2>>(model, pos_idx).valid()));
+  CHECK_FALSE((tinygltf::AccessorView<uint32_t>(model, prim.indices).valid()));
+  CHECK_FALSE((tinygltf::AccessorView<float>(model, 100, &err).valid()));
+  CHECK_FALSE(err.empty());
+
+  // Out of range accessors are rejected.
+  tinygltf::Model broken = model;
+  broken.accessors[size_t(pos_idx)].count += 1;
+  CHECK_FALSE((tinygltf::AccessorView<std::array<float, 3>>(broken, pos_idx).valid()));
+  // Counts whose extent wraps around are rejected too.
+  broken.accessors[size_t(pos_idx)].count = size_t(1) << 62;
+  CHECK_FALSE((tinygltf::AccessorView<std::array<float, 3>>(broken, pos_idx).valid()));
+  broken.accessors[size_t(pos_idx)].count = accessor.count;
+  broken.accessors[size_t(pos_idx)].byteOffset = ~size_t(0) - 4;
+  CHECK_FALSE((tinygltf::AccessorView<std::array<float, 3>>(broken, pos_idx).valid()));
+
+  // Normalized integer to float, strided.
+  const int8_t snorm[6] = {127, 0, -128, 0, 64, 0};
+  tinygltf::AccessorView<float, int8_t> s(
+      reinterpret_cast<const unsigned char *>(snorm), 3, 2, true);
+  CHECK(s[0] == 1.0f);
+  CHECK(s[1] == -1.0f);
+  CHECK(std::fabs(s[2] - 64.0f / 127.0f) < 1.0e-6f);
+
+  const uint8_t unorm[4] = {0, 255, 51, 255};
+  tinygltf::AccessorView<std::array<float, 2>, uint8_t> u(unorm, 2, 0, true);
+  CHECK(u.byte_stride() == 2);
+  CHECK(u[0][0] == 0.0f);
+  CHECK(u[0][1] == 1.0f);
+  CHECK(std::fabs(u[1][0] - 0.2f) < 1.0e-6f);
+
+  // Not normalized: plain conversion.
+  tinygltf::AccessorView<std::array<float, 2>, uint8_t> c(unorm, 2, 0, false);
+  CHECK(c[0][1] == 255.0f);
+}
+
+TEST_CASE("materialize-sparse-accessor", "[accessor]") {
+  // base: 4 x VEC2 float, stride 12. sparse: 2 values at indices 3 and 1.
+  tinygltf::Model model;
+  model.buffers.resize(1);
+  std::vector<unsigned char> &data = model.buffers[0].data;
+  auto append = [&data](const void *p, size_t n) {
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(p);
+    data.insert(data.end(), b, b + n);
+  };
+  const float base[12] = {1, 2, 0, 3, 4, 0, 5, 6, 0, 7, 8, 0};
+  const uint8_t indices8[4] = {3, 1, 0, 0};
+  const uint16_t indices16[2] = {2, 0};
+  const float values[4] = {10, 20, 30, 40};
+  append(base, sizeof(base));         // 0
+  append(indices8, sizeof(indices8)); // 48
+  append(indices16, sizeof(indices16)); // 52
+  append(values, sizeof(values));     // 56
+
+  auto add_view = [&model](size_t offset, size_t length, size_t stride) {
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = offset;
+    view.byteLength = length;
+    view.byteStride = stride;
+    model.bufferViews.push_back(view);
+  };
+  add_view(0, 48, 12);
+  add_view(48, 4, 0);
+  add_view(52, 4, 0);
+  add_view(56, 16, 0);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC2;
+  accessor.count = 4;
+  accessor.sparse.isSparse = true;
+  accessor.sparse.count = 2;
+  accessor.sparse.indices.bufferView = 1;
+  accessor.sparse.indices.byteOffset = 0;
+  accessor.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  accessor.sparse.values.bufferView = 3;
+  accessor.sparse.values.byteOffset = 0;
+  model.accessors.push_back(accessor);
+
+  // No base data, 16-bit indices.
+  accessor.bufferView = -1;
+  accessor.count = 3;
+  accessor.sparse.indices.bufferView = 2;
+  accessor.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  model.accessors.push_back(accessor);
+
+  std::string err;
+  std::vector<unsigned char> out;
+  REQUIRE(tinygltf::MaterializeAccessor(model, 0, &out, &err));
+  REQUIRE(out.size() == 4 * 8);
+  std::vector<float> f(8);
+  memcpy(f.data(), out.data(), out.size());
+  const float expected0[8] = {1, 2, 30, 40, 5, 6, 10, 20};
+  for (size_t i = 0; i < 8; i++) {
+    CHECK(f[i] == expected0[i]);
+  }
+
+  REQUIRE(tinygltf::MaterializeAccessor(model, 1, &out, &err));
+  REQUIRE(out.size() == 3 * 8);
+  memcpy(f.data(), out.data(), out.size());
+  const float expected1[6] = {30, 40, 0, 0, 10, 20};
+  for (size_t i = 0; i < 6; i++) {
+    CHECK(f[i] == expected1[i]);
+  }
+
+  // Out of range sparse index.
+  tinygltf::Model broken = model;
+  broken.accessors[1].count = 2;
+  CHECK_FALSE(tinygltf::MaterializeAccessor(broken, 1, &out, &err));
+  CHECK_FALSE(err.empty());
+  err.clear();
+  CHECK_FALSE(tinygltf::DensifySparseAccessors(&broken, &err));
+  CHECK(broken.accessors[0].sparse.isSparse);
+  err.clear();
+
+  // A count whose extent wraps around the 16 byte base view, with a sparse
+  // index far beyond the base data.
+  broken = model;
+  broken.bufferViews[0].byteStride = 0;
+  broken.bufferViews[0].byteLength = 16;
+  broken.accessors[0].type = TINYGLTF_TYPE_SCALAR;
+  broken.accessors[0].count = size_t(1) << 60;
+  broken.accessors[0].sparse.count = 1;
+  broken.accessors[0].sparse.indices.componentType =
+      TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  CHECK_FALSE(tinygltf::MaterializeAccessor(broken, 0, &out, &err));
+  CHECK(err.find("exceeds") != std::string::npos);
+  err.clear();
+  // count * 4 bytes wraps to 0.
+  broken.accessors[0].count = size_t(1) << 62;
+  CHECK_FALSE(tinygltf::MaterializeAccessor(broken, 0, &out, &err));
+  CHECK(err.find("too large") != std::string::npos);
+  err.clear();
+  // A huge count without bufferView is rejected before allocating.
+  broken = model;
+  broken.accessors[1].count = size_t(1) << 40;
+  CHECK_FALSE(tinygltf::MaterializeAccessor(broken, 1, &out, &err));
+  CHECK(err.find("without bufferView") != std::string::npos);
+  err.clear();
+
+  REQUIRE(tinygltf::DensifySparseAccessors(&model, &err));
+  for (size_t i = 0; i < model.accessors.size(); i++) {
+    CHECK_FALSE(model.accessors[i].sparse.isSparse);
+    tinygltf::AccessorView<std::array<float, 2>> view(model, int(i), &err);
+    REQUIRE(view.valid());
+    const float *expected = (i == 0) ? expected0 : expected1;
+    for (size_t k = 0; k < view.size(); k++) {
+      CHECK(view[k][0] == expected[2 * k]);
+      CHECK(view[k][1] == expected[2 * k + 1]);
+    }
+  }
+
+  // Sparse morph targets.
+  tinygltf::TinyGLTF ctx;
+  tinygltf::Model morph;
+  std::string warn;
+  REQUIRE(ctx.LoadBinaryFromFile(
+      &morph, &err, &warn,
+      "../models/SparseMorphTargets-issue280/singleBlendshapeCube_sparse.glb"));
+  std::vector<std::vector<unsigned char>> materialized(morph.accessors.size());
+  size_t num_sparse = 0;
+  for (size_t i = 0; i < morph.accessors.size(); i++) {
+    num_sparse += morph.accessors[i].sparse.isSparse ? 1 : 0;
+    REQUIRE(tinygltf::MaterializeAccessor(morph, int(i), &materialized[i], &err));
+  }
+  CHECK(num_sparse > 0);
+  REQUIRE(tinygltf::DensifySparseAccessors(&morph, &err));
+  for (size_t i = 0; i < morph.accessors.size(); i++) {
+    CHECK_FALSE(morph.accessors[i].sparse.isSparse);
+    REQUIRE(tinygltf::MaterializeAccessor(morph, int(i), &out, &err));
+    CHECK(out == materialized[i]);
+  }
+  CHECK(err.empty());
+}
+
+TEST_CASE("convert-accessors-to-float", "[accessor]") {
+  tinygltf::Model model;
+  tinygltf::TinyGLTF ctx;
+  std::string err;
+  std::string warn;
+  REQUIRE(ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf"));
+
+  // Quantized attributes: 37 x normalized SHORT VEC3(stride 8) and
+  // 37 x normalized UNSIGNED_BYTE VEC4(packed).
+  const size_t count = 37;
+  tinygltf::Buffer quantized;
+  for (size_t i = 0; i < count; i++) {
+    const int16_t v[4] = {int16_t(i * 800 - 32768), int16_t(32767 - i),
+                          int16_t(i), 0};
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(v);
+    quantized.data.insert(quantized.data.end(), b, b + sizeof(v));
+  }
+  for (size_t i = 0; i < count * 4; i++) {
+    quantized.data.push_back(static_cast<unsigned char>(i * 7));
+  }
+  model.buffers.push_back(quantized);
+  const int buffer = int(model.buffers.size() - 1);
+
+  tinygltf::BufferView view;
+  view.buffer = buffer;
+  view.byteOffset = 0;
+  view.byteLength = count * 8;
+  view.byteStride = 8;
+  model.bufferViews.push_back(view);
+  view.byteOffset = count * 8;
+  view.byteLength = count * 4;
+  view.byteStride = 0;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = int(model.bufferViews.size() - 2);
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_SHORT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.normalized = true;
+  accessor.count = count;
+  model.accessors.push_back(accessor);
+  const int short_idx = int(model.accessors.size() - 1);
+  accessor.bufferView = int(model.bufferViews.size() - 1);
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  accessor.type = TINYGLTF_TYPE_VEC4;
+  model.accessors.push_back(accessor);
+  const int byte_idx = int(model.accessors.size() - 1);
+
+  const tinygltf::Primitive &prim = model.meshes[0].primitives[0];
+  const int pos_idx = prim.attributes.at("POSITION");
+  const size_t num_pos = model.accessors[size_t(pos_idx)].count;
+
+  std::vector<float> pos_aos(num_pos * 3);
+  std::vector<float> pos_soa(num_pos * 3);
+  std::vector<float> shorts(count * 3);
+  std::vector<float> bytes_soa(count * 4);
+  std::vector<float> indices(model.accessors[size_t(prim.indices)].count);
+
+  std::vector<tinygltf::AccessorFloatTarget> targets(5);
+  targets[0].accessor = pos_idx;
+  targets[0].dst = pos_aos.data();
+  targets[1].accessor = pos_idx;
+  targets[1].dst = pos_soa.data();
+  targets[1].element_stride = 1;
+  targets[1].component_stride = num_pos;
+  targets[2].accessor = short_idx;
+  targets[2].dst = shorts.data();
+  targets[3].accessor = byte_idx;
+  targets[3].dst = bytes_soa.data();
+  targets[3].element_stride = 1;
+  targets[3].component_stride = count;
+  targets[4].accessor = prim.indices;
+  targets[4].dst = indices.data();
+
+  for (int num_threads = 1; num_threads <= 4; num_threads += 3) {
+    REQUIRE(tinygltf::ConvertAccessorsToFloat(model, targets, &err, num_threads));
+
+    tinygltf::AccessorView<std::array<float, 3>> positions(model, pos_idx);
+    REQUIRE(positions.valid());
+    for (size_t i = 0; i < num_pos; i++) {
+      for (size_t c = 0; c < 3; c++) {
+        CHECK(pos_aos[3 * i + c] == positions[i][c]);
+        CHECK(pos_soa[c * num_pos + i] == positions[i][c]);
+      }
+    }
+
+    tinygltf::AccessorView<std::array<float, 3>, int16_t> s(model, short_idx);
+    tinygltf::AccessorView<std::array<float, 4>, uint8_t> b(model, byte_idx);
+    REQUIRE(s.valid());
+    REQUIRE(b.valid());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+      for (size_t c = 0; c < 3; c++) {
+        if (std::fabs(shorts[3 * i + c] - s[i][c]) > 1.0e-6f) mismatches++;
+      }
+      for (size_t c = 0; c < 4; c++) {
+        if (std::fabs(bytes_soa[c * count + i] - b[i][c]) > 1.0e-6f) mismatches++;
+      }
+    }
+    CHECK(mismatches == 0);
+    CHECK(shorts[0] == -1.0f);
+    CHECK(std::fabs(bytes_soa[count * 3 + 36] -
+                    float((36 * 4 + 3) * 7 % 256) / 255.0f) < 1.0e-6f);
+
+    for (size_t i = 0; i < indices.size(); i++) {
+      tinygltf::AccessorView<uint16_t> idx(model, prim.indices);
+      CHECK(indices[i] == float(idx[i]));
+    }
+  }
+
+  // Flat packed conversion(SIMD path).
+  std::vector<float> bytes_aos(count * 4);
+  targets.resize(1);
+  targets[0].accessor = byte_idx;
+  targets[0].dst = bytes_aos.data();
+  REQUIRE(tinygltf::ConvertAccessorsToFloat(model, targets, &err));
+  for (size_t i = 0; i < count * 4; i++) {
+    CHECK(std::fabs(bytes_aos[i] - float((i * 7) % 256) / 255.0f) < 1.0e-6f);
+  }
+
+  // Invalid accessor.
+  targets[0].accessor = 1000;
+  CHECK_FALSE(tinygltf::ConvertAccessorsToFloat(model, targets, &err));
+  CHECK_FALSE(err.empty());
+
+  // A huge count must not wrap the range check.
+  err.clear();
+  tinygltf::Model wrapped = model;
+  wrapped.accessors[size_t(byte_idx)].count = size_t(1) << 62;
+  targets[0].accessor = byte_idx;
+  CHECK_FALSE(tinygltf::ConvertAccessorsToFloat(wrapped, targets, &err));
+  CHECK(err.find("exceeds") != std::string::npos);
+
+  // Exceptions thrown by tasks are rethrown on the calling thread after all
+  // threads are joined.
+  bool caught = false;
+  try {
+    tinygltf::detail::ParallelFor(64, 4, [](size_t i) {
+      if (i == 3) {
+        throw std::runtime_error("task");
+      }
+    });
+  } catch (const std::runtime_error &e) {
+    caught = std::string(e.what()) == "task";
+  }
+  CHECK(caught);
+}
+
+TEST_CASE("compute-accessor-bounds", "[accessor]") {
+  tinygltf::Model model;
+  tinygltf::TinyGLTF ctx;
+  std::string err;
+  std::string warn;
+  REQUIRE(ctx.LoadASCIIFromFile(&model, &err, &warn, "../models/Cube/Cube.gltf"));
+
+  const tinygltf::Model original = model;
+  for (auto &accessor : model.accessors) {
+    accessor.minValues.clear();
+    accessor.maxValues.clear();
+  }
+  REQUIRE(tinygltf::ComputeAccessorBounds(&model));
+  for (size_t i = 0; i < model.accessors.size(); i++) {
+    const tinygltf::Accessor &expected = original.accessors[i];
+    const tinygltf::Accessor &computed = model.accessors[i];
+    REQUIRE(computed.minValues.size() == expected.minValues.size());
+    REQUIRE(computed.maxValues.size() == expected.maxValues.size());
+    for (size_t c = 0; c < computed.minValues.size(); c++) {
+      CHECK(std::fabs(computed.minValues[c] - expected.minValues[c]) < 1.0e-5);
+      CHECK(std::fabs(computed.maxValues[c] - expected.maxValues[c]) < 1.0e-5);
+    }
+  }
+
+  // only_missing keeps existing values, update_accessors = false keeps all.
+  model.accessors[0].maxValues[0] = 1000.0;
+  model.accessors[1].minValues.clear();
+  tinygltf::AccessorBoundsOptions options;
+  options.only_missing = true;
+  std::vector<tinygltf::AccessorBounds> bounds;
+  REQUIRE(tinygltf::ComputeAccessorBounds(&model, options, &err, &bounds));
+  REQUIRE(bounds.size() == 1);
+  CHECK(bounds[0].accessor == 1);
+  CHECK(model.accessors[0].maxValues[0] == 1000.0);
+  CHECK(model.accessors[1].minValues.size() == 3);
+
+  options.only_missing = false;
+  options.update_accessors = false;
+  options.accessors.push_back(0);
+  REQUIRE(tinygltf::ComputeAccessorBounds(&model, options, &err, &bounds));
+  REQUIRE(bounds.size() == 1);
+  CHECK(bounds[0].max[0] == 35.0);
+  CHECK(model.accessors[0].maxValues[0] == 1000.0);
+
+  // Large strided float accessor, split into chunks on threads, and a sparse
+  // accessor on top of it.
+  const size_t count = 200003;
+  tinygltf::Buffer buffer;
+  buffer.data.resize(count * 16);
+  for (size_t i = 0; i < count; i++) {
+    const float v[4] = {float(i % 1000) - 500.0f, float(i) * 0.5f,
+                        -float(i), 12345.0f};
+    memcpy(buffer.data.data() + i * 16, v, sizeof(v));
+  }
+  const uint32_t sparse_index = 70000;
+  const float sparse_value[3] = {-9999.0f, 1.0e9f, 1.0f};
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(&sparse_index);
+  buffer.data.insert(buffer.data.end(), p, p + 4);
+  p = reinterpret_cast<const unsigned char *>(sparse_value);
+  buffer.data.insert(buffer.data.end(), p, p + 12);
+  model.buffers.push_back(buffer);
+
+  tinygltf::BufferView view;
+  view.buffer = int(model.buffers.size() - 1);
+  view.byteLength = count * 16;
+  view.byteStride = 16;
+  model.bufferViews.push_back(view);
+  view.byteOffset = count * 16;
+  view.byteLength = 16;
+  view.byteStride = 0;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = int(model.bufferViews.size() - 2);
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = count;
+  model.accessors.push_back(accessor);
+  accessor.sparse.isSparse = true;
+  accessor.sparse.count = 1;
+  accessor.sparse.indices.bufferView = int(model.bufferViews.size() - 1);
+  accessor.sparse.indices.byteOffset = 0;
+  accessor.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  accessor.sparse.values.bufferView = int(model.bufferViews.size() - 1);
+  accessor.sparse.values.byteOffset = 4;
+  model.accessors.push_back(accessor);
+
+  tinygltf::AccessorBounds b;
+  REQUIRE(tinygltf::ComputeAccessorBounds(model, int(model.accessors.size() - 2),
+                                          &b, &err, 4));
+  REQUIRE(b.min.size() == 3);
+  CHECK(b.min[0] == -500.0);
+  CHECK(b.max[0] == 499.0);
+  CHECK(b.min[1] == 0.0);
+  CHECK(b.max[1] == double(float(count - 1) * 0.5f));
+  CHECK(b.min[2] == -double(count - 1));
+  CHECK(b.max[2] == 0.0);
+
+  REQUIRE(tinygltf::ComputeAccessorBounds(model, int(model.accessors.size() - 1),
+                                          &b, &err, 4));
+  CHECK(b.min[0] == -9999.0);
+  CHECK(b.max[1] == 1.0e9);
+  CHECK(b.max[2] == 1.0);
+
+  CHECK_FALSE(tinygltf::ComputeAccessorBounds(model, 12345, &b, &err));
+
+  // Counts whose extent wraps around are rejected.
+  model.accessors[model.accessors.size() - 2].count = size_t(1) << 60;
+  err.clear();
+  CHECK_FALSE(tinygltf::ComputeAccessorBounds(
+      model, int(model.accessors.size() - 2), &b, &err));
+  CHECK(err.find("exceeds") != std::string::npos);
+}
+
+TEST_CASE("triangulate-primitives", "[mesh]") {
+  tinygltf::Model model;
+  std::string err;
+
+  // 6 vertices, strip indices with a restart(0xffff) in the middle.
+  const uint16_t strip[] = {0, 1, 2, 3, 0xffff, 2, 3, 4, 5};
+  tinygltf::Buffer buffer;
+  buffer.data.resize(sizeof(strip) + 6 * 12);
+  std::memcpy(buffer.data.data(), strip, sizeof(strip));
+  model.buffers.push_back(buffer);
+
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteOffset = 0;
+  view.byteLength = sizeof(strip);
+  model.bufferViews.push_back(view);
+  view.byteOffset = 20;
+  view.byteLength = 6 * 12;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor indices;
+  indices.bufferView = 0;
+  indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  indices.type = TINYGLTF_TYPE_SCALAR;
+  indices.count = 9;
+  model.accessors.push_back(indices);
+
+  tinygltf::Accessor position;
+  position.bufferView = 1;
+  position.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  position.type = TINYGLTF_TYPE_VEC3;
+  position.count = 6;
+  model.accessors.push_back(position);
+
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 1;
+  primitive.indices = 0;
+  primitive.mode = TINYGLTF_MODE_TRIANGLE_STRIP;
+
+  std::vector<uint32_t> tris;
+  tinygltf::TriangulateOptions options;
+  options.primitive_restart = true;
+  REQUIRE(tinygltf::GetTriangleIndices(model, primitive, &tris, &err, options));
+  const uint32_t expected_strip[] = {0, 1, 2, 1, 3, 2, 2, 3, 4, 3, 5, 4};
+  REQUIRE(tris.size() == 12);
+  for (size_t i = 0; i < tris.size(); i++) {
+    CHECK(tris[i] == expected_strip[i]);
+  }
+
+  // Fan(non-indexed): {1, 2, 0}, {2, 3, 0}, ...
+  tinygltf::Primitive fan;
+  fan.attributes["POSITION"] = 1;
+  fan.mode = TINYGLTF_MODE_TRIANGLE_FAN;
+  REQUIRE(tinygltf::GetTriangleIndices(model, fan, &tris, &err));
+  REQUIRE(tris.size() == 12);
+  CHECK(tris[0] == 1);
+  CHECK(tris[1] == 2);
+  CHECK(tris[2] == 0);
+  CHECK(tris[9] == 4);
+  CHECK(tris[10] == 5);
+  CHECK(tris[11] == 0);
+
+  tinygltf::Primitive points;
+  points.attributes["POSITION"] = 1;
+  points.mode = TINYGLTF_MODE_POINTS;
+  CHECK_FALSE(tinygltf::GetTriangleIndices(model, points, &tris, &err));
+  err.clear();
+
+  CHECK(tinygltf::GetSmallestIndexComponentType(255, true) ==
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+  CHECK(tinygltf::GetSmallestIndexComponentType(256, true) ==
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+  CHECK(tinygltf::GetSmallestIndexComponentType(65536) ==
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
+
+  // Widen/narrow round trip through the SIMD paths.
+  std::vector<uint32_t> wide(37);
+  for (size_t i = 0; i < wide.size(); i++) {
+    wide[i] = uint32_t(i * 1771) & 0xfffe;
+  }
+  std::vector<uint16_t> narrow(wide.size());
+  tinygltf::NarrowIndices(wide.data(), wide.size(),
+                          TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+                          reinterpret_cast<unsigned char *>(narrow.data()));
+  for (size_t i = 0; i < wide.size(); i++) {
+    CHECK(narrow[i] == wide[i]);
+  }
+
+  tinygltf::Mesh mesh;
+  primitive.mode = TINYGLTF_MODE_TRIANGLE_STRIP;
+  mesh.primitives.push_back(primitive);
+  mesh.primitives.push_back(fan);
+  mesh.primitives.push_back(points);
+  model.meshes.push_back(mesh);
+
+  options.num_threads = 2;
+  options.allow_unsigned_byte = true;
+  REQUIRE(tinygltf::TriangulatePrimitives(&model, options, &err));
+  CHECK(err.empty());
+  const tinygltf::Mesh &out = model.meshes[0];
+  CHECK(out.primitives[0].mode == TINYGLTF_MODE_TRIANGLES);
+  CHECK(out.primitives[1].mode == TINYGLTF_MODE_TRIANGLES);
+  CHECK(out.primitives[2].mode == TINYGLTF_MODE_POINTS);
+  const tinygltf::Accessor &acc =
+      model.accessors[size_t(out.primitives[0].indices)];
+  CHECK(acc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+  CHECK(acc.count == 12);
+  CHECK(acc.maxValues[0] == 5.0);
+  REQUIRE(tinygltf::GetTriangleIndices(model, out.primitives[0], &tris, &err));
+  for (size_t i = 0; i < tris.size(); i++) {
+    CHECK(tris[i] == expected_strip[i]);
+  }
+  CHECK(model.accessors[size_t(out.primitives[1].indices)].count == 12);
+}
+
+TEST_CASE("weld-vertices", "[mesh]") {
+  tinygltf::Model model;
+  std::string err;
+
+  // Non-indexed quad(2 triangles, 6 vertices, 4 unique) with a morph target
+  // and a color stream.
+  const float positions[] = {0, 0, 0, 1, 0, 0, 0, 1, 0,
+                             0, 1, 0, 1, 0, 0, 1, 1, 0};
+  const float deltas[] = {0, 0, 1, 0, 0, 1, 0, 0, 1,
+                          0, 0, 1, 0, 0, 1, 0, 0, 1};
+  const unsigned char colors[] = {255, 0, 0, 0, 255, 0, 0, 0, 255,
+                                  0, 0, 255, 0, 255, 0, 0, 0, 0};
+
+  tinygltf::Buffer buffer;
+  buffer.data.resize(1024, 0xcd);  // unreferenced bytes get dropped
+  std::memcpy(buffer.data.data() + 64, positions, sizeof(positions));
+  std::memcpy(buffer.data.data() + 256, deltas, sizeof(deltas));
+  std::memcpy(buffer.data.data() + 512, colors, sizeof(colors));
+  model.buffers.push_back(buffer);
+
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteOffset = 64;
+  view.byteLength = sizeof(positions);
+  model.bufferViews.push_back(view);
+  view.byteOffset = 256;
+  view.byteLength = sizeof(deltas);
+  model.bufferViews.push_back(view);
+  view.byteOffset = 512;
+  view.byteLength = sizeof(colors);
+  model.bufferViews.push_back(view);
+  view.byteOffset = 800;  // unreferenced, e.g. used by an extension
+  view.byteLength = 16;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = 6;
+  accessor.minValues = {0, 0, 0};
+  accessor.maxValues = {1, 1, 0};
+  model.accessors.push_back(accessor);
+  accessor.bufferView = 1;
+  accessor.minValues.clear();
+  accessor.maxValues.clear();
+  model.accessors.push_back(accessor);
+  accessor.bufferView = 2;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  accessor.normalized = true;
+  model.accessors.push_back(accessor);
+
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.attributes["COLOR_0"] = 2;
+  primitive.targets.push_back({{"POSITION", 1}});
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+
+  tinygltf::WeldReport report;
+  REQUIRE(tinygltf::WeldVertices(&model, tinygltf::WeldOptions(), &err,
+                                 &report));
+  CHECK(err.empty());
+  CHECK(report.vertices_before == 6);
+  CHECK(report.vertices_after == 4);
+  CHECK(report.bytes_before == 1024);
+  CHECK(report.bytes_after < 200);
+
+  const tinygltf::Primitive &welded = model.meshes[0].primitives[0];
+  // Only the accessors of the welded primitive remain. The bufferView which
+  // was unreferenced before welding is kept.
+  CHECK(model.accessors.size() == 4);
+  CHECK(model.bufferViews.size() == 5);
+  REQUIRE(welded.indices >= 0);
+
+  std::vector<uint32_t> tris;
+  REQUIRE(tinygltf::GetTriangleIndices(model, welded, &tris, &err));
+  const uint32_t expected[] = {0, 1, 2, 2, 1, 3};
+  REQUIRE(tris.size() == 6);
+  for (size_t i = 0; i < 6; i++) {
+    CHECK(tris[i] == expected[i]);
+  }
+
+  tinygltf::AccessorView<std::array<float, 3>> pos(
+      model, welded.attributes.at("POSITION"), &err);
+  REQUIRE(pos.valid());
+  REQUIRE(pos.size() == 4);
+  CHECK(pos[1][0] == 1.0f);
+  CHECK(pos[1][1] == 0.0f);
+  CHECK(pos[3][0] == 1.0f);
+  CHECK(pos[3][1] == 1.0f);
+  const tinygltf::Accessor &pos_accessor =
+      model.accessors[size_t(welded.attributes.at("POSITION"))];
+  CHECK(pos_accessor.maxValues[1] == 1.0);
+
+  // RGB8 colors get a 4 byte aligned stride.
+  const tinygltf::Accessor &color =
+      model.accessors[size_t(welded.attributes.at("COLOR_0"))];
+  CHECK(color.normalized);
+  CHECK(model.bufferViews[size_t(color.bufferView)].byteStride == 4);
+
+  tinygltf::AccessorView<std::array<float, 3>> delta(
+      model, welded.targets[0].at("POSITION"), &err);
+  REQUIRE(delta.valid());
+  REQUIRE(delta.size() == 4);
+  CHECK(delta[3][2] == 1.0f);
+
+  // CompactBuffers removes the unreferenced bufferView, unless an extension
+  // it does not know about may refer to it.
+  tinygltf::Model with_metadata = model;
+  with_metadata.extensionsUsed.push_back("EXT_structural_metadata");
+  err.clear();
+  CHECK_FALSE(tinygltf::CompactBuffers(&with_metadata, &err));
+  CHECK(err.find("EXT_structural_metadata") != std::string::npos);
+  CHECK(with_metadata.bufferViews.size() == 5);
+  err.clear();
+  REQUIRE(tinygltf::CompactBuffers(&model, &err));
+  CHECK(model.bufferViews.size() == 4);
+
+  // Welding again with the extension: the replaced data stays, nothing else
+  // is renumbered.
+  const std::vector<tinygltf::BufferView> views = with_metadata.bufferViews;
+  const std::vector<unsigned char> data = with_metadata.buffers[0].data;
+  with_metadata.meshes[0].primitives[0].indices = -1;
+  REQUIRE(tinygltf::WeldVertices(&with_metadata, tinygltf::WeldOptions(),
+                                 &err));
+  REQUIRE(with_metadata.bufferViews.size() > views.size());
+  for (size_t i = 0; i < views.size(); i++) {
+    CHECK(with_metadata.bufferViews[i] == views[i]);
+  }
+  CHECK(std::equal(data.begin(), data.end(),
+                   with_metadata.buffers[0].data.begin()));
+}
+
+TEST_CASE("optimize-vertex-cache", "[mesh]") {
+  // 32x32 grid of quads with triangles in a scrambled order.
+  const uint32_t kGrid = 32;
+  const uint32_t kRow = kGrid + 1;
+  std::vector<float> positions;
+  for (uint32_t y = 0; y < kRow; y++) {
+    for (uint32_t x = 0; x < kRow; x++) {
+      positions.push_back(float(x));
+      positions.push_back(float(y));
+      positions.push_back(0.0f);
+    }
+  }
+  std::vector<uint32_t> tris;
+  for (uint32_t y = 0; y < kGrid; y++) {
+    for (uint32_t x = 0; x < kGrid; x++) {
+      const uint32_t v = y * kRow + x;
+      const uint32_t quad[] = {v, v + 1, v + kRow, v + kRow, v + 1, v + kRow + 1};
+      tris.insert(tris.end(), quad, quad + 6);
+    }
+  }
+  const size_t num_tris = tris.size() / 3;
+  std::vector<uint32_t> scrambled(tris.size());
+  for (size_t t = 0; t < num_tris; t++) {
+    const size_t s = (t * 1237) % num_tris;  // 1237 is coprime to 2048
+    std::memcpy(&scrambled[3 * t], &tris[3 * s], 3 * sizeof(uint32_t));
+  }
+
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  buffer.data.resize(positions.size() * 4 + scrambled.size() * 4);
+  std::memcpy(buffer.data.data(), positions.data(), positions.size() * 4);
+  std::memcpy(buffer.data.data() + positions.size() * 4, scrambled.data(),
+              scrambled.size() * 4);
+  model.buffers.push_back(buffer);
+
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = positions.size() * 4;
+  model.bufferViews.push_back(view);
+  view.byteOffset = positions.size() * 4;
+  view.byteLength = scrambled.size() * 4;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = positions.size() / 3;
+  model.accessors.push_back(accessor);
+  accessor.bufferView = 1;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  accessor.type = TINYGLTF_TYPE_SCALAR;
+  accessor.count = scrambled.size();
+  model.accessors.push_back(accessor);
+
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.indices = 1;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+
+  std::string err;
+  std::vector<tinygltf::PrimitiveCacheReport> report;
+  tinygltf::VertexCacheOptions options;
+  options.num_threads = 2;
+  REQUIRE(tinygltf::OptimizePrimitivesForVertexCache(&model, options, &err,
+                                                     &report));
+  CHECK(err.empty());
+  REQUIRE(report.size() == 1);
+  CHECK(report[0].before.triangles == num_tris);
+  CHECK(report[0].before.vertices == kRow * kRow);
+  CHECK(report[0].after.acmr < 0.8);
+  CHECK(report[0].after.acmr < report[0].before.acmr);
+  CHECK(report[0].after.atvr < 1.6);
+
+  // Same set of triangles(as positions), sequential vertex fetch.
+  const tinygltf::Primitive &out = model.meshes[0].primitives[0];
+  CHECK(model.accessors[size_t(out.indices)].componentType ==
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+  std::vector<uint32_t> optimized;
+  REQUIRE(tinygltf::GetTriangleIndices(model, out, &optimized, &err));
+  REQUIRE(optimized.size() == tris.size());
+  tinygltf::AccessorView<std::array<float, 3>> pos(
+      model, out.attributes.at("POSITION"), &err);
+  REQUIRE(pos.size() == kRow * kRow);
+  std::set<std::array<float, 9>> expected_set, optimized_set;
+  uint32_t max_seen = 0;
+  for (size_t t = 0; t < num_tris; t++) {
+    std::array<float, 9> a, b;
+    for (size_t k = 0; k < 3; k++) {
+      const uint32_t v = optimized[3 * t + k];
+      CHECK(v <= max_seen + 1);
+      max_seen = (std::max)(max_seen, v);
+      for (size_t c = 0; c < 3; c++) {
+        a[3 * k + c] = positions[3 * tris[3 * t + k] + c];
+        b[3 * k + c] = pos[v][c];
+      }
+    }
+    expected_set.insert(a);
+    optimized_set.insert(b);
+  }
+  CHECK(expected_set == optimized_set);
+
+  // Out of range indices are rejected before they are used.
+  std::vector<uint32_t> bad = {0, 1, 2, 2, 1, 9};
+  std::vector<uint32_t> dst(bad.size());
+  std::vector<uint32_t> new_to_old;
+  err.clear();
+  CHECK_FALSE(tinygltf::OptimizeVertexCache(bad.data(), bad.size(), 9,
+                                            dst.data(), 32, &err));
+  CHECK(err.find("out of range") != std::string::npos);
+  CHECK_FALSE(tinygltf::OptimizeVertexFetch(bad.data(), bad.size(), 9,
+                                            &new_to_old, &err));
+  CHECK(bad[5] == 9);
+  REQUIRE(tinygltf::OptimizeVertexFetch(bad.data(), bad.size(), 10,
+                                        &new_to_old, &err));
+  CHECK(new_to_old == std::vector<uint32_t>({0, 1, 2, 9}));
+  CHECK(bad[5] == 3);
+}
+
+TEST_CASE("build-meshlets", "[meshlet]") {
+  // 16x16 grid of quads in the z = 0 plane, facing +z.
+  const uint32_t kGrid = 16;
+  const uint32_t kRow = kGrid + 1;
+  std::vector<float> positions;
+  for (uint32_t y = 0; y < kRow; y++) {
+    for (uint32_t x = 0; x < kRow; x++) {
+      positions.push_back(float(x));
+      positions.push_back(float(y));
+      positions.push_back(0.0f);
+    }
+  }
+  std::vector<uint32_t> tris;
+  for (uint32_t y = 0; y < kGrid; y++) {
+    for (uint32_t x = 0; x < kGrid; x++) {
+      const uint32_t v = y * kRow + x;
+      const uint32_t quad[] = {v, v + 1, v + kRow, v + kRow, v + 1, v + kRow + 1};
+      tris.insert(tris.end(), quad, quad + 6);
+    }
+  }
+
+  std::string err;
+  tinygltf::MeshletOptions options;
+  tinygltf::Meshlets meshlets;
+  REQUIRE(tinygltf::BuildMeshlets(tris.data(), tris.size(), positions.data(),
+                                  kRow * kRow, 3, options, &meshlets, &err));
+  REQUIRE(meshlets.meshlets.size() >= 5);
+  size_t triangle_index = 0;
+  for (const tinygltf::Meshlet &m : meshlets.meshlets) {
+    CHECK(m.vertex_count <= 64);
+    CHECK(m.triangle_count <= 124);
+    for (uint32_t t = 0; t < m.triangle_count; t++, triangle_index++) {
+      for (uint32_t k = 0; k < 3; k++) {
+        const uint8_t local = meshlets.triangles[m.triangle_offset + 3 * t + k];
+        REQUIRE(local < m.vertex_count);
+        CHECK(meshlets.vertices[m.vertex_offset + local] ==
+              tris[3 * triangle_index + k]);
+      }
+    }
+    for (uint32_t i = 0; i < m.vertex_count; i++) {
+      const float *p = &positions[3 * meshlets.vertices[m.vertex_offset + i]];
+      const float dx = p[0] - m.center[0], dy = p[1] - m.center[1],
+                  dz = p[2] - m.center[2];
+      CHECK(std::sqrt(dx * dx + dy * dy + dz * dz) <= m.radius * 1.0001f);
+    }
+    // Flat meshlet: a cone of zero angle around +z.
+    CHECK(m.cone_axis[2] == Approx(1.0f));
+    CHECK(m.cone_cutoff < 1e-3f);
+  }
+  CHECK(triangle_index == tris.size() / 3);
+
+  options.max_vertices = 300;
+  CHECK_FALSE(tinygltf::BuildMeshlets(tris.data(), tris.size(),
+                                      positions.data(), kRow * kRow, 3,
+                                      options, &meshlets, &err));
+  err.clear();
+  options.max_vertices = 64;
+
+  // Through the model, stored in an extension and written/loaded back.
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  buffer.data.resize(positions.size() * 4 + tris.size() * 4);
+  std::memcpy(buffer.data.data(), positions.data(), positions.size() * 4);
+  std::memcpy(buffer.data.data() + positions.size() * 4, tris.data(),
+              tris.size() * 4);
+  model.buffers.push_back(buffer);
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = positions.size() * 4;
+  model.bufferViews.push_back(view);
+  view.byteOffset = positions.size() * 4;
+  view.byteLength = tris.size() * 4;
+  model.bufferViews.push_back(view);
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = positions.size() / 3;
+  accessor.minValues = {0, 0, 0};
+  accessor.maxValues = {double(kGrid), double(kGrid), 0};
+  model.accessors.push_back(accessor);
+  accessor.bufferView = 1;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  accessor.type = TINYGLTF_TYPE_SCALAR;
+  accessor.count = tris.size();
+  accessor.minValues.clear();
+  accessor.maxValues.clear();
+  model.accessors.push_back(accessor);
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.indices = 1;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+  model.asset.version = "2.0";
+
+  options.store_in_model = true;
+  std::vector<tinygltf::PrimitiveMeshlets> generated;
+  REQUIRE(tinygltf::GenerateMeshlets(&model, options, &generated, &err));
+  REQUIRE(generated.size() == 1);
+  CHECK(generated[0].meshlets.meshlets.size() == meshlets.meshlets.size());
+  CHECK(model.extensionsUsed.size() == 1);
+
+  // Compaction keeps the meshlet bufferViews.
+  REQUIRE(tinygltf::CompactBuffers(&model, &err));
+
+  std::stringstream os;
+  tinygltf::TinyGLTF ctx;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, os, false, false));
+  tinygltf::Model loaded;
+  std::string warn;
+  const std::string json = os.str();
+  REQUIRE(ctx.LoadASCIIFromString(&loaded, &err, &warn, json.c_str(),
+                                  static_cast<unsigned int>(json.size()), ""));
+
+  tinygltf::Meshlets stored;
+  REQUIRE(tinygltf::GetStoredMeshlets(loaded, loaded.meshes[0].primitives[0],
+                                      &stored, &err));
+  REQUIRE(stored.meshlets.size() == meshlets.meshlets.size());
+  CHECK(stored.vertices == meshlets.vertices);
+  CHECK(stored.triangles == meshlets.triangles);
+  for (size_t i = 0; i < stored.meshlets.size(); i++) {
+    CHECK(stored.meshlets[i].triangle_offset ==
+          meshlets.meshlets[i].triangle_offset);
+    CHECK(stored.meshlets[i].radius == meshlets.meshlets[i].radius);
+    CHECK(stored.meshlets[i].cone_axis[2] == meshlets.meshlets[i].cone_axis[2]);
+  }
+
+  CHECK_FALSE(tinygltf::GetStoredMeshlets(loaded, tinygltf::Primitive(),
+                                          &stored, &err));
+}
+
+TEST_CASE("apply-vertex-layout", "[mesh]") {
+  // Two primitives sharing planar POSITION/NORMAL/TEXCOORD_0 accessors, one
+  // with a sparse morph target.
+  const size_t count = 5;
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  buffer.data.resize(count * (12 + 12 + 8) + 16 + 3 * 2);
+  float *pos = reinterpret_cast<float *>(buffer.data.data());
+  float *nrm = pos + count * 3;
+  float *uv = nrm + count * 3;
+  for (size_t i = 0; i < count; i++) {
+    pos[3 * i + 0] = float(i);
+    pos[3 * i + 1] = float(i) * 2.0f;
+    pos[3 * i + 2] = float(i) * 3.0f;
+    nrm[3 * i + 0] = 0.0f;
+    nrm[3 * i + 1] = 0.0f;
+    nrm[3 * i + 2] = 1.0f;
+    uv[2 * i + 0] = float(i) * 0.25f;
+    uv[2 * i + 1] = 1.0f;
+  }
+  // sparse: index 3 -> (7, 8, 9)
+  const size_t sparse_offset = count * 32;
+  const uint32_t sparse_index = 3;
+  const float sparse_value[3] = {7.0f, 8.0f, 9.0f};
+  std::memcpy(buffer.data.data() + sparse_offset, &sparse_index, 4);
+  std::memcpy(buffer.data.data() + sparse_offset + 4, sparse_value, 12);
+  const uint16_t indices[3] = {0, 2, 4};
+  std::memcpy(buffer.data.data() + sparse_offset + 16, indices, 6);
+  model.buffers.push_back(buffer);
+
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = count * 32 + 16 + 6;
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = count;
+  model.accessors.push_back(accessor);  // 0: POSITION
+  accessor.byteOffset = count * 12;
+  model.accessors.push_back(accessor);  // 1: NORMAL
+  accessor.byteOffset = count * 24;
+  accessor.type = TINYGLTF_TYPE_VEC2;
+  model.accessors.push_back(accessor);  // 2: TEXCOORD_0
+  accessor.bufferView = -1;
+  accessor.byteOffset = 0;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.sparse.isSparse = true;
+  accessor.sparse.count = 1;
+  accessor.sparse.indices.bufferView = 0;
+  accessor.sparse.indices.byteOffset = sparse_offset;
+  accessor.sparse.indices.componentType =
+      TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+  accessor.sparse.values.bufferView = 0;
+  accessor.sparse.values.byteOffset = sparse_offset + 4;
+  model.accessors.push_back(accessor);  // 3: morph target
+  accessor = tinygltf::Accessor();
+  accessor.bufferView = 0;
+  accessor.byteOffset = sparse_offset + 16;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  accessor.type = TINYGLTF_TYPE_SCALAR;
+  accessor.count = 3;
+  model.accessors.push_back(accessor);  // 4: indices
+
+  tinygltf::Mesh mesh;
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.attributes["NORMAL"] = 1;
+  primitive.attributes["TEXCOORD_0"] = 2;
+  primitive.indices = 4;
+  mesh.primitives.push_back(primitive);
+  primitive.targets.push_back({{"POSITION", 3}});
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+
+  std::string err;
+  tinygltf::VertexLayoutOptions options;
+  options.streams = {{"POSITION"}};
+  options.alignment = 16;
+  options.num_threads = 2;
+  REQUIRE(tinygltf::ApplyVertexLayout(&model, options, &err));
+  CHECK(err.empty());
+
+  // One buffer for the mesh, 16 byte aligned bufferViews.
+  REQUIRE(model.buffers.size() == 1);
+  for (const tinygltf::BufferView &v : model.bufferViews) {
+    CHECK(v.buffer == 0);
+    CHECK(v.byteOffset % 16 == 0);
+  }
+
+  for (size_t p = 0; p < 2; p++) {
+    const tinygltf::Primitive &prim = model.meshes[0].primitives[p];
+    const tinygltf::Accessor &a_pos =
+        model.accessors[size_t(prim.attributes.at("POSITION"))];
+    const tinygltf::Accessor &a_nrm =
+        model.accessors[size_t(prim.attributes.at("NORMAL"))];
+    const tinygltf::Accessor &a_uv =
+        model.accessors[size_t(prim.attributes.at("TEXCOORD_0"))];
+    CHECK(a_pos.bufferView != a_nrm.bufferView);
+    CHECK(a_nrm.bufferView == a_uv.bufferView);  // interleaved
+    CHECK(model.bufferViews[size_t(a_nrm.bufferView)].byteStride == 20);
+    CHECK(model.bufferViews[size_t(a_pos.bufferView)].byteStride == 0);
+    CHECK(a_nrm.byteOffset == 0);
+    CHECK(a_uv.byteOffset == 12);
+
+    tinygltf::AccessorView<std::array<float, 2>> uvs(
+        model, prim.attributes.at("TEXCOORD_0"), &err);
+    REQUIRE(uvs.size() == count);
+    CHECK(uvs[3][0] == 0.75f);
+    tinygltf::AccessorView<std::array<float, 3>> normals(
+        model, prim.attributes.at("NORMAL"), &err);
+    CHECK(normals[4][2] == 1.0f);
+    tinygltf::AccessorView<uint16_t> idx(model, prim.indices, &err);
+    REQUIRE(idx.size() == 3);
+    CHECK(idx[2] == 4);
+  }
+
+  const tinygltf::Primitive &morphed = model.meshes[0].primitives[1];
+  const tinygltf::Accessor &target =
+      model.accessors[size_t(morphed.targets[0].at("POSITION"))];
+  CHECK_FALSE(target.sparse.isSparse);
+  tinygltf::AccessorView<std::array<float, 3>> delta(
+      model, morphed.targets[0].at("POSITION"), &err);
+  REQUIRE(delta.valid());
+  CHECK(delta[3][1] == 8.0f);
+  CHECK(delta[2][1] == 0.0f);
+
+  options.alignment = 6;
+  CHECK_FALSE(tinygltf::ApplyVertexLayout(&model, options, &err));
+}
+
+TEST_CASE("quantize-meshes", "[quantization]") {
+  const size_t count = 100;
+  std::vector<float> data;
+  for (size_t i = 0; i < count; i++) {  // POSITION in [-1, 3]
+    data.push_back(-1.0f + 4.0f * float(i) / float(count - 1));
+    data.push_back(float(i % 7) * 0.25f);
+    data.push_back(0.5f);
+  }
+  for (size_t i = 0; i < count; i++) {  // NORMAL
+    const float a = float(i) * 0.1f;
+    data.push_back(std::cos(a));
+    data.push_back(std::sin(a));
+    data.push_back(0.0f);
+  }
+  for (size_t i = 0; i < count; i++) {  // TEXCOORD_0 in [0, 1]
+    data.push_back(float(i) / float(count - 1));
+    data.push_back(1.0f - float(i) / float(count - 1));
+  }
+  for (size_t i = 0; i < count; i++) {  // TEXCOORD_1 out of [0, 1]
+    data.push_back(float(i));
+    data.push_back(0.0f);
+  }
+
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  buffer.data.resize(data.size() * 4);
+  std::memcpy(buffer.data.data(), data.data(), buffer.data.size());
+  model.buffers.push_back(buffer);
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = buffer.data.size();
+  model.bufferViews.push_back(view);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.count = count;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.minValues = {-1, 0, 0.5};
+  accessor.maxValues = {3, 1.5, 0.5};
+  model.accessors.push_back(accessor);
+  accessor.minValues.clear();
+  accessor.maxValues.clear();
+  accessor.byteOffset = count * 12;
+  model.accessors.push_back(accessor);
+  accessor.type = TINYGLTF_TYPE_VEC2;
+  accessor.byteOffset = count * 24;
+  model.accessors.push_back(accessor);
+  accessor.byteOffset = count * 32;
+  model.accessors.push_back(accessor);
+
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.attributes["NORMAL"] = 1;
+  primitive.attributes["TEXCOORD_0"] = 2;
+  primitive.attributes["TEXCOORD_1"] = 3;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);  // 0: quantized
+  model.meshes.push_back(mesh);  // 1: skinned, skipped
+
+  // node 0: TRS, rotated 90 degrees around z(x, y, z) -> (-y, x, z).
+  tinygltf::Node node;
+  node.mesh = 0;
+  node.translation = {10.0, 20.0, 30.0};
+  node.rotation = {0.0, 0.0, std::sqrt(0.5), std::sqrt(0.5)};
+  node.scale = {2.0, 2.0, 2.0};
+  model.nodes.push_back(node);
+  // node 1: has a child, gets a new child node for the dequantization.
+  node = tinygltf::Node();
+  node.mesh = 0;
+  node.children.push_back(2);
+  model.nodes.push_back(node);
+  node = tinygltf::Node();
+  node.mesh = 1;
+  node.skin = 0;
+  model.nodes.push_back(node);
+
+  std::string err;
+  tinygltf::QuantizationOptions options;
+  options.num_threads = 2;
+  tinygltf::QuantizationReport report;
+  REQUIRE(tinygltf::QuantizeMeshes(&model, options, &err, &report));
+  CHECK(err.empty());
+  CHECK(report.meshes == 1);
+  CHECK(report.skipped_meshes == 1);
+  // 12 + 12 + 8 -> 8 + 4 + 4 bytes per vertex
+  CHECK(report.bytes_before == count * 32);
+  CHECK(report.bytes_after == count * 16);
+  CHECK(report.compression_ratio == Approx(2.0));
+  CHECK(report.max_position_error <= 0.5 * 4.0 / 16383.0 + 1e-6);
+  CHECK(report.max_position_error > 0.0);
+  CHECK(report.max_normal_error <= 0.5 / 127.0 + 1e-6);
+  CHECK(report.max_texcoord_error <= 0.5 / 65535.0 + 1e-6);
+  CHECK(model.extensionsUsed.size() == 1);
+  REQUIRE(model.extensionsRequired.size() == 1);
+  CHECK(model.extensionsRequired[0] == "KHR_mesh_quantization");
+
+  const tinygltf::Primitive &q = model.meshes[0].primitives[0];
+  const tinygltf::Accessor &pos = model.accessors[size_t(q.attributes.at("POSITION"))];
+  CHECK(pos.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+  CHECK_FALSE(pos.normalized);
+  CHECK(pos.maxValues[0] == 16383.0);
+  const tinygltf::Accessor &nrm = model.accessors[size_t(q.attributes.at("NORMAL"))];
+  CHECK(nrm.componentType == TINYGLTF_COMPONENT_TYPE_BYTE);
+  CHECK(nrm.normalized);
+  CHECK(model.bufferViews[size_t(nrm.bufferView)].byteStride == 4);
+  CHECK(model.accessors[size_t(q.attributes.at("TEXCOORD_0"))].componentType ==
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+  CHECK(model.accessors[size_t(q.attributes.at("TEXCOORD_1"))].componentType ==
+        TINYGLTF_COMPONENT_TYPE_FLOAT);
+  // The skinned mesh keeps float positions.
+  CHECK(model.accessors[size_t(
+                            model.meshes[1].primitives[0].attributes.at("POSITION"))]
+            .componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
+
+  // World positions through node 0 are preserved.
+  tinygltf::AccessorView<std::array<uint16_t, 3>> qpos(
+      model, q.attributes.at("POSITION"), &err);
+  REQUIRE(qpos.size() == count);
+  const tinygltf::Node &n0 = model.nodes[0];
+  for (size_t i = 0; i < count; i += 9) {
+    const float *p = &data[3 * i];
+    const double expected[3] = {10.0 - 2.0 * p[1], 20.0 + 2.0 * p[0],
+                                30.0 + 2.0 * p[2]};
+    const double local[3] = {n0.scale[0] * qpos[i][0], n0.scale[1] * qpos[i][1],
+                             n0.scale[2] * qpos[i][2]};
+    const double world[3] = {n0.translation[0] - local[1],
+                              n0.translation[1] + local[0],
+                              n0.translation[2] + local[2]};
+    for (int c = 0; c < 3; c++) {
+      CHECK(std::fabs(world[c] - expected[c]) <= 2.0 * 4.0 / 16383.0);
+    }
+  }
+
+  // Node 1 moved its mesh into a new child node.
+  CHECK(model.nodes[1].mesh == -1);
+  REQUIRE(model.nodes[1].children.size() == 2);
+  const tinygltf::Node &child = model.nodes[size_t(model.nodes[1].children[1])];
+  CHECK(child.mesh == 0);
+  CHECK(child.translation[0] == Approx(-1.0));
+  CHECK(child.scale[0] == Approx(4.0 / 16383.0));
+
+  options.normal_bits = 12;
+  CHECK_FALSE(tinygltf::QuantizeMeshes(&model, options, &err));
+}
+
+TEST_CASE("meshopt-decode", "[meshopt]") {
+  // ATTRIBUTES, stride 4: literal, 2 bit, zero and 4 bit(escaped) groups.
+  const unsigned char vertex_stream[] = {
+      0xa0, 0x03, 10, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0x01, 0x80, 0, 0, 0, 0x00, 0x02, 0xff, 0, 0, 0, 0, 0, 0, 0, 111, 112,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned char expected_vertices[] = {5, 1, 0, 200, 3, 1, 0, 0};
+  unsigned char vertices[8];
+  REQUIRE(tinygltf::DecodeMeshoptVertexBuffer(vertices, 2, 4, vertex_stream,
+                                              sizeof(vertex_stream)));
+  CHECK(std::equal(vertices, vertices + 8, expected_vertices));
+  CHECK_FALSE(tinygltf::DecodeMeshoptVertexBuffer(
+      vertices, 2, 4, vertex_stream, sizeof(vertex_stream) - 1));
+
+  // TRIANGLES: codeaux table, edge fifo reuse and a free index.
+  const unsigned char triangle_stream[] = {
+      0xe1, 0xf0, 0x10, 0x1f, 0xc8, 0x01, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  uint32_t triangles[9];
+  REQUIRE(tinygltf::DecodeMeshoptIndexBuffer(
+      reinterpret_cast<unsigned char *>(triangles), 9, 4, triangle_stream,
+      sizeof(triangle_stream)));
+  const uint32_t expected_triangles[] = {0, 1, 2, 2, 1, 3, 3, 1, 100};
+  CHECK(std::equal(triangles, triangles + 9, expected_triangles));
+
+  // INDICES: two baselines and a multi byte varint.
+  const unsigned char sequence_stream[] = {0xd1, 0x00, 0x04, 0x04, 0x20, 0x15,
+                                           0x88, 0x09, 0, 0, 0, 0};
+  uint16_t sequence[6];
+  REQUIRE(tinygltf::DecodeMeshoptIndexSequence(
+      reinterpret_cast<unsigned char *>(sequence), 6, 2, sequence_stream,
+      sizeof(sequence_stream)));
+  const uint16_t expected_sequence[] = {0, 1, 2, 10, 5, 300};
+  CHECK(std::equal(sequence, sequence + 6, expected_sequence));
+
+  // EXPONENTIAL: 4 SIMD lanes and a scalar tail.
+  uint32_t exp[5] = {0xff000003u, 0x02fffffbu, 0x00000001u, 0x00000000u,
+                     0xfe000006u};
+  REQUIRE(tinygltf::ApplyMeshoptFilter(reinterpret_cast<unsigned char *>(exp),
+                                       1, 20, "EXPONENTIAL"));
+  float expf[5];
+  memcpy(expf, exp, sizeof(expf));
+  CHECK(expf[0] == 1.5f);
+  CHECK(expf[1] == -20.0f);
+  CHECK(expf[2] == 1.0f);
+  CHECK(expf[3] == 0.0f);
+  CHECK(expf[4] == 1.5f);
+
+  // OCTAHEDRAL(8 bit): results are unit length and the 4th byte is kept.
+  int8_t oct[5 * 4] = {0,   0,   127, 7,  127, 0, 127, -1, -64, 0,
+                       127, 1,   0,   64, 127, 2, -30, -90, 127, 3};
+  REQUIRE(tinygltf::ApplyMeshoptFilter(reinterpret_cast<unsigned char *>(oct),
+                                       5, 4, "OCTAHEDRAL"));
+  CHECK(oct[0] == 0);
+  CHECK(oct[2] == 127);
+  CHECK(oct[3] == 7);
+  CHECK(oct[4] == 127);
+  CHECK(oct[6] == 0);
+  CHECK(oct[8] < 0);
+  for (int i = 0; i < 5; i++) {
+    const float l = std::sqrt(float(oct[i * 4] * oct[i * 4]) +
+                              float(oct[i * 4 + 1] * oct[i * 4 + 1]) +
+                              float(oct[i * 4 + 2] * oct[i * 4 + 2]));
+    CHECK(std::fabs(l - 127.0f) < 2.0f);
+  }
+
+  // QUATERNION: the 2 low bits of the 4th component select the largest one.
+  int16_t quat[2 * 4] = {0, 0, 0, 0x7fff, 0, 0, 0, 0x7ffc};
+  REQUIRE(tinygltf::ApplyMeshoptFilter(reinterpret_cast<unsigned char *>(quat),
+                                       2, 8, "QUATERNION"));
+  const int16_t expected_quat[] = {0, 0, 0, 32767, 32767, 0, 0, 0};
+  CHECK(std::equal(quat, quat + 8, expected_quat));
+  CHECK_FALSE(tinygltf::ApplyMeshoptFilter(
+      reinterpret_cast<unsigned char *>(quat), 2, 4, "QUATERNION"));
+
+  // Decoded while loading, into the fallback buffer.
+  const std::string gltf = R"({
+    "asset": {"version": "2.0"},
+    "extensionsUsed": ["EXT_meshopt_compression"],
+    "buffers": [
+      {"byteLength": 67, "uri": "data:application/octet-stream;base64,oAMKAwAAAAAAAAAAAAAAAAAAAYAAAAAAAv8AAAAAAAAAb3AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=="},
+      {"byteLength": 8, "extensions": {"EXT_meshopt_compression": {"fallback": true}}}
+    ],
+    "bufferViews": [
+      {"buffer": 1, "byteLength": 8, "byteStride": 4,
+       "extensions": {"EXT_meshopt_compression": {
+         "buffer": 0, "byteLength": 67, "byteStride": 4, "count": 2,
+         "mode": "ATTRIBUTES"}}}
+    ],
+    "accessors": [
+      {"bufferView": 0, "componentType": 5121, "count": 2, "type": "VEC4"}
+    ]
+  })";
+  tinygltf::Model model;
+  tinygltf::TinyGLTF ctx;
+  std::string err, warn;
+  REQUIRE(ctx.LoadASCIIFromString(&model, &err, &warn, gltf.c_str(),
+                                  static_cast<unsigned int>(gltf.size()), ""));
+  REQUIRE(model.buffers[1].data.size() == 8);
+  CHECK(std::equal(model.buffers[1].data.begin(), model.buffers[1].data.end(),
+                   expected_vertices));
+}
+
+TEST_CASE("meshopt-encode", "[meshopt]") {
+  // Bitstreams round trip exactly.
+  std::vector<unsigned char> vertices(1000 * 12);
+  for (size_t i = 0; i < vertices.size(); i++) {
+    vertices[i] = static_cast<unsigned char>((i % 12) < 6 ? i / 12 : i * 37);
+  }
+  std::vector<unsigned char> stream;
+  REQUIRE(tinygltf::EncodeMeshoptVertexBuffer(&stream, vertices.data(), 1000,
+                                              12));
+  std::vector<unsigned char> decoded(vertices.size());
+  REQUIRE(tinygltf::DecodeMeshoptVertexBuffer(decoded.data(), 1000, 12,
+                                              stream.data(), stream.size()));
+  CHECK(decoded == vertices);
+
+  // 16x16 grid, plus a few unrelated triangles.
+  const uint16_t kRow = 17;
+  std::vector<uint16_t> tris;
+  for (uint16_t y = 0; y < 16; y++) {
+    for (uint16_t x = 0; x < 16; x++) {
+      const uint16_t v = uint16_t(y * kRow + x);
+      const uint16_t quad[] = {v, uint16_t(v + 1), uint16_t(v + kRow),
+                               uint16_t(v + kRow), uint16_t(v + 1),
+                               uint16_t(v + kRow + 1)};
+      tris.insert(tris.end(), quad, quad + 6);
+    }
+  }
+  const uint16_t extra[] = {5, 5, 5, 1000, 2, 999, 0, 65535, 7};
+  tris.insert(tris.end(), extra, extra + 9);
+  for (int mode = 0; mode < 2; mode++) {
+    stream.clear();
+    const unsigned char *src =
+        reinterpret_cast<const unsigned char *>(tris.data());
+    std::vector<uint16_t> indices(tris.size());
+    unsigned char *dst = reinterpret_cast<unsigned char *>(indices.data());
+    if (mode == 0) {
+      REQUIRE(tinygltf::EncodeMeshoptIndexBuffer(&stream, src, tris.size(),
+                                                 2));
+      // much smaller than the raw indices
+      CHECK(stream.size() * 3 < tris.size() * 2);
+      REQUIRE(tinygltf::DecodeMeshoptIndexBuffer(dst, tris.size(), 2,
+                                                 stream.data(), stream.size()));
+      // triangles may be rotated
+      for (size_t t = 0; t < tris.size(); t += 3) {
+        int r = 0;
+        while (r < 3 && indices[t] != tris[t + size_t(r)]) {
+          r++;
+        }
+        REQUIRE(r < 3);
+        for (size_t k = 0; k < 3; k++) {
+          CHECK(indices[t + k] == tris[t + (size_t(r) + k) % 3]);
+        }
+      }
+      continue;
+    } else {
+      REQUIRE(tinygltf::EncodeMeshoptIndexSequence(&stream, src, tris.size(),
+                                                   2));
+      REQUIRE(tinygltf::DecodeMeshoptIndexSequence(
+          dst, tris.size(), 2, stream.data(), stream.size()));
+    }
+    CHECK(indices == tris);
+  }
+
+  // Filters: encode then decode approximates the input.
+  int16_t quat[4] = {0, 0, -23170, 23170};  // 90 degrees around -z
+  REQUIRE(tinygltf::EncodeMeshoptFilter(reinterpret_cast<unsigned char *>(quat),
+                                        1, 8, "QUATERNION"));
+  REQUIRE(tinygltf::ApplyMeshoptFilter(reinterpret_cast<unsigned char *>(quat),
+                                       1, 8, "QUATERNION"));
+  // q and -q are the same rotation
+  const int sign = quat[3] < 0 ? -1 : 1;
+  CHECK(std::abs(quat[0]) <= 1);
+  CHECK(std::abs(quat[1]) <= 1);
+  CHECK(std::abs(sign * quat[2] + 23170) <= 2);
+  CHECK(std::abs(sign * quat[3] - 23170) <= 2);
+
+  int8_t oct[8] = {0, -127, 0, 0, 73, 73, -73, 127};
+  REQUIRE(tinygltf::EncodeMeshoptFilter(reinterpret_cast<unsigned char *>(oct),
+                                        2, 4, "OCTAHEDRAL"));
+  REQUIRE(tinygltf::ApplyMeshoptFilter(reinterpret_cast<unsigned char *>(oct),
+                                       2, 4, "OCTAHEDRAL"));
+  const int8_t expected_oct[8] = {0, -127, 0, 0, 73, 73, -73, 127};
+  for (int i = 0; i < 8; i++) {
+    CHECK(std::abs(oct[i] - expected_oct[i]) <= 2);
+  }
+
+  float floats[3] = {3.25f, -1e-6f, 12345.678f};
+  REQUIRE(tinygltf::EncodeMeshoptFilter(
+      reinterpret_cast<unsigned char *>(floats), 1, 12, "EXPONENTIAL", 16));
+  REQUIRE(tinygltf::ApplyMeshoptFilter(
+      reinterpret_cast<unsigned char *>(floats), 1, 12, "EXPONENTIAL"));
+  CHECK(floats[0] == 3.25f);
+  CHECK(std::fabs(floats[1] + 1e-6f) < 1e-10f);
+  CHECK(std::fabs(floats[2] - 12345.678f) < 0.5f);
+
+  // Through the writer: positions, octahedral normals and indices.
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  std::vector<float> positions;
+  std::vector<int8_t> normals;
+  for (uint16_t y = 0; y < kRow; y++) {
+    for (uint16_t x = 0; x < kRow; x++) {
+      const float p[] = {float(x), float(y), 0.1f * float(x * y)};
+      positions.insert(positions.end(), p, p + 3);
+      const int8_t n[] = {int8_t(x - 8), int8_t(y - 8), 120, 0};
+      normals.insert(normals.end(), n, n + 4);
+    }
+  }
+  tris.resize(16 * 16 * 6);
+  const size_t positions_size = positions.size() * 4;
+  const size_t normals_size = normals.size();
+  buffer.data.resize(positions_size + normals_size + tris.size() * 2);
+  std::memcpy(buffer.data.data(), positions.data(), positions_size);
+  std::memcpy(buffer.data.data() + positions_size, normals.data(),
+              normals_size);
+  std::memcpy(buffer.data.data() + positions_size + normals_size, tris.data(),
+              tris.size() * 2);
+  model.buffers.push_back(buffer);
+  const size_t offsets[] = {0, positions_size, positions_size + normals_size};
+  const size_t lengths[] = {positions_size, normals_size, tris.size() * 2};
+  const int types[] = {TINYGLTF_TYPE_VEC3, TINYGLTF_TYPE_VEC4,
+                       TINYGLTF_TYPE_SCALAR};
+  const int component_types[] = {TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                  TINYGLTF_COMPONENT_TYPE_BYTE,
+                                  TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT};
+  for (int i = 0; i < 3; i++) {
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = offsets[i];
+    view.byteLength = lengths[i];
+    model.bufferViews.push_back(view);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = i;
+    accessor.componentType = component_types[i];
+    accessor.type = types[i];
+    accessor.normalized = i == 1;
+    accessor.count = i == 2 ? tris.size() : size_t(kRow * kRow);
+    model.accessors.push_back(accessor);
+  }
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.attributes["NORMAL"] = 1;
+  primitive.indices = 2;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+  model.asset.version = "2.0";
+
+  tinygltf::MeshoptEncodeOptions options;
+  options.octahedral_filter = true;
+  for (int keep_fallback = 0; keep_fallback < 2; keep_fallback++) {
+    options.keep_fallback = keep_fallback != 0;
+    tinygltf::Model encoded = model;
+    tinygltf::MeshoptEncodeReport report;
+    std::string err;
+    REQUIRE(tinygltf::EncodeMeshoptCompression(&encoded, options, &err,
+                                               &report));
+    CHECK(report.views == 3);
+    CHECK(report.compression_ratio > 2.0);
+    CHECK(encoded.extensionsUsed.size() == 1);
+    CHECK(encoded.extensionsRequired.size() == (keep_fallback ? 0u : 1u));
+    const tinygltf::Value &ext =
+        encoded.bufferViews[1].extensions["EXT_meshopt_compression"];
+    CHECK(ext.Get("filter").Get<std::string>() == "OCTAHEDRAL");
+    CHECK(encoded.bufferViews[2]
+              .extensions["EXT_meshopt_compression"]
+              .Get("mode")
+              .Get<std::string>() == "TRIANGLES");
+
+    // Written by TinyGLTF with the same options, loaded and decoded back.
+    tinygltf::TinyGLTF ctx;
+    ctx.SetMeshoptCompression(true, options);
+    std::stringstream os;
+    REQUIRE(ctx.WriteGltfSceneToStream(&model, os, false, false));
+    const std::string json = os.str();
+    CHECK((json.find("\"fallback\":true") != std::string::npos) ==
+          !keep_fallback);
+
+    tinygltf::Model loaded;
+    std::string warn;
+    REQUIRE(ctx.LoadASCIIFromString(&loaded, &err, &warn, json.c_str(),
+                                    static_cast<unsigned int>(json.size()),
+                                    ""));
+    for (int i = 0; i < 3; i++) {
+      const tinygltf::BufferView &a = encoded.bufferViews[size_t(i)];
+      const tinygltf::BufferView &b = loaded.bufferViews[size_t(i)];
+      REQUIRE(a.byteLength == b.byteLength);
+      const unsigned char *pa =
+          encoded.buffers[size_t(a.buffer)].data.data() + a.byteOffset;
+      const unsigned char *pb =
+          loaded.buffers[size_t(b.buffer)].data.data() + b.byteOffset;
+      CHECK(std::equal(pa, pa + a.byteLength, pb));
+    }
+    // positions and indices are lossless
+    CHECK(std::memcmp(loaded.buffers[size_t(loaded.bufferViews[0].buffer)]
+                              .data.data() +
+                          loaded.bufferViews[0].byteOffset,
+                      positions.data(), positions_size) == 0);
+  }
+
+  // A bufferView referenced only from an extension survives writing.
+  const unsigned char metadata[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  model.buffers[0].data.insert(model.buffers[0].data.end(), metadata,
+                               metadata + 8);
+  tinygltf::BufferView metadata_view;
+  metadata_view.buffer = 0;
+  metadata_view.byteOffset = model.buffers[0].data.size() - 8;
+  metadata_view.byteLength = 8;
+  model.bufferViews.push_back(metadata_view);
+  model.extensionsUsed.push_back("EXT_structural_metadata");
+  tinygltf::TinyGLTF ctx;
+  ctx.SetMeshoptCompression(true, options);
+  std::stringstream os;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, os, false, false));
+  const std::string json = os.str();
+  tinygltf::Model loaded;
+  std::string err, warn;
+  REQUIRE(ctx.LoadASCIIFromString(&loaded, &err, &warn, json.c_str(),
+                                  static_cast<unsigned int>(json.size()), ""));
+  REQUIRE(loaded.bufferViews.size() == 4);
+  const tinygltf::BufferView &view = loaded.bufferViews[3];
+  REQUIRE(view.byteLength == 8);
+  const unsigned char *data =
+      loaded.buffers[size_t(view.buffer)].data.data() + view.byteOffset;
+  CHECK(std::equal(data, data + 8, metadata));
+
+  // Image pixels are written from the model passed to the writer.
+  tinygltf::Image image;
+  image.width = 2;
+  image.height = 1;
+  image.component = 4;
+  image.bits = 8;
+  image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  image.mimeType = "image/png";
+  const unsigned char pixels[8] = {255, 0, 0, 255, 0, 0, 255, 255};
+  image.image.assign(pixels, pixels + 8);
+  model.images.push_back(image);
+  std::stringstream image_os;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, image_os, false, false));
+  const std::string image_json = image_os.str();
+  tinygltf::Model image_loaded;
+  REQUIRE(ctx.LoadASCIIFromString(
+      &image_loaded, &err, &warn, image_json.c_str(),
+      static_cast<unsigned int>(image_json.size()), ""));
+  REQUIRE(image_loaded.images.size() == 1);
+  CHECK(image_loaded.images[0].image == image.image);
+}
+
+#ifdef TINYGLTF_ENABLE_DRACO
+TEST_CASE("draco-round-trip", "[draco]") {
+  // 8x8 grid: written with KHR_draco_mesh_compression, then loaded back.
+  const uint16_t kRow = 9;
+  std::vector<float> positions;
+  for (uint16_t y = 0; y < kRow; y++) {
+    for (uint16_t x = 0; x < kRow; x++) {
+      const float p[] = {float(x), float(y), 0.25f * float(x + y)};
+      positions.insert(positions.end(), p, p + 3);
+    }
+  }
+  std::vector<uint16_t> tris;
+  for (uint16_t y = 0; y + 1 < kRow; y++) {
+    for (uint16_t x = 0; x + 1 < kRow; x++) {
+      const uint16_t v = uint16_t(y * kRow + x);
+      const uint16_t quad[] = {v, uint16_t(v + 1), uint16_t(v + kRow),
+                               uint16_t(v + kRow), uint16_t(v + 1),
+                               uint16_t(v + kRow + 1)};
+      tris.insert(tris.end(), quad, quad + 6);
+    }
+  }
+
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  const size_t positions_size = positions.size() * sizeof(float);
+  buffer.data.resize(positions_size + tris.size() * 2);
+  std::memcpy(buffer.data.data(), positions.data(), positions_size);
+  std::memcpy(buffer.data.data() + positions_size, tris.data(),
+              tris.size() * 2);
+  model.buffers.push_back(buffer);
+  const size_t offsets[] = {0, positions_size};
+  const size_t lengths[] = {positions_size, tris.size() * 2};
+  const int types[] = {TINYGLTF_TYPE_VEC3, TINYGLTF_TYPE_SCALAR};
+  const int component_types[] = {TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                  TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT};
+  for (int i = 0; i < 2; i++) {
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = offsets[i];
+    view.byteLength = lengths[i];
+    model.bufferViews.push_back(view);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = i;
+    accessor.componentType = component_types[i];
+    accessor.type = types[i];
+    accessor.count = i == 1 ? tris.size() : size_t(kRow * kRow);
+    model.accessors.push_back(accessor);
+  }
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  primitive.indices = 1;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+  model.asset.version = "2.0";
+
+  tinygltf::TinyGLTF ctx;
+  ctx.SetDracoCompression(true);
+  std::stringstream os;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, os, false, true));
+  const std::string glb = os.str();
+  // The model passed to the writer is untouched.
+  CHECK(model.extensionsUsed.empty());
+  CHECK(model.accessors[0].bufferView == 0);
+
+  tinygltf::MemoryGeometryCache memory;
+  tinygltf::GeometryCacheCallbacks callbacks = {
+      &tinygltf::LookupMemoryGeometryCache,
+      &tinygltf::StoreMemoryGeometryCache, &memory};
+  ctx.SetGeometryCache(callbacks);
+  for (int pass = 0; pass < 2; pass++) {
+    // The second pass is served from the cache, on the loading thread.
+    ctx.SetGeometryDecodeThreads(pass == 0 ? 0 : 1);
+    tinygltf::Model loaded;
+    std::string err, warn;
+    REQUIRE(ctx.LoadBinaryFromMemory(
+        &loaded, &err, &warn,
+        reinterpret_cast<const unsigned char *>(glb.data()),
+        static_cast<unsigned int>(glb.size())));
+    CHECK(warn.empty());
+    REQUIRE(memory.entries.size() == 1);
+    const tinygltf::Primitive &p = loaded.meshes[0].primitives[0];
+    REQUIRE(p.extensions.count("KHR_draco_mesh_compression") == 1);
+
+    // Positions are quantized, and Draco may reorder the points: compare
+    // the triangles by position.
+    tinygltf::AccessorView<std::array<float, 3>> decoded_positions(
+        loaded, p.attributes.at("POSITION"), &err);
+    REQUIRE(decoded_positions.valid());
+    REQUIRE(decoded_positions.size() == size_t(kRow * kRow));
+    tinygltf::AccessorView<uint16_t> decoded_tris(loaded, p.indices, &err);
+    REQUIRE(decoded_tris.valid());
+    REQUIRE(decoded_tris.size() == tris.size());
+    std::multiset<std::vector<int>> expected, actual;
+    for (size_t t = 0; t < tris.size(); t += 3) {
+      std::vector<int> a, b;
+      for (size_t k = 0; k < 3; k++) {
+        for (size_t c = 0; c < 3; c++) {
+          a.push_back(int(std::lround(positions[tris[t + k] * 3 + c] * 4)));
+          b.push_back(int(std::lround(
+              decoded_positions[decoded_tris[t + k]][c] * 4)));
+        }
+      }
+      expected.insert(a);
+      actual.insert(b);
+    }
+    CHECK(actual == expected);
+  }
+
+  // A huge accessor count is checked against the decoded mesh before
+  // anything is allocated for it.
+  std::stringstream text;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, text, false, false));
+  std::string json = text.str();
+  const std::string count = "\"count\":" + std::to_string(kRow * kRow) + ",";
+  const size_t at = json.find(count);
+  REQUIRE(at != std::string::npos);
+  json.replace(at, count.size(), "\"count\":1099511627776,");
+  tinygltf::Model huge;
+  std::string err, warn;
+  CHECK(ctx.LoadASCIIFromString(&huge, &err, &warn, json.c_str(),
+                                static_cast<unsigned int>(json.size()), ""));
+  CHECK(warn.find("does not match the accessor") != std::string::npos);
+}
+#endif
+
+TEST_CASE("geometry-cache", "[cache]") {
+  tinygltf::Model model;
+  tinygltf::Buffer buffer;
+  std::vector<float> positions;
+  for (int i = 0; i < 64; i++) {
+    const float p[] = {float(i % 8), float(i / 8), 0.5f * float(i)};
+    positions.insert(positions.end(), p, p + 3);
+  }
+  buffer.data.resize(positions.size() * sizeof(float));
+  std::memcpy(buffer.data.data(), positions.data(), buffer.data.size());
+  model.buffers.push_back(buffer);
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = buffer.data.size();
+  model.bufferViews.push_back(view);
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_VEC3;
+  accessor.count = 64;
+  model.accessors.push_back(accessor);
+  tinygltf::Primitive primitive;
+  primitive.attributes["POSITION"] = 0;
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+  model.asset.version = "2.0";
+
+  tinygltf::TinyGLTF ctx;
+  ctx.SetMeshoptCompression(true);
+  std::stringstream os;
+  REQUIRE(ctx.WriteGltfSceneToStream(&model, os, false, false));
+  const std::string json = os.str();
+  REQUIRE(json.find("EXT_meshopt_compression") != std::string::npos);
+
+  tinygltf::MemoryGeometryCache memory;
+  tinygltf::GeometryCacheCallbacks callbacks = {
+      &tinygltf::LookupMemoryGeometryCache,
+      &tinygltf::StoreMemoryGeometryCache, &memory};
+  ctx.SetGeometryCache(callbacks);
+  CHECK(ctx.GetGeometryDecodeThreads() == 0);
+  ctx.SetGeometryDecodeThreads(1);
+
+  const auto load = [&](tinygltf::Model *loaded) {
+    std::string err, warn;
+    REQUIRE(ctx.LoadASCIIFromString(loaded, &err, &warn, json.c_str(),
+                                    static_cast<unsigned int>(json.size()),
+                                    ""));
+    const tinygltf::BufferView &v = loaded->bufferViews[0];
+    REQUIRE(v.byteLength == buffer.data.size());
+    return std::vector<unsigned char>(
+        loaded->buffers[size_t(v.buffer)].data.begin() +
+            std::ptrdiff_t(v.byteOffset),
+        loaded->buffers[size_t(v.buffer)].data.begin() +
+            std::ptrdiff_t(v.byteOffset + v.byteLength));
+  };
+
+  tinygltf::Model first;
+  CHECK(load(&first) == buffer.data);
+  REQUIRE(memory.entries.size() == 1);
+  // The decoded data follows the identity of the entry.
+  std::vector<unsigned char> &entry = memory.entries.begin()->second;
+  REQUIRE(entry.size() > buffer.data.size());
+  const size_t header_size = entry.size() - buffer.data.size();
+  const std::vector<unsigned char> header(
+      entry.begin(), entry.begin() + std::ptrdiff_t(header_size));
+  CHECK(std::equal(buffer.data.begin(), buffer.data.end(),
+                   entry.begin() + std::ptrdiff_t(header_size)));
+  CHECK(memory.bytes == entry.size());
+
+  // The second load is served from the cache: a modified entry shows up.
+  std::fill(entry.begin() + std::ptrdiff_t(header_size), entry.end(),
+            static_cast<unsigned char>(0x11));
+  tinygltf::Model second;
+  CHECK(load(&second) == std::vector<unsigned char>(buffer.data.size(), 0x11));
+
+  // An entry of another identity(e.g. a key collision) is ignored and
+  // replaced.
+  entry[0] ^= 1;
+  tinygltf::Model third;
+  CHECK(load(&third) == buffer.data);
+  CHECK(std::equal(header.begin(), header.end(), entry.begin()));
+
+  // So is an entry of the wrong size.
+  entry.resize(header_size + 4);
+  memory.bytes = entry.size();
+  tinygltf::Model fourth;
+  CHECK(load(&fourth) == buffer.data);
+  CHECK(entry.size() == header_size + buffer.data.size());
+
+  // Eviction keeps the most recent entries within max_bytes.
+  tinygltf::MemoryGeometryCache small;
+  small.max_bytes = 10;
+  const std::vector<unsigned char> four(4, 1), eight(8, 2);
+  std::vector<unsigned char> out;
+  tinygltf::StoreMemoryGeometryCache(1, four, &small);
+  tinygltf::StoreMemoryGeometryCache(2, four, &small);
+  CHECK(small.bytes == 8);
+  tinygltf::StoreMemoryGeometryCache(3, eight, &small);
+  CHECK(small.entries.size() == 1);
+  CHECK(!tinygltf::LookupMemoryGeometryCache(1, &out, &small));
+  CHECK(tinygltf::LookupMemoryGeometryCache(3, &out, &small));
+  CHECK(out == eight);
+
+  // Disk cache.
+  tinygltf::DiskGeometryCache disk;
+  disk.directory = ".";
+  const uint64_t key = 0x1234abcdull;
+  const std::string path = tinygltf::GetDiskGeometryCachePath(".", key);
+  CHECK(path == "./000000001234abcd.tgcache");
+  CHECK(!tinygltf::LookupDiskGeometryCache(key, &out, &disk));
+  tinygltf::StoreDiskGeometryCache(key, buffer.data, &disk);
+  REQUIRE(tinygltf::LookupDiskGeometryCache(key, &out, &disk));
+  CHECK(out == buffer.data);
+  CHECK(!tinygltf::LookupDiskGeometryCache(key + 1, &out, &disk));
+
+  // A truncated file is ignored.
+  std::vector<unsigned char> file;
+  std::string err;
+  REQUIRE(tinygltf::ReadWholeFile(&file, &err, path, nullptr));
+  file.resize(file.size() - 1);
+  REQUIRE(tinygltf::WriteWholeFile(&err, path, file, nullptr));
+  CHECK(!tinygltf::LookupDiskGeometryCache(key, &out, &disk));
+  std::remove(path.c_str());
+}
+
+TEST_CASE("flatten-scene", "[scene]") {
+  // 0: T(1, 0, 0) -> 1: R(90 deg around z) S(2) -> 2: T(1, 0, 0)
+  //              \-> 3: matrix T(0, 0, 3)
+  tinygltf::Model model;
+  model.nodes.resize(5);  // node 4 is not in the scene
+  model.nodes[0].translation = {1.0, 0.0, 0.0};
+  model.nodes[0].children = {1, 3};
+  model.nodes[1].rotation = {0.0, 0.0, std::sqrt(0.5), std::sqrt(0.5)};
+  model.nodes[1].scale = {2.0, 2.0, 2.0};
+  model.nodes[1].children = {2};
+  model.nodes[2].translation = {1.0, 0.0, 0.0};
+  model.nodes[3].matrix = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 3, 1};
+  tinygltf::Scene scene;
+  scene.nodes = {0};
+  model.scenes.push_back(scene);
+
+  tinygltf::FlatScene flat;
+  tinygltf::FlattenSceneOptions options;
+  options.float_matrices = true;
+  std::string err;
+  REQUIRE(tinygltf::FlattenScene(model, -1, &flat, options, &err));
+  REQUIRE(flat.nodes.size() == 4);
+  CHECK(flat.level_offsets == std::vector<size_t>({0, 1, 3, 4}));
+  CHECK(flat.nodes == std::vector<int>({0, 1, 3, 2}));
+  CHECK(flat.parents == std::vector<int>({-1, 0, 0, 1}));
+  CHECK(flat.node_entries == std::vector<int>({0, 1, 3, 2, -1}));
+
+  const auto world_translation = [&](int node, int c) {
+    return flat.world_matrices[16 * size_t(flat.node_entries[size_t(node)]) +
+                               12 + size_t(c)];
+  };
+  CHECK(std::fabs(world_translation(2, 0) - 1.0) < 1e-9);
+  CHECK(std::fabs(world_translation(2, 1) - 2.0) < 1e-9);
+  CHECK(std::fabs(world_translation(3, 0) - 1.0) < 1e-9);
+  CHECK(std::fabs(world_translation(3, 2) - 3.0) < 1e-9);
+  // the x axis of node 1 maps to 2 * y
+  CHECK(std::fabs(flat.world_matrices[16 * 1 + 1] - 2.0) < 1e-9);
+  CHECK(flat.world_matrices_f[16 * 3 + 13] == 2.0f);
+
+  // Incremental update of a subtree.
+  flat.translations[0] = 0.0;
+  flat.translations[2] = 5.0;
+  flat.dirty[0] = 1;
+  tinygltf::UpdateFlatSceneTransforms(&flat, options);
+  CHECK(std::fabs(world_translation(2, 0)) < 1e-9);
+  CHECK(std::fabs(world_translation(2, 2) - 5.0) < 1e-9);
+  CHECK(std::fabs(world_translation(3, 2) - 8.0) < 1e-9);
+  CHECK(flat.world_matrices_f[16 * 3 + 14] == 5.0f);
+  CHECK(flat.dirty == std::vector<unsigned char>(4, 0));
+
+  // Only the subtree of a dirty entry changes.
+  flat.world_matrices[16 * 2 + 12] = 100.0;  // node 3, outside the subtree
+  flat.has_matrix[1] = 0;
+  flat.rotations[4 * 1 + 2] = 0.0;
+  flat.rotations[4 * 1 + 3] = 1.0;
+  flat.dirty[1] = 1;
+  tinygltf::UpdateFlatSceneTransforms(&flat, options);
+  CHECK(std::fabs(world_translation(2, 0) - 2.0) < 1e-9);
+  CHECK(world_translation(3, 0) == 100.0);
+
+  // Wide and deep tree, in parallel: the world translation is the sum of the
+  // ancestor translations.
+  tinygltf::Model big;
+  const size_t kNodes = 20000;
+  big.nodes.resize(kNodes);
+  for (size_t i = 0; i < kNodes; i++) {
+    big.nodes[i].translation = {double(i % 7), 1.0, 0.0};
+    if (i > 0) {
+      big.nodes[(i - 1) / 3].children.push_back(int(i));
+    }
+  }
+  big.scenes.push_back(scene);
+  options.num_threads = 4;
+  REQUIRE(tinygltf::FlattenScene(big, 0, &flat, options, &err));
+  REQUIRE(flat.nodes.size() == kNodes);
+  for (size_t e = 1; e < kNodes; e++) {
+    const size_t p = size_t(flat.parents[e]);
+    REQUIRE(p < e);
+    const size_t node = size_t(flat.nodes[e]);
+    if (std::fabs(flat.world_matrices[16 * e + 12] -
+                  flat.world_matrices[16 * p + 12] - double(node % 7)) >
+            1e-9 ||
+        flat.world_matrices[16 * e + 13] !=
+            flat.world_matrices[16 * p + 13] + 1.0) {
+      FAIL("world translation of entry " << e);
+    }
+  }
+
+  // Per-frame update on an executor of the application. Tasks run in reverse
+  // order here, so they must not depend on each other.
+  const std::vector<double> expected = flat.world_matrices;
+  size_t num_tasks = 0;
+  options.num_threads = 1;
+  options.executor = [&](size_t n, const std::function<void(size_t)> &task) {
+    num_tasks += n;
+    for (size_t i = n; i > 0; i--) {
+      task(i - 1);
+    }
+  };
+  std::fill(flat.world_matrices.begin(), flat.world_matrices.end(), 0.0);
+  std::fill(flat.dirty.begin(), flat.dirty.end(),
+            static_cast<unsigned char>(1));
+  tinygltf::UpdateFlatSceneTransforms(&flat, options);
+  CHECK(num_tasks > 2);
+  CHECK(flat.world_matrices == expected);
+  options.executor = nullptr;
+
+  // Not a tree.
+  big.nodes[5].children.push_back(1);
+  err.clear();
+  CHECK(!tinygltf::FlattenScene(big, 0, &flat, options, &err));
+  CHECK(err.find("several parents") != std::string::npos);
+}
+
+TEST_CASE("animation-sampler", "[animation]") {
+  tinygltf::Model model;
+  model.buffers.resize(1);
+  const auto add_accessor = [&](const std::vector<float> &values, int type) {
+    std::vector<unsigned char> &data = model.buffers[0].data;
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = data.size();
+    view.byteLength = values.size() * sizeof(float);
+    data.resize(data.size() + view.byteLength);
+    std::memcpy(data.data() + view.byteOffset, values.data(), view.byteLength);
+    model.bufferViews.push_back(view);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    accessor.type = type;
+    accessor.count = values.size() / size_t(tinygltf::GetNumComponentsInType(
+                                         uint32_t(type)));
+    model.accessors.push_back(accessor);
+    return int(model.accessors.size() - 1);
+  };
+  const float h = std::sqrt(0.5f);
+  const int times = add_accessor({0.0f, 1.0f, 2.0f}, TINYGLTF_TYPE_SCALAR);
+  const int translations = add_accessor({0, 0, 0, 2, 0, 0, 2, 4, 0},
+                                        TINYGLTF_TYPE_VEC3);
+  // identity, 90 and 180 degrees around z
+  const int rotations = add_accessor({0, 0, 0, 1, 0, 0, h, h, 0, 0, 1, 0},
+                                     TINYGLTF_TYPE_VEC4);
+  const int scales = add_accessor({1, 1, 1, 2, 2, 2, 3, 3, 3},
+                                  TINYGLTF_TYPE_VEC3);
+  // 2 morph targets: (in-tangent, value, out-tangent) per key
+  const int weights = add_accessor({0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+                                    0, 0, 0, 0, 0, 0},
+                                   TINYGLTF_TYPE_SCALAR);
+
+  tinygltf::Animation animation;
+  const auto add_sampler = [&](int output, const char *interpolation) {
+    tinygltf::AnimationSampler sampler;
+    sampler.input = times;
+    sampler.output = output;
+    sampler.interpolation = interpolation;
+    animation.samplers.push_back(sampler);
+    return int(animation.samplers.size() - 1);
+  };
+  const auto add_channel = [&](int sampler, int node, const char *path) {
+    tinygltf::AnimationChannel channel;
+    channel.sampler = sampler;
+    channel.target_node = node;
+    channel.target_path = path;
+    animation.channels.push_back(channel);
+  };
+  model.nodes.resize(6);
+  add_channel(add_sampler(translations, "LINEAR"), 0, "translation");
+  add_channel(add_sampler(scales, "STEP"), 0, "scale");
+  add_channel(add_sampler(weights, "CUBICSPLINE"), 0, "weights");
+  const int rotation_sampler = add_sampler(rotations, "LINEAR");
+  for (int n = 0; n < 6; n++) {  // a group of 4 and a partial group
+    add_channel(rotation_sampler, n, "rotation");
+  }
+  tinygltf::AnimationChannel pointer;  // no target node: skipped
+  pointer.sampler = 0;
+  pointer.target_path = "pointer";
+  animation.channels.push_back(pointer);
+  model.animations.push_back(animation);
+
+  tinygltf::AnimationClip clip;
+  std::string err;
+  REQUIRE(tinygltf::CompileAnimation(model, 0, &clip, &err));
+  CHECK(clip.channels.size() == 9);
+  CHECK(clip.slerp_channels.size() == 6);
+  CHECK(clip.times.size() == 3);  // shared input stored once
+  CHECK(clip.values.size() == 9 + 9 + 18 + 12);
+  CHECK(clip.pose_size == 3 + 3 + 2 + 6 * 4);
+  CHECK(clip.end_time == 2.0f);
+
+  tinygltf::AnimationCursor cursor;
+  std::vector<float> pose(clip.pose_size);
+  const auto check_pose = [&](float time) {
+    tinygltf::SampleAnimation(clip, time, &cursor, pose.data());
+    const float t = std::min(std::max(time, 0.0f), 2.0f);
+    // translation
+    const float x = t < 1.0f ? 2.0f * t : 2.0f;
+    const float y = t < 1.0f ? 0.0f : 4.0f * (t - 1.0f);
+    CHECK(std::fabs(pose[0] - x) < 1e-5f);
+    CHECK(std::fabs(pose[1] - y) < 1e-5f);
+    // scale(STEP)
+    const float s = t < 1.0f ? 1.0f : (t < 2.0f ? 2.0f : 3.0f);
+    CHECK(pose[3] == s);
+    // weights(CUBICSPLINE with zero tangents is smoothstep)
+    const float u = t < 1.0f ? t : t - 1.0f;
+    const float smooth = u * u * (3.0f - 2.0f * u);
+    const float w0 = t < 1.0f ? 1.0f - smooth : 0.0f;
+    const float w1 = t < 1.0f ? smooth : 1.0f - smooth;
+    CHECK(std::fabs(pose[6] - (t >= 2.0f ? 0.0f : w0)) < 1e-5f);
+    CHECK(std::fabs(pose[7] - (t >= 2.0f ? 0.0f : w1)) < 1e-5f);
+    // rotation: slerp is uniform in angle
+    const float angle = 0.5f * 3.14159265f * t;
+    for (size_t n = 0; n < 6; n++) {
+      const float *q = &pose[8 + 4 * n];
+      CHECK(std::fabs(q[0]) < 1e-6f);
+      CHECK(std::fabs(q[2] - std::sin(0.5f * angle)) < 2e-6f);
+      CHECK(std::fabs(q[3] - std::cos(0.5f * angle)) < 2e-6f);
+    }
+  };
+  // forward playback, a jump back and clamping
+  for (float time = -0.5f; time < 2.5f; time += 0.0625f) {
+    check_pose(time);
+  }
+  check_pose(0.3f);
+  check_pose(1.7f);
+  check_pose(1.0f);
+
+  tinygltf::SampleAnimation(clip, 1.5f, &cursor, pose.data());
+  tinygltf::ApplyAnimationPose(clip, pose.data(), &model);
+  CHECK(model.nodes[0].translation == std::vector<double>({2.0, 2.0, 0.0}));
+  CHECK(model.nodes[0].scale == std::vector<double>({2.0, 2.0, 2.0}));
+  CHECK(model.nodes[0].weights.size() == 2);
+  CHECK(model.nodes[5].rotation.size() == 4);
+
+  tinygltf::Scene scene;
+  scene.nodes = {0, 1};
+  model.scenes.push_back(scene);
+  tinygltf::FlatScene flat;
+  REQUIRE(tinygltf::FlattenScene(model, 0, &flat));
+  tinygltf::SampleAnimation(clip, 0.5f, &cursor, pose.data());
+  tinygltf::ApplyAnimationPose(clip, pose.data(), &flat);
+  CHECK(flat.dirty == std::vector<unsigned char>({1, 1}));
+  CHECK(flat.translations[0] == 1.0);
+  tinygltf::UpdateFlatSceneTransforms(&flat);
+  CHECK(std::fabs(flat.world_matrices[12] - 1.0) < 1e-9);
+
+  // Output count mismatch.
+  model.animations[0].samplers[0].output = scales + 0;
+  model.accessors[size_t(scales)].count = 2;
+  err.clear();
+  CHECK(!tinygltf::CompileAnimation(model, 0, &clip, &err));
+  CHECK(err.find("counts do not match") != std::string::npos);
+}
+
+TEST_CASE("animation-optimize", "[animation]") {
+  // 1 second baked at 120 Hz. Translation and rotation are reproduced by
+  // 2 keys, scale is a curve. They share the input accessor. Node 1 has its
+  // own input, resampled to 30 Hz.
+  tinygltf::Model model;
+  model.buffers.resize(1);
+  const auto add_accessor = [&](const std::vector<float> &values, int type) {
+    std::vector<unsigned char> &data = model.buffers[0].data;
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = data.size();
+    view.byteLength = values.size() * sizeof(float);
+    data.resize(data.size() + view.byteLength);
+    std::memcpy(data.data() + view.byteOffset, values.data(), view.byteLength);
+    model.bufferViews.push_back(view);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    accessor.type = type;
+    accessor.count = values.size() / size_t(tinygltf::GetNumComponentsInType(
+                                         uint32_t(type)));
+    model.accessors.push_back(accessor);
+    return int(model.accessors.size() - 1);
+  };
+  const size_t kKeys = 121;
+  std::vector<float> times, translations, rotations, scales, curve;
+  for (size_t i = 0; i < kKeys; i++) {
+    const float t = float(i) / 120.0f;
+    times.push_back(t);
+    const float tr[] = {2.0f * t, 1.0f, -t};
+    translations.insert(translations.end(), tr, tr + 3);
+    const float half_angle = 0.5f * 1.5f * t;  // 1.5 rad per second
+    const float q[] = {0.0f, std::sin(half_angle), 0.0f, std::cos(half_angle)};
+    rotations.insert(rotations.end(), q, q + 4);
+    const float s = 1.0f + 0.5f * std::sin(6.28318f * t);
+    const float sc[] = {s, s, s};
+    scales.insert(scales.end(), sc, sc + 3);
+    const float c[] = {std::sin(3.0f * t), 0.0f, 0.0f};
+    curve.insert(curve.end(), c, c + 3);
+  }
+  const int shared_input = add_accessor(times, TINYGLTF_TYPE_SCALAR);
+  const int own_input = add_accessor(times, TINYGLTF_TYPE_SCALAR);
+  tinygltf::Animation animation;
+  const char *paths[] = {"translation", "rotation", "scale", "translation"};
+  const int outputs[] = {add_accessor(translations, TINYGLTF_TYPE_VEC3),
+                         add_accessor(rotations, TINYGLTF_TYPE_VEC4),
+                         add_accessor(scales, TINYGLTF_TYPE_VEC3),
+                         add_accessor(curve, TINYGLTF_TYPE_VEC3)};
+  for (int i = 0; i < 4; i++) {
+    tinygltf::AnimationSampler sampler;
+    sampler.input = i < 3 ? shared_input : own_input;
+    sampler.output = outputs[i];
+    animation.samplers.push_back(sampler);
+    tinygltf::AnimationChannel channel;
+    channel.sampler = i;
+    channel.target_node = i < 3 ? 0 : 1;
+    channel.target_path = paths[i];
+    animation.channels.push_back(channel);
+  }
+  model.animations.push_back(animation);
+  model.nodes.resize(2);
+  const tinygltf::Model original = model;
+
+  tinygltf::AnimationOptimizeOptions options;
+  options.resample_rate = 30.0;
+  options.translation_tolerance = 1e-3;
+  options.scale_tolerance = 1e-3;
+  tinygltf::AnimationOptimizeReport report;
+  std::string err;
+  REQUIRE(tinygltf::OptimizeAnimations(&model, options, &err, &report));
+  CHECK(report.samplers == 4);
+  CHECK(report.keys_before == 4 * kKeys);
+  CHECK(report.keys_after < report.keys_before / 3);
+  CHECK(report.bytes_after < report.bytes_before);
+  CHECK(report.compression_ratio > 3.0);
+
+  // The shared input is still shared.
+  const std::vector<tinygltf::AnimationSampler> &samplers =
+      model.animations[0].samplers;
+  CHECK(samplers[0].input == samplers[1].input);
+  CHECK(samplers[1].input == samplers[2].input);
+  CHECK(samplers[3].input != samplers[0].input);
+  const tinygltf::Accessor &input =
+      model.accessors[size_t(samplers[0].input)];
+  CHECK(input.minValues == std::vector<double>({0.0}));
+  CHECK(input.maxValues == std::vector<double>({1.0}));
+  CHECK(model.accessors[size_t(samplers[3].input)].count <= 31);
+  // unused accessors are removed
+  CHECK(model.accessors.size() == 2 + 4);
+
+  // Close to the original animation at the original keys(the tolerance plus
+  // the error of a 30 Hz linear approximation of the curves).
+  tinygltf::AnimationClip a, b;
+  REQUIRE(tinygltf::CompileAnimation(original, 0, &a, &err));
+  REQUIRE(tinygltf::CompileAnimation(model, 0, &b, &err));
+  REQUIRE(a.pose_size == b.pose_size);
+  tinygltf::AnimationCursor ca, cb;
+  std::vector<float> pa(a.pose_size), pb(b.pose_size);
+  for (size_t i = 0; i < kKeys; i++) {
+    tinygltf::SampleAnimation(a, times[i], &ca, pa.data());
+    tinygltf::SampleAnimation(b, times[i], &cb, pb.data());
+    for (size_t c = 0; c < 3; c++) {
+      CHECK(std::fabs(pa[c] - pb[c]) < 1e-3f);         // translation
+      CHECK(std::fabs(pa[7 + c] - pb[7 + c]) < 4e-3f);  // scale
+    }
+    for (size_t c = 3; c < 7; c++) {
+      CHECK(std::fabs(pa[c] - pb[c]) < 1e-3f);  // rotation
+    }
+    CHECK(std::fabs(pa[10] - pb[10]) < 2e-3f);
+  }
+
+  // Nothing left to remove.
+  REQUIRE(tinygltf::OptimizeAnimations(&model, options, &err, &report));
+  CHECK(report.samplers == 0);
+  CHECK(report.bytes_after == report.bytes_before);
+
+  // Without compaction the replaced data stays, and the report says so.
+  tinygltf::Model grown = original;
+  options.compact_buffers = false;
+  REQUIRE(tinygltf::OptimizeAnimations(&grown, options, &err, &report));
+  CHECK(report.samplers == 4);
+  CHECK(report.bytes_before == original.buffers[0].data.size());
+  CHECK(report.bytes_after == grown.buffers[0].data.size());
+  CHECK(report.bytes_after > report.bytes_before);
+  CHECK(report.compression_ratio < 1.0);
+  CHECK(grown.accessors.size() == original.accessors.size() + 2 + 4);
+
+  // Compaction keeps a bufferView which an unknown extension may refer to.
+  tinygltf::Model extended = original;
+  const unsigned char metadata[4] = {1, 2, 3, 4};
+  std::vector<unsigned char> &data = extended.buffers[0].data;
+  data.insert(data.end(), metadata, metadata + 4);
+  tinygltf::BufferView metadata_view;
+  metadata_view.buffer = 0;
+  metadata_view.byteOffset = data.size() - 4;
+  metadata_view.byteLength = 4;
+  extended.bufferViews.push_back(metadata_view);
+  extended.extensionsUsed.push_back("EXT_structural_metadata");
+  options.compact_buffers = true;
+  REQUIRE(tinygltf::OptimizeAnimations(&extended, options, &err, &report));
+  CHECK(report.samplers == 4);
+  REQUIRE(extended.bufferViews.size() > original.bufferViews.size());
+  const tinygltf::BufferView &kept =
+      extended.bufferViews[original.bufferViews.size()];
+  REQUIRE(kept.byteLength == 4);
+  CHECK(std::equal(metadata, metadata + 4,
+                   extended.buffers[0].data.begin() +
+                       std::ptrdiff_t(kept.byteOffset)));
+}
+
+TEST_CASE("skin-palettes", "[skin]") {
+  tinygltf::Model model;
+  model.nodes.resize(4);  // node 3 is not in the scene
+  model.nodes[0].translation = {1.0, 0.0, 0.0};
+  model.nodes[0].children = {1};
+  model.nodes[1].rotation = {0.0, 0.0, std::sqrt(0.5), std::sqrt(0.5)};
+  model.nodes[1].children = {2};
+  model.nodes[2].translation = {0.0, 2.0, 0.0};
+  tinygltf::Scene scene;
+  scene.nodes = {0};
+  model.scenes.push_back(scene);
+
+  // Inverse bind matrices: T(-1, 0, 0) and S(0.5), plus an unused one.
+  const float ibm[48] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -1, 0, 0, 1,
+                         0.5f, 0, 0, 0, 0, 0.5f, 0, 0, 0, 0, 0.5f, 0,
+                         0, 0, 0, 1,
+                         1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  tinygltf::Buffer buffer;
+  buffer.data.resize(sizeof(ibm));
+  std::memcpy(buffer.data.data(), ibm, sizeof(ibm));
+  model.buffers.push_back(buffer);
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteLength = sizeof(ibm);
+  model.bufferViews.push_back(view);
+  tinygltf::Accessor accessor;
+  accessor.bufferView = 0;
+  accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  accessor.type = TINYGLTF_TYPE_MAT4;
+  accessor.count = 3;
+  model.accessors.push_back(accessor);
+
+  tinygltf::Skin skin0, skin1;
+  skin0.joints = {1, 2};
+  skin0.inverseBindMatrices = 0;
+  skin1.joints = {0, 3};
+  model.skins.push_back(skin0);
+  model.skins.push_back(skin1);
+
+  tinygltf::SkinPaletteData data;
+  std::string err;
+  REQUIRE(tinygltf::PrepareSkinPalettes(model, &data, &err));
+  CHECK(data.skin_offsets == std::vector<size_t>({0, 2, 4}));
+  CHECK(data.joints == std::vector<int>({1, 2, 0, 3}));
+  CHECK(data.inverse_bind_matrices.size() == 4 * 16);
+  CHECK(data.inverse_bind_matrices[12] == -1.0f);
+  CHECK(data.inverse_bind_matrices[32] == 1.0f);  // identity
+
+  tinygltf::FlatScene flat;
+  REQUIRE(tinygltf::FlattenScene(model, 0, &flat));
+  std::vector<float> palettes(16 * data.joints.size());
+  tinygltf::ComputeSkinPalettes(data, flat, palettes.data(), 2);
+
+  // Reference: world(joint) * IBM in double.
+  for (size_t j = 0; j < data.joints.size(); j++) {
+    const int entry = flat.node_entries[size_t(data.joints[j])];
+    double world[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    if (entry >= 0) {
+      std::copy(flat.world_matrices.begin() + 16 * entry,
+                flat.world_matrices.begin() + 16 * entry + 16, world);
+    }
+    const float *b = &data.inverse_bind_matrices[16 * j];
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++) {
+        double v = 0.0;
+        for (int k = 0; k < 4; k++) {
+          v += world[4 * k + r] * double(b[4 * c + k]);
+        }
+        CHECK(std::fabs(palettes[16 * j + size_t(4 * c + r)] - v) < 1e-6);
+      }
+    }
+  }
+  // joint 1(node 2) at (1, 0, 0) + R(z90) * (0, 2, 0) = (-1, 0, 0), scaled
+  CHECK(std::fabs(palettes[16 + 12] + 1.0f) < 1e-6f);
+  CHECK(std::fabs(palettes[16 + 1] - 0.5f) < 1e-6f);
+
+  // Same result from float world matrices per model node.
+  std::vector<float> node_worlds(16 * model.nodes.size(), 0.0f);
+  for (size_t n = 0; n < model.nodes.size(); n++) {
+    const int entry = flat.node_entries[n];
+    for (size_t i = 0; i < 16; i++) {
+      node_worlds[16 * n + i] =
+          entry >= 0 ? float(flat.world_matrices[16 * size_t(entry) + i])
+                     : ((i % 5) == 0 ? 1.0f : 0.0f);
+    }
+  }
+  std::vector<float> palettes2(palettes.size());
+  tinygltf::ComputeSkinPalettes(data, node_worlds.data(), palettes2.data());
+  CHECK(palettes2 == palettes);
+
+  // Many joints, on an executor of the application.
+  tinygltf::SkinPaletteData many;
+  many.skin_offsets = {0, 1000};
+  for (size_t j = 0; j < 1000; j++) {
+    many.joints.push_back(int(j % model.nodes.size()));
+    many.inverse_bind_matrices.insert(many.inverse_bind_matrices.end(),
+                                      data.inverse_bind_matrices.begin(),
+                                      data.inverse_bind_matrices.begin() + 16);
+  }
+  std::vector<float> expected(16 * 1000), on_executor(16 * 1000);
+  tinygltf::ComputeSkinPalettes(many, node_worlds.data(), expected.data());
+  size_t num_tasks = 0;
+  tinygltf::ComputeSkinPalettes(
+      many, node_worlds.data(), on_executor.data(), 1,
+      [&](size_t n, const std::function<void(size_t)> &task) {
+        num_tasks += n;
+        for (size_t i = 0; i < n; i++) {
+          task(i);
+        }
+      });
+  CHECK(num_tasks == 4);
+  CHECK(on_executor == expected);
+
+  model.skins[0].joints.push_back(7);
+  err.clear();
+  CHECK(!tinygltf::PrepareSkinPalettes(model, &data, &err));
+  CHECK(err.find("invalid joint") != std::string::npos);
+}
+
+TEST_CASE("pose-primitive", "[skin]") {
+  tinygltf::Model model;
+  model.buffers.resize(1);
+  // Appends `data` as a tightly packed accessor.
+  auto add_accessor = [&](const void *data, size_t size, int component_type,
+                          int type, size_t count) {
+    std::vector<unsigned char> &bytes = model.buffers[0].data;
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = bytes.size();
+    view.byteLength = size;
+    bytes.insert(bytes.end(), static_cast<const unsigned char *>(data),
+                 static_cast<const unsigned char *>(data) + size);
+    bytes.resize((bytes.size() + 3) & ~size_t(3));
+    model.bufferViews.push_back(view);
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size()) - 1;
+    accessor.componentType = component_type;
+    accessor.type = type;
+    accessor.count = count;
+    model.accessors.push_back(accessor);
+    return int(model.accessors.size()) - 1;
+  };
+
+  const float positions[9] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+  const float normals[9] = {0, 0, 1, 1, 1, 0, 0, 0, 1};
+  const float target0_positions[9] = {0, 0, 1, 0, 0, 1, 0, 0, 1};
+  const float target0_normals[9] = {1, 0, 0, 0, 0, 0, 0, 0, 0};
+  const float target2_positions[9] = {9, 9, 9, 9, 9, 9, 9, 9, 9};
+  const uint8_t joints[12] = {0, 0, 0, 0, 0, 1, 0, 0, 5, 0, 0, 0};
+  const float joint_weights[12] = {1, 0, 0, 0, 0.5f, 0.5f, 0, 0, 1, 0, 0, 0};
+
+  tinygltf::Primitive prim;
+  prim.attributes["POSITION"] =
+      add_accessor(positions, sizeof(positions), TINYGLTF_COMPONENT_TYPE_FLOAT,
+                   TINYGLTF_TYPE_VEC3, 3);
+  prim.attributes["NORMAL"] =
+      add_accessor(normals, sizeof(normals), TINYGLTF_COMPONENT_TYPE_FLOAT,
+                   TINYGLTF_TYPE_VEC3, 3);
+  prim.attributes["JOINTS_0"] =
+      add_accessor(joints, sizeof(joints),
+                   TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, TINYGLTF_TYPE_VEC4, 3);
+  prim.attributes["WEIGHTS_0"] =
+      add_accessor(joint_weights, sizeof(joint_weights),
+                   TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4, 3);
+
+  // Target 0 is dense, target 1 is sparse without bufferView(+2 z on vertex
+  // 2), target 2 has a zero weight.
+  std::map<std::string, int> target0, target1, target2;
+  target0["POSITION"] = add_accessor(target0_positions,
+                                     sizeof(target0_positions),
+                                     TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                     TINYGLTF_TYPE_VEC3, 3);
+  target0["NORMAL"] = add_accessor(target0_normals, sizeof(target0_normals),
+                                   TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                   TINYGLTF_TYPE_VEC3, 3);
+  const uint16_t sparse_index = 2;
+  const float sparse_value[3] = {0, 0, 2};
+  const int sparse_indices =
+      add_accessor(&sparse_index, sizeof(sparse_index),
+                   TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+                   TINYGLTF_TYPE_SCALAR, 1);
+  const int sparse_values =
+      add_accessor(sparse_value, sizeof(sparse_value),
+                   TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, 1);
+  tinygltf::Accessor sparse;
+  sparse.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+  sparse.type = TINYGLTF_TYPE_VEC3;
+  sparse.count = 3;
+  sparse.sparse.isSparse = true;
+  sparse.sparse.count = 1;
+  sparse.sparse.indices.bufferView =
+      model.accessors[size_t(sparse_indices)].bufferView;
+  sparse.sparse.indices.byteOffset = 0;
+  sparse.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  sparse.sparse.values.bufferView =
+      model.accessors[size_t(sparse_values)].bufferView;
+  sparse.sparse.values.byteOffset = 0;
+  model.accessors.push_back(sparse);
+  target1["POSITION"] = int(model.accessors.size()) - 1;
+  target2["POSITION"] = add_accessor(target2_positions,
+                                     sizeof(target2_positions),
+                                     TINYGLTF_COMPONENT_TYPE_FLOAT,
+                                     TINYGLTF_TYPE_VEC3, 3);
+  prim.targets = {target0, target1, target2};
+
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(prim);
+  mesh.weights = {0.5, 1.0, 0.0};
+  model.meshes.push_back(mesh);
+  tinygltf::Node node;
+  node.mesh = 0;
+  model.nodes.push_back(node);
+
+  const std::vector<float> weights = tinygltf::GetMorphWeights(model, 0);
+  CHECK(weights == std::vector<float>({0.5f, 1.0f, 0.0f}));
+
+  auto check_vec3 = [](const float *v, float x, float y, float z) {
+    CHECK(std::fabs(v[0] - x) < 1e-6f);
+    CHECK(std::fabs(v[1] - y) < 1e-6f);
+    CHECK(std::fabs(v[2] - z) < 1e-6f);
+  };
+  const float n0 = 1.0f / std::sqrt(1.25f);  // |(0.5, 0, 1)|
+  const float n1 = 1.0f / std::sqrt(1.0f + 4.0f / 9.0f);  // |(2/3, 1, 0)|
+
+  // Morph targets only.
+  tinygltf::PosedPrimitive posed;
+  std::string err;
+  REQUIRE(tinygltf::PosePrimitive(model, 0, 0, weights.data(), weights.size(),
+                                  nullptr, 0, &posed,
+                                  tinygltf::PosePrimitiveOptions(), &err));
+  REQUIRE(posed.positions.size() == 9);
+  REQUIRE(posed.normals.size() == 9);
+  CHECK(posed.tangents.empty());
+  check_vec3(&posed.positions[0], 0, 0, 0.5f);
+  check_vec3(&posed.positions[3], 1, 0, 0.5f);
+  check_vec3(&posed.positions[6], 0, 1, 2.5f);
+  check_vec3(&posed.normals[0], 0.5f * n0, 0, n0);
+  check_vec3(&posed.normals[3], std::sqrt(0.5f), std::sqrt(0.5f), 0);
+
+  // Skinned with T(1, 2, 3) and S(2, 1, 1). Vertex 2 refers to joint 5, which
+  // is ignored.
+  const float palette[32] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1, 2, 3, 1,
+                             2, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  tinygltf::PosePrimitiveOptions options;
+  options.num_threads = 2;
+  REQUIRE(tinygltf::PosePrimitive(model, 0, 0, weights.data(), weights.size(),
+                                  palette, 2, &posed, options, &err));
+  check_vec3(&posed.positions[0], 1, 2, 3.5f);
+  // 0.5 * T + 0.5 * S = [diag(1.5, 1, 1), (0.5, 1, 1.5)]
+  check_vec3(&posed.positions[3], 2, 1, 2);
+  check_vec3(&posed.positions[6], 0, 1, 2.5f);
+  check_vec3(&posed.normals[0], 0.5f * n0, 0, n0);
+  // Inverse transpose of diag(1.5, 1, 1) applied to (1, 1, 0).
+  check_vec3(&posed.normals[3], 2.0f / 3.0f * n1, n1, 0);
+  check_vec3(&posed.normals[6], 0, 0, 1);
+
+  // Same result on an executor of the application.
+  tinygltf::PosedPrimitive on_executor;
+  size_t num_tasks = 0;
+  options.num_threads = 1;
+  options.executor = [&](size_t n, const std::function<void(size_t)> &task) {
+    num_tasks += n;
+    for (size_t i = 0; i < n; i++) {
+      task(i);
+    }
+  };
+  REQUIRE(tinygltf::PosePrimitive(model, 0, 0, weights.data(), weights.size(),
+                                  palette, 2, &on_executor, options, &err));
+  CHECK(num_tasks > 0);
+  CHECK(on_executor.positions == posed.positions);
+  CHECK(on_executor.normals == posed.normals);
+
+  model.accessors[size_t(prim.attributes["WEIGHTS_0"])].type =
+      TINYGLTF_TYPE_VEC3;
+  err.clear();
+  CHECK(!tinygltf::PosePrimitive(model, 0, 0, weights.data(), weights.size(),
+                                 palette, 2, &posed, options, &err));
+  CHECK(err.find("WEIGHTS_0") != std::string::npos);
+}
@@ -44,9 +44,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -632,7 +634,8 @@ struct Image {
   int component{-1};
   int bits{-1};        // bit depth per channel. 8(byte), 16 or 32.
   int pixel_type{-1};  // pixel type(TINYGLTF_COMPONENT_TYPE_***). usually
-                       // UBYTE(bits = 8) or USHORT(bits = 16)
+                       // UBYTE(bits = 8) or USHORT(bits = 16). FLOAT(bits =
+                       // 32, or 16 for half float) when converted at load.
   std::vector<unsigned char> image;
   int bufferView{-1};    // (required if no uri)
   std::string mimeType;  // (required if no uri) ["image/jpeg", "image/png",
@@ -1257,5429 +1260,12358 @@ enum SectionCheck {
 };
 
 ///
-/// URIEncodeFunction type. Signature for custom URI encoding of external
-/// resources such as .bin and image files. Used by tinygltf to re-encode the
-/// final location of saved files. object_type may be used to encode buffer and
-/// image URIs differently, for example. See
-/// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#uris
+/// Compile-time mapping from a C++ component type to
+/// TINYGLTF_COMPONENT_TYPE_***.
 ///
-using URIEncodeFunction = std::function<bool(
-    const std::string & /* in_uri */, const std::string & /* object_type */,
-    std::string * /* out_uri */, void * /* user_data */)>;
+template <typename C>
+struct AccessorComponentTraits;
+
+#define TINYGLTF_ACCESSOR_COMPONENT_TRAITS(ctype, gltf_type, norm_scale) \
+  template <>                                                            \
+  struct AccessorComponentTraits<ctype> {                                \
+    static const int component_type = gltf_type;                         \
+    static double normalize_scale() { return norm_scale; }               \
+  };
+
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(int8_t, TINYGLTF_COMPONENT_TYPE_BYTE,
+                                   1.0 / 127.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(uint8_t,
+                                   TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE,
+                                   1.0 / 255.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(int16_t, TINYGLTF_COMPONENT_TYPE_SHORT,
+                                   1.0 / 32767.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(uint16_t,
+                                   TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+                                   1.0 / 65535.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(int32_t, TINYGLTF_COMPONENT_TYPE_INT, 1.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(uint32_t,
+                                   TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, 1.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(float, TINYGLTF_COMPONENT_TYPE_FLOAT, 1.0)
+TINYGLTF_ACCESSOR_COMPONENT_TRAITS(double, TINYGLTF_COMPONENT_TYPE_DOUBLE, 1.0)
+
+#undef TINYGLTF_ACCESSOR_COMPONENT_TRAITS
 
 ///
-/// URIDecodeFunction type. Signature for custom URI decoding of external
-/// resources such as .bin and image files. Used by tinygltf when computing
-/// filenames to write resources.
+/// Element type of `AccessorView`. A component type for SCALAR, or
+/// std::array<component, N> for VECn/MATn(e.g. std::array<float, 3> for VEC3).
 ///
-using URIDecodeFunction =
-    std::function<bool(const std::string & /* in_uri */,
-                       std::string * /* out_uri */, void * /* user_data */)>;
+template <typename T>
+struct AccessorElementTraits {
+  typedef T component_type;
+  static const int num_components = 1;
+};
 
-// Declaration of default uri decode function
-bool URIDecode(const std::string &in_uri, std::string *out_uri,
-               void *user_data);
+template <typename C, size_t N>
+struct AccessorElementTraits<std::array<C, N>> {
+  typedef C component_type;
+  static const int num_components = int(N);
+};
 
 ///
-/// A structure containing URI callbacks and a pointer to their user data.
+/// Typed, strided and zero-copy view of an accessor.
 ///
-struct URICallbacks {
-  URIEncodeFunction encode;  // Optional encode method
-  URIDecodeFunction decode;  // Required decode method
+/// `T` is the element type returned to the user. `SrcComponentT` is the
+/// component type stored in the buffer, which must match
+/// `Accessor::componentType`. When they differ, each component is converted
+/// with `static_cast`, or, for a floating point `T` of a `normalized`
+/// accessor, with the glTF normalization rule(e.g. `c / 255.0` for
+/// UNSIGNED_BYTE, `max(c / 127.0, -1.0)` for BYTE).
+///
+/// Types, counts and buffer bounds are validated once at construction. Element
+/// access is an unchecked strided load.
+///
+///   AccessorView<std::array<float, 3>> positions(model, accessor_idx, &err);
+///   AccessorView<std::array<float, 2>, uint16_t> uvs(model, uv_idx, &err);
+///   if (positions.valid()) {
+///     for (const std::array<float, 3> &p : positions) { ... }
+///   }
+///
+/// Sparse accessors are not supported(`valid()` returns false).
+///
+template <typename T, typename SrcComponentT =
+                          typename AccessorElementTraits<T>::component_type>
+class AccessorView {
+ public:
+  typedef T value_type;
+  typedef typename AccessorElementTraits<T>::component_type component_type;
+  static const int num_components = AccessorElementTraits<T>::num_components;
+
+  class const_iterator {
+   public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T *pointer;
+    typedef T reference;
+
+    const_iterator() = default;
+    const_iterator(const AccessorView *view, size_t idx)
+        : view_(view), idx_(idx) {}
+
+    T operator*() const { return (*view_)[idx_]; }
+    T operator[](difference_type n) const {
+      return (*view_)[size_t(difference_type(idx_) + n)];
+    }
 
-  void *user_data;  // An argument that is passed to all uri callbacks
+    const_iterator &operator++() {
+      ++idx_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++idx_;
+      return it;
+    }
+    const_iterator &operator--() {
+      --idx_;
+      return *this;
+    }
+    const_iterator operator--(int) {
+      const_iterator it = *this;
+      --idx_;
+      return it;
+    }
+    const_iterator &operator+=(difference_type n) {
+      idx_ = size_t(difference_type(idx_) + n);
+      return *this;
+    }
+    const_iterator &operator-=(difference_type n) {
+      idx_ = size_t(difference_type(idx_) - n);
+      return *this;
+    }
+    const_iterator operator+(difference_type n) const {
+      return const_iterator(view_, size_t(difference_type(idx_) + n));
+    }
+    const_iterator operator-(difference_type n) const {
+      return const_iterator(view_, size_t(difference_type(idx_) - n));
+    }
+    difference_type operator-(const const_iterator &other) const {
+      return difference_type(idx_) - difference_type(other.idx_);
+    }
+
+    bool operator==(const const_iterator &other) const {
+      return idx_ == other.idx_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return idx_ != other.idx_;
+    }
+    bool operator<(const const_iterator &other) const {
+      return idx_ < other.idx_;
+    }
+
+   private:
+    const AccessorView *view_{nullptr};
+    size_t idx_{0};
+  };
+
+  AccessorView() = default;
+
+  ///
+  /// View `model.accessors[accessor_idx]`. Check `valid()` before use. The
+  /// reason is appended to `err` on failure.
+  ///
+  AccessorView(const Model &model, int accessor_idx,
+               std::string *err = nullptr) {
+    Init(model, accessor_idx, err);
+  }
+
+  ///
+  /// View raw memory of `count` elements placed `byte_stride` bytes apart.
+  ///
+  AccessorView(const unsigned char *data, size_t count, size_t byte_stride,
+               bool normalized = false)
+      : data_(data),
+        count_(count),
+        stride_(byte_stride ? byte_stride : ElementSize()),
+        normalized_(normalized),
+        valid_(data != nullptr || count == 0) {}
+
+  bool valid() const { return valid_; }
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  size_t byte_stride() const { return stride_; }
+  bool normalized() const { return normalized_; }
+  const unsigned char *data() const { return data_; }
+
+  T operator[](size_t i) const {
+    return Load(data_ + i * stride_, normalized_);
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, count_); }
+
+ private:
+  // Bytes of an element in the buffer.
+  static size_t ElementSize() {
+    return sizeof(SrcComponentT) *
+           size_t(AccessorElementTraits<T>::num_components);
+  }
+
+  static component_type ConvertComponent(SrcComponentT c, bool normalized) {
+    if (std::is_floating_point<component_type>::value &&
+        !std::is_floating_point<SrcComponentT>::value && normalized) {
+      const double v =
+          double(c) * AccessorComponentTraits<SrcComponentT>::normalize_scale();
+      return component_type(v < -1.0 ? -1.0 : v);
+    }
+    return static_cast<component_type>(c);
+  }
+
+  static T Load(const unsigned char *p, bool normalized) {
+    T value;
+    if (std::is_same<component_type, SrcComponentT>::value) {
+      std::memcpy(&value, p, sizeof(T));
+    } else {
+      SrcComponentT src[AccessorElementTraits<T>::num_components];
+      std::memcpy(src, p, sizeof(src));
+      component_type *dst = reinterpret_cast<component_type *>(&value);
+      for (int k = 0; k < AccessorElementTraits<T>::num_components; k++) {
+        dst[k] = ConvertComponent(src[k], normalized);
+      }
+    }
+    return value;
+  }
+
+  void Init(const Model &model, int accessor_idx, std::string *err) {
+    static_assert(sizeof(T) == sizeof(component_type) *
+                                   size_t(AccessorElementTraits<T>::num_components),
+                  "AccessorView element type must be tightly packed.");
+
+    if ((accessor_idx < 0) || (size_t(accessor_idx) >= model.accessors.size())) {
+      if (err) {
+        (*err) += "Invalid accessor index " + std::to_string(accessor_idx) +
+                  ".\n";
+      }
+      return;
+    }
+    const Accessor &accessor = model.accessors[size_t(accessor_idx)];
+    const std::string name = "accessor[" + std::to_string(accessor_idx) + "]";
+
+    if (accessor.sparse.isSparse) {
+      if (err) {
+        (*err) += name + " is a sparse accessor.\n";
+      }
+      return;
+    }
+    if (accessor.componentType !=
+        AccessorComponentTraits<SrcComponentT>::component_type) {
+      if (err) {
+        (*err) += name + " componentType " +
+                  std::to_string(accessor.componentType) +
+                  " does not match the view.\n";
+      }
+      return;
+    }
+    if (GetNumComponentsInType(static_cast<uint32_t>(accessor.type)) !=
+        AccessorElementTraits<T>::num_components) {
+      if (err) {
+        (*err) += name + " type " + std::to_string(accessor.type) +
+                  " does not match the view.\n";
+      }
+      return;
+    }
+
+    normalized_ = accessor.normalized;
+    if (accessor.count == 0) {
+      valid_ = true;
+      return;
+    }
+
+    if ((accessor.bufferView < 0) ||
+        (size_t(accessor.bufferView) >= model.bufferViews.size())) {
+      if (err) {
+        (*err) += name + " has no valid bufferView.\n";
+      }
+      return;
+    }
+    const BufferView &bufferView =
+        model.bufferViews[size_t(accessor.bufferView)];
+    if ((bufferView.buffer < 0) ||
+        (size_t(bufferView.buffer) >= model.buffers.size())) {
+      if (err) {
+        (*err) += name + " has no valid buffer.\n";
+      }
+      return;
+    }
+    const Buffer &buffer = model.buffers[size_t(bufferView.buffer)];
+
+    const int stride = accessor.ByteStride(bufferView);
+    if ((stride <= 0) || (size_t(stride) < ElementSize())) {
+      if (err) {
+        (*err) += name + " has an invalid byteStride.\n";
+      }
+      return;
+    }
+
+    // Every element must be inside of both the bufferView and the buffer.
+    // Checked with divisions so that huge counts or offsets cannot wrap.
+    const size_t elem_size = ElementSize();
+    const size_t view_length = bufferView.byteLength;
+    if ((bufferView.byteOffset > buffer.data.size()) ||
+        (view_length > buffer.data.size() - bufferView.byteOffset) ||
+        (accessor.byteOffset > view_length) ||
+        (view_length - accessor.byteOffset < elem_size) ||
+        (accessor.count >
+         (view_length - accessor.byteOffset - elem_size) / size_t(stride) +
+             1)) {
+      if (err) {
+        (*err) += name + " exceeds the range of its bufferView/buffer.\n";
+      }
+      return;
+    }
+
+    data_ = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+    count_ = accessor.count;
+    stride_ = size_t(stride);
+    valid_ = true;
+  }
+
+  const unsigned char *data_{nullptr};
+  size_t count_{0};
+  size_t stride_{0};
+  bool normalized_{false};
+  bool valid_{false};
 };
 
 ///
-/// FileExistsFunction type. Signature for custom filesystem callbacks.
+/// Resolves `model.accessors[accessor_idx]` into tightly packed elements
+/// (`count` * element size bytes). The data of a sparse accessor is its base
+/// data(zeros when it has no bufferView) with the sparse values scattered to
+/// the sparse indices. Returns false and appends the reason to `err` when the
+/// accessor is invalid.
 ///
-using FileExistsFunction = std::function<bool(
-    const std::string & /* abs_filename */, void * /* user_data */)>;
+bool MaterializeAccessor(const Model &model, int accessor_idx,
+                         std::vector<unsigned char> *out,
+                         std::string *err = nullptr);
 
 ///
-/// ExpandFilePathFunction type. Signature for custom filesystem callbacks.
+/// Replaces every sparse accessor of `model` with a dense one. Dense data is
+/// appended to `model->buffers[0]`(a buffer is created when the model has
+/// none) with a new bufferView per accessor. The bufferViews used only by the
+/// sparse data are left in the model. `model` is untouched on failure.
 ///
-using ExpandFilePathFunction =
-    std::function<std::string(const std::string &, void *)>;
+bool DensifySparseAccessors(Model *model, std::string *err = nullptr);
 
 ///
-/// ReadWholeFileFunction type. Signature for custom filesystem callbacks.
+/// Destination of an accessor for `ConvertAccessorsToFloat`. Component `c` of
+/// element `i` is written to `dst[i * element_stride + c * component_stride]`
+/// (strides are in floats).
+///   AoS(xyzxyz...): element_stride = 0(number of components),
+///                   component_stride = 1.
+///   SoA(xxx...yyy...): element_stride = 1, component_stride = count.
 ///
-using ReadWholeFileFunction = std::function<bool(
-    std::vector<unsigned char> *, std::string *, const std::string &, void *)>;
+struct AccessorFloatTarget {
+  int accessor{-1};  // index of Model::accessors
+  float *dst{nullptr};
+  size_t element_stride{0};
+  size_t component_stride{1};
+};
 
 ///
-/// WriteWholeFileFunction type. Signature for custom filesystem callbacks.
+/// Converts accessors to float into caller-provided arrays. Components of
+/// normalized accessors are mapped to [0, 1](unsigned) or [-1, 1](signed),
+/// other integer components are converted as is. Sparse accessors are
+/// materialized. Accessors are converted in parallel on `num_threads`
+/// threads(0 = hardware concurrency).
+/// Returns false and appends the reasons to `err` when some accessors are
+/// invalid(the other targets are still written).
 ///
-using WriteWholeFileFunction =
-    std::function<bool(std::string *, const std::string &,
-                       const std::vector<unsigned char> &, void *)>;
+bool ConvertAccessorsToFloat(const Model &model,
+                             const std::vector<AccessorFloatTarget> &targets,
+                             std::string *err = nullptr, int num_threads = 0);
 
 ///
-/// GetFileSizeFunction type. Signature for custom filesystem callbacks.
+/// Per component min/max of an accessor. Values are in the component type of
+/// the accessor(normalized integers are not scaled), after applying sparse
+/// substitution, as `Accessor::minValues`/`Accessor::maxValues` require.
 ///
-using GetFileSizeFunction =
-    std::function<bool(size_t *filesize_out, std::string *err,
-                       const std::string &abs_filename, void *userdata)>;
+struct AccessorBounds {
+  int accessor{-1};
+  std::vector<double> min;
+  std::vector<double> max;
+};
+
+struct AccessorBoundsOptions {
+  std::vector<int> accessors;    // Accessors to process. empty = all.
+  bool update_accessors{true};   // Write Accessor::minValues/maxValues.
+  bool only_missing{false};      // Keep accessors which already have both.
+  int num_threads{0};            // 0 = hardware concurrency.
+};
 
 ///
-/// A structure containing all required filesystem callbacks and a pointer to
-/// their user data.
+/// Computes exact per component min/max of accessors. Large accessors are
+/// split into chunks, and chunks are reduced in parallel. Results are stored
+/// to `bounds`(when not nullptr, in the order of processed accessors) and,
+/// with `update_accessors`, to the accessors of `model`.
+/// Accessors with `count` = 0 are skipped. Returns false and appends the
+/// reasons to `err` when some accessors are invalid.
 ///
-struct FsCallbacks {
-  FileExistsFunction FileExists;
-  ExpandFilePathFunction ExpandFilePath;
-  ReadWholeFileFunction ReadWholeFile;
-  WriteWholeFileFunction WriteWholeFile;
-  GetFileSizeFunction GetFileSizeInBytes;  // To avoid GetFileSize Win32 API,
-                                           // add `InBytes` suffix.
+bool ComputeAccessorBounds(Model *model,
+                           const AccessorBoundsOptions &options =
+                               AccessorBoundsOptions(),
+                           std::string *err = nullptr,
+                           std::vector<AccessorBounds> *bounds = nullptr);
 
-  void *user_data;  // An argument that is passed to all fs callbacks
+///
+/// Computes min/max of a single accessor without modifying the model(e.g.
+/// the AABB of a POSITION accessor).
+///
+bool ComputeAccessorBounds(const Model &model, int accessor_idx,
+                           AccessorBounds *bounds, std::string *err = nullptr,
+                           int num_threads = 0);
+
+struct TriangulateOptions {
+  // Treat the maximum value of the index component type(e.g. 0xffff) as a
+  // primitive restart, which ends a strip/fan. glTF does not allow it, but
+  // assets converted from other formats may contain it.
+  bool primitive_restart{false};
+  // Drop triangles with repeated vertices(e.g. stitching triangles of
+  // strips).
+  bool remove_degenerate{false};
+  // TriangulatePrimitives: TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT or
+  // UNSIGNED_INT. 0 = the smallest type which fits the vertex count.
+  int index_component_type{0};
+  // TriangulatePrimitives: allow UNSIGNED_BYTE indices for the smallest type.
+  // Off by default since many graphics APIs do not support 8-bit indices.
+  bool allow_unsigned_byte{false};
+  int num_threads{0};  // 0 = hardware concurrency.
 };
 
-#ifndef TINYGLTF_NO_FS
-// Declaration of default filesystem callbacks
+///
+/// Returns the triangle list(3 indices per triangle, 32-bit) of a
+/// TRIANGLES/TRIANGLE_STRIP/TRIANGLE_FAN primitive, keeping the winding order
+/// of strips and fans as defined by the glTF spec. Non-indexed primitives get
+/// sequential indices. Returns false for other modes or invalid accessors.
+///
+bool GetTriangleIndices(const Model &model, const Primitive &primitive,
+                        std::vector<uint32_t> *triangles,
+                        std::string *err = nullptr,
+                        const TriangulateOptions &options =
+                            TriangulateOptions());
 
-bool FileExists(const std::string &abs_filename, void *);
+///
+/// Smallest index component type for `num_vertices` vertices. The maximum
+/// value of each type is reserved(glTF forbids it as an index).
+///
+int GetSmallestIndexComponentType(size_t num_vertices,
+                                  bool allow_unsigned_byte = false);
 
 ///
-/// Expand file path(e.g. `~` to home directory on posix, `%APPDATA%` to
-/// `C:\\Users\\tinygltf\\AppData`)
+/// Stores 32-bit indices as `component_type`(UNSIGNED_BYTE, UNSIGNED_SHORT or
+/// UNSIGNED_INT). `dst` must have room for `count` indices. Values must fit.
 ///
-/// @param[in] filepath File path string. Assume UTF-8
-/// @param[in] userdata User data. Set to `nullptr` if you don't need it.
+void NarrowIndices(const uint32_t *src, size_t count, int component_type,
+                   unsigned char *dst);
+
 ///
-std::string ExpandFilePath(const std::string &filepath, void *userdata);
+/// Converts every TRIANGLES/TRIANGLE_STRIP/TRIANGLE_FAN primitive of the
+/// model to an indexed triangle list with `options.index_component_type`
+/// indices. Primitives are processed in parallel. New index data is appended
+/// to `model->buffers[0]` with a new bufferView and accessor per primitive.
+/// Triangle lists whose indices already have the requested type are kept.
+/// Other modes(points and lines) are left as is.
+///
+bool TriangulatePrimitives(Model *model,
+                           const TriangulateOptions &options =
+                               TriangulateOptions(),
+                           std::string *err = nullptr);
+
+struct WeldOptions {
+  // Remove the accessors/bufferViews/bytes which welding replaced. Data of
+  // other accessors and bufferViews is kept(see `CompactBuffers`).
+  bool compact_buffers{true};
+  int num_threads{0};  // 0 = hardware concurrency.
+};
 
-bool ReadWholeFile(std::vector<unsigned char> *out, std::string *err,
-                   const std::string &filepath, void *);
+struct WeldReport {
+  size_t vertices_before{0};
+  size_t vertices_after{0};
+  size_t bytes_before{0};  // Total size of `Model::buffers`
+  size_t bytes_after{0};
+};
 
-bool WriteWholeFile(std::string *err, const std::string &filepath,
-                    const std::vector<unsigned char> &contents, void *);
+///
+/// Merges bitwise identical vertices of each primitive. All attributes and
+/// morph target attributes form the vertex key. Unused vertices are dropped,
+/// vertices are renumbered in the order of first use and the primitive gets
+/// new attribute and index accessors(appended to `model->buffers[0]`).
+/// Primitive mode is kept. Non-indexed primitives become indexed.
+/// KHR_draco_mesh_compression primitives are skipped.
+///
+bool WeldVertices(Model *model, const WeldOptions &options = WeldOptions(),
+                  std::string *err = nullptr, WeldReport *report = nullptr);
 
-bool GetFileSizeInBytes(size_t *filesize_out, std::string *err,
-                        const std::string &filepath, void *);
-#endif
+///
+/// Removes unreferenced accessors, bufferViews and buffers, and drops unused
+/// bytes of buffers, updating all indices. Accessor references are collected
+/// from meshes, skins, animations and EXT_mesh_gpu_instancing. BufferView
+/// references from accessors, images, KHR_draco_mesh_compression and
+/// TINYGLTF_meshlets(`GenerateMeshlets`). Ranges of
+/// EXT_meshopt_compression/KHR_meshopt_compression bufferViews are kept.
+/// Buffers whose data is not loaded are left as is.
+/// Other extensions(e.g. EXT_structural_metadata) may refer to data this
+/// function cannot see, so models which use extensions other than the above,
+/// KHR_materials_*, KHR_texture_transform, KHR_texture_basisu,
+/// KHR_lights_punctual, KHR_mesh_quantization, EXT_texture_webp/avif,
+/// KHR_animation_pointer, KHR_xmp_json_ld and MSFT_lod are left unchanged
+/// and false is returned.
+/// The `compact_buffers` option of mesh passes only reclaims what the pass
+/// itself replaced, and keeps all data which existed before the pass when the
+/// model uses such extensions.
+///
+bool CompactBuffers(Model *model, std::string *err = nullptr);
+
+struct VertexCacheStats {
+  size_t triangles{0};
+  size_t vertices{0};     // Vertices referenced by the indices
+  size_t transformed{0};  // Vertex shader invocations(cache misses)
+  double acmr{0.0};       // Average cache miss ratio: transformed / triangles
+  double atvr{0.0};       // Average transform to vertex ratio: transformed /
+                          // vertices(1.0 is optimal)
+};
 
 ///
-/// LoadImageDataFunction type. Signature for custom image loading callbacks.
+/// Simulates a FIFO post-transform vertex cache of `cache_size` entries over a
+/// triangle list.
 ///
-using LoadImageDataFunction = std::function<bool(
-    Image * /* image */, const int /* image_idx */, std::string * /* err */,
-    std::string * /* warn */, int /* req_width */, int /* req_height */,
-    const unsigned char * /* bytes */, int /* size */, void * /*user_data */)>;
+VertexCacheStats AnalyzeVertexCache(const uint32_t *indices, size_t count,
+                                    size_t num_vertices,
+                                    size_t cache_size = 16);
 
 ///
-/// WriteImageDataFunction type. Signature for custom image writing callbacks.
-/// The out_uri parameter becomes the URI written to the gltf and may reference
-/// a file or contain a data URI.
+/// Reorders triangles for the post-transform vertex cache(Tom Forsyth's
+/// "Linear-Speed Vertex Cache Optimisation"). `dst` receives `count` indices
+/// and must not alias `indices`. Returns false when an index is not below
+/// `num_vertices`.
 ///
-using WriteImageDataFunction = std::function<bool(
-    const std::string * /* basepath */, const std::string * /* filename */,
-    const Image *image, bool /* embedImages */,
-    const FsCallbacks * /* fs_cb */, const URICallbacks * /* uri_cb */,
-    std::string * /* out_uri */, void * /* user_pointer */)>;
+bool OptimizeVertexCache(const uint32_t *indices, size_t count,
+                         size_t num_vertices, uint32_t *dst,
+                         size_t cache_size = 32, std::string *err = nullptr);
 
-#ifndef TINYGLTF_NO_STB_IMAGE
-// Declaration of default image loader callback
-bool LoadImageData(Image *image, const int image_idx, std::string *err,
-                   std::string *warn, int req_width, int req_height,
-                   const unsigned char *bytes, int size, void *);
-#endif
+///
+/// Renumbers vertices in the order of first use by `indices`(in place), so
+/// that vertex fetch is sequential. `new_to_old` receives the source vertex of
+/// each new vertex(its size is the new vertex count). Unused vertices are
+/// dropped. Returns false, leaving `indices` untouched, when an index is not
+/// below `num_vertices`.
+///
+bool OptimizeVertexFetch(uint32_t *indices, size_t count, size_t num_vertices,
+                         std::vector<uint32_t> *new_to_old,
+                         std::string *err = nullptr);
+
+struct VertexCacheOptions {
+  size_t cache_size{32};        // Cache size used for optimization
+  size_t stats_cache_size{16};  // Cache size used for the statistics
+  // Also reorder vertex attributes in the order of first use. Shared
+  // attribute accessors are duplicated per primitive.
+  bool reorder_vertices{true};
+  bool compact_buffers{true};  // Reclaim the data this pass replaced
+  int num_threads{0};          // 0 = hardware concurrency.
+};
 
-#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
-// Declaration of default image writer callback
-bool WriteImageData(const std::string *basepath, const std::string *filename,
-                    const Image *image, bool embedImages,
-                    const FsCallbacks* fs_cb, const URICallbacks *uri_cb,
-                    std::string *out_uri, void *);
-#endif
+struct PrimitiveCacheReport {
+  int mesh{-1};
+  int primitive{-1};
+  VertexCacheStats before;
+  VertexCacheStats after;
+};
 
 ///
-/// glTF Parser/Serializer context.
+/// Optimizes every TRIANGLES primitive of the model(in parallel) for the
+/// vertex cache and vertex fetch. Primitives get new index(and attribute)
+/// accessors appended to `model->buffers[0]`. KHR_draco_mesh_compression
+/// primitives are skipped. `report` receives ACMR/ATVR before and after for
+/// each optimized primitive.
 ///
-class TinyGLTF {
- public:
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wc++98-compat"
-#endif
+bool OptimizePrimitivesForVertexCache(
+    Model *model, const VertexCacheOptions &options = VertexCacheOptions(),
+    std::string *err = nullptr,
+    std::vector<PrimitiveCacheReport> *report = nullptr);
 
-  TinyGLTF() = default;
+///
+/// Cluster of a triangle list with its culling bounds. A meshlet uses
+/// `vertex_count` entries of `Meshlets::vertices` from `vertex_offset`
+/// (vertex indices of the primitive) and `triangle_count` * 3 entries of
+/// `Meshlets::triangles` from `triangle_offset`(meshlet local indices).
+///
+/// The meshlet is backfacing and can be culled when
+/// dot(normalize(cone_apex - camera_position), cone_axis) >= cone_cutoff.
+/// cone_cutoff is 1 when the triangle normals spread too much for culling.
+///
+struct Meshlet {
+  uint32_t vertex_offset{0};
+  uint32_t vertex_count{0};
+  uint32_t triangle_offset{0};
+  uint32_t triangle_count{0};
+  float center[3] = {0.0f, 0.0f, 0.0f};  // bounding sphere
+  float radius{0.0f};
+  float cone_apex[3] = {0.0f, 0.0f, 0.0f};
+  float cone_axis[3] = {0.0f, 0.0f, 0.0f};
+  float cone_cutoff{1.0f};
+};
 
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
+struct Meshlets {
+  std::vector<Meshlet> meshlets;
+  std::vector<uint32_t> vertices;
+  std::vector<uint8_t> triangles;
+};
 
-  ~TinyGLTF() = default;
+struct MeshletOptions {
+  size_t max_vertices{64};    // <= 255
+  size_t max_triangles{124};  // <= 512
+  // GenerateMeshlets: store meshlets in the model under the
+  // "TINYGLTF_meshlets" primitive extension(see `GenerateMeshlets`).
+  bool store_in_model{false};
+  int num_threads{0};  // 0 = hardware concurrency.
+};
 
-  ///
-  /// Loads glTF ASCII asset from a file.
-  /// Set warning message to `warn` for example it fails to load asserts.
-  /// Returns false and set error string to `err` if there's an error.
-  ///
-  bool LoadASCIIFromFile(Model *model, std::string *err, std::string *warn,
-                         const std::string &filename,
-                         unsigned int check_sections = REQUIRE_VERSION);
+///
+/// Splits a triangle list into meshlets in triangle order. Reorder triangles
+/// with `OptimizeVertexCache` first for better filled meshlets.
+/// `positions` holds `num_vertices` xyz positions, `position_stride` floats
+/// apart.
+///
+bool BuildMeshlets(const uint32_t *indices, size_t count,
+                   const float *positions, size_t num_vertices,
+                   size_t position_stride, const MeshletOptions &options,
+                   Meshlets *meshlets, std::string *err = nullptr);
 
-  ///
-  /// Loads glTF ASCII asset from string(memory).
-  /// `length` = strlen(str);
-  /// `base_dir` is a search path of glTF asset(e.g. images). Path Must be an
-  /// expanded path (e.g. no tilde(`~`), no environment variables). Set warning
-  /// message to `warn` for example it fails to load asserts. Returns false and
-  /// set error string to `err` if there's an error.
-  ///
-  bool LoadASCIIFromString(Model *model, std::string *err, std::string *warn,
-                           const char *str, const unsigned int length,
-                           const std::string &base_dir,
-                           unsigned int check_sections = REQUIRE_VERSION);
+///
+/// Builds meshlets of a TRIANGLES/TRIANGLE_STRIP/TRIANGLE_FAN primitive from
+/// its POSITION and index accessors.
+///
+bool BuildMeshlets(const Model &model, const Primitive &primitive,
+                   const MeshletOptions &options, Meshlets *meshlets,
+                   std::string *err = nullptr);
 
-  ///
-  /// Loads glTF binary asset from a file.
-  /// Set warning message to `warn` for example it fails to load asserts.
-  /// Returns false and set error string to `err` if there's an error.
-  ///
-  bool LoadBinaryFromFile(Model *model, std::string *err, std::string *warn,
-                          const std::string &filename,
-                          unsigned int check_sections = REQUIRE_VERSION);
+struct PrimitiveMeshlets {
+  int mesh{-1};
+  int primitive{-1};
+  Meshlets meshlets;
+};
 
-  ///
-  /// Loads glTF binary asset from memory.
-  /// `length` = strlen(str);
-  /// `base_dir` is a search path of glTF asset(e.g. images). Path Must be an
-  /// expanded path (e.g. no tilde(`~`), no environment variables).
-  /// Set warning message to `warn` for example it fails to load asserts.
-  /// Returns false and set error string to `err` if there's an error.
-  ///
-  bool LoadBinaryFromMemory(Model *model, std::string *err, std::string *warn,
-                            const unsigned char *bytes,
-                            const unsigned int length,
-                            const std::string &base_dir = "",
-                            unsigned int check_sections = REQUIRE_VERSION);
-
-  ///
-  /// Write glTF to stream, buffers and images will be embedded
-  ///
-  bool WriteGltfSceneToStream(const Model *model, std::ostream &stream,
-                              bool prettyPrint, bool writeBinary);
+///
+/// Builds meshlets for every triangle primitive of the model in parallel.
+///
+/// With `options.store_in_model`, each primitive gets the extension
+///
+///   "TINYGLTF_meshlets": {
+///     "maxVertices": 64, "maxTriangles": 124,
+///     "meshlets": <bufferView>,  // 64 bytes per meshlet: uint32
+///                                // vertex_offset, vertex_count,
+///                                // triangle_offset, triangle_count, then
+///                                // float center[3], radius, cone_apex[3],
+///                                // cone_axis[3], cone_cutoff, padding
+///     "vertices": <bufferView>,  // uint32
+///     "triangles": <bufferView>  // uint8, 3 per triangle
+///   }
+///
+/// with data appended to `model->buffers[0]`, so meshlets round-trip through
+/// the writer and can be read back with `GetStoredMeshlets`. Regenerate them
+/// after passes which change vertices or indices.
+///
+bool GenerateMeshlets(Model *model,
+                      const MeshletOptions &options = MeshletOptions(),
+                      std::vector<PrimitiveMeshlets> *meshlets = nullptr,
+                      std::string *err = nullptr);
 
-  ///
-  /// Write glTF to file.
-  ///
-  bool WriteGltfSceneToFile(const Model *model, const std::string &filename,
-                            bool embedImages, bool embedBuffers,
-                            bool prettyPrint, bool writeBinary);
+///
+/// Reads meshlets stored by `GenerateMeshlets`. Returns false when the
+/// primitive has no(valid) "TINYGLTF_meshlets" extension.
+///
+bool GetStoredMeshlets(const Model &model, const Primitive &primitive,
+                       Meshlets *meshlets, std::string *err = nullptr);
+
+struct VertexLayoutOptions {
+  // Attribute names interleaved into one bufferView per entry, in this
+  // order(e.g. {{"POSITION"}, {"NORMAL", "TEXCOORD_0"}}). Names missing in a
+  // primitive are skipped. Attributes not listed are interleaved into one
+  // more bufferView(or each gets its own with `separate_remaining`). Empty =
+  // all attributes interleaved into one bufferView.
+  std::vector<std::vector<std::string>> streams;
+  bool separate_remaining{false};
+  // Alignment of each bufferView in the mesh buffer. Power of two >= 4(e.g.
+  // 16 for direct upload into SIMD-friendly GPU staging memory).
+  size_t alignment{4};
+  bool compact_buffers{true};  // Reclaim the data this pass replaced
+  int num_threads{0};          // 0 = hardware concurrency.
+};
 
-  ///
-  /// Sets the parsing strictness.
-  ///
-  void SetParseStrictness(ParseStrictness strictness);
+///
+/// Rewrites the vertex attributes and indices of every mesh into a new buffer
+/// per mesh, with the attribute layout of `options`, so that a mesh can be
+/// uploaded with one copy. Elements are 4 byte aligned within vertices. Morph
+/// target attributes get a bufferView each. Meshes are processed in parallel.
+/// Accessors shared between primitives are duplicated per primitive, and
+/// KHR_draco_mesh_compression primitives are left as is.
+///
+bool ApplyVertexLayout(Model *model,
+                       const VertexLayoutOptions &options =
+                           VertexLayoutOptions(),
+                       std::string *err = nullptr);
+
+struct QuantizationOptions {
+  // Bits per component. Positions: 1..16(stored as UNSIGNED_BYTE up to 8
+  // bits, UNSIGNED_SHORT otherwise). Normals/tangents/texcoords: 8 or 16
+  // (normalized BYTE/SHORT, UNSIGNED_BYTE/SHORT for texcoords).
+  // 0 = leave the attribute as is.
+  int position_bits{14};
+  int normal_bits{8};
+  int tangent_bits{8};
+  int texcoord_bits{16};
+  bool compact_buffers{true};  // Reclaim the data this pass replaced
+  int num_threads{0};          // 0 = hardware concurrency.
+};
 
-  ///
-  /// Set callback to use for loading image data. Passing the nullptr is akin to
-  /// calling RemoveImageLoader().
-  ///
-  void SetImageLoader(LoadImageDataFunction LoadImageData, void *user_data);
+struct QuantizationReport {
+  size_t meshes{0};          // Quantized meshes
+  size_t skipped_meshes{0};  // Skinned, morphed, instanced or unused meshes
+  size_t bytes_before{0};    // Size of the quantized attribute data
+  size_t bytes_after{0};
+  double compression_ratio{1.0};  // bytes_before / bytes_after
+  // Maximum absolute error per component after dequantization. Positions in
+  // mesh units.
+  double max_position_error{0.0};
+  double max_normal_error{0.0};
+  double max_tangent_error{0.0};
+  double max_texcoord_error{0.0};
+};
 
-  ///
-  /// Unset(remove) callback of loading image data
-  ///
-  void RemoveImageLoader();
+///
+/// Quantizes vertex attributes as allowed by KHR_mesh_quantization, in
+/// parallel across meshes. Positions of a mesh are quantized to unsigned
+/// integers over the mesh bounds with a uniform scale, and the dequantization
+/// (translation and scale) goes into the transform of each node which
+/// instantiates the mesh, or into a new child node when the node transform is
+/// animated or also affects children, cameras or lights. Texcoords are
+/// quantized only when they lie in [0, 1]. Meshes with morph targets or used
+/// by skinned or EXT_mesh_gpu_instancing nodes are skipped. New accessors are
+/// appended to `model->buffers[0]`, and KHR_mesh_quantization is added to
+/// `extensionsUsed` and `extensionsRequired`.
+///
+bool QuantizeMeshes(Model *model,
+                    const QuantizationOptions &options = QuantizationOptions(),
+                    std::string *err = nullptr,
+                    QuantizationReport *report = nullptr);
 
-  ///
-  /// Set callback to use for writing image data
-  ///
-  void SetImageWriter(WriteImageDataFunction WriteImageData, void *user_data);
+///
+/// GeometryCacheLookupFunction type. Signature for decoded geometry cache
+/// callbacks. Returns true and sets `data` when an entry exists for `key`.
+///
+using GeometryCacheLookupFunction = std::function<bool(
+    uint64_t /* key */, std::vector<unsigned char> * /* data */,
+    void * /* user_data */)>;
 
-  ///
-  /// Set callbacks to use for URI encoding and decoding and their user data.
-  /// Returns false if there is an error with the callbacks. If err is not
-  /// nullptr, explanation will be written there.
-  ///
-  bool SetURICallbacks(URICallbacks callbacks, std::string* err = nullptr);
+///
+/// GeometryCacheStoreFunction type. Signature for decoded geometry cache
+/// callbacks.
+///
+using GeometryCacheStoreFunction =
+    std::function<void(uint64_t /* key */,
+                       const std::vector<unsigned char> & /* data */,
+                       void * /* user_data */)>;
 
-  ///
-  /// Set callbacks to use for filesystem (fs) access and their user data.
-  /// Returns false if there is an error with the callbacks. If err is not
-  /// nullptr, explanation will be written there.
-  ///
-  bool SetFsCallbacks(FsCallbacks callbacks, std::string* err = nullptr);
+///
+/// Cache of decoded KHR_draco_mesh_compression meshes and
+/// EXT_meshopt_compression bufferViews. The key is a 64-bit hash of the
+/// compressed bytes and the decode options(e.g. mode, filter, component
+/// types), so repeated loads of the same asset skip decompression. Each entry
+/// starts with the compressed byte length and the decode options, which the
+/// loader compares before using it. Both callbacks are optional, and are only
+/// called from the loading thread.
+///
+struct GeometryCacheCallbacks {
+  GeometryCacheLookupFunction Lookup;
+  GeometryCacheStoreFunction Store;
 
-  ///
-  /// Set serializing default values(default = false).
-  /// When true, default values are force serialized to .glTF.
-  /// This may be helpful if you want to serialize a full description of glTF
-  /// data.
-  ///
-  /// TODO(LTE): Supply parsing option as function arguments to
-  /// `LoadASCIIFromFile()` and others, not by a class method
-  ///
-  void SetSerializeDefaultValues(const bool enabled) {
-    serialize_default_values_ = enabled;
-  }
+  void *user_data;  // An argument that is passed to all cache callbacks
+};
 
-  bool GetSerializeDefaultValues() const { return serialize_default_values_; }
+///
+/// In-memory geometry cache. Pass it as `user_data` of
+/// `LookupMemoryGeometryCache`/`StoreMemoryGeometryCache`. The oldest
+/// entries are evicted when the total size exceeds `max_bytes`.
+///
+struct MemoryGeometryCache {
+  std::map<uint64_t, std::vector<unsigned char>> entries;
+  std::vector<uint64_t> order;  // Insertion order, for eviction
+  size_t bytes{0};              // Total size of `entries`
+  size_t max_bytes{0};          // 0 = unlimited
+};
 
-  ///
-  /// Store original JSON string for `extras` and `extensions`.
-  /// This feature will be useful when the user want to reconstruct custom data
-  /// structure from JSON string.
-  ///
-  void SetStoreOriginalJSONForExtrasAndExtensions(const bool enabled) {
-    store_original_json_for_extras_and_extensions_ = enabled;
-  }
+bool LookupMemoryGeometryCache(uint64_t key, std::vector<unsigned char> *data,
+                               void *user_data);
 
-  bool GetStoreOriginalJSONForExtrasAndExtensions() const {
-    return store_original_json_for_extras_and_extensions_;
-  }
+void StoreMemoryGeometryCache(uint64_t key,
+                              const std::vector<unsigned char> &data,
+                              void *user_data);
 
-  ///
-  /// Specify whether preserve image channels when loading images or not.
-  /// (Not effective when the user supplies their own LoadImageData callbacks)
-  ///
-  void SetPreserveImageChannels(bool onoff) {
-    preserve_image_channels_ = onoff;
-  }
+#ifndef TINYGLTF_NO_FS
+///
+/// On-disk geometry cache: one file per entry in `directory`(which must
+/// exist), named `GetDiskGeometryCachePath(directory, key)`. Pass it as
+/// `user_data` of `LookupDiskGeometryCache`/`StoreDiskGeometryCache`.
+/// Truncated or corrupted files are ignored.
+///
+struct DiskGeometryCache {
+  std::string directory;
+};
 
-  bool GetPreserveImageChannels() const { return preserve_image_channels_; }
+/// Returns `directory` + "/" + 16 hex digits of `key` + ".tgcache".
+std::string GetDiskGeometryCachePath(const std::string &directory,
+                                     uint64_t key);
 
-  ///
-  /// Specifiy whether image data is decoded/decompressed during load, or left as is
-  ///
-  void SetImagesAsIs(bool onoff) {
-      images_as_is_ = onoff;
-  }
+bool LookupDiskGeometryCache(uint64_t key, std::vector<unsigned char> *data,
+                             void *user_data);
 
-  bool GetImagesAsIs() const { return images_as_is_; }
+void StoreDiskGeometryCache(uint64_t key,
+                            const std::vector<unsigned char> &data,
+                            void *user_data);
+#endif
 
-  ///
-  /// Set maximum allowed external file size in bytes.
-  /// Default: 2GB
-  /// Only effective for built-in ReadWholeFileFunction FS function.
-  ///
-  void SetMaxExternalFileSize(size_t max_bytes) {
-    max_external_file_size_ = max_bytes;
-  }
+#ifdef TINYGLTF_ENABLE_MESHOPT
+///
+/// Decoders of the EXT_meshopt_compression bitstreams. Each returns false on
+/// malformed or unsupported(newer version) data.
+///
+/// ATTRIBUTES: `count` elements of `byte_stride` bytes(multiple of 4, <= 256).
+///
+bool DecodeMeshoptVertexBuffer(unsigned char *dst, size_t count,
+                               size_t byte_stride, const unsigned char *src,
+                               size_t src_size);
 
-  size_t GetMaxExternalFileSize() const { return max_external_file_size_; }
+///
+/// TRIANGLES: `count`(multiple of 3) indices of `index_size`(2 or 4) bytes.
+///
+bool DecodeMeshoptIndexBuffer(unsigned char *dst, size_t count,
+                              size_t index_size, const unsigned char *src,
+                              size_t src_size);
 
- private:
-  ///
-  /// Loads glTF asset from string(memory).
-  /// `length` = strlen(str);
-  /// Set warning message to `warn` for example it fails to load asserts
-  /// Returns false and set error string to `err` if there's an error.
-  ///
-  bool LoadFromString(Model *model, std::string *err, std::string *warn,
-                      const char *str, const unsigned int length,
-                      const std::string &base_dir, unsigned int check_sections);
+///
+/// INDICES: `count` indices of `index_size`(2 or 4) bytes.
+///
+bool DecodeMeshoptIndexSequence(unsigned char *dst, size_t count,
+                                size_t index_size, const unsigned char *src,
+                                size_t src_size);
 
-  const unsigned char *bin_data_ = nullptr;
-  size_t bin_size_ = 0;
-  bool is_binary_ = false;
+///
+/// Applies a decoding filter("NONE", "OCTAHEDRAL", "QUATERNION" or
+/// "EXPONENTIAL") in place on `count` decoded elements.
+///
+bool ApplyMeshoptFilter(unsigned char *data, size_t count, size_t byte_stride,
+                        const std::string &filter);
 
-  ParseStrictness strictness_ = ParseStrictness::Strict;
+///
+/// Decodes every bufferView with the EXT_meshopt_compression extension into
+/// its(fallback) buffer, in parallel. The loader calls this after parsing
+/// bufferViews, so accessors read the decoded data. The extension and the
+/// compressed buffer are kept as is. Decoded bufferViews are looked up in and
+/// stored to `cache` when given.
+///
+bool DecodeMeshoptCompression(Model *model, std::string *err = nullptr,
+                              int num_threads = 0,
+                              const GeometryCacheCallbacks *cache = nullptr);
 
-  bool serialize_default_values_ = false;  ///< Serialize default values?
+///
+/// Encoders of the EXT_meshopt_compression bitstreams(the inverse of the
+/// decoders above). The stream is appended to `dst`. Returns false when the
+/// input can not be encoded(e.g. invalid stride).
+///
+bool EncodeMeshoptVertexBuffer(std::vector<unsigned char> *dst,
+                               const unsigned char *src, size_t count,
+                               size_t byte_stride);
 
-  bool store_original_json_for_extras_and_extensions_ = false;
+/// TRIANGLES may rotate the vertices of triangles(the winding is kept).
+bool EncodeMeshoptIndexBuffer(std::vector<unsigned char> *dst,
+                              const unsigned char *src, size_t count,
+                              size_t index_size);
 
-  bool preserve_image_channels_ = false;  /// Default false(expand channels to
-                                          /// RGBA) for backward compatibility.
+bool EncodeMeshoptIndexSequence(std::vector<unsigned char> *dst,
+                                const unsigned char *src, size_t count,
+                                size_t index_size);
 
-  bool images_as_is_ = false; /// Default false (decode/decompress images)
+///
+/// Applies the encoding side of a filter in place. OCTAHEDRAL and QUATERNION
+/// take normalized BYTE/SHORT vectors(stride 4/8) and normalized SHORT
+/// quaternions(stride 8), EXPONENTIAL takes floats and keeps
+/// `exponential_bits`(1-24) bits of mantissa. The result is decoded with
+/// `ApplyMeshoptFilter`.
+///
+bool EncodeMeshoptFilter(unsigned char *data, size_t count, size_t byte_stride,
+                         const std::string &filter, int exponential_bits = 24);
+
+struct MeshoptEncodeOptions {
+  // Keep the uncompressed data in the original buffers for loaders without
+  // EXT_meshopt_compression support. When false, compressed bufferViews are
+  // moved to a fallback buffer which is written without data, and the
+  // extension becomes required.
+  bool keep_fallback{false};
+  bool compress_attributes{true};
+  bool compress_indices{true};
+  // OCTAHEDRAL filter for normalized BYTE/SHORT NORMAL and TANGENT.
+  bool octahedral_filter{false};
+  // QUATERNION filter for normalized SHORT rotation animation outputs.
+  bool quaternion_filter{false};
+  // EXPONENTIAL filter with this many mantissa bits(1-24) for FLOAT vertex
+  // attributes. 0 = disabled. Lossy.
+  int exponential_bits{0};
+  // Reclaim the bytes moved to the fallback buffer. Data this pass did not
+  // touch is kept(see `CompactBuffers`).
+  bool compact_buffers{true};
+  int num_threads{0};  // 0 = hardware concurrency.
+};
 
-  size_t max_external_file_size_{
-      size_t((std::numeric_limits<int32_t>::max)())};  // Default 2GB
+struct MeshoptEncodeReport {
+  size_t views{0};         // number of compressed bufferViews
+  size_t bytes_before{0};  // uncompressed size of them
+  size_t bytes_after{0};   // compressed size of them
+  double compression_ratio{1.0};
+};
 
-  // Warning & error messages
-  std::string warn_;
-  std::string err_;
+///
+/// Compresses vertex(ATTRIBUTES) and index(TRIANGLES/INDICES) bufferViews in
+/// parallel. Compressed streams are appended to buffers[0], and the
+/// EXT_meshopt_compression bufferView extension and `extensionsUsed` are
+/// filled in. bufferViews which do not get smaller are left as is. The
+/// uncompressed data is replaced by the decoded values(filtered attributes,
+/// rotated triangles), and min/max of filtered accessors are refreshed.
+///
+bool EncodeMeshoptCompression(
+    Model *model, const MeshoptEncodeOptions &options = MeshoptEncodeOptions(),
+    std::string *err = nullptr, MeshoptEncodeReport *report = nullptr);
+#endif
 
-  FsCallbacks fs = {
-#ifndef TINYGLTF_NO_FS
-      &tinygltf::FileExists,
-      &tinygltf::ExpandFilePath,
-      &tinygltf::ReadWholeFile,
-      &tinygltf::WriteWholeFile,
-      &tinygltf::GetFileSizeInBytes,
+#ifdef TINYGLTF_ENABLE_DRACO
+///
+/// Quantization bits of FLOAT attributes for Draco encoding. 0 = lossless.
+///
+struct DracoQuantization {
+  int position_bits{14};
+  int normal_bits{10};    // NORMAL, TANGENT
+  int texcoord_bits{12};  // TEXCOORD_n
+  int color_bits{8};      // COLOR_n
+  int generic_bits{12};   // other attributes
+};
 
-      nullptr  // Fs callback user data
-#else
-      nullptr, nullptr, nullptr, nullptr, nullptr,
+struct DracoEncodeOptions {
+  DracoQuantization quantization;
+  // Quantization of individual primitives, keyed by (mesh, primitive).
+  std::map<std::pair<int, int>, DracoQuantization> primitive_quantization;
+  int encode_speed{7};  // 0(best compression) - 10(fastest)
+  int decode_speed{7};  // 0(best compression) - 10(fastest)
+  // Remove the accessors/bufferViews/bytes of the compressed attributes. Data
+  // of other accessors and bufferViews is kept(see `CompactBuffers`).
+  bool compact_buffers{true};
+  int num_threads{0};  // 0 = hardware concurrency.
+};
 
-      nullptr  // Fs callback user data
+///
+/// Compresses triangle primitives(TRIANGLES, TRIANGLE_STRIP and
+/// TRIANGLE_FAN; primitives with morph targets are skipped) with
+/// KHR_draco_mesh_compression in parallel. The compressed data is appended
+/// to buffers[0] as a bufferView, and the primitive gets new accessors
+/// without bufferView(count/type stubs, POSITION with min/max) as the
+/// extension requires. The extension is added to `extensionsUsed` and
+/// `extensionsRequired`.
+///
+bool EncodeDracoCompression(
+    Model *model, const DracoEncodeOptions &options = DracoEncodeOptions(),
+    std::string *err = nullptr);
 #endif
-  };
 
-  URICallbacks uri_cb = {
-      // Use paths as-is by default. This will use JSON string escaping.
-      nullptr,
-      // Decode all URIs before using them as paths as the application may have
-      // percent encoded them.
-      &tinygltf::URIDecode,
-      // URI callback user data
-      nullptr};
+///
+/// Runs `task(i)` for every i in [0, num_tasks), possibly in parallel, and
+/// returns when all tasks have finished. The per-frame utilities
+/// (`UpdateFlatSceneTransforms`, `ComputeSkinPalettes`, `PosePrimitive`) use
+/// it instead of starting threads, so that they can run on the thread pool or
+/// job system of the application.
+///
+using TaskExecutorFunction = std::function<void(
+    size_t /* num_tasks */, const std::function<void(size_t)> & /* task */)>;
 
-  LoadImageDataFunction LoadImageData =
-#ifndef TINYGLTF_NO_STB_IMAGE
-      &tinygltf::LoadImageData;
-#else
-      nullptr;
-#endif
-  void *load_image_user_data_{nullptr};
-  bool user_image_loader_{false};
+///
+/// A scene flattened into arrays sorted by depth: the nodes of depth `d` are
+/// entries [level_offsets[d], level_offsets[d + 1]), and parents come before
+/// their children. Matrices are column major, 16 values per entry. The local
+/// transform of an entry is `local_matrices` when `has_matrix` is set(the
+/// node has a `matrix`), else T * R * S of `translations`, `rotations`(x, y,
+/// z, w) and `scales`.
+///
+struct FlatScene {
+  std::vector<int> nodes;             // Model node of each entry
+  std::vector<int> parents;           // Parent entry, -1 for root nodes
+  std::vector<size_t> level_offsets;  // Depth d + 1 entries(plus end)
+  std::vector<int> node_entries;  // Entry of each model node, -1 = not in scene
+
+  std::vector<double> translations;  // 3 per entry
+  std::vector<double> rotations;     // 4 per entry
+  std::vector<double> scales;        // 3 per entry
+  std::vector<unsigned char> has_matrix;
+
+  std::vector<double> local_matrices;  // 16 per entry
+  std::vector<double> world_matrices;  // 16 per entry
+  std::vector<float> world_matrices_f;  // `world_matrices` as float, when
+                                        // FlattenSceneOptions::float_matrices
+
+  // Entries whose local transform was modified. Set by the user, cleared by
+  // `UpdateFlatSceneTransforms`.
+  std::vector<unsigned char> dirty;
+};
 
-  WriteImageDataFunction WriteImageData =
-#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
-      &tinygltf::WriteImageData;
-#else
-      nullptr;
-#endif
-  void *write_image_user_data_{nullptr};
+struct FlattenSceneOptions {
+  bool float_matrices{false};  // Also fill `FlatScene::world_matrices_f`
+  int num_threads{1};  // 1 = calling thread only, 0 = hardware concurrency.
+  TaskExecutorFunction executor;  // Used instead of `num_threads` when set.
 };
 
-#ifdef __clang__
-#pragma clang diagnostic pop  // -Wpadded
-#endif
+///
+/// Flattens the node hierarchy of `scene`(-1 = `defaultScene`, or the first
+/// scene) and computes local and world matrices. The nodes of each depth are
+/// processed in parallel. Returns false when the hierarchy is not a tree
+/// (a node with several parents, or a cycle) or refers to invalid nodes.
+///
+bool FlattenScene(const Model &model, int scene, FlatScene *flat,
+                  const FlattenSceneOptions &options = FlattenSceneOptions(),
+                  std::string *err = nullptr);
 
-}  // namespace tinygltf
+///
+/// Recomputes the local matrices of `dirty` entries and the world matrices of
+/// their subtrees, depth by depth, then clears `dirty`. Depths with more than
+/// 1024 entries are split into tasks for `options.executor`; without an
+/// executor, `num_threads` other than 1 starts threads on every call.
+///
+void UpdateFlatSceneTransforms(
+    FlatScene *flat,
+    const FlattenSceneOptions &options = FlattenSceneOptions());
+
+enum AnimationPath {
+  ANIMATION_PATH_TRANSLATION,
+  ANIMATION_PATH_ROTATION,
+  ANIMATION_PATH_SCALE,
+  ANIMATION_PATH_WEIGHTS
+};
 
-#endif  // TINY_GLTF_H_
+enum AnimationInterpolation {
+  ANIMATION_INTERPOLATION_LINEAR,
+  ANIMATION_INTERPOLATION_STEP,
+  ANIMATION_INTERPOLATION_CUBICSPLINE
+};
 
-#if defined(TINYGLTF_IMPLEMENTATION) || defined(__INTELLISENSE__)
-#include <algorithm>
-// #include <cassert>
-#ifndef TINYGLTF_NO_FS
-#include <sys/stat.h>  // for is_directory check
+///
+/// A channel of an `AnimationClip`. The keyframe times are
+/// `times[input, input + num_keys)`. The values of key `k` start at
+/// `values[output + k * components]`, or `values[output + 3 * k * components]`
+/// for CUBICSPLINE(in-tangent, value and out-tangent). The sampled value goes
+/// to `pose[pose_offset, pose_offset + components)`.
+///
+struct AnimationClipChannel {
+  int node{-1};
+  AnimationPath path{ANIMATION_PATH_TRANSLATION};
+  AnimationInterpolation interpolation{ANIMATION_INTERPOLATION_LINEAR};
+  size_t components{0};  // 3, 4(rotation) or the number of morph targets
+  size_t input{0};
+  size_t num_keys{0};
+  size_t output{0};
+  size_t pose_offset{0};
+};
 
-#include <cstdio>
-#include <fstream>
-#endif
-#include <sstream>
+///
+/// An animation with the sampler inputs and outputs resolved into float
+/// arrays(an input accessor shared by samplers is stored once). Channels
+/// which do not target a node are skipped.
+///
+struct AnimationClip {
+  std::vector<float> times;
+  std::vector<float> values;
+  std::vector<AnimationClipChannel> channels;
+  std::vector<size_t> slerp_channels;  // LINEAR rotation channels
+  size_t pose_size{0};                 // Floats of a sampled pose
+  float start_time{0.0f};
+  float end_time{0.0f};
+};
 
-#ifdef __clang__
-// Disable some warnings for external files.
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wfloat-equal"
-#pragma clang diagnostic ignored "-Wexit-time-destructors"
-#pragma clang diagnostic ignored "-Wconversion"
-#pragma clang diagnostic ignored "-Wold-style-cast"
-#pragma clang diagnostic ignored "-Wglobal-constructors"
-#if __has_warning("-Wreserved-id-macro")
-#pragma clang diagnostic ignored "-Wreserved-id-macro"
-#endif
-#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
-#pragma clang diagnostic ignored "-Wpadded"
-#pragma clang diagnostic ignored "-Wc++98-compat"
-#pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
-#pragma clang diagnostic ignored "-Wdocumentation-unknown-command"
-#pragma clang diagnostic ignored "-Wswitch-enum"
-#pragma clang diagnostic ignored "-Wimplicit-fallthrough"
-#pragma clang diagnostic ignored "-Wweak-vtables"
-#pragma clang diagnostic ignored "-Wcovered-switch-default"
-#if __has_warning("-Wdouble-promotion")
-#pragma clang diagnostic ignored "-Wdouble-promotion"
-#endif
-#if __has_warning("-Wcomma")
-#pragma clang diagnostic ignored "-Wcomma"
-#endif
-#if __has_warning("-Wzero-as-null-pointer-constant")
-#pragma clang diagnostic ignored "-Wzero-as-null-pointer-constant"
-#endif
-#if __has_warning("-Wcast-qual")
-#pragma clang diagnostic ignored "-Wcast-qual"
-#endif
-#if __has_warning("-Wmissing-variable-declarations")
-#pragma clang diagnostic ignored "-Wmissing-variable-declarations"
-#endif
-#if __has_warning("-Wmissing-prototypes")
-#pragma clang diagnostic ignored "-Wmissing-prototypes"
-#endif
-#if __has_warning("-Wcast-align")
-#pragma clang diagnostic ignored "-Wcast-align"
-#endif
-#if __has_warning("-Wnewline-eof")
-#pragma clang diagnostic ignored "-Wnewline-eof"
-#endif
-#if __has_warning("-Wunused-parameter")
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#endif
-#if __has_warning("-Wmismatched-tags")
-#pragma clang diagnostic ignored "-Wmismatched-tags"
-#endif
-#if __has_warning("-Wextra-semi-stmt")
-#pragma clang diagnostic ignored "-Wextra-semi-stmt"
-#endif
-#endif
+///
+/// Playback state of an `AnimationClip`: the current key of each channel
+/// (lookups are amortized O(1) when the time moves monotonically), and
+/// scratch arrays. Use one cursor per animated instance.
+///
+struct AnimationCursor {
+  std::vector<size_t> keys;
+  std::vector<float> from;
+  std::vector<float> to;
+  std::vector<float> weights;
+};
 
-// Disable GCC warnings
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wtype-limits"
-#endif  // __GNUC__
+///
+/// Resolves `model.animations[animation]` into `clip`. Returns false when a
+/// sampler or an accessor is invalid.
+///
+bool CompileAnimation(const Model &model, int animation, AnimationClip *clip,
+                      std::string *err = nullptr);
 
-#ifndef TINYGLTF_NO_INCLUDE_JSON
-#ifndef TINYGLTF_USE_RAPIDJSON
-#include "json.hpp"
-#else
-#ifndef TINYGLTF_NO_INCLUDE_RAPIDJSON
-#include "document.h"
-#include "prettywriter.h"
-#include "rapidjson.h"
-#include "stringbuffer.h"
-#include "writer.h"
-#endif
-#endif
-#endif
+///
+/// Samples all channels of `clip` at `time`(clamped to the keyframe range)
+/// into `pose`(`clip.pose_size` floats). Rotations are interpolated with
+/// slerp 4 channels at a time, other LINEAR values with 4-wide lerp
+/// (SSE2/NEON).
+///
+void SampleAnimation(const AnimationClip &clip, float time,
+                     AnimationCursor *cursor, float *pose);
 
-#ifdef TINYGLTF_ENABLE_DRACO
-#include "draco/compression/decode.h"
-#include "draco/core/decoder_buffer.h"
-#endif
+///
+/// Writes a sampled pose into the translation, rotation, scale and weights of
+/// the nodes of `model`.
+///
+void ApplyAnimationPose(const AnimationClip &clip, const float *pose,
+                        Model *model);
 
-#ifndef TINYGLTF_NO_STB_IMAGE
-#ifndef TINYGLTF_NO_INCLUDE_STB_IMAGE
-#include "stb_image.h"
-#endif
-#endif
+///
+/// Writes a sampled pose into the TRS arrays of `scene` and marks the
+/// animated entries dirty(see `UpdateFlatSceneTransforms`). Morph weights
+/// and nodes which are not in the scene are skipped.
+///
+void ApplyAnimationPose(const AnimationClip &clip, const float *pose,
+                        FlatScene *scene);
+
+struct AnimationOptimizeOptions {
+  // Resampling rate in Hz(0 = keep the keyframe times). Samplers are only
+  // resampled when it reduces their number of keys.
+  double resample_rate{0.0};
+  // Maximum error of the removed keyframes, per target path.
+  double translation_tolerance{1e-4};  // Distance
+  double rotation_tolerance{1e-3};     // Angle in radians
+  double scale_tolerance{1e-4};
+  double weights_tolerance{1e-4};
+  // Remove the input/output accessors(and their bufferViews/bytes) of the
+  // rewritten samplers. Data of other accessors is kept(see `CompactBuffers`).
+  bool compact_buffers{true};
+  int num_threads{0};  // 0 = hardware concurrency.
+};
 
-#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
-#ifndef TINYGLTF_NO_INCLUDE_STB_IMAGE_WRITE
-#include "stb_image_write.h"
-#endif
-#endif
+struct AnimationOptimizeReport {
+  size_t samplers{0};  // Rewritten samplers
+  size_t keys_before{0};
+  size_t keys_after{0};
+  size_t bytes_before{0};  // Size of all buffers before the pass
+  size_t bytes_after{0};   // Size of all buffers after the pass
+  double compression_ratio{1.0};  // bytes_before / bytes_after
+};
 
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
+///
+/// Resamples LINEAR and STEP animation samplers and removes the keyframes
+/// which interpolation of the remaining keys reproduces within the
+/// tolerance. Samplers sharing an input accessor keep a common input(a key
+/// is removed only when all of them allow it), and are processed in parallel
+/// per input. New float accessors are appended to `model->buffers[0]`, and
+/// the replaced input/output accessors are removed when `compact_buffers` is
+/// set(otherwise the buffers grow). CUBICSPLINE samplers and non-float data
+/// are left as is.
+///
+bool OptimizeAnimations(
+    Model *model,
+    const AnimationOptimizeOptions &options = AnimationOptimizeOptions(),
+    std::string *err = nullptr, AnimationOptimizeReport *report = nullptr);
 
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
+///
+/// Joints and inverse bind matrices(as float, 16 per joint, column major) of
+/// all skins of a model, for `ComputeSkinPalettes`. The joints of skin `s`
+/// are [skin_offsets[s], skin_offsets[s + 1]).
+///
+struct SkinPaletteData {
+  std::vector<size_t> skin_offsets;  // Number of skins + 1
+  std::vector<int> joints;           // Node of each joint
+  std::vector<float> inverse_bind_matrices;
+};
 
-#ifdef _WIN32
+///
+/// Loads the joints and inverse bind matrices of `model.skins`(identity when
+/// a skin has no inverseBindMatrices). Returns false when a skin refers to an
+/// invalid node or accessor.
+///
+bool PrepareSkinPalettes(const Model &model, SkinPaletteData *data,
+                         std::string *err = nullptr);
 
-// issue 143.
-// Define NOMINMAX to avoid min/max defines,
-// but undef it after included Windows.h
-#ifndef NOMINMAX
-#define TINYGLTF_INTERNAL_NOMINMAX
-#define NOMINMAX
-#endif
+///
+/// Computes world(joint) * inverse bind matrix of every joint of every skin
+/// into `palettes`(16 floats per joint, `data.joints` order) with SIMD 4x4
+/// multiplies. `world_matrices` holds 16 floats per model node.
+/// The transform of the skinned mesh node and `Skin::skeleton` are not used,
+/// as the glTF spec requires.
+/// By default the palettes are computed on the calling thread. Chunks of 256
+/// joints are run on `executor` when it is given, else on `num_threads`
+/// threads(0 = hardware concurrency) which are started for the call.
+///
+void ComputeSkinPalettes(
+    const SkinPaletteData &data, const float *world_matrices, float *palettes,
+    int num_threads = 1,
+    const TaskExecutorFunction &executor = TaskExecutorFunction());
 
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#define TINYGLTF_INTERNAL_WIN32_LEAN_AND_MEAN
-#endif
-#ifndef __MINGW32__
-#include <Windows.h>  // include API for expanding a file path
-#else
-#include <windows.h>
-#endif
+///
+/// Same as above, with the world matrices of a flattened scene
+/// (`world_matrices_f` when present). Joints which are not in the scene use
+/// the identity.
+///
+void ComputeSkinPalettes(
+    const SkinPaletteData &data, const FlatScene &scene, float *palettes,
+    int num_threads = 1,
+    const TaskExecutorFunction &executor = TaskExecutorFunction());
 
-#ifdef TINYGLTF_INTERNAL_WIN32_LEAN_AND_MEAN
-#undef WIN32_LEAN_AND_MEAN
-#endif
+///
+/// Posed vertex attributes of a primitive. `normals`(3 floats per vertex)
+/// and `tangents`(4 floats per vertex, w is kept) are empty when the
+/// primitive has no NORMAL or TANGENT.
+///
+struct PosedPrimitive {
+  std::vector<float> positions;  // 3 floats per vertex
+  std::vector<float> normals;
+  std::vector<float> tangents;
+};
 
-#if defined(TINYGLTF_INTERNAL_NOMINMAX)
-#undef NOMINMAX
-#endif
+struct PosePrimitiveOptions {
+  bool normalize_normals{true};  // Renormalize normals and tangents.
+  // Accessor conversion and chunks of 2048 vertices run on `executor` when it
+  // is set, else on `num_threads` threads started for the call(1 = calling
+  // thread only, 0 = hardware concurrency).
+  int num_threads{1};
+  TaskExecutorFunction executor;
+};
 
-#if defined(__GLIBCXX__)  // mingw
+///
+/// Returns the morph target weights of `node`: `Node::weights`, or the
+/// `Mesh::weights` of its mesh when the node has none.
+///
+std::vector<float> GetMorphWeights(const Model &model, int node);
 
-#include <fcntl.h>  // _O_RDONLY
+///
+/// Poses POSITION, NORMAL and TANGENT of `model.meshes[mesh].primitives
+/// [primitive]` on the CPU: morph targets are blended with `weights`
+/// (`num_weights` floats, missing weights are 0, see `GetMorphWeights`), then
+/// linear blend skinning with JOINTS_n/WEIGHTS_n is applied when `palette`
+/// is given(16 floats per joint of the skin, e.g. from `ComputeSkinPalettes`;
+/// influences of joints >= `num_joints` are ignored). Normals are transformed
+/// with the inverse transpose of the blended matrix.
+/// Sparse morph targets without bufferView are applied at their sparse
+/// indices only, without densifying. Vertices are processed in parallel
+/// chunks with SIMD.
+/// Returns false when the primitive or its accessors are invalid.
+///
+bool PosePrimitive(const Model &model, int mesh, int primitive,
+                   const float *weights, size_t num_weights,
+                   const float *palette, size_t num_joints,
+                   PosedPrimitive *out,
+                   const PosePrimitiveOptions &options = PosePrimitiveOptions(),
+                   std::string *err = nullptr);
 
-#include <ext/stdio_filebuf.h>  // fstream (all sorts of IO stuff) + stdio_filebuf (=streambuf)
+///
+/// URIEncodeFunction type. Signature for custom URI encoding of external
+/// resources such as .bin and image files. Used by tinygltf to re-encode the
+/// final location of saved files. object_type may be used to encode buffer and
+/// image URIs differently, for example. See
+/// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#uris
+///
+using URIEncodeFunction = std::function<bool(
+    const std::string & /* in_uri */, const std::string & /* object_type */,
+    std::string * /* out_uri */, void * /* user_data */)>;
 
-#endif
+///
+/// URIDecodeFunction type. Signature for custom URI decoding of external
+/// resources such as .bin and image files. Used by tinygltf when computing
+/// filenames to write resources.
+///
+using URIDecodeFunction =
+    std::function<bool(const std::string & /* in_uri */,
+                       std::string * /* out_uri */, void * /* user_data */)>;
 
-#elif !defined(__ANDROID__) && !defined(__OpenBSD__)
-// #include <wordexp.h>
-#endif
+// Declaration of default uri decode function
+bool URIDecode(const std::string &in_uri, std::string *out_uri,
+               void *user_data);
 
-#if defined(__sparcv9) || defined(__powerpc__)
-// Big endian
-#else
-#if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || MINIZ_X86_OR_X64_CPU
-#define TINYGLTF_LITTLE_ENDIAN 1
-#endif
-#endif
+///
+/// A structure containing URI callbacks and a pointer to their user data.
+///
+struct URICallbacks {
+  URIEncodeFunction encode;  // Optional encode method
+  URIDecodeFunction decode;  // Required decode method
 
-namespace tinygltf {
-namespace detail {
-#ifdef TINYGLTF_USE_RAPIDJSON
+  void *user_data;  // An argument that is passed to all uri callbacks
+};
 
-#ifdef TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
-// This uses the RapidJSON CRTAllocator.  It is thread safe and multiple
-// documents may be active at once.
-using json =
-    rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
-using json_iterator = json::MemberIterator;
-using json_const_iterator = json::ConstMemberIterator;
-using json_const_array_iterator = json const *;
-using JsonDocument =
-    rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
-rapidjson::CrtAllocator s_CrtAllocator;  // stateless and thread safe
-rapidjson::CrtAllocator &GetAllocator() { return s_CrtAllocator; }
-#else
-// This uses the default RapidJSON MemoryPoolAllocator.  It is very fast, but
-// not thread safe. Only a single JsonDocument may be active at any one time,
-// meaning only a single gltf load/save can be active any one time.
-using json = rapidjson::Value;
-using json_iterator = json::MemberIterator;
-using json_const_iterator = json::ConstMemberIterator;
-using json_const_array_iterator = json const *;
-rapidjson::Document *s_pActiveDocument = nullptr;
-rapidjson::Document::AllocatorType &GetAllocator() {
-  assert(s_pActiveDocument);  // Root json node must be JsonDocument type
-  return s_pActiveDocument->GetAllocator();
-}
+///
+/// FileExistsFunction type. Signature for custom filesystem callbacks.
+///
+using FileExistsFunction = std::function<bool(
+    const std::string & /* abs_filename */, void * /* user_data */)>;
 
-#ifdef __clang__
-#pragma clang diagnostic push
-// Suppress JsonDocument(JsonDocument &&rhs) noexcept
-#pragma clang diagnostic ignored "-Wunused-member-function"
-#endif
+///
+/// ExpandFilePathFunction type. Signature for custom filesystem callbacks.
+///
+using ExpandFilePathFunction =
+    std::function<std::string(const std::string &, void *)>;
 
-struct JsonDocument : public rapidjson::Document {
-  JsonDocument() {
-    assert(s_pActiveDocument ==
-           nullptr);  // When using default allocator, only one document can be
-                      // active at a time, if you need multiple active at once,
-                      // define TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
-    s_pActiveDocument = this;
-  }
-  JsonDocument(const JsonDocument &) = delete;
-  JsonDocument(JsonDocument &&rhs) noexcept
-      : rapidjson::Document(std::move(rhs)) {
-    s_pActiveDocument = this;
-    rhs.isNil = true;
-  }
-  ~JsonDocument() {
-    if (!isNil) {
-      s_pActiveDocument = nullptr;
-    }
-  }
+///
+/// ReadWholeFileFunction type. Signature for custom filesystem callbacks.
+///
+using ReadWholeFileFunction = std::function<bool(
+    std::vector<unsigned char> *, std::string *, const std::string &, void *)>;
 
- private:
-  bool isNil = false;
-};
+///
+/// WriteWholeFileFunction type. Signature for custom filesystem callbacks.
+///
+using WriteWholeFileFunction =
+    std::function<bool(std::string *, const std::string &,
+                       const std::vector<unsigned char> &, void *)>;
 
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
+///
+/// GetFileSizeFunction type. Signature for custom filesystem callbacks.
+///
+using GetFileSizeFunction =
+    std::function<bool(size_t *filesize_out, std::string *err,
+                       const std::string &abs_filename, void *userdata)>;
 
-#endif  // TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
+///
+/// ReadFileRangeFunction type. Signature for custom filesystem callbacks.
+/// Reads up to `length` bytes from `offset`. `out` is shorter than `length`
+/// at the end of file.
+///
+using ReadFileRangeFunction =
+    std::function<bool(std::vector<unsigned char> *out, std::string *err,
+                       const std::string &abs_filename, size_t offset,
+                       size_t length, void *userdata)>;
 
-#else
-using nlohmann::json;
-using json_iterator = json::iterator;
-using json_const_iterator = json::const_iterator;
-using json_const_array_iterator = json_const_iterator;
-using JsonDocument = json;
+///
+/// A structure containing all required filesystem callbacks and a pointer to
+/// their user data.
+///
+struct FsCallbacks {
+  FileExistsFunction FileExists;
+  ExpandFilePathFunction ExpandFilePath;
+  ReadWholeFileFunction ReadWholeFile;
+  WriteWholeFileFunction WriteWholeFile;
+  GetFileSizeFunction GetFileSizeInBytes;  // To avoid GetFileSize Win32 API,
+                                           // add `InBytes` suffix.
+
+  void *user_data;  // An argument that is passed to all fs callbacks
+
+  // Optional. Used to read only the header of external images. `ReadWholeFile`
+  // is used when not set.
+  ReadFileRangeFunction ReadFileRange;
+};
+
+#ifndef TINYGLTF_NO_FS
+// Declaration of default filesystem callbacks
+
+bool FileExists(const std::string &abs_filename, void *);
+
+///
+/// Expand file path(e.g. `~` to home directory on posix, `%APPDATA%` to
+/// `C:\\Users\\tinygltf\\AppData`)
+///
+/// @param[in] filepath File path string. Assume UTF-8
+/// @param[in] userdata User data. Set to `nullptr` if you don't need it.
+///
+std::string ExpandFilePath(const std::string &filepath, void *userdata);
+
+bool ReadWholeFile(std::vector<unsigned char> *out, std::string *err,
+                   const std::string &filepath, void *);
+
+bool ReadFileRange(std::vector<unsigned char> *out, std::string *err,
+                   const std::string &filepath, size_t offset, size_t length,
+                   void *);
+
+bool WriteWholeFile(std::string *err, const std::string &filepath,
+                    const std::vector<unsigned char> &contents, void *);
+
+bool GetFileSizeInBytes(size_t *filesize_out, std::string *err,
+                        const std::string &filepath, void *);
 #endif
 
-void JsonParse(JsonDocument &doc, const char *str, size_t length,
-               bool throwExc = false) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  (void)throwExc;
-  doc.Parse(str, length);
-#else
-  doc = detail::json::parse(str, str + length, nullptr, throwExc);
+///
+/// LoadImageDataFunction type. Signature for custom image loading callbacks.
+///
+using LoadImageDataFunction = std::function<bool(
+    Image * /* image */, const int /* image_idx */, std::string * /* err */,
+    std::string * /* warn */, int /* req_width */, int /* req_height */,
+    const unsigned char * /* bytes */, int /* size */, void * /*user_data */)>;
+
+///
+/// WriteImageDataFunction type. Signature for custom image writing callbacks.
+/// The out_uri parameter becomes the URI written to the gltf and may reference
+/// a file or contain a data URI.
+///
+using WriteImageDataFunction = std::function<bool(
+    const std::string * /* basepath */, const std::string * /* filename */,
+    const Image *image, bool /* embedImages */,
+    const FsCallbacks * /* fs_cb */, const URICallbacks * /* uri_cb */,
+    std::string * /* out_uri */, void * /* user_pointer */)>;
+
+///
+/// ImageDecodeFunction type. Signature for image decoder backends used by the
+/// builtin image loader. Decode `bytes` into `out` as tightly packed 8bit or
+/// 16bit(native endian) pixels, and set `width`, `height`, `component` and
+/// `bits`. `req_component` is the requested number of channels(0 = as
+/// stored). A backend may ignore it; the builtin loader converts channels
+/// afterwards.
+///
+using ImageDecodeFunction = std::function<bool(
+    std::vector<unsigned char> * /* out */, int * /* width */,
+    int * /* height */, int * /* component */, int * /* bits */,
+    int /* req_component */, const unsigned char * /* bytes */, int /* size */,
+    std::string * /* err */, void * /* user_data */)>;
+
+///
+/// Image decoder backend registered for a MIME type.
+///
+struct ImageDecoder {
+  ImageDecodeFunction decode;
+  void *user_data{nullptr};
+};
+
+///
+/// Returns the MIME type("image/jpeg", "image/png", ...) of an encoded image
+/// by looking at its magic bytes, or an empty string if unknown.
+///
+std::string GetImageMimeType(const unsigned char *bytes, size_t size);
+
+#ifdef TINYGLTF_ENABLE_LIBJPEG_TURBO
+// Image decoder backend using the libjpeg API of libjpeg-turbo. Register with
+// `TinyGLTF::SetImageDecoder("image/jpeg", DecodeImageLibjpegTurbo, nullptr)`
+bool DecodeImageLibjpegTurbo(std::vector<unsigned char> *out, int *width,
+                             int *height, int *component, int *bits,
+                             int req_component, const unsigned char *bytes,
+                             int size, std::string *err, void *user_data);
 #endif
-}
-}  // namespace detail
-}  // namespace tinygltf
 
-#ifdef __APPLE__
-#include "TargetConditionals.h"
+#ifdef TINYGLTF_ENABLE_SPNG
+// Image decoder backend using libspng. Register with
+// `TinyGLTF::SetImageDecoder("image/png", DecodeImageSpng, nullptr)`
+bool DecodeImageSpng(std::vector<unsigned char> *out, int *width, int *height,
+                     int *component, int *bits, int req_component,
+                     const unsigned char *bytes, int size, std::string *err,
+                     void *user_data);
+#endif
+
+// Declaration of default image loader callback. With TINYGLTF_NO_STB_IMAGE it
+// only decodes images with the backends set by `TinyGLTF::SetImageDecoder`.
+bool LoadImageData(Image *image, const int image_idx, std::string *err,
+                   std::string *warn, int req_width, int req_height,
+                   const unsigned char *bytes, int size, void *);
+
+#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
+// Declaration of default image writer callback
+bool WriteImageData(const std::string *basepath, const std::string *filename,
+                    const Image *image, bool embedImages,
+                    const FsCallbacks* fs_cb, const URICallbacks *uri_cb,
+                    std::string *out_uri, void *);
 #endif
 
+///
+/// glTF Parser/Serializer context.
+///
+class TinyGLTF {
+ public:
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wc++98-compat"
 #endif
 
-namespace tinygltf {
+  TinyGLTF() = default;
 
-///
-/// Internal LoadImageDataOption struct.
-/// This struct is passed through `user_pointer` in LoadImageData.
-/// The struct is not passed when the user supply their own LoadImageData
-/// callbacks.
-///
-struct LoadImageDataOption {
-  // true: preserve image channels(e.g. load as RGB image if the image has RGB
-  // channels) default `false`(channels are expanded to RGBA for backward
-  // compatibility).
-  bool preserve_channels{false};
-  // true: do not decode/decompress image data.
-  // default `false`: decode/decompress image data.
-  bool as_is{false};
-};
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
 
-// Equals function for Value, for recursivity
-static bool Equals(const tinygltf::Value &one, const tinygltf::Value &other) {
-  if (one.Type() != other.Type()) return false;
+  ~TinyGLTF() = default;
 
-  switch (one.Type()) {
-    case NULL_TYPE:
-      return true;
-    case BOOL_TYPE:
-      return one.Get<bool>() == other.Get<bool>();
-    case REAL_TYPE:
-      return TINYGLTF_DOUBLE_EQUAL(one.Get<double>(), other.Get<double>());
-    case INT_TYPE:
-      return one.Get<int>() == other.Get<int>();
-    case OBJECT_TYPE: {
-      auto oneObj = one.Get<tinygltf::Value::Object>();
-      auto otherObj = other.Get<tinygltf::Value::Object>();
-      if (oneObj.size() != otherObj.size()) return false;
-      for (auto &it : oneObj) {
-        auto otherIt = otherObj.find(it.first);
-        if (otherIt == otherObj.end()) return false;
+  ///
+  /// Loads glTF ASCII asset from a file.
+  /// Set warning message to `warn` for example it fails to load asserts.
+  /// Returns false and set error string to `err` if there's an error.
+  ///
+  bool LoadASCIIFromFile(Model *model, std::string *err, std::string *warn,
+                         const std::string &filename,
+                         unsigned int check_sections = REQUIRE_VERSION);
 
-        if (!Equals(it.second, otherIt->second)) return false;
-      }
-      return true;
-    }
-    case ARRAY_TYPE: {
-      if (one.Size() != other.Size()) return false;
-      for (size_t i = 0; i < one.Size(); ++i)
-        if (!Equals(one.Get(i), other.Get(i))) return false;
-      return true;
-    }
-    case STRING_TYPE:
-      return one.Get<std::string>() == other.Get<std::string>();
-    case BINARY_TYPE:
-      return one.Get<std::vector<unsigned char> >() ==
-             other.Get<std::vector<unsigned char> >();
-    default: {
-      // unhandled type
-      return false;
-    }
-  }
-}
+  ///
+  /// Loads glTF ASCII asset from string(memory).
+  /// `length` = strlen(str);
+  /// `base_dir` is a search path of glTF asset(e.g. images). Path Must be an
+  /// expanded path (e.g. no tilde(`~`), no environment variables). Set warning
+  /// message to `warn` for example it fails to load asserts. Returns false and
+  /// set error string to `err` if there's an error.
+  ///
+  bool LoadASCIIFromString(Model *model, std::string *err, std::string *warn,
+                           const char *str, const unsigned int length,
+                           const std::string &base_dir,
+                           unsigned int check_sections = REQUIRE_VERSION);
 
-// Equals function for std::vector<double> using TINYGLTF_DOUBLE_EPSILON
-static bool Equals(const std::vector<double> &one,
-                   const std::vector<double> &other) {
-  if (one.size() != other.size()) return false;
-  for (int i = 0; i < int(one.size()); ++i) {
-    if (!TINYGLTF_DOUBLE_EQUAL(one[size_t(i)], other[size_t(i)])) return false;
-  }
-  return true;
-}
+  ///
+  /// Loads glTF binary asset from a file.
+  /// Set warning message to `warn` for example it fails to load asserts.
+  /// Returns false and set error string to `err` if there's an error.
+  ///
+  bool LoadBinaryFromFile(Model *model, std::string *err, std::string *warn,
+                          const std::string &filename,
+                          unsigned int check_sections = REQUIRE_VERSION);
 
-bool Accessor::operator==(const Accessor &other) const {
-  return this->bufferView == other.bufferView &&
-         this->byteOffset == other.byteOffset &&
-         this->componentType == other.componentType &&
-         this->count == other.count && this->extensions == other.extensions &&
-         this->extras == other.extras &&
-         Equals(this->maxValues, other.maxValues) &&
-         Equals(this->minValues, other.minValues) && this->name == other.name &&
-         this->normalized == other.normalized && this->type == other.type;
-}
-bool Animation::operator==(const Animation &other) const {
-  return this->channels == other.channels &&
-         this->extensions == other.extensions && this->extras == other.extras &&
-         this->name == other.name && this->samplers == other.samplers;
-}
-bool AnimationChannel::operator==(const AnimationChannel &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->target_node == other.target_node &&
-         this->target_path == other.target_path &&
-         this->sampler == other.sampler;
-}
-bool AnimationSampler::operator==(const AnimationSampler &other) const {
-  return this->extras == other.extras && this->extensions == other.extensions &&
-         this->input == other.input &&
-         this->interpolation == other.interpolation &&
-         this->output == other.output;
-}
-bool Asset::operator==(const Asset &other) const {
-  return this->copyright == other.copyright &&
-         this->extensions == other.extensions && this->extras == other.extras &&
-         this->generator == other.generator &&
-         this->minVersion == other.minVersion && this->version == other.version;
-}
-bool Buffer::operator==(const Buffer &other) const {
-  return this->data == other.data && this->extensions == other.extensions &&
-         this->extras == other.extras && this->name == other.name &&
-         this->uri == other.uri;
-}
-bool BufferView::operator==(const BufferView &other) const {
-  return this->buffer == other.buffer && this->byteLength == other.byteLength &&
-         this->byteOffset == other.byteOffset &&
-         this->byteStride == other.byteStride && this->name == other.name &&
-         this->target == other.target && this->extensions == other.extensions &&
-         this->extras == other.extras &&
-         this->dracoDecoded == other.dracoDecoded;
-}
-bool Camera::operator==(const Camera &other) const {
-  return this->name == other.name && this->extensions == other.extensions &&
-         this->extras == other.extras &&
-         this->orthographic == other.orthographic &&
-         this->perspective == other.perspective && this->type == other.type;
-}
-bool Image::operator==(const Image &other) const {
-  return this->bufferView == other.bufferView &&
+  ///
+  /// Loads glTF binary asset from memory.
+  /// `length` = strlen(str);
+  /// `base_dir` is a search path of glTF asset(e.g. images). Path Must be an
+  /// expanded path (e.g. no tilde(`~`), no environment variables).
+  /// Set warning message to `warn` for example it fails to load asserts.
+  /// Returns false and set error string to `err` if there's an error.
+  ///
+  bool LoadBinaryFromMemory(Model *model, std::string *err, std::string *warn,
+                            const unsigned char *bytes,
+                            const unsigned int length,
+                            const std::string &base_dir = "",
+                            unsigned int check_sections = REQUIRE_VERSION);
+
+  ///
+  /// Write glTF to stream, buffers and images will be embedded
+  ///
+  bool WriteGltfSceneToStream(const Model *model, std::ostream &stream,
+                              bool prettyPrint, bool writeBinary);
+
+  ///
+  /// Write glTF to file.
+  ///
+  bool WriteGltfSceneToFile(const Model *model, const std::string &filename,
+                            bool embedImages, bool embedBuffers,
+                            bool prettyPrint, bool writeBinary);
+
+  ///
+  /// Sets the parsing strictness.
+  ///
+  void SetParseStrictness(ParseStrictness strictness);
+
+  ///
+  /// Set callback to use for loading image data. Passing the nullptr is akin to
+  /// calling RemoveImageLoader().
+  ///
+  void SetImageLoader(LoadImageDataFunction LoadImageData, void *user_data);
+
+  ///
+  /// Unset(remove) callback of loading image data
+  ///
+  void RemoveImageLoader();
+
+  ///
+  /// Set image decoder backend used by the builtin image loader for images of
+  /// `mime_type`(e.g. "image/jpeg"). The MIME type is detected from the magic
+  /// bytes of the image. When the backend fails, stb_image is used(with
+  /// TINYGLTF_NO_STB_IMAGE, the backends are the only decoders).
+  /// Passing the nullptr is akin to calling RemoveImageDecoder().
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImageDecoder(const std::string &mime_type, ImageDecodeFunction func,
+                       void *user_data);
+
+  ///
+  /// Unset(remove) image decoder backend for `mime_type`
+  ///
+  void RemoveImageDecoder(const std::string &mime_type);
+
+  ///
+  /// Set callback to use for writing image data
+  ///
+  void SetImageWriter(WriteImageDataFunction WriteImageData, void *user_data);
+
+  ///
+  /// Set callbacks to use for URI encoding and decoding and their user data.
+  /// Returns false if there is an error with the callbacks. If err is not
+  /// nullptr, explanation will be written there.
+  ///
+  bool SetURICallbacks(URICallbacks callbacks, std::string* err = nullptr);
+
+  ///
+  /// Set callbacks to use for filesystem (fs) access and their user data.
+  /// Returns false if there is an error with the callbacks. If err is not
+  /// nullptr, explanation will be written there.
+  ///
+  bool SetFsCallbacks(FsCallbacks callbacks, std::string* err = nullptr);
+
+  ///
+  /// Set serializing default values(default = false).
+  /// When true, default values are force serialized to .glTF.
+  /// This may be helpful if you want to serialize a full description of glTF
+  /// data.
+  ///
+  /// TODO(LTE): Supply parsing option as function arguments to
+  /// `LoadASCIIFromFile()` and others, not by a class method
+  ///
+  void SetSerializeDefaultValues(const bool enabled) {
+    serialize_default_values_ = enabled;
+  }
+
+  bool GetSerializeDefaultValues() const { return serialize_default_values_; }
+
+  ///
+  /// Store original JSON string for `extras` and `extensions`.
+  /// This feature will be useful when the user want to reconstruct custom data
+  /// structure from JSON string.
+  ///
+  void SetStoreOriginalJSONForExtrasAndExtensions(const bool enabled) {
+    store_original_json_for_extras_and_extensions_ = enabled;
+  }
+
+  bool GetStoreOriginalJSONForExtrasAndExtensions() const {
+    return store_original_json_for_extras_and_extensions_;
+  }
+
+  ///
+  /// Specify whether preserve image channels when loading images or not.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetPreserveImageChannels(bool onoff) {
+    preserve_image_channels_ = onoff;
+  }
+
+  bool GetPreserveImageChannels() const { return preserve_image_channels_; }
+
+  ///
+  /// Specifiy whether image data is decoded/decompressed during load, or left as is
+  ///
+  void SetImagesAsIs(bool onoff) {
+      images_as_is_ = onoff;
+  }
+
+  bool GetImagesAsIs() const { return images_as_is_; }
+
+  ///
+  /// When images are loaded as is(`SetImagesAsIs(true)`), do not copy the
+  /// encoded bytes of images stored in a bufferView to `Image::image`.
+  /// `Image::image` is left empty and the bytes are borrowed from
+  /// `Model::bufferViews[Image::bufferView]`. Default false.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImagesAsIsBorrowBufferView(bool onoff) {
+    images_as_is_borrow_buffer_view_ = onoff;
+  }
+
+  bool GetImagesAsIsBorrowBufferView() const {
+    return images_as_is_borrow_buffer_view_;
+  }
+
+  ///
+  /// Only read the header of images. `Image::width`, `Image::height`,
+  /// `Image::component`(channels stored in the file) and `Image::bits` are
+  /// set, and `Image::image` is left empty. External image files are read
+  /// partially through `FsCallbacks::ReadFileRange` when available.
+  /// Takes precedence over `SetImagesAsIs`. Default false.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImagesHeaderOnly(bool onoff) { images_header_only_ = onoff; }
+
+  bool GetImagesHeaderOnly() const { return images_header_only_; }
+
+  ///
+  /// Set the maximum width/height of decoded images(default 0 = unlimited).
+  /// Larger images are box-filtered down by an integer factor right after
+  /// decoding, and `Image::width`/`Image::height` are updated to match.
+  /// Useful to bound the memory of texture-heavy assets.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetMaxImageDimension(int max_dim) { max_image_dimension_ = max_dim; }
+
+  int GetMaxImageDimension() const { return max_image_dimension_; }
+
+  ///
+  /// Set the number of channels of decoded images(1 = grey, 2 = grey + alpha,
+  /// 3 = RGB, 4 = RGBA). 0(default) follows `SetPreserveImageChannels`.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImageTargetComponents(int components) {
+    image_target_components_ = components;
+  }
+
+  int GetImageTargetComponents() const { return image_target_components_; }
+
+  ///
+  /// Set the pixel format of decoded images. `pixel_type` and `bits` is one of
+  /// TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE(8), UNSIGNED_SHORT(16) or FLOAT(32,
+  /// or 16 for half float). Conversion is done in the same pass which copies
+  /// the decoded pixels to `Image::image`, and `Image::bits`/
+  /// `Image::pixel_type` describe the result. -1(default) keeps the decoded
+  /// format.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImageTargetPixelFormat(int pixel_type, int bits) {
+    image_target_pixel_type_ = pixel_type;
+    image_target_bits_ = bits;
+  }
+
+  int GetImageTargetPixelType() const { return image_target_pixel_type_; }
+  int GetImageTargetBits() const { return image_target_bits_; }
+
+  ///
+  /// Decode sRGB encoded color images(sources of baseColorTexture and
+  /// emissiveTexture) to linear while loading. Other images and alpha
+  /// channels are untouched. Usually combined with a FLOAT pixel format
+  /// (`SetImageTargetPixelFormat`) to avoid banding. Default false.
+  /// (Not effective when the user supplies their own LoadImageData callbacks)
+  ///
+  void SetImageSRGBToLinear(bool onoff) { image_srgb_to_linear_ = onoff; }
+
+  bool GetImageSRGBToLinear() const { return image_srgb_to_linear_; }
+
+  ///
+  /// Set maximum allowed external file size in bytes.
+  /// Default: 2GB
+  /// Only effective for built-in ReadWholeFileFunction FS function.
+  ///
+  void SetMaxExternalFileSize(size_t max_bytes) {
+    max_external_file_size_ = max_bytes;
+  }
+
+  size_t GetMaxExternalFileSize() const { return max_external_file_size_; }
+
+  ///
+  /// Set callbacks of a decoded geometry cache(e.g. `MemoryGeometryCache` or
+  /// `DiskGeometryCache`). KHR_draco_mesh_compression and
+  /// EXT_meshopt_compression data found in the cache is not decoded again.
+  /// Default: no cache.
+  ///
+  void SetGeometryCache(const GeometryCacheCallbacks &callbacks) {
+    geometry_cache_ = callbacks;
+  }
+
+  const GeometryCacheCallbacks &GetGeometryCache() const {
+    return geometry_cache_;
+  }
+
+  ///
+  /// Set the number of threads which decode KHR_draco_mesh_compression and
+  /// EXT_meshopt_compression data while loading. 0 = hardware concurrency,
+  /// 1 = decode on the loading thread. Default 0.
+  ///
+  void SetGeometryDecodeThreads(int num_threads) {
+    geometry_decode_threads_ = num_threads;
+  }
+
+  int GetGeometryDecodeThreads() const { return geometry_decode_threads_; }
+
+#ifdef TINYGLTF_ENABLE_MESHOPT
+  ///
+  /// Compress bufferViews with `EncodeMeshoptCompression` when writing glTF.
+  /// The model passed to `WriteGltfSceneToStream`/`WriteGltfSceneToFile` is
+  /// not modified(a copy is compressed). Default false.
+  ///
+  void SetMeshoptCompression(
+      bool onoff,
+      const MeshoptEncodeOptions &options = MeshoptEncodeOptions()) {
+    meshopt_compression_ = onoff;
+    meshopt_encode_options_ = options;
+  }
+
+  bool GetMeshoptCompression() const { return meshopt_compression_; }
+#endif
+
+#ifdef TINYGLTF_ENABLE_DRACO
+  ///
+  /// Compress triangle primitives with `EncodeDracoCompression` when writing
+  /// glTF. The model passed to `WriteGltfSceneToStream`/
+  /// `WriteGltfSceneToFile` is not modified(a copy is compressed). Applied
+  /// before meshopt compression. Default false.
+  ///
+  void SetDracoCompression(
+      bool onoff, const DracoEncodeOptions &options = DracoEncodeOptions()) {
+    draco_compression_ = onoff;
+    draco_encode_options_ = options;
+  }
+
+  bool GetDracoCompression() const { return draco_compression_; }
+#endif
+
+ private:
+  ///
+  /// Loads glTF asset from string(memory).
+  /// `length` = strlen(str);
+  /// Set warning message to `warn` for example it fails to load asserts
+  /// Returns false and set error string to `err` if there's an error.
+  ///
+  bool LoadFromString(Model *model, std::string *err, std::string *warn,
+                      const char *str, const unsigned int length,
+                      const std::string &base_dir, unsigned int check_sections);
+
+  ///
+  /// Applies the compression enabled for writing to `compressed`(a copy of
+  /// `*model` without image pixels) and points `*model` to it. Does nothing
+  /// when no compression is enabled.
+  ///
+  bool CompressModelForWriting(const Model **model, Model *compressed);
+
+  const unsigned char *bin_data_ = nullptr;
+  size_t bin_size_ = 0;
+  bool is_binary_ = false;
+
+  ParseStrictness strictness_ = ParseStrictness::Strict;
+
+  bool serialize_default_values_ = false;  ///< Serialize default values?
+
+  bool store_original_json_for_extras_and_extensions_ = false;
+
+  bool preserve_image_channels_ = false;  /// Default false(expand channels to
+                                          /// RGBA) for backward compatibility.
+
+  bool images_as_is_ = false; /// Default false (decode/decompress images)
+
+  bool images_as_is_borrow_buffer_view_ = false;  /// Default false(copy)
+
+  bool images_header_only_ = false;  /// Default false(load pixels)
+
+  int max_image_dimension_ = 0;      /// Default 0(no downscaling)
+  int image_target_components_ = 0;  /// Default 0(see preserve_image_channels_)
+  int image_target_pixel_type_ = -1;  /// Default -1(keep decoded format)
+  int image_target_bits_ = -1;
+  bool image_srgb_to_linear_ = false;
+
+  size_t max_external_file_size_{
+      size_t((std::numeric_limits<int32_t>::max)())};  // Default 2GB
+
+  GeometryCacheCallbacks geometry_cache_ = {nullptr, nullptr, nullptr};
+  int geometry_decode_threads_ = 0;  // Default 0(hardware concurrency)
+
+#ifdef TINYGLTF_ENABLE_MESHOPT
+  bool meshopt_compression_ = false;
+  MeshoptEncodeOptions meshopt_encode_options_;
+#endif
+
+#ifdef TINYGLTF_ENABLE_DRACO
+  bool draco_compression_ = false;
+  DracoEncodeOptions draco_encode_options_;
+#endif
+
+  // Warning & error messages
+  std::string warn_;
+  std::string err_;
+
+  FsCallbacks fs = {
+#ifndef TINYGLTF_NO_FS
+      &tinygltf::FileExists,
+      &tinygltf::ExpandFilePath,
+      &tinygltf::ReadWholeFile,
+      &tinygltf::WriteWholeFile,
+      &tinygltf::GetFileSizeInBytes,
+
+      nullptr,  // Fs callback user data
+
+      &tinygltf::ReadFileRange
+#else
+      nullptr, nullptr, nullptr, nullptr, nullptr,
+
+      nullptr,  // Fs callback user data
+
+      nullptr
+#endif
+  };
+
+  URICallbacks uri_cb = {
+      // Use paths as-is by default. This will use JSON string escaping.
+      nullptr,
+      // Decode all URIs before using them as paths as the application may have
+      // percent encoded them.
+      &tinygltf::URIDecode,
+      // URI callback user data
+      nullptr};
+
+  LoadImageDataFunction LoadImageData = &tinygltf::LoadImageData;
+  void *load_image_user_data_{nullptr};
+  bool user_image_loader_{false};
+
+  std::map<std::string, ImageDecoder> image_decoders_;
+
+  WriteImageDataFunction WriteImageData =
+#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
+      &tinygltf::WriteImageData;
+#else
+      nullptr;
+#endif
+  void *write_image_user_data_{nullptr};
+};
+
+#ifdef __clang__
+#pragma clang diagnostic pop  // -Wpadded
+#endif
+
+}  // namespace tinygltf
+
+#endif  // TINY_GLTF_H_
+
+#if defined(TINYGLTF_IMPLEMENTATION) || defined(__INTELLISENSE__)
+#include <algorithm>
+// #include <cassert>
+#ifndef TINYGLTF_NO_FS
+#include <sys/stat.h>  // for is_directory check
+
+#include <cstdio>
+#include <fstream>
+#endif
+#include <sstream>
+
+// Accessor/mesh utilities only use std::thread with TINYGLTF_ENABLE_THREADS
+// (link with -pthread). std::thread is not available on WASI, and on
+// Emscripten without pthreads.
+#if !defined(TINYGLTF_ENABLE_THREADS) || defined(__wasi__) || \
+    (defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__))
+#ifndef TINYGLTF_NO_THREADS
+#define TINYGLTF_NO_THREADS
+#endif
+#endif
+
+#ifndef TINYGLTF_NO_THREADS
+#include <atomic>
+#include <exception>
+#include <thread>
+#endif
+
+#ifndef TINYGLTF_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TINYGLTF_INTERNAL_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TINYGLTF_INTERNAL_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#ifdef __clang__
+// Disable some warnings for external files.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wfloat-equal"
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#pragma clang diagnostic ignored "-Wconversion"
+#pragma clang diagnostic ignored "-Wold-style-cast"
+#pragma clang diagnostic ignored "-Wglobal-constructors"
+#if __has_warning("-Wreserved-id-macro")
+#pragma clang diagnostic ignored "-Wreserved-id-macro"
+#endif
+#pragma clang diagnostic ignored "-Wdisabled-macro-expansion"
+#pragma clang diagnostic ignored "-Wpadded"
+#pragma clang diagnostic ignored "-Wc++98-compat"
+#pragma clang diagnostic ignored "-Wc++98-compat-pedantic"
+#pragma clang diagnostic ignored "-Wdocumentation-unknown-command"
+#pragma clang diagnostic ignored "-Wswitch-enum"
+#pragma clang diagnostic ignored "-Wimplicit-fallthrough"
+#pragma clang diagnostic ignored "-Wweak-vtables"
+#pragma clang diagnostic ignored "-Wcovered-switch-default"
+#if __has_warning("-Wdouble-promotion")
+#pragma clang diagnostic ignored "-Wdouble-promotion"
+#endif
+#if __has_warning("-Wcomma")
+#pragma clang diagnostic ignored "-Wcomma"
+#endif
+#if __has_warning("-Wzero-as-null-pointer-constant")
+#pragma clang diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+#if __has_warning("-Wcast-qual")
+#pragma clang diagnostic ignored "-Wcast-qual"
+#endif
+#if __has_warning("-Wmissing-variable-declarations")
+#pragma clang diagnostic ignored "-Wmissing-variable-declarations"
+#endif
+#if __has_warning("-Wmissing-prototypes")
+#pragma clang diagnostic ignored "-Wmissing-prototypes"
+#endif
+#if __has_warning("-Wcast-align")
+#pragma clang diagnostic ignored "-Wcast-align"
+#endif
+#if __has_warning("-Wnewline-eof")
+#pragma clang diagnostic ignored "-Wnewline-eof"
+#endif
+#if __has_warning("-Wunused-parameter")
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#if __has_warning("-Wmismatched-tags")
+#pragma clang diagnostic ignored "-Wmismatched-tags"
+#endif
+#if __has_warning("-Wextra-semi-stmt")
+#pragma clang diagnostic ignored "-Wextra-semi-stmt"
+#endif
+#endif
+
+// Disable GCC warnings
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wtype-limits"
+#endif  // __GNUC__
+
+#ifndef TINYGLTF_NO_INCLUDE_JSON
+#ifndef TINYGLTF_USE_RAPIDJSON
+#include "json.hpp"
+#else
+#ifndef TINYGLTF_NO_INCLUDE_RAPIDJSON
+#include "document.h"
+#include "prettywriter.h"
+#include "rapidjson.h"
+#include "stringbuffer.h"
+#include "writer.h"
+#endif
+#endif
+#endif
+
+#ifdef TINYGLTF_ENABLE_DRACO
+#include "draco/compression/decode.h"
+#include "draco/compression/expert_encode.h"
+#include "draco/core/decoder_buffer.h"
+#include "draco/core/encoder_buffer.h"
+#include "draco/mesh/mesh.h"
+#endif
+
+#ifdef TINYGLTF_ENABLE_LIBJPEG_TURBO
+#include <csetjmp>
+#include <cstdio>  // jpeglib.h requires FILE
+
+#include "jpeglib.h"
+#endif
+
+#ifdef TINYGLTF_ENABLE_SPNG
+#include "spng.h"
+#endif
+
+#ifndef TINYGLTF_NO_STB_IMAGE
+#ifndef TINYGLTF_NO_INCLUDE_STB_IMAGE
+#include "stb_image.h"
+#endif
+#endif
+
+#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
+#ifndef TINYGLTF_NO_INCLUDE_STB_IMAGE_WRITE
+#include "stb_image_write.h"
+#endif
+#endif
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#ifdef _WIN32
+
+// issue 143.
+// Define NOMINMAX to avoid min/max defines,
+// but undef it after included Windows.h
+#ifndef NOMINMAX
+#define TINYGLTF_INTERNAL_NOMINMAX
+#define NOMINMAX
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define TINYGLTF_INTERNAL_WIN32_LEAN_AND_MEAN
+#endif
+#ifndef __MINGW32__
+#include <Windows.h>  // include API for expanding a file path
+#else
+#include <windows.h>
+#endif
+
+#ifdef TINYGLTF_INTERNAL_WIN32_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#endif
+
+#if defined(TINYGLTF_INTERNAL_NOMINMAX)
+#undef NOMINMAX
+#endif
+
+#if defined(__GLIBCXX__)  // mingw
+
+#include <fcntl.h>  // _O_RDONLY
+
+#include <ext/stdio_filebuf.h>  // fstream (all sorts of IO stuff) + stdio_filebuf (=streambuf)
+
+#endif
+
+#elif !defined(__ANDROID__) && !defined(__OpenBSD__)
+// #include <wordexp.h>
+#endif
+
+#if defined(__sparcv9) || defined(__powerpc__)
+// Big endian
+#else
+#if (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || MINIZ_X86_OR_X64_CPU
+#define TINYGLTF_LITTLE_ENDIAN 1
+#endif
+#endif
+
+namespace tinygltf {
+namespace detail {
+#ifdef TINYGLTF_USE_RAPIDJSON
+
+#ifdef TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
+// This uses the RapidJSON CRTAllocator.  It is thread safe and multiple
+// documents may be active at once.
+using json =
+    rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+using json_iterator = json::MemberIterator;
+using json_const_iterator = json::ConstMemberIterator;
+using json_const_array_iterator = json const *;
+using JsonDocument =
+    rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::CrtAllocator>;
+rapidjson::CrtAllocator s_CrtAllocator;  // stateless and thread safe
+rapidjson::CrtAllocator &GetAllocator() { return s_CrtAllocator; }
+#else
+// This uses the default RapidJSON MemoryPoolAllocator.  It is very fast, but
+// not thread safe. Only a single JsonDocument may be active at any one time,
+// meaning only a single gltf load/save can be active any one time.
+using json = rapidjson::Value;
+using json_iterator = json::MemberIterator;
+using json_const_iterator = json::ConstMemberIterator;
+using json_const_array_iterator = json const *;
+rapidjson::Document *s_pActiveDocument = nullptr;
+rapidjson::Document::AllocatorType &GetAllocator() {
+  assert(s_pActiveDocument);  // Root json node must be JsonDocument type
+  return s_pActiveDocument->GetAllocator();
+}
+
+#ifdef __clang__
+#pragma clang diagnostic push
+// Suppress JsonDocument(JsonDocument &&rhs) noexcept
+#pragma clang diagnostic ignored "-Wunused-member-function"
+#endif
+
+struct JsonDocument : public rapidjson::Document {
+  JsonDocument() {
+    assert(s_pActiveDocument ==
+           nullptr);  // When using default allocator, only one document can be
+                      // active at a time, if you need multiple active at once,
+                      // define TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
+    s_pActiveDocument = this;
+  }
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument(JsonDocument &&rhs) noexcept
+      : rapidjson::Document(std::move(rhs)) {
+    s_pActiveDocument = this;
+    rhs.isNil = true;
+  }
+  ~JsonDocument() {
+    if (!isNil) {
+      s_pActiveDocument = nullptr;
+    }
+  }
+
+ private:
+  bool isNil = false;
+};
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#endif  // TINYGLTF_USE_RAPIDJSON_CRTALLOCATOR
+
+#else
+using nlohmann::json;
+using json_iterator = json::iterator;
+using json_const_iterator = json::const_iterator;
+using json_const_array_iterator = json_const_iterator;
+using JsonDocument = json;
+#endif
+
+void JsonParse(JsonDocument &doc, const char *str, size_t length,
+               bool throwExc = false) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  (void)throwExc;
+  doc.Parse(str, length);
+#else
+  doc = detail::json::parse(str, str + length, nullptr, throwExc);
+#endif
+}
+}  // namespace detail
+}  // namespace tinygltf
+
+#ifdef __APPLE__
+#include "TargetConditionals.h"
+#endif
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wc++98-compat"
+#endif
+
+namespace tinygltf {
+
+///
+/// Internal LoadImageDataOption struct.
+/// This struct is passed through `user_pointer` in LoadImageData.
+/// The struct is not passed when the user supply their own LoadImageData
+/// callbacks.
+///
+struct LoadImageDataOption {
+  // true: preserve image channels(e.g. load as RGB image if the image has RGB
+  // channels) default `false`(channels are expanded to RGBA for backward
+  // compatibility).
+  bool preserve_channels{false};
+  // true: do not decode/decompress image data.
+  // default `false`: decode/decompress image data.
+  bool as_is{false};
+  // true: with `as_is`, do not copy encoded bytes to `Image::image`. The
+  // caller adopts(moves) its own copy or keeps referencing the bufferView.
+  bool as_is_no_copy{false};
+  // > 0: downscale decoded image so that both width and height are equal or
+  // less than this value. default `0`(keep the original resolution).
+  int max_image_dimension{0};
+  // 1, 2, 3 or 4: number of channels of the decoded image. Overrides
+  // `preserve_channels`. default `0`(not specified).
+  int target_components{0};
+  // Image decoder backends keyed by MIME type. stb_image is used for other
+  // types or when the backend fails.
+  const std::map<std::string, ImageDecoder> *decoders{nullptr};
+  // true: only read the image header. `width`, `height`, `component`(channels
+  // stored in the file) and `bits` are set, and `Image::image` is left empty.
+  bool header_only{false};
+  // Pixel format of the decoded image. TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE
+  // with bits 8, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT with bits 16, or
+  // TINYGLTF_COMPONENT_TYPE_FLOAT with bits 32(float) or 16(half float).
+  // default `-1`(keep the decoded format).
+  int target_pixel_type{-1};
+  int target_bits{-1};
+  // true: decode sRGB color channels of images flagged in `srgb_images` to
+  // linear. Alpha channel is left as is. default `false`.
+  bool srgb_to_linear{false};
+  // srgb_images[image_idx] is true when the image stores sRGB encoded color
+  // (e.g. referenced by baseColorTexture or emissiveTexture).
+  std::vector<bool> srgb_images;
+};
+
+// Equals function for Value, for recursivity
+static bool Equals(const tinygltf::Value &one, const tinygltf::Value &other) {
+  if (one.Type() != other.Type()) return false;
+
+  switch (one.Type()) {
+    case NULL_TYPE:
+      return true;
+    case BOOL_TYPE:
+      return one.Get<bool>() == other.Get<bool>();
+    case REAL_TYPE:
+      return TINYGLTF_DOUBLE_EQUAL(one.Get<double>(), other.Get<double>());
+    case INT_TYPE:
+      return one.Get<int>() == other.Get<int>();
+    case OBJECT_TYPE: {
+      auto oneObj = one.Get<tinygltf::Value::Object>();
+      auto otherObj = other.Get<tinygltf::Value::Object>();
+      if (oneObj.size() != otherObj.size()) return false;
+      for (auto &it : oneObj) {
+        auto otherIt = otherObj.find(it.first);
+        if (otherIt == otherObj.end()) return false;
+
+        if (!Equals(it.second, otherIt->second)) return false;
+      }
+      return true;
+    }
+    case ARRAY_TYPE: {
+      if (one.Size() != other.Size()) return false;
+      for (size_t i = 0; i < one.Size(); ++i)
+        if (!Equals(one.Get(i), other.Get(i))) return false;
+      return true;
+    }
+    case STRING_TYPE:
+      return one.Get<std::string>() == other.Get<std::string>();
+    case BINARY_TYPE:
+      return one.Get<std::vector<unsigned char> >() ==
+             other.Get<std::vector<unsigned char> >();
+    default: {
+      // unhandled type
+      return false;
+    }
+  }
+}
+
+// Equals function for std::vector<double> using TINYGLTF_DOUBLE_EPSILON
+static bool Equals(const std::vector<double> &one,
+                   const std::vector<double> &other) {
+  if (one.size() != other.size()) return false;
+  for (int i = 0; i < int(one.size()); ++i) {
+    if (!TINYGLTF_DOUBLE_EQUAL(one[size_t(i)], other[size_t(i)])) return false;
+  }
+  return true;
+}
+
+bool Accessor::operator==(const Accessor &other) const {
+  return this->bufferView == other.bufferView &&
+         this->byteOffset == other.byteOffset &&
+         this->componentType == other.componentType &&
+         this->count == other.count && this->extensions == other.extensions &&
+         this->extras == other.extras &&
+         Equals(this->maxValues, other.maxValues) &&
+         Equals(this->minValues, other.minValues) && this->name == other.name &&
+         this->normalized == other.normalized && this->type == other.type;
+}
+bool Animation::operator==(const Animation &other) const {
+  return this->channels == other.channels &&
+         this->extensions == other.extensions && this->extras == other.extras &&
+         this->name == other.name && this->samplers == other.samplers;
+}
+bool AnimationChannel::operator==(const AnimationChannel &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->target_node == other.target_node &&
+         this->target_path == other.target_path &&
+         this->sampler == other.sampler;
+}
+bool AnimationSampler::operator==(const AnimationSampler &other) const {
+  return this->extras == other.extras && this->extensions == other.extensions &&
+         this->input == other.input &&
+         this->interpolation == other.interpolation &&
+         this->output == other.output;
+}
+bool Asset::operator==(const Asset &other) const {
+  return this->copyright == other.copyright &&
+         this->extensions == other.extensions && this->extras == other.extras &&
+         this->generator == other.generator &&
+         this->minVersion == other.minVersion && this->version == other.version;
+}
+bool Buffer::operator==(const Buffer &other) const {
+  return this->data == other.data && this->extensions == other.extensions &&
+         this->extras == other.extras && this->name == other.name &&
+         this->uri == other.uri;
+}
+bool BufferView::operator==(const BufferView &other) const {
+  return this->buffer == other.buffer && this->byteLength == other.byteLength &&
+         this->byteOffset == other.byteOffset &&
+         this->byteStride == other.byteStride && this->name == other.name &&
+         this->target == other.target && this->extensions == other.extensions &&
+         this->extras == other.extras &&
+         this->dracoDecoded == other.dracoDecoded;
+}
+bool Camera::operator==(const Camera &other) const {
+  return this->name == other.name && this->extensions == other.extensions &&
+         this->extras == other.extras &&
+         this->orthographic == other.orthographic &&
+         this->perspective == other.perspective && this->type == other.type;
+}
+bool Image::operator==(const Image &other) const {
+  return this->bufferView == other.bufferView &&
          this->component == other.component &&
          this->extensions == other.extensions && this->extras == other.extras &&
-         this->height == other.height && this->image == other.image &&
-         this->mimeType == other.mimeType && this->name == other.name &&
-         this->uri == other.uri && this->width == other.width;
+         this->height == other.height && this->image == other.image &&
+         this->mimeType == other.mimeType && this->name == other.name &&
+         this->uri == other.uri && this->width == other.width;
+}
+bool Light::operator==(const Light &other) const {
+  return Equals(this->color, other.color) && this->name == other.name &&
+         this->type == other.type;
+}
+bool AudioEmitter::operator==(const AudioEmitter &other) const {
+  return this->name == other.name &&
+         TINYGLTF_DOUBLE_EQUAL(this->gain, other.gain) &&
+         this->loop == other.loop && this->playing == other.playing &&
+         this->type == other.type &&
+         this->distanceModel == other.distanceModel &&
+         this->source == other.source;
+}
+bool AudioSource::operator==(const AudioSource &other) const {
+  return this->name == other.name && this->uri == other.uri;
+}
+bool Material::operator==(const Material &other) const {
+  return (this->pbrMetallicRoughness == other.pbrMetallicRoughness) &&
+         (this->normalTexture == other.normalTexture) &&
+         (this->occlusionTexture == other.occlusionTexture) &&
+         (this->emissiveTexture == other.emissiveTexture) &&
+         Equals(this->emissiveFactor, other.emissiveFactor) &&
+         (this->alphaMode == other.alphaMode) &&
+         TINYGLTF_DOUBLE_EQUAL(this->alphaCutoff, other.alphaCutoff) &&
+         (this->doubleSided == other.doubleSided) &&
+         (this->extensions == other.extensions) &&
+         (this->extras == other.extras) && (this->values == other.values) &&
+         (this->additionalValues == other.additionalValues) &&
+         (this->name == other.name);
+}
+bool Mesh::operator==(const Mesh &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->name == other.name && Equals(this->weights, other.weights) &&
+         this->primitives == other.primitives;
+}
+bool Model::operator==(const Model &other) const {
+  return this->accessors == other.accessors &&
+         this->animations == other.animations && this->asset == other.asset &&
+         this->buffers == other.buffers &&
+         this->bufferViews == other.bufferViews &&
+         this->cameras == other.cameras &&
+         this->defaultScene == other.defaultScene &&
+         this->extensions == other.extensions &&
+         this->extensionsRequired == other.extensionsRequired &&
+         this->extensionsUsed == other.extensionsUsed &&
+         this->extras == other.extras && this->images == other.images &&
+         this->lights == other.lights && this->materials == other.materials &&
+         this->meshes == other.meshes && this->nodes == other.nodes &&
+         this->samplers == other.samplers && this->scenes == other.scenes &&
+         this->skins == other.skins && this->textures == other.textures;
+}
+bool Node::operator==(const Node &other) const {
+  return this->camera == other.camera && this->children == other.children &&
+         this->extensions == other.extensions && this->extras == other.extras &&
+         Equals(this->matrix, other.matrix) && this->mesh == other.mesh &&
+         (this->light == other.light) && (this->emitter == other.emitter) &&
+         this->name == other.name && Equals(this->rotation, other.rotation) &&
+         Equals(this->scale, other.scale) && this->skin == other.skin &&
+         Equals(this->translation, other.translation) &&
+         Equals(this->weights, other.weights);
+}
+bool SpotLight::operator==(const SpotLight &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         TINYGLTF_DOUBLE_EQUAL(this->innerConeAngle, other.innerConeAngle) &&
+         TINYGLTF_DOUBLE_EQUAL(this->outerConeAngle, other.outerConeAngle);
+}
+bool PositionalEmitter::operator==(const PositionalEmitter &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         TINYGLTF_DOUBLE_EQUAL(this->coneInnerAngle, other.coneInnerAngle) &&
+         TINYGLTF_DOUBLE_EQUAL(this->coneOuterAngle, other.coneOuterAngle) &&
+         TINYGLTF_DOUBLE_EQUAL(this->coneOuterGain, other.coneOuterGain) &&
+         TINYGLTF_DOUBLE_EQUAL(this->maxDistance, other.maxDistance) &&
+         TINYGLTF_DOUBLE_EQUAL(this->refDistance, other.refDistance) &&
+         TINYGLTF_DOUBLE_EQUAL(this->rolloffFactor, other.rolloffFactor);
+}
+bool OrthographicCamera::operator==(const OrthographicCamera &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         TINYGLTF_DOUBLE_EQUAL(this->xmag, other.xmag) &&
+         TINYGLTF_DOUBLE_EQUAL(this->ymag, other.ymag) &&
+         TINYGLTF_DOUBLE_EQUAL(this->zfar, other.zfar) &&
+         TINYGLTF_DOUBLE_EQUAL(this->znear, other.znear);
+}
+bool Parameter::operator==(const Parameter &other) const {
+  if (this->bool_value != other.bool_value ||
+      this->has_number_value != other.has_number_value)
+    return false;
+
+  if (!TINYGLTF_DOUBLE_EQUAL(this->number_value, other.number_value))
+    return false;
+
+  if (this->json_double_value.size() != other.json_double_value.size())
+    return false;
+  for (auto &it : this->json_double_value) {
+    auto otherIt = other.json_double_value.find(it.first);
+    if (otherIt == other.json_double_value.end()) return false;
+
+    if (!TINYGLTF_DOUBLE_EQUAL(it.second, otherIt->second)) return false;
+  }
+
+  if (!Equals(this->number_array, other.number_array)) return false;
+
+  if (this->string_value != other.string_value) return false;
+
+  return true;
+}
+bool PerspectiveCamera::operator==(const PerspectiveCamera &other) const {
+  return TINYGLTF_DOUBLE_EQUAL(this->aspectRatio, other.aspectRatio) &&
+         this->extensions == other.extensions && this->extras == other.extras &&
+         TINYGLTF_DOUBLE_EQUAL(this->yfov, other.yfov) &&
+         TINYGLTF_DOUBLE_EQUAL(this->zfar, other.zfar) &&
+         TINYGLTF_DOUBLE_EQUAL(this->znear, other.znear);
+}
+bool Primitive::operator==(const Primitive &other) const {
+  return this->attributes == other.attributes && this->extras == other.extras &&
+         this->indices == other.indices && this->material == other.material &&
+         this->mode == other.mode && this->targets == other.targets;
+}
+bool Sampler::operator==(const Sampler &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->magFilter == other.magFilter &&
+         this->minFilter == other.minFilter && this->name == other.name &&
+         this->wrapS == other.wrapS && this->wrapT == other.wrapT;
+
+  // this->wrapR == other.wrapR
+}
+bool Scene::operator==(const Scene &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->name == other.name && this->nodes == other.nodes;
+}
+bool Skin::operator==(const Skin &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->inverseBindMatrices == other.inverseBindMatrices &&
+         this->joints == other.joints && this->name == other.name &&
+         this->skeleton == other.skeleton;
+}
+bool Texture::operator==(const Texture &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->name == other.name && this->sampler == other.sampler &&
+         this->source == other.source;
+}
+bool TextureInfo::operator==(const TextureInfo &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->index == other.index && this->texCoord == other.texCoord;
+}
+bool NormalTextureInfo::operator==(const NormalTextureInfo &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->index == other.index && this->texCoord == other.texCoord &&
+         TINYGLTF_DOUBLE_EQUAL(this->scale, other.scale);
+}
+bool OcclusionTextureInfo::operator==(const OcclusionTextureInfo &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         this->index == other.index && this->texCoord == other.texCoord &&
+         TINYGLTF_DOUBLE_EQUAL(this->strength, other.strength);
+}
+bool PbrMetallicRoughness::operator==(const PbrMetallicRoughness &other) const {
+  return this->extensions == other.extensions && this->extras == other.extras &&
+         (this->baseColorTexture == other.baseColorTexture) &&
+         (this->metallicRoughnessTexture == other.metallicRoughnessTexture) &&
+         Equals(this->baseColorFactor, other.baseColorFactor) &&
+         TINYGLTF_DOUBLE_EQUAL(this->metallicFactor, other.metallicFactor) &&
+         TINYGLTF_DOUBLE_EQUAL(this->roughnessFactor, other.roughnessFactor);
+}
+bool Value::operator==(const Value &other) const {
+  return Equals(*this, other);
+}
+
+static void swap4(unsigned int *val) {
+#ifdef TINYGLTF_LITTLE_ENDIAN
+  (void)val;
+#else
+  unsigned int tmp = *val;
+  unsigned char *dst = reinterpret_cast<unsigned char *>(val);
+  unsigned char *src = reinterpret_cast<unsigned char *>(&tmp);
+
+  dst[0] = src[3];
+  dst[1] = src[2];
+  dst[2] = src[1];
+  dst[3] = src[0];
+#endif
+}
+
+static std::string JoinPath(const std::string &path0,
+                            const std::string &path1) {
+  if (path0.empty()) {
+    return path1;
+  } else {
+    // check '/'
+    char lastChar = *path0.rbegin();
+    if (lastChar != '/') {
+      return path0 + std::string("/") + path1;
+    } else {
+      return path0 + path1;
+    }
+  }
+}
+
+static std::string FindFile(const std::vector<std::string> &paths,
+                            const std::string &filepath, FsCallbacks *fs) {
+  if (fs == nullptr || fs->ExpandFilePath == nullptr ||
+      fs->FileExists == nullptr) {
+    // Error, fs callback[s] missing
+    return std::string();
+  }
+
+  // https://github.com/syoyo/tinygltf/issues/416
+  // Use strlen() since std::string's size/length reports the number of elements
+  // in the buffer, not the length of string(null-terminated) strip
+  // null-character in the middle of string.
+  size_t slength = strlen(filepath.c_str());
+  if (slength == 0) {
+    return std::string();
+  }
+
+  std::string cleaned_filepath = std::string(filepath.c_str());
+
+  for (size_t i = 0; i < paths.size(); i++) {
+    std::string absPath =
+        fs->ExpandFilePath(JoinPath(paths[i], cleaned_filepath), fs->user_data);
+    if (fs->FileExists(absPath, fs->user_data)) {
+      return absPath;
+    }
+  }
+
+  return std::string();
+}
+
+static std::string GetFilePathExtension(const std::string &FileName) {
+  if (FileName.find_last_of(".") != std::string::npos)
+    return FileName.substr(FileName.find_last_of(".") + 1);
+  return "";
+}
+
+static std::string GetBaseDir(const std::string &filepath) {
+  if (filepath.find_last_of("/\\") != std::string::npos)
+    return filepath.substr(0, filepath.find_last_of("/\\") + 1);
+  return "";
+}
+
+static std::string GetBaseFilename(const std::string &filepath) {
+  auto idx = filepath.find_last_of("/\\");
+  if (idx != std::string::npos) return filepath.substr(idx + 1);
+  return filepath;
+}
+
+std::string base64_encode(unsigned char const *, unsigned int len);
+std::string base64_decode(std::string const &s);
+
+/*
+   base64.cpp and base64.h
+
+   Copyright (C) 2004-2008 René Nyffenegger
+
+   This source code is provided 'as-is', without any express or implied
+   warranty. In no event will the author be held liable for any damages
+   arising from the use of this software.
+
+   Permission is granted to anyone to use this software for any purpose,
+   including commercial applications, and to alter it and redistribute it
+   freely, subject to the following restrictions:
+
+   1. The origin of this source code must not be misrepresented; you must not
+      claim that you wrote the original source code. If you use this source code
+      in a product, an acknowledgment in the product documentation would be
+      appreciated but is not required.
+
+   2. Altered source versions must be plainly marked as such, and must not be
+      misrepresented as being the original source code.
+
+   3. This notice may not be removed or altered from any source distribution.
+
+   René Nyffenegger rene.nyffenegger@adp-gmbh.ch
+
+*/
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wsign-conversion"
+#pragma clang diagnostic ignored "-Wconversion"
+#endif
+
+static inline bool is_base64(unsigned char c) {
+  return (isalnum(c) || (c == '+') || (c == '/'));
+}
+
+std::string base64_encode(unsigned char const *bytes_to_encode,
+                          unsigned int in_len) {
+  std::string ret;
+  int i = 0;
+  int j = 0;
+  unsigned char char_array_3[3];
+  unsigned char char_array_4[4];
+
+  const char *base64_chars =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+      "abcdefghijklmnopqrstuvwxyz"
+      "0123456789+/";
+
+  while (in_len--) {
+    char_array_3[i++] = *(bytes_to_encode++);
+    if (i == 3) {
+      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+      char_array_4[1] =
+          ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+      char_array_4[2] =
+          ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+      char_array_4[3] = char_array_3[2] & 0x3f;
+
+      for (i = 0; (i < 4); i++) ret += base64_chars[char_array_4[i]];
+      i = 0;
+    }
+  }
+
+  if (i) {
+    for (j = i; j < 3; j++) char_array_3[j] = '\0';
+
+    char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+    char_array_4[1] =
+        ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+    char_array_4[2] =
+        ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+
+    for (j = 0; (j < i + 1); j++) ret += base64_chars[char_array_4[j]];
+
+    while ((i++ < 3)) ret += '=';
+  }
+
+  return ret;
+}
+
+std::string base64_decode(std::string const &encoded_string) {
+  int in_len = static_cast<int>(encoded_string.size());
+  int i = 0;
+  int j = 0;
+  int in_ = 0;
+  unsigned char char_array_4[4], char_array_3[3];
+  std::string ret;
+
+  const std::string base64_chars =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+      "abcdefghijklmnopqrstuvwxyz"
+      "0123456789+/";
+
+  while (in_len-- && (encoded_string[in_] != '=') &&
+         is_base64(encoded_string[in_])) {
+    char_array_4[i++] = encoded_string[in_];
+    in_++;
+    if (i == 4) {
+      for (i = 0; i < 4; i++)
+        char_array_4[i] =
+            static_cast<unsigned char>(base64_chars.find(char_array_4[i]));
+
+      char_array_3[0] =
+          (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
+      char_array_3[1] =
+          ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+
+      for (i = 0; (i < 3); i++) ret += char_array_3[i];
+      i = 0;
+    }
+  }
+
+  if (i) {
+    for (j = i; j < 4; j++) char_array_4[j] = 0;
+
+    for (j = 0; j < 4; j++)
+      char_array_4[j] =
+          static_cast<unsigned char>(base64_chars.find(char_array_4[j]));
+
+    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
+    char_array_3[1] =
+        ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
+    char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+
+    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
+  }
+
+  return ret;
+}
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+// https://github.com/syoyo/tinygltf/issues/228
+// TODO(syoyo): Use uriparser https://uriparser.github.io/ for stricter Uri
+// decoding?
+//
+// Uri Decoding from DLIB
+// http://dlib.net/dlib/server/server_http.cpp.html
+// --- dlib begin ------------------------------------------------------------
+// Copyright (C) 2003  Davis E. King (davis@dlib.net)
+// License: Boost Software License
+// Boost Software License - Version 1.0 - August 17th, 2003
+
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//
+namespace dlib {
+
+inline unsigned char from_hex(unsigned char ch) {
+  if (ch <= '9' && ch >= '0')
+    ch -= '0';
+  else if (ch <= 'f' && ch >= 'a')
+    ch -= 'a' - 10;
+  else if (ch <= 'F' && ch >= 'A')
+    ch -= 'A' - 10;
+  else
+    ch = 0;
+  return ch;
+}
+
+static const std::string urldecode(const std::string &str) {
+  using namespace std;
+  string result;
+  string::size_type i;
+  for (i = 0; i < str.size(); ++i) {
+    if (str[i] == '+') {
+      result += ' ';
+    } else if (str[i] == '%' && str.size() > i + 2) {
+      const unsigned char ch1 =
+          from_hex(static_cast<unsigned char>(str[i + 1]));
+      const unsigned char ch2 =
+          from_hex(static_cast<unsigned char>(str[i + 2]));
+      const unsigned char ch = static_cast<unsigned char>((ch1 << 4) | ch2);
+      result += static_cast<char>(ch);
+      i += 2;
+    } else {
+      result += str[i];
+    }
+  }
+  return result;
+}
+
+}  // namespace dlib
+// --- dlib end --------------------------------------------------------------
+
+bool URIDecode(const std::string &in_uri, std::string *out_uri,
+               void *user_data) {
+  (void)user_data;
+  *out_uri = dlib::urldecode(in_uri);
+  return true;
+}
+
+static bool LoadExternalFile(std::vector<unsigned char> *out, std::string *err,
+                             std::string *warn, const std::string &filename,
+                             const std::string &basedir, bool required,
+                             size_t reqBytes, bool checkSize,
+                             size_t maxFileSize, FsCallbacks *fs) {
+  if (fs == nullptr || fs->FileExists == nullptr ||
+      fs->ExpandFilePath == nullptr || fs->ReadWholeFile == nullptr) {
+    // This is a developer error, assert() ?
+    if (err) {
+      (*err) += "FS callback[s] not set\n";
+    }
+    return false;
+  }
+
+  std::string *failMsgOut = required ? err : warn;
+
+  out->clear();
+
+  std::vector<std::string> paths;
+  paths.push_back(basedir);
+  paths.push_back(".");
+
+  std::string filepath = FindFile(paths, filename, fs);
+  if (filepath.empty() || filename.empty()) {
+    if (failMsgOut) {
+      (*failMsgOut) += "File not found : " + filename + "\n";
+    }
+    return false;
+  }
+
+  // Check file size
+  if (fs->GetFileSizeInBytes) {
+    size_t file_size{0};
+    std::string _err;
+    bool ok =
+        fs->GetFileSizeInBytes(&file_size, &_err, filepath, fs->user_data);
+    if (!ok) {
+      if (_err.size()) {
+        if (failMsgOut) {
+          (*failMsgOut) += "Getting file size failed : " + filename +
+                           ", err = " + _err + "\n";
+        }
+      }
+      return false;
+    }
+
+    if (file_size > maxFileSize) {
+      if (failMsgOut) {
+        (*failMsgOut) += "File size " + std::to_string(file_size) +
+                         " exceeds maximum allowed file size " +
+                         std::to_string(maxFileSize) + " : " + filepath + "\n";
+      }
+      return false;
+    }
+  }
+
+  std::vector<unsigned char> buf;
+  std::string fileReadErr;
+  bool fileRead =
+      fs->ReadWholeFile(&buf, &fileReadErr, filepath, fs->user_data);
+  if (!fileRead) {
+    if (failMsgOut) {
+      (*failMsgOut) +=
+          "File read error : " + filepath + " : " + fileReadErr + "\n";
+    }
+    return false;
+  }
+
+  size_t sz = buf.size();
+  if (sz == 0) {
+    if (failMsgOut) {
+      (*failMsgOut) += "File is empty : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  if (checkSize) {
+    if (reqBytes == sz) {
+      out->swap(buf);
+      return true;
+    } else {
+      std::stringstream ss;
+      ss << "File size mismatch : " << filepath << ", requestedBytes "
+         << reqBytes << ", but got " << sz << std::endl;
+      if (failMsgOut) {
+        (*failMsgOut) += ss.str();
+      }
+      return false;
+    }
+  }
+
+  out->swap(buf);
+  return true;
+}
+
+//
+// Reads up to `length` bytes from `offset` of an external file. Returns false
+// when the file is not found or `fs` has no `ReadFileRange` callback.
+//
+static bool LoadExternalFileRange(std::vector<unsigned char> *out,
+                                  std::string *err,
+                                  const std::string &filename,
+                                  const std::string &basedir, size_t offset,
+                                  size_t length, FsCallbacks *fs) {
+  if (fs == nullptr || fs->FileExists == nullptr ||
+      fs->ExpandFilePath == nullptr || fs->ReadFileRange == nullptr) {
+    return false;
+  }
+
+  out->clear();
+
+  std::vector<std::string> paths;
+  paths.push_back(basedir);
+  paths.push_back(".");
+
+  std::string filepath = FindFile(paths, filename, fs);
+  if (filepath.empty() || filename.empty()) {
+    return false;
+  }
+
+  return fs->ReadFileRange(out, err, filepath, offset, length, fs->user_data);
+}
+
+void TinyGLTF::SetParseStrictness(ParseStrictness strictness) {
+  strictness_ = strictness;
+}
+
+void TinyGLTF::SetImageLoader(LoadImageDataFunction func, void *user_data) {
+  if (func == nullptr) {
+    RemoveImageLoader();
+    return;
+  }
+  LoadImageData = std::move(func);
+  load_image_user_data_ = user_data;
+  user_image_loader_ = true;
+}
+
+void TinyGLTF::RemoveImageLoader() {
+  LoadImageData = &tinygltf::LoadImageData;
+
+  load_image_user_data_ = nullptr;
+  user_image_loader_ = false;
+}
+
+void TinyGLTF::SetImageDecoder(const std::string &mime_type,
+                               ImageDecodeFunction func, void *user_data) {
+  if (func == nullptr) {
+    RemoveImageDecoder(mime_type);
+    return;
+  }
+  ImageDecoder decoder;
+  decoder.decode = std::move(func);
+  decoder.user_data = user_data;
+  image_decoders_[mime_type] = std::move(decoder);
+}
+
+void TinyGLTF::RemoveImageDecoder(const std::string &mime_type) {
+  image_decoders_.erase(mime_type);
+}
+
+std::string GetImageMimeType(const unsigned char *bytes, size_t size) {
+  if (bytes == nullptr) {
+    return std::string();
+  }
+  if ((size >= 3) && (bytes[0] == 0xFF) && (bytes[1] == 0xD8) &&
+      (bytes[2] == 0xFF)) {
+    return "image/jpeg";
+  }
+  static const unsigned char png_sig[8] = {0x89, 'P',  'N',  'G',
+                                           0x0D, 0x0A, 0x1A, 0x0A};
+  if ((size >= 8) && (memcmp(bytes, png_sig, 8) == 0)) {
+    return "image/png";
+  }
+  if ((size >= 2) && (bytes[0] == 'B') && (bytes[1] == 'M')) {
+    return "image/bmp";
+  }
+  if ((size >= 6) && ((memcmp(bytes, "GIF87a", 6) == 0) ||
+                      (memcmp(bytes, "GIF89a", 6) == 0))) {
+    return "image/gif";
+  }
+  if ((size >= 12) && (memcmp(bytes, "RIFF", 4) == 0) &&
+      (memcmp(bytes + 8, "WEBP", 4) == 0)) {
+    return "image/webp";
+  }
+  static const unsigned char ktx2_sig[12] = {0xAB, 'K',  'T',  'X',
+                                             ' ',  '2',  '0',  0xBB,
+                                             0x0D, 0x0A, 0x1A, 0x0A};
+  if ((size >= 12) && (memcmp(bytes, ktx2_sig, 12) == 0)) {
+    return "image/ktx2";
+  }
+  return std::string();
+}
+
+#ifdef TINYGLTF_ENABLE_LIBJPEG_TURBO
+namespace {
+
+struct JpegErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jmp;
+  char message[JMSG_LENGTH_MAX];
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  JpegErrorManager *mgr = reinterpret_cast<JpegErrorManager *>(cinfo->err);
+  (*cinfo->err->format_message)(cinfo, mgr->message);
+  longjmp(mgr->jmp, 1);
+}
+
+}  // namespace
+
+bool DecodeImageLibjpegTurbo(std::vector<unsigned char> *out, int *width,
+                             int *height, int *component, int *bits,
+                             int req_component, const unsigned char *bytes,
+                             int size, std::string *err, void *user_data) {
+  (void)user_data;
+
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager jerr;
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = JpegErrorExit;
+  jerr.message[0] = '\0';
+
+  if (setjmp(jerr.jmp)) {
+    jpeg_destroy_decompress(&cinfo);
+    if (err) {
+      (*err) += "libjpeg: " + std::string(jerr.message) + "\n";
+    }
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char *>(bytes),
+               static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+
+  if (cinfo.num_components == 1) {
+    cinfo.out_color_space = JCS_GRAYSCALE;
+  } else {
+#ifdef JCS_EXTENSIONS
+    // libjpeg-turbo can write RGBA directly.
+    cinfo.out_color_space = (req_component == 4) ? JCS_EXT_RGBA : JCS_RGB;
+#else
+    cinfo.out_color_space = JCS_RGB;
+#endif
+  }
+
+  jpeg_start_decompress(&cinfo);
+
+  const size_t row_stride =
+      size_t(cinfo.output_width) * size_t(cinfo.output_components);
+  // Decode straight into the caller's storage.
+  out->resize(row_stride * size_t(cinfo.output_height));
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = out->data() + size_t(cinfo.output_scanline) * row_stride;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  *width = int(cinfo.output_width);
+  *height = int(cinfo.output_height);
+  *component = cinfo.output_components;
+  *bits = 8;
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+#endif
+
+#ifdef TINYGLTF_ENABLE_SPNG
+bool DecodeImageSpng(std::vector<unsigned char> *out, int *width, int *height,
+                     int *component, int *bits, int req_component,
+                     const unsigned char *bytes, int size, std::string *err,
+                     void *user_data) {
+  (void)user_data;
+
+  spng_ctx *ctx = spng_ctx_new(0);
+  if (!ctx) {
+    if (err) {
+      (*err) += "spng: Failed to create context.\n";
+    }
+    return false;
+  }
+
+  int ret = spng_set_png_buffer(ctx, bytes, size_t(size));
+  spng_ihdr ihdr;
+  if (ret == 0) {
+    ret = spng_get_ihdr(ctx, &ihdr);
+  }
+
+  int fmt = SPNG_FMT_RGBA8;
+  int comp = 4;
+  int depth = 8;
+  if (ret == 0) {
+    spng_trns trns;
+    const bool has_alpha = (ihdr.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA) ||
+                           (ihdr.color_type == SPNG_COLOR_TYPE_TRUECOLOR_ALPHA) ||
+                           (spng_get_trns(ctx, &trns) == 0);
+    if (ihdr.bit_depth == 16) {
+      fmt = SPNG_FMT_RGBA16;
+      depth = 16;
+    } else if (!has_alpha && (req_component != 4)) {
+      fmt = SPNG_FMT_RGB8;
+      comp = 3;
+    }
+  }
+
+  size_t out_size = 0;
+  if (ret == 0) {
+    ret = spng_decoded_image_size(ctx, fmt, &out_size);
+  }
+  if (ret == 0) {
+    // Decode straight into the caller's storage.
+    out->resize(out_size);
+    ret = spng_decode_image(ctx, out->data(), out_size, fmt, SPNG_DECODE_TRNS);
+  }
+
+  spng_ctx_free(ctx);
+
+  if (ret != 0) {
+    if (err) {
+      (*err) += "spng: " + std::string(spng_strerror(ret)) + "\n";
+    }
+    return false;
+  }
+
+  *width = int(ihdr.width);
+  *height = int(ihdr.height);
+  *component = comp;
+  *bits = depth;
+  return true;
+}
+#endif
+
+//
+// Box-filter `factor` x `factor` blocks of pixels into one pixel.
+// Rows of a block are first summed into `sums`(a simple loop the compiler can
+// vectorize), then the columns of the block are reduced. Blocks at the
+// right/bottom border may be partial and are averaged over the pixels they
+// actually cover.
+// Output is written in place: output pixel `i` never lies after the input
+// rows which are still needed.
+//
+template <typename T, typename SumT>
+static void DownscaleImageBox(T *pixels, int w, int h, int comp, int factor) {
+  const size_t row_len = size_t(w) * size_t(comp);
+  const int out_w = (w + factor - 1) / factor;
+  const int out_h = (h + factor - 1) / factor;
+
+  std::vector<SumT> sums(row_len);
+  T *dst = pixels;
+
+  for (int oy = 0; oy < out_h; oy++) {
+    const int y0 = oy * factor;
+    const int ny = (std::min)(factor, h - y0);
+
+    std::fill(sums.begin(), sums.end(), SumT(0));
+    for (int y = y0; y < y0 + ny; y++) {
+      const T *src = pixels + size_t(y) * row_len;
+      for (size_t i = 0; i < row_len; i++) {
+        sums[i] += SumT(src[i]);
+      }
+    }
+
+    for (int ox = 0; ox < out_w; ox++) {
+      const int x0 = ox * factor;
+      const int nx = (std::min)(factor, w - x0);
+      const SumT n = SumT(nx) * SumT(ny);
+      for (int c = 0; c < comp; c++) {
+        SumT s = 0;
+        for (int x = x0; x < x0 + nx; x++) {
+          s += sums[size_t(x) * size_t(comp) + size_t(c)];
+        }
+        *dst++ = T((s + n / 2) / n);
+      }
+    }
+  }
+}
+
+//
+// Downscale decoded 8bit/16bit image in place so that both width and height
+// are equal or less than `max_dim`. `width` and `height` are updated.
+//
+static void DownscaleImage(unsigned char *image, int *width, int *height,
+                           int comp, int bits, int max_dim) {
+  if ((max_dim <= 0) || ((*width <= max_dim) && (*height <= max_dim))) {
+    return;
+  }
+
+  const int dim = (std::max)(*width, *height);
+  const int factor = (dim + max_dim - 1) / max_dim;
+  const uint64_t max_value = (bits == 16) ? 65535 : 255;
+  const bool narrow_sum = (uint64_t(factor) * uint64_t(factor) * max_value) <=
+                          uint64_t((std::numeric_limits<uint32_t>::max)());
+
+  if (bits == 16) {
+    uint16_t *pixels = reinterpret_cast<uint16_t *>(image);
+    if (narrow_sum) {
+      DownscaleImageBox<uint16_t, uint32_t>(pixels, *width, *height, comp,
+                                            factor);
+    } else {
+      DownscaleImageBox<uint16_t, uint64_t>(pixels, *width, *height, comp,
+                                            factor);
+    }
+  } else {
+    if (narrow_sum) {
+      DownscaleImageBox<uint8_t, uint32_t>(image, *width, *height, comp,
+                                           factor);
+    } else {
+      DownscaleImageBox<uint8_t, uint64_t>(image, *width, *height, comp,
+                                           factor);
+    }
+  }
+
+  *width = (*width + factor - 1) / factor;
+  *height = (*height + factor - 1) / factor;
+}
+
+//
+// Convert the number of channels of tightly packed pixels. Channel semantics
+// follow stb_image: 1 = grey, 2 = grey + alpha, 3 = RGB, 4 = RGBA.
+//
+template <typename T>
+static void ConvertImageComponentsT(const T *src, T *dst, size_t num_pixels,
+                                    int src_comp, int dst_comp) {
+  const T alpha_one = (std::numeric_limits<T>::max)();
+  for (size_t i = 0; i < num_pixels; i++) {
+    const T *s = src + i * size_t(src_comp);
+    T *d = dst + i * size_t(dst_comp);
+    T r, g, b, a;
+    if (src_comp <= 2) {
+      r = g = b = s[0];
+      a = (src_comp == 2) ? s[1] : alpha_one;
+    } else {
+      r = s[0];
+      g = s[1];
+      b = s[2];
+      a = (src_comp == 4) ? s[3] : alpha_one;
+    }
+    if (dst_comp <= 2) {
+      // Same weights as stb_image.
+      d[0] = T((uint32_t(r) * 77 + uint32_t(g) * 150 + uint32_t(b) * 29) >> 8);
+      if (dst_comp == 2) {
+        d[1] = a;
+      }
+    } else {
+      d[0] = r;
+      d[1] = g;
+      d[2] = b;
+      if (dst_comp == 4) {
+        d[3] = a;
+      }
+    }
+  }
+}
+
+static void ConvertImageComponents(std::vector<unsigned char> *image,
+                                   int width, int height, int bits,
+                                   int src_comp, int dst_comp) {
+  if (src_comp == dst_comp) {
+    return;
+  }
+  const size_t num_pixels = size_t(width) * size_t(height);
+  const size_t dst_size = num_pixels * size_t(dst_comp) * size_t(bits / 8);
+  std::vector<unsigned char> dst(dst_size);
+  if (bits == 16) {
+    ConvertImageComponentsT(reinterpret_cast<const uint16_t *>(image->data()),
+                            reinterpret_cast<uint16_t *>(dst.data()),
+                            num_pixels, src_comp, dst_comp);
+  } else {
+    ConvertImageComponentsT(image->data(), dst.data(), num_pixels, src_comp,
+                            dst_comp);
+  }
+  image->swap(dst);
+}
+
+static float SRGBToLinear(float c) {
+  return (c <= 0.04045f) ? c / 12.92f
+                         : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// IEEE 754 binary16 from binary32(round to nearest).
+static uint16_t FloatToHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(float));
+  const uint32_t sign = (x >> 16) & 0x8000u;
+  const uint32_t biased = (x >> 23) & 0xffu;
+  uint32_t mant = x & 0x7fffffu;
+  if (biased == 0xffu) {  // inf or nan
+    return uint16_t(sign | 0x7c00u | (mant ? 0x200u : 0u));
+  }
+  const int exp = int(biased) - 127 + 15;
+  if (exp >= 31) {
+    return uint16_t(sign | 0x7c00u);
+  }
+  if (exp <= 0) {  // denormal or zero
+    if (exp < -10) {
+      return uint16_t(sign);
+    }
+    mant |= 0x800000u;
+    const uint32_t shift = uint32_t(14 - exp);
+    uint32_t h = mant >> shift;
+    if ((mant >> (shift - 1)) & 1u) {
+      h++;
+    }
+    return uint16_t(sign | h);
+  }
+  uint32_t h = sign | (uint32_t(exp) << 10) | (mant >> 13);
+  if (mant & 0x1000u) {
+    h++;  // may carry into the exponent, which is the correct rounding.
+  }
+  return uint16_t(h);
+}
+
+static bool IsValidImagePixelFormat(int pixel_type, int bits) {
+  return ((pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) &&
+          (bits == 8)) ||
+         ((pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) &&
+          (bits == 16)) ||
+         ((pixel_type == TINYGLTF_COMPONENT_TYPE_FLOAT) &&
+          ((bits == 32) || (bits == 16)));
+}
+
+static void EncodePixel(float f, int, unsigned char *out) {
+  *out = static_cast<unsigned char>(f * 255.0f + 0.5f);
+}
+
+static void EncodePixel(float f, int dst_type, uint16_t *out) {
+  *out = (dst_type == TINYGLTF_COMPONENT_TYPE_FLOAT)
+             ? FloatToHalf(f)
+             : static_cast<uint16_t>(f * 65535.0f + 0.5f);
+}
+
+static void EncodePixel(float f, int, float *out) { *out = f; }
+
+//
+// Builds a lookup table from every source value(8 or 16 bit) to the
+// destination type. The whole conversion(normalization, sRGB decoding,
+// rounding, float16 encoding) is folded into the table, so the per pixel work
+// is a single load and store.
+//
+template <typename DstT>
+static void BuildPixelLUT(std::vector<DstT> *lut, int src_bits, int dst_type,
+                          bool srgb) {
+  const size_t n = size_t(1) << src_bits;
+  const float scale = 1.0f / float(n - 1);
+  lut->resize(n);
+  for (size_t i = 0; i < n; i++) {
+    float f = float(i) * scale;
+    if (srgb) {
+      f = SRGBToLinear(f);
+    }
+    EncodePixel(f, dst_type, &(*lut)[i]);
+  }
+}
+
+template <typename SrcT, typename DstT>
+static void ConvertImagePixelsT(const SrcT *src, DstT *dst, size_t num_pixels,
+                                int comp, int src_bits, int dst_type,
+                                bool srgb) {
+  // Alpha is always linear.
+  const int alpha_channel = ((comp == 2) || (comp == 4)) ? comp - 1 : -1;
+
+  std::vector<DstT> color_lut;
+  std::vector<DstT> alpha_lut;
+  BuildPixelLUT(&color_lut, src_bits, dst_type, srgb);
+  if (srgb && alpha_channel >= 0) {
+    BuildPixelLUT(&alpha_lut, src_bits, dst_type, false);
+  }
+  const DstT *luts[4] = {color_lut.data(), color_lut.data(), color_lut.data(),
+                         color_lut.data()};
+  if (!alpha_lut.empty()) {
+    luts[alpha_channel] = alpha_lut.data();
+  }
+
+  if (comp == 4) {
+    for (size_t i = 0; i < num_pixels; i++) {
+      dst[4 * i + 0] = luts[0][src[4 * i + 0]];
+      dst[4 * i + 1] = luts[1][src[4 * i + 1]];
+      dst[4 * i + 2] = luts[2][src[4 * i + 2]];
+      dst[4 * i + 3] = luts[3][src[4 * i + 3]];
+    }
+  } else {
+    for (size_t i = 0; i < num_pixels; i++) {
+      for (int c = 0; c < comp; c++) {
+        dst[size_t(comp) * i + size_t(c)] = luts[c][src[size_t(comp) * i + size_t(c)]];
+      }
+    }
+  }
+}
+
+//
+// Converts decoded pixels(8 or 16 bit) to `dst_type`/`dst_bits` in a single
+// pass, optionally decoding sRGB color channels to linear.
+//
+static void ConvertImagePixels(const unsigned char *src, int width, int height,
+                               int comp, int src_bits, int dst_type,
+                               int dst_bits, bool srgb,
+                               std::vector<unsigned char> *dst) {
+  const size_t num_pixels = size_t(width) * size_t(height);
+  dst->resize(num_pixels * size_t(comp) * size_t(dst_bits / 8));
+
+  if (src_bits == 16) {
+    const uint16_t *s = reinterpret_cast<const uint16_t *>(src);
+    if (dst_bits == 32) {
+      ConvertImagePixelsT(s, reinterpret_cast<float *>(dst->data()),
+                          num_pixels, comp, src_bits, dst_type, srgb);
+    } else if (dst_bits == 16) {
+      ConvertImagePixelsT(s, reinterpret_cast<uint16_t *>(dst->data()),
+                          num_pixels, comp, src_bits, dst_type, srgb);
+    } else {
+      ConvertImagePixelsT(s, dst->data(), num_pixels, comp, src_bits, dst_type,
+                          srgb);
+    }
+  } else {
+    if (dst_bits == 32) {
+      ConvertImagePixelsT(src, reinterpret_cast<float *>(dst->data()),
+                          num_pixels, comp, src_bits, dst_type, srgb);
+    } else if (dst_bits == 16) {
+      ConvertImagePixelsT(src, reinterpret_cast<uint16_t *>(dst->data()),
+                          num_pixels, comp, src_bits, dst_type, srgb);
+    } else {
+      ConvertImagePixelsT(src, dst->data(), num_pixels, comp, src_bits,
+                          dst_type, srgb);
+    }
+  }
+}
+
+//
+// Stores decoded pixels to `image`, converting them to the pixel format
+// requested in `option`. `pixels` is used(swapped) as is when no conversion is
+// required.
+//
+static void StoreDecodedImage(Image *image, const int image_idx,
+                              const unsigned char *data,
+                              std::vector<unsigned char> *pixels, int w, int h,
+                              int comp, int bits,
+                              const LoadImageDataOption &option) {
+  const bool srgb =
+      option.srgb_to_linear && (image_idx >= 0) &&
+      (size_t(image_idx) < option.srgb_images.size()) &&
+      option.srgb_images[size_t(image_idx)];
+
+  int dst_type = (bits == 16) ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                              : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  int dst_bits = bits;
+  if (IsValidImagePixelFormat(option.target_pixel_type, option.target_bits)) {
+    dst_type = option.target_pixel_type;
+    dst_bits = option.target_bits;
+  }
+
+  const size_t data_size =
+      size_t(w) * size_t(h) * size_t(comp) * size_t(bits / 8);
+  if (!srgb && (dst_bits == bits) &&
+      (dst_type != TINYGLTF_COMPONENT_TYPE_FLOAT)) {
+    if (pixels) {
+      pixels->resize(data_size);
+      image->image.swap(*pixels);
+    } else {
+      image->image.assign(data, data + data_size);
+    }
+  } else {
+    ConvertImagePixels(data, w, h, comp, bits, dst_type, dst_bits, srgb,
+                       &image->image);
+  }
+
+  image->width = w;
+  image->height = h;
+  image->component = comp;
+  image->bits = dst_bits;
+  image->pixel_type = dst_type;
+}
+
+//
+// Decode with an image decoder backend. Returns false when no backend is
+// available for the image or the backend fails(the caller falls back to
+// stb_image).
+//
+static bool DecodeImageWithBackend(Image *image, const int image_idx,
+                                   std::string *warn, int req_width,
+                                   int req_height, int req_comp,
+                                   const unsigned char *bytes, int size,
+                                   const LoadImageDataOption &option) {
+  if (!option.decoders || option.decoders->empty()) {
+    return false;
+  }
+
+  const std::string mime_type =
+      GetImageMimeType(bytes, static_cast<size_t>(size));
+  if (mime_type.empty()) {
+    return false;
+  }
+
+  std::map<std::string, ImageDecoder>::const_iterator it =
+      option.decoders->find(mime_type);
+  if (it == option.decoders->end() || !it->second.decode) {
+    return false;
+  }
+  const ImageDecodeFunction &decode = it->second.decode;
+  void *decoder_user_data = it->second.user_data;
+
+  std::vector<unsigned char> pixels;
+  int w = 0, h = 0, comp = 0, bits = 0;
+  std::string decode_err;
+  if (!decode(&pixels, &w, &h, &comp, &bits, req_comp, bytes, size,
+              &decode_err, decoder_user_data) ||
+      (w < 1) || (h < 1) || (comp < 1) || (comp > 4) ||
+      ((bits != 8) && (bits != 16)) ||
+      (pixels.size() <
+       size_t(w) * size_t(h) * size_t(comp) * size_t(bits / 8))) {
+    if (warn) {
+      (*warn) += "Image decoder for \"" + mime_type +
+                 "\" failed. Fall back to stb_image for image[" +
+                 std::to_string(image_idx) + "] name = \"" + image->name +
+                 "\". " + decode_err + "\n";
+    }
+    return false;
+  }
+
+  if (((req_width > 0) && (req_width != w)) ||
+      ((req_height > 0) && (req_height != h))) {
+    // Let the stb_image path report the mismatch.
+    return false;
+  }
+
+  if ((req_comp != 0) && (req_comp != comp)) {
+    ConvertImageComponents(&pixels, w, h, bits, comp, req_comp);
+    comp = req_comp;
+  }
+
+  if (option.max_image_dimension > 0) {
+    DownscaleImage(pixels.data(), &w, &h, comp, bits,
+                   option.max_image_dimension);
+  }
+
+  StoreDecodedImage(image, image_idx, pixels.data(), &pixels, w, h, comp, bits,
+                    option);
+  image->as_is = false;
+  return true;
+}
+
+#ifndef TINYGLTF_NO_STB_IMAGE
+bool LoadImageData(Image *image, const int image_idx, std::string *err,
+                   std::string *warn, int req_width, int req_height,
+                   const unsigned char *bytes, int size, void *user_data) {
+  const LoadImageDataOption default_option;
+  const LoadImageDataOption &option =
+      user_data ? *reinterpret_cast<const LoadImageDataOption *>(user_data)
+                : default_option;
+
+  int w = 0, h = 0, comp = 0, req_comp = 0;
+
+  if (option.header_only) {
+    image->image.clear();
+    image->as_is = false;
+    if (!stbi_info_from_memory(bytes, size, &w, &h, &comp)) {
+      if (warn) {
+        (*warn) +=
+            "Unknown image format. STB cannot decode image header for image[" +
+            std::to_string(image_idx) + "] name = \"" + image->name + "\".\n";
+      }
+      image->width = image->height = image->component = -1;
+      image->bits = image->pixel_type = -1;
+      return true;
+    }
+    const bool is_16bit = stbi_is_16_bit_from_memory(bytes, size) != 0;
+    image->width = w;
+    image->height = h;
+    image->component = comp;
+    image->bits = is_16bit ? 16 : 8;
+    image->pixel_type = is_16bit ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                                 : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    return true;
+  }
+
+  if (!option.as_is) {
+    req_comp = option.preserve_channels ? 0 : 4;
+    if ((option.target_components >= 1) && (option.target_components <= 4)) {
+      req_comp = option.target_components;
+    }
+    if (DecodeImageWithBackend(image, image_idx, warn, req_width, req_height,
+                               req_comp, bytes, size, option)) {
+      return true;
+    }
+  }
+
+  // Try to decode image header
+  if (!stbi_info_from_memory(bytes, size, &w, &h, &comp)) {
+    // On failure, if we load images as is, we just warn.
+    std::string* msgOut = option.as_is ? warn : err;
+    if (msgOut) {
+      (*msgOut) +=
+        "Unknown image format. STB cannot decode image header for image[" +
+        std::to_string(image_idx) + "] name = \"" + image->name + "\".\n";
+    }
+    if (!option.as_is) {
+      // If we decode images, error out.
+      return false;
+    } else {
+      // If we load images as is, we copy the image data,
+      // set all image properties to invalid, and report success.
+      image->width = image->height = image->component = -1;
+      image->bits = image->pixel_type = -1;
+      image->as_is = true;
+      if (!option.as_is_no_copy) {
+        image->image.assign(bytes, bytes + size);
+      }
+      return true;
+    }
+  }
+
+  int bits = 8;
+  int pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+
+  if (stbi_is_16_bit_from_memory(bytes, size)) {
+    bits = 16;
+    pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  }
+
+  // preserve_channels true: Use channels stored in the image file.
+  // false: force 32-bit textures for common Vulkan compatibility. It appears
+  // that some GPU drivers do not support 24-bit images for Vulkan
+  req_comp = (option.preserve_channels || option.as_is) ? 0 : 4;
+  if (!option.as_is && (option.target_components >= 1) &&
+      (option.target_components <= 4)) {
+    req_comp = option.target_components;
+  }
+
+  unsigned char* data = nullptr;
+  // Perform image decoding if requested
+  if (!option.as_is) {
+    // If the image is marked as 16 bit per channel, attempt to decode it as such first.
+    // If that fails, we are going to attempt to load it as 8 bit per channel image.
+    if (bits == 16) {
+      data = reinterpret_cast<unsigned char *>(stbi_load_16_from_memory(bytes, size, &w, &h, &comp, req_comp));
+    }
+    // Load as 8 bit per channel data
+    if (!data) {
+      data = stbi_load_from_memory(bytes, size, &w, &h, &comp, req_comp);
+      if (!data) {
+        if (err) {
+          (*err) +=
+            "Unknown image format. STB cannot decode image data for image[" +
+            std::to_string(image_idx) + "] name = \"" + image->name + "\".\n";
+        }
+        return false;
+      }
+      // If we were succesful, mark as 8 bit
+      bits = 8;
+      pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    }
+  }
+
+  if ((w < 1) || (h < 1)) {
+    stbi_image_free(data);
+    if (err) {
+      (*err) += "Invalid image data for image[" + std::to_string(image_idx) +
+                "] name = \"" + image->name + "\"\n";
+    }
+    return false;
+  }
+
+  if (req_width > 0) {
+    if (req_width != w) {
+      stbi_image_free(data);
+      if (err) {
+        (*err) += "Image width mismatch for image[" +
+                  std::to_string(image_idx) + "] name = \"" + image->name +
+                  "\"\n";
+      }
+      return false;
+    }
+  }
+
+  if (req_height > 0) {
+    if (req_height != h) {
+      stbi_image_free(data);
+      if (err) {
+        (*err) += "Image height mismatch. for image[" +
+                  std::to_string(image_idx) + "] name = \"" + image->name +
+                  "\"\n";
+      }
+      return false;
+    }
+  }
+
+  if (req_comp != 0) {
+    // loaded data has `req_comp` channels(components)
+    comp = req_comp;
+  }
+
+  if (option.as_is) {
+    // Store the original image data, unless the caller keeps it.
+    if (!option.as_is_no_copy) {
+      image->image.assign(bytes, bytes + size);
+    }
+  } else {
+    // Shrink within the decoder's buffer so that only the downscaled pixels
+    // are copied.
+    if (option.max_image_dimension > 0) {
+      DownscaleImage(data, &w, &h, comp, bits, option.max_image_dimension);
+    }
+
+    // Store the decoded image data. Pixels are copied(or converted to the
+    // requested pixel format) in a single pass, and the decoder's buffer is
+    // released right after.
+    StoreDecodedImage(image, image_idx, data, nullptr, w, h, comp, bits,
+                      option);
+    stbi_image_free(data);
+    image->as_is = false;
+    return true;
+  }
+
+  image->width = w;
+  image->height = h;
+  image->component = comp;
+  image->bits = bits;
+  image->pixel_type = pixel_type;
+  image->as_is = option.as_is;
+
+  return true;
+}
+#else
+bool LoadImageData(Image *image, const int image_idx, std::string *err,
+                   std::string *warn, int req_width, int req_height,
+                   const unsigned char *bytes, int size, void *user_data) {
+  const LoadImageDataOption default_option;
+  const LoadImageDataOption &option =
+      user_data ? *reinterpret_cast<const LoadImageDataOption *>(user_data)
+                : default_option;
+
+  if (!option.as_is && !option.header_only) {
+    int req_comp = option.preserve_channels ? 0 : 4;
+    if ((option.target_components >= 1) && (option.target_components <= 4)) {
+      req_comp = option.target_components;
+    }
+    if (DecodeImageWithBackend(image, image_idx, warn, req_width, req_height,
+                               req_comp, bytes, size, option)) {
+      return true;
+    }
+    if (err) {
+      (*err) += "No image decoder for image[" + std::to_string(image_idx) +
+                "] name = \"" + image->name +
+                "\"(stb_image is disabled).\n";
+    }
+    return false;
+  }
+
+  // The header is not parsed without stb_image: the image properties are
+  // unknown, and as-is images keep their encoded bytes.
+  image->width = image->height = image->component = -1;
+  image->bits = image->pixel_type = -1;
+  image->as_is = option.as_is;
+  image->image.clear();
+  if (option.as_is && !option.as_is_no_copy) {
+    image->image.assign(bytes, bytes + size);
+  }
+  return true;
+}
+#endif
+
+void TinyGLTF::SetImageWriter(WriteImageDataFunction func, void *user_data) {
+  WriteImageData = std::move(func);
+  write_image_user_data_ = user_data;
+}
+
+#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
+static void WriteToMemory_stbi(void *context, void *data, int size) {
+  std::vector<unsigned char> *buffer =
+      reinterpret_cast<std::vector<unsigned char> *>(context);
+
+  unsigned char *pData = reinterpret_cast<unsigned char *>(data);
+
+  buffer->insert(buffer->end(), pData, pData + size);
+}
+
+bool WriteImageData(const std::string *basepath, const std::string *filename,
+                    const Image *image, bool embedImages,
+                    const FsCallbacks* fs_cb, const URICallbacks *uri_cb,
+                    std::string *out_uri, void *) {
+  // Early out on empty images, report the original uri if the image was not written.
+  if (image->image.empty()) {
+    *out_uri = *filename;
+    return true;
+  }
+
+  const std::string ext = GetFilePathExtension(*filename);
+
+  // Write image to temporary buffer
+  std::string header;
+  std::vector<unsigned char> data;
+
+  // If the image data is already encoded, take it as is
+  if (image->as_is) {
+      data = image->image;
+  }
+
+  if (ext == "png") {
+    if (!image->as_is) {
+      if ((image->bits != 8) ||
+          (image->pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)) {
+          // Unsupported pixel format
+          return false;
+      }
+
+      if (!stbi_write_png_to_func(WriteToMemory_stbi, &data, image->width,
+                                  image->height, image->component,
+                                  &image->image[0], 0)) {
+        return false;
+      }
+    }
+    header = "data:image/png;base64,";
+  } else if (ext == "jpg") {
+    if (!image->as_is &&
+        !stbi_write_jpg_to_func(WriteToMemory_stbi, &data, image->width,
+                                image->height, image->component,
+                                &image->image[0], 100)) {
+      return false;
+    }
+    header = "data:image/jpeg;base64,";
+  } else if (ext == "bmp") {
+    if (!image->as_is &&
+        !stbi_write_bmp_to_func(WriteToMemory_stbi, &data, image->width,
+                                image->height, image->component,
+                                &image->image[0])) {
+      return false;
+    }
+    header = "data:image/bmp;base64,";
+  } else if (!embedImages) {
+    // Error: can't output requested format to file
+    return false;
+  }
+
+  if (embedImages) {
+    // Embed base64-encoded image into URI
+    if (data.size()) {
+      *out_uri = header + base64_encode(&data[0],
+                                        static_cast<unsigned int>(data.size()));
+    } else {
+      // Throw error?
+    }
+  } else {
+    // Write image to disc
+    if ((fs_cb != nullptr) && (fs_cb->WriteWholeFile != nullptr)) {
+      const std::string imagefilepath = JoinPath(*basepath, *filename);
+      std::string writeError;
+      if (!fs_cb->WriteWholeFile(&writeError, imagefilepath, data,
+                              fs_cb->user_data)) {
+        // Could not write image file to disc; Throw error ?
+        return false;
+      }
+    } else {
+      // Throw error?
+    }
+    if (uri_cb->encode) {
+      if (!uri_cb->encode(*filename, "image", out_uri, uri_cb->user_data)) {
+        return false;
+      }
+    } else {
+      *out_uri = *filename;
+    }
+  }
+
+  return true;
+}
+#endif
+
+bool TinyGLTF::SetURICallbacks(URICallbacks callbacks, std::string* err) {
+  if (callbacks.decode == nullptr) {
+    if (err != nullptr) {
+      *err = "URI Callback require a non-null decode function.";
+    }
+    return false;
+  }
+
+  if (callbacks.decode) {
+    uri_cb = std::move(callbacks);
+  }
+  return true;
+}
+
+bool TinyGLTF::SetFsCallbacks(FsCallbacks callbacks, std::string *err) {
+  // If callbacks are defined at all, they must all be defined.
+  if (callbacks.FileExists == nullptr || callbacks.ExpandFilePath == nullptr ||
+      callbacks.ReadWholeFile == nullptr ||
+      callbacks.WriteWholeFile == nullptr ||
+      callbacks.GetFileSizeInBytes == nullptr) {
+    if (err != nullptr) {
+      *err =
+          "FS Callbacks must be completely defined. At least one callback is "
+          "null.";
+    }
+    return false;
+  }
+  fs = std::move(callbacks);
+  return true;
+}
+
+#ifdef _WIN32
+static inline std::wstring UTF8ToWchar(const std::string &str) {
+  int wstr_size =
+      MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), nullptr, 0);
+  std::wstring wstr((size_t)wstr_size, 0);
+  MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), &wstr[0],
+                      (int)wstr.size());
+  return wstr;
+}
+
+static inline std::string WcharToUTF8(const std::wstring &wstr) {
+  int str_size = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), (int)wstr.size(),
+                                     nullptr, 0, nullptr, nullptr);
+  std::string str((size_t)str_size, 0);
+  WideCharToMultiByte(CP_UTF8, 0, wstr.data(), (int)wstr.size(), &str[0],
+                      (int)str.size(), nullptr, nullptr);
+  return str;
+}
+#endif
+
+#ifndef TINYGLTF_NO_FS
+// Default implementations of filesystem functions
+
+bool FileExists(const std::string &abs_filename, void *) {
+  bool ret;
+#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+  if (asset_manager) {
+    AAsset *asset = AAssetManager_open(asset_manager, abs_filename.c_str(),
+                                       AASSET_MODE_STREAMING);
+    if (!asset) {
+      return false;
+    }
+    AAsset_close(asset);
+    ret = true;
+  } else {
+    return false;
+  }
+#else
+#ifdef _WIN32
+#if defined(_MSC_VER) || defined(_LIBCPP_VERSION)
+
+  // First check if a file is a directory.
+  DWORD result = GetFileAttributesW(UTF8ToWchar(abs_filename).c_str());
+  if (result == INVALID_FILE_ATTRIBUTES) {
+    return false;
+  }
+  if (result & FILE_ATTRIBUTE_DIRECTORY) {
+    return false;
+  }
+
+  FILE *fp = nullptr;
+  errno_t err = _wfopen_s(&fp, UTF8ToWchar(abs_filename).c_str(), L"rb");
+  if (err != 0) {
+    return false;
+  }
+#elif defined(__GLIBCXX__)
+  FILE *fp = fopen(abs_filename.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+#else
+  // TODO: is_directory check
+  FILE *fp = nullptr;
+  errno_t err = fopen_s(&fp, abs_filename.c_str(), "rb");
+  if (err != 0) {
+    return false;
+  }
+#endif
+
+#else
+  struct stat sb;
+  if (stat(abs_filename.c_str(), &sb)) {
+    return false;
+  }
+  if (S_ISDIR(sb.st_mode)) {
+    return false;
+  }
+
+  FILE *fp = fopen(abs_filename.c_str(), "rb");
+#endif
+  if (fp) {
+    ret = true;
+    fclose(fp);
+  } else {
+    ret = false;
+  }
+#endif
+
+  return ret;
+}
+
+std::string ExpandFilePath(const std::string &filepath, void *) {
+  // https://github.com/syoyo/tinygltf/issues/368
+  //
+  // No file path expansion in built-in FS function anymore, since glTF URI
+  // should not contain tilde('~') and environment variables, and for security
+  // reason(`wordexp`).
+  //
+  // Users need to supply `base_dir`(in `LoadASCIIFromString`,
+  // `LoadBinaryFromMemory`) in expanded absolute path.
+
+  return filepath;
+
+#if 0
+#ifdef _WIN32
+  // Assume input `filepath` is encoded in UTF-8
+  std::wstring wfilepath = UTF8ToWchar(filepath);
+  DWORD wlen = ExpandEnvironmentStringsW(wfilepath.c_str(), nullptr, 0);
+  wchar_t *wstr = new wchar_t[wlen];
+  ExpandEnvironmentStringsW(wfilepath.c_str(), wstr, wlen);
+
+  std::wstring ws(wstr);
+  delete[] wstr;
+  return WcharToUTF8(ws);
+
+#else
+
+#if defined(TARGET_OS_IPHONE) || defined(TARGET_IPHONE_SIMULATOR) || \
+    defined(__ANDROID__) || defined(__EMSCRIPTEN__) || defined(__OpenBSD__)
+  // no expansion
+  std::string s = filepath;
+#else
+  std::string s;
+  wordexp_t p;
+
+  if (filepath.empty()) {
+    return "";
+  }
+
+  // Quote the string to keep any spaces in filepath intact.
+  std::string quoted_path = "\"" + filepath + "\"";
+  // char** w;
+  int ret = wordexp(quoted_path.c_str(), &p, 0);
+  if (ret) {
+    // err
+    s = filepath;
+    return s;
+  }
+
+  // Use first element only.
+  if (p.we_wordv) {
+    s = std::string(p.we_wordv[0]);
+    wordfree(&p);
+  } else {
+    s = filepath;
+  }
+
+#endif
+
+  return s;
+#endif
+#endif
+}
+
+bool GetFileSizeInBytes(size_t *filesize_out, std::string *err,
+                        const std::string &filepath, void *userdata) {
+  (void)userdata;
+
+#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+  if (asset_manager) {
+    AAsset *asset = AAssetManager_open(asset_manager, filepath.c_str(),
+                                       AASSET_MODE_STREAMING);
+    if (!asset) {
+      if (err) {
+        (*err) += "File open error : " + filepath + "\n";
+      }
+      return false;
+    }
+    size_t size = AAsset_getLength(asset);
+
+    if (size == 0) {
+      if (err) {
+        (*err) += "Invalid file size : " + filepath +
+                  " (does the path point to a directory?)";
+      }
+      return false;
+    }
+
+    return true;
+  } else {
+    if (err) {
+      (*err) += "No asset manager specified : " + filepath + "\n";
+    }
+    return false;
+  }
+#else
+#ifdef _WIN32
+#if defined(__GLIBCXX__)  // mingw
+  int file_descriptor =
+      _wopen(UTF8ToWchar(filepath).c_str(), _O_RDONLY | _O_BINARY);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(file_descriptor, std::ios_base::in);
+  std::istream f(&wfile_buf);
+#elif defined(_MSC_VER) || defined(_LIBCPP_VERSION)
+  // For libcxx, assume _LIBCPP_HAS_OPEN_WITH_WCHAR is defined to accept
+  // `wchar_t *`
+  std::ifstream f(UTF8ToWchar(filepath).c_str(), std::ifstream::binary);
+#else
+  // Unknown compiler/runtime
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+#else
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+  if (!f) {
+    if (err) {
+      (*err) += "File open error : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  // For directory(and pipe?), peek() will fail(Posix gnustl/libc++ only)
+  f.peek();
+  if (!f) {
+    if (err) {
+      (*err) +=
+          "File read error. Maybe empty file or invalid file : " + filepath +
+          "\n";
+    }
+    return false;
+  }
+
+  f.seekg(0, f.end);
+  const auto sz = f.tellg();
+
+  // std::cout << "sz = " << sz << "\n";
+  f.seekg(0, f.beg);
+
+  if (sz < 0) {
+    if (err) {
+      (*err) += "Invalid file size : " + filepath +
+                " (does the path point to a directory?)";
+    }
+    return false;
+  } else if (sz == std::streamoff(0)) {
+    if (err) {
+      (*err) += "File is empty : " + filepath + "\n";
+    }
+    return false;
+  } else if (sz >= (std::numeric_limits<std::streamoff>::max)()) {
+    if (err) {
+      (*err) += "Invalid file size : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  (*filesize_out) = static_cast<size_t>(sz);
+  return true;
+#endif
+}
+
+bool ReadWholeFile(std::vector<unsigned char> *out, std::string *err,
+                   const std::string &filepath, void *) {
+#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+  if (asset_manager) {
+    AAsset *asset = AAssetManager_open(asset_manager, filepath.c_str(),
+                                       AASSET_MODE_STREAMING);
+    if (!asset) {
+      if (err) {
+        (*err) += "File open error : " + filepath + "\n";
+      }
+      return false;
+    }
+    size_t size = AAsset_getLength(asset);
+    if (size == 0) {
+      if (err) {
+        (*err) += "Invalid file size : " + filepath +
+                  " (does the path point to a directory?)";
+      }
+      return false;
+    }
+    out->resize(static_cast<size_t>(size));
+    AAsset_read(asset, reinterpret_cast<char *>(&out->at(0)), size);
+    AAsset_close(asset);
+    return true;
+  } else {
+    if (err) {
+      (*err) += "No asset manager specified : " + filepath + "\n";
+    }
+    return false;
+  }
+#else
+#ifdef _WIN32
+#if defined(__GLIBCXX__)  // mingw
+  int file_descriptor =
+      _wopen(UTF8ToWchar(filepath).c_str(), _O_RDONLY | _O_BINARY);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(file_descriptor, std::ios_base::in);
+  std::istream f(&wfile_buf);
+#elif defined(_MSC_VER) || defined(_LIBCPP_VERSION)
+  // For libcxx, assume _LIBCPP_HAS_OPEN_WITH_WCHAR is defined to accept
+  // `wchar_t *`
+  std::ifstream f(UTF8ToWchar(filepath).c_str(), std::ifstream::binary);
+#else
+  // Unknown compiler/runtime
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+#else
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+  if (!f) {
+    if (err) {
+      (*err) += "File open error : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  // For directory(and pipe?), peek() will fail(Posix gnustl/libc++ only)
+  f.peek();
+  if (!f) {
+    if (err) {
+      (*err) +=
+          "File read error. Maybe empty file or invalid file : " + filepath +
+          "\n";
+    }
+    return false;
+  }
+
+  f.seekg(0, f.end);
+  const auto sz = f.tellg();
+
+  // std::cout << "sz = " << sz << "\n";
+  f.seekg(0, f.beg);
+
+  if (sz < 0) {
+    if (err) {
+      (*err) += "Invalid file size : " + filepath +
+                " (does the path point to a directory?)";
+    }
+    return false;
+  } else if (sz == std::streamoff(0)) {
+    if (err) {
+      (*err) += "File is empty : " + filepath + "\n";
+    }
+    return false;
+  } else if (sz >= (std::numeric_limits<std::streamoff>::max)()) {
+    if (err) {
+      (*err) += "Invalid file size : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  out->resize(sz);
+  f.read(reinterpret_cast<char *>(&out->at(0)),
+         static_cast<std::streamsize>(sz));
+
+  return true;
+#endif
+}
+
+bool ReadFileRange(std::vector<unsigned char> *out, std::string *err,
+                   const std::string &filepath, size_t offset, size_t length,
+                   void *) {
+#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
+  if (asset_manager) {
+    AAsset *asset = AAssetManager_open(asset_manager, filepath.c_str(),
+                                       AASSET_MODE_STREAMING);
+    if (!asset) {
+      if (err) {
+        (*err) += "File open error : " + filepath + "\n";
+      }
+      return false;
+    }
+    AAsset_seek(asset, static_cast<off_t>(offset), SEEK_SET);
+    out->resize(length);
+    int n = AAsset_read(asset, reinterpret_cast<char *>(out->data()), length);
+    AAsset_close(asset);
+    out->resize(n > 0 ? static_cast<size_t>(n) : 0);
+    return true;
+  } else {
+    if (err) {
+      (*err) += "No asset manager specified : " + filepath + "\n";
+    }
+    return false;
+  }
+#else
+#ifdef _WIN32
+#if defined(__GLIBCXX__)  // mingw
+  int file_descriptor =
+      _wopen(UTF8ToWchar(filepath).c_str(), _O_RDONLY | _O_BINARY);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(file_descriptor, std::ios_base::in);
+  std::istream f(&wfile_buf);
+#elif defined(_MSC_VER) || defined(_LIBCPP_VERSION)
+  // For libcxx, assume _LIBCPP_HAS_OPEN_WITH_WCHAR is defined to accept
+  // `wchar_t *`
+  std::ifstream f(UTF8ToWchar(filepath).c_str(), std::ifstream::binary);
+#else
+  // Unknown compiler/runtime
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+#else
+  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+#endif
+  if (!f) {
+    if (err) {
+      (*err) += "File open error : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  out->clear();
+  f.seekg(static_cast<std::streamoff>(offset), f.beg);
+  if (!f) {
+    // Beyond the end of file.
+    return true;
+  }
+
+  out->resize(length);
+  f.read(reinterpret_cast<char *>(out->data()),
+         static_cast<std::streamsize>(length));
+  out->resize(static_cast<size_t>(f.gcount()));
+
+  return true;
+#endif
+}
+
+bool WriteWholeFile(std::string *err, const std::string &filepath,
+                    const std::vector<unsigned char> &contents, void *) {
+#ifdef _WIN32
+#if defined(__GLIBCXX__)  // mingw
+  int file_descriptor = _wopen(UTF8ToWchar(filepath).c_str(),
+                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(
+      file_descriptor, std::ios_base::out | std::ios_base::binary);
+  std::ostream f(&wfile_buf);
+#elif defined(_MSC_VER)
+  std::ofstream f(UTF8ToWchar(filepath).c_str(), std::ofstream::binary);
+#else  // clang?
+  std::ofstream f(filepath.c_str(), std::ofstream::binary);
+#endif
+#else
+  std::ofstream f(filepath.c_str(), std::ofstream::binary);
+#endif
+  if (!f) {
+    if (err) {
+      (*err) += "File open error for writing : " + filepath + "\n";
+    }
+    return false;
+  }
+
+  f.write(reinterpret_cast<const char *>(&contents.at(0)),
+          static_cast<std::streamsize>(contents.size()));
+  if (!f) {
+    if (err) {
+      (*err) += "File write error: " + filepath + "\n";
+    }
+    return false;
+  }
+
+  return true;
+}
+
+#endif  // TINYGLTF_NO_FS
+
+static std::string MimeToExt(const std::string &mimeType) {
+  if (mimeType == "image/jpeg") {
+    return "jpg";
+  } else if (mimeType == "image/png") {
+    return "png";
+  } else if (mimeType == "image/bmp") {
+    return "bmp";
+  } else if (mimeType == "image/gif") {
+    return "gif";
+  }
+
+  return "";
+}
+
+static bool UpdateImageObject(const Image &image, std::string &baseDir,
+                              int index, bool embedImages,
+                              const FsCallbacks *fs_cb,
+                              const URICallbacks *uri_cb,
+                              const WriteImageDataFunction& WriteImageData,
+                              void *user_data, std::string *out_uri) {
+  std::string filename;
+  std::string ext;
+  // If image has uri, use it as a filename
+  if (image.uri.size()) {
+    std::string decoded_uri;
+    if (!uri_cb->decode(image.uri, &decoded_uri, uri_cb->user_data)) {
+      // A decode failure results in a failure to write the gltf.
+      return false;
+    }
+    filename = GetBaseFilename(decoded_uri);
+    ext = GetFilePathExtension(filename);
+  } else if (image.bufferView != -1) {
+    // If there's no URI and the data exists in a buffer,
+    // don't change properties or write images
+  } else if (image.name.size()) {
+    ext = MimeToExt(image.mimeType);
+    // Otherwise use name as filename
+    filename = image.name + "." + ext;
+  } else {
+    ext = MimeToExt(image.mimeType);
+    // Fallback to index of image as filename
+    filename = std::to_string(index) + "." + ext;
+  }
+
+  // If callback is set, modify image data object.
+  // Note that the callback is also invoked for images without data.
+  // The default callback implementation simply returns true for
+  // empty images and sets the out URI to filename.
+  bool imageWritten = false;
+  if (WriteImageData != nullptr && !filename.empty()) {
+    imageWritten = WriteImageData(&baseDir, &filename, &image, embedImages,
+                                  fs_cb, uri_cb, out_uri, user_data);
+    if (!imageWritten) {
+      return false;
+    }
+  }
+
+  // Use the original uri if the image was not written.
+  if (!imageWritten) {
+    *out_uri = image.uri;
+  }
+
+  return true;
+}
+
+bool IsDataURI(const std::string &in) {
+  std::string header = "data:application/octet-stream;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:image/jpeg;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:image/png;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:image/bmp;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:image/gif;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:text/plain;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  header = "data:application/gltf-buffer;base64,";
+  if (in.find(header) == 0) {
+    return true;
+  }
+
+  return false;
+}
+
+bool DecodeDataURI(std::vector<unsigned char> *out, std::string &mime_type,
+                   const std::string &in, size_t reqBytes, bool checkSize) {
+  std::string header = "data:application/octet-stream;base64,";
+  std::string data;
+  if (in.find(header) == 0) {
+    data = base64_decode(in.substr(header.size()));  // cut mime string.
+  }
+
+  if (data.empty()) {
+    header = "data:image/jpeg;base64,";
+    if (in.find(header) == 0) {
+      mime_type = "image/jpeg";
+      data = base64_decode(in.substr(header.size()));  // cut mime string.
+    }
+  }
+
+  if (data.empty()) {
+    header = "data:image/png;base64,";
+    if (in.find(header) == 0) {
+      mime_type = "image/png";
+      data = base64_decode(in.substr(header.size()));  // cut mime string.
+    }
+  }
+
+  if (data.empty()) {
+    header = "data:image/bmp;base64,";
+    if (in.find(header) == 0) {
+      mime_type = "image/bmp";
+      data = base64_decode(in.substr(header.size()));  // cut mime string.
+    }
+  }
+
+  if (data.empty()) {
+    header = "data:image/gif;base64,";
+    if (in.find(header) == 0) {
+      mime_type = "image/gif";
+      data = base64_decode(in.substr(header.size()));  // cut mime string.
+    }
+  }
+
+  if (data.empty()) {
+    header = "data:text/plain;base64,";
+    if (in.find(header) == 0) {
+      mime_type = "text/plain";
+      data = base64_decode(in.substr(header.size()));
+    }
+  }
+
+  if (data.empty()) {
+    header = "data:application/gltf-buffer;base64,";
+    if (in.find(header) == 0) {
+      data = base64_decode(in.substr(header.size()));
+    }
+  }
+
+  // TODO(syoyo): Allow empty buffer? #229
+  if (data.empty()) {
+    return false;
+  }
+
+  if (checkSize) {
+    if (data.size() != reqBytes) {
+      return false;
+    }
+    out->resize(reqBytes);
+  } else {
+    out->resize(data.size());
+  }
+  std::copy(data.begin(), data.end(), out->begin());
+  return true;
+}
+
+namespace detail {
+bool GetInt(const detail::json &o, int &val) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (!o.IsDouble()) {
+    if (o.IsInt()) {
+      val = o.GetInt();
+      return true;
+    } else if (o.IsUint()) {
+      val = static_cast<int>(o.GetUint());
+      return true;
+    } else if (o.IsInt64()) {
+      val = static_cast<int>(o.GetInt64());
+      return true;
+    } else if (o.IsUint64()) {
+      val = static_cast<int>(o.GetUint64());
+      return true;
+    }
+  }
+
+  return false;
+#else
+  auto type = o.type();
+
+  if ((type == detail::json::value_t::number_integer) ||
+      (type == detail::json::value_t::number_unsigned)) {
+    val = static_cast<int>(o.get<int64_t>());
+    return true;
+  }
+
+  return false;
+#endif
+}
+
+#ifdef TINYGLTF_USE_RAPIDJSON
+bool GetDouble(const detail::json &o, double &val) {
+  if (o.IsDouble()) {
+    val = o.GetDouble();
+    return true;
+  }
+
+  return false;
+}
+#endif
+
+bool GetNumber(const detail::json &o, double &val) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (o.IsNumber()) {
+    val = o.GetDouble();
+    return true;
+  }
+
+  return false;
+#else
+  if (o.is_number()) {
+    val = o.get<double>();
+    return true;
+  }
+
+  return false;
+#endif
+}
+
+bool GetString(const detail::json &o, std::string &val) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (o.IsString()) {
+    val = o.GetString();
+    return true;
+  }
+
+  return false;
+#else
+  if (o.type() == detail::json::value_t::string) {
+    val = o.get<std::string>();
+    return true;
+  }
+
+  return false;
+#endif
+}
+
+bool IsArray(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.IsArray();
+#else
+  return o.is_array();
+#endif
+}
+
+detail::json_const_array_iterator ArrayBegin(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.Begin();
+#else
+  return o.begin();
+#endif
+}
+
+detail::json_const_array_iterator ArrayEnd(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.End();
+#else
+  return o.end();
+#endif
+}
+
+bool IsObject(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.IsObject();
+#else
+  return o.is_object();
+#endif
+}
+
+detail::json_const_iterator ObjectBegin(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.MemberBegin();
+#else
+  return o.begin();
+#endif
+}
+
+detail::json_const_iterator ObjectEnd(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.MemberEnd();
+#else
+  return o.end();
+#endif
+}
+
+// Making this a const char* results in a pointer to a temporary when
+// TINYGLTF_USE_RAPIDJSON is off.
+std::string GetKey(detail::json_const_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return it->name.GetString();
+#else
+  return it.key().c_str();
+#endif
+}
+
+bool FindMember(const detail::json &o, const char *member,
+                detail::json_const_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (!o.IsObject()) {
+    return false;
+  }
+  it = o.FindMember(member);
+  return it != o.MemberEnd();
+#else
+  it = o.find(member);
+  return it != o.end();
+#endif
+}
+
+bool FindMember(detail::json &o, const char *member,
+                detail::json_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (!o.IsObject()) {
+    return false;
+  }
+  it = o.FindMember(member);
+  return it != o.MemberEnd();
+#else
+  it = o.find(member);
+  return it != o.end();
+#endif
+}
+
+void Erase(detail::json &o, detail::json_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  o.EraseMember(it);
+#else
+  o.erase(it);
+#endif
+}
+
+bool IsEmpty(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.ObjectEmpty();
+#else
+  return o.empty();
+#endif
+}
+
+const detail::json &GetValue(detail::json_const_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return it->value;
+#else
+  return it.value();
+#endif
+}
+
+detail::json &GetValue(detail::json_iterator &it) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return it->value;
+#else
+  return it.value();
+#endif
+}
+
+std::string JsonToString(const detail::json &o, int spacing = -1) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  using namespace rapidjson;
+  StringBuffer buffer;
+  if (spacing == -1) {
+    Writer<StringBuffer> writer(buffer);
+    // TODO: Better error handling.
+    // https://github.com/syoyo/tinygltf/issues/332
+    if (!o.Accept(writer)) {
+      return "tiny_gltf::JsonToString() failed rapidjson conversion";
+    }
+  } else {
+    PrettyWriter<StringBuffer> writer(buffer);
+    writer.SetIndent(' ', uint32_t(spacing));
+    if (!o.Accept(writer)) {
+      return "tiny_gltf::JsonToString() failed rapidjson conversion";
+    }
+  }
+  return buffer.GetString();
+#else
+  return o.dump(spacing);
+#endif
+}
+
+}  // namespace detail
+
+static bool ParseJsonAsValue(Value *ret, const detail::json &o) {
+  Value val{};
+#ifdef TINYGLTF_USE_RAPIDJSON
+  using rapidjson::Type;
+  switch (o.GetType()) {
+    case Type::kObjectType: {
+      Value::Object value_object;
+      for (auto it = o.MemberBegin(); it != o.MemberEnd(); ++it) {
+        Value entry;
+        ParseJsonAsValue(&entry, it->value);
+        if (entry.Type() != NULL_TYPE)
+          value_object.emplace(detail::GetKey(it), std::move(entry));
+      }
+      if (value_object.size() > 0) val = Value(std::move(value_object));
+    } break;
+    case Type::kArrayType: {
+      Value::Array value_array;
+      value_array.reserve(o.Size());
+      for (auto it = o.Begin(); it != o.End(); ++it) {
+        Value entry;
+        ParseJsonAsValue(&entry, *it);
+        if (entry.Type() != NULL_TYPE)
+          value_array.emplace_back(std::move(entry));
+      }
+      if (value_array.size() > 0) val = Value(std::move(value_array));
+    } break;
+    case Type::kStringType:
+      val = Value(std::string(o.GetString()));
+      break;
+    case Type::kFalseType:
+    case Type::kTrueType:
+      val = Value(o.GetBool());
+      break;
+    case Type::kNumberType:
+      if (!o.IsDouble()) {
+        int i = 0;
+        detail::GetInt(o, i);
+        val = Value(i);
+      } else {
+        double d = 0.0;
+        detail::GetDouble(o, d);
+        val = Value(d);
+      }
+      break;
+    case Type::kNullType:
+      break;
+      // all types are covered, so no `case default`
+  }
+#else
+  switch (o.type()) {
+    case detail::json::value_t::object: {
+      Value::Object value_object;
+      for (auto it = o.begin(); it != o.end(); it++) {
+        Value entry;
+        ParseJsonAsValue(&entry, it.value());
+        if (entry.Type() != NULL_TYPE)
+          value_object.emplace(it.key(), std::move(entry));
+      }
+      if (value_object.size() > 0) val = Value(std::move(value_object));
+    } break;
+    case detail::json::value_t::array: {
+      Value::Array value_array;
+      value_array.reserve(o.size());
+      for (auto it = o.begin(); it != o.end(); it++) {
+        Value entry;
+        ParseJsonAsValue(&entry, it.value());
+        if (entry.Type() != NULL_TYPE)
+          value_array.emplace_back(std::move(entry));
+      }
+      if (value_array.size() > 0) val = Value(std::move(value_array));
+    } break;
+    case detail::json::value_t::string:
+      val = Value(o.get<std::string>());
+      break;
+    case detail::json::value_t::boolean:
+      val = Value(o.get<bool>());
+      break;
+    case detail::json::value_t::number_integer:
+    case detail::json::value_t::number_unsigned:
+      val = Value(static_cast<int>(o.get<int64_t>()));
+      break;
+    case detail::json::value_t::number_float:
+      val = Value(o.get<double>());
+      break;
+    case detail::json::value_t::null:
+    case detail::json::value_t::discarded:
+    case detail::json::value_t::binary:
+      // default:
+      break;
+  }
+#endif
+  const bool isNotNull = val.Type() != NULL_TYPE;
+
+  if (ret) *ret = std::move(val);
+
+  return isNotNull;
+}
+
+static bool ParseExtrasProperty(Value *ret, const detail::json &o) {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, "extras", it)) {
+    return false;
+  }
+
+  return ParseJsonAsValue(ret, detail::GetValue(it));
+}
+
+static bool ParseBooleanProperty(bool *ret, std::string *err,
+                                 const detail::json &o,
+                                 const std::string &property,
+                                 const bool required,
+                                 const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  auto &value = detail::GetValue(it);
+
+  bool isBoolean;
+  bool boolValue = false;
+#ifdef TINYGLTF_USE_RAPIDJSON
+  isBoolean = value.IsBool();
+  if (isBoolean) {
+    boolValue = value.GetBool();
+  }
+#else
+  isBoolean = value.is_boolean();
+  if (isBoolean) {
+    boolValue = value.get<bool>();
+  }
+#endif
+  if (!isBoolean) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not a bool type.\n";
+      }
+    }
+    return false;
+  }
+
+  if (ret) {
+    (*ret) = boolValue;
+  }
+
+  return true;
+}
+
+static bool ParseIntegerProperty(int *ret, std::string *err,
+                                 const detail::json &o,
+                                 const std::string &property,
+                                 const bool required,
+                                 const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  int intValue;
+  bool isInt = detail::GetInt(detail::GetValue(it), intValue);
+  if (!isInt) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not an integer type.\n";
+      }
+    }
+    return false;
+  }
+
+  if (ret) {
+    (*ret) = intValue;
+  }
+
+  return true;
+}
+
+static bool ParseUnsignedProperty(size_t *ret, std::string *err,
+                                  const detail::json &o,
+                                  const std::string &property,
+                                  const bool required,
+                                  const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  auto &value = detail::GetValue(it);
+
+  size_t uValue = 0;
+  bool isUValue;
+#ifdef TINYGLTF_USE_RAPIDJSON
+  isUValue = false;
+  if (value.IsUint()) {
+    uValue = value.GetUint();
+    isUValue = true;
+  } else if (value.IsUint64()) {
+    uValue = value.GetUint64();
+    isUValue = true;
+  }
+#else
+  isUValue = value.is_number_unsigned();
+  if (isUValue) {
+    uValue = value.get<size_t>();
+  }
+#endif
+  if (!isUValue) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not a positive integer.\n";
+      }
+    }
+    return false;
+  }
+
+  if (ret) {
+    (*ret) = uValue;
+  }
+
+  return true;
+}
+
+static bool ParseNumberProperty(double *ret, std::string *err,
+                                const detail::json &o,
+                                const std::string &property,
+                                const bool required,
+                                const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  double numberValue;
+  bool isNumber = detail::GetNumber(detail::GetValue(it), numberValue);
+
+  if (!isNumber) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not a number type.\n";
+      }
+    }
+    return false;
+  }
+
+  if (ret) {
+    (*ret) = numberValue;
+  }
+
+  return true;
+}
+
+static bool ParseNumberArrayProperty(std::vector<double> *ret, std::string *err,
+                                     const detail::json &o,
+                                     const std::string &property, bool required,
+                                     const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  if (!detail::IsArray(detail::GetValue(it))) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not an array";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  ret->clear();
+  auto end = detail::ArrayEnd(detail::GetValue(it));
+  for (auto i = detail::ArrayBegin(detail::GetValue(it)); i != end; ++i) {
+    double numberValue;
+    const bool isNumber = detail::GetNumber(*i, numberValue);
+    if (!isNumber) {
+      if (required) {
+        if (err) {
+          (*err) += "'" + property + "' property is not a number.\n";
+          if (!parent_node.empty()) {
+            (*err) += " in " + parent_node;
+          }
+          (*err) += ".\n";
+        }
+      }
+      return false;
+    }
+    ret->push_back(numberValue);
+  }
+
+  return true;
+}
+
+static bool ParseIntegerArrayProperty(std::vector<int> *ret, std::string *err,
+                                      const detail::json &o,
+                                      const std::string &property,
+                                      bool required,
+                                      const std::string &parent_node = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  if (!detail::IsArray(detail::GetValue(it))) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not an array";
+        if (!parent_node.empty()) {
+          (*err) += " in " + parent_node;
+        }
+        (*err) += ".\n";
+      }
+    }
+    return false;
+  }
+
+  ret->clear();
+  auto end = detail::ArrayEnd(detail::GetValue(it));
+  for (auto i = detail::ArrayBegin(detail::GetValue(it)); i != end; ++i) {
+    int numberValue;
+    bool isNumber = detail::GetInt(*i, numberValue);
+    if (!isNumber) {
+      if (required) {
+        if (err) {
+          (*err) += "'" + property + "' property is not an integer type.\n";
+          if (!parent_node.empty()) {
+            (*err) += " in " + parent_node;
+          }
+          (*err) += ".\n";
+        }
+      }
+      return false;
+    }
+    ret->push_back(numberValue);
+  }
+
+  return true;
+}
+
+static bool ParseStringProperty(
+    std::string *ret, std::string *err, const detail::json &o,
+    const std::string &property, bool required,
+    const std::string &parent_node = std::string()) {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing";
+        if (parent_node.empty()) {
+          (*err) += ".\n";
+        } else {
+          (*err) += " in `" + parent_node + "'.\n";
+        }
+      }
+    }
+    return false;
+  }
+
+  std::string strValue;
+  if (!detail::GetString(detail::GetValue(it), strValue)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not a string type.\n";
+      }
+    }
+    return false;
+  }
+
+  if (ret) {
+    (*ret) = std::move(strValue);
+  }
+
+  return true;
+}
+
+static bool ParseStringIntegerProperty(std::map<std::string, int> *ret,
+                                       std::string *err, const detail::json &o,
+                                       const std::string &property,
+                                       bool required,
+                                       const std::string &parent = "") {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        if (!parent.empty()) {
+          (*err) +=
+              "'" + property + "' property is missing in " + parent + ".\n";
+        } else {
+          (*err) += "'" + property + "' property is missing.\n";
+        }
+      }
+    }
+    return false;
+  }
+
+  const detail::json &dict = detail::GetValue(it);
+
+  // Make sure we are dealing with an object / dictionary.
+  if (!detail::IsObject(dict)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not an object.\n";
+      }
+    }
+    return false;
+  }
+
+  ret->clear();
+
+  detail::json_const_iterator dictIt(detail::ObjectBegin(dict));
+  detail::json_const_iterator dictItEnd(detail::ObjectEnd(dict));
+
+  for (; dictIt != dictItEnd; ++dictIt) {
+    int intVal;
+    if (!detail::GetInt(detail::GetValue(dictIt), intVal)) {
+      if (required) {
+        if (err) {
+          (*err) += "'" + property + "' value is not an integer type.\n";
+        }
+      }
+      return false;
+    }
+
+    // Insert into the list.
+    (*ret)[detail::GetKey(dictIt)] = intVal;
+  }
+  return true;
 }
-bool Light::operator==(const Light &other) const {
-  return Equals(this->color, other.color) && this->name == other.name &&
-         this->type == other.type;
+
+static bool ParseJSONProperty(std::map<std::string, double> *ret,
+                              std::string *err, const detail::json &o,
+                              const std::string &property, bool required) {
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, property.c_str(), it)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is missing. \n'";
+      }
+    }
+    return false;
+  }
+
+  const detail::json &obj = detail::GetValue(it);
+
+  if (!detail::IsObject(obj)) {
+    if (required) {
+      if (err) {
+        (*err) += "'" + property + "' property is not a JSON object.\n";
+      }
+    }
+    return false;
+  }
+
+  ret->clear();
+
+  detail::json_const_iterator it2(detail::ObjectBegin(obj));
+  detail::json_const_iterator itEnd(detail::ObjectEnd(obj));
+  for (; it2 != itEnd; ++it2) {
+    double numVal;
+    if (detail::GetNumber(detail::GetValue(it2), numVal))
+      ret->emplace(std::string(detail::GetKey(it2)), numVal);
+  }
+
+  return true;
 }
-bool AudioEmitter::operator==(const AudioEmitter &other) const {
-  return this->name == other.name &&
-         TINYGLTF_DOUBLE_EQUAL(this->gain, other.gain) &&
-         this->loop == other.loop && this->playing == other.playing &&
-         this->type == other.type &&
-         this->distanceModel == other.distanceModel &&
-         this->source == other.source;
+
+static bool ParseParameterProperty(Parameter *param, std::string *err,
+                                   const detail::json &o,
+                                   const std::string &prop, bool required) {
+  // A parameter value can either be a string or an array of either a boolean or
+  // a number. Booleans of any kind aren't supported here. Granted, it
+  // complicates the Parameter structure and breaks it semantically in the sense
+  // that the client probably works off the assumption that if the string is
+  // empty the vector is used, etc. Would a tagged union work?
+  if (ParseStringProperty(&param->string_value, err, o, prop, false)) {
+    // Found string property.
+    return true;
+  } else if (ParseNumberArrayProperty(&param->number_array, err, o, prop,
+                                      false)) {
+    // Found a number array.
+    return true;
+  } else if (ParseNumberProperty(&param->number_value, err, o, prop, false)) {
+    param->has_number_value = true;
+    return true;
+  } else if (ParseJSONProperty(&param->json_double_value, err, o, prop,
+                               false)) {
+    return true;
+  } else if (ParseBooleanProperty(&param->bool_value, err, o, prop, false)) {
+    return true;
+  } else {
+    if (required) {
+      if (err) {
+        (*err) += "parameter must be a string or number / number array.\n";
+      }
+    }
+    return false;
+  }
 }
-bool AudioSource::operator==(const AudioSource &other) const {
-  return this->name == other.name && this->uri == other.uri;
+
+static bool ParseExtensionsProperty(ExtensionMap *ret, std::string *err,
+                                    const detail::json &o) {
+  (void)err;
+
+  detail::json_const_iterator it;
+  if (!detail::FindMember(o, "extensions", it)) {
+    return false;
+  }
+
+  auto &obj = detail::GetValue(it);
+  if (!detail::IsObject(obj)) {
+    return false;
+  }
+  ExtensionMap extensions;
+  detail::json_const_iterator extIt =
+      detail::ObjectBegin(obj);  // it.value().begin();
+  detail::json_const_iterator extEnd = detail::ObjectEnd(obj);
+  for (; extIt != extEnd; ++extIt) {
+    auto &itObj = detail::GetValue(extIt);
+    if (!detail::IsObject(itObj)) continue;
+    std::string key(detail::GetKey(extIt));
+    if (!ParseJsonAsValue(&extensions[key], itObj)) {
+      if (!key.empty()) {
+        // create empty object so that an extension object is still of type
+        // object
+        extensions[key] = Value{Value::Object{}};
+      }
+    }
+  }
+  if (ret) {
+    (*ret) = std::move(extensions);
+  }
+  return true;
+}
+
+template <typename GltfType>
+static bool ParseExtrasAndExtensions(GltfType *target, std::string *err,
+                                     const detail::json &o,
+                                     bool store_json_strings) {
+  ParseExtensionsProperty(&target->extensions, err, o);
+  ParseExtrasProperty(&target->extras, o);
+
+  if (store_json_strings) {
+    {
+      detail::json_const_iterator it;
+      if (detail::FindMember(o, "extensions", it)) {
+        target->extensions_json_string =
+            detail::JsonToString(detail::GetValue(it));
+      }
+    }
+    {
+      detail::json_const_iterator it;
+      if (detail::FindMember(o, "extras", it)) {
+        target->extras_json_string = detail::JsonToString(detail::GetValue(it));
+      }
+    }
+  }
+  return true;
+}
+
+static bool ParseAsset(Asset *asset, std::string *err, const detail::json &o,
+                       bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&asset->version, err, o, "version", true, "Asset");
+  ParseStringProperty(&asset->generator, err, o, "generator", false, "Asset");
+  ParseStringProperty(&asset->minVersion, err, o, "minVersion", false, "Asset");
+  ParseStringProperty(&asset->copyright, err, o, "copyright", false, "Asset");
+
+  ParseExtrasAndExtensions(asset, err, o,
+                           store_original_json_for_extras_and_extensions);
+  return true;
+}
+
+static bool ParseImage(Image *image, const int image_idx, std::string *err,
+                       std::string *warn, const detail::json &o,
+                       bool store_original_json_for_extras_and_extensions,
+                       const std::string &basedir, const size_t max_file_size,
+                       FsCallbacks *fs, const URICallbacks *uri_cb,
+                       const LoadImageDataFunction& LoadImageData = nullptr,
+                       void *load_image_user_data = nullptr,
+                       bool adopt_as_is_data = false,
+                       size_t header_probe_bytes = 0) {
+  // A glTF image must either reference a bufferView or an image uri
+
+  // schema says oneOf [`bufferView`, `uri`]
+  // TODO(syoyo): Check the type of each parameters.
+  detail::json_const_iterator it;
+  bool hasBufferView = detail::FindMember(o, "bufferView", it);
+  bool hasURI = detail::FindMember(o, "uri", it);
+
+  ParseStringProperty(&image->name, err, o, "name", false);
+
+  if (hasBufferView && hasURI) {
+    // Should not both defined.
+    if (err) {
+      (*err) +=
+          "Only one of `bufferView` or `uri` should be defined, but both are "
+          "defined for image[" +
+          std::to_string(image_idx) + "] name = \"" + image->name + "\"\n";
+    }
+    return false;
+  }
+
+  if (!hasBufferView && !hasURI) {
+    if (err) {
+      (*err) += "Neither required `bufferView` nor `uri` defined for image[" +
+                std::to_string(image_idx) + "] name = \"" + image->name +
+                "\"\n";
+    }
+    return false;
+  }
+
+  ParseExtrasAndExtensions(image, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  if (hasBufferView) {
+    int bufferView = -1;
+    if (!ParseIntegerProperty(&bufferView, err, o, "bufferView", true)) {
+      if (err) {
+        (*err) += "Failed to parse `bufferView` for image[" +
+                  std::to_string(image_idx) + "] name = \"" + image->name +
+                  "\"\n";
+      }
+      return false;
+    }
+
+    std::string mime_type;
+    ParseStringProperty(&mime_type, err, o, "mimeType", false);
+
+    int width = 0;
+    ParseIntegerProperty(&width, err, o, "width", false);
+
+    int height = 0;
+    ParseIntegerProperty(&height, err, o, "height", false);
+
+    // Just only save some information here. Loading actual image data from
+    // bufferView is done after this `ParseImage` function.
+    image->bufferView = bufferView;
+    image->mimeType = mime_type;
+    image->width = width;
+    image->height = height;
+
+    return true;
+  }
+
+  // Parse URI & Load image data.
+
+  std::string uri;
+  std::string tmp_err;
+  if (!ParseStringProperty(&uri, &tmp_err, o, "uri", true)) {
+    if (err) {
+      (*err) += "Failed to parse `uri` for image[" + std::to_string(image_idx) +
+                "] name = \"" + image->name + "\".\n";
+    }
+    return false;
+  }
+
+  std::vector<unsigned char> img;
+
+  if (IsDataURI(uri)) {
+    if (!DecodeDataURI(&img, image->mimeType, uri, 0, false)) {
+      if (err) {
+        (*err) += "Failed to decode 'uri' for image[" +
+                  std::to_string(image_idx) + "] name = \"" + image->name +
+                  "\"\n";
+      }
+      return false;
+    }
+  } else {
+    // Assume external file
+    // Unconditionally keep the external URI of the image
+    image->uri = uri;
+#ifdef TINYGLTF_NO_EXTERNAL_IMAGE
+    (void)header_probe_bytes;
+    return true;
+#else
+    std::string decoded_uri;
+    if (!uri_cb->decode(uri, &decoded_uri, uri_cb->user_data)) {
+      if (warn) {
+        (*warn) += "Failed to decode 'uri' for image[" +
+                   std::to_string(image_idx) + "] name = \"" + image->name +
+                   "\"\n";
+      }
+
+      // Image loading failure is not critical to overall gltf loading.
+      return true;
+    }
+
+    if ((header_probe_bytes > 0) && LoadImageData) {
+      // Read only the head of the file. When the header does not fit in it
+      // (e.g. JPEG with a large EXIF block), the whole file is read below.
+      std::vector<unsigned char> head;
+      std::string probe_err;
+      std::string probe_warn;
+      if (LoadExternalFileRange(&head, &probe_err, decoded_uri, basedir, 0,
+                                header_probe_bytes, fs) &&
+          !head.empty() &&
+          LoadImageData(image, image_idx, &probe_err, &probe_warn, 0, 0,
+                        head.data(), static_cast<int>(head.size()),
+                        load_image_user_data) &&
+          (image->width > 0)) {
+        if (warn) {
+          (*warn) += probe_warn;
+        }
+        return true;
+      }
+    }
+
+    if (!LoadExternalFile(&img, err, warn, decoded_uri, basedir,
+                          /* required */ false, /* required bytes */ 0,
+                          /* checksize */ false,
+                          /* max file size */ max_file_size, fs)) {
+      if (warn) {
+        (*warn) += "Failed to load external 'uri' for image[" +
+                   std::to_string(image_idx) + "] name = \"" + decoded_uri +
+                   "\"\n";
+      }
+      // If the image cannot be loaded, keep uri as image->uri.
+      return true;
+    }
+
+    if (img.empty()) {
+      if (warn) {
+        (*warn) += "Image data is empty for image[" +
+                   std::to_string(image_idx) + "] name = \"" + image->name +
+                   "\" \n";
+      }
+      return false;
+    }
+#endif
+  }
+
+  if (LoadImageData == nullptr) {
+    if (err) {
+      (*err) += "No LoadImageData callback specified.\n";
+    }
+    return false;
+  }
+
+  if (!LoadImageData(image, image_idx, err, warn, 0, 0, &img.at(0),
+                     static_cast<int>(img.size()), load_image_user_data)) {
+    return false;
+  }
+
+  if (adopt_as_is_data && image->as_is) {
+    // The loader did not copy the encoded bytes. Take over our buffer.
+    image->image.swap(img);
+  }
+
+  return true;
 }
-bool Material::operator==(const Material &other) const {
-  return (this->pbrMetallicRoughness == other.pbrMetallicRoughness) &&
-         (this->normalTexture == other.normalTexture) &&
-         (this->occlusionTexture == other.occlusionTexture) &&
-         (this->emissiveTexture == other.emissiveTexture) &&
-         Equals(this->emissiveFactor, other.emissiveFactor) &&
-         (this->alphaMode == other.alphaMode) &&
-         TINYGLTF_DOUBLE_EQUAL(this->alphaCutoff, other.alphaCutoff) &&
-         (this->doubleSided == other.doubleSided) &&
-         (this->extensions == other.extensions) &&
-         (this->extras == other.extras) && (this->values == other.values) &&
-         (this->additionalValues == other.additionalValues) &&
-         (this->name == other.name);
+
+static bool ParseTexture(Texture *texture, std::string *err,
+                         const detail::json &o,
+                         bool store_original_json_for_extras_and_extensions,
+                         const std::string &basedir) {
+  (void)basedir;
+  int sampler = -1;
+  int source = -1;
+  ParseIntegerProperty(&sampler, err, o, "sampler", false);
+
+  ParseIntegerProperty(&source, err, o, "source", false);
+
+  texture->sampler = sampler;
+  texture->source = source;
+
+  ParseExtrasAndExtensions(texture, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  ParseStringProperty(&texture->name, err, o, "name", false);
+
+  return true;
 }
-bool Mesh::operator==(const Mesh &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->name == other.name && Equals(this->weights, other.weights) &&
-         this->primitives == other.primitives;
+
+static bool ParseTextureInfo(
+    TextureInfo *texinfo, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  if (texinfo == nullptr) {
+    return false;
+  }
+
+  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
+                            /* required */ true, "TextureInfo")) {
+    return false;
+  }
+
+  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
+
+  ParseExtrasAndExtensions(texinfo, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
-bool Model::operator==(const Model &other) const {
-  return this->accessors == other.accessors &&
-         this->animations == other.animations && this->asset == other.asset &&
-         this->buffers == other.buffers &&
-         this->bufferViews == other.bufferViews &&
-         this->cameras == other.cameras &&
-         this->defaultScene == other.defaultScene &&
-         this->extensions == other.extensions &&
-         this->extensionsRequired == other.extensionsRequired &&
-         this->extensionsUsed == other.extensionsUsed &&
-         this->extras == other.extras && this->images == other.images &&
-         this->lights == other.lights && this->materials == other.materials &&
-         this->meshes == other.meshes && this->nodes == other.nodes &&
-         this->samplers == other.samplers && this->scenes == other.scenes &&
-         this->skins == other.skins && this->textures == other.textures;
+
+static bool ParseNormalTextureInfo(
+    NormalTextureInfo *texinfo, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  if (texinfo == nullptr) {
+    return false;
+  }
+
+  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
+                            /* required */ true, "NormalTextureInfo")) {
+    return false;
+  }
+
+  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
+  ParseNumberProperty(&texinfo->scale, err, o, "scale", false);
+
+  ParseExtrasAndExtensions(texinfo, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
-bool Node::operator==(const Node &other) const {
-  return this->camera == other.camera && this->children == other.children &&
-         this->extensions == other.extensions && this->extras == other.extras &&
-         Equals(this->matrix, other.matrix) && this->mesh == other.mesh &&
-         (this->light == other.light) && (this->emitter == other.emitter) &&
-         this->name == other.name && Equals(this->rotation, other.rotation) &&
-         Equals(this->scale, other.scale) && this->skin == other.skin &&
-         Equals(this->translation, other.translation) &&
-         Equals(this->weights, other.weights);
+
+static bool ParseOcclusionTextureInfo(
+    OcclusionTextureInfo *texinfo, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  if (texinfo == nullptr) {
+    return false;
+  }
+
+  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
+                            /* required */ true, "NormalTextureInfo")) {
+    return false;
+  }
+
+  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
+  ParseNumberProperty(&texinfo->strength, err, o, "strength", false);
+
+  ParseExtrasAndExtensions(texinfo, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
-bool SpotLight::operator==(const SpotLight &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         TINYGLTF_DOUBLE_EQUAL(this->innerConeAngle, other.innerConeAngle) &&
-         TINYGLTF_DOUBLE_EQUAL(this->outerConeAngle, other.outerConeAngle);
+
+static bool ParseBuffer(Buffer *buffer, std::string *err, const detail::json &o,
+                        bool store_original_json_for_extras_and_extensions,
+                        FsCallbacks *fs, const URICallbacks *uri_cb,
+                        const std::string &basedir,
+                        const size_t max_buffer_size, bool is_binary = false,
+                        const unsigned char *bin_data = nullptr,
+                        size_t bin_size = 0) {
+  size_t byteLength;
+  if (!ParseUnsignedProperty(&byteLength, err, o, "byteLength", true,
+                             "Buffer")) {
+    return false;
+  }
+
+  // In glTF 2.0, uri is not mandatory anymore
+  buffer->uri.clear();
+  ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
+
+#ifdef TINYGLTF_ENABLE_MESHOPT
+  // EXT_meshopt_compression fallback buffer without data: filled when
+  // compressed bufferViews are decoded.
+  if (buffer->uri.empty()) {
+    detail::json_const_iterator extensions_it;
+    detail::json_const_iterator meshopt_it;
+    bool fallback = false;
+    if (detail::FindMember(o, "extensions", extensions_it) &&
+        detail::FindMember(detail::GetValue(extensions_it),
+                           "EXT_meshopt_compression", meshopt_it)) {
+      ParseBooleanProperty(&fallback, nullptr, detail::GetValue(meshopt_it),
+                           "fallback", false);
+    }
+    if (fallback) {
+      if (byteLength > max_buffer_size) {
+        if (err) {
+          (*err) += "Fallback buffer size exceeds the maximum buffer size.\n";
+        }
+        return false;
+      }
+      buffer->data.assign(byteLength, 0);
+      ParseStringProperty(&buffer->name, err, o, "name", false);
+      ParseExtrasAndExtensions(buffer, err, o,
+                               store_original_json_for_extras_and_extensions);
+      return true;
+    }
+  }
+#endif
+
+  // having an empty uri for a non embedded image should not be valid
+  if (!is_binary && buffer->uri.empty()) {
+    if (err) {
+      (*err) += "'uri' is missing from non binary glTF file buffer.\n";
+    }
+  }
+
+  detail::json_const_iterator type;
+  if (detail::FindMember(o, "type", type)) {
+    std::string typeStr;
+    if (detail::GetString(detail::GetValue(type), typeStr)) {
+      if (typeStr.compare("arraybuffer") == 0) {
+        // buffer.type = "arraybuffer";
+      }
+    }
+  }
+
+  if (is_binary) {
+    // Still binary glTF accepts external dataURI.
+    if (!buffer->uri.empty()) {
+      // First try embedded data URI.
+      if (IsDataURI(buffer->uri)) {
+        std::string mime_type;
+        if (!DecodeDataURI(&buffer->data, mime_type, buffer->uri, byteLength,
+                           true)) {
+          if (err) {
+            (*err) +=
+                "Failed to decode 'uri' : " + buffer->uri + " in Buffer\n";
+          }
+          return false;
+        }
+      } else {
+        // External .bin file.
+        std::string decoded_uri;
+        if (!uri_cb->decode(buffer->uri, &decoded_uri, uri_cb->user_data)) {
+          return false;
+        }
+        if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr,
+                              decoded_uri, basedir, /* required */ true,
+                              byteLength, /* checkSize */ true,
+                              /* max_file_size */ max_buffer_size, fs)) {
+          return false;
+        }
+      }
+    } else {
+      // load data from (embedded) binary data
+
+      if ((bin_size == 0) || (bin_data == nullptr)) {
+        if (err) {
+          (*err) +=
+              "Invalid binary data in `Buffer', or GLB with empty BIN chunk.\n";
+        }
+        return false;
+      }
+
+      if (byteLength > bin_size) {
+        if (err) {
+          std::stringstream ss;
+          ss << "Invalid `byteLength'. Must be equal or less than binary size: "
+                "`byteLength' = "
+             << byteLength << ", binary size = " << bin_size << std::endl;
+          (*err) += ss.str();
+        }
+        return false;
+      }
+
+      // Read buffer data
+      buffer->data.resize(static_cast<size_t>(byteLength));
+      memcpy(&(buffer->data.at(0)), bin_data, static_cast<size_t>(byteLength));
+    }
+
+  } else {
+    if (IsDataURI(buffer->uri)) {
+      std::string mime_type;
+      if (!DecodeDataURI(&buffer->data, mime_type, buffer->uri, byteLength,
+                         true)) {
+        if (err) {
+          (*err) += "Failed to decode 'uri' : " + buffer->uri + " in Buffer\n";
+        }
+        return false;
+      }
+    } else {
+      // Assume external .bin file.
+      std::string decoded_uri;
+      if (!uri_cb->decode(buffer->uri, &decoded_uri, uri_cb->user_data)) {
+        return false;
+      }
+      if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr, decoded_uri,
+                            basedir, /* required */ true, byteLength,
+                            /* checkSize */ true,
+                            /* max file size */ max_buffer_size, fs)) {
+        return false;
+      }
+    }
+  }
+
+  ParseStringProperty(&buffer->name, err, o, "name", false);
+
+  ParseExtrasAndExtensions(buffer, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
-bool PositionalEmitter::operator==(const PositionalEmitter &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         TINYGLTF_DOUBLE_EQUAL(this->coneInnerAngle, other.coneInnerAngle) &&
-         TINYGLTF_DOUBLE_EQUAL(this->coneOuterAngle, other.coneOuterAngle) &&
-         TINYGLTF_DOUBLE_EQUAL(this->coneOuterGain, other.coneOuterGain) &&
-         TINYGLTF_DOUBLE_EQUAL(this->maxDistance, other.maxDistance) &&
-         TINYGLTF_DOUBLE_EQUAL(this->refDistance, other.refDistance) &&
-         TINYGLTF_DOUBLE_EQUAL(this->rolloffFactor, other.rolloffFactor);
+
+static bool ParseBufferView(
+    BufferView *bufferView, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  int buffer = -1;
+  if (!ParseIntegerProperty(&buffer, err, o, "buffer", true, "BufferView")) {
+    return false;
+  }
+
+  size_t byteOffset = 0;
+  ParseUnsignedProperty(&byteOffset, err, o, "byteOffset", false);
+
+  size_t byteLength = 1;
+  if (!ParseUnsignedProperty(&byteLength, err, o, "byteLength", true,
+                             "BufferView")) {
+    return false;
+  }
+
+  size_t byteStride = 0;
+  if (!ParseUnsignedProperty(&byteStride, err, o, "byteStride", false)) {
+    // Spec says: When byteStride of referenced bufferView is not defined, it
+    // means that accessor elements are tightly packed, i.e., effective stride
+    // equals the size of the element.
+    // We cannot determine the actual byteStride until Accessor are parsed, thus
+    // set 0(= tightly packed) here(as done in OpenGL's VertexAttribPoiner)
+    byteStride = 0;
+  }
+
+  if ((byteStride > 252) || ((byteStride % 4) != 0)) {
+    if (err) {
+      std::stringstream ss;
+      ss << "Invalid `byteStride' value. `byteStride' must be the multiple of "
+            "4 : "
+         << byteStride << std::endl;
+
+      (*err) += ss.str();
+    }
+    return false;
+  }
+
+  int target = 0;
+  ParseIntegerProperty(&target, err, o, "target", false);
+  if ((target == TINYGLTF_TARGET_ARRAY_BUFFER) ||
+      (target == TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER)) {
+    // OK
+  } else {
+    target = 0;
+  }
+  bufferView->target = target;
+
+  ParseStringProperty(&bufferView->name, err, o, "name", false);
+
+  ParseExtrasAndExtensions(bufferView, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  bufferView->buffer = buffer;
+  bufferView->byteOffset = byteOffset;
+  bufferView->byteLength = byteLength;
+  bufferView->byteStride = byteStride;
+  return true;
 }
-bool OrthographicCamera::operator==(const OrthographicCamera &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         TINYGLTF_DOUBLE_EQUAL(this->xmag, other.xmag) &&
-         TINYGLTF_DOUBLE_EQUAL(this->ymag, other.ymag) &&
-         TINYGLTF_DOUBLE_EQUAL(this->zfar, other.zfar) &&
-         TINYGLTF_DOUBLE_EQUAL(this->znear, other.znear);
+
+static bool ParseSparseAccessor(
+    Accessor::Sparse *sparse, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  sparse->isSparse = true;
+
+  int count = 0;
+  if (!ParseIntegerProperty(&count, err, o, "count", true, "SparseAccessor")) {
+    return false;
+  }
+
+  ParseExtrasAndExtensions(sparse, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  detail::json_const_iterator indices_iterator;
+  detail::json_const_iterator values_iterator;
+  if (!detail::FindMember(o, "indices", indices_iterator)) {
+    (*err) = "the sparse object of this accessor doesn't have indices";
+    return false;
+  }
+
+  if (!detail::FindMember(o, "values", values_iterator)) {
+    (*err) = "the sparse object of this accessor doesn't have values";
+    return false;
+  }
+
+  const detail::json &indices_obj = detail::GetValue(indices_iterator);
+  const detail::json &values_obj = detail::GetValue(values_iterator);
+
+  int indices_buffer_view = 0, component_type = 0;
+  size_t indices_byte_offset = 0;
+  if (!ParseIntegerProperty(&indices_buffer_view, err, indices_obj,
+                            "bufferView", true, "SparseAccessor")) {
+    return false;
+  }
+  ParseUnsignedProperty(&indices_byte_offset, err, indices_obj, "byteOffset",
+                       false);
+  if (!ParseIntegerProperty(&component_type, err, indices_obj, "componentType",
+                            true, "SparseAccessor")) {
+    return false;
+  }
+
+  int values_buffer_view = 0;
+  size_t values_byte_offset = 0;
+  if (!ParseIntegerProperty(&values_buffer_view, err, values_obj, "bufferView",
+                            true, "SparseAccessor")) {
+    return false;
+  }
+  ParseUnsignedProperty(&values_byte_offset, err, values_obj, "byteOffset",
+                       false);
+
+  sparse->count = count;
+  sparse->indices.bufferView = indices_buffer_view;
+  sparse->indices.byteOffset = indices_byte_offset;
+  sparse->indices.componentType = component_type;
+  ParseExtrasAndExtensions(&sparse->indices, err, indices_obj,
+                           store_original_json_for_extras_and_extensions);
+
+  sparse->values.bufferView = values_buffer_view;
+  sparse->values.byteOffset = values_byte_offset;
+  ParseExtrasAndExtensions(&sparse->values, err, values_obj,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
-bool Parameter::operator==(const Parameter &other) const {
-  if (this->bool_value != other.bool_value ||
-      this->has_number_value != other.has_number_value)
+
+static bool ParseAccessor(Accessor *accessor, std::string *err,
+                          const detail::json &o,
+                          bool store_original_json_for_extras_and_extensions) {
+  int bufferView = -1;
+  ParseIntegerProperty(&bufferView, err, o, "bufferView", false, "Accessor");
+
+  size_t byteOffset = 0;
+  ParseUnsignedProperty(&byteOffset, err, o, "byteOffset", false, "Accessor");
+
+  bool normalized = false;
+  ParseBooleanProperty(&normalized, err, o, "normalized", false, "Accessor");
+
+  size_t componentType = 0;
+  if (!ParseUnsignedProperty(&componentType, err, o, "componentType", true,
+                             "Accessor")) {
+    return false;
+  }
+
+  size_t count = 0;
+  if (!ParseUnsignedProperty(&count, err, o, "count", true, "Accessor")) {
+    return false;
+  }
+
+  std::string type;
+  if (!ParseStringProperty(&type, err, o, "type", true, "Accessor")) {
+    return false;
+  }
+
+  if (type.compare("SCALAR") == 0) {
+    accessor->type = TINYGLTF_TYPE_SCALAR;
+  } else if (type.compare("VEC2") == 0) {
+    accessor->type = TINYGLTF_TYPE_VEC2;
+  } else if (type.compare("VEC3") == 0) {
+    accessor->type = TINYGLTF_TYPE_VEC3;
+  } else if (type.compare("VEC4") == 0) {
+    accessor->type = TINYGLTF_TYPE_VEC4;
+  } else if (type.compare("MAT2") == 0) {
+    accessor->type = TINYGLTF_TYPE_MAT2;
+  } else if (type.compare("MAT3") == 0) {
+    accessor->type = TINYGLTF_TYPE_MAT3;
+  } else if (type.compare("MAT4") == 0) {
+    accessor->type = TINYGLTF_TYPE_MAT4;
+  } else {
+    std::stringstream ss;
+    ss << "Unsupported `type` for accessor object. Got \"" << type << "\"\n";
+    if (err) {
+      (*err) += ss.str();
+    }
     return false;
+  }
 
-  if (!TINYGLTF_DOUBLE_EQUAL(this->number_value, other.number_value))
-    return false;
+  ParseStringProperty(&accessor->name, err, o, "name", false);
 
-  if (this->json_double_value.size() != other.json_double_value.size())
-    return false;
-  for (auto &it : this->json_double_value) {
-    auto otherIt = other.json_double_value.find(it.first);
-    if (otherIt == other.json_double_value.end()) return false;
+  accessor->minValues.clear();
+  accessor->maxValues.clear();
+  ParseNumberArrayProperty(&accessor->minValues, err, o, "min", false,
+                           "Accessor");
 
-    if (!TINYGLTF_DOUBLE_EQUAL(it.second, otherIt->second)) return false;
+  ParseNumberArrayProperty(&accessor->maxValues, err, o, "max", false,
+                           "Accessor");
+
+  accessor->count = count;
+  accessor->bufferView = bufferView;
+  accessor->byteOffset = byteOffset;
+  accessor->normalized = normalized;
+  {
+    if (componentType >= TINYGLTF_COMPONENT_TYPE_BYTE &&
+        componentType <= TINYGLTF_COMPONENT_TYPE_DOUBLE) {
+      // OK
+      accessor->componentType = int(componentType);
+    } else {
+      std::stringstream ss;
+      ss << "Invalid `componentType` in accessor. Got " << componentType
+         << "\n";
+      if (err) {
+        (*err) += ss.str();
+      }
+      return false;
+    }
   }
 
-  if (!Equals(this->number_array, other.number_array)) return false;
+  ParseExtrasAndExtensions(accessor, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  if (this->string_value != other.string_value) return false;
+  // check if accessor has a "sparse" object:
+  detail::json_const_iterator iterator;
+  if (detail::FindMember(o, "sparse", iterator)) {
+    // here this accessor has a "sparse" subobject
+    return ParseSparseAccessor(&accessor->sparse, err,
+                               detail::GetValue(iterator),
+                               store_original_json_for_extras_and_extensions);
+  }
 
   return true;
 }
-bool PerspectiveCamera::operator==(const PerspectiveCamera &other) const {
-  return TINYGLTF_DOUBLE_EQUAL(this->aspectRatio, other.aspectRatio) &&
-         this->extensions == other.extensions && this->extras == other.extras &&
-         TINYGLTF_DOUBLE_EQUAL(this->yfov, other.yfov) &&
-         TINYGLTF_DOUBLE_EQUAL(this->zfar, other.zfar) &&
-         TINYGLTF_DOUBLE_EQUAL(this->znear, other.znear);
-}
-bool Primitive::operator==(const Primitive &other) const {
-  return this->attributes == other.attributes && this->extras == other.extras &&
-         this->indices == other.indices && this->material == other.material &&
-         this->mode == other.mode && this->targets == other.targets;
-}
-bool Sampler::operator==(const Sampler &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->magFilter == other.magFilter &&
-         this->minFilter == other.minFilter && this->name == other.name &&
-         this->wrapS == other.wrapS && this->wrapT == other.wrapT;
 
-  // this->wrapR == other.wrapR
-}
-bool Scene::operator==(const Scene &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->name == other.name && this->nodes == other.nodes;
-}
-bool Skin::operator==(const Skin &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->inverseBindMatrices == other.inverseBindMatrices &&
-         this->joints == other.joints && this->name == other.name &&
-         this->skeleton == other.skeleton;
-}
-bool Texture::operator==(const Texture &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->name == other.name && this->sampler == other.sampler &&
-         this->source == other.source;
-}
-bool TextureInfo::operator==(const TextureInfo &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->index == other.index && this->texCoord == other.texCoord;
-}
-bool NormalTextureInfo::operator==(const NormalTextureInfo &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->index == other.index && this->texCoord == other.texCoord &&
-         TINYGLTF_DOUBLE_EQUAL(this->scale, other.scale);
-}
-bool OcclusionTextureInfo::operator==(const OcclusionTextureInfo &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         this->index == other.index && this->texCoord == other.texCoord &&
-         TINYGLTF_DOUBLE_EQUAL(this->strength, other.strength);
-}
-bool PbrMetallicRoughness::operator==(const PbrMetallicRoughness &other) const {
-  return this->extensions == other.extensions && this->extras == other.extras &&
-         (this->baseColorTexture == other.baseColorTexture) &&
-         (this->metallicRoughnessTexture == other.metallicRoughnessTexture) &&
-         Equals(this->baseColorFactor, other.baseColorFactor) &&
-         TINYGLTF_DOUBLE_EQUAL(this->metallicFactor, other.metallicFactor) &&
-         TINYGLTF_DOUBLE_EQUAL(this->roughnessFactor, other.roughnessFactor);
-}
-bool Value::operator==(const Value &other) const {
-  return Equals(*this, other);
+#ifdef TINYGLTF_ENABLE_DRACO
+
+static void DecodeIndexBuffer(draco::Mesh *mesh, size_t componentSize,
+                              uint8_t *outBuffer) {
+  if (componentSize == 4) {
+    assert(sizeof(mesh->face(draco::FaceIndex(0))[0]) == componentSize);
+    if (mesh->num_faces() > 0) {
+      memcpy(outBuffer, &mesh->face(draco::FaceIndex(0))[0],
+             size_t(mesh->num_faces()) * 3 * componentSize);
+    }
+  } else {
+    size_t faceStride = componentSize * 3;
+    for (draco::FaceIndex f(0); f < mesh->num_faces(); ++f) {
+      const draco::Mesh::Face &face = mesh->face(f);
+      if (componentSize == 2) {
+        uint16_t indices[3] = {(uint16_t)face[0].value(),
+                               (uint16_t)face[1].value(),
+                               (uint16_t)face[2].value()};
+        memcpy(outBuffer + f.value() * faceStride, &indices[0], faceStride);
+      } else {
+        uint8_t indices[3] = {(uint8_t)face[0].value(),
+                              (uint8_t)face[1].value(),
+                              (uint8_t)face[2].value()};
+        memcpy(outBuffer + f.value() * faceStride, &indices[0], faceStride);
+      }
+    }
+  }
 }
 
-static void swap4(unsigned int *val) {
-#ifdef TINYGLTF_LITTLE_ENDIAN
-  (void)val;
-#else
-  unsigned int tmp = *val;
-  unsigned char *dst = reinterpret_cast<unsigned char *>(val);
-  unsigned char *src = reinterpret_cast<unsigned char *>(&tmp);
+template <typename T>
+static bool GetAttributeForAllPoints(draco::Mesh *mesh,
+                                     const draco::PointAttribute *pAttribute,
+                                     uint8_t *outBuffer) {
+  size_t byteOffset = 0;
+  T values[4] = {0, 0, 0, 0};
+  for (draco::PointIndex i(0); i < mesh->num_points(); ++i) {
+    const draco::AttributeValueIndex val_index = pAttribute->mapped_index(i);
+    if (!pAttribute->ConvertValue<T>(val_index, pAttribute->num_components(),
+                                     values))
+      return false;
 
-  dst[0] = src[3];
-  dst[1] = src[2];
-  dst[2] = src[1];
-  dst[3] = src[0];
-#endif
+    memcpy(outBuffer + byteOffset, &values[0],
+           sizeof(T) * pAttribute->num_components());
+    byteOffset += sizeof(T) * pAttribute->num_components();
+  }
+
+  return true;
 }
 
-static std::string JoinPath(const std::string &path0,
-                            const std::string &path1) {
-  if (path0.empty()) {
-    return path1;
-  } else {
-    // check '/'
-    char lastChar = *path0.rbegin();
-    if (lastChar != '/') {
-      return path0 + std::string("/") + path1;
-    } else {
-      return path0 + path1;
-    }
+static bool GetAttributeForAllPoints(uint32_t componentType, draco::Mesh *mesh,
+                                     const draco::PointAttribute *pAttribute,
+                                     uint8_t *outBuffer) {
+  bool decodeResult = false;
+  switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      decodeResult =
+          GetAttributeForAllPoints<uint8_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      decodeResult =
+          GetAttributeForAllPoints<int8_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      decodeResult =
+          GetAttributeForAllPoints<uint16_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      decodeResult =
+          GetAttributeForAllPoints<int16_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_INT:
+      decodeResult =
+          GetAttributeForAllPoints<int32_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      decodeResult =
+          GetAttributeForAllPoints<uint32_t>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+      decodeResult =
+          GetAttributeForAllPoints<float>(mesh, pAttribute, outBuffer);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+      decodeResult =
+          GetAttributeForAllPoints<double>(mesh, pAttribute, outBuffer);
+      break;
+    default:
+      return false;
   }
+
+  return decodeResult;
 }
 
-static std::string FindFile(const std::vector<std::string> &paths,
-                            const std::string &filepath, FsCallbacks *fs) {
-  if (fs == nullptr || fs->ExpandFilePath == nullptr ||
-      fs->FileExists == nullptr) {
-    // Error, fs callback[s] missing
-    return std::string();
-  }
+// KHR_draco_mesh_compression primitives are decoded in a stage after all
+// meshes are parsed. Defined at the end of the implementation.
+static bool DecodeDracoPrimitives(Model *model, std::string *err,
+                                  std::string *warn,
+                                  ParseStrictness strictness,
+                                  const GeometryCacheCallbacks *cache,
+                                  int num_threads);
+#endif
 
-  // https://github.com/syoyo/tinygltf/issues/416
-  // Use strlen() since std::string's size/length reports the number of elements
-  // in the buffer, not the length of string(null-terminated) strip
-  // null-character in the middle of string.
-  size_t slength = strlen(filepath.c_str());
-  if (slength == 0) {
-    return std::string();
+static bool ParsePrimitive(Primitive *primitive, Model *model,
+                           std::string *err, std::string *warn,
+                           const detail::json &o,
+                           bool store_original_json_for_extras_and_extensions,
+                           ParseStrictness strictness) {
+  int material = -1;
+  ParseIntegerProperty(&material, err, o, "material", false);
+  primitive->material = material;
+
+  int mode = TINYGLTF_MODE_TRIANGLES;
+  ParseIntegerProperty(&mode, err, o, "mode", false);
+  primitive->mode = mode;  // Why only triangles were supported ?
+
+  int indices = -1;
+  ParseIntegerProperty(&indices, err, o, "indices", false);
+  primitive->indices = indices;
+  if (!ParseStringIntegerProperty(&primitive->attributes, err, o, "attributes",
+                                  true, "Primitive")) {
+    return false;
   }
 
-  std::string cleaned_filepath = std::string(filepath.c_str());
+  // Look for morph targets
+  detail::json_const_iterator targetsObject;
+  if (detail::FindMember(o, "targets", targetsObject) &&
+      detail::IsArray(detail::GetValue(targetsObject))) {
+    auto targetsObjectEnd = detail::ArrayEnd(detail::GetValue(targetsObject));
+    for (detail::json_const_array_iterator i =
+             detail::ArrayBegin(detail::GetValue(targetsObject));
+         i != targetsObjectEnd; ++i) {
+      std::map<std::string, int> targetAttribues;
+
+      const detail::json &dict = *i;
+      if (detail::IsObject(dict)) {
+        detail::json_const_iterator dictIt(detail::ObjectBegin(dict));
+        detail::json_const_iterator dictItEnd(detail::ObjectEnd(dict));
 
-  for (size_t i = 0; i < paths.size(); i++) {
-    std::string absPath =
-        fs->ExpandFilePath(JoinPath(paths[i], cleaned_filepath), fs->user_data);
-    if (fs->FileExists(absPath, fs->user_data)) {
-      return absPath;
+        for (; dictIt != dictItEnd; ++dictIt) {
+          int iVal;
+          if (detail::GetInt(detail::GetValue(dictIt), iVal))
+            targetAttribues[detail::GetKey(dictIt)] = iVal;
+        }
+        primitive->targets.emplace_back(std::move(targetAttribues));
+      }
     }
   }
 
-  return std::string();
-}
-
-static std::string GetFilePathExtension(const std::string &FileName) {
-  if (FileName.find_last_of(".") != std::string::npos)
-    return FileName.substr(FileName.find_last_of(".") + 1);
-  return "";
-}
+  ParseExtrasAndExtensions(primitive, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-static std::string GetBaseDir(const std::string &filepath) {
-  if (filepath.find_last_of("/\\") != std::string::npos)
-    return filepath.substr(0, filepath.find_last_of("/\\") + 1);
-  return "";
-}
+  // KHR_draco_mesh_compression is decoded after all meshes are parsed.
+  (void)model;
+  (void)warn;
+  (void)strictness;
 
-static std::string GetBaseFilename(const std::string &filepath) {
-  auto idx = filepath.find_last_of("/\\");
-  if (idx != std::string::npos) return filepath.substr(idx + 1);
-  return filepath;
+  return true;
 }
 
-std::string base64_encode(unsigned char const *, unsigned int len);
-std::string base64_decode(std::string const &s);
-
-/*
-   base64.cpp and base64.h
-
-   Copyright (C) 2004-2008 René Nyffenegger
+static bool ParseMesh(Mesh *mesh, Model *model,
+                      std::string *err, std::string *warn,
+                      const detail::json &o,
+                      bool store_original_json_for_extras_and_extensions,
+                      ParseStrictness strictness) {
+  ParseStringProperty(&mesh->name, err, o, "name", false);
 
-   This source code is provided 'as-is', without any express or implied
-   warranty. In no event will the author be held liable for any damages
-   arising from the use of this software.
+  mesh->primitives.clear();
+  detail::json_const_iterator primObject;
+  if (detail::FindMember(o, "primitives", primObject) &&
+      detail::IsArray(detail::GetValue(primObject))) {
+    detail::json_const_array_iterator primEnd =
+        detail::ArrayEnd(detail::GetValue(primObject));
+    for (detail::json_const_array_iterator i =
+             detail::ArrayBegin(detail::GetValue(primObject));
+         i != primEnd; ++i) {
+      Primitive primitive;
+      if (ParsePrimitive(&primitive, model, err, warn, *i,
+                         store_original_json_for_extras_and_extensions,
+                         strictness)) {
+        // Only add the primitive if the parsing succeeds.
+        mesh->primitives.emplace_back(std::move(primitive));
+      }
+    }
+  }
 
-   Permission is granted to anyone to use this software for any purpose,
-   including commercial applications, and to alter it and redistribute it
-   freely, subject to the following restrictions:
+  // Should probably check if has targets and if dimensions fit
+  ParseNumberArrayProperty(&mesh->weights, err, o, "weights", false);
 
-   1. The origin of this source code must not be misrepresented; you must not
-      claim that you wrote the original source code. If you use this source code
-      in a product, an acknowledgment in the product documentation would be
-      appreciated but is not required.
+  ParseExtrasAndExtensions(mesh, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-   2. Altered source versions must be plainly marked as such, and must not be
-      misrepresented as being the original source code.
+  return true;
+}
 
-   3. This notice may not be removed or altered from any source distribution.
+static bool ParseNode(Node *node, std::string *err, const detail::json &o,
+                      bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&node->name, err, o, "name", false);
 
-   René Nyffenegger rene.nyffenegger@adp-gmbh.ch
+  int skin = -1;
+  ParseIntegerProperty(&skin, err, o, "skin", false);
+  node->skin = skin;
 
-*/
+  // Matrix and T/R/S are exclusive
+  if (!ParseNumberArrayProperty(&node->matrix, err, o, "matrix", false)) {
+    ParseNumberArrayProperty(&node->rotation, err, o, "rotation", false);
+    ParseNumberArrayProperty(&node->scale, err, o, "scale", false);
+    ParseNumberArrayProperty(&node->translation, err, o, "translation", false);
+  }
 
-#ifdef __clang__
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wsign-conversion"
-#pragma clang diagnostic ignored "-Wconversion"
-#endif
+  int camera = -1;
+  ParseIntegerProperty(&camera, err, o, "camera", false);
+  node->camera = camera;
 
-static inline bool is_base64(unsigned char c) {
-  return (isalnum(c) || (c == '+') || (c == '/'));
-}
+  int mesh = -1;
+  ParseIntegerProperty(&mesh, err, o, "mesh", false);
+  node->mesh = mesh;
 
-std::string base64_encode(unsigned char const *bytes_to_encode,
-                          unsigned int in_len) {
-  std::string ret;
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3];
-  unsigned char char_array_4[4];
+  node->children.clear();
+  ParseIntegerArrayProperty(&node->children, err, o, "children", false);
 
-  const char *base64_chars =
-      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-      "abcdefghijklmnopqrstuvwxyz"
-      "0123456789+/";
+  ParseNumberArrayProperty(&node->weights, err, o, "weights", false);
 
-  while (in_len--) {
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) {
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] =
-          ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] =
-          ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
+  ParseExtrasAndExtensions(node, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-      for (i = 0; (i < 4); i++) ret += base64_chars[char_array_4[i]];
-      i = 0;
+  // KHR_lights_punctual: parse light source reference
+  int light = -1;
+  if (node->extensions.count("KHR_lights_punctual") != 0) {
+    auto const &light_ext = node->extensions["KHR_lights_punctual"];
+    if (light_ext.Has("light")) {
+      light = light_ext.Get("light").GetNumberAsInt();
+    } else {
+      if (err) {
+        *err +=
+            "Node has extension KHR_lights_punctual, but does not reference "
+            "a light source.\n";
+      }
+      return false;
     }
   }
+  node->light = light;
 
-  if (i) {
-    for (j = i; j < 3; j++) char_array_3[j] = '\0';
-
-    char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] =
-        ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] =
-        ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-
-    for (j = 0; (j < i + 1); j++) ret += base64_chars[char_array_4[j]];
+  // KHR_audio: parse audio source reference
+  int emitter = -1;
+  if (node->extensions.count("KHR_audio") != 0) {
+    auto const &audio_ext = node->extensions["KHR_audio"];
+    if (audio_ext.Has("emitter")) {
+      emitter = audio_ext.Get("emitter").GetNumberAsInt();
+    } else {
+      if (err) {
+        *err +=
+            "Node has extension KHR_audio, but does not reference "
+            "a audio emitter.\n";
+      }
+      return false;
+    }
+  }
+  node->emitter = emitter;
 
-    while ((i++ < 3)) ret += '=';
+  node->lods.clear();
+  if (node->extensions.count("MSFT_lod") != 0) {
+    auto const &msft_lod_ext = node->extensions["MSFT_lod"];
+    if (msft_lod_ext.Has("ids")) {
+      auto idsArr = msft_lod_ext.Get("ids");
+      for (size_t i = 0; i < idsArr.ArrayLen(); ++i) {
+        node->lods.emplace_back(idsArr.Get(i).GetNumberAsInt());
+      }
+    } else {
+      if (err) {
+        *err +=
+            "Node has extension MSFT_lod, but does not reference "
+            "other nodes via their ids.\n";
+      }
+      return false;
+    }
   }
 
-  return ret;
+  return true;
 }
 
-std::string base64_decode(std::string const &encoded_string) {
-  int in_len = static_cast<int>(encoded_string.size());
-  int i = 0;
-  int j = 0;
-  int in_ = 0;
-  unsigned char char_array_4[4], char_array_3[3];
-  std::string ret;
+static bool ParseScene(Scene *scene, std::string *err, const detail::json &o,
+                       bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&scene->name, err, o, "name", false);
+  ParseIntegerArrayProperty(&scene->nodes, err, o, "nodes", false);
 
-  const std::string base64_chars =
-      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-      "abcdefghijklmnopqrstuvwxyz"
-      "0123456789+/";
+  ParseExtrasAndExtensions(scene, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  while (in_len-- && (encoded_string[in_] != '=') &&
-         is_base64(encoded_string[in_])) {
-    char_array_4[i++] = encoded_string[in_];
-    in_++;
-    if (i == 4) {
-      for (i = 0; i < 4; i++)
-        char_array_4[i] =
-            static_cast<unsigned char>(base64_chars.find(char_array_4[i]));
+  // Parse KHR_audio global emitters
+  if (scene->extensions.count("KHR_audio") != 0) {
+    auto const &audio_ext = scene->extensions["KHR_audio"];
+    if (audio_ext.Has("emitters")) {
+      auto emittersArr = audio_ext.Get("emitters");
+      for (size_t i = 0; i < emittersArr.ArrayLen(); ++i) {
+        scene->audioEmitters.emplace_back(emittersArr.Get(i).GetNumberAsInt());
+      }
+    } else {
+      if (err) {
+        *err +=
+            "Node has extension KHR_audio, but does not reference "
+            "a audio emitter.\n";
+      }
+      return false;
+    }
+  }
 
-      char_array_3[0] =
-          (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-      char_array_3[1] =
-          ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+  return true;
+}
 
-      for (i = 0; (i < 3); i++) ret += char_array_3[i];
-      i = 0;
+static bool ParsePbrMetallicRoughness(
+    PbrMetallicRoughness *pbr, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  if (pbr == nullptr) {
+    return false;
+  }
+
+  std::vector<double> baseColorFactor;
+  if (ParseNumberArrayProperty(&baseColorFactor, err, o, "baseColorFactor",
+                               /* required */ false)) {
+    if (baseColorFactor.size() != 4) {
+      if (err) {
+        (*err) +=
+            "Array length of `baseColorFactor` parameter in "
+            "pbrMetallicRoughness must be 4, but got " +
+            std::to_string(baseColorFactor.size()) + "\n";
+      }
+      return false;
     }
+    pbr->baseColorFactor = baseColorFactor;
   }
 
-  if (i) {
-    for (j = i; j < 4; j++) char_array_4[j] = 0;
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "baseColorTexture", it)) {
+      ParseTextureInfo(&pbr->baseColorTexture, err, detail::GetValue(it),
+                       store_original_json_for_extras_and_extensions);
+    }
+  }
 
-    for (j = 0; j < 4; j++)
-      char_array_4[j] =
-          static_cast<unsigned char>(base64_chars.find(char_array_4[j]));
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "metallicRoughnessTexture", it)) {
+      ParseTextureInfo(&pbr->metallicRoughnessTexture, err,
+                       detail::GetValue(it),
+                       store_original_json_for_extras_and_extensions);
+    }
+  }
 
-    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-    char_array_3[1] =
-        ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-    char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+  ParseNumberProperty(&pbr->metallicFactor, err, o, "metallicFactor", false);
+  ParseNumberProperty(&pbr->roughnessFactor, err, o, "roughnessFactor", false);
 
-    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
-  }
+  ParseExtrasAndExtensions(pbr, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  return ret;
+  return true;
 }
-#ifdef __clang__
-#pragma clang diagnostic pop
-#endif
 
-// https://github.com/syoyo/tinygltf/issues/228
-// TODO(syoyo): Use uriparser https://uriparser.github.io/ for stricter Uri
-// decoding?
-//
-// Uri Decoding from DLIB
-// http://dlib.net/dlib/server/server_http.cpp.html
-// --- dlib begin ------------------------------------------------------------
-// Copyright (C) 2003  Davis E. King (davis@dlib.net)
-// License: Boost Software License
-// Boost Software License - Version 1.0 - August 17th, 2003
+static bool ParseMaterial(Material *material, std::string *err, std::string *warn,
+                          const detail::json &o,
+                          bool store_original_json_for_extras_and_extensions,
+                          ParseStrictness strictness) {
+  ParseStringProperty(&material->name, err, o, "name", /* required */ false);
 
-// Permission is hereby granted, free of charge, to any person or organization
-// obtaining a copy of the software and accompanying documentation covered by
-// this license (the "Software") to use, reproduce, display, distribute,
-// execute, and transmit the Software, and to prepare derivative works of the
-// Software, and to permit third-parties to whom the Software is furnished to
-// do so, all subject to the following:
-// The copyright notices in the Software and this entire statement, including
-// the above license grant, this restriction and the following disclaimer,
-// must be included in all copies of the Software, in whole or in part, and
-// all derivative works of the Software, unless such copies or derivative
-// works are solely in the form of machine-executable object code generated by
-// a source language processor.
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
-// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
-// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
-// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
-// DEALINGS IN THE SOFTWARE.
-//
-namespace dlib {
+  if (ParseNumberArrayProperty(&material->emissiveFactor, err, o,
+                               "emissiveFactor",
+                               /* required */ false)) {
+    if (strictness==ParseStrictness::Permissive && material->emissiveFactor.size() == 4) {
+      if (warn) {
+        (*warn) +=
+            "Array length of `emissiveFactor` parameter in "
+            "material must be 3, but got 4\n";
+      }
+      material->emissiveFactor.resize(3);
+    }
+    else if (material->emissiveFactor.size() != 3) {
+      if (err) {
+        (*err) +=
+            "Array length of `emissiveFactor` parameter in "
+            "material must be 3, but got " +
+            std::to_string(material->emissiveFactor.size()) + "\n";
+      }
+      return false;
+    }
+  } else {
+    // fill with default values
+    material->emissiveFactor = {0.0, 0.0, 0.0};
+  }
 
-inline unsigned char from_hex(unsigned char ch) {
-  if (ch <= '9' && ch >= '0')
-    ch -= '0';
-  else if (ch <= 'f' && ch >= 'a')
-    ch -= 'a' - 10;
-  else if (ch <= 'F' && ch >= 'A')
-    ch -= 'A' - 10;
-  else
-    ch = 0;
-  return ch;
-}
+  ParseStringProperty(&material->alphaMode, err, o, "alphaMode",
+                      /* required */ false);
+  ParseNumberProperty(&material->alphaCutoff, err, o, "alphaCutoff",
+                      /* required */ false);
+  ParseBooleanProperty(&material->doubleSided, err, o, "doubleSided",
+                       /* required */ false);
 
-static const std::string urldecode(const std::string &str) {
-  using namespace std;
-  string result;
-  string::size_type i;
-  for (i = 0; i < str.size(); ++i) {
-    if (str[i] == '+') {
-      result += ' ';
-    } else if (str[i] == '%' && str.size() > i + 2) {
-      const unsigned char ch1 =
-          from_hex(static_cast<unsigned char>(str[i + 1]));
-      const unsigned char ch2 =
-          from_hex(static_cast<unsigned char>(str[i + 2]));
-      const unsigned char ch = static_cast<unsigned char>((ch1 << 4) | ch2);
-      result += static_cast<char>(ch);
-      i += 2;
-    } else {
-      result += str[i];
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "pbrMetallicRoughness", it)) {
+      ParsePbrMetallicRoughness(&material->pbrMetallicRoughness, err,
+                                detail::GetValue(it),
+                                store_original_json_for_extras_and_extensions);
     }
   }
-  return result;
-}
 
-}  // namespace dlib
-// --- dlib end --------------------------------------------------------------
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "normalTexture", it)) {
+      ParseNormalTextureInfo(&material->normalTexture, err,
+                             detail::GetValue(it),
+                             store_original_json_for_extras_and_extensions);
+    }
+  }
 
-bool URIDecode(const std::string &in_uri, std::string *out_uri,
-               void *user_data) {
-  (void)user_data;
-  *out_uri = dlib::urldecode(in_uri);
-  return true;
-}
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "occlusionTexture", it)) {
+      ParseOcclusionTextureInfo(&material->occlusionTexture, err,
+                                detail::GetValue(it),
+                                store_original_json_for_extras_and_extensions);
+    }
+  }
 
-static bool LoadExternalFile(std::vector<unsigned char> *out, std::string *err,
-                             std::string *warn, const std::string &filename,
-                             const std::string &basedir, bool required,
-                             size_t reqBytes, bool checkSize,
-                             size_t maxFileSize, FsCallbacks *fs) {
-  if (fs == nullptr || fs->FileExists == nullptr ||
-      fs->ExpandFilePath == nullptr || fs->ReadWholeFile == nullptr) {
-    // This is a developer error, assert() ?
-    if (err) {
-      (*err) += "FS callback[s] not set\n";
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(o, "emissiveTexture", it)) {
+      ParseTextureInfo(&material->emissiveTexture, err, detail::GetValue(it),
+                       store_original_json_for_extras_and_extensions);
     }
-    return false;
   }
 
-  std::string *failMsgOut = required ? err : warn;
+  // Old code path. For backward compatibility, we still store material values
+  // as Parameter. This will create duplicated information for
+  // example(pbrMetallicRoughness), but should be negligible in terms of memory
+  // consumption.
+  // TODO(syoyo): Remove in the next major release.
+  material->values.clear();
+  material->additionalValues.clear();
 
-  out->clear();
+  detail::json_const_iterator it(detail::ObjectBegin(o));
+  detail::json_const_iterator itEnd(detail::ObjectEnd(o));
 
-  std::vector<std::string> paths;
-  paths.push_back(basedir);
-  paths.push_back(".");
+  for (; it != itEnd; ++it) {
+    std::string key(detail::GetKey(it));
+    if (key == "pbrMetallicRoughness") {
+      if (detail::IsObject(detail::GetValue(it))) {
+        const detail::json &values_object = detail::GetValue(it);
 
-  std::string filepath = FindFile(paths, filename, fs);
-  if (filepath.empty() || filename.empty()) {
-    if (failMsgOut) {
-      (*failMsgOut) += "File not found : " + filename + "\n";
+        detail::json_const_iterator itVal(detail::ObjectBegin(values_object));
+        detail::json_const_iterator itValEnd(detail::ObjectEnd(values_object));
+
+        for (; itVal != itValEnd; ++itVal) {
+          Parameter param;
+          if (ParseParameterProperty(&param, err, values_object,
+                                     detail::GetKey(itVal), false)) {
+            material->values.emplace(detail::GetKey(itVal), std::move(param));
+          }
+        }
+      }
+    } else if (key == "extensions" || key == "extras") {
+      // done later, skip, otherwise poorly parsed contents will be saved in the
+      // parametermap and serialized again later
+    } else {
+      Parameter param;
+      if (ParseParameterProperty(&param, err, o, key, false)) {
+        // names of materials have already been parsed. Putting it in this map
+        // doesn't correctly reflect the glTF specification
+        if (key != "name")
+          material->additionalValues.emplace(std::move(key), std::move(param));
+      }
     }
-    return false;
   }
 
-  // Check file size
-  if (fs->GetFileSizeInBytes) {
-    size_t file_size{0};
-    std::string _err;
-    bool ok =
-        fs->GetFileSizeInBytes(&file_size, &_err, filepath, fs->user_data);
-    if (!ok) {
-      if (_err.size()) {
-        if (failMsgOut) {
-          (*failMsgOut) += "Getting file size failed : " + filename +
-                           ", err = " + _err + "\n";
-        }
+  material->extensions.clear();  // Note(agnat): Why?
+  ParseExtrasAndExtensions(material, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  material->lods.clear();
+  if (material->extensions.count("MSFT_lod") != 0) {
+    auto const &msft_lod_ext = material->extensions["MSFT_lod"];
+    if (msft_lod_ext.Has("ids")) {
+      auto idsArr = msft_lod_ext.Get("ids");
+      for (size_t i = 0; i < idsArr.ArrayLen(); ++i) {
+        material->lods.emplace_back(idsArr.Get(i).GetNumberAsInt());
       }
-      return false;
-    }
-
-    if (file_size > maxFileSize) {
-      if (failMsgOut) {
-        (*failMsgOut) += "File size " + std::to_string(file_size) +
-                         " exceeds maximum allowed file size " +
-                         std::to_string(maxFileSize) + " : " + filepath + "\n";
+    } else {
+      if (err) {
+        *err +=
+            "Material has extension MSFT_lod, but does not reference "
+            "other materials via their ids.\n";
       }
       return false;
     }
   }
 
-  std::vector<unsigned char> buf;
-  std::string fileReadErr;
-  bool fileRead =
-      fs->ReadWholeFile(&buf, &fileReadErr, filepath, fs->user_data);
-  if (!fileRead) {
-    if (failMsgOut) {
-      (*failMsgOut) +=
-          "File read error : " + filepath + " : " + fileReadErr + "\n";
-    }
-    return false;
-  }
+  return true;
+}
 
-  size_t sz = buf.size();
-  if (sz == 0) {
-    if (failMsgOut) {
-      (*failMsgOut) += "File is empty : " + filepath + "\n";
+static bool ParseAnimationChannel(
+    AnimationChannel *channel, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  int samplerIndex = -1;
+  int targetIndex = -1;
+  if (!ParseIntegerProperty(&samplerIndex, err, o, "sampler", true,
+                            "AnimationChannel")) {
+    if (err) {
+      (*err) += "`sampler` field is missing in animation channels\n";
     }
     return false;
   }
 
-  if (checkSize) {
-    if (reqBytes == sz) {
-      out->swap(buf);
-      return true;
-    } else {
-      std::stringstream ss;
-      ss << "File size mismatch : " << filepath << ", requestedBytes "
-         << reqBytes << ", but got " << sz << std::endl;
-      if (failMsgOut) {
-        (*failMsgOut) += ss.str();
+  detail::json_const_iterator targetIt;
+  if (detail::FindMember(o, "target", targetIt) &&
+      detail::IsObject(detail::GetValue(targetIt))) {
+    const detail::json &target_object = detail::GetValue(targetIt);
+
+    ParseIntegerProperty(&targetIndex, err, target_object, "node", false);
+
+    if (!ParseStringProperty(&channel->target_path, err, target_object, "path",
+                             true)) {
+      if (err) {
+        (*err) += "`path` field is missing in animation.channels.target\n";
       }
       return false;
     }
+    ParseExtensionsProperty(&channel->target_extensions, err, target_object);
+    ParseExtrasProperty(&channel->target_extras, target_object);
+    if (store_original_json_for_extras_and_extensions) {
+      {
+        detail::json_const_iterator it;
+        if (detail::FindMember(target_object, "extensions", it)) {
+          channel->target_extensions_json_string =
+              detail::JsonToString(detail::GetValue(it));
+        }
+      }
+      {
+        detail::json_const_iterator it;
+        if (detail::FindMember(target_object, "extras", it)) {
+          channel->target_extras_json_string =
+              detail::JsonToString(detail::GetValue(it));
+        }
+      }
+    }
   }
 
-  out->swap(buf);
-  return true;
-}
+  channel->sampler = samplerIndex;
+  channel->target_node = targetIndex;
 
-void TinyGLTF::SetParseStrictness(ParseStrictness strictness) {
-  strictness_ = strictness;
-}
+  ParseExtrasAndExtensions(channel, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-void TinyGLTF::SetImageLoader(LoadImageDataFunction func, void *user_data) {
-  if (func == nullptr) {
-    RemoveImageLoader();
-    return;
-  }
-  LoadImageData = std::move(func);
-  load_image_user_data_ = user_data;
-  user_image_loader_ = true;
+  return true;
 }
 
-void TinyGLTF::RemoveImageLoader() {
-  LoadImageData =
-#ifndef TINYGLTF_NO_STB_IMAGE
-      &tinygltf::LoadImageData;
-#else
-      nullptr;
-#endif
+static bool ParseAnimation(Animation *animation, std::string *err,
+                           const detail::json &o,
+                           bool store_original_json_for_extras_and_extensions) {
+  {
+    detail::json_const_iterator channelsIt;
+    if (detail::FindMember(o, "channels", channelsIt) &&
+        detail::IsArray(detail::GetValue(channelsIt))) {
+      detail::json_const_array_iterator channelEnd =
+          detail::ArrayEnd(detail::GetValue(channelsIt));
+      for (detail::json_const_array_iterator i =
+               detail::ArrayBegin(detail::GetValue(channelsIt));
+           i != channelEnd; ++i) {
+        AnimationChannel channel;
+        if (ParseAnimationChannel(
+                &channel, err, *i,
+                store_original_json_for_extras_and_extensions)) {
+          // Only add the channel if the parsing succeeds.
+          animation->channels.emplace_back(std::move(channel));
+        }
+      }
+    }
+  }
 
-  load_image_user_data_ = nullptr;
-  user_image_loader_ = false;
-}
+  {
+    detail::json_const_iterator samplerIt;
+    if (detail::FindMember(o, "samplers", samplerIt) &&
+        detail::IsArray(detail::GetValue(samplerIt))) {
+      const detail::json &sampler_array = detail::GetValue(samplerIt);
 
-#ifndef TINYGLTF_NO_STB_IMAGE
-bool LoadImageData(Image *image, const int image_idx, std::string *err,
-                   std::string *warn, int req_width, int req_height,
-                   const unsigned char *bytes, int size, void *user_data) {
-  (void)warn;
+      detail::json_const_array_iterator it = detail::ArrayBegin(sampler_array);
+      detail::json_const_array_iterator itEnd = detail::ArrayEnd(sampler_array);
 
-  LoadImageDataOption option;
-  if (user_data) {
-    option = *reinterpret_cast<LoadImageDataOption *>(user_data);
-  }
+      for (; it != itEnd; ++it) {
+        const detail::json &s = *it;
 
-  int w = 0, h = 0, comp = 0, req_comp = 0;
+        AnimationSampler sampler;
+        int inputIndex = -1;
+        int outputIndex = -1;
+        if (!ParseIntegerProperty(&inputIndex, err, s, "input", true)) {
+          if (err) {
+            (*err) += "`input` field is missing in animation.sampler\n";
+          }
+          return false;
+        }
+        ParseStringProperty(&sampler.interpolation, err, s, "interpolation",
+                            false);
+        if (!ParseIntegerProperty(&outputIndex, err, s, "output", true)) {
+          if (err) {
+            (*err) += "`output` field is missing in animation.sampler\n";
+          }
+          return false;
+        }
+        sampler.input = inputIndex;
+        sampler.output = outputIndex;
+        ParseExtrasAndExtensions(&sampler, err, s,
+                                 store_original_json_for_extras_and_extensions);
 
-  // Try to decode image header
-  if (!stbi_info_from_memory(bytes, size, &w, &h, &comp)) {
-    // On failure, if we load images as is, we just warn.
-    std::string* msgOut = option.as_is ? warn : err;
-    if (msgOut) {
-      (*msgOut) +=
-        "Unknown image format. STB cannot decode image header for image[" +
-        std::to_string(image_idx) + "] name = \"" + image->name + "\".\n";
-    }
-    if (!option.as_is) {
-      // If we decode images, error out.
-      return false;
-    } else {
-      // If we load images as is, we copy the image data,
-      // set all image properties to invalid, and report success.
-      image->width = image->height = image->component = -1;
-      image->bits = image->pixel_type = -1;
-      image->image.resize(static_cast<size_t>(size));
-      std::copy(bytes, bytes + size, image->image.begin());
-      return true;
+        animation->samplers.emplace_back(std::move(sampler));
+      }
     }
   }
 
-  int bits = 8;
-  int pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  ParseStringProperty(&animation->name, err, o, "name", false);
 
-  if (stbi_is_16_bit_from_memory(bytes, size)) {
-    bits = 16;
-    pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
-  }
+  ParseExtrasAndExtensions(animation, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  // preserve_channels true: Use channels stored in the image file.
-  // false: force 32-bit textures for common Vulkan compatibility. It appears
-  // that some GPU drivers do not support 24-bit images for Vulkan
-  req_comp = (option.preserve_channels || option.as_is) ? 0 : 4;
+  return true;
+}
 
-  unsigned char* data = nullptr;
-  // Perform image decoding if requested
-  if (!option.as_is) {
-    // If the image is marked as 16 bit per channel, attempt to decode it as such first.
-    // If that fails, we are going to attempt to load it as 8 bit per channel image.
-    if (bits == 16) {
-      data = reinterpret_cast<unsigned char *>(stbi_load_16_from_memory(bytes, size, &w, &h, &comp, req_comp));
-    }
-    // Load as 8 bit per channel data
-    if (!data) {
-      data = stbi_load_from_memory(bytes, size, &w, &h, &comp, req_comp);
-      if (!data) {
-        if (err) {
-          (*err) +=
-            "Unknown image format. STB cannot decode image data for image[" +
-            std::to_string(image_idx) + "] name = \"" + image->name + "\".\n";
-        }
-        return false;
-      }
-      // If we were succesful, mark as 8 bit
-      bits = 8;
-      pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-    }
-  }
+static bool ParseSampler(Sampler *sampler, std::string *err,
+                         const detail::json &o,
+                         bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&sampler->name, err, o, "name", false);
+
+  int minFilter = -1;
+  int magFilter = -1;
+  int wrapS = TINYGLTF_TEXTURE_WRAP_REPEAT;
+  int wrapT = TINYGLTF_TEXTURE_WRAP_REPEAT;
+  // int wrapR = TINYGLTF_TEXTURE_WRAP_REPEAT;
+  ParseIntegerProperty(&minFilter, err, o, "minFilter", false);
+  ParseIntegerProperty(&magFilter, err, o, "magFilter", false);
+  ParseIntegerProperty(&wrapS, err, o, "wrapS", false);
+  ParseIntegerProperty(&wrapT, err, o, "wrapT", false);
+  // ParseIntegerProperty(&wrapR, err, o, "wrapR", false);  // tinygltf
+  // extension
+
+  // TODO(syoyo): Check the value is allowed one.
+  // (e.g. we allow 9728(NEAREST), but don't allow 9727)
+
+  sampler->minFilter = minFilter;
+  sampler->magFilter = magFilter;
+  sampler->wrapS = wrapS;
+  sampler->wrapT = wrapT;
+  // sampler->wrapR = wrapR;
+
+  ParseExtrasAndExtensions(sampler, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
+}
 
-  if ((w < 1) || (h < 1)) {
-    stbi_image_free(data);
-    if (err) {
-      (*err) += "Invalid image data for image[" + std::to_string(image_idx) +
-                "] name = \"" + image->name + "\"\n";
-    }
+static bool ParseSkin(Skin *skin, std::string *err, const detail::json &o,
+                      bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&skin->name, err, o, "name", false, "Skin");
+
+  std::vector<int> joints;
+  if (!ParseIntegerArrayProperty(&joints, err, o, "joints", false, "Skin")) {
     return false;
   }
+  skin->joints = std::move(joints);
 
-  if (req_width > 0) {
-    if (req_width != w) {
-      stbi_image_free(data);
-      if (err) {
-        (*err) += "Image width mismatch for image[" +
-                  std::to_string(image_idx) + "] name = \"" + image->name +
-                  "\"\n";
-      }
-      return false;
-    }
-  }
+  int skeleton = -1;
+  ParseIntegerProperty(&skeleton, err, o, "skeleton", false, "Skin");
+  skin->skeleton = skeleton;
 
-  if (req_height > 0) {
-    if (req_height != h) {
-      stbi_image_free(data);
-      if (err) {
-        (*err) += "Image height mismatch. for image[" +
-                  std::to_string(image_idx) + "] name = \"" + image->name +
-                  "\"\n";
-      }
-      return false;
-    }
-  }
+  int invBind = -1;
+  ParseIntegerProperty(&invBind, err, o, "inverseBindMatrices", false, "Skin");
+  skin->inverseBindMatrices = invBind;
 
-  if (req_comp != 0) {
-    // loaded data has `req_comp` channels(components)
-    comp = req_comp;
-  }
+  ParseExtrasAndExtensions(skin, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  image->width = w;
-  image->height = h;
-  image->component = comp;
-  image->bits = bits;
-  image->pixel_type = pixel_type;
-  image->as_is = option.as_is;
+  return true;
+}
 
-  if (option.as_is) {
-    // Store the original image data
-    image->image.resize(static_cast<size_t>(size));
-    std::copy(bytes, bytes + size, image->image.begin());
+static bool ParsePerspectiveCamera(
+    PerspectiveCamera *camera, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  double yfov = 0.0;
+  if (!ParseNumberProperty(&yfov, err, o, "yfov", true, "OrthographicCamera")) {
+    return false;
   }
-  else {
-    // Store the decoded image data
-    image->image.resize(static_cast<size_t>(w * h * comp) * size_t(bits / 8));
-    std::copy(data, data + w * h * comp * (bits / 8), image->image.begin());
+
+  double znear = 0.0;
+  if (!ParseNumberProperty(&znear, err, o, "znear", true,
+                           "PerspectiveCamera")) {
+    return false;
   }
 
-  stbi_image_free(data);
+  double aspectRatio = 0.0;  // = invalid
+  ParseNumberProperty(&aspectRatio, err, o, "aspectRatio", false,
+                      "PerspectiveCamera");
+
+  double zfar = 0.0;  // = invalid
+  ParseNumberProperty(&zfar, err, o, "zfar", false, "PerspectiveCamera");
+
+  camera->aspectRatio = aspectRatio;
+  camera->zfar = zfar;
+  camera->yfov = yfov;
+  camera->znear = znear;
+
+  ParseExtrasAndExtensions(camera, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  // TODO(syoyo): Validate parameter values.
+
   return true;
 }
-#endif
 
-void TinyGLTF::SetImageWriter(WriteImageDataFunction func, void *user_data) {
-  WriteImageData = std::move(func);
-  write_image_user_data_ = user_data;
-}
+static bool ParseSpotLight(SpotLight *light, std::string *err,
+                           const detail::json &o,
+                           bool store_original_json_for_extras_and_extensions) {
+  ParseNumberProperty(&light->innerConeAngle, err, o, "innerConeAngle", false);
+  ParseNumberProperty(&light->outerConeAngle, err, o, "outerConeAngle", false);
 
-#ifndef TINYGLTF_NO_STB_IMAGE_WRITE
-static void WriteToMemory_stbi(void *context, void *data, int size) {
-  std::vector<unsigned char> *buffer =
-      reinterpret_cast<std::vector<unsigned char> *>(context);
+  ParseExtrasAndExtensions(light, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  unsigned char *pData = reinterpret_cast<unsigned char *>(data);
+  // TODO(syoyo): Validate parameter values.
 
-  buffer->insert(buffer->end(), pData, pData + size);
+  return true;
 }
 
-bool WriteImageData(const std::string *basepath, const std::string *filename,
-                    const Image *image, bool embedImages,
-                    const FsCallbacks* fs_cb, const URICallbacks *uri_cb,
-                    std::string *out_uri, void *) {
-  // Early out on empty images, report the original uri if the image was not written.
-  if (image->image.empty()) {
-    *out_uri = *filename;
-    return true;
+static bool ParseOrthographicCamera(
+    OrthographicCamera *camera, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  double xmag = 0.0;
+  if (!ParseNumberProperty(&xmag, err, o, "xmag", true, "OrthographicCamera")) {
+    return false;
   }
 
-  const std::string ext = GetFilePathExtension(*filename);
+  double ymag = 0.0;
+  if (!ParseNumberProperty(&ymag, err, o, "ymag", true, "OrthographicCamera")) {
+    return false;
+  }
 
-  // Write image to temporary buffer
-  std::string header;
-  std::vector<unsigned char> data;
+  double zfar = 0.0;
+  if (!ParseNumberProperty(&zfar, err, o, "zfar", true, "OrthographicCamera")) {
+    return false;
+  }
 
-  // If the image data is already encoded, take it as is
-  if (image->as_is) {
-      data = image->image;
+  double znear = 0.0;
+  if (!ParseNumberProperty(&znear, err, o, "znear", true,
+                           "OrthographicCamera")) {
+    return false;
   }
 
-  if (ext == "png") {
-    if (!image->as_is) {
-      if ((image->bits != 8) ||
-          (image->pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)) {
-          // Unsupported pixel format
-          return false;
-      }
+  ParseExtrasAndExtensions(camera, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-      if (!stbi_write_png_to_func(WriteToMemory_stbi, &data, image->width,
-                                  image->height, image->component,
-                                  &image->image[0], 0)) {
-        return false;
+  camera->xmag = xmag;
+  camera->ymag = ymag;
+  camera->zfar = zfar;
+  camera->znear = znear;
+
+  // TODO(syoyo): Validate parameter values.
+
+  return true;
+}
+
+static bool ParseCamera(Camera *camera, std::string *err, const detail::json &o,
+                        bool store_original_json_for_extras_and_extensions) {
+  if (!ParseStringProperty(&camera->type, err, o, "type", true, "Camera")) {
+    return false;
+  }
+
+  if (camera->type.compare("orthographic") == 0) {
+    detail::json_const_iterator orthoIt;
+    if (!detail::FindMember(o, "orthographic", orthoIt)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "Orthographic camera description not found." << std::endl;
+        (*err) += ss.str();
       }
-    }
-    header = "data:image/png;base64,";
-  } else if (ext == "jpg") {
-    if (!image->as_is &&
-        !stbi_write_jpg_to_func(WriteToMemory_stbi, &data, image->width,
-                                image->height, image->component,
-                                &image->image[0], 100)) {
       return false;
     }
-    header = "data:image/jpeg;base64,";
-  } else if (ext == "bmp") {
-    if (!image->as_is &&
-        !stbi_write_bmp_to_func(WriteToMemory_stbi, &data, image->width,
-                                image->height, image->component,
-                                &image->image[0])) {
+
+    const detail::json &v = detail::GetValue(orthoIt);
+    if (!detail::IsObject(v)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "\"orthographic\" is not a JSON object." << std::endl;
+        (*err) += ss.str();
+      }
       return false;
     }
-    header = "data:image/bmp;base64,";
-  } else if (!embedImages) {
-    // Error: can't output requested format to file
-    return false;
-  }
 
-  if (embedImages) {
-    // Embed base64-encoded image into URI
-    if (data.size()) {
-      *out_uri = header + base64_encode(&data[0],
-                                        static_cast<unsigned int>(data.size()));
-    } else {
-      // Throw error?
+    if (!ParseOrthographicCamera(
+            &camera->orthographic, err, v,
+            store_original_json_for_extras_and_extensions)) {
+      return false;
     }
-  } else {
-    // Write image to disc
-    if ((fs_cb != nullptr) && (fs_cb->WriteWholeFile != nullptr)) {
-      const std::string imagefilepath = JoinPath(*basepath, *filename);
-      std::string writeError;
-      if (!fs_cb->WriteWholeFile(&writeError, imagefilepath, data,
-                              fs_cb->user_data)) {
-        // Could not write image file to disc; Throw error ?
-        return false;
+  } else if (camera->type.compare("perspective") == 0) {
+    detail::json_const_iterator perspIt;
+    if (!detail::FindMember(o, "perspective", perspIt)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "Perspective camera description not found." << std::endl;
+        (*err) += ss.str();
       }
-    } else {
-      // Throw error?
+      return false;
     }
-    if (uri_cb->encode) {
-      if (!uri_cb->encode(*filename, "image", out_uri, uri_cb->user_data)) {
-        return false;
+
+    const detail::json &v = detail::GetValue(perspIt);
+    if (!detail::IsObject(v)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "\"perspective\" is not a JSON object." << std::endl;
+        (*err) += ss.str();
       }
-    } else {
-      *out_uri = *filename;
+      return false;
+    }
+
+    if (!ParsePerspectiveCamera(
+            &camera->perspective, err, v,
+            store_original_json_for_extras_and_extensions)) {
+      return false;
+    }
+  } else {
+    if (err) {
+      std::stringstream ss;
+      ss << "Invalid camera type: \"" << camera->type
+         << "\". Must be \"perspective\" or \"orthographic\"" << std::endl;
+      (*err) += ss.str();
     }
+    return false;
   }
 
-  return true;
-}
-#endif
+  ParseStringProperty(&camera->name, err, o, "name", false);
 
-bool TinyGLTF::SetURICallbacks(URICallbacks callbacks, std::string* err) {
-  if (callbacks.decode == nullptr) {
-    if (err != nullptr) {
-      *err = "URI Callback require a non-null decode function.";
-    }
-    return false;
-  }
+  ParseExtrasAndExtensions(camera, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  if (callbacks.decode) {
-    uri_cb = std::move(callbacks);
-  }
   return true;
 }
 
-bool TinyGLTF::SetFsCallbacks(FsCallbacks callbacks, std::string *err) {
-  // If callbacks are defined at all, they must all be defined.
-  if (callbacks.FileExists == nullptr || callbacks.ExpandFilePath == nullptr ||
-      callbacks.ReadWholeFile == nullptr ||
-      callbacks.WriteWholeFile == nullptr ||
-      callbacks.GetFileSizeInBytes == nullptr) {
-    if (err != nullptr) {
-      *err =
-          "FS Callbacks must be completely defined. At least one callback is "
-          "null.";
-    }
+static bool ParseLight(Light *light, std::string *err, const detail::json &o,
+                       bool store_original_json_for_extras_and_extensions) {
+  if (!ParseStringProperty(&light->type, err, o, "type", true)) {
     return false;
   }
-  fs = std::move(callbacks);
-  return true;
-}
-
-#ifdef _WIN32
-static inline std::wstring UTF8ToWchar(const std::string &str) {
-  int wstr_size =
-      MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), nullptr, 0);
-  std::wstring wstr((size_t)wstr_size, 0);
-  MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), &wstr[0],
-                      (int)wstr.size());
-  return wstr;
-}
 
-static inline std::string WcharToUTF8(const std::wstring &wstr) {
-  int str_size = WideCharToMultiByte(CP_UTF8, 0, wstr.data(), (int)wstr.size(),
-                                     nullptr, 0, nullptr, nullptr);
-  std::string str((size_t)str_size, 0);
-  WideCharToMultiByte(CP_UTF8, 0, wstr.data(), (int)wstr.size(), &str[0],
-                      (int)str.size(), nullptr, nullptr);
-  return str;
-}
-#endif
+  if (light->type == "spot") {
+    detail::json_const_iterator spotIt;
+    if (!detail::FindMember(o, "spot", spotIt)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "Spot light description not found." << std::endl;
+        (*err) += ss.str();
+      }
+      return false;
+    }
 
-#ifndef TINYGLTF_NO_FS
-// Default implementations of filesystem functions
+    const detail::json &v = detail::GetValue(spotIt);
+    if (!detail::IsObject(v)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "\"spot\" is not a JSON object." << std::endl;
+        (*err) += ss.str();
+      }
+      return false;
+    }
 
-bool FileExists(const std::string &abs_filename, void *) {
-  bool ret;
-#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
-  if (asset_manager) {
-    AAsset *asset = AAssetManager_open(asset_manager, abs_filename.c_str(),
-                                       AASSET_MODE_STREAMING);
-    if (!asset) {
+    if (!ParseSpotLight(&light->spot, err, v,
+                        store_original_json_for_extras_and_extensions)) {
       return false;
     }
-    AAsset_close(asset);
-    ret = true;
-  } else {
-    return false;
   }
-#else
-#ifdef _WIN32
-#if defined(_MSC_VER) || defined(_LIBCPP_VERSION)
 
-  // First check if a file is a directory.
-  DWORD result = GetFileAttributesW(UTF8ToWchar(abs_filename).c_str());
-  if (result == INVALID_FILE_ATTRIBUTES) {
-    return false;
-  }
-  if (result & FILE_ATTRIBUTE_DIRECTORY) {
-    return false;
-  }
+  ParseStringProperty(&light->name, err, o, "name", false);
+  ParseNumberArrayProperty(&light->color, err, o, "color", false);
+  ParseNumberProperty(&light->range, err, o, "range", false);
+  ParseNumberProperty(&light->intensity, err, o, "intensity", false);
 
-  FILE *fp = nullptr;
-  errno_t err = _wfopen_s(&fp, UTF8ToWchar(abs_filename).c_str(), L"rb");
-  if (err != 0) {
-    return false;
-  }
-#elif defined(__GLIBCXX__)
-  FILE *fp = fopen(abs_filename.c_str(), "rb");
-  if (!fp) {
-    return false;
-  }
-#else
-  // TODO: is_directory check
-  FILE *fp = nullptr;
-  errno_t err = fopen_s(&fp, abs_filename.c_str(), "rb");
-  if (err != 0) {
-    return false;
-  }
-#endif
+  ParseExtrasAndExtensions(light, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-#else
-  struct stat sb;
-  if (stat(abs_filename.c_str(), &sb)) {
-    return false;
-  }
-  if (S_ISDIR(sb.st_mode)) {
-    return false;
-  }
+  return true;
+}
 
-  FILE *fp = fopen(abs_filename.c_str(), "rb");
-#endif
-  if (fp) {
-    ret = true;
-    fclose(fp);
-  } else {
-    ret = false;
-  }
-#endif
+static bool ParsePositionalEmitter(
+    PositionalEmitter *positional, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  ParseNumberProperty(&positional->coneInnerAngle, err, o, "coneInnerAngle",
+                      false);
+  ParseNumberProperty(&positional->coneOuterAngle, err, o, "coneOuterAngle",
+                      false);
+  ParseNumberProperty(&positional->coneOuterGain, err, o, "coneOuterGain",
+                      false);
+  ParseNumberProperty(&positional->maxDistance, err, o, "maxDistance", false);
+  ParseNumberProperty(&positional->refDistance, err, o, "refDistance", false);
+  ParseNumberProperty(&positional->rolloffFactor, err, o, "rolloffFactor",
+                      false);
 
-  return ret;
+  ParseExtrasAndExtensions(positional, err, o,
+                           store_original_json_for_extras_and_extensions);
+
+  return true;
 }
 
-std::string ExpandFilePath(const std::string &filepath, void *) {
-  // https://github.com/syoyo/tinygltf/issues/368
-  //
-  // No file path expansion in built-in FS function anymore, since glTF URI
-  // should not contain tilde('~') and environment variables, and for security
-  // reason(`wordexp`).
-  //
-  // Users need to supply `base_dir`(in `LoadASCIIFromString`,
-  // `LoadBinaryFromMemory`) in expanded absolute path.
+static bool ParseAudioEmitter(
+    AudioEmitter *emitter, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  if (!ParseStringProperty(&emitter->type, err, o, "type", true)) {
+    return false;
+  }
 
-  return filepath;
+  if (emitter->type == "positional") {
+    detail::json_const_iterator positionalIt;
+    if (!detail::FindMember(o, "positional", positionalIt)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "Positional emitter description not found." << std::endl;
+        (*err) += ss.str();
+      }
+      return false;
+    }
 
-#if 0
-#ifdef _WIN32
-  // Assume input `filepath` is encoded in UTF-8
-  std::wstring wfilepath = UTF8ToWchar(filepath);
-  DWORD wlen = ExpandEnvironmentStringsW(wfilepath.c_str(), nullptr, 0);
-  wchar_t *wstr = new wchar_t[wlen];
-  ExpandEnvironmentStringsW(wfilepath.c_str(), wstr, wlen);
+    const detail::json &v = detail::GetValue(positionalIt);
+    if (!detail::IsObject(v)) {
+      if (err) {
+        std::stringstream ss;
+        ss << "\"positional\" is not a JSON object." << std::endl;
+        (*err) += ss.str();
+      }
+      return false;
+    }
 
-  std::wstring ws(wstr);
-  delete[] wstr;
-  return WcharToUTF8(ws);
+    if (!ParsePositionalEmitter(
+            &emitter->positional, err, v,
+            store_original_json_for_extras_and_extensions)) {
+      return false;
+    }
+  }
 
-#else
+  ParseStringProperty(&emitter->name, err, o, "name", false);
+  ParseNumberProperty(&emitter->gain, err, o, "gain", false);
+  ParseBooleanProperty(&emitter->loop, err, o, "loop", false);
+  ParseBooleanProperty(&emitter->playing, err, o, "playing", false);
+  ParseStringProperty(&emitter->distanceModel, err, o, "distanceModel", false);
+  ParseIntegerProperty(&emitter->source, err, o, "source", true);
 
-#if defined(TARGET_OS_IPHONE) || defined(TARGET_IPHONE_SIMULATOR) || \
-    defined(__ANDROID__) || defined(__EMSCRIPTEN__) || defined(__OpenBSD__)
-  // no expansion
-  std::string s = filepath;
-#else
-  std::string s;
-  wordexp_t p;
+  ParseExtrasAndExtensions(emitter, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  if (filepath.empty()) {
-    return "";
-  }
+  return true;
+}
 
-  // Quote the string to keep any spaces in filepath intact.
-  std::string quoted_path = "\"" + filepath + "\"";
-  // char** w;
-  int ret = wordexp(quoted_path.c_str(), &p, 0);
-  if (ret) {
-    // err
-    s = filepath;
-    return s;
-  }
+static bool ParseAudioSource(
+    AudioSource *source, std::string *err, const detail::json &o,
+    bool store_original_json_for_extras_and_extensions) {
+  ParseStringProperty(&source->name, err, o, "name", false);
+  ParseStringProperty(&source->uri, err, o, "uri", false);
 
-  // Use first element only.
-  if (p.we_wordv) {
-    s = std::string(p.we_wordv[0]);
-    wordfree(&p);
-  } else {
-    s = filepath;
+  if (source->uri.empty()) {
+    ParseIntegerProperty(&source->bufferView, err, o, "bufferView", true);
+    ParseStringProperty(&source->mimeType, err, o, "mimeType", true);
   }
 
-#endif
+  ParseExtrasAndExtensions(source, err, o,
+                           store_original_json_for_extras_and_extensions);
 
-  return s;
-#endif
-#endif
+  return true;
 }
 
-bool GetFileSizeInBytes(size_t *filesize_out, std::string *err,
-                        const std::string &filepath, void *userdata) {
-  (void)userdata;
+namespace detail {
 
-#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
-  if (asset_manager) {
-    AAsset *asset = AAssetManager_open(asset_manager, filepath.c_str(),
-                                       AASSET_MODE_STREAMING);
-    if (!asset) {
-      if (err) {
-        (*err) += "File open error : " + filepath + "\n";
-      }
-      return false;
+template <typename Callback>
+bool ForEachInArray(const detail::json &_v, const char *member, Callback &&cb) {
+  detail::json_const_iterator itm;
+  if (detail::FindMember(_v, member, itm) &&
+      detail::IsArray(detail::GetValue(itm))) {
+    const detail::json &root = detail::GetValue(itm);
+    auto it = detail::ArrayBegin(root);
+    auto end = detail::ArrayEnd(root);
+    for (; it != end; ++it) {
+      if (!cb(*it)) return false;
     }
-    size_t size = AAsset_getLength(asset);
+  }
+  return true;
+};
 
-    if (size == 0) {
-      if (err) {
-        (*err) += "Invalid file size : " + filepath +
-                  " (does the path point to a directory?)";
-      }
-      return false;
+}  // end of namespace detail
+
+bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
+                              const char *json_str,
+                              unsigned int json_str_length,
+                              const std::string &base_dir,
+                              unsigned int check_sections) {
+  if (json_str_length < 4) {
+    if (err) {
+      (*err) = "JSON string too short.\n";
     }
+    return false;
+  }
 
-    return true;
-  } else {
+  detail::JsonDocument v;
+
+#if (defined(__cpp_exceptions) || defined(__EXCEPTIONS) || \
+     defined(_CPPUNWIND)) &&                               \
+    !defined(TINYGLTF_NOEXCEPTION)
+  try {
+    detail::JsonParse(v, json_str, json_str_length, true);
+
+  } catch (const std::exception &e) {
     if (err) {
-      (*err) += "No asset manager specified : " + filepath + "\n";
+      (*err) = e.what();
     }
     return false;
   }
 #else
-#ifdef _WIN32
-#if defined(__GLIBCXX__)  // mingw
-  int file_descriptor =
-      _wopen(UTF8ToWchar(filepath).c_str(), _O_RDONLY | _O_BINARY);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(file_descriptor, std::ios_base::in);
-  std::istream f(&wfile_buf);
-#elif defined(_MSC_VER) || defined(_LIBCPP_VERSION)
-  // For libcxx, assume _LIBCPP_HAS_OPEN_WITH_WCHAR is defined to accept
-  // `wchar_t *`
-  std::ifstream f(UTF8ToWchar(filepath).c_str(), std::ifstream::binary);
-#else
-  // Unknown compiler/runtime
-  std::ifstream f(filepath.c_str(), std::ifstream::binary);
-#endif
-#else
-  std::ifstream f(filepath.c_str(), std::ifstream::binary);
+  {
+    detail::JsonParse(v, json_str, json_str_length);
+
+    if (!detail::IsObject(v)) {
+      // Assume parsing was failed.
+      if (err) {
+        (*err) = "Failed to parse JSON object\n";
+      }
+      return false;
+    }
+  }
 #endif
-  if (!f) {
+
+  if (!detail::IsObject(v)) {
+    // root is not an object.
     if (err) {
-      (*err) += "File open error : " + filepath + "\n";
+      (*err) = "Root element is not a JSON object\n";
     }
     return false;
   }
 
-  // For directory(and pipe?), peek() will fail(Posix gnustl/libc++ only)
-  f.peek();
-  if (!f) {
-    if (err) {
-      (*err) +=
-          "File read error. Maybe empty file or invalid file : " + filepath +
-          "\n";
+  {
+    bool version_found = false;
+    detail::json_const_iterator it;
+    if (detail::FindMember(v, "asset", it) &&
+        detail::IsObject(detail::GetValue(it))) {
+      auto &itObj = detail::GetValue(it);
+      detail::json_const_iterator version_it;
+      std::string versionStr;
+      if (detail::FindMember(itObj, "version", version_it) &&
+          detail::GetString(detail::GetValue(version_it), versionStr)) {
+        version_found = true;
+      }
+    }
+    if (version_found) {
+      // OK
+    } else if (check_sections & REQUIRE_VERSION) {
+      if (err) {
+        (*err) += "\"asset\" object not found in .gltf or not an object type\n";
+      }
+      return false;
     }
-    return false;
   }
 
-  f.seekg(0, f.end);
-  const auto sz = f.tellg();
+  // scene is not mandatory.
+  // FIXME Maybe a better way to handle it than removing the code
 
-  // std::cout << "sz = " << sz << "\n";
-  f.seekg(0, f.beg);
+  auto IsArrayMemberPresent = [](const detail::json &_v,
+                                 const char *name) -> bool {
+    detail::json_const_iterator it;
+    return detail::FindMember(_v, name, it) &&
+           detail::IsArray(detail::GetValue(it));
+  };
 
-  if (sz < 0) {
-    if (err) {
-      (*err) += "Invalid file size : " + filepath +
-                " (does the path point to a directory?)";
-    }
-    return false;
-  } else if (sz == std::streamoff(0)) {
-    if (err) {
-      (*err) += "File is empty : " + filepath + "\n";
-    }
-    return false;
-  } else if (sz >= (std::numeric_limits<std::streamoff>::max)()) {
-    if (err) {
-      (*err) += "Invalid file size : " + filepath + "\n";
+  {
+    if ((check_sections & REQUIRE_SCENES) &&
+        !IsArrayMemberPresent(v, "scenes")) {
+      if (err) {
+        (*err) += "\"scenes\" object not found in .gltf or not an array type\n";
+      }
+      return false;
     }
-    return false;
   }
 
-  (*filesize_out) = static_cast<size_t>(sz);
-  return true;
-#endif
-}
+  {
+    if ((check_sections & REQUIRE_NODES) && !IsArrayMemberPresent(v, "nodes")) {
+      if (err) {
+        (*err) += "\"nodes\" object not found in .gltf\n";
+      }
+      return false;
+    }
+  }
 
-bool ReadWholeFile(std::vector<unsigned char> *out, std::string *err,
-                   const std::string &filepath, void *) {
-#ifdef TINYGLTF_ANDROID_LOAD_FROM_ASSETS
-  if (asset_manager) {
-    AAsset *asset = AAssetManager_open(asset_manager, filepath.c_str(),
-                                       AASSET_MODE_STREAMING);
-    if (!asset) {
+  {
+    if ((check_sections & REQUIRE_ACCESSORS) &&
+        !IsArrayMemberPresent(v, "accessors")) {
       if (err) {
-        (*err) += "File open error : " + filepath + "\n";
+        (*err) += "\"accessors\" object not found in .gltf\n";
       }
       return false;
     }
-    size_t size = AAsset_getLength(asset);
-    if (size == 0) {
+  }
+
+  {
+    if ((check_sections & REQUIRE_BUFFERS) &&
+        !IsArrayMemberPresent(v, "buffers")) {
       if (err) {
-        (*err) += "Invalid file size : " + filepath +
-                  " (does the path point to a directory?)";
+        (*err) += "\"buffers\" object not found in .gltf\n";
       }
       return false;
     }
-    out->resize(static_cast<size_t>(size));
-    AAsset_read(asset, reinterpret_cast<char *>(&out->at(0)), size);
-    AAsset_close(asset);
-    return true;
-  } else {
-    if (err) {
-      (*err) += "No asset manager specified : " + filepath + "\n";
+  }
+
+  {
+    if ((check_sections & REQUIRE_BUFFER_VIEWS) &&
+        !IsArrayMemberPresent(v, "bufferViews")) {
+      if (err) {
+        (*err) += "\"bufferViews\" object not found in .gltf\n";
+      }
+      return false;
     }
-    return false;
   }
-#else
-#ifdef _WIN32
-#if defined(__GLIBCXX__)  // mingw
-  int file_descriptor =
-      _wopen(UTF8ToWchar(filepath).c_str(), _O_RDONLY | _O_BINARY);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(file_descriptor, std::ios_base::in);
-  std::istream f(&wfile_buf);
-#elif defined(_MSC_VER) || defined(_LIBCPP_VERSION)
-  // For libcxx, assume _LIBCPP_HAS_OPEN_WITH_WCHAR is defined to accept
-  // `wchar_t *`
-  std::ifstream f(UTF8ToWchar(filepath).c_str(), std::ifstream::binary);
-#else
-  // Unknown compiler/runtime
-  std::ifstream f(filepath.c_str(), std::ifstream::binary);
-#endif
-#else
-  std::ifstream f(filepath.c_str(), std::ifstream::binary);
-#endif
-  if (!f) {
-    if (err) {
-      (*err) += "File open error : " + filepath + "\n";
+
+  // Reset the model
+  (*model) = Model();
+
+  // 1. Parse Asset
+  {
+    detail::json_const_iterator it;
+    if (detail::FindMember(v, "asset", it) &&
+        detail::IsObject(detail::GetValue(it))) {
+      const detail::json &root = detail::GetValue(it);
+
+      ParseAsset(&model->asset, err, root,
+                 store_original_json_for_extras_and_extensions_);
     }
-    return false;
   }
 
-  // For directory(and pipe?), peek() will fail(Posix gnustl/libc++ only)
-  f.peek();
-  if (!f) {
-    if (err) {
-      (*err) +=
-          "File read error. Maybe empty file or invalid file : " + filepath +
-          "\n";
-    }
-    return false;
+  using detail::ForEachInArray;
+
+  // 2. Parse extensionUsed
+  {
+    ForEachInArray(v, "extensionsUsed", [&](const detail::json &o) {
+      std::string str;
+      detail::GetString(o, str);
+      model->extensionsUsed.emplace_back(std::move(str));
+      return true;
+    });
+  }
+
+  {
+    ForEachInArray(v, "extensionsRequired", [&](const detail::json &o) {
+      std::string str;
+      detail::GetString(o, str);
+      model->extensionsRequired.emplace_back(std::move(str));
+      return true;
+    });
   }
 
-  f.seekg(0, f.end);
-  const auto sz = f.tellg();
+  // 3. Parse Buffer
+  {
+    bool success = ForEachInArray(v, "buffers", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`buffers' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Buffer buffer;
+      if (!ParseBuffer(&buffer, err, o,
+                       store_original_json_for_extras_and_extensions_, &fs,
+                       &uri_cb, base_dir, max_external_file_size_, is_binary_,
+                       bin_data_, bin_size_)) {
+        return false;
+      }
 
-  // std::cout << "sz = " << sz << "\n";
-  f.seekg(0, f.beg);
+      model->buffers.emplace_back(std::move(buffer));
+      return true;
+    });
 
-  if (sz < 0) {
-    if (err) {
-      (*err) += "Invalid file size : " + filepath +
-                " (does the path point to a directory?)";
-    }
-    return false;
-  } else if (sz == std::streamoff(0)) {
-    if (err) {
-      (*err) += "File is empty : " + filepath + "\n";
-    }
-    return false;
-  } else if (sz >= (std::numeric_limits<std::streamoff>::max)()) {
-    if (err) {
-      (*err) += "Invalid file size : " + filepath + "\n";
+    if (!success) {
+      return false;
     }
-    return false;
   }
+  // 4. Parse BufferView
+  {
+    bool success = ForEachInArray(v, "bufferViews", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`bufferViews' does not contain an JSON object.";
+        }
+        return false;
+      }
+      BufferView bufferView;
+      if (!ParseBufferView(&bufferView, err, o,
+                           store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-  out->resize(sz);
-  f.read(reinterpret_cast<char *>(&out->at(0)),
-         static_cast<std::streamsize>(sz));
-
-  return true;
-#endif
-}
+      model->bufferViews.emplace_back(std::move(bufferView));
+      return true;
+    });
 
-bool WriteWholeFile(std::string *err, const std::string &filepath,
-                    const std::vector<unsigned char> &contents, void *) {
-#ifdef _WIN32
-#if defined(__GLIBCXX__)  // mingw
-  int file_descriptor = _wopen(UTF8ToWchar(filepath).c_str(),
-                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(
-      file_descriptor, std::ios_base::out | std::ios_base::binary);
-  std::ostream f(&wfile_buf);
-#elif defined(_MSC_VER)
-  std::ofstream f(UTF8ToWchar(filepath).c_str(), std::ofstream::binary);
-#else  // clang?
-  std::ofstream f(filepath.c_str(), std::ofstream::binary);
-#endif
-#else
-  std::ofstream f(filepath.c_str(), std::ofstream::binary);
-#endif
-  if (!f) {
-    if (err) {
-      (*err) += "File open error for writing : " + filepath + "\n";
+    if (!success) {
+      return false;
     }
-    return false;
   }
 
-  f.write(reinterpret_cast<const char *>(&contents.at(0)),
-          static_cast<std::streamsize>(contents.size()));
-  if (!f) {
-    if (err) {
-      (*err) += "File write error: " + filepath + "\n";
-    }
+#ifdef TINYGLTF_ENABLE_MESHOPT
+  // 4.1 Decode EXT_meshopt_compression bufferViews
+  if (!DecodeMeshoptCompression(model, err, geometry_decode_threads_,
+                                &geometry_cache_)) {
     return false;
   }
+#endif
 
-  return true;
-}
+  // 5. Parse Accessor
+  {
+    bool success = ForEachInArray(v, "accessors", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`accessors' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Accessor accessor;
+      if (!ParseAccessor(&accessor, err, o,
+                         store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-#endif  // TINYGLTF_NO_FS
+      model->accessors.emplace_back(std::move(accessor));
+      return true;
+    });
 
-static std::string MimeToExt(const std::string &mimeType) {
-  if (mimeType == "image/jpeg") {
-    return "jpg";
-  } else if (mimeType == "image/png") {
-    return "png";
-  } else if (mimeType == "image/bmp") {
-    return "bmp";
-  } else if (mimeType == "image/gif") {
-    return "gif";
+    if (!success) {
+      return false;
+    }
   }
 
-  return "";
-}
+  // 6. Parse Mesh
+  {
+    bool success = ForEachInArray(v, "meshes", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`meshes' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Mesh mesh;
+      if (!ParseMesh(&mesh, model, err, warn, o,
+                     store_original_json_for_extras_and_extensions_,
+                     strictness_)) {
+        return false;
+      }
 
-static bool UpdateImageObject(const Image &image, std::string &baseDir,
-                              int index, bool embedImages,
-                              const FsCallbacks *fs_cb,
-                              const URICallbacks *uri_cb,
-                              const WriteImageDataFunction& WriteImageData,
-                              void *user_data, std::string *out_uri) {
-  std::string filename;
-  std::string ext;
-  // If image has uri, use it as a filename
-  if (image.uri.size()) {
-    std::string decoded_uri;
-    if (!uri_cb->decode(image.uri, &decoded_uri, uri_cb->user_data)) {
-      // A decode failure results in a failure to write the gltf.
+      model->meshes.emplace_back(std::move(mesh));
+      return true;
+    });
+
+    if (!success) {
       return false;
     }
-    filename = GetBaseFilename(decoded_uri);
-    ext = GetFilePathExtension(filename);
-  } else if (image.bufferView != -1) {
-    // If there's no URI and the data exists in a buffer,
-    // don't change properties or write images
-  } else if (image.name.size()) {
-    ext = MimeToExt(image.mimeType);
-    // Otherwise use name as filename
-    filename = image.name + "." + ext;
-  } else {
-    ext = MimeToExt(image.mimeType);
-    // Fallback to index of image as filename
-    filename = std::to_string(index) + "." + ext;
   }
 
-  // If callback is set, modify image data object.
-  // Note that the callback is also invoked for images without data.
-  // The default callback implementation simply returns true for
-  // empty images and sets the out URI to filename.
-  bool imageWritten = false;
-  if (WriteImageData != nullptr && !filename.empty()) {
-    imageWritten = WriteImageData(&baseDir, &filename, &image, embedImages,
-                                  fs_cb, uri_cb, out_uri, user_data);
-    if (!imageWritten) {
-      return false;
+#ifdef TINYGLTF_ENABLE_DRACO
+  // 6.1 Decode KHR_draco_mesh_compression primitives
+  if (!DecodeDracoPrimitives(model, err, warn, strictness_, &geometry_cache_,
+                             geometry_decode_threads_)) {
+    return false;
+  }
+#endif
+
+  // Assign missing bufferView target types
+  // - Look for missing Mesh indices
+  // - Look for missing Mesh attributes
+  for (auto &mesh : model->meshes) {
+    for (auto &primitive : mesh.primitives) {
+      if (primitive.indices >
+          -1)  // has indices from parsing step, must be Element Array Buffer
+      {
+        if (size_t(primitive.indices) >= model->accessors.size()) {
+          if (err) {
+            (*err) += "primitive indices accessor out of bounds";
+          }
+          return false;
+        }
+
+        const auto bufferView =
+            model->accessors[size_t(primitive.indices)].bufferView;
+        if (bufferView < 0) {
+          // skip, bufferView could be null(-1) for certain extensions
+        } else if (size_t(bufferView) >= model->bufferViews.size()) {
+          if (err) {
+            (*err) += "accessor[" + std::to_string(primitive.indices) +
+                      "] invalid bufferView";
+          }
+          return false;
+        } else {
+          model->bufferViews[size_t(bufferView)].target =
+              TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+          // we could optionally check if accessors' bufferView type is Scalar, as
+          // it should be
+        }
+      }
+
+      for (auto &attribute : primitive.attributes) {
+        const auto accessorsIndex = size_t(attribute.second);
+        if (accessorsIndex < model->accessors.size()) {
+          const auto bufferView = model->accessors[accessorsIndex].bufferView;
+          // bufferView could be null(-1) for sparse morph target
+          if (bufferView >= 0 && bufferView < (int)model->bufferViews.size()) {
+            model->bufferViews[size_t(bufferView)].target =
+                TINYGLTF_TARGET_ARRAY_BUFFER;
+          }
+        }
+      }
+
+      for (auto &target : primitive.targets) {
+        for (auto &attribute : target) {
+          const auto accessorsIndex = size_t(attribute.second);
+          if (accessorsIndex < model->accessors.size()) {
+            const auto bufferView = model->accessors[accessorsIndex].bufferView;
+            // bufferView could be null(-1) for sparse morph target
+            if (bufferView >= 0 &&
+                bufferView < (int)model->bufferViews.size()) {
+              model->bufferViews[size_t(bufferView)].target =
+                  TINYGLTF_TARGET_ARRAY_BUFFER;
+            }
+          }
+        }
+      }
     }
   }
 
-  // Use the original uri if the image was not written.
-  if (!imageWritten) {
-    *out_uri = image.uri;
-  }
+  // 7. Parse Node
+  {
+    bool success = ForEachInArray(v, "nodes", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`nodes' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Node node;
+      if (!ParseNode(&node, err, o,
+                     store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-  return true;
-}
+      model->nodes.emplace_back(std::move(node));
+      return true;
+    });
 
-bool IsDataURI(const std::string &in) {
-  std::string header = "data:application/octet-stream;base64,";
-  if (in.find(header) == 0) {
-    return true;
+    if (!success) {
+      return false;
+    }
   }
 
-  header = "data:image/jpeg;base64,";
-  if (in.find(header) == 0) {
-    return true;
-  }
+  // 8. Parse scenes.
+  {
+    bool success = ForEachInArray(v, "scenes", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`scenes' does not contain an JSON object.";
+        }
+        return false;
+      }
 
-  header = "data:image/png;base64,";
-  if (in.find(header) == 0) {
-    return true;
-  }
+      Scene scene;
+      if (!ParseScene(&scene, err, o,
+                      store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-  header = "data:image/bmp;base64,";
-  if (in.find(header) == 0) {
-    return true;
-  }
+      model->scenes.emplace_back(std::move(scene));
+      return true;
+    });
 
-  header = "data:image/gif;base64,";
-  if (in.find(header) == 0) {
-    return true;
+    if (!success) {
+      return false;
+    }
   }
 
-  header = "data:text/plain;base64,";
-  if (in.find(header) == 0) {
-    return true;
+  // 9. Parse default scenes.
+  {
+    detail::json_const_iterator rootIt;
+    int iVal;
+    if (detail::FindMember(v, "scene", rootIt) &&
+        detail::GetInt(detail::GetValue(rootIt), iVal)) {
+      model->defaultScene = iVal;
+    }
   }
 
-  header = "data:application/gltf-buffer;base64,";
-  if (in.find(header) == 0) {
-    return true;
-  }
+  // 10. Parse Material
+  {
+    bool success = ForEachInArray(v, "materials", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`materials' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Material material;
+      ParseStringProperty(&material.name, err, o, "name", false);
 
-  return false;
-}
+      if (!ParseMaterial(&material, err, warn, o,
+                         store_original_json_for_extras_and_extensions_,
+                         strictness_)) {
+        return false;
+      }
 
-bool DecodeDataURI(std::vector<unsigned char> *out, std::string &mime_type,
-                   const std::string &in, size_t reqBytes, bool checkSize) {
-  std::string header = "data:application/octet-stream;base64,";
-  std::string data;
-  if (in.find(header) == 0) {
-    data = base64_decode(in.substr(header.size()));  // cut mime string.
-  }
+      model->materials.emplace_back(std::move(material));
+      return true;
+    });
 
-  if (data.empty()) {
-    header = "data:image/jpeg;base64,";
-    if (in.find(header) == 0) {
-      mime_type = "image/jpeg";
-      data = base64_decode(in.substr(header.size()));  // cut mime string.
+    if (!success) {
+      return false;
     }
   }
 
-  if (data.empty()) {
-    header = "data:image/png;base64,";
-    if (in.find(header) == 0) {
-      mime_type = "image/png";
-      data = base64_decode(in.substr(header.size()));  // cut mime string.
-    }
-  }
+  // 11. Parse Image
+  void *load_image_user_data{nullptr};
 
-  if (data.empty()) {
-    header = "data:image/bmp;base64,";
-    if (in.find(header) == 0) {
-      mime_type = "image/bmp";
-      data = base64_decode(in.substr(header.size()));  // cut mime string.
-    }
-  }
+  LoadImageDataOption load_image_option;
+  bool adopt_as_is_data = false;
+  size_t header_probe_bytes = 0;
 
-  if (data.empty()) {
-    header = "data:image/gif;base64,";
-    if (in.find(header) == 0) {
-      mime_type = "image/gif";
-      data = base64_decode(in.substr(header.size()));  // cut mime string.
+  if (user_image_loader_) {
+    // Use user supplied pointer
+    load_image_user_data = load_image_user_data_;
+  } else {
+    adopt_as_is_data = images_as_is_ && !images_header_only_;
+    if (images_header_only_) {
+      // Enough for the header of common image formats, including JPEG files
+      // with EXIF/ICC data in front of the frame header.
+      header_probe_bytes = 64 * 1024;
     }
-  }
-
-  if (data.empty()) {
-    header = "data:text/plain;base64,";
-    if (in.find(header) == 0) {
-      mime_type = "text/plain";
-      data = base64_decode(in.substr(header.size()));
+    load_image_option.header_only = images_header_only_;
+    load_image_option.preserve_channels = preserve_image_channels_;
+    load_image_option.as_is = images_as_is_;
+    load_image_option.max_image_dimension = max_image_dimension_;
+    load_image_option.target_components = image_target_components_;
+    load_image_option.decoders = &image_decoders_;
+    load_image_option.target_pixel_type = image_target_pixel_type_;
+    load_image_option.target_bits = image_target_bits_;
+    load_image_option.srgb_to_linear = image_srgb_to_linear_;
+    if (image_srgb_to_linear_) {
+      // Color textures are sRGB encoded. Textures are parsed after images, so
+      // look up their `source` in JSON.
+      std::vector<int> texture_sources;
+      ForEachInArray(v, "textures", [&](const detail::json &o) {
+        int source = -1;
+        if (detail::IsObject(o)) {
+          ParseIntegerProperty(&source, nullptr, o, "source", false);
+        }
+        texture_sources.push_back(source);
+        return true;
+      });
+      std::vector<bool> &srgb_images = load_image_option.srgb_images;
+      auto mark_srgb = [&](int texture) {
+        if ((texture < 0) || (size_t(texture) >= texture_sources.size())) {
+          return;
+        }
+        const int source = texture_sources[size_t(texture)];
+        if (source < 0) {
+          return;
+        }
+        if (size_t(source) >= srgb_images.size()) {
+          srgb_images.resize(size_t(source) + 1, false);
+        }
+        srgb_images[size_t(source)] = true;
+      };
+      for (const Material &material : model->materials) {
+        mark_srgb(material.pbrMetallicRoughness.baseColorTexture.index);
+        mark_srgb(material.emissiveTexture.index);
+      }
     }
+    load_image_user_data = reinterpret_cast<void *>(&load_image_option);
   }
 
-  if (data.empty()) {
-    header = "data:application/gltf-buffer;base64,";
-    if (in.find(header) == 0) {
-      data = base64_decode(in.substr(header.size()));
+  {
+    int idx = 0;
+    bool success = ForEachInArray(v, "images", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "image[" + std::to_string(idx) + "] is not a JSON object.";
+        }
+        return false;
+      }
+      Image image;
+      // Images from uri are read into a temporary buffer owned by ParseImage,
+      // which is adopted instead of copied in as-is mode.
+      load_image_option.as_is_no_copy = adopt_as_is_data;
+      if (!ParseImage(&image, idx, err, warn, o,
+                      store_original_json_for_extras_and_extensions_, base_dir,
+                      max_external_file_size_, &fs, &uri_cb,
+                      this->LoadImageData, load_image_user_data,
+                      adopt_as_is_data, header_probe_bytes)) {
+        return false;
+      }
+
+      if (image.bufferView != -1) {
+        // Load image from the buffer view.
+        if (size_t(image.bufferView) >= model->bufferViews.size()) {
+          if (err) {
+            std::stringstream ss;
+            ss << "image[" << idx << "] bufferView \"" << image.bufferView
+               << "\" not found in the scene." << std::endl;
+            (*err) += ss.str();
+          }
+          return false;
+        }
+
+        const BufferView &bufferView =
+            model->bufferViews[size_t(image.bufferView)];
+        if (size_t(bufferView.buffer) >= model->buffers.size()) {
+          if (err) {
+            std::stringstream ss;
+            ss << "image[" << idx << "] buffer \"" << bufferView.buffer
+               << "\" not found in the scene." << std::endl;
+            (*err) += ss.str();
+          }
+          return false;
+        }
+        const Buffer &buffer = model->buffers[size_t(bufferView.buffer)];
+
+        if (LoadImageData == nullptr) {
+          if (err) {
+            (*err) += "No LoadImageData callback specified.\n";
+          }
+          return false;
+        }
+        load_image_option.as_is_no_copy = images_as_is_borrow_buffer_view_;
+        bool ret = LoadImageData(
+            &image, idx, err, warn, image.width, image.height,
+            &buffer.data[bufferView.byteOffset],
+            static_cast<int>(bufferView.byteLength), load_image_user_data);
+        if (!ret) {
+          return false;
+        }
+      }
+
+      model->images.emplace_back(std::move(image));
+      ++idx;
+      return true;
+    });
+
+    if (!success) {
+      return false;
     }
   }
 
-  // TODO(syoyo): Allow empty buffer? #229
-  if (data.empty()) {
-    return false;
-  }
+  // 12. Parse Texture
+  {
+    bool success = ForEachInArray(v, "textures", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`textures' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Texture texture;
+      if (!ParseTexture(&texture, err, o,
+                        store_original_json_for_extras_and_extensions_,
+                        base_dir)) {
+        return false;
+      }
 
-  if (checkSize) {
-    if (data.size() != reqBytes) {
+      model->textures.emplace_back(std::move(texture));
+      return true;
+    });
+
+    if (!success) {
       return false;
     }
-    out->resize(reqBytes);
-  } else {
-    out->resize(data.size());
   }
-  std::copy(data.begin(), data.end(), out->begin());
-  return true;
-}
 
-namespace detail {
-bool GetInt(const detail::json &o, int &val) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (!o.IsDouble()) {
-    if (o.IsInt()) {
-      val = o.GetInt();
-      return true;
-    } else if (o.IsUint()) {
-      val = static_cast<int>(o.GetUint());
-      return true;
-    } else if (o.IsInt64()) {
-      val = static_cast<int>(o.GetInt64());
-      return true;
-    } else if (o.IsUint64()) {
-      val = static_cast<int>(o.GetUint64());
+  // 13. Parse Animation
+  {
+    bool success = ForEachInArray(v, "animations", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`animations' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Animation animation;
+      if (!ParseAnimation(&animation, err, o,
+                          store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
+
+      model->animations.emplace_back(std::move(animation));
       return true;
+    });
+
+    if (!success) {
+      return false;
     }
   }
 
-  return false;
-#else
-  auto type = o.type();
+  // 14. Parse Skin
+  {
+    bool success = ForEachInArray(v, "skins", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`skins' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Skin skin;
+      if (!ParseSkin(&skin, err, o,
+                     store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-  if ((type == detail::json::value_t::number_integer) ||
-      (type == detail::json::value_t::number_unsigned)) {
-    val = static_cast<int>(o.get<int64_t>());
-    return true;
+      model->skins.emplace_back(std::move(skin));
+      return true;
+    });
+
+    if (!success) {
+      return false;
+    }
   }
 
-  return false;
-#endif
-}
+  // 15. Parse Sampler
+  {
+    bool success = ForEachInArray(v, "samplers", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`samplers' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Sampler sampler;
+      if (!ParseSampler(&sampler, err, o,
+                        store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-#ifdef TINYGLTF_USE_RAPIDJSON
-bool GetDouble(const detail::json &o, double &val) {
-  if (o.IsDouble()) {
-    val = o.GetDouble();
-    return true;
+      model->samplers.emplace_back(std::move(sampler));
+      return true;
+    });
+
+    if (!success) {
+      return false;
+    }
   }
 
-  return false;
-}
-#endif
+  // 16. Parse Camera
+  {
+    bool success = ForEachInArray(v, "cameras", [&](const detail::json &o) {
+      if (!detail::IsObject(o)) {
+        if (err) {
+          (*err) += "`cameras' does not contain an JSON object.";
+        }
+        return false;
+      }
+      Camera camera;
+      if (!ParseCamera(&camera, err, o,
+                       store_original_json_for_extras_and_extensions_)) {
+        return false;
+      }
 
-bool GetNumber(const detail::json &o, double &val) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (o.IsNumber()) {
-    val = o.GetDouble();
-    return true;
-  }
+      model->cameras.emplace_back(std::move(camera));
+      return true;
+    });
 
-  return false;
-#else
-  if (o.is_number()) {
-    val = o.get<double>();
-    return true;
+    if (!success) {
+      return false;
+    }
   }
 
-  return false;
-#endif
-}
+  // 17. Parse Extras & Extensions
+  ParseExtrasAndExtensions(model, err, v,
+                           store_original_json_for_extras_and_extensions_);
 
-bool GetString(const detail::json &o, std::string &val) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (o.IsString()) {
-    val = o.GetString();
-    return true;
-  }
+  // 18. Specific extension implementations
+  {
+    detail::json_const_iterator rootIt;
+    if (detail::FindMember(v, "extensions", rootIt) &&
+        detail::IsObject(detail::GetValue(rootIt))) {
+      const detail::json &root = detail::GetValue(rootIt);
 
-  return false;
-#else
-  if (o.type() == detail::json::value_t::string) {
-    val = o.get<std::string>();
-    return true;
-  }
+      detail::json_const_iterator it(detail::ObjectBegin(root));
+      detail::json_const_iterator itEnd(detail::ObjectEnd(root));
+      for (; it != itEnd; ++it) {
+        // parse KHR_lights_punctual extension
+        std::string key(detail::GetKey(it));
+        if ((key == "KHR_lights_punctual") &&
+            detail::IsObject(detail::GetValue(it))) {
+          const detail::json &object = detail::GetValue(it);
+          detail::json_const_iterator itLight;
+          if (detail::FindMember(object, "lights", itLight)) {
+            const detail::json &lights = detail::GetValue(itLight);
+            if (!detail::IsArray(lights)) {
+              continue;
+            }
 
-  return false;
-#endif
-}
+            auto arrayIt(detail::ArrayBegin(lights));
+            auto arrayItEnd(detail::ArrayEnd(lights));
+            for (; arrayIt != arrayItEnd; ++arrayIt) {
+              Light light;
+              if (!ParseLight(&light, err, *arrayIt,
+                              store_original_json_for_extras_and_extensions_)) {
+                return false;
+              }
+              model->lights.emplace_back(std::move(light));
+            }
+          }
+        }
+        // parse KHR_audio extension
+        if ((key == "KHR_audio") && detail::IsObject(detail::GetValue(it))) {
+          const detail::json &object = detail::GetValue(it);
+          detail::json_const_iterator itKhrAudio;
+          if (detail::FindMember(object, "emitters", itKhrAudio)) {
+            const detail::json &emitters = detail::GetValue(itKhrAudio);
+            if (!detail::IsArray(emitters)) {
+              continue;
+            }
 
-bool IsArray(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.IsArray();
-#else
-  return o.is_array();
-#endif
-}
+            auto arrayIt(detail::ArrayBegin(emitters));
+            auto arrayItEnd(detail::ArrayEnd(emitters));
+            for (; arrayIt != arrayItEnd; ++arrayIt) {
+              AudioEmitter emitter;
+              if (!ParseAudioEmitter(
+                      &emitter, err, *arrayIt,
+                      store_original_json_for_extras_and_extensions_)) {
+                return false;
+              }
+              model->audioEmitters.emplace_back(std::move(emitter));
+            }
+          }
 
-detail::json_const_array_iterator ArrayBegin(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.Begin();
-#else
-  return o.begin();
-#endif
-}
+          if (detail::FindMember(object, "sources", itKhrAudio)) {
+            const detail::json &sources = detail::GetValue(itKhrAudio);
+            if (!detail::IsArray(sources)) {
+              continue;
+            }
 
-detail::json_const_array_iterator ArrayEnd(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.End();
-#else
-  return o.end();
-#endif
-}
+            auto arrayIt(detail::ArrayBegin(sources));
+            auto arrayItEnd(detail::ArrayEnd(sources));
+            for (; arrayIt != arrayItEnd; ++arrayIt) {
+              AudioSource source;
+              if (!ParseAudioSource(
+                      &source, err, *arrayIt,
+                      store_original_json_for_extras_and_extensions_)) {
+                return false;
+              }
+              model->audioSources.emplace_back(std::move(source));
+            }
+          }
+        }
+      }
+    }
+  }
 
-bool IsObject(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.IsObject();
-#else
-  return o.is_object();
-#endif
+  return true;
 }
 
-detail::json_const_iterator ObjectBegin(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.MemberBegin();
-#else
-  return o.begin();
-#endif
-}
+bool TinyGLTF::LoadASCIIFromString(Model *model, std::string *err,
+                                   std::string *warn, const char *str,
+                                   unsigned int length,
+                                   const std::string &base_dir,
+                                   unsigned int check_sections) {
+  is_binary_ = false;
+  bin_data_ = nullptr;
+  bin_size_ = 0;
 
-detail::json_const_iterator ObjectEnd(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.MemberEnd();
-#else
-  return o.end();
-#endif
+  return LoadFromString(model, err, warn, str, length, base_dir,
+                        check_sections);
 }
 
-// Making this a const char* results in a pointer to a temporary when
-// TINYGLTF_USE_RAPIDJSON is off.
-std::string GetKey(detail::json_const_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return it->name.GetString();
-#else
-  return it.key().c_str();
-#endif
-}
+bool TinyGLTF::LoadASCIIFromFile(Model *model, std::string *err,
+                                 std::string *warn, const std::string &filename,
+                                 unsigned int check_sections) {
+  std::stringstream ss;
 
-bool FindMember(const detail::json &o, const char *member,
-                detail::json_const_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (!o.IsObject()) {
+  if (fs.ReadWholeFile == nullptr) {
+    // Programmer error, assert() ?
+    ss << "Failed to read file: " << filename
+       << ": one or more FS callback not set" << std::endl;
+    if (err) {
+      (*err) = ss.str();
+    }
     return false;
   }
-  it = o.FindMember(member);
-  return it != o.MemberEnd();
-#else
-  it = o.find(member);
-  return it != o.end();
-#endif
-}
 
-bool FindMember(detail::json &o, const char *member,
-                detail::json_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (!o.IsObject()) {
+  std::vector<unsigned char> data;
+  std::string fileerr;
+  bool fileread = fs.ReadWholeFile(&data, &fileerr, filename, fs.user_data);
+  if (!fileread) {
+    ss << "Failed to read file: " << filename << ": " << fileerr << std::endl;
+    if (err) {
+      (*err) = ss.str();
+    }
     return false;
   }
-  it = o.FindMember(member);
-  return it != o.MemberEnd();
-#else
-  it = o.find(member);
-  return it != o.end();
-#endif
-}
 
-void Erase(detail::json &o, detail::json_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  o.EraseMember(it);
-#else
-  o.erase(it);
-#endif
-}
+  size_t sz = data.size();
+  if (sz == 0) {
+    if (err) {
+      (*err) = "Empty file.";
+    }
+    return false;
+  }
 
-bool IsEmpty(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.ObjectEmpty();
-#else
-  return o.empty();
-#endif
-}
+  std::string basedir = GetBaseDir(filename);
 
-const detail::json &GetValue(detail::json_const_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return it->value;
-#else
-  return it.value();
-#endif
-}
+  bool ret = LoadASCIIFromString(
+      model, err, warn, reinterpret_cast<const char *>(&data.at(0)),
+      static_cast<unsigned int>(data.size()), basedir, check_sections);
 
-detail::json &GetValue(detail::json_iterator &it) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return it->value;
-#else
-  return it.value();
-#endif
+  return ret;
 }
 
-std::string JsonToString(const detail::json &o, int spacing = -1) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  using namespace rapidjson;
-  StringBuffer buffer;
-  if (spacing == -1) {
-    Writer<StringBuffer> writer(buffer);
-    // TODO: Better error handling.
-    // https://github.com/syoyo/tinygltf/issues/332
-    if (!o.Accept(writer)) {
-      return "tiny_gltf::JsonToString() failed rapidjson conversion";
+bool TinyGLTF::LoadBinaryFromMemory(Model *model, std::string *err,
+                                    std::string *warn,
+                                    const unsigned char *bytes,
+                                    unsigned int size,
+                                    const std::string &base_dir,
+                                    unsigned int check_sections) {
+  if (size < 20) {
+    if (err) {
+      (*err) = "Too short data size for glTF Binary.";
     }
+    return false;
+  }
+
+  if (bytes[0] == 'g' && bytes[1] == 'l' && bytes[2] == 'T' &&
+      bytes[3] == 'F') {
+    // ok
   } else {
-    PrettyWriter<StringBuffer> writer(buffer);
-    writer.SetIndent(' ', uint32_t(spacing));
-    if (!o.Accept(writer)) {
-      return "tiny_gltf::JsonToString() failed rapidjson conversion";
+    if (err) {
+      (*err) = "Invalid magic.";
     }
+    return false;
   }
-  return buffer.GetString();
-#else
-  return o.dump(spacing);
-#endif
-}
 
-}  // namespace detail
+  unsigned int version;        // 4 bytes
+  unsigned int length;         // 4 bytes
+  unsigned int chunk0_length;  // 4 bytes
+  unsigned int chunk0_format;  // 4 bytes;
 
-static bool ParseJsonAsValue(Value *ret, const detail::json &o) {
-  Value val{};
-#ifdef TINYGLTF_USE_RAPIDJSON
-  using rapidjson::Type;
-  switch (o.GetType()) {
-    case Type::kObjectType: {
-      Value::Object value_object;
-      for (auto it = o.MemberBegin(); it != o.MemberEnd(); ++it) {
-        Value entry;
-        ParseJsonAsValue(&entry, it->value);
-        if (entry.Type() != NULL_TYPE)
-          value_object.emplace(detail::GetKey(it), std::move(entry));
-      }
-      if (value_object.size() > 0) val = Value(std::move(value_object));
-    } break;
-    case Type::kArrayType: {
-      Value::Array value_array;
-      value_array.reserve(o.Size());
-      for (auto it = o.Begin(); it != o.End(); ++it) {
-        Value entry;
-        ParseJsonAsValue(&entry, *it);
-        if (entry.Type() != NULL_TYPE)
-          value_array.emplace_back(std::move(entry));
-      }
-      if (value_array.size() > 0) val = Value(std::move(value_array));
-    } break;
-    case Type::kStringType:
-      val = Value(std::string(o.GetString()));
-      break;
-    case Type::kFalseType:
-    case Type::kTrueType:
-      val = Value(o.GetBool());
-      break;
-    case Type::kNumberType:
-      if (!o.IsDouble()) {
-        int i = 0;
-        detail::GetInt(o, i);
-        val = Value(i);
-      } else {
-        double d = 0.0;
-        detail::GetDouble(o, d);
-        val = Value(d);
-      }
-      break;
-    case Type::kNullType:
-      break;
-      // all types are covered, so no `case default`
-  }
-#else
-  switch (o.type()) {
-    case detail::json::value_t::object: {
-      Value::Object value_object;
-      for (auto it = o.begin(); it != o.end(); it++) {
-        Value entry;
-        ParseJsonAsValue(&entry, it.value());
-        if (entry.Type() != NULL_TYPE)
-          value_object.emplace(it.key(), std::move(entry));
-      }
-      if (value_object.size() > 0) val = Value(std::move(value_object));
-    } break;
-    case detail::json::value_t::array: {
-      Value::Array value_array;
-      value_array.reserve(o.size());
-      for (auto it = o.begin(); it != o.end(); it++) {
-        Value entry;
-        ParseJsonAsValue(&entry, it.value());
-        if (entry.Type() != NULL_TYPE)
-          value_array.emplace_back(std::move(entry));
-      }
-      if (value_array.size() > 0) val = Value(std::move(value_array));
-    } break;
-    case detail::json::value_t::string:
-      val = Value(o.get<std::string>());
-      break;
-    case detail::json::value_t::boolean:
-      val = Value(o.get<bool>());
-      break;
-    case detail::json::value_t::number_integer:
-    case detail::json::value_t::number_unsigned:
-      val = Value(static_cast<int>(o.get<int64_t>()));
-      break;
-    case detail::json::value_t::number_float:
-      val = Value(o.get<double>());
-      break;
-    case detail::json::value_t::null:
-    case detail::json::value_t::discarded:
-    case detail::json::value_t::binary:
-      // default:
-      break;
-  }
-#endif
-  const bool isNotNull = val.Type() != NULL_TYPE;
+  memcpy(&version, bytes + 4, 4);
+  swap4(&version);
+  memcpy(&length, bytes + 8, 4); // Total glb size, including header and all chunks.
+  swap4(&length);
+  memcpy(&chunk0_length, bytes + 12, 4);  // JSON data length
+  swap4(&chunk0_length);
+  memcpy(&chunk0_format, bytes + 16, 4);
+  swap4(&chunk0_format);
+
+  // https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#binary-gltf-layout
+  //
+  // In case the Bin buffer is not present, the size is exactly 20 + size of
+  // JSON contents,
+  // so use "greater than" operator.
+  //
+  // https://github.com/syoyo/tinygltf/issues/372
+  // Use 64bit uint to avoid integer overflow.
+  uint64_t header_and_json_size = 20ull + uint64_t(chunk0_length);
 
-  if (ret) *ret = std::move(val);
+  if (header_and_json_size > (std::numeric_limits<uint32_t>::max)()) {
+    // Do not allow 4GB or more GLB data.
+    if (err) {
+      (*err) = "Invalid glTF binary. GLB data exceeds 4GB.";
+    }
+    return false;
+  }
 
-  return isNotNull;
-}
+  if ((header_and_json_size > uint64_t(size)) || (chunk0_length < 1) ||
+      (length > size) || (header_and_json_size > uint64_t(length)) ||
+      (chunk0_format != 0x4E4F534A)) {  // 0x4E4F534A = JSON format.
+    if (err) {
+      (*err) = "Invalid glTF binary.";
+    }
+    return false;
+  }
 
-static bool ParseExtrasProperty(Value *ret, const detail::json &o) {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, "extras", it)) {
+  // Padding check
+  // The start and the end of each chunk must be aligned to a 4-byte boundary.
+  // No padding check for chunk0 start since its 4byte-boundary is ensured.
+  if ((header_and_json_size % 4) != 0) {
+    if (err) {
+      (*err) = "JSON Chunk end does not aligned to a 4-byte boundary.";
+    }
     return false;
   }
 
-  return ParseJsonAsValue(ret, detail::GetValue(it));
-}
+  // std::cout << "header_and_json_size = " << header_and_json_size << "\n";
+  // std::cout << "length = " << length << "\n";
 
-static bool ParseBooleanProperty(bool *ret, std::string *err,
-                                 const detail::json &o,
-                                 const std::string &property,
-                                 const bool required,
-                                 const std::string &parent_node = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
+  // Chunk1(BIN) data
+  // The spec says: When the binary buffer is empty or when it is stored by
+  // other means, this chunk SHOULD be omitted. So when header + JSON data ==
+  // binary size, Chunk1 is omitted.
+  if (header_and_json_size == uint64_t(length)) {
+    bin_data_ = nullptr;
+    bin_size_ = 0;
+  } else {
+    // Read Chunk1 info(BIN data)
+    //
+    // issue-440:
+    // 'SHOULD' in glTF spec means 'RECOMMENDED',
+    // So there is a situation that Chunk1(BIN) is composed of zero-sized BIN data
+    // (chunksize(0) + binformat(BIN) = 8bytes).
+    //
+    if ((header_and_json_size + 8ull) > uint64_t(length)) {
       if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
+        (*err) =
+            "Insufficient storage space for Chunk1(BIN data). At least Chunk1 "
+            "Must have 8 or more bytes, but got " +
+            std::to_string((header_and_json_size + 8ull) - uint64_t(length)) +
+            ".\n";
       }
+      return false;
     }
-    return false;
-  }
 
-  auto &value = detail::GetValue(it);
+    unsigned int chunk1_length{0};  // 4 bytes
+    unsigned int chunk1_format{0};  // 4 bytes;
+    memcpy(&chunk1_length, bytes + header_and_json_size,
+           4);  // Bin data length
+    swap4(&chunk1_length);
+    memcpy(&chunk1_format, bytes + header_and_json_size + 4, 4);
+    swap4(&chunk1_format);
 
-  bool isBoolean;
-  bool boolValue = false;
-#ifdef TINYGLTF_USE_RAPIDJSON
-  isBoolean = value.IsBool();
-  if (isBoolean) {
-    boolValue = value.GetBool();
-  }
-#else
-  isBoolean = value.is_boolean();
-  if (isBoolean) {
-    boolValue = value.get<bool>();
-  }
-#endif
-  if (!isBoolean) {
-    if (required) {
+    if (chunk1_format != 0x004e4942) {
       if (err) {
-        (*err) += "'" + property + "' property is not a bool type.\n";
+        (*err) = "Invalid chunkType for Chunk1.";
       }
+      return false;
     }
-    return false;
+
+    if (chunk1_length == 0) {
+
+      if (header_and_json_size + 8 > uint64_t(length)) {
+        if (err) {
+          (*err) = "BIN Chunk header location exceeds the GLB size.";
+        }
+        return false;
+      }
+
+      bin_data_ = nullptr;
+
+    } else {
+
+      // When BIN chunk size is not zero, at least Chunk1 should have 12 bytes(8 bytes(header) + 4 bytes(bin
+      // payload could be 1~3 bytes, but need to be aligned to 4 bytes)
+
+      if (chunk1_length < 4) {
+        if (err) {
+          (*err) = "Insufficient Chunk1(BIN) data size.";
+        }
+        return false;
+      }
+
+      if ((chunk1_length % 4) != 0) {
+        if (strictness_==ParseStrictness::Permissive) {
+          if (warn) {
+            (*warn) += "BIN Chunk end is not aligned to a 4-byte boundary.\n";
+          }
+        }
+        else {
+          if (err) {
+            (*err) = "BIN Chunk end is not aligned to a 4-byte boundary.";
+          }
+          return false;
+        }
+      }
+
+      // +8 chunk1 header size.
+      if (uint64_t(chunk1_length) + header_and_json_size + 8 > uint64_t(length)) {
+        if (err) {
+          (*err) = "BIN Chunk data length exceeds the GLB size.";
+        }
+        return false;
+      }
+
+      bin_data_ = bytes + header_and_json_size +
+                  8;  // 4 bytes (bin_buffer_length) + 4 bytes(bin_buffer_format)
+    }
+
+    bin_size_ = size_t(chunk1_length);
   }
 
-  if (ret) {
-    (*ret) = boolValue;
+  is_binary_ = true;
+
+  bool ret = LoadFromString(model, err, warn,
+                            reinterpret_cast<const char *>(&bytes[20]),
+                            chunk0_length, base_dir, check_sections);
+  if (!ret) {
+    return ret;
   }
 
   return true;
 }
 
-static bool ParseIntegerProperty(int *ret, std::string *err,
-                                 const detail::json &o,
-                                 const std::string &property,
-                                 const bool required,
-                                 const std::string &parent_node = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
+bool TinyGLTF::LoadBinaryFromFile(Model *model, std::string *err,
+                                  std::string *warn,
+                                  const std::string &filename,
+                                  unsigned int check_sections) {
+  std::stringstream ss;
+
+  if (fs.ReadWholeFile == nullptr) {
+    // Programmer error, assert() ?
+    ss << "Failed to read file: " << filename
+       << ": one or more FS callback not set" << std::endl;
+    if (err) {
+      (*err) = ss.str();
     }
     return false;
   }
 
-  int intValue;
-  bool isInt = detail::GetInt(detail::GetValue(it), intValue);
-  if (!isInt) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not an integer type.\n";
-      }
+  std::vector<unsigned char> data;
+  std::string fileerr;
+  bool fileread = fs.ReadWholeFile(&data, &fileerr, filename, fs.user_data);
+  if (!fileread) {
+    ss << "Failed to read file: " << filename << ": " << fileerr << std::endl;
+    if (err) {
+      (*err) = ss.str();
     }
     return false;
   }
 
-  if (ret) {
-    (*ret) = intValue;
-  }
+  std::string basedir = GetBaseDir(filename);
 
-  return true;
+  bool ret = LoadBinaryFromMemory(model, err, warn, &data.at(0),
+                                  static_cast<unsigned int>(data.size()),
+                                  basedir, check_sections);
+
+  return ret;
 }
 
-static bool ParseUnsignedProperty(size_t *ret, std::string *err,
-                                  const detail::json &o,
-                                  const std::string &property,
-                                  const bool required,
-                                  const std::string &parent_node = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
-    }
-    return false;
+///////////////////////
+// GLTF Serialization
+///////////////////////
+namespace detail {
+detail::json JsonFromString(const char *s) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return detail::json(s, detail::GetAllocator());
+#else
+  return detail::json(s);
+#endif
+}
+
+void JsonAssign(detail::json &dest, const detail::json &src) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  dest.CopyFrom(src, detail::GetAllocator());
+#else
+  dest = src;
+#endif
+}
+
+void JsonAddMember(detail::json &o, const char *key, detail::json &&value) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  if (!o.IsObject()) {
+    o.SetObject();
   }
 
-  auto &value = detail::GetValue(it);
+  // Issue 420.
+  // AddMember may create duplicated key, so use [] API when a key already
+  // exists.
+  // https://github.com/Tencent/rapidjson/issues/771#issuecomment-254386863
+  detail::json_const_iterator it;
+  if (detail::FindMember(o, key, it)) {
+    o[key] = std::move(value);  // replace
+  } else {
+    o.AddMember(detail::json(key, detail::GetAllocator()), std::move(value),
+                detail::GetAllocator());
+  }
+#else
+  o[key] = std::move(value);
+#endif
+}
 
-  size_t uValue = 0;
-  bool isUValue;
+void JsonPushBack(detail::json &o, detail::json &&value) {
 #ifdef TINYGLTF_USE_RAPIDJSON
-  isUValue = false;
-  if (value.IsUint()) {
-    uValue = value.GetUint();
-    isUValue = true;
-  } else if (value.IsUint64()) {
-    uValue = value.GetUint64();
-    isUValue = true;
-  }
+  o.PushBack(std::move(value), detail::GetAllocator());
 #else
-  isUValue = value.is_number_unsigned();
-  if (isUValue) {
-    uValue = value.get<size_t>();
-  }
+  o.push_back(std::move(value));
 #endif
-  if (!isUValue) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not a positive integer.\n";
-      }
-    }
-    return false;
-  }
+}
 
-  if (ret) {
-    (*ret) = uValue;
-  }
+bool JsonIsNull(const detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  return o.IsNull();
+#else
+  return o.is_null();
+#endif
+}
 
-  return true;
+void JsonSetObject(detail::json &o) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  o.SetObject();
+#else
+  o = o.object({});
+#endif
 }
 
-static bool ParseNumberProperty(double *ret, std::string *err,
-                                const detail::json &o,
-                                const std::string &property,
-                                const bool required,
-                                const std::string &parent_node = "") {
-  detail::json_const_iterator it;
+void JsonReserveArray(detail::json &o, size_t s) {
+#ifdef TINYGLTF_USE_RAPIDJSON
+  o.SetArray();
+  o.Reserve(static_cast<rapidjson::SizeType>(s), detail::GetAllocator());
+#endif
+  (void)(o);
+  (void)(s);
+}
+}  // namespace detail
 
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
-    }
-    return false;
-  }
+// typedef std::pair<std::string, detail::json> json_object_pair;
 
-  double numberValue;
-  bool isNumber = detail::GetNumber(detail::GetValue(it), numberValue);
+template <typename T>
+static void SerializeNumberProperty(const std::string &key, T number,
+                                    detail::json &obj) {
+  // obj.insert(
+  //    json_object_pair(key, detail::json(static_cast<double>(number))));
+  // obj[key] = static_cast<double>(number);
+  detail::JsonAddMember(obj, key.c_str(), detail::json(number));
+}
 
-  if (!isNumber) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not a number type.\n";
-      }
-    }
-    return false;
-  }
+#ifdef TINYGLTF_USE_RAPIDJSON
+template <>
+void SerializeNumberProperty(const std::string &key, size_t number,
+                             detail::json &obj) {
+  detail::JsonAddMember(obj, key.c_str(),
+                        detail::json(static_cast<uint64_t>(number)));
+}
+#endif
 
-  if (ret) {
-    (*ret) = numberValue;
+template <typename T>
+static void SerializeNumberArrayProperty(const std::string &key,
+                                         const std::vector<T> &value,
+                                         detail::json &obj) {
+  if (value.empty()) return;
+
+  detail::json ary;
+  detail::JsonReserveArray(ary, value.size());
+  for (const auto &s : value) {
+    detail::JsonPushBack(ary, detail::json(s));
   }
+  detail::JsonAddMember(obj, key.c_str(), std::move(ary));
+}
 
-  return true;
+static void SerializeStringProperty(const std::string &key,
+                                    const std::string &value,
+                                    detail::json &obj) {
+  detail::JsonAddMember(obj, key.c_str(),
+                        detail::JsonFromString(value.c_str()));
 }
 
-static bool ParseNumberArrayProperty(std::vector<double> *ret, std::string *err,
-                                     const detail::json &o,
-                                     const std::string &property, bool required,
-                                     const std::string &parent_node = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
-    }
-    return false;
+static void SerializeStringArrayProperty(const std::string &key,
+                                         const std::vector<std::string> &value,
+                                         detail::json &obj) {
+  detail::json ary;
+  detail::JsonReserveArray(ary, value.size());
+  for (auto &s : value) {
+    detail::JsonPushBack(ary, detail::JsonFromString(s.c_str()));
   }
+  detail::JsonAddMember(obj, key.c_str(), std::move(ary));
+}
 
-  if (!detail::IsArray(detail::GetValue(it))) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not an array";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
+static bool ValueToJson(const Value &value, detail::json *ret) {
+  detail::json obj;
+#ifdef TINYGLTF_USE_RAPIDJSON
+  switch (value.Type()) {
+    case REAL_TYPE:
+      obj.SetDouble(value.Get<double>());
+      break;
+    case INT_TYPE:
+      obj.SetInt(value.Get<int>());
+      break;
+    case BOOL_TYPE:
+      obj.SetBool(value.Get<bool>());
+      break;
+    case STRING_TYPE:
+      obj.SetString(value.Get<std::string>().c_str(), detail::GetAllocator());
+      break;
+    case ARRAY_TYPE: {
+      obj.SetArray();
+      obj.Reserve(static_cast<rapidjson::SizeType>(value.ArrayLen()),
+                  detail::GetAllocator());
+      for (unsigned int i = 0; i < value.ArrayLen(); ++i) {
+        Value elementValue = value.Get(int(i));
+        detail::json elementJson;
+        if (ValueToJson(value.Get(int(i)), &elementJson))
+          obj.PushBack(std::move(elementJson), detail::GetAllocator());
+      }
+      break;
+    }
+    case BINARY_TYPE:
+      // TODO
+      // obj = detail::json(value.Get<std::vector<unsigned char>>());
+      return false;
+      break;
+    case OBJECT_TYPE: {
+      obj.SetObject();
+      Value::Object objMap = value.Get<Value::Object>();
+      for (auto &it : objMap) {
+        detail::json elementJson;
+        if (ValueToJson(it.second, &elementJson)) {
+          obj.AddMember(detail::json(it.first.c_str(), detail::GetAllocator()),
+                        std::move(elementJson), detail::GetAllocator());
         }
-        (*err) += ".\n";
       }
+      break;
     }
-    return false;
+    case NULL_TYPE:
+    default:
+      return false;
   }
-
-  ret->clear();
-  auto end = detail::ArrayEnd(detail::GetValue(it));
-  for (auto i = detail::ArrayBegin(detail::GetValue(it)); i != end; ++i) {
-    double numberValue;
-    const bool isNumber = detail::GetNumber(*i, numberValue);
-    if (!isNumber) {
-      if (required) {
-        if (err) {
-          (*err) += "'" + property + "' property is not a number.\n";
-          if (!parent_node.empty()) {
-            (*err) += " in " + parent_node;
-          }
-          (*err) += ".\n";
-        }
+#else
+  switch (value.Type()) {
+    case REAL_TYPE:
+      obj = detail::json(value.Get<double>());
+      break;
+    case INT_TYPE:
+      obj = detail::json(value.Get<int>());
+      break;
+    case BOOL_TYPE:
+      obj = detail::json(value.Get<bool>());
+      break;
+    case STRING_TYPE:
+      obj = detail::json(value.Get<std::string>());
+      break;
+    case ARRAY_TYPE: {
+      for (size_t i = 0; i < value.ArrayLen(); ++i) {
+        Value elementValue = value.Get(i);
+        detail::json elementJson;
+        if (ValueToJson(value.Get(i), &elementJson))
+          obj.push_back(elementJson);
+      }
+      break;
+    }
+    case BINARY_TYPE:
+      // TODO
+      // obj = json(value.Get<std::vector<unsigned char>>());
+      return false;
+      break;
+    case OBJECT_TYPE: {
+      Value::Object objMap = value.Get<Value::Object>();
+      for (auto &it : objMap) {
+        detail::json elementJson;
+        if (ValueToJson(it.second, &elementJson)) obj[it.first] = elementJson;
       }
-      return false;
+      break;
     }
-    ret->push_back(numberValue);
+    case NULL_TYPE:
+    default:
+      return false;
   }
-
+#endif
+  if (ret) *ret = std::move(obj);
   return true;
 }
 
-static bool ParseIntegerArrayProperty(std::vector<int> *ret, std::string *err,
-                                      const detail::json &o,
-                                      const std::string &property,
-                                      bool required,
-                                      const std::string &parent_node = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
-    }
-    return false;
+static void SerializeValue(const std::string &key, const Value &value,
+                           detail::json &obj) {
+  detail::json ret;
+  if (ValueToJson(value, &ret)) {
+    detail::JsonAddMember(obj, key.c_str(), std::move(ret));
   }
+}
 
-  if (!detail::IsArray(detail::GetValue(it))) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not an array";
-        if (!parent_node.empty()) {
-          (*err) += " in " + parent_node;
-        }
-        (*err) += ".\n";
-      }
-    }
-    return false;
+static void SerializeGltfBufferData(const std::vector<unsigned char> &data,
+                                    detail::json &o) {
+  std::string header = "data:application/octet-stream;base64,";
+  if (data.size() > 0) {
+    std::string encodedData =
+        base64_encode(&data[0], static_cast<unsigned int>(data.size()));
+    SerializeStringProperty("uri", header + encodedData, o);
+  } else {
+    // Issue #229
+    // size 0 is allowed. Just emit mime header.
+    SerializeStringProperty("uri", header, o);
   }
+}
 
-  ret->clear();
-  auto end = detail::ArrayEnd(detail::GetValue(it));
-  for (auto i = detail::ArrayBegin(detail::GetValue(it)); i != end; ++i) {
-    int numberValue;
-    bool isNumber = detail::GetInt(*i, numberValue);
-    if (!isNumber) {
-      if (required) {
-        if (err) {
-          (*err) += "'" + property + "' property is not an integer type.\n";
-          if (!parent_node.empty()) {
-            (*err) += " in " + parent_node;
-          }
-          (*err) += ".\n";
-        }
-      }
-      return false;
-    }
-    ret->push_back(numberValue);
+static bool SerializeGltfBufferData(const std::vector<unsigned char> &data,
+                                    const std::string &binFilename) {
+#ifdef _WIN32
+#if defined(__GLIBCXX__)  // mingw
+  int file_descriptor = _wopen(UTF8ToWchar(binFilename).c_str(),
+                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(
+      file_descriptor, std::ios_base::out | std::ios_base::binary);
+  std::ostream output(&wfile_buf);
+  if (!wfile_buf.is_open()) return false;
+#elif defined(_MSC_VER)
+  std::ofstream output(UTF8ToWchar(binFilename).c_str(), std::ofstream::binary);
+  if (!output.is_open()) return false;
+#else
+  std::ofstream output(binFilename.c_str(), std::ofstream::binary);
+  if (!output.is_open()) return false;
+#endif
+#else
+  std::ofstream output(binFilename.c_str(), std::ofstream::binary);
+  if (!output.is_open()) return false;
+#endif
+  if (data.size() > 0) {
+    output.write(reinterpret_cast<const char *>(&data[0]),
+                 std::streamsize(data.size()));
+  } else {
+    // Issue #229
+    // size 0 will be still valid buffer data.
+    // write empty file.
   }
-
   return true;
 }
 
-static bool ParseStringProperty(
-    std::string *ret, std::string *err, const detail::json &o,
-    const std::string &property, bool required,
-    const std::string &parent_node = std::string()) {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing";
-        if (parent_node.empty()) {
-          (*err) += ".\n";
+#if 0  // FIXME(syoyo): not used. will be removed in the future release.
+static void SerializeParameterMap(ParameterMap &param, detail::json &o) {
+  for (ParameterMap::iterator paramIt = param.begin(); paramIt != param.end();
+       ++paramIt) {
+    if (paramIt->second.number_array.size()) {
+      SerializeNumberArrayProperty<double>(paramIt->first,
+                                           paramIt->second.number_array, o);
+    } else if (paramIt->second.json_double_value.size()) {
+      detail::json json_double_value;
+      for (std::map<std::string, double>::iterator it =
+               paramIt->second.json_double_value.begin();
+           it != paramIt->second.json_double_value.end(); ++it) {
+        if (it->first == "index") {
+          json_double_value[it->first] = paramIt->second.TextureIndex();
         } else {
-          (*err) += " in `" + parent_node + "'.\n";
+          json_double_value[it->first] = it->second;
         }
       }
+
+      o[paramIt->first] = json_double_value;
+    } else if (!paramIt->second.string_value.empty()) {
+      SerializeStringProperty(paramIt->first, paramIt->second.string_value, o);
+    } else if (paramIt->second.has_number_value) {
+      o[paramIt->first] = paramIt->second.number_value;
+    } else {
+      o[paramIt->first] = paramIt->second.bool_value;
     }
-    return false;
   }
+}
+#endif
 
-  std::string strValue;
-  if (!detail::GetString(detail::GetValue(it), strValue)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not a string type.\n";
+static void SerializeExtensionMap(const ExtensionMap &extensions,
+                                  detail::json &o) {
+  if (!extensions.size()) return;
+
+  detail::json extMap;
+  for (ExtensionMap::const_iterator extIt = extensions.begin();
+       extIt != extensions.end(); ++extIt) {
+    // Allow an empty object for extension(#97)
+    detail::json ret;
+    bool isNull = true;
+    if (ValueToJson(extIt->second, &ret)) {
+      isNull = detail::JsonIsNull(ret);
+      detail::JsonAddMember(extMap, extIt->first.c_str(), std::move(ret));
+    }
+    if (isNull) {
+      if (!(extIt->first.empty())) {  // name should not be empty, but for sure
+        // create empty object so that an extension name is still included in
+        // json.
+        detail::json empty;
+        detail::JsonSetObject(empty);
+        detail::JsonAddMember(extMap, extIt->first.c_str(), std::move(empty));
       }
     }
-    return false;
   }
+  detail::JsonAddMember(o, "extensions", std::move(extMap));
+}
 
-  if (ret) {
-    (*ret) = std::move(strValue);
-  }
+static void SerializeExtras(const Value &extras, detail::json &o) {
+  if (extras.Type() != NULL_TYPE) SerializeValue("extras", extras, o);
+}
 
-  return true;
+template <typename GltfType>
+void SerializeExtrasAndExtensions(const GltfType &obj, detail::json &o) {
+  SerializeExtensionMap(obj.extensions, o);
+  SerializeExtras(obj.extras, o);
 }
 
-static bool ParseStringIntegerProperty(std::map<std::string, int> *ret,
-                                       std::string *err, const detail::json &o,
-                                       const std::string &property,
-                                       bool required,
-                                       const std::string &parent = "") {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        if (!parent.empty()) {
-          (*err) +=
-              "'" + property + "' property is missing in " + parent + ".\n";
-        } else {
-          (*err) += "'" + property + "' property is missing.\n";
-        }
-      }
+static void SerializeGltfAccessor(const Accessor &accessor, detail::json &o) {
+  if (accessor.bufferView >= 0)
+    SerializeNumberProperty<int>("bufferView", accessor.bufferView, o);
+
+  if (accessor.byteOffset != 0)
+    SerializeNumberProperty<size_t>("byteOffset", accessor.byteOffset, o);
+
+  SerializeNumberProperty<int>("componentType", accessor.componentType, o);
+  SerializeNumberProperty<size_t>("count", accessor.count, o);
+
+  if ((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) ||
+      (accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE)) {
+    SerializeNumberArrayProperty<double>("min", accessor.minValues, o);
+    SerializeNumberArrayProperty<double>("max", accessor.maxValues, o);
+  } else {
+    // Issue #301. Serialize as integer.
+    // Assume int value is within [-2**31-1, 2**31-1]
+    {
+      std::vector<int> values;
+      std::transform(accessor.minValues.begin(), accessor.minValues.end(),
+                     std::back_inserter(values),
+                     [](double v) { return static_cast<int>(v); });
+
+      SerializeNumberArrayProperty<int>("min", values, o);
     }
-    return false;
-  }
 
-  const detail::json &dict = detail::GetValue(it);
+    {
+      std::vector<int> values;
+      std::transform(accessor.maxValues.begin(), accessor.maxValues.end(),
+                     std::back_inserter(values),
+                     [](double v) { return static_cast<int>(v); });
 
-  // Make sure we are dealing with an object / dictionary.
-  if (!detail::IsObject(dict)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not an object.\n";
-      }
+      SerializeNumberArrayProperty<int>("max", values, o);
     }
-    return false;
   }
 
-  ret->clear();
+  if (accessor.normalized)
+    SerializeValue("normalized", Value(accessor.normalized), o);
+  std::string type;
+  switch (accessor.type) {
+    case TINYGLTF_TYPE_SCALAR:
+      type = "SCALAR";
+      break;
+    case TINYGLTF_TYPE_VEC2:
+      type = "VEC2";
+      break;
+    case TINYGLTF_TYPE_VEC3:
+      type = "VEC3";
+      break;
+    case TINYGLTF_TYPE_VEC4:
+      type = "VEC4";
+      break;
+    case TINYGLTF_TYPE_MAT2:
+      type = "MAT2";
+      break;
+    case TINYGLTF_TYPE_MAT3:
+      type = "MAT3";
+      break;
+    case TINYGLTF_TYPE_MAT4:
+      type = "MAT4";
+      break;
+  }
+
+  SerializeStringProperty("type", type, o);
+  if (!accessor.name.empty()) SerializeStringProperty("name", accessor.name, o);
 
-  detail::json_const_iterator dictIt(detail::ObjectBegin(dict));
-  detail::json_const_iterator dictItEnd(detail::ObjectEnd(dict));
+  SerializeExtrasAndExtensions(accessor, o);
 
-  for (; dictIt != dictItEnd; ++dictIt) {
-    int intVal;
-    if (!detail::GetInt(detail::GetValue(dictIt), intVal)) {
-      if (required) {
-        if (err) {
-          (*err) += "'" + property + "' value is not an integer type.\n";
-        }
-      }
-      return false;
+  // sparse
+  if (accessor.sparse.isSparse) {
+    detail::json sparse;
+    SerializeNumberProperty<int>("count", accessor.sparse.count, sparse);
+    {
+      detail::json indices;
+      SerializeNumberProperty<int>("bufferView",
+                                   accessor.sparse.indices.bufferView, indices);
+      SerializeNumberProperty<size_t>("byteOffset",
+                                   accessor.sparse.indices.byteOffset, indices);
+      SerializeNumberProperty<int>(
+          "componentType", accessor.sparse.indices.componentType, indices);
+      SerializeExtrasAndExtensions(accessor.sparse.indices, indices);
+      detail::JsonAddMember(sparse, "indices", std::move(indices));
     }
-
-    // Insert into the list.
-    (*ret)[detail::GetKey(dictIt)] = intVal;
-  }
-  return true;
-}
-
-static bool ParseJSONProperty(std::map<std::string, double> *ret,
-                              std::string *err, const detail::json &o,
-                              const std::string &property, bool required) {
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, property.c_str(), it)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is missing. \n'";
-      }
+    {
+      detail::json values;
+      SerializeNumberProperty<int>("bufferView",
+                                   accessor.sparse.values.bufferView, values);
+      SerializeNumberProperty<size_t>("byteOffset",
+                                   accessor.sparse.values.byteOffset, values);
+      SerializeExtrasAndExtensions(accessor.sparse.values, values);
+      detail::JsonAddMember(sparse, "values", std::move(values));
     }
-    return false;
+    SerializeExtrasAndExtensions(accessor.sparse, sparse);
+    detail::JsonAddMember(o, "sparse", std::move(sparse));
   }
+}
 
-  const detail::json &obj = detail::GetValue(it);
+static void SerializeGltfAnimationChannel(const AnimationChannel &channel,
+                                          detail::json &o) {
+  SerializeNumberProperty("sampler", channel.sampler, o);
+  {
+    detail::json target;
 
-  if (!detail::IsObject(obj)) {
-    if (required) {
-      if (err) {
-        (*err) += "'" + property + "' property is not a JSON object.\n";
-      }
+    if (channel.target_node >= 0) {
+      SerializeNumberProperty("node", channel.target_node, target);
     }
-    return false;
-  }
 
-  ret->clear();
+    SerializeStringProperty("path", channel.target_path, target);
 
-  detail::json_const_iterator it2(detail::ObjectBegin(obj));
-  detail::json_const_iterator itEnd(detail::ObjectEnd(obj));
-  for (; it2 != itEnd; ++it2) {
-    double numVal;
-    if (detail::GetNumber(detail::GetValue(it2), numVal))
-      ret->emplace(std::string(detail::GetKey(it2)), numVal);
+    SerializeExtensionMap(channel.target_extensions, target);
+    SerializeExtras(channel.target_extras, target);
+
+    detail::JsonAddMember(o, "target", std::move(target));
   }
 
-  return true;
+  SerializeExtrasAndExtensions(channel, o);
 }
 
-static bool ParseParameterProperty(Parameter *param, std::string *err,
-                                   const detail::json &o,
-                                   const std::string &prop, bool required) {
-  // A parameter value can either be a string or an array of either a boolean or
-  // a number. Booleans of any kind aren't supported here. Granted, it
-  // complicates the Parameter structure and breaks it semantically in the sense
-  // that the client probably works off the assumption that if the string is
-  // empty the vector is used, etc. Would a tagged union work?
-  if (ParseStringProperty(&param->string_value, err, o, prop, false)) {
-    // Found string property.
-    return true;
-  } else if (ParseNumberArrayProperty(&param->number_array, err, o, prop,
-                                      false)) {
-    // Found a number array.
-    return true;
-  } else if (ParseNumberProperty(&param->number_value, err, o, prop, false)) {
-    param->has_number_value = true;
-    return true;
-  } else if (ParseJSONProperty(&param->json_double_value, err, o, prop,
-                               false)) {
-    return true;
-  } else if (ParseBooleanProperty(&param->bool_value, err, o, prop, false)) {
-    return true;
-  } else {
-    if (required) {
-      if (err) {
-        (*err) += "parameter must be a string or number / number array.\n";
-      }
-    }
-    return false;
-  }
-}
+static void SerializeGltfAnimationSampler(const AnimationSampler &sampler,
+                                          detail::json &o) {
+  SerializeNumberProperty("input", sampler.input, o);
+  SerializeNumberProperty("output", sampler.output, o);
+  SerializeStringProperty("interpolation", sampler.interpolation, o);
 
-static bool ParseExtensionsProperty(ExtensionMap *ret, std::string *err,
-                                    const detail::json &o) {
-  (void)err;
+  SerializeExtrasAndExtensions(sampler, o);
+}
 
-  detail::json_const_iterator it;
-  if (!detail::FindMember(o, "extensions", it)) {
-    return false;
-  }
+static void SerializeGltfAnimation(const Animation &animation,
+                                   detail::json &o) {
+  if (!animation.name.empty())
+    SerializeStringProperty("name", animation.name, o);
 
-  auto &obj = detail::GetValue(it);
-  if (!detail::IsObject(obj)) {
-    return false;
-  }
-  ExtensionMap extensions;
-  detail::json_const_iterator extIt =
-      detail::ObjectBegin(obj);  // it.value().begin();
-  detail::json_const_iterator extEnd = detail::ObjectEnd(obj);
-  for (; extIt != extEnd; ++extIt) {
-    auto &itObj = detail::GetValue(extIt);
-    if (!detail::IsObject(itObj)) continue;
-    std::string key(detail::GetKey(extIt));
-    if (!ParseJsonAsValue(&extensions[key], itObj)) {
-      if (!key.empty()) {
-        // create empty object so that an extension object is still of type
-        // object
-        extensions[key] = Value{Value::Object{}};
-      }
+  {
+    detail::json channels;
+    detail::JsonReserveArray(channels, animation.channels.size());
+    for (unsigned int i = 0; i < animation.channels.size(); ++i) {
+      detail::json channel;
+      AnimationChannel gltfChannel = animation.channels[i];
+      SerializeGltfAnimationChannel(gltfChannel, channel);
+      detail::JsonPushBack(channels, std::move(channel));
     }
-  }
-  if (ret) {
-    (*ret) = std::move(extensions);
-  }
-  return true;
-}
 
-template <typename GltfType>
-static bool ParseExtrasAndExtensions(GltfType *target, std::string *err,
-                                     const detail::json &o,
-                                     bool store_json_strings) {
-  ParseExtensionsProperty(&target->extensions, err, o);
-  ParseExtrasProperty(&target->extras, o);
+    detail::JsonAddMember(o, "channels", std::move(channels));
+  }
 
-  if (store_json_strings) {
-    {
-      detail::json_const_iterator it;
-      if (detail::FindMember(o, "extensions", it)) {
-        target->extensions_json_string =
-            detail::JsonToString(detail::GetValue(it));
-      }
-    }
-    {
-      detail::json_const_iterator it;
-      if (detail::FindMember(o, "extras", it)) {
-        target->extras_json_string = detail::JsonToString(detail::GetValue(it));
-      }
+  {
+    detail::json samplers;
+    detail::JsonReserveArray(samplers, animation.samplers.size());
+    for (unsigned int i = 0; i < animation.samplers.size(); ++i) {
+      detail::json sampler;
+      AnimationSampler gltfSampler = animation.samplers[i];
+      SerializeGltfAnimationSampler(gltfSampler, sampler);
+      detail::JsonPushBack(samplers, std::move(sampler));
     }
+    detail::JsonAddMember(o, "samplers", std::move(samplers));
   }
-  return true;
-}
-
-static bool ParseAsset(Asset *asset, std::string *err, const detail::json &o,
-                       bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&asset->version, err, o, "version", true, "Asset");
-  ParseStringProperty(&asset->generator, err, o, "generator", false, "Asset");
-  ParseStringProperty(&asset->minVersion, err, o, "minVersion", false, "Asset");
-  ParseStringProperty(&asset->copyright, err, o, "copyright", false, "Asset");
 
-  ParseExtrasAndExtensions(asset, err, o,
-                           store_original_json_for_extras_and_extensions);
-  return true;
+  SerializeExtrasAndExtensions(animation, o);
 }
 
-static bool ParseImage(Image *image, const int image_idx, std::string *err,
-                       std::string *warn, const detail::json &o,
-                       bool store_original_json_for_extras_and_extensions,
-                       const std::string &basedir, const size_t max_file_size,
-                       FsCallbacks *fs, const URICallbacks *uri_cb,
-                       const LoadImageDataFunction& LoadImageData = nullptr,
-                       void *load_image_user_data = nullptr) {
-  // A glTF image must either reference a bufferView or an image uri
-
-  // schema says oneOf [`bufferView`, `uri`]
-  // TODO(syoyo): Check the type of each parameters.
-  detail::json_const_iterator it;
-  bool hasBufferView = detail::FindMember(o, "bufferView", it);
-  bool hasURI = detail::FindMember(o, "uri", it);
+static void SerializeGltfAsset(const Asset &asset, detail::json &o) {
+  if (!asset.generator.empty()) {
+    SerializeStringProperty("generator", asset.generator, o);
+  }
 
-  ParseStringProperty(&image->name, err, o, "name", false);
+  if (!asset.copyright.empty()) {
+    SerializeStringProperty("copyright", asset.copyright, o);
+  }
 
-  if (hasBufferView && hasURI) {
-    // Should not both defined.
-    if (err) {
-      (*err) +=
-          "Only one of `bufferView` or `uri` should be defined, but both are "
-          "defined for image[" +
-          std::to_string(image_idx) + "] name = \"" + image->name + "\"\n";
-    }
-    return false;
+  auto version = asset.version;
+  if (version.empty()) {
+    // Just in case
+    // `version` must be defined
+    version = "2.0";
   }
 
-  if (!hasBufferView && !hasURI) {
-    if (err) {
-      (*err) += "Neither required `bufferView` nor `uri` defined for image[" +
-                std::to_string(image_idx) + "] name = \"" + image->name +
-                "\"\n";
-    }
-    return false;
-  }
+  // TODO(syoyo): Do we need to check if `version` is greater or equal to 2.0?
+  SerializeStringProperty("version", version, o);
 
-  ParseExtrasAndExtensions(image, err, o,
-                           store_original_json_for_extras_and_extensions);
+  SerializeExtrasAndExtensions(asset, o);
+}
 
-  if (hasBufferView) {
-    int bufferView = -1;
-    if (!ParseIntegerProperty(&bufferView, err, o, "bufferView", true)) {
-      if (err) {
-        (*err) += "Failed to parse `bufferView` for image[" +
-                  std::to_string(image_idx) + "] name = \"" + image->name +
-                  "\"\n";
-      }
-      return false;
-    }
+static void SerializeGltfBufferBin(const Buffer &buffer, detail::json &o,
+                                   std::vector<unsigned char> &binBuffer) {
+  SerializeNumberProperty("byteLength", buffer.data.size(), o);
+  binBuffer = buffer.data;
 
-    std::string mime_type;
-    ParseStringProperty(&mime_type, err, o, "mimeType", false);
+  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
 
-    int width = 0;
-    ParseIntegerProperty(&width, err, o, "width", false);
+  SerializeExtrasAndExtensions(buffer, o);
+}
 
-    int height = 0;
-    ParseIntegerProperty(&height, err, o, "height", false);
+#ifdef TINYGLTF_ENABLE_MESHOPT
+static bool IsMeshoptFallbackBuffer(const Buffer &buffer) {
+  auto it = buffer.extensions.find("EXT_meshopt_compression");
+  return (it != buffer.extensions.end()) && it->second.Has("fallback") &&
+         it->second.Get("fallback").IsBool() &&
+         it->second.Get("fallback").Get<bool>();
+}
 
-    // Just only save some information here. Loading actual image data from
-    // bufferView is done after this `ParseImage` function.
-    image->bufferView = bufferView;
-    image->mimeType = mime_type;
-    image->width = width;
-    image->height = height;
+// EXT_meshopt_compression fallback buffer: only the size is written.
+static void SerializeGltfFallbackBuffer(const Buffer &buffer, detail::json &o) {
+  SerializeNumberProperty("byteLength", buffer.data.size(), o);
 
-    return true;
-  }
+  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
 
-  // Parse URI & Load image data.
+  SerializeExtrasAndExtensions(buffer, o);
+}
+#endif
 
-  std::string uri;
-  std::string tmp_err;
-  if (!ParseStringProperty(&uri, &tmp_err, o, "uri", true)) {
-    if (err) {
-      (*err) += "Failed to parse `uri` for image[" + std::to_string(image_idx) +
-                "] name = \"" + image->name + "\".\n";
-    }
-    return false;
-  }
+static void SerializeGltfBuffer(const Buffer &buffer, detail::json &o) {
+  SerializeNumberProperty("byteLength", buffer.data.size(), o);
+  SerializeGltfBufferData(buffer.data, o);
 
-  std::vector<unsigned char> img;
+  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
 
-  if (IsDataURI(uri)) {
-    if (!DecodeDataURI(&img, image->mimeType, uri, 0, false)) {
-      if (err) {
-        (*err) += "Failed to decode 'uri' for image[" +
-                  std::to_string(image_idx) + "] name = \"" + image->name +
-                  "\"\n";
-      }
-      return false;
-    }
-  } else {
-    // Assume external file
-    // Unconditionally keep the external URI of the image
-    image->uri = uri;
-#ifdef TINYGLTF_NO_EXTERNAL_IMAGE
-    return true;
-#else
-    std::string decoded_uri;
-    if (!uri_cb->decode(uri, &decoded_uri, uri_cb->user_data)) {
-      if (warn) {
-        (*warn) += "Failed to decode 'uri' for image[" +
-                   std::to_string(image_idx) + "] name = \"" + image->name +
-                   "\"\n";
-      }
+  SerializeExtrasAndExtensions(buffer, o);
+}
 
-      // Image loading failure is not critical to overall gltf loading.
-      return true;
-    }
+static bool SerializeGltfBuffer(const Buffer &buffer, detail::json &o,
+                                const std::string &binFilename,
+                                const std::string &binUri) {
+  if (!SerializeGltfBufferData(buffer.data, binFilename)) return false;
+  SerializeNumberProperty("byteLength", buffer.data.size(), o);
+  SerializeStringProperty("uri", binUri, o);
 
-    if (!LoadExternalFile(&img, err, warn, decoded_uri, basedir,
-                          /* required */ false, /* required bytes */ 0,
-                          /* checksize */ false,
-                          /* max file size */ max_file_size, fs)) {
-      if (warn) {
-        (*warn) += "Failed to load external 'uri' for image[" +
-                   std::to_string(image_idx) + "] name = \"" + decoded_uri +
-                   "\"\n";
-      }
-      // If the image cannot be loaded, keep uri as image->uri.
-      return true;
-    }
+  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
 
-    if (img.empty()) {
-      if (warn) {
-        (*warn) += "Image data is empty for image[" +
-                   std::to_string(image_idx) + "] name = \"" + image->name +
-                   "\" \n";
-      }
-      return false;
-    }
-#endif
-  }
+  SerializeExtrasAndExtensions(buffer, o);
+  return true;
+}
 
-  if (LoadImageData == nullptr) {
-    if (err) {
-      (*err) += "No LoadImageData callback specified.\n";
-    }
-    return false;
+static void SerializeGltfBufferView(const BufferView &bufferView,
+                                    detail::json &o) {
+  SerializeNumberProperty("buffer", bufferView.buffer, o);
+  SerializeNumberProperty<size_t>("byteLength", bufferView.byteLength, o);
+
+  // byteStride is optional, minimum allowed is 4
+  if (bufferView.byteStride >= 4) {
+    SerializeNumberProperty<size_t>("byteStride", bufferView.byteStride, o);
+  }
+  // byteOffset is optional, default is 0
+  if (bufferView.byteOffset > 0) {
+    SerializeNumberProperty<size_t>("byteOffset", bufferView.byteOffset, o);
+  }
+  // Target is optional, check if it contains a valid value
+  if (bufferView.target == TINYGLTF_TARGET_ARRAY_BUFFER ||
+      bufferView.target == TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER) {
+    SerializeNumberProperty("target", bufferView.target, o);
+  }
+  if (bufferView.name.size()) {
+    SerializeStringProperty("name", bufferView.name, o);
   }
 
-  return LoadImageData(image, image_idx, err, warn, 0, 0, &img.at(0),
-                       static_cast<int>(img.size()), load_image_user_data);
+  SerializeExtrasAndExtensions(bufferView, o);
 }
 
-static bool ParseTexture(Texture *texture, std::string *err,
-                         const detail::json &o,
-                         bool store_original_json_for_extras_and_extensions,
-                         const std::string &basedir) {
-  (void)basedir;
-  int sampler = -1;
-  int source = -1;
-  ParseIntegerProperty(&sampler, err, o, "sampler", false);
+static void SerializeGltfImage(const Image &image, const std::string &uri,
+                               detail::json &o) {
+  // From 2.7.0, we look for `uri` parameter, not `Image.uri`
+  // if uri is empty, the mimeType and bufferview should be set
+  if (uri.empty()) {
+    SerializeStringProperty("mimeType", image.mimeType, o);
+    SerializeNumberProperty<int>("bufferView", image.bufferView, o);
+  } else {
+    SerializeStringProperty("uri", uri, o);
+  }
 
-  ParseIntegerProperty(&source, err, o, "source", false);
+  if (image.name.size()) {
+    SerializeStringProperty("name", image.name, o);
+  }
 
-  texture->sampler = sampler;
-  texture->source = source;
+  SerializeExtrasAndExtensions(image, o);
+}
 
-  ParseExtrasAndExtensions(texture, err, o,
-                           store_original_json_for_extras_and_extensions);
+static void SerializeGltfTextureInfo(const TextureInfo &texinfo,
+                                     detail::json &o) {
+  SerializeNumberProperty("index", texinfo.index, o);
 
-  ParseStringProperty(&texture->name, err, o, "name", false);
+  if (texinfo.texCoord != 0) {
+    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
+  }
 
-  return true;
+  SerializeExtrasAndExtensions(texinfo, o);
 }
 
-static bool ParseTextureInfo(
-    TextureInfo *texinfo, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  if (texinfo == nullptr) {
-    return false;
+static void SerializeGltfNormalTextureInfo(const NormalTextureInfo &texinfo,
+                                           detail::json &o) {
+  SerializeNumberProperty("index", texinfo.index, o);
+
+  if (texinfo.texCoord != 0) {
+    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
   }
 
-  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
-                            /* required */ true, "TextureInfo")) {
-    return false;
+  if (!TINYGLTF_DOUBLE_EQUAL(texinfo.scale, 1.0)) {
+    SerializeNumberProperty("scale", texinfo.scale, o);
   }
 
-  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
+  SerializeExtrasAndExtensions(texinfo, o);
+}
 
-  ParseExtrasAndExtensions(texinfo, err, o,
-                           store_original_json_for_extras_and_extensions);
+static void SerializeGltfOcclusionTextureInfo(
+    const OcclusionTextureInfo &texinfo, detail::json &o) {
+  SerializeNumberProperty("index", texinfo.index, o);
 
-  return true;
+  if (texinfo.texCoord != 0) {
+    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
+  }
+
+  if (!TINYGLTF_DOUBLE_EQUAL(texinfo.strength, 1.0)) {
+    SerializeNumberProperty("strength", texinfo.strength, o);
+  }
+
+  SerializeExtrasAndExtensions(texinfo, o);
 }
 
-static bool ParseNormalTextureInfo(
-    NormalTextureInfo *texinfo, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  if (texinfo == nullptr) {
-    return false;
+static void SerializeGltfPbrMetallicRoughness(const PbrMetallicRoughness &pbr,
+                                              detail::json &o) {
+  std::vector<double> default_baseColorFactor = {1.0, 1.0, 1.0, 1.0};
+  if (!Equals(pbr.baseColorFactor, default_baseColorFactor)) {
+    SerializeNumberArrayProperty<double>("baseColorFactor", pbr.baseColorFactor,
+                                         o);
   }
 
-  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
-                            /* required */ true, "NormalTextureInfo")) {
-    return false;
+  if (!TINYGLTF_DOUBLE_EQUAL(pbr.metallicFactor, 1.0)) {
+    SerializeNumberProperty("metallicFactor", pbr.metallicFactor, o);
+  }
+
+  if (!TINYGLTF_DOUBLE_EQUAL(pbr.roughnessFactor, 1.0)) {
+    SerializeNumberProperty("roughnessFactor", pbr.roughnessFactor, o);
+  }
+
+  if (pbr.baseColorTexture.index > -1) {
+    detail::json texinfo;
+    SerializeGltfTextureInfo(pbr.baseColorTexture, texinfo);
+    detail::JsonAddMember(o, "baseColorTexture", std::move(texinfo));
+  }
+
+  if (pbr.metallicRoughnessTexture.index > -1) {
+    detail::json texinfo;
+    SerializeGltfTextureInfo(pbr.metallicRoughnessTexture, texinfo);
+    detail::JsonAddMember(o, "metallicRoughnessTexture", std::move(texinfo));
   }
 
-  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
-  ParseNumberProperty(&texinfo->scale, err, o, "scale", false);
-
-  ParseExtrasAndExtensions(texinfo, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
+  SerializeExtrasAndExtensions(pbr, o);
 }
 
-static bool ParseOcclusionTextureInfo(
-    OcclusionTextureInfo *texinfo, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  if (texinfo == nullptr) {
-    return false;
+static void SerializeGltfMaterial(const Material &material, detail::json &o) {
+  if (material.name.size()) {
+    SerializeStringProperty("name", material.name, o);
   }
 
-  if (!ParseIntegerProperty(&texinfo->index, err, o, "index",
-                            /* required */ true, "NormalTextureInfo")) {
-    return false;
+  // QUESTION(syoyo): Write material parameters regardless of its default value?
+
+  if (!TINYGLTF_DOUBLE_EQUAL(material.alphaCutoff, 0.5)) {
+    SerializeNumberProperty("alphaCutoff", material.alphaCutoff, o);
   }
 
-  ParseIntegerProperty(&texinfo->texCoord, err, o, "texCoord", false);
-  ParseNumberProperty(&texinfo->strength, err, o, "strength", false);
+  if (material.alphaMode.compare("OPAQUE") != 0) {
+    SerializeStringProperty("alphaMode", material.alphaMode, o);
+  }
 
-  ParseExtrasAndExtensions(texinfo, err, o,
-                           store_original_json_for_extras_and_extensions);
+  if (material.doubleSided != false)
+    detail::JsonAddMember(o, "doubleSided", detail::json(material.doubleSided));
 
-  return true;
-}
+  if (material.normalTexture.index > -1) {
+    detail::json texinfo;
+    SerializeGltfNormalTextureInfo(material.normalTexture, texinfo);
+    detail::JsonAddMember(o, "normalTexture", std::move(texinfo));
+  }
 
-static bool ParseBuffer(Buffer *buffer, std::string *err, const detail::json &o,
-                        bool store_original_json_for_extras_and_extensions,
-                        FsCallbacks *fs, const URICallbacks *uri_cb,
-                        const std::string &basedir,
-                        const size_t max_buffer_size, bool is_binary = false,
-                        const unsigned char *bin_data = nullptr,
-                        size_t bin_size = 0) {
-  size_t byteLength;
-  if (!ParseUnsignedProperty(&byteLength, err, o, "byteLength", true,
-                             "Buffer")) {
-    return false;
+  if (material.occlusionTexture.index > -1) {
+    detail::json texinfo;
+    SerializeGltfOcclusionTextureInfo(material.occlusionTexture, texinfo);
+    detail::JsonAddMember(o, "occlusionTexture", std::move(texinfo));
   }
 
-  // In glTF 2.0, uri is not mandatory anymore
-  buffer->uri.clear();
-  ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
+  if (material.emissiveTexture.index > -1) {
+    detail::json texinfo;
+    SerializeGltfTextureInfo(material.emissiveTexture, texinfo);
+    detail::JsonAddMember(o, "emissiveTexture", std::move(texinfo));
+  }
 
-  // having an empty uri for a non embedded image should not be valid
-  if (!is_binary && buffer->uri.empty()) {
-    if (err) {
-      (*err) += "'uri' is missing from non binary glTF file buffer.\n";
-    }
+  std::vector<double> default_emissiveFactor = {0.0, 0.0, 0.0};
+  if (!Equals(material.emissiveFactor, default_emissiveFactor)) {
+    SerializeNumberArrayProperty<double>("emissiveFactor",
+                                         material.emissiveFactor, o);
   }
 
-  detail::json_const_iterator type;
-  if (detail::FindMember(o, "type", type)) {
-    std::string typeStr;
-    if (detail::GetString(detail::GetValue(type), typeStr)) {
-      if (typeStr.compare("arraybuffer") == 0) {
-        // buffer.type = "arraybuffer";
-      }
+  {
+    detail::json pbrMetallicRoughness;
+    SerializeGltfPbrMetallicRoughness(material.pbrMetallicRoughness,
+                                      pbrMetallicRoughness);
+    // Issue 204
+    // Do not serialize `pbrMetallicRoughness` if pbrMetallicRoughness has all
+    // default values(json is null). Otherwise it will serialize to
+    // `pbrMetallicRoughness : null`, which cannot be read by other glTF
+    // importers (and validators).
+    //
+    if (!detail::JsonIsNull(pbrMetallicRoughness)) {
+      detail::JsonAddMember(o, "pbrMetallicRoughness",
+                            std::move(pbrMetallicRoughness));
     }
   }
 
-  if (is_binary) {
-    // Still binary glTF accepts external dataURI.
-    if (!buffer->uri.empty()) {
-      // First try embedded data URI.
-      if (IsDataURI(buffer->uri)) {
-        std::string mime_type;
-        if (!DecodeDataURI(&buffer->data, mime_type, buffer->uri, byteLength,
-                           true)) {
-          if (err) {
-            (*err) +=
-                "Failed to decode 'uri' : " + buffer->uri + " in Buffer\n";
-          }
-          return false;
-        }
-      } else {
-        // External .bin file.
-        std::string decoded_uri;
-        if (!uri_cb->decode(buffer->uri, &decoded_uri, uri_cb->user_data)) {
-          return false;
-        }
-        if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr,
-                              decoded_uri, basedir, /* required */ true,
-                              byteLength, /* checkSize */ true,
-                              /* max_file_size */ max_buffer_size, fs)) {
-          return false;
-        }
-      }
-    } else {
-      // load data from (embedded) binary data
+#if 0  // legacy way. just for the record.
+  if (material.values.size()) {
+    detail::json pbrMetallicRoughness;
+    SerializeParameterMap(material.values, pbrMetallicRoughness);
+    detail::JsonAddMember(o, "pbrMetallicRoughness", std::move(pbrMetallicRoughness));
+  }
 
-      if ((bin_size == 0) || (bin_data == nullptr)) {
-        if (err) {
-          (*err) +=
-              "Invalid binary data in `Buffer', or GLB with empty BIN chunk.\n";
-        }
-        return false;
-      }
+  SerializeParameterMap(material.additionalValues, o);
+#endif
 
-      if (byteLength > bin_size) {
-        if (err) {
-          std::stringstream ss;
-          ss << "Invalid `byteLength'. Must be equal or less than binary size: "
-                "`byteLength' = "
-             << byteLength << ", binary size = " << bin_size << std::endl;
-          (*err) += ss.str();
-        }
-        return false;
-      }
+  SerializeExtrasAndExtensions(material, o);
 
-      // Read buffer data
-      buffer->data.resize(static_cast<size_t>(byteLength));
-      memcpy(&(buffer->data.at(0)), bin_data, static_cast<size_t>(byteLength));
+  // MSFT_lod
+  if (!material.lods.empty()) {
+    detail::json_iterator it;
+    if (!detail::FindMember(o, "extensions", it)) {
+      detail::json extensions;
+      detail::JsonSetObject(extensions);
+      detail::JsonAddMember(o, "extensions", std::move(extensions));
+      detail::FindMember(o, "extensions", it);
     }
-
+    auto &extensions = detail::GetValue(it);
+    if (!detail::FindMember(extensions, "MSFT_lod", it)) {
+      detail::json lod;
+      detail::JsonSetObject(lod);
+      detail::JsonAddMember(extensions, "MSFT_lod", std::move(lod));
+      detail::FindMember(extensions, "MSFT_lod", it);
+    }
+    SerializeNumberArrayProperty<int>("ids", material.lods, detail::GetValue(it));
   } else {
-    if (IsDataURI(buffer->uri)) {
-      std::string mime_type;
-      if (!DecodeDataURI(&buffer->data, mime_type, buffer->uri, byteLength,
-                         true)) {
-        if (err) {
-          (*err) += "Failed to decode 'uri' : " + buffer->uri + " in Buffer\n";
-        }
-        return false;
-      }
-    } else {
-      // Assume external .bin file.
-      std::string decoded_uri;
-      if (!uri_cb->decode(buffer->uri, &decoded_uri, uri_cb->user_data)) {
-        return false;
+    detail::json_iterator ext_it;
+    if (detail::FindMember(o, "extensions", ext_it)) {
+      auto &extensions = detail::GetValue(ext_it);
+      detail::json_iterator lp_it;
+      if (detail::FindMember(extensions, "MSFT_lod", lp_it)) {
+        detail::Erase(extensions, lp_it);
       }
-      if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr, decoded_uri,
-                            basedir, /* required */ true, byteLength,
-                            /* checkSize */ true,
-                            /* max file size */ max_buffer_size, fs)) {
-        return false;
+      if (detail::IsEmpty(extensions)) {
+        detail::Erase(o, ext_it);
       }
     }
   }
+}
 
-  ParseStringProperty(&buffer->name, err, o, "name", false);
+static void SerializeGltfMesh(const Mesh &mesh, detail::json &o) {
+  detail::json primitives;
+  detail::JsonReserveArray(primitives, mesh.primitives.size());
+  for (unsigned int i = 0; i < mesh.primitives.size(); ++i) {
+    detail::json primitive;
+    const Primitive &gltfPrimitive = mesh.primitives[i];  // don't make a copy
+    {
+      detail::json attributes;
+      for (auto attrIt = gltfPrimitive.attributes.begin();
+           attrIt != gltfPrimitive.attributes.end(); ++attrIt) {
+        SerializeNumberProperty<int>(attrIt->first, attrIt->second, attributes);
+      }
 
-  ParseExtrasAndExtensions(buffer, err, o,
-                           store_original_json_for_extras_and_extensions);
+      detail::JsonAddMember(primitive, "attributes", std::move(attributes));
+    }
 
-  return true;
-}
+    // Indices is optional
+    if (gltfPrimitive.indices > -1) {
+      SerializeNumberProperty<int>("indices", gltfPrimitive.indices, primitive);
+    }
+    // Material is optional
+    if (gltfPrimitive.material > -1) {
+      SerializeNumberProperty<int>("material", gltfPrimitive.material,
+                                   primitive);
+    }
+    SerializeNumberProperty<int>("mode", gltfPrimitive.mode, primitive);
 
-static bool ParseBufferView(
-    BufferView *bufferView, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  int buffer = -1;
-  if (!ParseIntegerProperty(&buffer, err, o, "buffer", true, "BufferView")) {
-    return false;
-  }
+    // Morph targets
+    if (gltfPrimitive.targets.size()) {
+      detail::json targets;
+      detail::JsonReserveArray(targets, gltfPrimitive.targets.size());
+      for (unsigned int k = 0; k < gltfPrimitive.targets.size(); ++k) {
+        detail::json targetAttributes;
+        std::map<std::string, int> targetData = gltfPrimitive.targets[k];
+        for (std::map<std::string, int>::iterator attrIt = targetData.begin();
+             attrIt != targetData.end(); ++attrIt) {
+          SerializeNumberProperty<int>(attrIt->first, attrIt->second,
+                                       targetAttributes);
+        }
+        detail::JsonPushBack(targets, std::move(targetAttributes));
+      }
+      detail::JsonAddMember(primitive, "targets", std::move(targets));
+    }
 
-  size_t byteOffset = 0;
-  ParseUnsignedProperty(&byteOffset, err, o, "byteOffset", false);
+    SerializeExtrasAndExtensions(gltfPrimitive, primitive);
 
-  size_t byteLength = 1;
-  if (!ParseUnsignedProperty(&byteLength, err, o, "byteLength", true,
-                             "BufferView")) {
-    return false;
+    detail::JsonPushBack(primitives, std::move(primitive));
+  }
+
+  detail::JsonAddMember(o, "primitives", std::move(primitives));
+
+  if (mesh.weights.size()) {
+    SerializeNumberArrayProperty<double>("weights", mesh.weights, o);
   }
 
-  size_t byteStride = 0;
-  if (!ParseUnsignedProperty(&byteStride, err, o, "byteStride", false)) {
-    // Spec says: When byteStride of referenced bufferView is not defined, it
-    // means that accessor elements are tightly packed, i.e., effective stride
-    // equals the size of the element.
-    // We cannot determine the actual byteStride until Accessor are parsed, thus
-    // set 0(= tightly packed) here(as done in OpenGL's VertexAttribPoiner)
-    byteStride = 0;
+  if (mesh.name.size()) {
+    SerializeStringProperty("name", mesh.name, o);
   }
 
-  if ((byteStride > 252) || ((byteStride % 4) != 0)) {
-    if (err) {
-      std::stringstream ss;
-      ss << "Invalid `byteStride' value. `byteStride' must be the multiple of "
-            "4 : "
-         << byteStride << std::endl;
+  SerializeExtrasAndExtensions(mesh, o);
+}
 
-      (*err) += ss.str();
-    }
-    return false;
-  }
+static void SerializeSpotLight(const SpotLight &spot, detail::json &o) {
+  SerializeNumberProperty("innerConeAngle", spot.innerConeAngle, o);
+  SerializeNumberProperty("outerConeAngle", spot.outerConeAngle, o);
+  SerializeExtrasAndExtensions(spot, o);
+}
 
-  int target = 0;
-  ParseIntegerProperty(&target, err, o, "target", false);
-  if ((target == TINYGLTF_TARGET_ARRAY_BUFFER) ||
-      (target == TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER)) {
-    // OK
-  } else {
-    target = 0;
+static void SerializeGltfLight(const Light &light, detail::json &o) {
+  if (!light.name.empty()) SerializeStringProperty("name", light.name, o);
+  SerializeNumberProperty("intensity", light.intensity, o);
+  if (light.range > 0.0) {
+    SerializeNumberProperty("range", light.range, o);
   }
-  bufferView->target = target;
+  SerializeNumberArrayProperty("color", light.color, o);
+  SerializeStringProperty("type", light.type, o);
+  if (light.type == "spot") {
+    detail::json spot;
+    SerializeSpotLight(light.spot, spot);
+    detail::JsonAddMember(o, "spot", std::move(spot));
+  }
+  SerializeExtrasAndExtensions(light, o);
+}
 
-  ParseStringProperty(&bufferView->name, err, o, "name", false);
+static void SerializeGltfPositionalEmitter(const PositionalEmitter &positional,
+                                           detail::json &o) {
+  if (!TINYGLTF_DOUBLE_EQUAL(positional.coneInnerAngle, 6.283185307179586))
+    SerializeNumberProperty("coneInnerAngle", positional.coneInnerAngle, o);
+  if (!TINYGLTF_DOUBLE_EQUAL(positional.coneOuterAngle, 6.283185307179586))
+    SerializeNumberProperty("coneOuterAngle", positional.coneOuterAngle, o);
+  if (positional.coneOuterGain > 0.0)
+    SerializeNumberProperty("coneOuterGain", positional.coneOuterGain, o);
+  if (!TINYGLTF_DOUBLE_EQUAL(positional.maxDistance, 100.0))
+    SerializeNumberProperty("maxDistance", positional.maxDistance, o);
+  if (!TINYGLTF_DOUBLE_EQUAL(positional.refDistance, 1.0))
+    SerializeNumberProperty("refDistance", positional.refDistance, o);
+  if (!TINYGLTF_DOUBLE_EQUAL(positional.rolloffFactor, 1.0))
+    SerializeNumberProperty("rolloffFactor", positional.rolloffFactor, o);
 
-  ParseExtrasAndExtensions(bufferView, err, o,
-                           store_original_json_for_extras_and_extensions);
+  SerializeExtrasAndExtensions(positional, o);
+}
 
-  bufferView->buffer = buffer;
-  bufferView->byteOffset = byteOffset;
-  bufferView->byteLength = byteLength;
-  bufferView->byteStride = byteStride;
-  return true;
+static void SerializeGltfAudioEmitter(const AudioEmitter &emitter,
+                                      detail::json &o) {
+  if (!emitter.name.empty()) SerializeStringProperty("name", emitter.name, o);
+  if (!TINYGLTF_DOUBLE_EQUAL(emitter.gain, 1.0))
+    SerializeNumberProperty("gain", emitter.gain, o);
+  if (emitter.loop) SerializeNumberProperty("loop", emitter.loop, o);
+  if (emitter.playing) SerializeNumberProperty("playing", emitter.playing, o);
+  if (!emitter.type.empty()) SerializeStringProperty("type", emitter.type, o);
+  if (!emitter.distanceModel.empty())
+    SerializeStringProperty("distanceModel", emitter.distanceModel, o);
+  if (emitter.type == "positional") {
+    detail::json positional;
+    SerializeGltfPositionalEmitter(emitter.positional, positional);
+    detail::JsonAddMember(o, "positional", std::move(positional));
+  }
+  SerializeNumberProperty("source", emitter.source, o);
+  SerializeExtrasAndExtensions(emitter, o);
 }
 
-static bool ParseSparseAccessor(
-    Accessor::Sparse *sparse, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  sparse->isSparse = true;
+static void SerializeGltfAudioSource(const AudioSource &source,
+                                     detail::json &o) {
+  std::string name;
+  std::string uri;
+  std::string mimeType;  // (required if no uri) ["audio/mp3", "audio/ogg",
+                         // "audio/wav", "audio/m4a"]
 
-  int count = 0;
-  if (!ParseIntegerProperty(&count, err, o, "count", true, "SparseAccessor")) {
-    return false;
+  if (!source.name.empty()) SerializeStringProperty("name", source.name, o);
+  if (source.uri.empty()) {
+    SerializeStringProperty("mimeType", source.mimeType, o);
+    SerializeNumberProperty<int>("bufferView", source.bufferView, o);
+  } else {
+    SerializeStringProperty("uri", source.uri, o);
   }
+  SerializeExtrasAndExtensions(source, o);
+}
 
-  ParseExtrasAndExtensions(sparse, err, o,
-                           store_original_json_for_extras_and_extensions);
+static void SerializeGltfNode(const Node &node, detail::json &o) {
+  if (node.translation.size() > 0) {
+    SerializeNumberArrayProperty<double>("translation", node.translation, o);
+  }
+  if (node.rotation.size() > 0) {
+    SerializeNumberArrayProperty<double>("rotation", node.rotation, o);
+  }
+  if (node.scale.size() > 0) {
+    SerializeNumberArrayProperty<double>("scale", node.scale, o);
+  }
+  if (node.matrix.size() > 0) {
+    SerializeNumberArrayProperty<double>("matrix", node.matrix, o);
+  }
+  if (node.mesh != -1) {
+    SerializeNumberProperty<int>("mesh", node.mesh, o);
+  }
 
-  detail::json_const_iterator indices_iterator;
-  detail::json_const_iterator values_iterator;
-  if (!detail::FindMember(o, "indices", indices_iterator)) {
-    (*err) = "the sparse object of this accessor doesn't have indices";
-    return false;
+  if (node.skin != -1) {
+    SerializeNumberProperty<int>("skin", node.skin, o);
   }
 
-  if (!detail::FindMember(o, "values", values_iterator)) {
-    (*err) = "the sparse object of this accessor doesn't have values";
-    return false;
+  if (node.camera != -1) {
+    SerializeNumberProperty<int>("camera", node.camera, o);
   }
 
-  const detail::json &indices_obj = detail::GetValue(indices_iterator);
-  const detail::json &values_obj = detail::GetValue(values_iterator);
+  if (node.weights.size() > 0) {
+    SerializeNumberArrayProperty<double>("weights", node.weights, o);
+  }
 
-  int indices_buffer_view = 0, component_type = 0;
-  size_t indices_byte_offset = 0;
-  if (!ParseIntegerProperty(&indices_buffer_view, err, indices_obj,
-                            "bufferView", true, "SparseAccessor")) {
-    return false;
+  SerializeExtrasAndExtensions(node, o);
+
+  // Note(agnat): If the asset was loaded from disk, the node may already
+  // contain the KHR_lights_punctual extension. If it was constructed in
+  // memory it does not. In any case we update the JSON property using
+  // the value from the struct. Last, if the node does not have a light
+  // reference but the extension is still present, we remove it.
+  if (node.light != -1) {
+    detail::json_iterator it;
+    if (!detail::FindMember(o, "extensions", it)) {
+      detail::json extensions;
+      detail::JsonSetObject(extensions);
+      detail::JsonAddMember(o, "extensions", std::move(extensions));
+      detail::FindMember(o, "extensions", it);
+    }
+    auto &extensions = detail::GetValue(it);
+    if (!detail::FindMember(extensions, "KHR_lights_punctual", it)) {
+      detail::json lights_punctual;
+      detail::JsonSetObject(lights_punctual);
+      detail::JsonAddMember(extensions, "KHR_lights_punctual",
+                            std::move(lights_punctual));
+      detail::FindMember(extensions, "KHR_lights_punctual", it);
+    }
+    SerializeNumberProperty("light", node.light, detail::GetValue(it));
+  } else {
+    // node has no light ref (any longer)... so we clean up
+    detail::json_iterator ext_it;
+    if (detail::FindMember(o, "extensions", ext_it)) {
+      auto &extensions = detail::GetValue(ext_it);
+      detail::json_iterator lp_it;
+      if (detail::FindMember(extensions, "KHR_lights_punctual", lp_it)) {
+        detail::Erase(extensions, lp_it);
+      }
+      if (detail::IsEmpty(extensions)) {
+        detail::Erase(o, ext_it);
+      }
+    }
   }
-  ParseUnsignedProperty(&indices_byte_offset, err, indices_obj, "byteOffset",
-                       false);
-  if (!ParseIntegerProperty(&component_type, err, indices_obj, "componentType",
-                            true, "SparseAccessor")) {
-    return false;
+
+  // KHR_audio
+  if (node.emitter != -1) {
+    detail::json_iterator it;
+    if (!detail::FindMember(o, "extensions", it)) {
+      detail::json extensions;
+      detail::JsonSetObject(extensions);
+      detail::JsonAddMember(o, "extensions", std::move(extensions));
+      detail::FindMember(o, "extensions", it);
+    }
+    auto &extensions = detail::GetValue(it);
+    if (!detail::FindMember(extensions, "KHR_audio", it)) {
+      detail::json audio;
+      detail::JsonSetObject(audio);
+      detail::JsonAddMember(extensions, "KHR_audio", std::move(audio));
+      detail::FindMember(extensions, "KHR_audio", it);
+    }
+    SerializeNumberProperty("emitter", node.emitter, detail::GetValue(it));
+  } else {
+    detail::json_iterator ext_it;
+    if (detail::FindMember(o, "extensions", ext_it)) {
+      auto &extensions = detail::GetValue(ext_it);
+      detail::json_iterator lp_it;
+      if (detail::FindMember(extensions, "KHR_audio", lp_it)) {
+        detail::Erase(extensions, lp_it);
+      }
+      if (detail::IsEmpty(extensions)) {
+        detail::Erase(o, ext_it);
+      }
+    }
   }
 
-  int values_buffer_view = 0;
-  size_t values_byte_offset = 0;
-  if (!ParseIntegerProperty(&values_buffer_view, err, values_obj, "bufferView",
-                            true, "SparseAccessor")) {
-    return false;
+  // MSFT_lod
+  if (!node.lods.empty()) {
+    detail::json_iterator it;
+    if (!detail::FindMember(o, "extensions", it)) {
+      detail::json extensions;
+      detail::JsonSetObject(extensions);
+      detail::JsonAddMember(o, "extensions", std::move(extensions));
+      detail::FindMember(o, "extensions", it);
+    }
+    auto &extensions = detail::GetValue(it);
+    if (!detail::FindMember(extensions, "MSFT_lod", it)) {
+      detail::json lod;
+      detail::JsonSetObject(lod);
+      detail::JsonAddMember(extensions, "MSFT_lod", std::move(lod));
+      detail::FindMember(extensions, "MSFT_lod", it);
+    }
+    SerializeNumberArrayProperty<int>("ids", node.lods, detail::GetValue(it));
+  } else {
+    detail::json_iterator ext_it;
+    if (detail::FindMember(o, "extensions", ext_it)) {
+      auto &extensions = detail::GetValue(ext_it);
+      detail::json_iterator lp_it;
+      if (detail::FindMember(extensions, "MSFT_lod", lp_it)) {
+        detail::Erase(extensions, lp_it);
+      }
+      if (detail::IsEmpty(extensions)) {
+        detail::Erase(o, ext_it);
+      }
+    }
   }
-  ParseUnsignedProperty(&values_byte_offset, err, values_obj, "byteOffset",
-                       false);
 
-  sparse->count = count;
-  sparse->indices.bufferView = indices_buffer_view;
-  sparse->indices.byteOffset = indices_byte_offset;
-  sparse->indices.componentType = component_type;
-  ParseExtrasAndExtensions(&sparse->indices, err, indices_obj,
-                           store_original_json_for_extras_and_extensions);
+  if (!node.name.empty()) SerializeStringProperty("name", node.name, o);
+  SerializeNumberArrayProperty<int>("children", node.children, o);
+}
 
-  sparse->values.bufferView = values_buffer_view;
-  sparse->values.byteOffset = values_byte_offset;
-  ParseExtrasAndExtensions(&sparse->values, err, values_obj,
-                           store_original_json_for_extras_and_extensions);
+static void SerializeGltfSampler(const Sampler &sampler, detail::json &o) {
+  if (!sampler.name.empty()) {
+    SerializeStringProperty("name", sampler.name, o);
+  }
+  if (sampler.magFilter != -1) {
+    SerializeNumberProperty("magFilter", sampler.magFilter, o);
+  }
+  if (sampler.minFilter != -1) {
+    SerializeNumberProperty("minFilter", sampler.minFilter, o);
+  }
+  // SerializeNumberProperty("wrapR", sampler.wrapR, o);
+  SerializeNumberProperty("wrapS", sampler.wrapS, o);
+  SerializeNumberProperty("wrapT", sampler.wrapT, o);
 
-  return true;
+  SerializeExtrasAndExtensions(sampler, o);
 }
 
-static bool ParseAccessor(Accessor *accessor, std::string *err,
-                          const detail::json &o,
-                          bool store_original_json_for_extras_and_extensions) {
-  int bufferView = -1;
-  ParseIntegerProperty(&bufferView, err, o, "bufferView", false, "Accessor");
-
-  size_t byteOffset = 0;
-  ParseUnsignedProperty(&byteOffset, err, o, "byteOffset", false, "Accessor");
+static void SerializeGltfOrthographicCamera(const OrthographicCamera &camera,
+                                            detail::json &o) {
+  SerializeNumberProperty("zfar", camera.zfar, o);
+  SerializeNumberProperty("znear", camera.znear, o);
+  SerializeNumberProperty("xmag", camera.xmag, o);
+  SerializeNumberProperty("ymag", camera.ymag, o);
 
-  bool normalized = false;
-  ParseBooleanProperty(&normalized, err, o, "normalized", false, "Accessor");
+  SerializeExtrasAndExtensions(camera, o);
+}
 
-  size_t componentType = 0;
-  if (!ParseUnsignedProperty(&componentType, err, o, "componentType", true,
-                             "Accessor")) {
-    return false;
+static void SerializeGltfPerspectiveCamera(const PerspectiveCamera &camera,
+                                           detail::json &o) {
+  SerializeNumberProperty("zfar", camera.zfar, o);
+  SerializeNumberProperty("znear", camera.znear, o);
+  if (camera.aspectRatio > 0) {
+    SerializeNumberProperty("aspectRatio", camera.aspectRatio, o);
   }
 
-  size_t count = 0;
-  if (!ParseUnsignedProperty(&count, err, o, "count", true, "Accessor")) {
-    return false;
+  if (camera.yfov > 0) {
+    SerializeNumberProperty("yfov", camera.yfov, o);
   }
 
-  std::string type;
-  if (!ParseStringProperty(&type, err, o, "type", true, "Accessor")) {
-    return false;
+  SerializeExtrasAndExtensions(camera, o);
+}
+
+static void SerializeGltfCamera(const Camera &camera, detail::json &o) {
+  SerializeStringProperty("type", camera.type, o);
+  if (!camera.name.empty()) {
+    SerializeStringProperty("name", camera.name, o);
   }
 
-  if (type.compare("SCALAR") == 0) {
-    accessor->type = TINYGLTF_TYPE_SCALAR;
-  } else if (type.compare("VEC2") == 0) {
-    accessor->type = TINYGLTF_TYPE_VEC2;
-  } else if (type.compare("VEC3") == 0) {
-    accessor->type = TINYGLTF_TYPE_VEC3;
-  } else if (type.compare("VEC4") == 0) {
-    accessor->type = TINYGLTF_TYPE_VEC4;
-  } else if (type.compare("MAT2") == 0) {
-    accessor->type = TINYGLTF_TYPE_MAT2;
-  } else if (type.compare("MAT3") == 0) {
-    accessor->type = TINYGLTF_TYPE_MAT3;
-  } else if (type.compare("MAT4") == 0) {
-    accessor->type = TINYGLTF_TYPE_MAT4;
+  if (camera.type.compare("orthographic") == 0) {
+    detail::json orthographic;
+    SerializeGltfOrthographicCamera(camera.orthographic, orthographic);
+    detail::JsonAddMember(o, "orthographic", std::move(orthographic));
+  } else if (camera.type.compare("perspective") == 0) {
+    detail::json perspective;
+    SerializeGltfPerspectiveCamera(camera.perspective, perspective);
+    detail::JsonAddMember(o, "perspective", std::move(perspective));
   } else {
-    std::stringstream ss;
-    ss << "Unsupported `type` for accessor object. Got \"" << type << "\"\n";
-    if (err) {
-      (*err) += ss.str();
-    }
-    return false;
+    // ???
   }
 
-  ParseStringProperty(&accessor->name, err, o, "name", false);
-
-  accessor->minValues.clear();
-  accessor->maxValues.clear();
-  ParseNumberArrayProperty(&accessor->minValues, err, o, "min", false,
-                           "Accessor");
-
-  ParseNumberArrayProperty(&accessor->maxValues, err, o, "max", false,
-                           "Accessor");
-
-  accessor->count = count;
-  accessor->bufferView = bufferView;
-  accessor->byteOffset = byteOffset;
-  accessor->normalized = normalized;
-  {
-    if (componentType >= TINYGLTF_COMPONENT_TYPE_BYTE &&
-        componentType <= TINYGLTF_COMPONENT_TYPE_DOUBLE) {
-      // OK
-      accessor->componentType = int(componentType);
-    } else {
-      std::stringstream ss;
-      ss << "Invalid `componentType` in accessor. Got " << componentType
-         << "\n";
-      if (err) {
-        (*err) += ss.str();
-      }
-      return false;
-    }
-  }
+  SerializeExtrasAndExtensions(camera, o);
+}
 
-  ParseExtrasAndExtensions(accessor, err, o,
-                           store_original_json_for_extras_and_extensions);
+static void SerializeGltfScene(const Scene &scene, detail::json &o) {
+  SerializeNumberArrayProperty<int>("nodes", scene.nodes, o);
 
-  // check if accessor has a "sparse" object:
-  detail::json_const_iterator iterator;
-  if (detail::FindMember(o, "sparse", iterator)) {
-    // here this accessor has a "sparse" subobject
-    return ParseSparseAccessor(&accessor->sparse, err,
-                               detail::GetValue(iterator),
-                               store_original_json_for_extras_and_extensions);
+  if (scene.name.size()) {
+    SerializeStringProperty("name", scene.name, o);
   }
+  SerializeExtrasAndExtensions(scene, o);
 
-  return true;
-}
-
-#ifdef TINYGLTF_ENABLE_DRACO
-
-static void DecodeIndexBuffer(draco::Mesh *mesh, size_t componentSize,
-                              std::vector<uint8_t> &outBuffer) {
-  if (componentSize == 4) {
-    assert(sizeof(mesh->face(draco::FaceIndex(0))[0]) == componentSize);
-    memcpy(outBuffer.data(), &mesh->face(draco::FaceIndex(0))[0],
-           outBuffer.size());
+  // KHR_audio
+  if (!scene.audioEmitters.empty()) {
+    detail::json_iterator it;
+    if (!detail::FindMember(o, "extensions", it)) {
+      detail::json extensions;
+      detail::JsonSetObject(extensions);
+      detail::JsonAddMember(o, "extensions", std::move(extensions));
+      detail::FindMember(o, "extensions", it);
+    }
+    auto &extensions = detail::GetValue(it);
+    if (!detail::FindMember(extensions, "KHR_audio", it)) {
+      detail::json audio;
+      detail::JsonSetObject(audio);
+      detail::JsonAddMember(extensions, "KHR_audio", std::move(audio));
+      detail::FindMember(o, "KHR_audio", it);
+    }
+    SerializeNumberArrayProperty("emitters", scene.audioEmitters,
+                                 detail::GetValue(it));
   } else {
-    size_t faceStride = componentSize * 3;
-    for (draco::FaceIndex f(0); f < mesh->num_faces(); ++f) {
-      const draco::Mesh::Face &face = mesh->face(f);
-      if (componentSize == 2) {
-        uint16_t indices[3] = {(uint16_t)face[0].value(),
-                               (uint16_t)face[1].value(),
-                               (uint16_t)face[2].value()};
-        memcpy(outBuffer.data() + f.value() * faceStride, &indices[0],
-               faceStride);
-      } else {
-        uint8_t indices[3] = {(uint8_t)face[0].value(),
-                              (uint8_t)face[1].value(),
-                              (uint8_t)face[2].value()};
-        memcpy(outBuffer.data() + f.value() * faceStride, &indices[0],
-               faceStride);
+    detail::json_iterator ext_it;
+    if (detail::FindMember(o, "extensions", ext_it)) {
+      auto &extensions = detail::GetValue(ext_it);
+      detail::json_iterator lp_it;
+      if (detail::FindMember(extensions, "KHR_audio", lp_it)) {
+        detail::Erase(extensions, lp_it);
+      }
+      if (detail::IsEmpty(extensions)) {
+        detail::Erase(o, ext_it);
       }
     }
   }
 }
 
-template <typename T>
-static bool GetAttributeForAllPoints(draco::Mesh *mesh,
-                                     const draco::PointAttribute *pAttribute,
-                                     std::vector<uint8_t> &outBuffer) {
-  size_t byteOffset = 0;
-  T values[4] = {0, 0, 0, 0};
-  for (draco::PointIndex i(0); i < mesh->num_points(); ++i) {
-    const draco::AttributeValueIndex val_index = pAttribute->mapped_index(i);
-    if (!pAttribute->ConvertValue<T>(val_index, pAttribute->num_components(),
-                                     values))
-      return false;
-
-    memcpy(outBuffer.data() + byteOffset, &values[0],
-           sizeof(T) * pAttribute->num_components());
-    byteOffset += sizeof(T) * pAttribute->num_components();
-  }
-
-  return true;
-}
+static void SerializeGltfSkin(const Skin &skin, detail::json &o) {
+  // required
+  SerializeNumberArrayProperty<int>("joints", skin.joints, o);
 
-static bool GetAttributeForAllPoints(uint32_t componentType, draco::Mesh *mesh,
-                                     const draco::PointAttribute *pAttribute,
-                                     std::vector<uint8_t> &outBuffer) {
-  bool decodeResult = false;
-  switch (componentType) {
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-      decodeResult =
-          GetAttributeForAllPoints<uint8_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_BYTE:
-      decodeResult =
-          GetAttributeForAllPoints<int8_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-      decodeResult =
-          GetAttributeForAllPoints<uint16_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_SHORT:
-      decodeResult =
-          GetAttributeForAllPoints<int16_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_INT:
-      decodeResult =
-          GetAttributeForAllPoints<int32_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-      decodeResult =
-          GetAttributeForAllPoints<uint32_t>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_FLOAT:
-      decodeResult =
-          GetAttributeForAllPoints<float>(mesh, pAttribute, outBuffer);
-      break;
-    case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-      decodeResult =
-          GetAttributeForAllPoints<double>(mesh, pAttribute, outBuffer);
-      break;
-    default:
-      return false;
+  if (skin.inverseBindMatrices >= 0) {
+    SerializeNumberProperty("inverseBindMatrices", skin.inverseBindMatrices, o);
   }
 
-  return decodeResult;
+  if (skin.skeleton >= 0) {
+    SerializeNumberProperty("skeleton", skin.skeleton, o);
+  }
+
+  if (skin.name.size()) {
+    SerializeStringProperty("name", skin.name, o);
+  }
+
+  SerializeExtrasAndExtensions(skin, o);
 }
 
-static bool ParseDracoExtension(Primitive *primitive, Model *model,
-                                std::string *err, std::string *warn,
-                                const Value &dracoExtensionValue,
-                                ParseStrictness strictness) {
-  (void)err;
-  auto bufferViewValue = dracoExtensionValue.Get("bufferView");
-  if (!bufferViewValue.IsInt()) return false;
-  auto attributesValue = dracoExtensionValue.Get("attributes");
-  if (!attributesValue.IsObject()) return false;
-
-  auto attributesObject = attributesValue.Get<Value::Object>();
-  int bufferView = bufferViewValue.Get<int>();
-
-  BufferView &view = model->bufferViews[bufferView];
-  Buffer &buffer = model->buffers[view.buffer];
-  // BufferView has already been decoded
-  if (view.dracoDecoded) return true;
-  view.dracoDecoded = true;
-
-  const char *bufferViewData =
-      reinterpret_cast<const char *>(buffer.data.data() + view.byteOffset);
-  size_t bufferViewSize = view.byteLength;
-
-  // decode draco
-  draco::DecoderBuffer decoderBuffer;
-  decoderBuffer.Init(bufferViewData, bufferViewSize);
-  draco::Decoder decoder;
-  auto decodeResult = decoder.DecodeMeshFromBuffer(&decoderBuffer);
-  if (!decodeResult.ok()) {
-    return false;
-  }
-  const std::unique_ptr<draco::Mesh> &mesh = decodeResult.value();
-
-  // create new bufferView for indices
-  if (primitive->indices >= 0) {
-    if (strictness == ParseStrictness::Permissive) {
-      const draco::PointIndex::ValueType numPoint = mesh->num_points();
-      // handle the situation where the stored component type does not match the
-      // required type for the actual number of stored points
-      int supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-      if (numPoint < static_cast<draco::PointIndex::ValueType>(
-                         std::numeric_limits<uint8_t>::max())) {
-        supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
-      } else if (
-          numPoint < static_cast<draco::PointIndex::ValueType>(
-                         std::numeric_limits<uint16_t>::max())) {
-        supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
-      } else {
-        supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
-      }
+static void SerializeGltfTexture(const Texture &texture, detail::json &o) {
+  if (texture.sampler > -1) {
+    SerializeNumberProperty("sampler", texture.sampler, o);
+  }
+  if (texture.source > -1) {
+    SerializeNumberProperty("source", texture.source, o);
+  }
+  if (texture.name.size()) {
+    SerializeStringProperty("name", texture.name, o);
+  }
+  SerializeExtrasAndExtensions(texture, o);
+}
 
-      if (supposedComponentType > model->accessors[primitive->indices].componentType) {
-        if (warn) {
-          (*warn) +=
-              "GLTF component type " + std::to_string(model->accessors[primitive->indices].componentType) +
-              " is not sufficient for number of stored points,"
-              " treating as " + std::to_string(supposedComponentType) + "\n";
-        }
-        model->accessors[primitive->indices].componentType = supposedComponentType;
-      }
+///
+/// Serialize all properties except buffers and images.
+///
+static void SerializeGltfModel(const Model *model, detail::json &o) {
+  // ACCESSORS
+  if (model->accessors.size()) {
+    detail::json accessors;
+    detail::JsonReserveArray(accessors, model->accessors.size());
+    for (unsigned int i = 0; i < model->accessors.size(); ++i) {
+      detail::json accessor;
+      SerializeGltfAccessor(model->accessors[i], accessor);
+      detail::JsonPushBack(accessors, std::move(accessor));
     }
+    detail::JsonAddMember(o, "accessors", std::move(accessors));
+  }
 
-    int32_t componentSize = GetComponentSizeInBytes(
-        model->accessors[primitive->indices].componentType);
-    Buffer decodedIndexBuffer;
-    decodedIndexBuffer.data.resize(mesh->num_faces() * 3 * componentSize);
+  // ANIMATIONS
+  if (model->animations.size()) {
+    detail::json animations;
+    detail::JsonReserveArray(animations, model->animations.size());
+    for (unsigned int i = 0; i < model->animations.size(); ++i) {
+      if (model->animations[i].channels.size()) {
+        detail::json animation;
+        SerializeGltfAnimation(model->animations[i], animation);
+        detail::JsonPushBack(animations, std::move(animation));
+      }
+    }
 
-    DecodeIndexBuffer(mesh.get(), componentSize, decodedIndexBuffer.data);
+    detail::JsonAddMember(o, "animations", std::move(animations));
+  }
 
-    model->buffers.emplace_back(std::move(decodedIndexBuffer));
+  // ASSET
+  detail::json asset;
+  SerializeGltfAsset(model->asset, asset);
+  detail::JsonAddMember(o, "asset", std::move(asset));
 
-    BufferView decodedIndexBufferView;
-    decodedIndexBufferView.buffer = int(model->buffers.size() - 1);
-    decodedIndexBufferView.byteLength =
-        int(mesh->num_faces() * 3 * componentSize);
-    decodedIndexBufferView.byteOffset = 0;
-    decodedIndexBufferView.byteStride = 0;
-    decodedIndexBufferView.target = TINYGLTF_TARGET_ARRAY_BUFFER;
-    model->bufferViews.emplace_back(std::move(decodedIndexBufferView));
+  // BUFFERVIEWS
+  if (model->bufferViews.size()) {
+    detail::json bufferViews;
+    detail::JsonReserveArray(bufferViews, model->bufferViews.size());
+    for (unsigned int i = 0; i < model->bufferViews.size(); ++i) {
+      detail::json bufferView;
+      SerializeGltfBufferView(model->bufferViews[i], bufferView);
+      detail::JsonPushBack(bufferViews, std::move(bufferView));
+    }
+    detail::JsonAddMember(o, "bufferViews", std::move(bufferViews));
+  }
 
-    model->accessors[primitive->indices].bufferView =
-        int(model->bufferViews.size() - 1);
-    model->accessors[primitive->indices].count = int(mesh->num_faces() * 3);
+  // Extensions required
+  if (model->extensionsRequired.size()) {
+    SerializeStringArrayProperty("extensionsRequired",
+                                 model->extensionsRequired, o);
   }
 
-  for (const auto &attribute : attributesObject) {
-    if (!attribute.second.IsInt()) return false;
-    auto primitiveAttribute = primitive->attributes.find(attribute.first);
-    if (primitiveAttribute == primitive->attributes.end()) return false;
+  // MATERIALS
+  if (model->materials.size()) {
+    detail::json materials;
+    detail::JsonReserveArray(materials, model->materials.size());
+    for (unsigned int i = 0; i < model->materials.size(); ++i) {
+      detail::json material;
+      SerializeGltfMaterial(model->materials[i], material);
 
-    int dracoAttributeIndex = attribute.second.Get<int>();
-    const auto pAttribute = mesh->GetAttributeByUniqueId(dracoAttributeIndex);
-    const auto componentType =
-        model->accessors[primitiveAttribute->second].componentType;
+      if (detail::JsonIsNull(material)) {
+        // Issue 294.
+        // `material` does not have any required parameters
+        // so the result may be null(unmodified) when all material parameters
+        // have default value.
+        //
+        // null is not allowed thus we create an empty JSON object.
+        detail::JsonSetObject(material);
+      }
+      detail::JsonPushBack(materials, std::move(material));
+    }
+    detail::JsonAddMember(o, "materials", std::move(materials));
+  }
 
-    // Create a new buffer for this decoded buffer
-    Buffer decodedBuffer;
-    size_t bufferSize = mesh->num_points() * pAttribute->num_components() *
-                        GetComponentSizeInBytes(componentType);
-    decodedBuffer.data.resize(bufferSize);
+  // MESHES
+  if (model->meshes.size()) {
+    detail::json meshes;
+    detail::JsonReserveArray(meshes, model->meshes.size());
+    for (unsigned int i = 0; i < model->meshes.size(); ++i) {
+      detail::json mesh;
+      SerializeGltfMesh(model->meshes[i], mesh);
+      detail::JsonPushBack(meshes, std::move(mesh));
+    }
+    detail::JsonAddMember(o, "meshes", std::move(meshes));
+  }
 
-    if (!GetAttributeForAllPoints(componentType, mesh.get(), pAttribute,
-                                  decodedBuffer.data))
-      return false;
+  // NODES
+  if (model->nodes.size()) {
+    detail::json nodes;
+    detail::JsonReserveArray(nodes, model->nodes.size());
+    for (unsigned int i = 0; i < model->nodes.size(); ++i) {
+      detail::json node;
+      SerializeGltfNode(model->nodes[i], node);
 
-    model->buffers.emplace_back(std::move(decodedBuffer));
+      if (detail::JsonIsNull(node)) {
+        // Issue 457.
+        // `node` does not have any required parameters,
+        // so the result may be null(unmodified) when all node parameters
+        // have default value.
+        //
+        // null is not allowed thus we create an empty JSON object.
+        detail::JsonSetObject(node);
+      }
+      detail::JsonPushBack(nodes, std::move(node));
+    }
+    detail::JsonAddMember(o, "nodes", std::move(nodes));
+  }
 
-    BufferView decodedBufferView;
-    decodedBufferView.buffer = int(model->buffers.size() - 1);
-    decodedBufferView.byteLength = bufferSize;
-    decodedBufferView.byteOffset = pAttribute->byte_offset();
-    decodedBufferView.byteStride = pAttribute->byte_stride();
-    decodedBufferView.target = primitive->indices >= 0
-                                   ? TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER
-                                   : TINYGLTF_TARGET_ARRAY_BUFFER;
-    model->bufferViews.emplace_back(std::move(decodedBufferView));
+  // SCENE
+  if (model->defaultScene > -1) {
+    SerializeNumberProperty<int>("scene", model->defaultScene, o);
+  }
 
-    model->accessors[primitiveAttribute->second].bufferView =
-        int(model->bufferViews.size() - 1);
-    model->accessors[primitiveAttribute->second].count =
-        int(mesh->num_points());
+  // SCENES
+  if (model->scenes.size()) {
+    detail::json scenes;
+    detail::JsonReserveArray(scenes, model->scenes.size());
+    for (unsigned int i = 0; i < model->scenes.size(); ++i) {
+      detail::json currentScene;
+      SerializeGltfScene(model->scenes[i], currentScene);
+      if (detail::JsonIsNull(currentScene)) {
+        // Issue 464.
+        // `scene` does not have any required parameters,
+        // so the result may be null(unmodified) when all scene parameters
+        // have default value.
+        //
+        // null is not allowed thus we create an empty JSON object.
+        detail::JsonSetObject(currentScene);
+      }
+      detail::JsonPushBack(scenes, std::move(currentScene));
+    }
+    detail::JsonAddMember(o, "scenes", std::move(scenes));
   }
 
-  return true;
-}
-#endif
+  // SKINS
+  if (model->skins.size()) {
+    detail::json skins;
+    detail::JsonReserveArray(skins, model->skins.size());
+    for (unsigned int i = 0; i < model->skins.size(); ++i) {
+      detail::json skin;
+      SerializeGltfSkin(model->skins[i], skin);
+      detail::JsonPushBack(skins, std::move(skin));
+    }
+    detail::JsonAddMember(o, "skins", std::move(skins));
+  }
 
-static bool ParsePrimitive(Primitive *primitive, Model *model,
-                           std::string *err, std::string *warn,
-                           const detail::json &o,
-                           bool store_original_json_for_extras_and_extensions,
-                           ParseStrictness strictness) {
-  int material = -1;
-  ParseIntegerProperty(&material, err, o, "material", false);
-  primitive->material = material;
+  // TEXTURES
+  if (model->textures.size()) {
+    detail::json textures;
+    detail::JsonReserveArray(textures, model->textures.size());
+    for (unsigned int i = 0; i < model->textures.size(); ++i) {
+      detail::json texture;
+      SerializeGltfTexture(model->textures[i], texture);
+      detail::JsonPushBack(textures, std::move(texture));
+    }
+    detail::JsonAddMember(o, "textures", std::move(textures));
+  }
 
-  int mode = TINYGLTF_MODE_TRIANGLES;
-  ParseIntegerProperty(&mode, err, o, "mode", false);
-  primitive->mode = mode;  // Why only triangles were supported ?
+  // SAMPLERS
+  if (model->samplers.size()) {
+    detail::json samplers;
+    detail::JsonReserveArray(samplers, model->samplers.size());
+    for (unsigned int i = 0; i < model->samplers.size(); ++i) {
+      detail::json sampler;
+      SerializeGltfSampler(model->samplers[i], sampler);
+      detail::JsonPushBack(samplers, std::move(sampler));
+    }
+    detail::JsonAddMember(o, "samplers", std::move(samplers));
+  }
 
-  int indices = -1;
-  ParseIntegerProperty(&indices, err, o, "indices", false);
-  primitive->indices = indices;
-  if (!ParseStringIntegerProperty(&primitive->attributes, err, o, "attributes",
-                                  true, "Primitive")) {
-    return false;
+  // CAMERAS
+  if (model->cameras.size()) {
+    detail::json cameras;
+    detail::JsonReserveArray(cameras, model->cameras.size());
+    for (unsigned int i = 0; i < model->cameras.size(); ++i) {
+      detail::json camera;
+      SerializeGltfCamera(model->cameras[i], camera);
+      detail::JsonPushBack(cameras, std::move(camera));
+    }
+    detail::JsonAddMember(o, "cameras", std::move(cameras));
   }
 
-  // Look for morph targets
-  detail::json_const_iterator targetsObject;
-  if (detail::FindMember(o, "targets", targetsObject) &&
-      detail::IsArray(detail::GetValue(targetsObject))) {
-    auto targetsObjectEnd = detail::ArrayEnd(detail::GetValue(targetsObject));
-    for (detail::json_const_array_iterator i =
-             detail::ArrayBegin(detail::GetValue(targetsObject));
-         i != targetsObjectEnd; ++i) {
-      std::map<std::string, int> targetAttribues;
+  // EXTRAS & EXTENSIONS
+  SerializeExtrasAndExtensions(*model, o);
 
-      const detail::json &dict = *i;
-      if (detail::IsObject(dict)) {
-        detail::json_const_iterator dictIt(detail::ObjectBegin(dict));
-        detail::json_const_iterator dictItEnd(detail::ObjectEnd(dict));
+  auto extensionsUsed = model->extensionsUsed;
+
+  // LIGHTS as KHR_lights_punctual
+  if (model->lights.size()) {
+    detail::json lights;
+    detail::JsonReserveArray(lights, model->lights.size());
+    for (unsigned int i = 0; i < model->lights.size(); ++i) {
+      detail::json light;
+      SerializeGltfLight(model->lights[i], light);
+      detail::JsonPushBack(lights, std::move(light));
+    }
+    detail::json khr_lights_cmn;
+    detail::JsonAddMember(khr_lights_cmn, "lights", std::move(lights));
+    detail::json ext_j;
+
+    {
+      detail::json_const_iterator it;
+      if (detail::FindMember(o, "extensions", it)) {
+        detail::JsonAssign(ext_j, detail::GetValue(it));
+      }
+    }
+
+    detail::JsonAddMember(ext_j, "KHR_lights_punctual",
+                          std::move(khr_lights_cmn));
+
+    detail::JsonAddMember(o, "extensions", std::move(ext_j));
+
+    // Also add "KHR_lights_punctual" to `extensionsUsed`
+    {
+      auto has_khr_lights_punctual =
+          std::find_if(extensionsUsed.begin(), extensionsUsed.end(),
+                       [](const std::string &s) {
+                         return (s.compare("KHR_lights_punctual") == 0);
+                       });
 
-        for (; dictIt != dictItEnd; ++dictIt) {
-          int iVal;
-          if (detail::GetInt(detail::GetValue(dictIt), iVal))
-            targetAttribues[detail::GetKey(dictIt)] = iVal;
-        }
-        primitive->targets.emplace_back(std::move(targetAttribues));
+      if (has_khr_lights_punctual == extensionsUsed.end()) {
+        extensionsUsed.push_back("KHR_lights_punctual");
       }
     }
   }
 
-  ParseExtrasAndExtensions(primitive, err, o,
-                           store_original_json_for_extras_and_extensions);
+  // KHR_audio
+  if (!model->audioEmitters.empty() || !model->audioSources.empty()) {
+    detail::json emitters;
+    detail::JsonReserveArray(emitters, model->audioEmitters.size());
+    for (unsigned int i = 0; i < model->audioEmitters.size(); ++i) {
+      detail::json emitter;
+      SerializeGltfAudioEmitter(model->audioEmitters[i], emitter);
+      detail::JsonPushBack(emitters, std::move(emitter));
+    }
+    detail::json khr_audio_cmn;
+    detail::JsonAddMember(khr_audio_cmn, "emitters", std::move(emitters));
 
-#ifdef TINYGLTF_ENABLE_DRACO
-  auto dracoExtension =
-      primitive->extensions.find("KHR_draco_mesh_compression");
-  if (dracoExtension != primitive->extensions.end()) {
-    ParseDracoExtension(primitive, model, err, warn, dracoExtension->second, strictness);
-  }
-#else
-  (void)model;
-  (void)warn;
-  (void)strictness;
-#endif
+    detail::json sources;
+    detail::JsonReserveArray(sources, model->audioSources.size());
+    for (unsigned int i = 0; i < model->audioSources.size(); ++i) {
+      detail::json source;
+      SerializeGltfAudioSource(model->audioSources[i], source);
+      detail::JsonPushBack(sources, std::move(source));
+    }
+    detail::JsonAddMember(khr_audio_cmn, "sources", std::move(sources));
 
-  return true;
-}
+    detail::json ext_j;
+    {
+      detail::json_const_iterator it;
+      if (detail::FindMember(o, "extensions", it)) {
+        detail::JsonAssign(ext_j, detail::GetValue(it));
+      }
+    }
 
-static bool ParseMesh(Mesh *mesh, Model *model,
-                      std::string *err, std::string *warn,
-                      const detail::json &o,
-                      bool store_original_json_for_extras_and_extensions,
-                      ParseStrictness strictness) {
-  ParseStringProperty(&mesh->name, err, o, "name", false);
+    detail::JsonAddMember(ext_j, "KHR_audio", std::move(khr_audio_cmn));
 
-  mesh->primitives.clear();
-  detail::json_const_iterator primObject;
-  if (detail::FindMember(o, "primitives", primObject) &&
-      detail::IsArray(detail::GetValue(primObject))) {
-    detail::json_const_array_iterator primEnd =
-        detail::ArrayEnd(detail::GetValue(primObject));
-    for (detail::json_const_array_iterator i =
-             detail::ArrayBegin(detail::GetValue(primObject));
-         i != primEnd; ++i) {
-      Primitive primitive;
-      if (ParsePrimitive(&primitive, model, err, warn, *i,
-                         store_original_json_for_extras_and_extensions,
-                         strictness)) {
-        // Only add the primitive if the parsing succeeds.
-        mesh->primitives.emplace_back(std::move(primitive));
+    detail::JsonAddMember(o, "extensions", std::move(ext_j));
+
+    // Also add "KHR_audio" to `extensionsUsed`
+    {
+      auto has_khr_audio = std::find_if(
+          extensionsUsed.begin(), extensionsUsed.end(),
+          [](const std::string &s) { return (s.compare("KHR_audio") == 0); });
+
+      if (has_khr_audio == extensionsUsed.end()) {
+        extensionsUsed.push_back("KHR_audio");
       }
     }
   }
 
-  // Should probably check if has targets and if dimensions fit
-  ParseNumberArrayProperty(&mesh->weights, err, o, "weights", false);
+  // MSFT_lod
 
-  ParseExtrasAndExtensions(mesh, err, o,
-                           store_original_json_for_extras_and_extensions);
+  // Look if there is a node that employs MSFT_lod
+  auto msft_lod_nodes_it = std::find_if(
+    model->nodes.begin(), model->nodes.end(),
+    [](const Node& node) { return !node.lods.empty(); });
 
-  return true;
-}
+  // Look if there is a material that employs MSFT_lod
+  auto msft_lod_materials_it = std::find_if(
+    model->materials.begin(), model->materials.end(),
+    [](const Material& material) {return !material.lods.empty(); });
 
-static bool ParseNode(Node *node, std::string *err, const detail::json &o,
-                      bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&node->name, err, o, "name", false);
+  // If either a node or a material employ MSFT_lod, then we need
+  // to add MSFT_lod to the list of used extensions.
+  if (msft_lod_nodes_it != model->nodes.end() || msft_lod_materials_it != model->materials.end()) {
+    // First check if MSFT_lod is already registered as used extension
+    auto has_msft_lod = std::find_if(
+      extensionsUsed.begin(), extensionsUsed.end(),
+      [](const std::string &s) { return (s.compare("MSFT_lod") == 0); });
 
-  int skin = -1;
-  ParseIntegerProperty(&skin, err, o, "skin", false);
-  node->skin = skin;
+    // If MSFT_lod is not registered yet, add it
+    if (has_msft_lod == extensionsUsed.end()) {
+      extensionsUsed.push_back("MSFT_lod");
+    }
+  }
 
-  // Matrix and T/R/S are exclusive
-  if (!ParseNumberArrayProperty(&node->matrix, err, o, "matrix", false)) {
-    ParseNumberArrayProperty(&node->rotation, err, o, "rotation", false);
-    ParseNumberArrayProperty(&node->scale, err, o, "scale", false);
-    ParseNumberArrayProperty(&node->translation, err, o, "translation", false);
+  // Extensions used
+  if (extensionsUsed.size()) {
+    SerializeStringArrayProperty("extensionsUsed", extensionsUsed, o);
   }
+}
 
-  int camera = -1;
-  ParseIntegerProperty(&camera, err, o, "camera", false);
-  node->camera = camera;
+static bool WriteGltfStream(std::ostream &stream, const std::string &content) {
+  stream << content << std::endl;
+  return stream.good();
+}
 
-  int mesh = -1;
-  ParseIntegerProperty(&mesh, err, o, "mesh", false);
-  node->mesh = mesh;
+static bool WriteGltfFile(const std::string &output,
+                          const std::string &content) {
+#ifdef _WIN32
+#if defined(_MSC_VER)
+  std::ofstream gltfFile(UTF8ToWchar(output).c_str());
+#elif defined(__GLIBCXX__)
+  int file_descriptor = _wopen(UTF8ToWchar(output).c_str(),
+                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(
+      file_descriptor, std::ios_base::out | std::ios_base::binary);
+  std::ostream gltfFile(&wfile_buf);
+  if (!wfile_buf.is_open()) return false;
+#else
+  std::ofstream gltfFile(output.c_str());
+  if (!gltfFile.is_open()) return false;
+#endif
+#else
+  std::ofstream gltfFile(output.c_str());
+  if (!gltfFile.is_open()) return false;
+#endif
+  return WriteGltfStream(gltfFile, content);
+}
 
-  node->children.clear();
-  ParseIntegerArrayProperty(&node->children, err, o, "children", false);
+static bool WriteBinaryGltfStream(std::ostream &stream,
+                                  const std::string &content,
+                                  const std::vector<unsigned char> &binBuffer) {
+  const std::string header = "glTF";
+  const int version = 2;
 
-  ParseNumberArrayProperty(&node->weights, err, o, "weights", false);
+  const uint32_t content_size = uint32_t(content.size());
+  const uint32_t binBuffer_size = uint32_t(binBuffer.size());
+  // determine number of padding bytes required to ensure 4 byte alignment
+  const uint32_t content_padding_size =
+      content_size % 4 == 0 ? 0 : 4 - content_size % 4;
+  const uint32_t bin_padding_size =
+      binBuffer_size % 4 == 0 ? 0 : 4 - binBuffer_size % 4;
 
-  ParseExtrasAndExtensions(node, err, o,
-                           store_original_json_for_extras_and_extensions);
+  // 12 bytes for header, JSON content length, 8 bytes for JSON chunk info.
+  // Chunk data must be located at 4-byte boundary, which may require padding
+  const uint32_t length =
+      12 + 8 + content_size + content_padding_size +
+      (binBuffer_size ? (8 + binBuffer_size + bin_padding_size) : 0);
 
-  // KHR_lights_punctual: parse light source reference
-  int light = -1;
-  if (node->extensions.count("KHR_lights_punctual") != 0) {
-    auto const &light_ext = node->extensions["KHR_lights_punctual"];
-    if (light_ext.Has("light")) {
-      light = light_ext.Get("light").GetNumberAsInt();
-    } else {
-      if (err) {
-        *err +=
-            "Node has extension KHR_lights_punctual, but does not reference "
-            "a light source.\n";
-      }
-      return false;
-    }
-  }
-  node->light = light;
+  stream.write(header.c_str(), std::streamsize(header.size()));
+  stream.write(reinterpret_cast<const char *>(&version), sizeof(version));
+  stream.write(reinterpret_cast<const char *>(&length), sizeof(length));
 
-  // KHR_audio: parse audio source reference
-  int emitter = -1;
-  if (node->extensions.count("KHR_audio") != 0) {
-    auto const &audio_ext = node->extensions["KHR_audio"];
-    if (audio_ext.Has("emitter")) {
-      emitter = audio_ext.Get("emitter").GetNumberAsInt();
-    } else {
-      if (err) {
-        *err +=
-            "Node has extension KHR_audio, but does not reference "
-            "a audio emitter.\n";
-      }
-      return false;
-    }
-  }
-  node->emitter = emitter;
+  // JSON chunk info, then JSON data
+  const uint32_t model_length = uint32_t(content.size()) + content_padding_size;
+  const uint32_t model_format = 0x4E4F534A;
+  stream.write(reinterpret_cast<const char *>(&model_length),
+               sizeof(model_length));
+  stream.write(reinterpret_cast<const char *>(&model_format),
+               sizeof(model_format));
+  stream.write(content.c_str(), std::streamsize(content.size()));
 
-  node->lods.clear();
-  if (node->extensions.count("MSFT_lod") != 0) {
-    auto const &msft_lod_ext = node->extensions["MSFT_lod"];
-    if (msft_lod_ext.Has("ids")) {
-      auto idsArr = msft_lod_ext.Get("ids");
-      for (size_t i = 0; i < idsArr.ArrayLen(); ++i) {
-        node->lods.emplace_back(idsArr.Get(i).GetNumberAsInt());
-      }
-    } else {
-      if (err) {
-        *err +=
-            "Node has extension MSFT_lod, but does not reference "
-            "other nodes via their ids.\n";
-      }
-      return false;
+  // Chunk must be multiplies of 4, so pad with spaces
+  if (content_padding_size > 0) {
+    const std::string padding = std::string(size_t(content_padding_size), ' ');
+    stream.write(padding.c_str(), std::streamsize(padding.size()));
+  }
+  if (binBuffer.size() > 0) {
+    // BIN chunk info, then BIN data
+    const uint32_t bin_length = uint32_t(binBuffer.size()) + bin_padding_size;
+    const uint32_t bin_format = 0x004e4942;
+    stream.write(reinterpret_cast<const char *>(&bin_length),
+                 sizeof(bin_length));
+    stream.write(reinterpret_cast<const char *>(&bin_format),
+                 sizeof(bin_format));
+    stream.write(reinterpret_cast<const char *>(binBuffer.data()),
+                 std::streamsize(binBuffer.size()));
+    // Chunksize must be multiplies of 4, so pad with zeroes
+    if (bin_padding_size > 0) {
+      const std::vector<unsigned char> padding =
+          std::vector<unsigned char>(size_t(bin_padding_size), 0);
+      stream.write(reinterpret_cast<const char *>(padding.data()),
+                   std::streamsize(padding.size()));
     }
   }
 
-  return true;
+  stream.flush();
+  return stream.good();
 }
 
-static bool ParseScene(Scene *scene, std::string *err, const detail::json &o,
-                       bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&scene->name, err, o, "name", false);
-  ParseIntegerArrayProperty(&scene->nodes, err, o, "nodes", false);
-
-  ParseExtrasAndExtensions(scene, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  // Parse KHR_audio global emitters
-  if (scene->extensions.count("KHR_audio") != 0) {
-    auto const &audio_ext = scene->extensions["KHR_audio"];
-    if (audio_ext.Has("emitters")) {
-      auto emittersArr = audio_ext.Get("emitters");
-      for (size_t i = 0; i < emittersArr.ArrayLen(); ++i) {
-        scene->audioEmitters.emplace_back(emittersArr.Get(i).GetNumberAsInt());
-      }
-    } else {
-      if (err) {
-        *err +=
-            "Node has extension KHR_audio, but does not reference "
-            "a audio emitter.\n";
-      }
-      return false;
-    }
-  }
-
-  return true;
+static bool WriteBinaryGltfFile(const std::string &output,
+                                const std::string &content,
+                                const std::vector<unsigned char> &binBuffer) {
+#ifdef _WIN32
+#if defined(_MSC_VER)
+  std::ofstream gltfFile(UTF8ToWchar(output).c_str(), std::ios::binary);
+#elif defined(__GLIBCXX__)
+  int file_descriptor = _wopen(UTF8ToWchar(output).c_str(),
+                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
+  __gnu_cxx::stdio_filebuf<char> wfile_buf(
+      file_descriptor, std::ios_base::out | std::ios_base::binary);
+  std::ostream gltfFile(&wfile_buf);
+#else
+  std::ofstream gltfFile(output.c_str(), std::ios::binary);
+#endif
+#else
+  std::ofstream gltfFile(output.c_str(), std::ios::binary);
+#endif
+  return WriteBinaryGltfStream(gltfFile, content, binBuffer);
 }
 
-static bool ParsePbrMetallicRoughness(
-    PbrMetallicRoughness *pbr, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  if (pbr == nullptr) {
-    return false;
-  }
+#if defined(TINYGLTF_ENABLE_DRACO) || defined(TINYGLTF_ENABLE_MESHOPT)
+// Copies `src` to `dst` except the pixels of images, which compression does
+// not touch(the writer reads them from `src`).
+static void CopyModelForCompression(const Model &src, Model *dst) {
+  dst->accessors = src.accessors;
+  dst->animations = src.animations;
+  dst->buffers = src.buffers;
+  dst->bufferViews = src.bufferViews;
+  dst->materials = src.materials;
+  dst->meshes = src.meshes;
+  dst->nodes = src.nodes;
+  dst->textures = src.textures;
+  dst->images.resize(src.images.size());
+  for (size_t i = 0; i < src.images.size(); i++) {
+    const Image &image = src.images[i];
+    Image &copy = dst->images[i];
+    copy.name = image.name;
+    copy.width = image.width;
+    copy.height = image.height;
+    copy.component = image.component;
+    copy.bits = image.bits;
+    copy.pixel_type = image.pixel_type;
+    copy.bufferView = image.bufferView;
+    copy.mimeType = image.mimeType;
+    copy.uri = image.uri;
+    copy.extras = image.extras;
+    copy.extensions = image.extensions;
+    copy.extras_json_string = image.extras_json_string;
+    copy.extensions_json_string = image.extensions_json_string;
+    copy.as_is = image.as_is;
+  }
+  dst->skins = src.skins;
+  dst->samplers = src.samplers;
+  dst->cameras = src.cameras;
+  dst->scenes = src.scenes;
+  dst->lights = src.lights;
+  dst->audioEmitters = src.audioEmitters;
+  dst->audioSources = src.audioSources;
+  dst->defaultScene = src.defaultScene;
+  dst->extensionsUsed = src.extensionsUsed;
+  dst->extensionsRequired = src.extensionsRequired;
+  dst->asset = src.asset;
+  dst->extras = src.extras;
+  dst->extensions = src.extensions;
+  dst->extras_json_string = src.extras_json_string;
+  dst->extensions_json_string = src.extensions_json_string;
+}
+#endif
 
-  std::vector<double> baseColorFactor;
-  if (ParseNumberArrayProperty(&baseColorFactor, err, o, "baseColorFactor",
-                               /* required */ false)) {
-    if (baseColorFactor.size() != 4) {
-      if (err) {
-        (*err) +=
-            "Array length of `baseColorFactor` parameter in "
-            "pbrMetallicRoughness must be 4, but got " +
-            std::to_string(baseColorFactor.size()) + "\n";
-      }
+bool TinyGLTF::CompressModelForWriting(const Model **model,
+                                       Model *compressed) {
+  bool copied = false;
+#ifdef TINYGLTF_ENABLE_DRACO
+  if (draco_compression_) {
+    CopyModelForCompression(**model, compressed);
+    copied = true;
+    if (!EncodeDracoCompression(compressed, draco_encode_options_, &err_)) {
       return false;
     }
-    pbr->baseColorFactor = baseColorFactor;
   }
-
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "baseColorTexture", it)) {
-      ParseTextureInfo(&pbr->baseColorTexture, err, detail::GetValue(it),
-                       store_original_json_for_extras_and_extensions);
+#endif
+#ifdef TINYGLTF_ENABLE_MESHOPT
+  if (meshopt_compression_) {
+    if (!copied) {
+      CopyModelForCompression(**model, compressed);
+      copied = true;
     }
-  }
-
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "metallicRoughnessTexture", it)) {
-      ParseTextureInfo(&pbr->metallicRoughnessTexture, err,
-                       detail::GetValue(it),
-                       store_original_json_for_extras_and_extensions);
+    if (!EncodeMeshoptCompression(compressed, meshopt_encode_options_,
+                                  &err_)) {
+      return false;
     }
   }
-
-  ParseNumberProperty(&pbr->metallicFactor, err, o, "metallicFactor", false);
-  ParseNumberProperty(&pbr->roughnessFactor, err, o, "roughnessFactor", false);
-
-  ParseExtrasAndExtensions(pbr, err, o,
-                           store_original_json_for_extras_and_extensions);
-
+#endif
+  if (copied) {
+    *model = compressed;
+  }
   return true;
 }
 
-static bool ParseMaterial(Material *material, std::string *err, std::string *warn,
-                          const detail::json &o,
-                          bool store_original_json_for_extras_and_extensions,
-                          ParseStrictness strictness) {
-  ParseStringProperty(&material->name, err, o, "name", /* required */ false);
+bool TinyGLTF::WriteGltfSceneToStream(const Model *model, std::ostream &stream,
+                                      bool prettyPrint = true,
+                                      bool writeBinary = false) {
+  detail::JsonDocument output;
 
-  if (ParseNumberArrayProperty(&material->emissiveFactor, err, o,
-                               "emissiveFactor",
-                               /* required */ false)) {
-    if (strictness==ParseStrictness::Permissive && material->emissiveFactor.size() == 4) {
-      if (warn) {
-        (*warn) +=
-            "Array length of `emissiveFactor` parameter in "
-            "material must be 3, but got 4\n";
+  // Images of `compressed` have no pixels: write them from `source`.
+  const Model *source = model;
+  Model compressed;
+  if (!CompressModelForWriting(&model, &compressed)) {
+    return false;
+  }
+
+  /// Serialize all properties except buffers and images.
+  SerializeGltfModel(model, output);
+
+  // BUFFERS
+  std::vector<unsigned char> binBuffer;
+  if (model->buffers.size()) {
+    detail::json buffers;
+    detail::JsonReserveArray(buffers, model->buffers.size());
+    for (unsigned int i = 0; i < model->buffers.size(); ++i) {
+      detail::json buffer;
+#ifdef TINYGLTF_ENABLE_MESHOPT
+      if (IsMeshoptFallbackBuffer(model->buffers[i])) {
+        SerializeGltfFallbackBuffer(model->buffers[i], buffer);
+        detail::JsonPushBack(buffers, std::move(buffer));
+        continue;
       }
-      material->emissiveFactor.resize(3);
-    }
-    else if (material->emissiveFactor.size() != 3) {
-      if (err) {
-        (*err) +=
-            "Array length of `emissiveFactor` parameter in "
-            "material must be 3, but got " +
-            std::to_string(material->emissiveFactor.size()) + "\n";
+#endif
+      if (writeBinary && i == 0 && model->buffers[i].uri.empty()) {
+        SerializeGltfBufferBin(model->buffers[i], buffer, binBuffer);
+      } else {
+        SerializeGltfBuffer(model->buffers[i], buffer);
       }
-      return false;
+      detail::JsonPushBack(buffers, std::move(buffer));
     }
-  } else {
-    // fill with default values
-    material->emissiveFactor = {0.0, 0.0, 0.0};
+    detail::JsonAddMember(output, "buffers", std::move(buffers));
   }
 
-  ParseStringProperty(&material->alphaMode, err, o, "alphaMode",
-                      /* required */ false);
-  ParseNumberProperty(&material->alphaCutoff, err, o, "alphaCutoff",
-                      /* required */ false);
-  ParseBooleanProperty(&material->doubleSided, err, o, "doubleSided",
-                       /* required */ false);
+  // IMAGES
+  if (model->images.size()) {
+    detail::json images;
+    detail::JsonReserveArray(images, model->images.size());
+    for (unsigned int i = 0; i < model->images.size(); ++i) {
+      detail::json image;
 
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "pbrMetallicRoughness", it)) {
-      ParsePbrMetallicRoughness(&material->pbrMetallicRoughness, err,
-                                detail::GetValue(it),
-                                store_original_json_for_extras_and_extensions);
+      std::string dummystring;
+      // UpdateImageObject need baseDir but only uses it if embeddedImages is
+      // enabled, since we won't write separate images when writing to a stream
+      // we
+      std::string uri;
+      if (!UpdateImageObject(source->images[i], dummystring, int(i), true,
+                             &fs, &uri_cb, this->WriteImageData,
+                             this->write_image_user_data_, &uri)) {
+        return false;
+      }
+      SerializeGltfImage(model->images[i], uri, image);
+      detail::JsonPushBack(images, std::move(image));
     }
+    detail::JsonAddMember(output, "images", std::move(images));
   }
 
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "normalTexture", it)) {
-      ParseNormalTextureInfo(&material->normalTexture, err,
-                             detail::GetValue(it),
-                             store_original_json_for_extras_and_extensions);
-    }
+  if (writeBinary) {
+    return WriteBinaryGltfStream(stream, detail::JsonToString(output),
+                                 binBuffer);
+  } else {
+    return WriteGltfStream(stream,
+                           detail::JsonToString(output, prettyPrint ? 2 : -1));
   }
+}
 
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "occlusionTexture", it)) {
-      ParseOcclusionTextureInfo(&material->occlusionTexture, err,
-                                detail::GetValue(it),
-                                store_original_json_for_extras_and_extensions);
-    }
+bool TinyGLTF::WriteGltfSceneToFile(const Model *model,
+                                    const std::string &filename,
+                                    bool embedImages = false,
+                                    bool embedBuffers = false,
+                                    bool prettyPrint = true,
+                                    bool writeBinary = false) {
+  detail::JsonDocument output;
+  // Images of `compressed` have no pixels: write them from `source`.
+  const Model *source = model;
+  Model compressed;
+  if (!CompressModelForWriting(&model, &compressed)) {
+    return false;
   }
+  std::string defaultBinFilename = GetBaseFilename(filename);
+  std::string defaultBinFileExt = ".bin";
+  std::string::size_type pos =
+      defaultBinFilename.rfind('.', defaultBinFilename.length());
 
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(o, "emissiveTexture", it)) {
-      ParseTextureInfo(&material->emissiveTexture, err, detail::GetValue(it),
-                       store_original_json_for_extras_and_extensions);
-    }
+  if (pos != std::string::npos) {
+    defaultBinFilename = defaultBinFilename.substr(0, pos);
   }
+  std::string baseDir = GetBaseDir(filename);
+  if (baseDir.empty()) {
+    baseDir = "./";
+  }
+  /// Serialize all properties except buffers and images.
+  SerializeGltfModel(model, output);
 
-  // Old code path. For backward compatibility, we still store material values
-  // as Parameter. This will create duplicated information for
-  // example(pbrMetallicRoughness), but should be negligible in terms of memory
-  // consumption.
-  // TODO(syoyo): Remove in the next major release.
-  material->values.clear();
-  material->additionalValues.clear();
-
-  detail::json_const_iterator it(detail::ObjectBegin(o));
-  detail::json_const_iterator itEnd(detail::ObjectEnd(o));
-
-  for (; it != itEnd; ++it) {
-    std::string key(detail::GetKey(it));
-    if (key == "pbrMetallicRoughness") {
-      if (detail::IsObject(detail::GetValue(it))) {
-        const detail::json &values_object = detail::GetValue(it);
-
-        detail::json_const_iterator itVal(detail::ObjectBegin(values_object));
-        detail::json_const_iterator itValEnd(detail::ObjectEnd(values_object));
+  // BUFFERS
+  std::vector<std::string> usedFilenames;
+  std::vector<unsigned char> binBuffer;
+  if (model->buffers.size()) {
+    detail::json buffers;
+    detail::JsonReserveArray(buffers, model->buffers.size());
+    for (unsigned int i = 0; i < model->buffers.size(); ++i) {
+      detail::json buffer;
+#ifdef TINYGLTF_ENABLE_MESHOPT
+      if (IsMeshoptFallbackBuffer(model->buffers[i])) {
+        SerializeGltfFallbackBuffer(model->buffers[i], buffer);
+        detail::JsonPushBack(buffers, std::move(buffer));
+        continue;
+      }
+#endif
+      if (writeBinary && i == 0 && model->buffers[i].uri.empty()) {
+        SerializeGltfBufferBin(model->buffers[i], buffer, binBuffer);
+      } else if (embedBuffers) {
+        SerializeGltfBuffer(model->buffers[i], buffer);
+      } else {
+        std::string binSavePath;
+        std::string binFilename;
+        std::string binUri;
+        if (!model->buffers[i].uri.empty() &&
+            !IsDataURI(model->buffers[i].uri)) {
+          binUri = model->buffers[i].uri;
+          if (!uri_cb.decode(binUri, &binFilename, uri_cb.user_data)) {
+            return false;
+          }
+        } else {
+          binFilename = defaultBinFilename + defaultBinFileExt;
+          bool inUse = true;
+          int numUsed = 0;
+          while (inUse) {
+            inUse = false;
+            for (const std::string &usedName : usedFilenames) {
+              if (binFilename.compare(usedName) != 0) continue;
+              inUse = true;
+              binFilename = defaultBinFilename + std::to_string(numUsed++) +
+                            defaultBinFileExt;
+              break;
+            }
+          }
 
-        for (; itVal != itValEnd; ++itVal) {
-          Parameter param;
-          if (ParseParameterProperty(&param, err, values_object,
-                                     detail::GetKey(itVal), false)) {
-            material->values.emplace(detail::GetKey(itVal), std::move(param));
+          if (uri_cb.encode) {
+            if (!uri_cb.encode(binFilename, "buffer", &binUri,
+                               uri_cb.user_data)) {
+              return false;
+            }
+          } else {
+            binUri = binFilename;
           }
         }
+        usedFilenames.push_back(binFilename);
+        binSavePath = JoinPath(baseDir, binFilename);
+        if (!SerializeGltfBuffer(model->buffers[i], buffer, binSavePath,
+                                 binUri)) {
+          return false;
+        }
       }
-    } else if (key == "extensions" || key == "extras") {
-      // done later, skip, otherwise poorly parsed contents will be saved in the
-      // parametermap and serialized again later
-    } else {
-      Parameter param;
-      if (ParseParameterProperty(&param, err, o, key, false)) {
-        // names of materials have already been parsed. Putting it in this map
-        // doesn't correctly reflect the glTF specification
-        if (key != "name")
-          material->additionalValues.emplace(std::move(key), std::move(param));
-      }
+      detail::JsonPushBack(buffers, std::move(buffer));
     }
+    detail::JsonAddMember(output, "buffers", std::move(buffers));
   }
 
-  material->extensions.clear();  // Note(agnat): Why?
-  ParseExtrasAndExtensions(material, err, o,
-                           store_original_json_for_extras_and_extensions);
+  // IMAGES
+  if (model->images.size()) {
+    detail::json images;
+    detail::JsonReserveArray(images, model->images.size());
+    for (unsigned int i = 0; i < model->images.size(); ++i) {
+      detail::json image;
 
-  material->lods.clear();
-  if (material->extensions.count("MSFT_lod") != 0) {
-    auto const &msft_lod_ext = material->extensions["MSFT_lod"];
-    if (msft_lod_ext.Has("ids")) {
-      auto idsArr = msft_lod_ext.Get("ids");
-      for (size_t i = 0; i < idsArr.ArrayLen(); ++i) {
-        material->lods.emplace_back(idsArr.Get(i).GetNumberAsInt());
-      }
-    } else {
-      if (err) {
-        *err +=
-            "Material has extension MSFT_lod, but does not reference "
-            "other materials via their ids.\n";
+      std::string uri;
+      if (!UpdateImageObject(source->images[i], baseDir, int(i), embedImages,
+                             &fs, &uri_cb, this->WriteImageData,
+                             this->write_image_user_data_, &uri)) {
+        return false;
       }
-      return false;
+      SerializeGltfImage(model->images[i], uri, image);
+      detail::JsonPushBack(images, std::move(image));
     }
+    detail::JsonAddMember(output, "images", std::move(images));
   }
 
-  return true;
+  if (writeBinary) {
+    return WriteBinaryGltfFile(filename, detail::JsonToString(output),
+                               binBuffer);
+  } else {
+    return WriteGltfFile(filename,
+                         detail::JsonToString(output, (prettyPrint ? 2 : -1)));
+  }
 }
 
-static bool ParseAnimationChannel(
-    AnimationChannel *channel, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  int samplerIndex = -1;
-  int targetIndex = -1;
-  if (!ParseIntegerProperty(&samplerIndex, err, o, "sampler", true,
-                            "AnimationChannel")) {
+///
+/// Returns the data of `bufferView` from `byte_offset` when `num_bytes` fit in
+/// it, nullptr otherwise.
+///
+static const unsigned char *GetBufferViewData(const Model &model,
+                                              int bufferView,
+                                              size_t byte_offset,
+                                              size_t num_bytes,
+                                              const std::string &name,
+                                              std::string *err) {
+  if ((bufferView < 0) || (size_t(bufferView) >= model.bufferViews.size())) {
     if (err) {
-      (*err) += "`sampler` field is missing in animation channels\n";
+      (*err) += name + ": invalid bufferView " + std::to_string(bufferView) +
+                ".\n";
     }
-    return false;
+    return nullptr;
   }
-
-  detail::json_const_iterator targetIt;
-  if (detail::FindMember(o, "target", targetIt) &&
-      detail::IsObject(detail::GetValue(targetIt))) {
-    const detail::json &target_object = detail::GetValue(targetIt);
-
-    ParseIntegerProperty(&targetIndex, err, target_object, "node", false);
-
-    if (!ParseStringProperty(&channel->target_path, err, target_object, "path",
-                             true)) {
-      if (err) {
-        (*err) += "`path` field is missing in animation.channels.target\n";
-      }
-      return false;
+  const BufferView &view = model.bufferViews[size_t(bufferView)];
+  if ((view.buffer < 0) || (size_t(view.buffer) >= model.buffers.size())) {
+    if (err) {
+      (*err) += name + ": invalid buffer " + std::to_string(view.buffer) +
+                ".\n";
     }
-    ParseExtensionsProperty(&channel->target_extensions, err, target_object);
-    ParseExtrasProperty(&channel->target_extras, target_object);
-    if (store_original_json_for_extras_and_extensions) {
-      {
-        detail::json_const_iterator it;
-        if (detail::FindMember(target_object, "extensions", it)) {
-          channel->target_extensions_json_string =
-              detail::JsonToString(detail::GetValue(it));
-        }
-      }
-      {
-        detail::json_const_iterator it;
-        if (detail::FindMember(target_object, "extras", it)) {
-          channel->target_extras_json_string =
-              detail::JsonToString(detail::GetValue(it));
-        }
-      }
+    return nullptr;
+  }
+  const Buffer &buffer = model.buffers[size_t(view.buffer)];
+  // No sums, so that crafted offsets and lengths cannot wrap around.
+  if ((view.byteOffset > buffer.data.size()) ||
+      (view.byteLength > buffer.data.size() - view.byteOffset) ||
+      (byte_offset > view.byteLength) ||
+      (num_bytes > view.byteLength - byte_offset)) {
+    if (err) {
+      (*err) += name + ": data exceeds the range of bufferView " +
+                std::to_string(bufferView) + ".\n";
     }
+    return nullptr;
   }
+  return buffer.data.data() + view.byteOffset + byte_offset;
+}
 
-  channel->sampler = samplerIndex;
-  channel->target_node = targetIndex;
-
-  ParseExtrasAndExtensions(channel, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
+///
+/// Returns true when `count` elements of `elem_size` bytes, `stride` bytes
+/// apart, fit in `num_bytes`. Checked with a division so that huge counts
+/// cannot wrap the extent `(count - 1) * stride + elem_size`.
+///
+static bool StridedElementsFit(size_t count, size_t elem_size, size_t stride,
+                               size_t num_bytes) {
+  if (count == 0) {
+    return true;
+  }
+  if ((stride == 0) || (num_bytes < elem_size)) {
+    return false;
+  }
+  return count <= (num_bytes - elem_size) / stride + 1;
 }
 
-static bool ParseAnimation(Animation *animation, std::string *err,
-                           const detail::json &o,
-                           bool store_original_json_for_extras_and_extensions) {
-  {
-    detail::json_const_iterator channelsIt;
-    if (detail::FindMember(o, "channels", channelsIt) &&
-        detail::IsArray(detail::GetValue(channelsIt))) {
-      detail::json_const_array_iterator channelEnd =
-          detail::ArrayEnd(detail::GetValue(channelsIt));
-      for (detail::json_const_array_iterator i =
-               detail::ArrayBegin(detail::GetValue(channelsIt));
-           i != channelEnd; ++i) {
-        AnimationChannel channel;
-        if (ParseAnimationChannel(
-                &channel, err, *i,
-                store_original_json_for_extras_and_extensions)) {
-          // Only add the channel if the parsing succeeds.
-          animation->channels.emplace_back(std::move(channel));
-        }
-      }
+///
+/// Same as above for `count` elements of `elem_size` bytes, `stride` bytes
+/// apart(`count` > 0).
+///
+static const unsigned char *GetBufferViewData(const Model &model,
+                                              int bufferView,
+                                              size_t byte_offset,
+                                              size_t count, size_t elem_size,
+                                              size_t stride,
+                                              const std::string &name,
+                                              std::string *err) {
+  const unsigned char *data =
+      GetBufferViewData(model, bufferView, byte_offset, 0, name, err);
+  if (!data) {
+    return nullptr;
+  }
+  const BufferView &view = model.bufferViews[size_t(bufferView)];
+  if (!StridedElementsFit(count, elem_size, stride,
+                          view.byteLength - byte_offset)) {
+    if (err) {
+      (*err) += name + ": data exceeds the range of bufferView " +
+                std::to_string(bufferView) + ".\n";
     }
+    return nullptr;
   }
+  return data;
+}
 
-  {
-    detail::json_const_iterator samplerIt;
-    if (detail::FindMember(o, "samplers", samplerIt) &&
-        detail::IsArray(detail::GetValue(samplerIt))) {
-      const detail::json &sampler_array = detail::GetValue(samplerIt);
-
-      detail::json_const_array_iterator it = detail::ArrayBegin(sampler_array);
-      detail::json_const_array_iterator itEnd = detail::ArrayEnd(sampler_array);
-
-      for (; it != itEnd; ++it) {
-        const detail::json &s = *it;
-
-        AnimationSampler sampler;
-        int inputIndex = -1;
-        int outputIndex = -1;
-        if (!ParseIntegerProperty(&inputIndex, err, s, "input", true)) {
-          if (err) {
-            (*err) += "`input` field is missing in animation.sampler\n";
-          }
-          return false;
-        }
-        ParseStringProperty(&sampler.interpolation, err, s, "interpolation",
-                            false);
-        if (!ParseIntegerProperty(&outputIndex, err, s, "output", true)) {
-          if (err) {
-            (*err) += "`output` field is missing in animation.sampler\n";
-          }
-          return false;
-        }
-        sampler.input = inputIndex;
-        sampler.output = outputIndex;
-        ParseExtrasAndExtensions(&sampler, err, s,
-                                 store_original_json_for_extras_and_extensions);
-
-        animation->samplers.emplace_back(std::move(sampler));
-      }
+//
+// Looks up the sparse indices(`index_size` bytes each) and values(`elem_size`
+// bytes each) of `accessor`, whose `sparse.count` is > 0, after checking the
+// index componentType and that both fit in their bufferViews.
+//
+static bool GetSparseIndicesAndValues(const Model &model,
+                                      const Accessor &accessor,
+                                      size_t elem_size, const std::string &name,
+                                      const unsigned char **indices,
+                                      int *index_size,
+                                      const unsigned char **values,
+                                      std::string *err) {
+  const Accessor::Sparse &sparse = accessor.sparse;
+  const size_t num_values = size_t(sparse.count);
+  if ((sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) &&
+      (sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) &&
+      (sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)) {
+    if (err) {
+      (*err) += name + ": invalid sparse indices componentType.\n";
     }
+    return false;
   }
-
-  ParseStringProperty(&animation->name, err, o, "name", false);
-
-  ParseExtrasAndExtensions(animation, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
+  *index_size = GetComponentSizeInBytes(
+      static_cast<uint32_t>(sparse.indices.componentType));
+  *indices = GetBufferViewData(model, sparse.indices.bufferView,
+                               sparse.indices.byteOffset, num_values,
+                               size_t(*index_size), size_t(*index_size),
+                               name + " sparse indices", err);
+  *values = *indices ? GetBufferViewData(model, sparse.values.bufferView,
+                                         sparse.values.byteOffset, num_values,
+                                         elem_size, elem_size,
+                                         name + " sparse values", err)
+                     : nullptr;
+  return *values != nullptr;
 }
 
-static bool ParseSampler(Sampler *sampler, std::string *err,
-                         const detail::json &o,
-                         bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&sampler->name, err, o, "name", false);
-
-  int minFilter = -1;
-  int magFilter = -1;
-  int wrapS = TINYGLTF_TEXTURE_WRAP_REPEAT;
-  int wrapT = TINYGLTF_TEXTURE_WRAP_REPEAT;
-  // int wrapR = TINYGLTF_TEXTURE_WRAP_REPEAT;
-  ParseIntegerProperty(&minFilter, err, o, "minFilter", false);
-  ParseIntegerProperty(&magFilter, err, o, "magFilter", false);
-  ParseIntegerProperty(&wrapS, err, o, "wrapS", false);
-  ParseIntegerProperty(&wrapT, err, o, "wrapT", false);
-  // ParseIntegerProperty(&wrapR, err, o, "wrapR", false);  // tinygltf
-  // extension
-
-  // TODO(syoyo): Check the value is allowed one.
-  // (e.g. we allow 9728(NEAREST), but don't allow 9727)
-
-  sampler->minFilter = minFilter;
-  sampler->magFilter = magFilter;
-  sampler->wrapS = wrapS;
-  sampler->wrapT = wrapT;
-  // sampler->wrapR = wrapR;
-
-  ParseExtrasAndExtensions(sampler, err, o,
-                           store_original_json_for_extras_and_extensions);
-
+//
+// Calls `func(i, index)` for each of the `num_values` sparse indices. Returns
+// false at the first index which is not below `count`.
+//
+template <typename IndexT, typename Func>
+static bool ForEachSparseIndex(const unsigned char *indices, size_t num_values,
+                               size_t count, const Func &func) {
+  for (size_t i = 0; i < num_values; i++) {
+    IndexT idx;
+    std::memcpy(&idx, indices + i * sizeof(IndexT), sizeof(IndexT));
+    if (size_t(idx) >= count) {
+      return false;
+    }
+    func(i, size_t(idx));
+  }
   return true;
 }
 
-static bool ParseSkin(Skin *skin, std::string *err, const detail::json &o,
-                      bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&skin->name, err, o, "name", false, "Skin");
-
-  std::vector<int> joints;
-  if (!ParseIntegerArrayProperty(&joints, err, o, "joints", false, "Skin")) {
-    return false;
+template <typename Func>
+static bool ForEachSparseIndex(const unsigned char *indices, int index_size,
+                               size_t num_values, size_t count,
+                               const Func &func) {
+  if (index_size == 1) {
+    return ForEachSparseIndex<uint8_t>(indices, num_values, count, func);
+  } else if (index_size == 2) {
+    return ForEachSparseIndex<uint16_t>(indices, num_values, count, func);
   }
-  skin->joints = std::move(joints);
-
-  int skeleton = -1;
-  ParseIntegerProperty(&skeleton, err, o, "skeleton", false, "Skin");
-  skin->skeleton = skeleton;
+  return ForEachSparseIndex<uint32_t>(indices, num_values, count, func);
+}
 
-  int invBind = -1;
-  ParseIntegerProperty(&invBind, err, o, "inverseBindMatrices", false, "Skin");
-  skin->inverseBindMatrices = invBind;
+//
+// Scatter sparse values. `ElemSize` > 0 gives the compiler a fixed size copy
+// for common element sizes, 0 falls back to the runtime `elem_size`.
+//
+template <size_t ElemSize>
+static bool ScatterSparseValues(unsigned char *dst, size_t count,
+                                const unsigned char *indices, int index_size,
+                                const unsigned char *values, size_t num_values,
+                                size_t elem_size) {
+  const size_t n = ElemSize ? ElemSize : elem_size;
+  return ForEachSparseIndex(indices, index_size, num_values, count,
+                            [&](size_t i, size_t idx) {
+                              std::memcpy(dst + idx * n, values + i * n, n);
+                            });
+}
 
-  ParseExtrasAndExtensions(skin, err, o,
-                           store_original_json_for_extras_and_extensions);
+static bool ScatterSparseValues(unsigned char *dst, size_t count,
+                                const unsigned char *indices, int index_size,
+                                const unsigned char *values, size_t num_values,
+                                size_t elem_size) {
+  switch (elem_size) {
+    case 4:
+      return ScatterSparseValues<4>(dst, count, indices, index_size, values,
+                                    num_values, elem_size);
+    case 8:
+      return ScatterSparseValues<8>(dst, count, indices, index_size, values,
+                                    num_values, elem_size);
+    case 12:
+      return ScatterSparseValues<12>(dst, count, indices, index_size, values,
+                                     num_values, elem_size);
+    case 16:
+      return ScatterSparseValues<16>(dst, count, indices, index_size, values,
+                                     num_values, elem_size);
+    default:
+      return ScatterSparseValues<0>(dst, count, indices, index_size, values,
+                                    num_values, elem_size);
+  }
+}
 
-  return true;
+//
+// Appends `data` to buffers[0] as a new bufferView(4 byte aligned) and
+// returns its index.
+//
+static int AppendBufferView(Model *model, const unsigned char *data,
+                            size_t size, int target) {
+  if (model->buffers.empty()) {
+    model->buffers.emplace_back();
+  }
+  Buffer &buffer = model->buffers[0];
+  buffer.data.resize((buffer.data.size() + 3) & ~size_t(3));
+
+  BufferView view;
+  view.buffer = 0;
+  view.byteOffset = buffer.data.size();
+  view.byteLength = size;
+  view.target = target;
+  buffer.data.insert(buffer.data.end(), data, data + size);
+  model->bufferViews.emplace_back(std::move(view));
+  return int(model->bufferViews.size() - 1);
 }
 
-static bool ParsePerspectiveCamera(
-    PerspectiveCamera *camera, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  double yfov = 0.0;
-  if (!ParseNumberProperty(&yfov, err, o, "yfov", true, "OrthographicCamera")) {
+bool MaterializeAccessor(const Model &model, int accessor_idx,
+                         std::vector<unsigned char> *out, std::string *err) {
+  if ((accessor_idx < 0) || (size_t(accessor_idx) >= model.accessors.size())) {
+    if (err) {
+      (*err) += "Invalid accessor index " + std::to_string(accessor_idx) +
+                ".\n";
+    }
     return false;
   }
+  const Accessor &accessor = model.accessors[size_t(accessor_idx)];
+  const std::string name = "accessor[" + std::to_string(accessor_idx) + "]";
 
-  double znear = 0.0;
-  if (!ParseNumberProperty(&znear, err, o, "znear", true,
-                           "PerspectiveCamera")) {
+  const int component_size =
+      GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+  const int num_components =
+      GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+  if ((component_size <= 0) || (num_components <= 0)) {
+    if (err) {
+      (*err) += name + ": invalid componentType or type.\n";
+    }
     return false;
   }
+  const size_t elem_size = size_t(component_size) * size_t(num_components);
+  const size_t count = accessor.count;
 
-  double aspectRatio = 0.0;  // = invalid
-  ParseNumberProperty(&aspectRatio, err, o, "aspectRatio", false,
-                      "PerspectiveCamera");
+  if (count > (std::numeric_limits<size_t>::max)() / elem_size) {
+    if (err) {
+      (*err) += name + ": count is too large.\n";
+    }
+    return false;
+  }
 
-  double zfar = 0.0;  // = invalid
-  ParseNumberProperty(&zfar, err, o, "zfar", false, "PerspectiveCamera");
+  const unsigned char *src = nullptr;
+  int stride = 0;
+  if ((accessor.bufferView >= 0) && (count > 0)) {
+    if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
+      if (err) {
+        (*err) += name + ": invalid bufferView.\n";
+      }
+      return false;
+    }
+    stride = accessor.ByteStride(
+        model.bufferViews[size_t(accessor.bufferView)]);
+    if ((stride <= 0) || (size_t(stride) < elem_size)) {
+      if (err) {
+        (*err) += name + ": invalid byteStride.\n";
+      }
+      return false;
+    }
+    src = GetBufferViewData(model, accessor.bufferView, accessor.byteOffset,
+                            count, elem_size, size_t(stride), name, err);
+    if (!src) {
+      return false;
+    }
+  }
 
-  camera->aspectRatio = aspectRatio;
-  camera->zfar = zfar;
-  camera->yfov = yfov;
-  camera->znear = znear;
+  // Without base data nothing in the file bounds `count`: limit the zeros to
+  // the default maximum buffer size of the loader(2GB).
+  if (!src && (count * elem_size >
+               size_t((std::numeric_limits<int32_t>::max)()))) {
+    if (err) {
+      (*err) += name + ": count is too large for an accessor without "
+                       "bufferView.\n";
+    }
+    return false;
+  }
 
-  ParseExtrasAndExtensions(camera, err, o,
-                           store_original_json_for_extras_and_extensions);
+  // Zeros when there is no base data. Allocated once the base data is known
+  // to be in range.
+  std::vector<unsigned char> data(count * elem_size);
+  if (src) {
+    if (size_t(stride) == elem_size) {
+      std::memcpy(data.data(), src, count * elem_size);
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        std::memcpy(data.data() + i * elem_size, src + i * size_t(stride),
+                    elem_size);
+      }
+    }
+  }
 
-  // TODO(syoyo): Validate parameter values.
+  if (accessor.sparse.isSparse && (accessor.sparse.count > 0)) {
+    const unsigned char *indices = nullptr;
+    const unsigned char *values = nullptr;
+    int index_size = 0;
+    if (!GetSparseIndicesAndValues(model, accessor, elem_size, name, &indices,
+                                   &index_size, &values, err)) {
+      return false;
+    }
+    if (!ScatterSparseValues(data.data(), count, indices, index_size, values,
+                             size_t(accessor.sparse.count), elem_size)) {
+      if (err) {
+        (*err) += name + ": sparse index out of range.\n";
+      }
+      return false;
+    }
+  }
 
+  out->swap(data);
   return true;
 }
 
-static bool ParseSpotLight(SpotLight *light, std::string *err,
-                           const detail::json &o,
-                           bool store_original_json_for_extras_and_extensions) {
-  ParseNumberProperty(&light->innerConeAngle, err, o, "innerConeAngle", false);
-  ParseNumberProperty(&light->outerConeAngle, err, o, "outerConeAngle", false);
+bool DensifySparseAccessors(Model *model, std::string *err) {
+  std::vector<std::pair<size_t, std::vector<unsigned char>>> dense;
+  for (size_t i = 0; i < model->accessors.size(); i++) {
+    if (!model->accessors[i].sparse.isSparse) {
+      continue;
+    }
+    dense.emplace_back(i, std::vector<unsigned char>());
+    if (!MaterializeAccessor(*model, int(i), &dense.back().second, err)) {
+      return false;
+    }
+  }
 
-  ParseExtrasAndExtensions(light, err, o,
-                           store_original_json_for_extras_and_extensions);
+  if (dense.empty()) {
+    return true;
+  }
 
-  // TODO(syoyo): Validate parameter values.
+  for (auto &item : dense) {
+    Accessor &accessor = model->accessors[item.first];
+    accessor.bufferView = AppendBufferView(model, item.second.data(),
+                                           item.second.size(), 0);
+    accessor.byteOffset = 0;
+    accessor.sparse = Accessor::Sparse();
+    accessor.sparse.isSparse = false;
+  }
 
   return true;
 }
 
-static bool ParseOrthographicCamera(
-    OrthographicCamera *camera, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  double xmag = 0.0;
-  if (!ParseNumberProperty(&xmag, err, o, "xmag", true, "OrthographicCamera")) {
-    return false;
-  }
+namespace detail {
 
-  double ymag = 0.0;
-  if (!ParseNumberProperty(&ymag, err, o, "ymag", true, "OrthographicCamera")) {
-    return false;
-  }
+static unsigned int GetNumThreads(int num_threads, size_t num_tasks) {
+#ifdef TINYGLTF_NO_THREADS
+  (void)num_threads;
+  (void)num_tasks;
+  return 1;
+#else
+  size_t n = (num_threads > 0) ? size_t(num_threads)
+                               : size_t(std::thread::hardware_concurrency());
+  n = (std::min)(n, num_tasks);
+  return (n > 0) ? static_cast<unsigned int>(n) : 1;
+#endif
+}
 
-  double zfar = 0.0;
-  if (!ParseNumberProperty(&zfar, err, o, "zfar", true, "OrthographicCamera")) {
-    return false;
+//
+// Calls `func(i)` for i in [0, n) on up to `num_threads` threads(0 = hardware
+// concurrency). Tasks are handed out one at a time, so tasks of different
+// sizes(e.g. accessors) are spread evenly.
+// When exceptions are enabled, the first exception thrown by a task stops
+// handing out tasks and is rethrown on the calling thread after all threads
+// are joined. When a thread cannot be created, the remaining tasks run on the
+// threads which already exist(at least the calling thread).
+//
+template <typename Func>
+static void ParallelFor(size_t n, int num_threads, const Func &func) {
+  const unsigned int nt = GetNumThreads(num_threads, n);
+  if (nt <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      func(i);
+    }
+    return;
   }
-
-  double znear = 0.0;
-  if (!ParseNumberProperty(&znear, err, o, "znear", true,
-                           "OrthographicCamera")) {
-    return false;
+#ifndef TINYGLTF_NO_THREADS
+  std::atomic<size_t> next(0);
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+  std::atomic<bool> failed(false);
+  // Written only by the thread which sets `failed` first, read after joins.
+  std::exception_ptr error;
+  auto worker = [&]() {
+    try {
+      for (;;) {
+        const size_t i = next.fetch_add(1);
+        if ((i >= n) || failed.load(std::memory_order_relaxed)) {
+          break;
+        }
+        func(i);
+      }
+    } catch (...) {
+      if (!failed.exchange(true)) {
+        error = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  try {
+    threads.reserve(nt - 1);
+    for (unsigned int t = 1; t < nt; t++) {
+      threads.emplace_back(worker);
+    }
+  } catch (...) {
+    // Out of threads or memory: continue with the threads created so far.
   }
-
-  ParseExtrasAndExtensions(camera, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  camera->xmag = xmag;
-  camera->ymag = ymag;
-  camera->zfar = zfar;
-  camera->znear = znear;
-
-  // TODO(syoyo): Validate parameter values.
-
-  return true;
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+#else
+  auto worker = [&]() {
+    for (;;) {
+      const size_t i = next.fetch_add(1);
+      if (i >= n) {
+        break;
+      }
+      func(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(nt - 1);
+  for (unsigned int t = 1; t < nt; t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &t : threads) {
+    t.join();
+  }
+#endif
+#endif
 }
 
-static bool ParseCamera(Camera *camera, std::string *err, const detail::json &o,
-                        bool store_original_json_for_extras_and_extensions) {
-  if (!ParseStringProperty(&camera->type, err, o, "type", true, "Camera")) {
-    return false;
+//
+// Same as above, but the tasks are handed to `executor` when it is set.
+//
+template <typename Func>
+static void ParallelFor(size_t n, int num_threads,
+                        const TaskExecutorFunction &executor,
+                        const Func &func) {
+  if (executor && n > 1) {
+    executor(n, std::function<void(size_t)>(func));
+    return;
   }
+  ParallelFor(n, num_threads, func);
+}
 
-  if (camera->type.compare("orthographic") == 0) {
-    detail::json_const_iterator orthoIt;
-    if (!detail::FindMember(o, "orthographic", orthoIt)) {
-      if (err) {
-        std::stringstream ss;
-        ss << "Orthographic camera description not found." << std::endl;
-        (*err) += ss.str();
+}  // namespace detail
+
+template <typename T>
+static void ConvertComponentsToFloat(const unsigned char *src,
+                                     size_t src_stride, size_t count,
+                                     size_t num_components, float scale,
+                                     bool snorm, float *dst,
+                                     size_t element_stride,
+                                     size_t component_stride) {
+  for (size_t i = 0; i < count; i++) {
+    const unsigned char *s = src + i * src_stride;
+    float *d = dst + i * element_stride;
+    for (size_t c = 0; c < num_components; c++) {
+      T v;
+      std::memcpy(&v, s + c * sizeof(T), sizeof(T));
+      float f = float(v) * scale;
+      if (snorm && (f < -1.0f)) {
+        f = -1.0f;
       }
-      return false;
+      d[c * component_stride] = f;
     }
+  }
+}
 
-    const detail::json &v = detail::GetValue(orthoIt);
-    if (!detail::IsObject(v)) {
-      if (err) {
-        std::stringstream ss;
-        ss << "\"orthographic\" is not a JSON object." << std::endl;
-        (*err) += ss.str();
+#if defined(TINYGLTF_INTERNAL_SSE2)
+static inline void StoreInt16x8AsFloat(__m128i v, bool is_signed,
+                                       __m128 scale, __m128 minv,
+                                       float *dst) {
+  __m128i lo, hi;
+  if (is_signed) {
+    lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+  } else {
+    const __m128i zero = _mm_setzero_si128();
+    lo = _mm_unpacklo_epi16(v, zero);
+    hi = _mm_unpackhi_epi16(v, zero);
+  }
+  _mm_storeu_ps(dst, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), scale), minv));
+  _mm_storeu_ps(dst + 4,
+                _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), scale), minv));
+}
+#elif defined(TINYGLTF_INTERNAL_NEON)
+static inline void StoreInt32x4AsFloat(float32x4_t f, float32x4_t scale,
+                                       float32x4_t minv, float *dst) {
+  vst1q_f32(dst, vmaxq_f32(vmulq_f32(f, scale), minv));
+}
+#endif
+
+//
+// Converts `n` packed 8/16-bit integers to float with SIMD. Returns the number
+// of converted values(the rest is left to the caller).
+//
+static size_t ConvertArrayToFloatSIMD(const unsigned char *src,
+                                      int component_type, size_t n,
+                                      float scale, bool snorm, float *dst) {
+  size_t i = 0;
+  const bool is_byte = (component_type == TINYGLTF_COMPONENT_TYPE_BYTE) ||
+                       (component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+  const bool is_short =
+      (component_type == TINYGLTF_COMPONENT_TYPE_SHORT) ||
+      (component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+  const bool is_signed = (component_type == TINYGLTF_COMPONENT_TYPE_BYTE) ||
+                         (component_type == TINYGLTF_COMPONENT_TYPE_SHORT);
+  const float min_value =
+      snorm ? -1.0f : std::numeric_limits<float>::lowest();
+#if defined(TINYGLTF_INTERNAL_SSE2)
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 vmin = _mm_set1_ps(min_value);
+  if (is_byte) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+      __m128i lo, hi;
+      if (is_signed) {
+        lo = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+        hi = _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8);
+      } else {
+        lo = _mm_unpacklo_epi8(b, zero);
+        hi = _mm_unpackhi_epi8(b, zero);
       }
-      return false;
+      // Sign is already extended to 16 bit.
+      StoreInt16x8AsFloat(lo, true, vscale, vmin, dst + i);
+      StoreInt16x8AsFloat(hi, true, vscale, vmin, dst + i + 8);
     }
-
-    if (!ParseOrthographicCamera(
-            &camera->orthographic, err, v,
-            store_original_json_for_extras_and_extensions)) {
-      return false;
+  } else if (is_short) {
+    for (; i + 8 <= n; i += 8) {
+      const __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+      StoreInt16x8AsFloat(v, is_signed, vscale, vmin, dst + i);
     }
-  } else if (camera->type.compare("perspective") == 0) {
-    detail::json_const_iterator perspIt;
-    if (!detail::FindMember(o, "perspective", perspIt)) {
-      if (err) {
-        std::stringstream ss;
-        ss << "Perspective camera description not found." << std::endl;
-        (*err) += ss.str();
+  }
+#elif defined(TINYGLTF_INTERNAL_NEON)
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const float32x4_t vmin = vdupq_n_f32(min_value);
+  if (is_byte) {
+    for (; i + 16 <= n; i += 16) {
+      int32x4_t q[4];
+      if (is_signed) {
+        const int8x16_t b = vld1q_s8(reinterpret_cast<const int8_t *>(src + i));
+        const int16x8_t lo = vmovl_s8(vget_low_s8(b));
+        const int16x8_t hi = vmovl_s8(vget_high_s8(b));
+        q[0] = vmovl_s16(vget_low_s16(lo));
+        q[1] = vmovl_s16(vget_high_s16(lo));
+        q[2] = vmovl_s16(vget_low_s16(hi));
+        q[3] = vmovl_s16(vget_high_s16(hi));
+      } else {
+        const uint8x16_t b = vld1q_u8(src + i);
+        const uint16x8_t lo = vmovl_u8(vget_low_u8(b));
+        const uint16x8_t hi = vmovl_u8(vget_high_u8(b));
+        q[0] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(lo)));
+        q[1] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(lo)));
+        q[2] = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(hi)));
+        q[3] = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(hi)));
+      }
+      for (int k = 0; k < 4; k++) {
+        StoreInt32x4AsFloat(vcvtq_f32_s32(q[k]), vscale, vmin,
+                            dst + i + 4 * size_t(k));
       }
-      return false;
     }
-
-    const detail::json &v = detail::GetValue(perspIt);
-    if (!detail::IsObject(v)) {
-      if (err) {
-        std::stringstream ss;
-        ss << "\"perspective\" is not a JSON object." << std::endl;
-        (*err) += ss.str();
+  } else if (is_short) {
+    for (; i + 8 <= n; i += 8) {
+      int32x4_t lo, hi;
+      if (is_signed) {
+        const int16x8_t v =
+            vld1q_s16(reinterpret_cast<const int16_t *>(src + 2 * i));
+        lo = vmovl_s16(vget_low_s16(v));
+        hi = vmovl_s16(vget_high_s16(v));
+      } else {
+        const uint16x8_t v =
+            vld1q_u16(reinterpret_cast<const uint16_t *>(src + 2 * i));
+        lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+        hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
       }
-      return false;
+      StoreInt32x4AsFloat(vcvtq_f32_s32(lo), vscale, vmin, dst + i);
+      StoreInt32x4AsFloat(vcvtq_f32_s32(hi), vscale, vmin, dst + i + 4);
     }
+  }
+#else
+  (void)src;
+  (void)n;
+  (void)scale;
+  (void)dst;
+  (void)is_byte;
+  (void)is_short;
+  (void)is_signed;
+  (void)min_value;
+#endif
+  return i;
+}
 
-    if (!ParsePerspectiveCamera(
-            &camera->perspective, err, v,
-            store_original_json_for_extras_and_extensions)) {
-      return false;
+// Scale of normalized integer components(1 for other components).
+static void GetFloatConversionScale(int component_type, bool normalized,
+                                    float *scale, bool *snorm) {
+  *scale = 1.0f;
+  *snorm = false;
+  if (!normalized) {
+    return;
+  }
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      *scale = 1.0f / 127.0f;
+      *snorm = true;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      *scale = 1.0f / 255.0f;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      *scale = 1.0f / 32767.0f;
+      *snorm = true;
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      *scale = 1.0f / 65535.0f;
+      break;
+    default:
+      break;
+  }
+}
+
+static void ConvertComponentsToFloat(int component_type,
+                                     const unsigned char *src,
+                                     size_t src_stride, size_t count,
+                                     size_t num_components, float scale,
+                                     bool snorm, float *dst,
+                                     size_t element_stride,
+                                     size_t component_stride) {
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      ConvertComponentsToFloat<int8_t>(src, src_stride, count, num_components,
+                                       scale, snorm, dst, element_stride,
+                                       component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      ConvertComponentsToFloat<uint8_t>(src, src_stride, count, num_components,
+                                        scale, snorm, dst, element_stride,
+                                        component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      ConvertComponentsToFloat<int16_t>(src, src_stride, count, num_components,
+                                        scale, snorm, dst, element_stride,
+                                        component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      ConvertComponentsToFloat<uint16_t>(src, src_stride, count,
+                                         num_components, scale, snorm, dst,
+                                         element_stride, component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_INT:
+      ConvertComponentsToFloat<int32_t>(src, src_stride, count, num_components,
+                                        scale, snorm, dst, element_stride,
+                                        component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      ConvertComponentsToFloat<uint32_t>(src, src_stride, count,
+                                         num_components, scale, snorm, dst,
+                                         element_stride, component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+      ConvertComponentsToFloat<float>(src, src_stride, count, num_components,
+                                      scale, snorm, dst, element_stride,
+                                      component_stride);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+      ConvertComponentsToFloat<double>(src, src_stride, count, num_components,
+                                       scale, snorm, dst, element_stride,
+                                       component_stride);
+      break;
+    default:
+      break;
+  }
+}
+
+static bool ConvertAccessorToFloat(const Model &model,
+                                   const AccessorFloatTarget &target,
+                                   std::string *err) {
+  if ((target.accessor < 0) ||
+      (size_t(target.accessor) >= model.accessors.size())) {
+    if (err) {
+      (*err) += "Invalid accessor index " + std::to_string(target.accessor) +
+                ".\n";
     }
-  } else {
+    return false;
+  }
+  const Accessor &accessor = model.accessors[size_t(target.accessor)];
+  const std::string name = "accessor[" + std::to_string(target.accessor) + "]";
+  if (!target.dst) {
     if (err) {
-      std::stringstream ss;
-      ss << "Invalid camera type: \"" << camera->type
-         << "\". Must be \"perspective\" or \"orthographic\"" << std::endl;
-      (*err) += ss.str();
+      (*err) += name + ": no destination.\n";
     }
     return false;
   }
 
-  ParseStringProperty(&camera->name, err, o, "name", false);
-
-  ParseExtrasAndExtensions(camera, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
-}
-
-static bool ParseLight(Light *light, std::string *err, const detail::json &o,
-                       bool store_original_json_for_extras_and_extensions) {
-  if (!ParseStringProperty(&light->type, err, o, "type", true)) {
+  const int component_type = accessor.componentType;
+  const int component_size =
+      GetComponentSizeInBytes(static_cast<uint32_t>(component_type));
+  const int num_components =
+      GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+  if ((component_size <= 0) || (num_components <= 0)) {
+    if (err) {
+      (*err) += name + ": invalid componentType or type.\n";
+    }
     return false;
   }
+  const size_t elem_size = size_t(component_size) * size_t(num_components);
+  const size_t count = accessor.count;
+  if (count == 0) {
+    return true;
+  }
 
-  if (light->type == "spot") {
-    detail::json_const_iterator spotIt;
-    if (!detail::FindMember(o, "spot", spotIt)) {
+  std::vector<unsigned char> materialized;
+  const unsigned char *src = nullptr;
+  size_t src_stride = elem_size;
+  if (accessor.sparse.isSparse || (accessor.bufferView < 0)) {
+    if (!MaterializeAccessor(model, target.accessor, &materialized, err)) {
+      return false;
+    }
+    src = materialized.data();
+  } else {
+    if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
       if (err) {
-        std::stringstream ss;
-        ss << "Spot light description not found." << std::endl;
-        (*err) += ss.str();
+        (*err) += name + ": invalid bufferView.\n";
       }
       return false;
     }
-
-    const detail::json &v = detail::GetValue(spotIt);
-    if (!detail::IsObject(v)) {
+    const int stride =
+        accessor.ByteStride(model.bufferViews[size_t(accessor.bufferView)]);
+    if ((stride <= 0) || (size_t(stride) < elem_size)) {
       if (err) {
-        std::stringstream ss;
-        ss << "\"spot\" is not a JSON object." << std::endl;
-        (*err) += ss.str();
+        (*err) += name + ": invalid byteStride.\n";
       }
       return false;
     }
-
-    if (!ParseSpotLight(&light->spot, err, v,
-                        store_original_json_for_extras_and_extensions)) {
+    src_stride = size_t(stride);
+    src = GetBufferViewData(model, accessor.bufferView, accessor.byteOffset,
+                            count, elem_size, src_stride, name, err);
+    if (!src) {
       return false;
     }
   }
 
-  ParseStringProperty(&light->name, err, o, "name", false);
-  ParseNumberArrayProperty(&light->color, err, o, "color", false);
-  ParseNumberProperty(&light->range, err, o, "range", false);
-  ParseNumberProperty(&light->intensity, err, o, "intensity", false);
-
-  ParseExtrasAndExtensions(light, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
-}
-
-static bool ParsePositionalEmitter(
-    PositionalEmitter *positional, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  ParseNumberProperty(&positional->coneInnerAngle, err, o, "coneInnerAngle",
-                      false);
-  ParseNumberProperty(&positional->coneOuterAngle, err, o, "coneOuterAngle",
-                      false);
-  ParseNumberProperty(&positional->coneOuterGain, err, o, "coneOuterGain",
-                      false);
-  ParseNumberProperty(&positional->maxDistance, err, o, "maxDistance", false);
-  ParseNumberProperty(&positional->refDistance, err, o, "refDistance", false);
-  ParseNumberProperty(&positional->rolloffFactor, err, o, "rolloffFactor",
-                      false);
-
-  ParseExtrasAndExtensions(positional, err, o,
-                           store_original_json_for_extras_and_extensions);
-
+  float scale = 1.0f;
+  bool snorm = false;
+  GetFloatConversionScale(component_type, accessor.normalized, &scale, &snorm);
+
+  const size_t nc = size_t(num_components);
+  const size_t element_stride =
+      target.element_stride ? target.element_stride : nc;
+  const size_t component_stride =
+      target.component_stride ? target.component_stride : 1;
+  float *dst = target.dst;
+
+  size_t n = count;
+  size_t ncomp = nc;
+  size_t es = element_stride;
+  size_t cs = component_stride;
+  if ((src_stride == elem_size) && (element_stride == nc) &&
+      (component_stride == 1)) {
+    // Both sides are packed: convert as a flat array.
+    n = count * nc;
+    if (component_type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      std::memcpy(dst, src, n * sizeof(float));
+      return true;
+    }
+    const size_t done =
+        ConvertArrayToFloatSIMD(src, component_type, n, scale, snorm, dst);
+    src += done * size_t(component_size);
+    dst += done;
+    n -= done;
+    ncomp = 1;
+    es = 1;
+    cs = 1;
+    src_stride = size_t(component_size);
+  }
+
+  ConvertComponentsToFloat(component_type, src, src_stride, n, ncomp, scale,
+                           snorm, dst, es, cs);
   return true;
 }
 
-static bool ParseAudioEmitter(
-    AudioEmitter *emitter, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  if (!ParseStringProperty(&emitter->type, err, o, "type", true)) {
-    return false;
-  }
-
-  if (emitter->type == "positional") {
-    detail::json_const_iterator positionalIt;
-    if (!detail::FindMember(o, "positional", positionalIt)) {
-      if (err) {
-        std::stringstream ss;
-        ss << "Positional emitter description not found." << std::endl;
-        (*err) += ss.str();
-      }
-      return false;
-    }
-
-    const detail::json &v = detail::GetValue(positionalIt);
-    if (!detail::IsObject(v)) {
+static bool ConvertAccessorsToFloat(
+    const Model &model, const std::vector<AccessorFloatTarget> &targets,
+    std::string *err, int num_threads, const TaskExecutorFunction &executor) {
+  std::vector<std::string> errs(targets.size());
+  std::vector<char> results(targets.size(), 0);
+  detail::ParallelFor(targets.size(), num_threads, executor, [&](size_t i) {
+    results[i] = ConvertAccessorToFloat(model, targets[i], &errs[i]) ? 1 : 0;
+  });
+
+  bool ok = true;
+  for (size_t i = 0; i < targets.size(); i++) {
+    if (!results[i]) {
+      ok = false;
       if (err) {
-        std::stringstream ss;
-        ss << "\"positional\" is not a JSON object." << std::endl;
-        (*err) += ss.str();
+        (*err) += errs[i];
       }
-      return false;
-    }
-
-    if (!ParsePositionalEmitter(
-            &emitter->positional, err, v,
-            store_original_json_for_extras_and_extensions)) {
-      return false;
     }
   }
-
-  ParseStringProperty(&emitter->name, err, o, "name", false);
-  ParseNumberProperty(&emitter->gain, err, o, "gain", false);
-  ParseBooleanProperty(&emitter->loop, err, o, "loop", false);
-  ParseBooleanProperty(&emitter->playing, err, o, "playing", false);
-  ParseStringProperty(&emitter->distanceModel, err, o, "distanceModel", false);
-  ParseIntegerProperty(&emitter->source, err, o, "source", true);
-
-  ParseExtrasAndExtensions(emitter, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
+  return ok;
 }
 
-static bool ParseAudioSource(
-    AudioSource *source, std::string *err, const detail::json &o,
-    bool store_original_json_for_extras_and_extensions) {
-  ParseStringProperty(&source->name, err, o, "name", false);
-  ParseStringProperty(&source->uri, err, o, "uri", false);
-
-  if (source->uri.empty()) {
-    ParseIntegerProperty(&source->bufferView, err, o, "bufferView", true);
-    ParseStringProperty(&source->mimeType, err, o, "mimeType", true);
-  }
-
-  ParseExtrasAndExtensions(source, err, o,
-                           store_original_json_for_extras_and_extensions);
-
-  return true;
+bool ConvertAccessorsToFloat(const Model &model,
+                             const std::vector<AccessorFloatTarget> &targets,
+                             std::string *err, int num_threads) {
+  return ConvertAccessorsToFloat(model, targets, err, num_threads,
+                                 TaskExecutorFunction());
 }
 
-namespace detail {
+//
+// Resolved source of an accessor: strided elements in memory. `storage` holds
+// the materialized data of sparse accessors.
+//
+struct AccessorSource {
+  const unsigned char *data{nullptr};
+  size_t stride{0};
+  size_t count{0};
+  int component_type{-1};
+  size_t num_components{0};
+  std::vector<unsigned char> storage;
+};
 
-template <typename Callback>
-bool ForEachInArray(const detail::json &_v, const char *member, Callback &&cb) {
-  detail::json_const_iterator itm;
-  if (detail::FindMember(_v, member, itm) &&
-      detail::IsArray(detail::GetValue(itm))) {
-    const detail::json &root = detail::GetValue(itm);
-    auto it = detail::ArrayBegin(root);
-    auto end = detail::ArrayEnd(root);
-    for (; it != end; ++it) {
-      if (!cb(*it)) return false;
+static bool ResolveAccessorSource(const Model &model, int accessor_idx,
+                                  AccessorSource *source, std::string *err) {
+  if ((accessor_idx < 0) || (size_t(accessor_idx) >= model.accessors.size())) {
+    if (err) {
+      (*err) += "Invalid accessor index " + std::to_string(accessor_idx) +
+                ".\n";
     }
+    return false;
   }
-  return true;
-};
+  const Accessor &accessor = model.accessors[size_t(accessor_idx)];
+  const std::string name = "accessor[" + std::to_string(accessor_idx) + "]";
 
-}  // end of namespace detail
-
-bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
-                              const char *json_str,
-                              unsigned int json_str_length,
-                              const std::string &base_dir,
-                              unsigned int check_sections) {
-  if (json_str_length < 4) {
+  const int component_size =
+      GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+  const int num_components =
+      GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+  if ((component_size <= 0) || (num_components <= 0)) {
     if (err) {
-      (*err) = "JSON string too short.\n";
+      (*err) += name + ": invalid componentType or type.\n";
     }
     return false;
   }
+  const size_t elem_size = size_t(component_size) * size_t(num_components);
 
-  detail::JsonDocument v;
+  source->component_type = accessor.componentType;
+  source->num_components = size_t(num_components);
+  source->count = accessor.count;
+  source->stride = elem_size;
+  if (accessor.count == 0) {
+    return true;
+  }
 
-#if (defined(__cpp_exceptions) || defined(__EXCEPTIONS) || \
-     defined(_CPPUNWIND)) &&                               \
-    !defined(TINYGLTF_NOEXCEPTION)
-  try {
-    detail::JsonParse(v, json_str, json_str_length, true);
+  if (accessor.sparse.isSparse || (accessor.bufferView < 0)) {
+    if (!MaterializeAccessor(model, accessor_idx, &source->storage, err)) {
+      return false;
+    }
+    source->data = source->storage.data();
+    return true;
+  }
 
-  } catch (const std::exception &e) {
+  if (size_t(accessor.bufferView) >= model.bufferViews.size()) {
     if (err) {
-      (*err) = e.what();
+      (*err) += name + ": invalid bufferView.\n";
     }
     return false;
   }
-#else
-  {
-    detail::JsonParse(v, json_str, json_str_length);
+  const int stride =
+      accessor.ByteStride(model.bufferViews[size_t(accessor.bufferView)]);
+  if ((stride <= 0) || (size_t(stride) < elem_size)) {
+    if (err) {
+      (*err) += name + ": invalid byteStride.\n";
+    }
+    return false;
+  }
+  source->stride = size_t(stride);
+  source->data =
+      GetBufferViewData(model, accessor.bufferView, accessor.byteOffset,
+                        accessor.count, elem_size, size_t(stride), name, err);
+  return source->data != nullptr;
+}
 
-    if (!detail::IsObject(v)) {
-      // Assume parsing was failed.
-      if (err) {
-        (*err) = "Failed to parse JSON object\n";
-      }
-      return false;
+template <typename T>
+static void ReduceMinMax(const unsigned char *src, size_t stride, size_t begin,
+                         size_t end, size_t nc, double *out_min,
+                         double *out_max) {
+  T lo[16], hi[16];
+  std::memcpy(lo, src + begin * stride, nc * sizeof(T));
+  std::memcpy(hi, lo, nc * sizeof(T));
+  for (size_t i = begin + 1; i < end; i++) {
+    T v[16];
+    std::memcpy(v, src + i * stride, nc * sizeof(T));
+    for (size_t c = 0; c < nc; c++) {
+      lo[c] = (v[c] < lo[c]) ? v[c] : lo[c];
+      hi[c] = (v[c] > hi[c]) ? v[c] : hi[c];
     }
   }
+  for (size_t c = 0; c < nc; c++) {
+    out_min[c] = double(lo[c]);
+    out_max[c] = double(hi[c]);
+  }
+}
+
+//
+// min/max of float VEC2..VEC4 elements with 4-wide loads. `end` is limited so
+// that the 16 byte load of the last element stays inside of `src_bytes`.
+//
+static void ReduceMinMaxFloat(const unsigned char *src, size_t src_bytes,
+                              size_t stride, size_t begin, size_t end,
+                              size_t nc, double *out_min, double *out_max) {
+  size_t simd_end = begin;
+#if defined(TINYGLTF_INTERNAL_SSE2) || defined(TINYGLTF_INTERNAL_NEON)
+  if ((nc >= 2) && (nc <= 4) && (src_bytes >= 16)) {
+    simd_end = (std::max)(begin, (std::min)(end, (src_bytes - 16) / stride + 1));
+  }
+#else
+  (void)src_bytes;
 #endif
 
-  if (!detail::IsObject(v)) {
-    // root is not an object.
-    if (err) {
-      (*err) = "Root element is not a JSON object\n";
+  float lo[4], hi[4];
+  bool initialized = false;
+  if (simd_end > begin) {
+#if defined(TINYGLTF_INTERNAL_SSE2)
+    __m128 vlo = _mm_loadu_ps(reinterpret_cast<const float *>(src + begin * stride));
+    __m128 vhi = vlo;
+    for (size_t i = begin + 1; i < simd_end; i++) {
+      const __m128 v =
+          _mm_loadu_ps(reinterpret_cast<const float *>(src + i * stride));
+      vlo = _mm_min_ps(vlo, v);
+      vhi = _mm_max_ps(vhi, v);
     }
-    return false;
+    _mm_storeu_ps(lo, vlo);
+    _mm_storeu_ps(hi, vhi);
+#elif defined(TINYGLTF_INTERNAL_NEON)
+    float32x4_t vlo =
+        vld1q_f32(reinterpret_cast<const float *>(src + begin * stride));
+    float32x4_t vhi = vlo;
+    for (size_t i = begin + 1; i < simd_end; i++) {
+      const float32x4_t v =
+          vld1q_f32(reinterpret_cast<const float *>(src + i * stride));
+      vlo = vminq_f32(vlo, v);
+      vhi = vmaxq_f32(vhi, v);
+    }
+    vst1q_f32(lo, vlo);
+    vst1q_f32(hi, vhi);
+#endif
+    initialized = true;
   }
 
-  {
-    bool version_found = false;
-    detail::json_const_iterator it;
-    if (detail::FindMember(v, "asset", it) &&
-        detail::IsObject(detail::GetValue(it))) {
-      auto &itObj = detail::GetValue(it);
-      detail::json_const_iterator version_it;
-      std::string versionStr;
-      if (detail::FindMember(itObj, "version", version_it) &&
-          detail::GetString(detail::GetValue(version_it), versionStr)) {
-        version_found = true;
-      }
-    }
-    if (version_found) {
-      // OK
-    } else if (check_sections & REQUIRE_VERSION) {
-      if (err) {
-        (*err) += "\"asset\" object not found in .gltf or not an object type\n";
+  if (simd_end < end) {
+    double tail_min[16], tail_max[16];
+    ReduceMinMax<float>(src, stride, simd_end, end, nc, tail_min, tail_max);
+    for (size_t c = 0; c < nc; c++) {
+      if (!initialized) {
+        lo[c] = float(tail_min[c]);
+        hi[c] = float(tail_max[c]);
+      } else {
+        lo[c] = (std::min)(lo[c], float(tail_min[c]));
+        hi[c] = (std::max)(hi[c], float(tail_max[c]));
       }
-      return false;
     }
   }
 
-  // scene is not mandatory.
-  // FIXME Maybe a better way to handle it than removing the code
+  for (size_t c = 0; c < nc; c++) {
+    out_min[c] = double(lo[c]);
+    out_max[c] = double(hi[c]);
+  }
+}
 
-  auto IsArrayMemberPresent = [](const detail::json &_v,
-                                 const char *name) -> bool {
-    detail::json_const_iterator it;
-    return detail::FindMember(_v, name, it) &&
-           detail::IsArray(detail::GetValue(it));
-  };
+static void ReduceAccessorMinMax(const AccessorSource &source, size_t begin,
+                                 size_t end, double *out_min,
+                                 double *out_max) {
+  const unsigned char *src = source.data;
+  const size_t stride = source.stride;
+  const size_t nc = source.num_components;
+  switch (source.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      ReduceMinMax<int8_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      ReduceMinMax<uint8_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      ReduceMinMax<int16_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      ReduceMinMax<uint16_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_INT:
+      ReduceMinMax<int32_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      ReduceMinMax<uint32_t>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+      const size_t src_bytes =
+          (source.count - 1) * stride + nc * sizeof(float);
+      ReduceMinMaxFloat(src, src_bytes, stride, begin, end, nc, out_min,
+                        out_max);
+      break;
+    }
+    case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+      ReduceMinMax<double>(src, stride, begin, end, nc, out_min, out_max);
+      break;
+    default:
+      break;
+  }
+}
 
-  {
-    if ((check_sections & REQUIRE_SCENES) &&
-        !IsArrayMemberPresent(v, "scenes")) {
+//
+// Computes bounds of `accessors` into `bounds`. `ok[i]` is false when
+// accessors[i] is invalid or empty.
+//
+static bool ComputeBoundsOfAccessors(const Model &model,
+                                     const std::vector<int> &accessors,
+                                     int num_threads,
+                                     std::vector<AccessorBounds> *bounds,
+                                     std::vector<char> *ok, std::string *err) {
+  const size_t n = accessors.size();
+  std::vector<AccessorSource> sources(n);
+  std::vector<std::string> errs(n);
+  ok->assign(n, 0);
+  detail::ParallelFor(n, num_threads, [&](size_t i) {
+    (*ok)[i] =
+        ResolveAccessorSource(model, accessors[i], &sources[i], &errs[i]) ? 1
+                                                                          : 0;
+  });
+
+  bool success = true;
+  for (size_t i = 0; i < n; i++) {
+    if (!(*ok)[i]) {
+      success = false;
       if (err) {
-        (*err) += "\"scenes\" object not found in .gltf or not an array type\n";
+        (*err) += errs[i];
       }
-      return false;
     }
   }
 
-  {
-    if ((check_sections & REQUIRE_NODES) && !IsArrayMemberPresent(v, "nodes")) {
-      if (err) {
-        (*err) += "\"nodes\" object not found in .gltf\n";
-      }
-      return false;
+  // Split accessors into chunks so that a single large accessor is reduced
+  // on all threads.
+  const size_t kChunkSize = 64 * 1024;
+  struct Chunk {
+    size_t source;
+    size_t begin;
+    size_t end;
+    double min[16];
+    double max[16];
+  };
+  std::vector<Chunk> chunks;
+  for (size_t i = 0; i < n; i++) {
+    if (!(*ok)[i] || (sources[i].count == 0)) {
+      (*ok)[i] = 0;
+      continue;
+    }
+    for (size_t begin = 0; begin < sources[i].count; begin += kChunkSize) {
+      Chunk chunk;
+      chunk.source = i;
+      chunk.begin = begin;
+      chunk.end = (std::min)(begin + kChunkSize, sources[i].count);
+      chunks.push_back(chunk);
     }
   }
 
-  {
-    if ((check_sections & REQUIRE_ACCESSORS) &&
-        !IsArrayMemberPresent(v, "accessors")) {
-      if (err) {
-        (*err) += "\"accessors\" object not found in .gltf\n";
+  detail::ParallelFor(chunks.size(), num_threads, [&](size_t k) {
+    Chunk &chunk = chunks[k];
+    ReduceAccessorMinMax(sources[chunk.source], chunk.begin, chunk.end,
+                         chunk.min, chunk.max);
+  });
+
+  bounds->assign(n, AccessorBounds());
+  for (size_t i = 0; i < n; i++) {
+    (*bounds)[i].accessor = accessors[i];
+  }
+  for (const Chunk &chunk : chunks) {
+    AccessorBounds &b = (*bounds)[chunk.source];
+    const size_t nc = sources[chunk.source].num_components;
+    if (b.min.empty()) {
+      b.min.assign(chunk.min, chunk.min + nc);
+      b.max.assign(chunk.max, chunk.max + nc);
+    } else {
+      for (size_t c = 0; c < nc; c++) {
+        b.min[c] = (std::min)(b.min[c], chunk.min[c]);
+        b.max[c] = (std::max)(b.max[c], chunk.max[c]);
       }
-      return false;
     }
   }
 
-  {
-    if ((check_sections & REQUIRE_BUFFERS) &&
-        !IsArrayMemberPresent(v, "buffers")) {
-      if (err) {
-        (*err) += "\"buffers\" object not found in .gltf\n";
-      }
-      return false;
+  return success;
+}
+
+bool ComputeAccessorBounds(Model *model, const AccessorBoundsOptions &options,
+                           std::string *err,
+                           std::vector<AccessorBounds> *bounds) {
+  std::vector<int> accessors;
+  if (options.accessors.empty()) {
+    for (size_t i = 0; i < model->accessors.size(); i++) {
+      accessors.push_back(int(i));
     }
+  } else {
+    accessors = options.accessors;
   }
 
-  {
-    if ((check_sections & REQUIRE_BUFFER_VIEWS) &&
-        !IsArrayMemberPresent(v, "bufferViews")) {
-      if (err) {
-        (*err) += "\"bufferViews\" object not found in .gltf\n";
+  if (options.only_missing) {
+    std::vector<int> missing;
+    for (int idx : accessors) {
+      if ((idx >= 0) && (size_t(idx) < model->accessors.size())) {
+        const Accessor &accessor = model->accessors[size_t(idx)];
+        if (!accessor.minValues.empty() && !accessor.maxValues.empty()) {
+          continue;
+        }
       }
-      return false;
+      missing.push_back(idx);
     }
+    accessors.swap(missing);
   }
 
-  // Reset the model
-  (*model) = Model();
+  std::vector<AccessorBounds> results;
+  std::vector<char> ok;
+  const bool success = ComputeBoundsOfAccessors(
+      *model, accessors, options.num_threads, &results, &ok, err);
 
-  // 1. Parse Asset
-  {
-    detail::json_const_iterator it;
-    if (detail::FindMember(v, "asset", it) &&
-        detail::IsObject(detail::GetValue(it))) {
-      const detail::json &root = detail::GetValue(it);
+  if (options.update_accessors) {
+    for (size_t i = 0; i < results.size(); i++) {
+      if (ok[i]) {
+        Accessor &accessor = model->accessors[size_t(results[i].accessor)];
+        accessor.minValues = results[i].min;
+        accessor.maxValues = results[i].max;
+      }
+    }
+  }
 
-      ParseAsset(&model->asset, err, root,
-                 store_original_json_for_extras_and_extensions_);
+  if (bounds) {
+    bounds->clear();
+    for (size_t i = 0; i < results.size(); i++) {
+      if (ok[i]) {
+        bounds->push_back(std::move(results[i]));
+      }
     }
   }
 
-  using detail::ForEachInArray;
+  return success;
+}
 
-  // 2. Parse extensionUsed
-  {
-    ForEachInArray(v, "extensionsUsed", [&](const detail::json &o) {
-      std::string str;
-      detail::GetString(o, str);
-      model->extensionsUsed.emplace_back(std::move(str));
-      return true;
-    });
+bool ComputeAccessorBounds(const Model &model, int accessor_idx,
+                           AccessorBounds *bounds, std::string *err,
+                           int num_threads) {
+  std::vector<AccessorBounds> results;
+  std::vector<char> ok;
+  if (!ComputeBoundsOfAccessors(model, std::vector<int>(1, accessor_idx),
+                                num_threads, &results, &ok, err)) {
+    return false;
   }
+  *bounds = std::move(results[0]);
+  return true;
+}
 
-  {
-    ForEachInArray(v, "extensionsRequired", [&](const detail::json &o) {
-      std::string str;
-      detail::GetString(o, str);
-      model->extensionsRequired.emplace_back(std::move(str));
-      return true;
-    });
+//
+// Widens indices of `source`(UNSIGNED_BYTE/SHORT/INT) to 32 bit.
+//
+static bool WidenIndices(const AccessorSource &source,
+                         std::vector<uint32_t> *out, std::string *err) {
+  const size_t n = source.count;
+  out->resize(n);
+  if (n == 0) {
+    return true;
   }
-
-  // 3. Parse Buffer
-  {
-    bool success = ForEachInArray(v, "buffers", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`buffers' does not contain an JSON object.";
+  uint32_t *dst = out->data();
+  const unsigned char *src = source.data;
+  size_t i = 0;
+  if (source.num_components != 1) {
+    if (err) {
+      (*err) += "Indices must be SCALAR.\n";
+    }
+    return false;
+  }
+  switch (source.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+#if defined(TINYGLTF_INTERNAL_SSE2)
+      if (source.stride == 1) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16) {
+          const __m128i b =
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+          const __m128i lo = _mm_unpacklo_epi8(b, zero);
+          const __m128i hi = _mm_unpackhi_epi8(b, zero);
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                           _mm_unpacklo_epi16(lo, zero));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4),
+                           _mm_unpackhi_epi16(lo, zero));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8),
+                           _mm_unpacklo_epi16(hi, zero));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 12),
+                           _mm_unpackhi_epi16(hi, zero));
         }
-        return false;
       }
-      Buffer buffer;
-      if (!ParseBuffer(&buffer, err, o,
-                       store_original_json_for_extras_and_extensions_, &fs,
-                       &uri_cb, base_dir, max_external_file_size_, is_binary_,
-                       bin_data_, bin_size_)) {
-        return false;
+#elif defined(TINYGLTF_INTERNAL_NEON)
+      if (source.stride == 1) {
+        for (; i + 16 <= n; i += 16) {
+          const uint8x16_t b = vld1q_u8(src + i);
+          const uint16x8_t lo = vmovl_u8(vget_low_u8(b));
+          const uint16x8_t hi = vmovl_u8(vget_high_u8(b));
+          vst1q_u32(dst + i, vmovl_u16(vget_low_u16(lo)));
+          vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(lo)));
+          vst1q_u32(dst + i + 8, vmovl_u16(vget_low_u16(hi)));
+          vst1q_u32(dst + i + 12, vmovl_u16(vget_high_u16(hi)));
+        }
       }
-
-      model->buffers.emplace_back(std::move(buffer));
-      return true;
-    });
-
-    if (!success) {
-      return false;
-    }
-  }
-  // 4. Parse BufferView
-  {
-    bool success = ForEachInArray(v, "bufferViews", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`bufferViews' does not contain an JSON object.";
+#endif
+      for (; i < n; i++) {
+        dst[i] = src[i * source.stride];
+      }
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+#if defined(TINYGLTF_INTERNAL_SSE2)
+      if (source.stride == 2) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8) {
+          const __m128i v =
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                           _mm_unpacklo_epi16(v, zero));
+          _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4),
+                           _mm_unpackhi_epi16(v, zero));
         }
-        return false;
       }
-      BufferView bufferView;
-      if (!ParseBufferView(&bufferView, err, o,
-                           store_original_json_for_extras_and_extensions_)) {
-        return false;
+#elif defined(TINYGLTF_INTERNAL_NEON)
+      if (source.stride == 2) {
+        for (; i + 8 <= n; i += 8) {
+          const uint16x8_t v =
+              vld1q_u16(reinterpret_cast<const uint16_t *>(src + 2 * i));
+          vst1q_u32(dst + i, vmovl_u16(vget_low_u16(v)));
+          vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(v)));
+        }
+      }
+#endif
+      for (; i < n; i++) {
+        uint16_t v;
+        std::memcpy(&v, src + i * source.stride, sizeof(uint16_t));
+        dst[i] = v;
+      }
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      if (source.stride == 4) {
+        std::memcpy(dst, src, n * sizeof(uint32_t));
+      } else {
+        for (; i < n; i++) {
+          std::memcpy(dst + i, src + i * source.stride, sizeof(uint32_t));
+        }
+      }
+      break;
+    default:
+      if (err) {
+        (*err) += "Invalid componentType for indices.\n";
       }
-
-      model->bufferViews.emplace_back(std::move(bufferView));
-      return true;
-    });
-
-    if (!success) {
       return false;
-    }
   }
+  return true;
+}
 
-  // 5. Parse Accessor
-  {
-    bool success = ForEachInArray(v, "accessors", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`accessors' does not contain an JSON object.";
-        }
-        return false;
-      }
-      Accessor accessor;
-      if (!ParseAccessor(&accessor, err, o,
-                         store_original_json_for_extras_and_extensions_)) {
-        return false;
+static void AppendTriangle(uint32_t a, uint32_t b, uint32_t c,
+                           bool remove_degenerate,
+                           std::vector<uint32_t> *out) {
+  if (remove_degenerate && ((a == b) || (b == c) || (c == a))) {
+    return;
+  }
+  out->push_back(a);
+  out->push_back(b);
+  out->push_back(c);
+}
+
+//
+// Appends triangles of a run of vertices(no restart inside).
+//
+static void TriangulateRun(int mode, const uint32_t *v, size_t n,
+                           bool remove_degenerate,
+                           std::vector<uint32_t> *out) {
+  if (n < 3) {
+    return;
+  }
+  if (mode == TINYGLTF_MODE_TRIANGLE_STRIP) {
+    // p_i = {v_i, v_{i + (1 + i % 2)}, v_{i + (2 - i % 2)}}
+    for (size_t i = 0; i + 2 < n; i++) {
+      if (i & 1) {
+        AppendTriangle(v[i], v[i + 2], v[i + 1], remove_degenerate, out);
+      } else {
+        AppendTriangle(v[i], v[i + 1], v[i + 2], remove_degenerate, out);
       }
+    }
+  } else if (mode == TINYGLTF_MODE_TRIANGLE_FAN) {
+    // p_i = {v_{i + 1}, v_{i + 2}, v_0}
+    for (size_t i = 0; i + 2 < n; i++) {
+      AppendTriangle(v[i + 1], v[i + 2], v[0], remove_degenerate, out);
+    }
+  } else {
+    if (!remove_degenerate) {
+      out->insert(out->end(), v, v + (n - n % 3));
+      return;
+    }
+    for (size_t i = 0; i + 2 < n; i += 3) {
+      AppendTriangle(v[i], v[i + 1], v[i + 2], remove_degenerate, out);
+    }
+  }
+}
 
-      model->accessors.emplace_back(std::move(accessor));
-      return true;
-    });
+bool GetTriangleIndices(const Model &model, const Primitive &primitive,
+                        std::vector<uint32_t> *triangles, std::string *err,
+                        const TriangulateOptions &options) {
+  const int mode =
+      (primitive.mode < 0) ? TINYGLTF_MODE_TRIANGLES : primitive.mode;
+  if ((mode != TINYGLTF_MODE_TRIANGLES) &&
+      (mode != TINYGLTF_MODE_TRIANGLE_STRIP) &&
+      (mode != TINYGLTF_MODE_TRIANGLE_FAN)) {
+    if (err) {
+      (*err) += "Primitive mode " + std::to_string(mode) +
+                " is not a triangle mode.\n";
+    }
+    return false;
+  }
 
-    if (!success) {
+  std::vector<uint32_t> indices;
+  uint32_t restart_value = 0xffffffffu;
+  if (primitive.indices >= 0) {
+    AccessorSource source;
+    if (!ResolveAccessorSource(model, primitive.indices, &source, err) ||
+        !WidenIndices(source, &indices, err)) {
+      return false;
+    }
+    if (source.component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+      restart_value = 0xffu;
+    } else if (source.component_type ==
+               TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+      restart_value = 0xffffu;
+    }
+  } else {
+    std::map<std::string, int>::const_iterator it =
+        primitive.attributes.find("POSITION");
+    if (it == primitive.attributes.end()) {
+      it = primitive.attributes.begin();
+    }
+    if ((it == primitive.attributes.end()) || (it->second < 0) ||
+        (size_t(it->second) >= model.accessors.size())) {
+      if (err) {
+        (*err) += "Non-indexed primitive has no valid attribute.\n";
+      }
       return false;
     }
+    indices.resize(model.accessors[size_t(it->second)].count);
+    for (size_t i = 0; i < indices.size(); i++) {
+      indices[i] = uint32_t(i);
+    }
   }
 
-  // 6. Parse Mesh
-  {
-    bool success = ForEachInArray(v, "meshes", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`meshes' does not contain an JSON object.";
-        }
-        return false;
-      }
-      Mesh mesh;
-      if (!ParseMesh(&mesh, model, err, warn, o,
-                     store_original_json_for_extras_and_extensions_,
-                     strictness_)) {
-        return false;
-      }
+  triangles->clear();
+  const size_t n = indices.size();
+  if (mode == TINYGLTF_MODE_TRIANGLES) {
+    triangles->reserve(n);
+  } else {
+    triangles->reserve(n > 2 ? 3 * (n - 2) : 0);
+  }
 
-      model->meshes.emplace_back(std::move(mesh));
-      return true;
-    });
+  if (!options.primitive_restart || (primitive.indices < 0)) {
+    TriangulateRun(mode, indices.data(), n, options.remove_degenerate,
+                   triangles);
+    return true;
+  }
 
-    if (!success) {
-      return false;
+  size_t begin = 0;
+  for (size_t i = 0; i <= n; i++) {
+    if ((i == n) || (indices[i] == restart_value)) {
+      TriangulateRun(mode, indices.data() + begin, i - begin,
+                     options.remove_degenerate, triangles);
+      begin = i + 1;
     }
   }
+  return true;
+}
 
-  // Assign missing bufferView target types
-  // - Look for missing Mesh indices
-  // - Look for missing Mesh attributes
-  for (auto &mesh : model->meshes) {
-    for (auto &primitive : mesh.primitives) {
-      if (primitive.indices >
-          -1)  // has indices from parsing step, must be Element Array Buffer
-      {
-        if (size_t(primitive.indices) >= model->accessors.size()) {
-          if (err) {
-            (*err) += "primitive indices accessor out of bounds";
-          }
-          return false;
-        }
-
-        const auto bufferView =
-            model->accessors[size_t(primitive.indices)].bufferView;
-        if (bufferView < 0) {
-          // skip, bufferView could be null(-1) for certain extensions
-        } else if (size_t(bufferView) >= model->bufferViews.size()) {
-          if (err) {
-            (*err) += "accessor[" + std::to_string(primitive.indices) +
-                      "] invalid bufferView";
-          }
-          return false;
-        } else {
-          model->bufferViews[size_t(bufferView)].target =
-              TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
-          // we could optionally check if accessors' bufferView type is Scalar, as
-          // it should be
-        }
-      }
+int GetSmallestIndexComponentType(size_t num_vertices,
+                                  bool allow_unsigned_byte) {
+  if (allow_unsigned_byte && (num_vertices <= 0xff)) {
+    return TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  }
+  if (num_vertices <= 0xffff) {
+    return TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  }
+  return TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+}
 
-      for (auto &attribute : primitive.attributes) {
-        const auto accessorsIndex = size_t(attribute.second);
-        if (accessorsIndex < model->accessors.size()) {
-          const auto bufferView = model->accessors[accessorsIndex].bufferView;
-          // bufferView could be null(-1) for sparse morph target
-          if (bufferView >= 0 && bufferView < (int)model->bufferViews.size()) {
-            model->bufferViews[size_t(bufferView)].target =
-                TINYGLTF_TARGET_ARRAY_BUFFER;
-          }
-        }
-      }
+void NarrowIndices(const uint32_t *src, size_t count, int component_type,
+                   unsigned char *dst) {
+  size_t i = 0;
+  if (component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+#if defined(TINYGLTF_INTERNAL_SSE2)
+    // SSE2 has only a signed saturating pack: bias to the signed range and
+    // back.
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(-0x8000);
+    for (; i + 8 <= count; i += 8) {
+      const __m128i a = _mm_sub_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), bias32);
+      const __m128i b = _mm_sub_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4)),
+          bias32);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i),
+                       _mm_xor_si128(_mm_packs_epi32(a, b), bias16));
+    }
+#elif defined(TINYGLTF_INTERNAL_NEON)
+    for (; i + 8 <= count; i += 8) {
+      const uint16x8_t v = vcombine_u16(vmovn_u32(vld1q_u32(src + i)),
+                                        vmovn_u32(vld1q_u32(src + i + 4)));
+      vst1q_u16(reinterpret_cast<uint16_t *>(dst + 2 * i), v);
+    }
+#endif
+    for (; i < count; i++) {
+      const uint16_t v = static_cast<uint16_t>(src[i]);
+      std::memcpy(dst + 2 * i, &v, sizeof(uint16_t));
+    }
+  } else if (component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+    for (; i < count; i++) {
+      dst[i] = static_cast<unsigned char>(src[i]);
+    }
+  } else {
+    std::memcpy(dst, src, count * sizeof(uint32_t));
+  }
+}
 
-      for (auto &target : primitive.targets) {
-        for (auto &attribute : target) {
-          const auto accessorsIndex = size_t(attribute.second);
-          if (accessorsIndex < model->accessors.size()) {
-            const auto bufferView = model->accessors[accessorsIndex].bufferView;
-            // bufferView could be null(-1) for sparse morph target
-            if (bufferView >= 0 &&
-                bufferView < (int)model->bufferViews.size()) {
-              model->bufferViews[size_t(bufferView)].target =
-                  TINYGLTF_TARGET_ARRAY_BUFFER;
-            }
-          }
-        }
+bool TriangulatePrimitives(Model *model, const TriangulateOptions &options,
+                           std::string *err) {
+  struct Task {
+    size_t mesh;
+    size_t primitive;
+    std::vector<uint32_t> triangles;
+    size_t num_vertices;
+    int component_type;
+    bool ok;
+    std::string err;
+  };
+  std::vector<Task> tasks;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const int mode = model->meshes[m].primitives[p].mode;
+      if ((mode < 0) || (mode == TINYGLTF_MODE_TRIANGLES) ||
+          (mode == TINYGLTF_MODE_TRIANGLE_STRIP) ||
+          (mode == TINYGLTF_MODE_TRIANGLE_FAN)) {
+        Task task;
+        task.mesh = m;
+        task.primitive = p;
+        task.num_vertices = 0;
+        task.component_type = 0;
+        task.ok = false;
+        tasks.push_back(std::move(task));
       }
     }
   }
 
-  // 7. Parse Node
-  {
-    bool success = ForEachInArray(v, "nodes", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`nodes' does not contain an JSON object.";
-        }
-        return false;
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    Task &task = tasks[t];
+    const Primitive &primitive =
+        model->meshes[task.mesh].primitives[task.primitive];
+
+    // Vertex count from attributes, or from the largest index.
+    for (const auto &attrib : primitive.attributes) {
+      if ((attrib.second >= 0) &&
+          (size_t(attrib.second) < model->accessors.size())) {
+        task.num_vertices = (std::max)(
+            task.num_vertices, model->accessors[size_t(attrib.second)].count);
       }
-      Node node;
-      if (!ParseNode(&node, err, o,
-                     store_original_json_for_extras_and_extensions_)) {
-        return false;
+    }
+
+    task.ok = GetTriangleIndices(*model, primitive, &task.triangles,
+                                 &task.err, options);
+    if (!task.ok) {
+      return;
+    }
+    uint32_t max_index = 0;
+    for (uint32_t idx : task.triangles) {
+      max_index = (std::max)(max_index, idx);
+    }
+    if (!task.triangles.empty()) {
+      task.num_vertices = (std::max)(task.num_vertices, size_t(max_index) + 1);
+    }
+    task.component_type =
+        options.index_component_type
+            ? options.index_component_type
+            : GetSmallestIndexComponentType(task.num_vertices,
+                                            options.allow_unsigned_byte);
+    if ((task.component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+         task.num_vertices > 0xff) ||
+        (task.component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+         task.num_vertices > 0xffff)) {
+      task.ok = false;
+      task.err = "Index component type is too small for " +
+                 std::to_string(task.num_vertices) + " vertices.\n";
+    }
+  });
+
+  bool success = true;
+  for (Task &task : tasks) {
+    const std::string name = "mesh[" + std::to_string(task.mesh) +
+                             "].primitives[" +
+                             std::to_string(task.primitive) + "]";
+    if (!task.ok) {
+      success = false;
+      if (err) {
+        (*err) += name + ": " + task.err;
       }
+      continue;
+    }
 
-      model->nodes.emplace_back(std::move(node));
-      return true;
-    });
+    Primitive &primitive = model->meshes[task.mesh].primitives[task.primitive];
+    const int mode =
+        (primitive.mode < 0) ? TINYGLTF_MODE_TRIANGLES : primitive.mode;
+    if ((mode == TINYGLTF_MODE_TRIANGLES) && (primitive.indices >= 0) &&
+        (model->accessors[size_t(primitive.indices)].componentType ==
+         task.component_type) &&
+        !model->accessors[size_t(primitive.indices)].sparse.isSparse &&
+        (model->accessors[size_t(primitive.indices)].count ==
+         task.triangles.size())) {
+      continue;
+    }
 
-    if (!success) {
-      return false;
+    const size_t index_size = size_t(
+        GetComponentSizeInBytes(static_cast<uint32_t>(task.component_type)));
+    std::vector<unsigned char> data(task.triangles.size() * index_size);
+    NarrowIndices(task.triangles.data(), task.triangles.size(),
+                  task.component_type, data.data());
+
+    Accessor accessor;
+    accessor.bufferView =
+        AppendBufferView(model, data.data(), data.size(),
+                         TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+    accessor.componentType = task.component_type;
+    accessor.type = TINYGLTF_TYPE_SCALAR;
+    accessor.count = task.triangles.size();
+    if (!task.triangles.empty()) {
+      const uint32_t max_index =
+          *std::max_element(task.triangles.begin(), task.triangles.end());
+      const uint32_t min_index =
+          *std::min_element(task.triangles.begin(), task.triangles.end());
+      accessor.minValues.push_back(double(min_index));
+      accessor.maxValues.push_back(double(max_index));
     }
+    model->accessors.emplace_back(std::move(accessor));
+
+    primitive.indices = int(model->accessors.size() - 1);
+    primitive.mode = TINYGLTF_MODE_TRIANGLES;
   }
 
-  // 8. Parse scenes.
-  {
-    bool success = ForEachInArray(v, "scenes", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`scenes' does not contain an JSON object.";
-        }
-        return false;
-      }
+  return success;
+}
 
-      Scene scene;
-      if (!ParseScene(&scene, err, o,
-                      store_original_json_for_extras_and_extensions_)) {
-        return false;
+//
+// 64-bit hash of a byte sequence(8 bytes per step, multiply-xorshift mixing).
+//
+static uint64_t HashBytes64(const unsigned char *data, size_t size,
+                            uint64_t seed = 0) {
+  const uint64_t m = 0x9e3779b97f4a7c15ull;
+  uint64_t h = seed ^ (uint64_t(size) * m);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t k;
+    std::memcpy(&k, data + i, sizeof(uint64_t));
+    k *= 0xbf58476d1ce4e5b9ull;
+    k ^= k >> 31;
+    h = (h ^ k) * m;
+    h ^= h >> 29;
+  }
+  if (i < size) {
+    uint64_t k = 0;
+    std::memcpy(&k, data + i, size - i);
+    k *= 0xbf58476d1ce4e5b9ull;
+    k ^= k >> 31;
+    h = (h ^ k) * m;
+  }
+  h ^= h >> 32;
+  h *= 0x94d049bb133111ebull;
+  h ^= h >> 29;
+  return h;
+}
+
+//
+// Finds the first vertex with an identical key for each vertex, using an
+// open-addressing(linear probing) hash table.
+//
+static void FindUniqueVertices(const unsigned char *keys, size_t key_size,
+                               size_t count, std::vector<uint32_t> *canonical) {
+  size_t capacity = 16;
+  while (capacity < count * 2) {
+    capacity *= 2;
+  }
+  const uint32_t kEmpty = 0xffffffffu;
+  std::vector<uint32_t> table(capacity, kEmpty);
+  canonical->resize(count);
+  for (size_t v = 0; v < count; v++) {
+    const unsigned char *key = keys + v * key_size;
+    size_t slot = size_t(HashBytes64(key, key_size)) & (capacity - 1);
+    for (;;) {
+      const uint32_t entry = table[slot];
+      if (entry == kEmpty) {
+        table[slot] = uint32_t(v);
+        (*canonical)[v] = uint32_t(v);
+        break;
       }
+      if (std::memcmp(keys + size_t(entry) * key_size, key, key_size) == 0) {
+        (*canonical)[v] = entry;
+        break;
+      }
+      slot = (slot + 1) & (capacity - 1);
+    }
+  }
+}
 
-      model->scenes.emplace_back(std::move(scene));
-      return true;
-    });
+//
+// Vertex data of a primitive accessor(attribute or morph target attribute).
+//
+struct VertexStream {
+  int accessor{-1};
+  AccessorSource source;
+  size_t elem_size{0};
+  std::vector<unsigned char> data;  // reordered, 4 byte aligned elements
+};
 
-    if (!success) {
-      return false;
+// Attribute accessors followed by morph target attribute accessors.
+static std::vector<int> GetPrimitiveStreamAccessors(const Primitive &primitive) {
+  std::vector<int> accessors;
+  for (const auto &attrib : primitive.attributes) {
+    accessors.push_back(attrib.second);
+  }
+  for (const auto &target : primitive.targets) {
+    for (const auto &attrib : target) {
+      accessors.push_back(attrib.second);
     }
   }
+  return accessors;
+}
 
-  // 9. Parse default scenes.
-  {
-    detail::json_const_iterator rootIt;
-    int iVal;
-    if (detail::FindMember(v, "scene", rootIt) &&
-        detail::GetInt(detail::GetValue(rootIt), iVal)) {
-      model->defaultScene = iVal;
+static void SetPrimitiveStreamAccessors(Primitive *primitive,
+                                        const std::vector<int> &accessors) {
+  size_t s = 0;
+  for (auto &attrib : primitive->attributes) {
+    attrib.second = accessors[s++];
+  }
+  for (auto &target : primitive->targets) {
+    for (auto &attrib : target) {
+      attrib.second = accessors[s++];
     }
   }
+}
 
-  // 10. Parse Material
-  {
-    bool success = ForEachInArray(v, "materials", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`materials' does not contain an JSON object.";
-        }
-        return false;
+static bool ResolveVertexStreams(const Model &model, const Primitive &primitive,
+                                 std::vector<VertexStream> *streams,
+                                 size_t *num_vertices, std::string *err) {
+  const std::vector<int> accessors = GetPrimitiveStreamAccessors(primitive);
+  streams->resize(accessors.size());
+  *num_vertices = 0;
+  for (size_t s = 0; s < accessors.size(); s++) {
+    VertexStream &stream = (*streams)[s];
+    stream.accessor = accessors[s];
+    if (!ResolveAccessorSource(model, accessors[s], &stream.source, err)) {
+      return false;
+    }
+    stream.elem_size = size_t(GetComponentSizeInBytes(
+                           uint32_t(stream.source.component_type))) *
+                       stream.source.num_components;
+    if ((s > 0) && (stream.source.count != *num_vertices)) {
+      if (err) {
+        (*err) += "Attribute accessors have different counts.\n";
       }
-      Material material;
-      ParseStringProperty(&material.name, err, o, "name", false);
+      return false;
+    }
+    *num_vertices = stream.source.count;
+  }
+  return true;
+}
 
-      if (!ParseMaterial(&material, err, warn, o,
-                         store_original_json_for_extras_and_extensions_,
-                         strictness_)) {
-        return false;
+//
+// Indices of a primitive(sequential for non-indexed primitives), checked
+// against the vertex count.
+//
+static bool GetPrimitiveIndices(const Model &model, const Primitive &primitive,
+                                size_t num_vertices,
+                                std::vector<uint32_t> *indices,
+                                std::string *err) {
+  if (primitive.indices < 0) {
+    indices->resize(num_vertices);
+    for (size_t i = 0; i < num_vertices; i++) {
+      (*indices)[i] = uint32_t(i);
+    }
+    return true;
+  }
+  AccessorSource source;
+  if (!ResolveAccessorSource(model, primitive.indices, &source, err) ||
+      !WidenIndices(source, indices, err)) {
+    return false;
+  }
+  for (uint32_t idx : *indices) {
+    if (idx >= num_vertices) {
+      if (err) {
+        (*err) += "Index " + std::to_string(idx) + " out of range.\n";
       }
+      return false;
+    }
+  }
+  return true;
+}
 
-      model->materials.emplace_back(std::move(material));
-      return true;
-    });
+//
+// Gathers elements `new_to_old[i]` of the stream into `stream->data`. Elements
+// are padded to 4 bytes as the spec requires for vertex attributes.
+//
+static void GatherVertexStream(VertexStream *stream,
+                               const std::vector<uint32_t> &new_to_old) {
+  const size_t stride = (stream->elem_size + 3) & ~size_t(3);
+  stream->data.assign(new_to_old.size() * stride, 0);
+  for (size_t v = 0; v < new_to_old.size(); v++) {
+    std::memcpy(stream->data.data() + v * stride,
+                stream->source.data + size_t(new_to_old[v]) * stream->source.stride,
+                stream->elem_size);
+  }
+  stream->source = AccessorSource();
+}
 
-    if (!success) {
-      return false;
+//
+// Appends the gathered stream as a new accessor, which copies the properties
+// of the source accessor. min/max are recomputed when the source has them.
+//
+static int AppendVertexStream(Model *model, const VertexStream &stream,
+                              size_t count, std::string *err) {
+  const Accessor &src = model->accessors[size_t(stream.accessor)];
+  const size_t stride = (stream.elem_size + 3) & ~size_t(3);
+
+  Accessor accessor;
+  accessor.name = src.name;
+  accessor.componentType = src.componentType;
+  accessor.normalized = src.normalized;
+  accessor.type = src.type;
+  accessor.count = count;
+  const bool has_bounds = !src.minValues.empty() || !src.maxValues.empty();
+  accessor.bufferView = AppendBufferView(model, stream.data.data(),
+                                         stream.data.size(),
+                                         TINYGLTF_TARGET_ARRAY_BUFFER);
+  if (stride != stream.elem_size) {
+    model->bufferViews.back().byteStride = stride;
+  }
+  model->accessors.emplace_back(std::move(accessor));
+  const int accessor_idx = int(model->accessors.size() - 1);
+  if (has_bounds) {
+    AccessorBounds bounds;
+    if (ComputeAccessorBounds(*model, accessor_idx, &bounds, err, 1)) {
+      model->accessors.back().minValues = bounds.min;
+      model->accessors.back().maxValues = bounds.max;
     }
   }
+  return accessor_idx;
+}
 
-  // 11. Parse Image
-  void *load_image_user_data{nullptr};
+//
+// Appends indices as a new accessor with the smallest index type for
+// `num_vertices`.
+//
+static int AppendIndexAccessor(Model *model,
+                               const std::vector<uint32_t> &indices,
+                               size_t num_vertices) {
+  const int component_type = GetSmallestIndexComponentType(num_vertices);
+  const size_t index_size =
+      size_t(GetComponentSizeInBytes(uint32_t(component_type)));
+  std::vector<unsigned char> data(indices.size() * index_size);
+  NarrowIndices(indices.data(), indices.size(), component_type, data.data());
+
+  Accessor accessor;
+  accessor.bufferView = AppendBufferView(model, data.data(), data.size(),
+                                         TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+  accessor.componentType = component_type;
+  accessor.type = TINYGLTF_TYPE_SCALAR;
+  accessor.count = indices.size();
+  if (!indices.empty()) {
+    accessor.minValues.push_back(
+        double(*std::min_element(indices.begin(), indices.end())));
+    accessor.maxValues.push_back(
+        double(*std::max_element(indices.begin(), indices.end())));
+  }
+  model->accessors.emplace_back(std::move(accessor));
+  return int(model->accessors.size() - 1);
+}
 
-  LoadImageDataOption load_image_option;
+//
+// Accessors, bufferViews and buffers referenced from the parts of a model
+// tinygltf knows about. Accessors are referenced from meshes, skins,
+// animations and EXT_mesh_gpu_instancing, bufferViews from all accessors,
+// images and the KHR_draco_mesh_compression/TINYGLTF_meshlets extensions,
+// buffers from bufferViews and meshopt extensions. `unknown_extension` names
+// an extension used by the model which may refer to them too.
+//
+struct BufferReferences {
+  std::vector<char> accessors;
+  std::vector<char> views;
+  std::vector<char> buffers;
+  std::string unknown_extension;
+};
 
-  if (user_image_loader_) {
-    // Use user supplied pointer
-    load_image_user_data = load_image_user_data_;
-  } else {
-    load_image_option.preserve_channels = preserve_image_channels_;
-    load_image_option.as_is = images_as_is_;
-    load_image_user_data = reinterpret_cast<void *>(&load_image_option);
+static void CollectBufferReferences(const Model &model,
+                                    BufferReferences *refs);
+static bool CompactBuffers(Model *model, const BufferReferences *before,
+                           std::string *err);
+
+bool WeldVertices(Model *model, const WeldOptions &options, std::string *err,
+                  WeldReport *report) {
+  // Accessors and bufferViews this pass replaces are reclaimed afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+  struct Task {
+    size_t mesh;
+    size_t primitive;
+    std::vector<VertexStream> streams;
+    std::vector<uint32_t> indices;
+    size_t num_vertices;
+    size_t num_unique;
+    bool changed;
+    bool ok;
+    std::string err;
+  };
+
+  size_t bytes_before = 0;
+  for (const Buffer &buffer : model->buffers) {
+    bytes_before += buffer.data.size();
   }
 
-  {
-    int idx = 0;
-    bool success = ForEachInArray(v, "images", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "image[" + std::to_string(idx) + "] is not a JSON object.";
-        }
-        return false;
-      }
-      Image image;
-      if (!ParseImage(&image, idx, err, warn, o,
-                      store_original_json_for_extras_and_extensions_, base_dir,
-                      max_external_file_size_, &fs, &uri_cb,
-                      this->LoadImageData, load_image_user_data)) {
-        return false;
+  std::vector<Task> tasks;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const Primitive &primitive = model->meshes[m].primitives[p];
+      if (primitive.attributes.empty() ||
+          primitive.extensions.count("KHR_draco_mesh_compression")) {
+        continue;
       }
+      Task task;
+      task.mesh = m;
+      task.primitive = p;
+      task.num_vertices = 0;
+      task.num_unique = 0;
+      task.changed = false;
+      task.ok = false;
+      tasks.push_back(std::move(task));
+    }
+  }
 
-      if (image.bufferView != -1) {
-        // Load image from the buffer view.
-        if (size_t(image.bufferView) >= model->bufferViews.size()) {
-          if (err) {
-            std::stringstream ss;
-            ss << "image[" << idx << "] bufferView \"" << image.bufferView
-               << "\" not found in the scene." << std::endl;
-            (*err) += ss.str();
-          }
-          return false;
-        }
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    Task &task = tasks[t];
+    const Primitive &primitive =
+        model->meshes[task.mesh].primitives[task.primitive];
 
-        const BufferView &bufferView =
-            model->bufferViews[size_t(image.bufferView)];
-        if (size_t(bufferView.buffer) >= model->buffers.size()) {
-          if (err) {
-            std::stringstream ss;
-            ss << "image[" << idx << "] buffer \"" << bufferView.buffer
-               << "\" not found in the scene." << std::endl;
-            (*err) += ss.str();
-          }
-          return false;
-        }
-        const Buffer &buffer = model->buffers[size_t(bufferView.buffer)];
+    if (!ResolveVertexStreams(*model, primitive, &task.streams,
+                              &task.num_vertices, &task.err) ||
+        !GetPrimitiveIndices(*model, primitive, task.num_vertices,
+                             &task.indices, &task.err)) {
+      return;
+    }
+    const size_t n = task.num_vertices;
 
-        if (LoadImageData == nullptr) {
-          if (err) {
-            (*err) += "No LoadImageData callback specified.\n";
-          }
-          return false;
-        }
-        bool ret = LoadImageData(
-            &image, idx, err, warn, image.width, image.height,
-            &buffer.data[bufferView.byteOffset],
-            static_cast<int>(bufferView.byteLength), load_image_user_data);
-        if (!ret) {
-          return false;
-        }
+    size_t key_size = 0;
+    for (const VertexStream &stream : task.streams) {
+      key_size += stream.elem_size;
+    }
+    std::vector<unsigned char> keys(n * key_size);
+    size_t key_offset = 0;
+    for (const VertexStream &stream : task.streams) {
+      const unsigned char *src = stream.source.data;
+      for (size_t v = 0; v < n; v++) {
+        std::memcpy(keys.data() + v * key_size + key_offset,
+                    src + v * stream.source.stride, stream.elem_size);
       }
+      key_offset += stream.elem_size;
+    }
 
-      model->images.emplace_back(std::move(image));
-      ++idx;
-      return true;
-    });
+    std::vector<uint32_t> canonical;
+    FindUniqueVertices(keys.data(), key_size, n, &canonical);
+
+    // Renumber in the order of first use.
+    const uint32_t kUnassigned = 0xffffffffu;
+    std::vector<uint32_t> remap(n, kUnassigned);
+    std::vector<uint32_t> unique;  // new -> old
+    for (uint32_t &idx : task.indices) {
+      const uint32_t c = canonical[idx];
+      if (remap[c] == kUnassigned) {
+        remap[c] = uint32_t(unique.size());
+        unique.push_back(c);
+      }
+      idx = remap[c];
+    }
+    task.num_unique = unique.size();
+    task.changed = (primitive.indices < 0) || (task.num_unique != n);
+    task.ok = true;
+    if (!task.changed) {
+      return;
+    }
 
-    if (!success) {
-      return false;
+    for (VertexStream &stream : task.streams) {
+      GatherVertexStream(&stream, unique);
+    }
+  });
+
+  bool success = true;
+  size_t vertices_before = 0;
+  size_t vertices_after = 0;
+  for (Task &task : tasks) {
+    if (!task.ok) {
+      success = false;
+      if (err) {
+        (*err) += "mesh[" + std::to_string(task.mesh) + "].primitives[" +
+                  std::to_string(task.primitive) + "]: " + task.err;
+      }
+      continue;
+    }
+    vertices_before += task.num_vertices;
+    vertices_after += task.num_unique;
+    if (!task.changed) {
+      continue;
+    }
+
+    std::vector<int> accessors;
+    for (const VertexStream &stream : task.streams) {
+      accessors.push_back(
+          AppendVertexStream(model, stream, task.num_unique, err));
+    }
+    Primitive &primitive = model->meshes[task.mesh].primitives[task.primitive];
+    SetPrimitiveStreamAccessors(&primitive, accessors);
+    primitive.indices =
+        AppendIndexAccessor(model, task.indices, task.num_unique);
+  }
+
+  if (success && options.compact_buffers) {
+    success = CompactBuffers(model, &references, err);
+  }
+
+  if (report) {
+    report->vertices_before = vertices_before;
+    report->vertices_after = vertices_after;
+    report->bytes_before = bytes_before;
+    report->bytes_after = 0;
+    for (const Buffer &buffer : model->buffers) {
+      report->bytes_after += buffer.data.size();
+    }
+  }
+  return success;
+}
+
+//
+// Remaps an index stored in an extension value(e.g. {"bufferView": 3}).
+//
+static void RemapExtensionIndex(Value *ext, const char *key,
+                                const std::vector<int> &remap) {
+  if (!ext->IsObject() || !ext->Has(key)) {
+    return;
+  }
+  Value &v = ext->Get<Value::Object>()[key];
+  const int idx = v.GetNumberAsInt();
+  if ((idx >= 0) && (size_t(idx) < remap.size())) {
+    v = Value(remap[size_t(idx)]);
+  }
+}
+
+static int ExtensionIndex(const Value &ext, const char *key) {
+  if (!ext.IsObject() || !ext.Has(key) || !ext.Get(key).IsNumber()) {
+    return -1;
+  }
+  return ext.Get(key).GetNumberAsInt();
+}
+
+static const char *const kMeshoptExtensions[] = {"EXT_meshopt_compression",
+                                                 "KHR_meshopt_compression"};
+static const char *const kMeshletExtension = "TINYGLTF_meshlets";
+static const char *const kMeshletViews[] = {"meshlets", "vertices",
+                                            "triangles"};
+
+static void MarkReferencedAccessors(const Model &model,
+                                    std::vector<char> *referenced) {
+  referenced->assign(model.accessors.size(), 0);
+  auto mark_accessor = [&](int idx) {
+    if ((idx >= 0) && (size_t(idx) < referenced->size())) {
+      (*referenced)[size_t(idx)] = 1;
+    }
+  };
+  for (const Mesh &mesh : model.meshes) {
+    for (const Primitive &primitive : mesh.primitives) {
+      mark_accessor(primitive.indices);
+      for (const auto &attrib : primitive.attributes) {
+        mark_accessor(attrib.second);
+      }
+      for (const auto &target : primitive.targets) {
+        for (const auto &attrib : target) {
+          mark_accessor(attrib.second);
+        }
+      }
+    }
+  }
+  for (const Skin &skin : model.skins) {
+    mark_accessor(skin.inverseBindMatrices);
+  }
+  for (const Animation &animation : model.animations) {
+    for (const AnimationSampler &sampler : animation.samplers) {
+      mark_accessor(sampler.input);
+      mark_accessor(sampler.output);
+    }
+  }
+  for (const Node &node : model.nodes) {
+    auto it = node.extensions.find("EXT_mesh_gpu_instancing");
+    if ((it != node.extensions.end()) && it->second.Has("attributes")) {
+      const Value &attribs = it->second.Get("attributes");
+      for (const auto &key : attribs.Keys()) {
+        mark_accessor(ExtensionIndex(attribs, key.c_str()));
+      }
     }
   }
+}
 
-  // 12. Parse Texture
-  {
-    bool success = ForEachInArray(v, "textures", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`textures' does not contain an JSON object.";
+static void MarkReferencedViews(const Model &model,
+                                std::vector<char> *referenced) {
+  referenced->assign(model.bufferViews.size(), 0);
+  auto mark_view = [&](int idx) {
+    if ((idx >= 0) && (size_t(idx) < referenced->size())) {
+      (*referenced)[size_t(idx)] = 1;
+    }
+  };
+  for (const Accessor &accessor : model.accessors) {
+    mark_view(accessor.bufferView);
+    if (accessor.sparse.isSparse) {
+      mark_view(accessor.sparse.indices.bufferView);
+      mark_view(accessor.sparse.values.bufferView);
+    }
+  }
+  for (const Image &image : model.images) {
+    mark_view(image.bufferView);
+  }
+  for (const Mesh &mesh : model.meshes) {
+    for (const Primitive &primitive : mesh.primitives) {
+      auto it = primitive.extensions.find("KHR_draco_mesh_compression");
+      if (it != primitive.extensions.end()) {
+        mark_view(ExtensionIndex(it->second, "bufferView"));
+      }
+      it = primitive.extensions.find(kMeshletExtension);
+      if (it != primitive.extensions.end()) {
+        for (const char *key : kMeshletViews) {
+          mark_view(ExtensionIndex(it->second, key));
         }
-        return false;
       }
-      Texture texture;
-      if (!ParseTexture(&texture, err, o,
-                        store_original_json_for_extras_and_extensions_,
-                        base_dir)) {
-        return false;
+    }
+  }
+}
+
+static void MarkReferencedBuffers(const Model &model,
+                                  std::vector<char> *referenced) {
+  referenced->assign(model.buffers.size(), 0);
+  auto mark_buffer = [&](int idx) {
+    if ((idx >= 0) && (size_t(idx) < referenced->size())) {
+      (*referenced)[size_t(idx)] = 1;
+    }
+  };
+  for (const BufferView &view : model.bufferViews) {
+    mark_buffer(view.buffer);
+    for (const char *name : kMeshoptExtensions) {
+      auto it = view.extensions.find(name);
+      if (it != view.extensions.end()) {
+        mark_buffer(ExtensionIndex(it->second, "buffer"));
       }
+    }
+  }
+}
 
-      model->textures.emplace_back(std::move(texture));
+//
+// Extensions which do not refer to accessors, bufferViews or buffers, or
+// whose references `CompactBuffers` updates.
+//
+static bool IsCompactionSafeExtension(const std::string &name) {
+  static const char *const kKnown[] = {
+      "KHR_draco_mesh_compression", "EXT_meshopt_compression",
+      "KHR_meshopt_compression",    "EXT_mesh_gpu_instancing",
+      "KHR_mesh_quantization",      "KHR_lights_punctual",
+      "KHR_texture_transform",      "KHR_texture_basisu",
+      "EXT_texture_webp",           "EXT_texture_avif",
+      "KHR_animation_pointer",      "KHR_xmp_json_ld",
+      "MSFT_lod",                   "TINYGLTF_meshlets"};
+  for (const char *known : kKnown) {
+    if (name == known) {
       return true;
-    });
+    }
+  }
+  return name.compare(0, 14, "KHR_materials_") == 0;
+}
 
-    if (!success) {
-      return false;
+static std::string FindUnknownExtension(const Model &model) {
+  std::string unknown;
+  auto check = [&](const std::string &name) {
+    if (unknown.empty() && !IsCompactionSafeExtension(name)) {
+      unknown = name;
+    }
+  };
+  auto check_map = [&](const ExtensionMap &extensions) {
+    for (const auto &ext : extensions) {
+      check(ext.first);
+    }
+  };
+  for (const std::string &name : model.extensionsUsed) {
+    check(name);
+  }
+  for (const std::string &name : model.extensionsRequired) {
+    check(name);
+  }
+  check_map(model.extensions);
+  for (const Accessor &accessor : model.accessors) {
+    check_map(accessor.extensions);
+  }
+  for (const BufferView &view : model.bufferViews) {
+    check_map(view.extensions);
+  }
+  for (const Buffer &buffer : model.buffers) {
+    check_map(buffer.extensions);
+  }
+  for (const Mesh &mesh : model.meshes) {
+    check_map(mesh.extensions);
+    for (const Primitive &primitive : mesh.primitives) {
+      check_map(primitive.extensions);
     }
   }
+  for (const Node &node : model.nodes) {
+    check_map(node.extensions);
+  }
+  for (const Scene &scene : model.scenes) {
+    check_map(scene.extensions);
+  }
+  for (const Skin &skin : model.skins) {
+    check_map(skin.extensions);
+  }
+  for (const Animation &animation : model.animations) {
+    check_map(animation.extensions);
+  }
+  for (const Image &image : model.images) {
+    check_map(image.extensions);
+  }
+  for (const Texture &texture : model.textures) {
+    check_map(texture.extensions);
+  }
+  for (const Material &material : model.materials) {
+    check_map(material.extensions);
+  }
+  return unknown;
+}
 
-  // 13. Parse Animation
-  {
-    bool success = ForEachInArray(v, "animations", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`animations' does not contain an JSON object.";
-        }
-        return false;
-      }
-      Animation animation;
-      if (!ParseAnimation(&animation, err, o,
-                          store_original_json_for_extras_and_extensions_)) {
-        return false;
-      }
+static void CollectBufferReferences(const Model &model,
+                                    BufferReferences *refs) {
+  MarkReferencedAccessors(model, &refs->accessors);
+  MarkReferencedViews(model, &refs->views);
+  MarkReferencedBuffers(model, &refs->buffers);
+  refs->unknown_extension = FindUnknownExtension(model);
+}
 
-      model->animations.emplace_back(std::move(animation));
-      return true;
-    });
+//
+// Whether an unreferenced element `i` may be removed. With `before`(the
+// references before a pass), only elements which the pass appended or
+// stopped referencing are removed, and nothing which existed before when an
+// unknown extension may still refer to it.
+//
+static bool IsRemovable(size_t i, const BufferReferences *before,
+                        const std::vector<char> &referenced_before) {
+  if (!before || (i >= referenced_before.size())) {
+    return true;
+  }
+  return referenced_before[i] && before->unknown_extension.empty();
+}
 
-    if (!success) {
+//
+// Compaction for `CompactBuffers`(`before` = nullptr) and for passes which
+// replace accessors(`before` = the references before the pass).
+//
+static bool CompactBuffers(Model *model, const BufferReferences *before,
+                           std::string *err) {
+  if (!before) {
+    const std::string unknown = FindUnknownExtension(*model);
+    if (!unknown.empty()) {
+      if (err) {
+        (*err) += "CompactBuffers: extension " + unknown +
+                  " may refer to accessors or bufferViews. Not compacted.\n";
+      }
       return false;
     }
   }
 
-  // 14. Parse Skin
+  //
+  // Accessors
+  //
+  std::vector<char> referenced;
+  MarkReferencedAccessors(*model, &referenced);
+  std::vector<int> accessor_remap(model->accessors.size(), -1);
   {
-    bool success = ForEachInArray(v, "skins", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`skins' does not contain an JSON object.";
+    int n = 0;
+    for (size_t i = 0; i < model->accessors.size(); i++) {
+      if (referenced[i] ||
+          !IsRemovable(i, before, before ? before->accessors : referenced)) {
+        accessor_remap[i] = n;
+        if (size_t(n) != i) {
+          model->accessors[size_t(n)] = std::move(model->accessors[i]);
         }
-        return false;
-      }
-      Skin skin;
-      if (!ParseSkin(&skin, err, o,
-                     store_original_json_for_extras_and_extensions_)) {
-        return false;
+        n++;
       }
-
-      model->skins.emplace_back(std::move(skin));
-      return true;
-    });
-
-    if (!success) {
-      return false;
     }
+    model->accessors.resize(size_t(n));
   }
-
-  // 15. Parse Sampler
-  {
-    bool success = ForEachInArray(v, "samplers", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`samplers' does not contain an JSON object.";
+  auto remap_accessor = [&](int *idx) {
+    if ((*idx >= 0) && (size_t(*idx) < accessor_remap.size())) {
+      *idx = accessor_remap[size_t(*idx)];
+    }
+  };
+  for (Mesh &mesh : model->meshes) {
+    for (Primitive &primitive : mesh.primitives) {
+      remap_accessor(&primitive.indices);
+      for (auto &attrib : primitive.attributes) {
+        remap_accessor(&attrib.second);
+      }
+      for (auto &target : primitive.targets) {
+        for (auto &attrib : target) {
+          remap_accessor(&attrib.second);
         }
-        return false;
       }
-      Sampler sampler;
-      if (!ParseSampler(&sampler, err, o,
-                        store_original_json_for_extras_and_extensions_)) {
-        return false;
+    }
+  }
+  for (Skin &skin : model->skins) {
+    remap_accessor(&skin.inverseBindMatrices);
+  }
+  for (Animation &animation : model->animations) {
+    for (AnimationSampler &sampler : animation.samplers) {
+      remap_accessor(&sampler.input);
+      remap_accessor(&sampler.output);
+    }
+  }
+  for (Node &node : model->nodes) {
+    auto it = node.extensions.find("EXT_mesh_gpu_instancing");
+    if ((it != node.extensions.end()) && it->second.Has("attributes")) {
+      Value &attribs = it->second.Get<Value::Object>()["attributes"];
+      for (const auto &key : attribs.Keys()) {
+        RemapExtensionIndex(&attribs, key.c_str(), accessor_remap);
       }
-
-      model->samplers.emplace_back(std::move(sampler));
-      return true;
-    });
-
-    if (!success) {
-      return false;
     }
   }
 
-  // 16. Parse Camera
+  //
+  // BufferViews
+  //
+  MarkReferencedViews(*model, &referenced);
+  std::vector<int> view_remap(model->bufferViews.size(), -1);
   {
-    bool success = ForEachInArray(v, "cameras", [&](const detail::json &o) {
-      if (!detail::IsObject(o)) {
-        if (err) {
-          (*err) += "`cameras' does not contain an JSON object.";
+    int n = 0;
+    for (size_t i = 0; i < model->bufferViews.size(); i++) {
+      if (referenced[i] ||
+          !IsRemovable(i, before, before ? before->views : referenced)) {
+        view_remap[i] = n;
+        if (size_t(n) != i) {
+          model->bufferViews[size_t(n)] = std::move(model->bufferViews[i]);
         }
-        return false;
+        n++;
       }
-      Camera camera;
-      if (!ParseCamera(&camera, err, o,
-                       store_original_json_for_extras_and_extensions_)) {
-        return false;
+    }
+    model->bufferViews.resize(size_t(n));
+  }
+  auto remap_view = [&](int *idx) {
+    if ((*idx >= 0) && (size_t(*idx) < view_remap.size())) {
+      *idx = view_remap[size_t(*idx)];
+    }
+  };
+  for (Accessor &accessor : model->accessors) {
+    remap_view(&accessor.bufferView);
+    if (accessor.sparse.isSparse) {
+      remap_view(&accessor.sparse.indices.bufferView);
+      remap_view(&accessor.sparse.values.bufferView);
+    }
+  }
+  for (Image &image : model->images) {
+    remap_view(&image.bufferView);
+  }
+  for (Mesh &mesh : model->meshes) {
+    for (Primitive &primitive : mesh.primitives) {
+      auto it = primitive.extensions.find("KHR_draco_mesh_compression");
+      if (it != primitive.extensions.end()) {
+        RemapExtensionIndex(&it->second, "bufferView", view_remap);
+      }
+      it = primitive.extensions.find(kMeshletExtension);
+      if (it != primitive.extensions.end()) {
+        for (const char *key : kMeshletViews) {
+          RemapExtensionIndex(&it->second, key, view_remap);
+        }
       }
-
-      model->cameras.emplace_back(std::move(camera));
-      return true;
-    });
-
-    if (!success) {
-      return false;
     }
   }
 
-  // 17. Parse Extras & Extensions
-  ParseExtrasAndExtensions(model, err, v,
-                           store_original_json_for_extras_and_extensions_);
-
-  // 18. Specific extension implementations
-  {
-    detail::json_const_iterator rootIt;
-    if (detail::FindMember(v, "extensions", rootIt) &&
-        detail::IsObject(detail::GetValue(rootIt))) {
-      const detail::json &root = detail::GetValue(rootIt);
+  //
+  // Byte ranges of buffers. Overlapping ranges are merged into one span, and
+  // each span keeps its byte offset modulo 16 so that element alignment(and
+  // the alignment of `ApplyVertexLayout`) is preserved.
+  //
+  struct Range {
+    size_t begin;
+    size_t end;
+    size_t view;
+    bool meshopt;  // range of a meshopt extension of `view`
+  };
+  std::vector<std::vector<Range>> ranges(model->buffers.size());
+  bool success = true;
+  auto add_range = [&](int buffer, size_t offset, size_t length, size_t view,
+                       bool meshopt) {
+    if ((buffer < 0) || (size_t(buffer) >= model->buffers.size())) {
+      if (err) {
+        (*err) += "bufferView[" + std::to_string(view) +
+                  "]: invalid buffer index.\n";
+      }
+      success = false;
+      return;
+    }
+    const Buffer &b = model->buffers[size_t(buffer)];
+    if (!b.data.empty() && ((offset > b.data.size()) ||
+                            (length > b.data.size() - offset))) {
+      if (err) {
+        (*err) += "bufferView[" + std::to_string(view) +
+                  "]: range exceeds buffer size.\n";
+      }
+      success = false;
+      return;
+    }
+    Range r;
+    r.begin = offset;
+    r.end = offset + length;
+    r.view = view;
+    r.meshopt = meshopt;
+    ranges[size_t(buffer)].push_back(r);
+  };
+  for (size_t i = 0; i < model->bufferViews.size(); i++) {
+    const BufferView &view = model->bufferViews[i];
+    add_range(view.buffer, view.byteOffset, view.byteLength, i, false);
+    for (const char *name : kMeshoptExtensions) {
+      auto it = view.extensions.find(name);
+      if (it != view.extensions.end()) {
+        const int offset = ExtensionIndex(it->second, "byteOffset");
+        add_range(ExtensionIndex(it->second, "buffer"),
+                  size_t((std::max)(0, offset)),
+                  size_t((std::max)(0, ExtensionIndex(it->second,
+                                                      "byteLength"))),
+                  i, true);
+      }
+    }
+  }
+  if (!success) {
+    return false;
+  }
 
-      detail::json_const_iterator it(detail::ObjectBegin(root));
-      detail::json_const_iterator itEnd(detail::ObjectEnd(root));
-      for (; it != itEnd; ++it) {
-        // parse KHR_lights_punctual extension
-        std::string key(detail::GetKey(it));
-        if ((key == "KHR_lights_punctual") &&
-            detail::IsObject(detail::GetValue(it))) {
-          const detail::json &object = detail::GetValue(it);
-          detail::json_const_iterator itLight;
-          if (detail::FindMember(object, "lights", itLight)) {
-            const detail::json &lights = detail::GetValue(itLight);
-            if (!detail::IsArray(lights)) {
-              continue;
-            }
+  // Bytes outside of bufferViews may be used by unknown extensions.
+  const bool compact_bytes = !before || before->unknown_extension.empty();
+  MarkReferencedBuffers(*model, &referenced);
+  std::vector<int> buffer_remap(model->buffers.size(), -1);
+  int num_buffers = 0;
+  for (size_t b = 0; b < model->buffers.size(); b++) {
+    std::vector<Range> &rs = ranges[b];
+    if (!referenced[b] &&
+        IsRemovable(b, before, before ? before->buffers : referenced)) {
+      continue;
+    }
+    buffer_remap[b] = num_buffers++;
+    Buffer &buffer = model->buffers[b];
+    if (buffer.data.empty() || rs.empty() || !compact_bytes) {
+      continue;
+    }
 
-            auto arrayIt(detail::ArrayBegin(lights));
-            auto arrayItEnd(detail::ArrayEnd(lights));
-            for (; arrayIt != arrayItEnd; ++arrayIt) {
-              Light light;
-              if (!ParseLight(&light, err, *arrayIt,
-                              store_original_json_for_extras_and_extensions_)) {
-                return false;
-              }
-              model->lights.emplace_back(std::move(light));
+    std::sort(rs.begin(), rs.end(), [](const Range &a, const Range &c) {
+      return a.begin < c.begin;
+    });
+    std::vector<unsigned char> data;
+    data.reserve(buffer.data.size());
+    size_t i = 0;
+    while (i < rs.size()) {
+      const size_t span_begin = rs[i].begin;
+      size_t span_end = rs[i].end;
+      size_t j = i + 1;
+      while ((j < rs.size()) && (rs[j].begin < span_end)) {
+        span_end = (std::max)(span_end, rs[j].end);
+        j++;
+      }
+      const size_t dst = data.size() + ((span_begin - data.size()) & 15);
+      data.resize(dst);
+      data.insert(data.end(), buffer.data.begin() + std::ptrdiff_t(span_begin),
+                  buffer.data.begin() + std::ptrdiff_t(span_end));
+      for (size_t k = i; k < j; k++) {
+        const size_t offset = dst + (rs[k].begin - span_begin);
+        BufferView &view = model->bufferViews[rs[k].view];
+        if (rs[k].meshopt) {
+          for (const char *name : kMeshoptExtensions) {
+            auto it = view.extensions.find(name);
+            if ((it != view.extensions.end()) &&
+                (ExtensionIndex(it->second, "buffer") == int(b))) {
+              it->second.Get<Value::Object>()["byteOffset"] =
+                  Value(int(offset));
             }
           }
+        } else {
+          view.byteOffset = offset;
         }
-        // parse KHR_audio extension
-        if ((key == "KHR_audio") && detail::IsObject(detail::GetValue(it))) {
-          const detail::json &object = detail::GetValue(it);
-          detail::json_const_iterator itKhrAudio;
-          if (detail::FindMember(object, "emitters", itKhrAudio)) {
-            const detail::json &emitters = detail::GetValue(itKhrAudio);
-            if (!detail::IsArray(emitters)) {
-              continue;
-            }
-
-            auto arrayIt(detail::ArrayBegin(emitters));
-            auto arrayItEnd(detail::ArrayEnd(emitters));
-            for (; arrayIt != arrayItEnd; ++arrayIt) {
-              AudioEmitter emitter;
-              if (!ParseAudioEmitter(
-                      &emitter, err, *arrayIt,
-                      store_original_json_for_extras_and_extensions_)) {
-                return false;
-              }
-              model->audioEmitters.emplace_back(std::move(emitter));
-            }
-          }
-
-          if (detail::FindMember(object, "sources", itKhrAudio)) {
-            const detail::json &sources = detail::GetValue(itKhrAudio);
-            if (!detail::IsArray(sources)) {
-              continue;
-            }
+      }
+      i = j;
+    }
+    buffer.data.swap(data);
+  }
 
-            auto arrayIt(detail::ArrayBegin(sources));
-            auto arrayItEnd(detail::ArrayEnd(sources));
-            for (; arrayIt != arrayItEnd; ++arrayIt) {
-              AudioSource source;
-              if (!ParseAudioSource(
-                      &source, err, *arrayIt,
-                      store_original_json_for_extras_and_extensions_)) {
-                return false;
-              }
-              model->audioSources.emplace_back(std::move(source));
-            }
-          }
-        }
+  for (size_t b = 0, n = 0; b < model->buffers.size(); b++) {
+    if (buffer_remap[b] >= 0) {
+      if (n != b) {
+        model->buffers[n] = std::move(model->buffers[b]);
+      }
+      n++;
+    }
+  }
+  model->buffers.resize(size_t(num_buffers));
+  for (BufferView &view : model->bufferViews) {
+    if ((view.buffer >= 0) && (size_t(view.buffer) < buffer_remap.size())) {
+      view.buffer = buffer_remap[size_t(view.buffer)];
+    }
+    for (const char *name : kMeshoptExtensions) {
+      auto it = view.extensions.find(name);
+      if (it != view.extensions.end()) {
+        RemapExtensionIndex(&it->second, "buffer", buffer_remap);
       }
     }
   }
@@ -6687,2041 +13619,5451 @@ bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
   return true;
 }
 
-bool TinyGLTF::LoadASCIIFromString(Model *model, std::string *err,
-                                   std::string *warn, const char *str,
-                                   unsigned int length,
-                                   const std::string &base_dir,
-                                   unsigned int check_sections) {
-  is_binary_ = false;
-  bin_data_ = nullptr;
-  bin_size_ = 0;
-
-  return LoadFromString(model, err, warn, str, length, base_dir,
-                        check_sections);
+bool CompactBuffers(Model *model, std::string *err) {
+  return CompactBuffers(model, nullptr, err);
 }
 
-bool TinyGLTF::LoadASCIIFromFile(Model *model, std::string *err,
-                                 std::string *warn, const std::string &filename,
-                                 unsigned int check_sections) {
-  std::stringstream ss;
-
-  if (fs.ReadWholeFile == nullptr) {
-    // Programmer error, assert() ?
-    ss << "Failed to read file: " << filename
-       << ": one or more FS callback not set" << std::endl;
-    if (err) {
-      (*err) = ss.str();
+//
+// Returns false when an index is not below `num_vertices`.
+//
+static bool CheckIndexRange(const uint32_t *indices, size_t count,
+                            size_t num_vertices, std::string *err) {
+  for (size_t i = 0; i < count; i++) {
+    if (indices[i] >= num_vertices) {
+      if (err) {
+        (*err) += "Index " + std::to_string(indices[i]) + " out of range.\n";
+      }
+      return false;
     }
-    return false;
   }
+  return true;
+}
 
-  std::vector<unsigned char> data;
-  std::string fileerr;
-  bool fileread = fs.ReadWholeFile(&data, &fileerr, filename, fs.user_data);
-  if (!fileread) {
-    ss << "Failed to read file: " << filename << ": " << fileerr << std::endl;
-    if (err) {
-      (*err) = ss.str();
+VertexCacheStats AnalyzeVertexCache(const uint32_t *indices, size_t count,
+                                    size_t num_vertices, size_t cache_size) {
+  VertexCacheStats stats;
+  stats.triangles = count / 3;
+  if (cache_size == 0) {
+    cache_size = 1;
+  }
+  // FIFO cache via timestamps: a vertex is in the cache if it was transformed
+  // within the last `cache_size` transforms.
+  std::vector<size_t> timestamps(num_vertices, 0);
+  std::vector<bool> used(num_vertices, false);
+  size_t timestamp = cache_size + 1;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t v = indices[i];
+    if (v >= num_vertices) {
+      continue;
     }
-    return false;
+    if (!used[v]) {
+      used[v] = true;
+      stats.vertices++;
+    }
+    if (timestamp - timestamps[v] > cache_size) {
+      timestamps[v] = timestamp++;
+      stats.transformed++;
+    }
+  }
+  if (stats.triangles) {
+    stats.acmr = double(stats.transformed) / double(stats.triangles);
   }
+  if (stats.vertices) {
+    stats.atvr = double(stats.transformed) / double(stats.vertices);
+  }
+  return stats;
+}
 
-  size_t sz = data.size();
-  if (sz == 0) {
-    if (err) {
-      (*err) = "Empty file.";
-    }
+bool OptimizeVertexCache(const uint32_t *indices, size_t count,
+                         size_t num_vertices, uint32_t *dst,
+                         size_t cache_size, std::string *err) {
+  const size_t num_triangles = count / 3;
+  if (cache_size < 4) {
+    cache_size = 4;
+  }
+  if (!CheckIndexRange(indices, num_triangles * 3, num_vertices, err)) {
     return false;
   }
+  if (num_triangles == 0) {
+    return true;
+  }
 
-  std::string basedir = GetBaseDir(filename);
-
-  bool ret = LoadASCIIFromString(
-      model, err, warn, reinterpret_cast<const char *>(&data.at(0)),
-      static_cast<unsigned int>(data.size()), basedir, check_sections);
-
-  return ret;
-}
-
-bool TinyGLTF::LoadBinaryFromMemory(Model *model, std::string *err,
-                                    std::string *warn,
-                                    const unsigned char *bytes,
-                                    unsigned int size,
-                                    const std::string &base_dir,
-                                    unsigned int check_sections) {
-  if (size < 20) {
-    if (err) {
-      (*err) = "Too short data size for glTF Binary.";
+  // Score tables.
+  const size_t kMaxValence = 32;
+  std::vector<float> cache_scores(cache_size);
+  for (size_t i = 0; i < cache_size; i++) {
+    if (i < 3) {
+      cache_scores[i] = 0.75f;  // last triangle
+    } else {
+      const float s =
+          1.0f - float(i - 3) / float(cache_size - 3);
+      cache_scores[i] = std::pow(s, 1.5f);
     }
-    return false;
+  }
+  std::vector<float> valence_scores(kMaxValence + 1);
+  valence_scores[0] = 0.0f;
+  for (size_t i = 1; i <= kMaxValence; i++) {
+    valence_scores[i] = 2.0f / std::sqrt(float(i));
   }
 
-  if (bytes[0] == 'g' && bytes[1] == 'l' && bytes[2] == 'T' &&
-      bytes[3] == 'F') {
-    // ok
-  } else {
-    if (err) {
-      (*err) = "Invalid magic.";
+  // Vertex -> triangle adjacency.
+  std::vector<uint32_t> valence(num_vertices, 0);
+  for (size_t i = 0; i < num_triangles * 3; i++) {
+    valence[indices[i]]++;
+  }
+  std::vector<size_t> offsets(num_vertices + 1, 0);
+  for (size_t v = 0; v < num_vertices; v++) {
+    offsets[v + 1] = offsets[v] + valence[v];
+  }
+  std::vector<uint32_t> adjacency(num_triangles * 3);
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < num_triangles; t++) {
+      for (size_t k = 0; k < 3; k++) {
+        adjacency[fill[indices[3 * t + k]]++] = uint32_t(t);
+      }
     }
-    return false;
   }
 
-  unsigned int version;        // 4 bytes
-  unsigned int length;         // 4 bytes
-  unsigned int chunk0_length;  // 4 bytes
-  unsigned int chunk0_format;  // 4 bytes;
+  std::vector<int> cache_pos(num_vertices, -1);
+  auto vertex_score = [&](uint32_t v) -> float {
+    const uint32_t live = valence[v];
+    if (live == 0) {
+      return -1.0f;
+    }
+    float score = 0.0f;
+    if (cache_pos[v] >= 0) {
+      score = cache_scores[size_t(cache_pos[v])];
+    }
+    return score + valence_scores[(std::min)(size_t(live), kMaxValence)];
+  };
 
-  memcpy(&version, bytes + 4, 4);
-  swap4(&version);
-  memcpy(&length, bytes + 8, 4); // Total glb size, including header and all chunks.
-  swap4(&length);
-  memcpy(&chunk0_length, bytes + 12, 4);  // JSON data length
-  swap4(&chunk0_length);
-  memcpy(&chunk0_format, bytes + 16, 4);
-  swap4(&chunk0_format);
+  std::vector<float> vscores(num_vertices);
+  for (size_t v = 0; v < num_vertices; v++) {
+    vscores[v] = vertex_score(uint32_t(v));
+  }
+  std::vector<bool> emitted(num_triangles, false);
+  size_t best = 0;
+  float best_score = -1.0f;
+  for (size_t t = 0; t < num_triangles; t++) {
+    const float score = vscores[indices[3 * t]] +
+                        vscores[indices[3 * t + 1]] +
+                        vscores[indices[3 * t + 2]];
+    if (score > best_score) {
+      best_score = score;
+      best = t;
+    }
+  }
 
-  // https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#binary-gltf-layout
-  //
-  // In case the Bin buffer is not present, the size is exactly 20 + size of
-  // JSON contents,
-  // so use "greater than" operator.
-  //
-  // https://github.com/syoyo/tinygltf/issues/372
-  // Use 64bit uint to avoid integer overflow.
-  uint64_t header_and_json_size = 20ull + uint64_t(chunk0_length);
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> new_cache;
+  cache.reserve(cache_size + 3);
+  new_cache.reserve(cache_size + 3);
+  const size_t kNone = size_t(-1);
+  size_t scan = 0;  // fallback when no cached vertex has a live triangle
 
-  if (header_and_json_size > (std::numeric_limits<uint32_t>::max)()) {
-    // Do not allow 4GB or more GLB data.
-    if (err) {
-      (*err) = "Invalid glTF binary. GLB data exceeds 4GB.";
+  for (size_t out = 0; out < num_triangles; out++) {
+    if (best == kNone) {
+      while (emitted[scan]) {
+        scan++;
+      }
+      best = scan;
+    }
+    const size_t t = best;
+    emitted[t] = true;
+    const uint32_t *tri = indices + 3 * t;
+    dst[3 * out + 0] = tri[0];
+    dst[3 * out + 1] = tri[1];
+    dst[3 * out + 2] = tri[2];
+
+    // Remove the triangle from the live adjacency of its vertices.
+    for (size_t k = 0; k < 3; k++) {
+      const uint32_t v = tri[k];
+      uint32_t *adj = adjacency.data() + offsets[v];
+      for (uint32_t j = 0; j < valence[v]; j++) {
+        if (adj[j] == t) {
+          adj[j] = adj[valence[v] - 1];
+          valence[v]--;
+          break;
+        }
+      }
     }
-    return false;
-  }
 
-  if ((header_and_json_size > uint64_t(size)) || (chunk0_length < 1) ||
-      (length > size) || (header_and_json_size > uint64_t(length)) ||
-      (chunk0_format != 0x4E4F534A)) {  // 0x4E4F534A = JSON format.
-    if (err) {
-      (*err) = "Invalid glTF binary.";
+    // LRU cache update: triangle vertices move to the front.
+    new_cache.clear();
+    new_cache.push_back(tri[0]);
+    if (tri[1] != tri[0]) {
+      new_cache.push_back(tri[1]);
+    }
+    if ((tri[2] != tri[0]) && (tri[2] != tri[1])) {
+      new_cache.push_back(tri[2]);
+    }
+    for (uint32_t v : cache) {
+      if ((v != tri[0]) && (v != tri[1]) && (v != tri[2])) {
+        new_cache.push_back(v);
+      }
+    }
+    // Evicted vertices.
+    for (size_t i = cache_size; i < new_cache.size(); i++) {
+      cache_pos[new_cache[i]] = -1;
+      vscores[new_cache[i]] = vertex_score(new_cache[i]);
+    }
+    if (new_cache.size() > cache_size) {
+      new_cache.resize(cache_size);
+    }
+    for (size_t i = 0; i < new_cache.size(); i++) {
+      cache_pos[new_cache[i]] = int(i);
+      vscores[new_cache[i]] = vertex_score(new_cache[i]);
+    }
+    cache.swap(new_cache);
+
+    // Rescore live triangles of cached vertices and pick the best one.
+    best = kNone;
+    best_score = -1.0f;
+    for (uint32_t v : cache) {
+      const uint32_t *adj = adjacency.data() + offsets[v];
+      for (uint32_t j = 0; j < valence[v]; j++) {
+        const uint32_t a = adj[j];
+        const float score = vscores[indices[3 * a]] +
+                            vscores[indices[3 * a + 1]] +
+                            vscores[indices[3 * a + 2]];
+        if (score > best_score) {
+          best_score = score;
+          best = a;
+        }
+      }
     }
-    return false;
   }
+  return true;
+}
 
-  // Padding check
-  // The start and the end of each chunk must be aligned to a 4-byte boundary.
-  // No padding check for chunk0 start since its 4byte-boundary is ensured.
-  if ((header_and_json_size % 4) != 0) {
-    if (err) {
-      (*err) = "JSON Chunk end does not aligned to a 4-byte boundary.";
-    }
+bool OptimizeVertexFetch(uint32_t *indices, size_t count, size_t num_vertices,
+                         std::vector<uint32_t> *new_to_old, std::string *err) {
+  if (!CheckIndexRange(indices, count, num_vertices, err)) {
     return false;
   }
+  const uint32_t kUnassigned = 0xffffffffu;
+  std::vector<uint32_t> remap(num_vertices, kUnassigned);
+  new_to_old->clear();
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t v = indices[i];
+    if (remap[v] == kUnassigned) {
+      remap[v] = uint32_t(new_to_old->size());
+      new_to_old->push_back(v);
+    }
+    indices[i] = remap[v];
+  }
+  return true;
+}
 
-  // std::cout << "header_and_json_size = " << header_and_json_size << "\n";
-  // std::cout << "length = " << length << "\n";
+bool OptimizePrimitivesForVertexCache(
+    Model *model, const VertexCacheOptions &options, std::string *err,
+    std::vector<PrimitiveCacheReport> *report) {
+  // Accessors and bufferViews this pass replaces are reclaimed afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+  struct Task {
+    size_t mesh;
+    size_t primitive;
+    std::vector<VertexStream> streams;
+    std::vector<uint32_t> indices;
+    size_t num_vertices;
+    VertexCacheStats before;
+    VertexCacheStats after;
+    bool ok;
+    std::string err;
+  };
 
-  // Chunk1(BIN) data
-  // The spec says: When the binary buffer is empty or when it is stored by
-  // other means, this chunk SHOULD be omitted. So when header + JSON data ==
-  // binary size, Chunk1 is omitted.
-  if (header_and_json_size == uint64_t(length)) {
-    bin_data_ = nullptr;
-    bin_size_ = 0;
-  } else {
-    // Read Chunk1 info(BIN data)
-    //
-    // issue-440:
-    // 'SHOULD' in glTF spec means 'RECOMMENDED',
-    // So there is a situation that Chunk1(BIN) is composed of zero-sized BIN data
-    // (chunksize(0) + binformat(BIN) = 8bytes).
-    //
-    if ((header_and_json_size + 8ull) > uint64_t(length)) {
-      if (err) {
-        (*err) =
-            "Insufficient storage space for Chunk1(BIN data). At least Chunk1 "
-            "Must have 8 or more bytes, but got " +
-            std::to_string((header_and_json_size + 8ull) - uint64_t(length)) +
-            ".\n";
+  std::vector<Task> tasks;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const Primitive &primitive = model->meshes[m].primitives[p];
+      if (((primitive.mode >= 0) &&
+           (primitive.mode != TINYGLTF_MODE_TRIANGLES)) ||
+          primitive.attributes.empty() ||
+          primitive.extensions.count("KHR_draco_mesh_compression")) {
+        continue;
       }
-      return false;
+      Task task;
+      task.mesh = m;
+      task.primitive = p;
+      task.num_vertices = 0;
+      task.ok = false;
+      tasks.push_back(std::move(task));
     }
+  }
 
-    unsigned int chunk1_length{0};  // 4 bytes
-    unsigned int chunk1_format{0};  // 4 bytes;
-    memcpy(&chunk1_length, bytes + header_and_json_size,
-           4);  // Bin data length
-    swap4(&chunk1_length);
-    memcpy(&chunk1_format, bytes + header_and_json_size + 4, 4);
-    swap4(&chunk1_format);
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    Task &task = tasks[t];
+    const Primitive &primitive =
+        model->meshes[task.mesh].primitives[task.primitive];
 
-    if (chunk1_format != 0x004e4942) {
+    if (!ResolveVertexStreams(*model, primitive, &task.streams,
+                              &task.num_vertices, &task.err)) {
+      return;
+    }
+    std::vector<uint32_t> indices;
+    if (!GetPrimitiveIndices(*model, primitive, task.num_vertices, &indices,
+                             &task.err)) {
+      return;
+    }
+    indices.resize(indices.size() - indices.size() % 3);
+    task.before = AnalyzeVertexCache(indices.data(), indices.size(),
+                                     task.num_vertices,
+                                     options.stats_cache_size);
+
+    task.indices.resize(indices.size());
+    if (!OptimizeVertexCache(indices.data(), indices.size(), task.num_vertices,
+                             task.indices.data(), options.cache_size,
+                             &task.err)) {
+      return;
+    }
+
+    if (options.reorder_vertices) {
+      std::vector<uint32_t> new_to_old;
+      if (!OptimizeVertexFetch(task.indices.data(), task.indices.size(),
+                               task.num_vertices, &new_to_old, &task.err)) {
+        return;
+      }
+      task.num_vertices = new_to_old.size();
+      for (VertexStream &stream : task.streams) {
+        GatherVertexStream(&stream, new_to_old);
+      }
+    } else {
+      task.streams.clear();
+    }
+    task.after = AnalyzeVertexCache(task.indices.data(), task.indices.size(),
+                                    task.num_vertices,
+                                    options.stats_cache_size);
+    task.ok = true;
+  });
+
+  bool success = true;
+  if (report) {
+    report->clear();
+  }
+  for (Task &task : tasks) {
+    if (!task.ok) {
+      success = false;
       if (err) {
-        (*err) = "Invalid chunkType for Chunk1.";
+        (*err) += "mesh[" + std::to_string(task.mesh) + "].primitives[" +
+                  std::to_string(task.primitive) + "]: " + task.err;
       }
-      return false;
+      continue;
     }
 
-    if (chunk1_length == 0) {
-
-      if (header_and_json_size + 8 > uint64_t(length)) {
-        if (err) {
-          (*err) = "BIN Chunk header location exceeds the GLB size.";
-        }
-        return false;
+    Primitive &primitive = model->meshes[task.mesh].primitives[task.primitive];
+    if (options.reorder_vertices) {
+      std::vector<int> accessors;
+      for (const VertexStream &stream : task.streams) {
+        accessors.push_back(
+            AppendVertexStream(model, stream, task.num_vertices, err));
       }
+      SetPrimitiveStreamAccessors(&primitive, accessors);
+    }
+    primitive.indices =
+        AppendIndexAccessor(model, task.indices, task.num_vertices);
+    primitive.mode = TINYGLTF_MODE_TRIANGLES;
+
+    if (report) {
+      PrimitiveCacheReport r;
+      r.mesh = int(task.mesh);
+      r.primitive = int(task.primitive);
+      r.before = task.before;
+      r.after = task.after;
+      report->push_back(r);
+    }
+  }
 
-      bin_data_ = nullptr;
-
-    } else {
-
-      // When BIN chunk size is not zero, at least Chunk1 should have 12 bytes(8 bytes(header) + 4 bytes(bin
-      // payload could be 1~3 bytes, but need to be aligned to 4 bytes)
+  if (success && options.compact_buffers) {
+    success = CompactBuffers(model, &references, err);
+  }
+  return success;
+}
 
-      if (chunk1_length < 4) {
-        if (err) {
-          (*err) = "Insufficient Chunk1(BIN) data size.";
-        }
-        return false;
-      }
+static const size_t kMeshletRecordSize = 64;
 
-      if ((chunk1_length % 4) != 0) {
-        if (strictness_==ParseStrictness::Permissive) {
-          if (warn) {
-            (*warn) += "BIN Chunk end is not aligned to a 4-byte boundary.\n";
-          }
-        }
-        else {
-          if (err) {
-            (*err) = "BIN Chunk end is not aligned to a 4-byte boundary.";
-          }
-          return false;
-        }
-      }
+//
+// Bounding sphere(Ritter) and normal cone of a meshlet.
+//
+static void ComputeMeshletBounds(const Meshlets &meshlets,
+                                 const float *positions,
+                                 size_t position_stride, Meshlet *m) {
+  const uint32_t *verts = meshlets.vertices.data() + m->vertex_offset;
+  auto pos = [&](uint32_t local) {
+    return positions + size_t(verts[local]) * position_stride;
+  };
+  auto dist2 = [](const float *a, const float *b) {
+    const float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+  };
 
-      // +8 chunk1 header size.
-      if (uint64_t(chunk1_length) + header_and_json_size + 8 > uint64_t(length)) {
-        if (err) {
-          (*err) = "BIN Chunk data length exceeds the GLB size.";
-        }
-        return false;
+  // Initial sphere from the most distant pair of axis extremes.
+  uint32_t pmin[3] = {0, 0, 0}, pmax[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < m->vertex_count; i++) {
+    const float *p = pos(i);
+    for (int axis = 0; axis < 3; axis++) {
+      if (p[axis] < pos(pmin[axis])[axis]) pmin[axis] = i;
+      if (p[axis] > pos(pmax[axis])[axis]) pmax[axis] = i;
+    }
+  }
+  int best_axis = 0;
+  float best_d2 = -1.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    const float d2 = dist2(pos(pmin[axis]), pos(pmax[axis]));
+    if (d2 > best_d2) {
+      best_d2 = d2;
+      best_axis = axis;
+    }
+  }
+  const float *p0 = pos(pmin[best_axis]);
+  const float *p1 = pos(pmax[best_axis]);
+  float center[3] = {(p0[0] + p1[0]) * 0.5f, (p0[1] + p1[1]) * 0.5f,
+                     (p0[2] + p1[2]) * 0.5f};
+  float radius = std::sqrt(best_d2) * 0.5f;
+  for (uint32_t i = 0; i < m->vertex_count; i++) {
+    const float *p = pos(i);
+    const float d2 = dist2(p, center);
+    if (d2 > radius * radius) {
+      const float d = std::sqrt(d2);
+      const float new_radius = (radius + d) * 0.5f;
+      const float k = (new_radius - radius) / d;
+      radius = new_radius;
+      for (int c = 0; c < 3; c++) {
+        center[c] += (p[c] - center[c]) * k;
       }
-
-      bin_data_ = bytes + header_and_json_size +
-                  8;  // 4 bytes (bin_buffer_length) + 4 bytes(bin_buffer_format)
     }
-
-    bin_size_ = size_t(chunk1_length);
   }
-
-  is_binary_ = true;
-
-  bool ret = LoadFromString(model, err, warn,
-                            reinterpret_cast<const char *>(&bytes[20]),
-                            chunk0_length, base_dir, check_sections);
-  if (!ret) {
-    return ret;
+  for (int c = 0; c < 3; c++) {
+    m->center[c] = center[c];
+  }
+  m->radius = radius;
+
+  // Normal cone.
+  std::vector<float> normals(size_t(m->triangle_count) * 3);
+  std::vector<uint32_t> corners(m->triangle_count);
+  size_t num_normals = 0;
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  const uint8_t *tris = meshlets.triangles.data() + m->triangle_offset;
+  for (uint32_t t = 0; t < m->triangle_count; t++) {
+    const float *a = pos(tris[3 * t]);
+    const float *b = pos(tris[3 * t + 1]);
+    const float *c = pos(tris[3 * t + 2]);
+    const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                  e1[0] * e2[1] - e1[1] * e2[0]};
+    const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (len <= 0.0f) {
+      continue;  // degenerate
+    }
+    for (int k = 0; k < 3; k++) {
+      n[k] /= len;
+      normals[3 * num_normals + size_t(k)] = n[k];
+      axis[k] += n[k];
+    }
+    corners[num_normals] = tris[3 * t];
+    num_normals++;
+  }
+  const float axis_len =
+      std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  m->cone_cutoff = 1.0f;
+  if ((num_normals == 0) || (axis_len <= 0.0f)) {
+    return;
+  }
+  for (int k = 0; k < 3; k++) {
+    axis[k] /= axis_len;
+  }
+  float min_dp = 1.0f;
+  for (size_t i = 0; i < num_normals; i++) {
+    const float *n = &normals[3 * i];
+    min_dp = (std::min)(min_dp, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+  }
+  if (min_dp <= 0.1f) {
+    return;  // normals spread over(almost) a hemisphere: never culled
   }
 
-  return true;
+  // Apex: the point on the ray center - t * axis which lies behind the planes
+  // of all triangles.
+  float max_t = 0.0f;
+  for (size_t i = 0; i < num_normals; i++) {
+    const float *n = &normals[3 * i];
+    const float *p = pos(corners[i]);
+    const float dc = (center[0] - p[0]) * n[0] + (center[1] - p[1]) * n[1] +
+                     (center[2] - p[2]) * n[2];
+    const float dn = axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2];
+    max_t = (std::max)(max_t, dc / dn);
+  }
+  for (int k = 0; k < 3; k++) {
+    m->cone_axis[k] = axis[k];
+    m->cone_apex[k] = center[k] - axis[k] * max_t;
+  }
+  m->cone_cutoff = std::sqrt(1.0f - min_dp * min_dp);
 }
 
-bool TinyGLTF::LoadBinaryFromFile(Model *model, std::string *err,
-                                  std::string *warn,
-                                  const std::string &filename,
-                                  unsigned int check_sections) {
-  std::stringstream ss;
-
-  if (fs.ReadWholeFile == nullptr) {
-    // Programmer error, assert() ?
-    ss << "Failed to read file: " << filename
-       << ": one or more FS callback not set" << std::endl;
+bool BuildMeshlets(const uint32_t *indices, size_t count,
+                   const float *positions, size_t num_vertices,
+                   size_t position_stride, const MeshletOptions &options,
+                   Meshlets *meshlets, std::string *err) {
+  if ((options.max_vertices < 3) || (options.max_vertices > 255) ||
+      (options.max_triangles < 1) || (options.max_triangles > 512)) {
     if (err) {
-      (*err) = ss.str();
+      (*err) += "Invalid meshlet size limits.\n";
     }
     return false;
   }
-
-  std::vector<unsigned char> data;
-  std::string fileerr;
-  bool fileread = fs.ReadWholeFile(&data, &fileerr, filename, fs.user_data);
-  if (!fileread) {
-    ss << "Failed to read file: " << filename << ": " << fileerr << std::endl;
+  if (position_stride < 3) {
     if (err) {
-      (*err) = ss.str();
+      (*err) += "Invalid position stride.\n";
     }
     return false;
   }
+  if (!CheckIndexRange(indices, count, num_vertices, err)) {
+    return false;
+  }
 
-  std::string basedir = GetBaseDir(filename);
-
-  bool ret = LoadBinaryFromMemory(model, err, warn, &data.at(0),
-                                  static_cast<unsigned int>(data.size()),
-                                  basedir, check_sections);
+  meshlets->meshlets.clear();
+  meshlets->vertices.clear();
+  meshlets->triangles.clear();
+  meshlets->triangles.reserve(count - count % 3);
 
-  return ret;
-}
+  const uint8_t kUnused = 0xff;
+  std::vector<uint8_t> local(num_vertices, kUnused);
+  Meshlet current;
 
-///////////////////////
-// GLTF Serialization
-///////////////////////
-namespace detail {
-detail::json JsonFromString(const char *s) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return detail::json(s, detail::GetAllocator());
-#else
-  return detail::json(s);
-#endif
-}
+  auto finish = [&]() {
+    if (current.triangle_count == 0) {
+      return;
+    }
+    for (uint32_t i = 0; i < current.vertex_count; i++) {
+      local[meshlets->vertices[current.vertex_offset + i]] = kUnused;
+    }
+    ComputeMeshletBounds(*meshlets, positions, position_stride, &current);
+    meshlets->meshlets.push_back(current);
+    current = Meshlet();
+    current.vertex_offset = uint32_t(meshlets->vertices.size());
+    current.triangle_offset = uint32_t(meshlets->triangles.size());
+  };
 
-void JsonAssign(detail::json &dest, const detail::json &src) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  dest.CopyFrom(src, detail::GetAllocator());
-#else
-  dest = src;
-#endif
+  for (size_t t = 0; t + 2 < count; t += 3) {
+    const uint32_t tri[3] = {indices[t], indices[t + 1], indices[t + 2]};
+    const uint32_t extra = (local[tri[0]] == kUnused) +
+                           (local[tri[1]] == kUnused && tri[1] != tri[0]) +
+                           (local[tri[2]] == kUnused && tri[2] != tri[0] &&
+                            tri[2] != tri[1]);
+    if ((current.vertex_count + extra > options.max_vertices) ||
+        (current.triangle_count + 1 > options.max_triangles)) {
+      finish();
+    }
+    for (int k = 0; k < 3; k++) {
+      if (local[tri[k]] == kUnused) {
+        local[tri[k]] = uint8_t(current.vertex_count++);
+        meshlets->vertices.push_back(tri[k]);
+      }
+      meshlets->triangles.push_back(local[tri[k]]);
+    }
+    current.triangle_count++;
+  }
+  finish();
+  return true;
 }
 
-void JsonAddMember(detail::json &o, const char *key, detail::json &&value) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  if (!o.IsObject()) {
-    o.SetObject();
+bool BuildMeshlets(const Model &model, const Primitive &primitive,
+                   const MeshletOptions &options, Meshlets *meshlets,
+                   std::string *err) {
+  std::map<std::string, int>::const_iterator it =
+      primitive.attributes.find("POSITION");
+  if (it == primitive.attributes.end()) {
+    if (err) {
+      (*err) += "Primitive has no POSITION attribute.\n";
+    }
+    return false;
   }
-
-  // Issue 420.
-  // AddMember may create duplicated key, so use [] API when a key already
-  // exists.
-  // https://github.com/Tencent/rapidjson/issues/771#issuecomment-254386863
-  detail::json_const_iterator it;
-  if (detail::FindMember(o, key, it)) {
-    o[key] = std::move(value);  // replace
-  } else {
-    o.AddMember(detail::json(key, detail::GetAllocator()), std::move(value),
-                detail::GetAllocator());
+  if ((it->second < 0) || (size_t(it->second) >= model.accessors.size()) ||
+      (model.accessors[size_t(it->second)].type != TINYGLTF_TYPE_VEC3)) {
+    if (err) {
+      (*err) += "Invalid POSITION accessor.\n";
+    }
+    return false;
   }
-#else
-  o[key] = std::move(value);
-#endif
-}
-
-void JsonPushBack(detail::json &o, detail::json &&value) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  o.PushBack(std::move(value), detail::GetAllocator());
-#else
-  o.push_back(std::move(value));
-#endif
-}
-
-bool JsonIsNull(const detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  return o.IsNull();
-#else
-  return o.is_null();
-#endif
-}
-
-void JsonSetObject(detail::json &o) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  o.SetObject();
-#else
-  o = o.object({});
-#endif
-}
-
-void JsonReserveArray(detail::json &o, size_t s) {
-#ifdef TINYGLTF_USE_RAPIDJSON
-  o.SetArray();
-  o.Reserve(static_cast<rapidjson::SizeType>(s), detail::GetAllocator());
-#endif
-  (void)(o);
-  (void)(s);
-}
-}  // namespace detail
-
-// typedef std::pair<std::string, detail::json> json_object_pair;
-
-template <typename T>
-static void SerializeNumberProperty(const std::string &key, T number,
-                                    detail::json &obj) {
-  // obj.insert(
-  //    json_object_pair(key, detail::json(static_cast<double>(number))));
-  // obj[key] = static_cast<double>(number);
-  detail::JsonAddMember(obj, key.c_str(), detail::json(number));
-}
-
-#ifdef TINYGLTF_USE_RAPIDJSON
-template <>
-void SerializeNumberProperty(const std::string &key, size_t number,
-                             detail::json &obj) {
-  detail::JsonAddMember(obj, key.c_str(),
-                        detail::json(static_cast<uint64_t>(number)));
-}
-#endif
 
-template <typename T>
-static void SerializeNumberArrayProperty(const std::string &key,
-                                         const std::vector<T> &value,
-                                         detail::json &obj) {
-  if (value.empty()) return;
-
-  detail::json ary;
-  detail::JsonReserveArray(ary, value.size());
-  for (const auto &s : value) {
-    detail::JsonPushBack(ary, detail::json(s));
+  std::vector<uint32_t> indices;
+  if (!GetTriangleIndices(model, primitive, &indices, err)) {
+    return false;
   }
-  detail::JsonAddMember(obj, key.c_str(), std::move(ary));
-}
-
-static void SerializeStringProperty(const std::string &key,
-                                    const std::string &value,
-                                    detail::json &obj) {
-  detail::JsonAddMember(obj, key.c_str(),
-                        detail::JsonFromString(value.c_str()));
-}
 
-static void SerializeStringArrayProperty(const std::string &key,
-                                         const std::vector<std::string> &value,
-                                         detail::json &obj) {
-  detail::json ary;
-  detail::JsonReserveArray(ary, value.size());
-  for (auto &s : value) {
-    detail::JsonPushBack(ary, detail::JsonFromString(s.c_str()));
+  const size_t num_vertices = model.accessors[size_t(it->second)].count;
+  std::vector<float> positions(num_vertices * 3);
+  std::vector<AccessorFloatTarget> targets(1);
+  targets[0].accessor = it->second;
+  targets[0].dst = positions.data();
+  targets[0].element_stride = 3;
+  if (!ConvertAccessorsToFloat(model, targets, err, 1)) {
+    return false;
   }
-  detail::JsonAddMember(obj, key.c_str(), std::move(ary));
+  return BuildMeshlets(indices.data(), indices.size(), positions.data(),
+                       num_vertices, 3, options, meshlets, err);
 }
 
-static bool ValueToJson(const Value &value, detail::json *ret) {
-  detail::json obj;
-#ifdef TINYGLTF_USE_RAPIDJSON
-  switch (value.Type()) {
-    case REAL_TYPE:
-      obj.SetDouble(value.Get<double>());
-      break;
-    case INT_TYPE:
-      obj.SetInt(value.Get<int>());
-      break;
-    case BOOL_TYPE:
-      obj.SetBool(value.Get<bool>());
-      break;
-    case STRING_TYPE:
-      obj.SetString(value.Get<std::string>().c_str(), detail::GetAllocator());
-      break;
-    case ARRAY_TYPE: {
-      obj.SetArray();
-      obj.Reserve(static_cast<rapidjson::SizeType>(value.ArrayLen()),
-                  detail::GetAllocator());
-      for (unsigned int i = 0; i < value.ArrayLen(); ++i) {
-        Value elementValue = value.Get(int(i));
-        detail::json elementJson;
-        if (ValueToJson(value.Get(int(i)), &elementJson))
-          obj.PushBack(std::move(elementJson), detail::GetAllocator());
-      }
-      break;
-    }
-    case BINARY_TYPE:
-      // TODO
-      // obj = detail::json(value.Get<std::vector<unsigned char>>());
-      return false;
-      break;
-    case OBJECT_TYPE: {
-      obj.SetObject();
-      Value::Object objMap = value.Get<Value::Object>();
-      for (auto &it : objMap) {
-        detail::json elementJson;
-        if (ValueToJson(it.second, &elementJson)) {
-          obj.AddMember(detail::json(it.first.c_str(), detail::GetAllocator()),
-                        std::move(elementJson), detail::GetAllocator());
-        }
+bool GenerateMeshlets(Model *model, const MeshletOptions &options,
+                      std::vector<PrimitiveMeshlets> *meshlets,
+                      std::string *err) {
+  struct Task {
+    PrimitiveMeshlets result;
+    bool ok;
+    std::string err;
+  };
+  std::vector<Task> tasks;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const int mode = model->meshes[m].primitives[p].mode;
+      if ((mode >= 0) && (mode != TINYGLTF_MODE_TRIANGLES) &&
+          (mode != TINYGLTF_MODE_TRIANGLE_STRIP) &&
+          (mode != TINYGLTF_MODE_TRIANGLE_FAN)) {
+        continue;
       }
-      break;
+      Task task;
+      task.result.mesh = int(m);
+      task.result.primitive = int(p);
+      task.ok = false;
+      tasks.push_back(std::move(task));
     }
-    case NULL_TYPE:
-    default:
-      return false;
   }
-#else
-  switch (value.Type()) {
-    case REAL_TYPE:
-      obj = detail::json(value.Get<double>());
-      break;
-    case INT_TYPE:
-      obj = detail::json(value.Get<int>());
-      break;
-    case BOOL_TYPE:
-      obj = detail::json(value.Get<bool>());
-      break;
-    case STRING_TYPE:
-      obj = detail::json(value.Get<std::string>());
-      break;
-    case ARRAY_TYPE: {
-      for (size_t i = 0; i < value.ArrayLen(); ++i) {
-        Value elementValue = value.Get(i);
-        detail::json elementJson;
-        if (ValueToJson(value.Get(i), &elementJson))
-          obj.push_back(elementJson);
+
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    Task &task = tasks[t];
+    const Primitive &primitive =
+        model->meshes[size_t(task.result.mesh)]
+            .primitives[size_t(task.result.primitive)];
+    task.ok = BuildMeshlets(*model, primitive, options, &task.result.meshlets,
+                            &task.err);
+  });
+
+  bool success = true;
+  bool stored = false;
+  if (meshlets) {
+    meshlets->clear();
+  }
+  for (Task &task : tasks) {
+    if (!task.ok) {
+      success = false;
+      if (err) {
+        (*err) += "mesh[" + std::to_string(task.result.mesh) +
+                  "].primitives[" + std::to_string(task.result.primitive) +
+                  "]: " + task.err;
       }
-      break;
+      continue;
     }
-    case BINARY_TYPE:
-      // TODO
-      // obj = json(value.Get<std::vector<unsigned char>>());
-      return false;
-      break;
-    case OBJECT_TYPE: {
-      Value::Object objMap = value.Get<Value::Object>();
-      for (auto &it : objMap) {
-        detail::json elementJson;
-        if (ValueToJson(it.second, &elementJson)) obj[it.first] = elementJson;
+
+    if (options.store_in_model) {
+      const Meshlets &ml = task.result.meshlets;
+      std::vector<unsigned char> records(ml.meshlets.size() *
+                                         kMeshletRecordSize, 0);
+      for (size_t i = 0; i < ml.meshlets.size(); i++) {
+        const Meshlet &m = ml.meshlets[i];
+        unsigned char *dst = records.data() + i * kMeshletRecordSize;
+        const uint32_t header[4] = {m.vertex_offset, m.vertex_count,
+                                    m.triangle_offset, m.triangle_count};
+        const float bounds[11] = {
+            m.center[0],    m.center[1],    m.center[2],    m.radius,
+            m.cone_apex[0], m.cone_apex[1], m.cone_apex[2], m.cone_axis[0],
+            m.cone_axis[1], m.cone_axis[2], m.cone_cutoff};
+        std::memcpy(dst, header, sizeof(header));
+        std::memcpy(dst + sizeof(header), bounds, sizeof(bounds));
       }
-      break;
+
+      Value::Object ext;
+      ext["maxVertices"] = Value(int(options.max_vertices));
+      ext["maxTriangles"] = Value(int(options.max_triangles));
+      ext["meshlets"] =
+          Value(AppendBufferView(model, records.data(), records.size(), 0));
+      model->bufferViews.back().byteStride = kMeshletRecordSize;
+      ext["vertices"] = Value(AppendBufferView(
+          model, reinterpret_cast<const unsigned char *>(ml.vertices.data()),
+          ml.vertices.size() * sizeof(uint32_t), 0));
+      ext["triangles"] = Value(AppendBufferView(
+          model, ml.triangles.data(), ml.triangles.size(), 0));
+      model->meshes[size_t(task.result.mesh)]
+          .primitives[size_t(task.result.primitive)]
+          .extensions[kMeshletExtension] = Value(std::move(ext));
+      stored = true;
+    }
+
+    if (meshlets) {
+      meshlets->push_back(std::move(task.result));
     }
-    case NULL_TYPE:
-    default:
-      return false;
   }
-#endif
-  if (ret) *ret = std::move(obj);
-  return true;
-}
 
-static void SerializeValue(const std::string &key, const Value &value,
-                           detail::json &obj) {
-  detail::json ret;
-  if (ValueToJson(value, &ret)) {
-    detail::JsonAddMember(obj, key.c_str(), std::move(ret));
+  if (stored &&
+      (std::find(model->extensionsUsed.begin(), model->extensionsUsed.end(),
+                 kMeshletExtension) == model->extensionsUsed.end())) {
+    model->extensionsUsed.push_back(kMeshletExtension);
   }
+  return success;
 }
 
-static void SerializeGltfBufferData(const std::vector<unsigned char> &data,
-                                    detail::json &o) {
-  std::string header = "data:application/octet-stream;base64,";
-  if (data.size() > 0) {
-    std::string encodedData =
-        base64_encode(&data[0], static_cast<unsigned int>(data.size()));
-    SerializeStringProperty("uri", header + encodedData, o);
-  } else {
-    // Issue #229
-    // size 0 is allowed. Just emit mime header.
-    SerializeStringProperty("uri", header, o);
+bool GetStoredMeshlets(const Model &model, const Primitive &primitive,
+                       Meshlets *meshlets, std::string *err) {
+  auto it = primitive.extensions.find(kMeshletExtension);
+  if (it == primitive.extensions.end()) {
+    if (err) {
+      (*err) += "Primitive has no " + std::string(kMeshletExtension) +
+                " extension.\n";
+    }
+    return false;
   }
-}
+  const Value &ext = it->second;
+  const std::string name = kMeshletExtension;
 
-static bool SerializeGltfBufferData(const std::vector<unsigned char> &data,
-                                    const std::string &binFilename) {
-#ifdef _WIN32
-#if defined(__GLIBCXX__)  // mingw
-  int file_descriptor = _wopen(UTF8ToWchar(binFilename).c_str(),
-                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(
-      file_descriptor, std::ios_base::out | std::ios_base::binary);
-  std::ostream output(&wfile_buf);
-  if (!wfile_buf.is_open()) return false;
-#elif defined(_MSC_VER)
-  std::ofstream output(UTF8ToWchar(binFilename).c_str(), std::ofstream::binary);
-  if (!output.is_open()) return false;
-#else
-  std::ofstream output(binFilename.c_str(), std::ofstream::binary);
-  if (!output.is_open()) return false;
-#endif
-#else
-  std::ofstream output(binFilename.c_str(), std::ofstream::binary);
-  if (!output.is_open()) return false;
-#endif
-  if (data.size() > 0) {
-    output.write(reinterpret_cast<const char *>(&data[0]),
-                 std::streamsize(data.size()));
-  } else {
-    // Issue #229
-    // size 0 will be still valid buffer data.
-    // write empty file.
+  auto view_data = [&](const char *key, size_t *size) -> const unsigned char * {
+    const int view = ExtensionIndex(ext, key);
+    if ((view < 0) || (size_t(view) >= model.bufferViews.size())) {
+      if (err) {
+        (*err) += name + ": invalid \"" + key + "\" bufferView.\n";
+      }
+      return nullptr;
+    }
+    *size = model.bufferViews[size_t(view)].byteLength;
+    if (*size == 0) {
+      static const unsigned char kEmpty = 0;
+      return &kEmpty;
+    }
+    return GetBufferViewData(model, view, 0, *size, name, err);
+  };
+
+  size_t records_size = 0, vertices_size = 0, triangles_size = 0;
+  const unsigned char *records = view_data("meshlets", &records_size);
+  const unsigned char *vertices = view_data("vertices", &vertices_size);
+  const unsigned char *triangles = view_data("triangles", &triangles_size);
+  if (!records || !vertices || !triangles) {
+    return false;
+  }
+
+  meshlets->meshlets.resize(records_size / kMeshletRecordSize);
+  meshlets->vertices.resize(vertices_size / sizeof(uint32_t));
+  std::memcpy(meshlets->vertices.data(), vertices,
+              meshlets->vertices.size() * sizeof(uint32_t));
+  meshlets->triangles.assign(triangles, triangles + triangles_size);
+
+  for (size_t i = 0; i < meshlets->meshlets.size(); i++) {
+    Meshlet &m = meshlets->meshlets[i];
+    const unsigned char *src = records + i * kMeshletRecordSize;
+    uint32_t header[4];
+    float bounds[11];
+    std::memcpy(header, src, sizeof(header));
+    std::memcpy(bounds, src + sizeof(header), sizeof(bounds));
+    m.vertex_offset = header[0];
+    m.vertex_count = header[1];
+    m.triangle_offset = header[2];
+    m.triangle_count = header[3];
+    if ((size_t(m.vertex_offset) + m.vertex_count >
+         meshlets->vertices.size()) ||
+        (size_t(m.triangle_offset) + size_t(m.triangle_count) * 3 >
+         meshlets->triangles.size())) {
+      if (err) {
+        (*err) += name + ": meshlet[" + std::to_string(i) +
+                  "] out of range.\n";
+      }
+      return false;
+    }
+    for (int k = 0; k < 3; k++) {
+      m.center[k] = bounds[k];
+      m.cone_apex[k] = bounds[4 + k];
+      m.cone_axis[k] = bounds[7 + k];
+    }
+    m.radius = bounds[3];
+    m.cone_cutoff = bounds[10];
   }
   return true;
 }
 
-#if 0  // FIXME(syoyo): not used. will be removed in the future release.
-static void SerializeParameterMap(ParameterMap &param, detail::json &o) {
-  for (ParameterMap::iterator paramIt = param.begin(); paramIt != param.end();
-       ++paramIt) {
-    if (paramIt->second.number_array.size()) {
-      SerializeNumberArrayProperty<double>(paramIt->first,
-                                           paramIt->second.number_array, o);
-    } else if (paramIt->second.json_double_value.size()) {
-      detail::json json_double_value;
-      for (std::map<std::string, double>::iterator it =
-               paramIt->second.json_double_value.begin();
-           it != paramIt->second.json_double_value.end(); ++it) {
-        if (it->first == "index") {
-          json_double_value[it->first] = paramIt->second.TextureIndex();
-        } else {
-          json_double_value[it->first] = it->second;
+bool ApplyVertexLayout(Model *model, const VertexLayoutOptions &options,
+                       std::string *err) {
+  if ((options.alignment < 4) ||
+      ((options.alignment & (options.alignment - 1)) != 0)) {
+    if (err) {
+      (*err) += "Invalid alignment " + std::to_string(options.alignment) +
+                ".\n";
+    }
+    return false;
+  }
+
+  // Accessors and bufferViews this pass replaces are reclaimed afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+
+  // Layout of a mesh, relative to its new buffer.
+  struct NewView {
+    size_t offset;
+    size_t length;
+    size_t stride;
+    int target;
+  };
+  struct NewAccessor {
+    int source;      // source accessor(properties are copied)
+    size_t view;     // index into `views`
+    size_t offset;   // byteOffset
+  };
+  struct PrimitiveLayout {
+    size_t primitive;
+    std::map<std::string, size_t> attributes;  // -> index into `accessors`
+    std::vector<std::map<std::string, size_t>> targets;
+    size_t indices{size_t(-1)};
+  };
+  struct Task {
+    std::vector<unsigned char> data;
+    std::vector<NewView> views;
+    std::vector<NewAccessor> accessors;
+    std::vector<PrimitiveLayout> primitives;
+    bool ok{true};
+    std::string err;
+  };
+
+  std::vector<Task> tasks(model->meshes.size());
+
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t m) {
+    Task &task = tasks[m];
+    const Mesh &mesh = model->meshes[m];
+    const size_t alignment = options.alignment;
+
+    auto begin_view = [&](size_t stride, int target) {
+      task.data.resize((task.data.size() + alignment - 1) & ~(alignment - 1));
+      NewView view;
+      view.offset = task.data.size();
+      view.length = 0;
+      view.stride = stride;
+      view.target = target;
+      task.views.push_back(view);
+      return task.views.size() - 1;
+    };
+
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+      const Primitive &primitive = mesh.primitives[p];
+      if (primitive.attributes.empty() ||
+          primitive.extensions.count("KHR_draco_mesh_compression")) {
+        continue;
+      }
+      const std::string name =
+          "mesh[" + std::to_string(m) + "].primitives[" + std::to_string(p) +
+          "]: ";
+
+      std::vector<VertexStream> streams;
+      size_t num_vertices = 0;
+      std::string stream_err;
+      if (!ResolveVertexStreams(*model, primitive, &streams, &num_vertices,
+                                &stream_err)) {
+        task.ok = false;
+        task.err += name + stream_err;
+        continue;
+      }
+      if (num_vertices == 0) {
+        continue;
+      }
+
+      // Group attributes(indices into `streams`, which start with the
+      // attributes in map order).
+      std::vector<std::string> names;
+      for (const auto &attrib : primitive.attributes) {
+        names.push_back(attrib.first);
+      }
+      std::vector<bool> grouped(names.size(), false);
+      std::vector<std::vector<size_t>> groups;
+      for (const auto &stream_names : options.streams) {
+        std::vector<size_t> group;
+        for (const std::string &n : stream_names) {
+          for (size_t a = 0; a < names.size(); a++) {
+            if (!grouped[a] && (names[a] == n)) {
+              grouped[a] = true;
+              group.push_back(a);
+            }
+          }
+        }
+        if (!group.empty()) {
+          groups.push_back(group);
+        }
+      }
+      std::vector<size_t> remaining;
+      for (size_t a = 0; a < names.size(); a++) {
+        if (!grouped[a]) {
+          remaining.push_back(a);
+        }
+      }
+      if (options.separate_remaining) {
+        for (size_t a : remaining) {
+          groups.push_back(std::vector<size_t>(1, a));
         }
+      } else if (!remaining.empty()) {
+        groups.push_back(remaining);
+      }
+      // Morph targets: one bufferView each.
+      for (size_t s = names.size(); s < streams.size(); s++) {
+        groups.push_back(std::vector<size_t>(1, s));
       }
 
-      o[paramIt->first] = json_double_value;
-    } else if (!paramIt->second.string_value.empty()) {
-      SerializeStringProperty(paramIt->first, paramIt->second.string_value, o);
-    } else if (paramIt->second.has_number_value) {
-      o[paramIt->first] = paramIt->second.number_value;
-    } else {
-      o[paramIt->first] = paramIt->second.bool_value;
+      PrimitiveLayout layout;
+      layout.primitive = p;
+      std::vector<size_t> stream_accessors(streams.size());
+      bool ok = true;
+      for (const std::vector<size_t> &group : groups) {
+        std::vector<size_t> offsets;
+        size_t stride = 0;
+        for (size_t s : group) {
+          offsets.push_back(stride);
+          stride += (streams[s].elem_size + 3) & ~size_t(3);
+        }
+        if ((group.size() > 1) && (stride > 252)) {
+          task.err += name + "interleaved vertex stride exceeds 252 bytes.\n";
+          ok = false;
+          break;
+        }
+        const bool packed =
+            (group.size() == 1) && (stride == streams[group[0]].elem_size);
+        const size_t view = begin_view(packed ? 0 : stride,
+                                       TINYGLTF_TARGET_ARRAY_BUFFER);
+        const size_t base = task.data.size();
+        task.data.resize(base + num_vertices * stride, 0);
+        for (size_t g = 0; g < group.size(); g++) {
+          const VertexStream &stream = streams[group[g]];
+          unsigned char *dst = task.data.data() + base + offsets[g];
+          for (size_t v = 0; v < num_vertices; v++) {
+            std::memcpy(dst + v * stride,
+                        stream.source.data + v * stream.source.stride,
+                        stream.elem_size);
+          }
+          NewAccessor accessor;
+          accessor.source = stream.accessor;
+          accessor.view = view;
+          accessor.offset = offsets[g];
+          task.accessors.push_back(accessor);
+          stream_accessors[group[g]] = task.accessors.size() - 1;
+        }
+        task.views[view].length = num_vertices * stride;
+      }
+      if (!ok) {
+        task.ok = false;
+        continue;
+      }
+      for (size_t a = 0; a < names.size(); a++) {
+        layout.attributes[names[a]] = stream_accessors[a];
+      }
+      size_t s = names.size();
+      for (const auto &target : primitive.targets) {
+        std::map<std::string, size_t> t;
+        for (const auto &attrib : target) {
+          t[attrib.first] = stream_accessors[s++];
+        }
+        layout.targets.push_back(t);
+      }
+
+      if (primitive.indices >= 0) {
+        AccessorSource source;
+        if (!ResolveAccessorSource(*model, primitive.indices, &source,
+                                   &stream_err)) {
+          task.ok = false;
+          task.err += name + stream_err;
+          continue;
+        }
+        const size_t index_size =
+            size_t(GetComponentSizeInBytes(uint32_t(source.component_type)));
+        const size_t view = begin_view(0, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+        const size_t base = task.data.size();
+        task.data.resize(base + source.count * index_size);
+        for (size_t i = 0; i < source.count; i++) {
+          std::memcpy(task.data.data() + base + i * index_size,
+                      source.data + i * source.stride, index_size);
+        }
+        task.views[view].length = source.count * index_size;
+        NewAccessor accessor;
+        accessor.source = primitive.indices;
+        accessor.view = view;
+        accessor.offset = 0;
+        task.accessors.push_back(accessor);
+        layout.indices = task.accessors.size() - 1;
+      }
+      task.primitives.push_back(std::move(layout));
     }
-  }
-}
-#endif
+  });
 
-static void SerializeExtensionMap(const ExtensionMap &extensions,
-                                  detail::json &o) {
-  if (!extensions.size()) return;
+  bool success = true;
+  for (size_t m = 0; m < tasks.size(); m++) {
+    Task &task = tasks[m];
+    if (!task.ok) {
+      success = false;
+      if (err) {
+        (*err) += task.err;
+      }
+    }
+    if (task.primitives.empty()) {
+      continue;
+    }
 
-  detail::json extMap;
-  for (ExtensionMap::const_iterator extIt = extensions.begin();
-       extIt != extensions.end(); ++extIt) {
-    // Allow an empty object for extension(#97)
-    detail::json ret;
-    bool isNull = true;
-    if (ValueToJson(extIt->second, &ret)) {
-      isNull = detail::JsonIsNull(ret);
-      detail::JsonAddMember(extMap, extIt->first.c_str(), std::move(ret));
+    const int buffer_idx = int(model->buffers.size());
+    Buffer buffer;
+    buffer.name = model->meshes[m].name;
+    buffer.data.swap(task.data);
+    model->buffers.emplace_back(std::move(buffer));
+
+    const int view_base = int(model->bufferViews.size());
+    for (const NewView &v : task.views) {
+      BufferView view;
+      view.buffer = buffer_idx;
+      view.byteOffset = v.offset;
+      view.byteLength = v.length;
+      view.byteStride = v.stride;
+      view.target = v.target;
+      model->bufferViews.emplace_back(std::move(view));
     }
-    if (isNull) {
-      if (!(extIt->first.empty())) {  // name should not be empty, but for sure
-        // create empty object so that an extension name is still included in
-        // json.
-        detail::json empty;
-        detail::JsonSetObject(empty);
-        detail::JsonAddMember(extMap, extIt->first.c_str(), std::move(empty));
+
+    const int accessor_base = int(model->accessors.size());
+    for (const NewAccessor &a : task.accessors) {
+      Accessor accessor = model->accessors[size_t(a.source)];
+      accessor.bufferView = view_base + int(a.view);
+      accessor.byteOffset = a.offset;
+      accessor.sparse = Accessor::Sparse();
+      accessor.sparse.isSparse = false;
+      model->accessors.emplace_back(std::move(accessor));
+    }
+
+    for (const PrimitiveLayout &layout : task.primitives) {
+      Primitive &primitive = model->meshes[m].primitives[layout.primitive];
+      for (auto &attrib : primitive.attributes) {
+        attrib.second =
+            accessor_base + int(layout.attributes.at(attrib.first));
+      }
+      for (size_t t = 0; t < primitive.targets.size(); t++) {
+        for (auto &attrib : primitive.targets[t]) {
+          attrib.second =
+              accessor_base + int(layout.targets[t].at(attrib.first));
+        }
+      }
+      if (layout.indices != size_t(-1)) {
+        primitive.indices = accessor_base + int(layout.indices);
       }
     }
   }
-  detail::JsonAddMember(o, "extensions", std::move(extMap));
+
+  if (success && options.compact_buffers) {
+    success = CompactBuffers(model, &references, err);
+  }
+  return success;
 }
 
-static void SerializeExtras(const Value &extras, detail::json &o) {
-  if (extras.Type() != NULL_TYPE) SerializeValue("extras", extras, o);
+//
+// Quantized data of an attribute accessor.
+//
+struct QuantizedStream {
+  int source{-1};  // source accessor
+  int component_type{0};
+  bool normalized{false};
+  size_t num_components{0};
+  size_t count{0};
+  size_t stride{0};
+  std::vector<unsigned char> data;
+};
+
+//
+// Quantizes `count` * `num_components` floats to normalized integers of
+// `component_type`(or unnormalized, unsigned integers for positions, in which
+// case `values` must already be scaled). Returns the max abs error.
+//
+template <typename T>
+static double QuantizeComponents(const float *values, size_t count,
+                                 size_t num_components, bool normalized,
+                                 QuantizedStream *stream) {
+  const double qmax = double((std::numeric_limits<T>::max)());
+  const double qmin = std::numeric_limits<T>::is_signed ? -qmax : 0.0;
+  double max_error = 0.0;
+  stream->stride =
+      (sizeof(T) * num_components + 3) & ~size_t(3);
+  stream->data.assign(count * stream->stride, 0);
+  for (size_t i = 0; i < count; i++) {
+    T *dst = reinterpret_cast<T *>(stream->data.data() + i * stream->stride);
+    for (size_t c = 0; c < num_components; c++) {
+      const double v = double(values[i * num_components + c]);
+      double q = normalized ? v * qmax : v;
+      q = (std::min)(qmax, (std::max)(qmin, std::floor(q + 0.5)));
+      T t = static_cast<T>(q);
+      std::memcpy(dst + c, &t, sizeof(T));
+      if (normalized) {
+        max_error = (std::max)(max_error, std::fabs(q / qmax - v));
+      }
+    }
+  }
+  stream->num_components = num_components;
+  stream->count = count;
+  return max_error;
 }
 
-template <typename GltfType>
-void SerializeExtrasAndExtensions(const GltfType &obj, detail::json &o) {
-  SerializeExtensionMap(obj.extensions, o);
-  SerializeExtras(obj.extras, o);
+//
+// Rotates `v` by the quaternion q = [x, y, z, w].
+//
+static void RotateByQuaternion(const double q[4], const double v[3],
+                               double out[3]) {
+  // t = 2 * cross(q.xyz, v); out = v + q.w * t + cross(q.xyz, t)
+  const double t[3] = {2.0 * (q[1] * v[2] - q[2] * v[1]),
+                       2.0 * (q[2] * v[0] - q[0] * v[2]),
+                       2.0 * (q[0] * v[1] - q[1] * v[0])};
+  out[0] = v[0] + q[3] * t[0] + (q[1] * t[2] - q[2] * t[1]);
+  out[1] = v[1] + q[3] * t[1] + (q[2] * t[0] - q[0] * t[2]);
+  out[2] = v[2] + q[3] * t[2] + (q[0] * t[1] - q[1] * t[0]);
 }
 
-static void SerializeGltfAccessor(const Accessor &accessor, detail::json &o) {
-  if (accessor.bufferView >= 0)
-    SerializeNumberProperty<int>("bufferView", accessor.bufferView, o);
+bool QuantizeMeshes(Model *model, const QuantizationOptions &options,
+                    std::string *err, QuantizationReport *report) {
+  if ((options.position_bits < 0) || (options.position_bits > 16) ||
+      ((options.normal_bits != 0) && (options.normal_bits != 8) &&
+       (options.normal_bits != 16)) ||
+      ((options.tangent_bits != 0) && (options.tangent_bits != 8) &&
+       (options.tangent_bits != 16)) ||
+      ((options.texcoord_bits != 0) && (options.texcoord_bits != 8) &&
+       (options.texcoord_bits != 16))) {
+    if (err) {
+      (*err) += "Invalid quantization bits.\n";
+    }
+    return false;
+  }
 
-  if (accessor.byteOffset != 0)
-    SerializeNumberProperty<size_t>("byteOffset", accessor.byteOffset, o);
+  // Accessors and bufferViews this pass replaces are reclaimed afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
 
-  SerializeNumberProperty<int>("componentType", accessor.componentType, o);
-  SerializeNumberProperty<size_t>("count", accessor.count, o);
+  // Meshes which can be quantized.
+  const size_t num_meshes = model->meshes.size();
+  std::vector<int> usable(num_meshes, 0);  // 0: unused, 1: ok, -1: skipped
+  for (const Node &node : model->nodes) {
+    if ((node.mesh < 0) || (size_t(node.mesh) >= num_meshes)) {
+      continue;
+    }
+    if ((node.skin >= 0) || node.extensions.count("EXT_mesh_gpu_instancing")) {
+      usable[size_t(node.mesh)] = -1;
+    } else if (usable[size_t(node.mesh)] == 0) {
+      usable[size_t(node.mesh)] = 1;
+    }
+  }
+  for (size_t m = 0; m < num_meshes; m++) {
+    for (const Primitive &primitive : model->meshes[m].primitives) {
+      if (!primitive.targets.empty() ||
+          primitive.extensions.count("KHR_draco_mesh_compression")) {
+        usable[m] = -1;
+      }
+    }
+  }
 
-  if ((accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) ||
-      (accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE)) {
-    SerializeNumberArrayProperty<double>("min", accessor.minValues, o);
-    SerializeNumberArrayProperty<double>("max", accessor.maxValues, o);
-  } else {
-    // Issue #301. Serialize as integer.
-    // Assume int value is within [-2**31-1, 2**31-1]
-    {
-      std::vector<int> values;
-      std::transform(accessor.minValues.begin(), accessor.minValues.end(),
-                     std::back_inserter(values),
-                     [](double v) { return static_cast<int>(v); });
+  struct PrimitiveStreams {
+    size_t primitive;
+    std::vector<std::pair<std::string, QuantizedStream>> attributes;
+  };
+  struct Task {
+    size_t mesh;
+    std::vector<PrimitiveStreams> primitives;
+    bool quantize_positions{false};
+    double offset[3] = {0.0, 0.0, 0.0};  // dequantization
+    double scale{1.0};
+    size_t bytes_before{0};
+    size_t bytes_after{0};
+    double errors[4] = {0.0, 0.0, 0.0, 0.0};  // position/normal/tangent/uv
+    bool ok{true};
+    std::string err;
+  };
+  std::vector<Task> tasks;
+  size_t skipped = 0;
+  for (size_t m = 0; m < num_meshes; m++) {
+    if (usable[m] == 1) {
+      Task task;
+      task.mesh = m;
+      tasks.push_back(std::move(task));
+    } else {
+      skipped++;
+    }
+  }
 
-      SerializeNumberArrayProperty<int>("min", values, o);
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    Task &task = tasks[t];
+    const Mesh &mesh = model->meshes[task.mesh];
+
+    // Float data of the attributes to quantize.
+    struct Input {
+      std::string name;
+      int accessor;
+      size_t num_components;
+      std::vector<float> values;
+    };
+    std::vector<std::vector<Input>> inputs(mesh.primitives.size());
+    double bmin[3] = {std::numeric_limits<double>::max(),
+                      std::numeric_limits<double>::max(),
+                      std::numeric_limits<double>::max()};
+    double bmax[3] = {-std::numeric_limits<double>::max(),
+                      -std::numeric_limits<double>::max(),
+                      -std::numeric_limits<double>::max()};
+    bool has_position = false;
+
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+      for (const auto &attrib : mesh.primitives[p].attributes) {
+        const std::string &name = attrib.first;
+        const bool is_position = (name == "POSITION");
+        const bool is_normal = (name == "NORMAL");
+        const bool is_tangent = (name == "TANGENT");
+        const bool is_texcoord = (name.compare(0, 9, "TEXCOORD_") == 0);
+        if (!(is_position && options.position_bits) &&
+            !(is_normal && options.normal_bits) &&
+            !(is_tangent && options.tangent_bits) &&
+            !(is_texcoord && options.texcoord_bits)) {
+          continue;
+        }
+        if ((attrib.second < 0) ||
+            (size_t(attrib.second) >= model->accessors.size())) {
+          task.ok = false;
+          task.err += "Invalid accessor for " + name + ".\n";
+          return;
+        }
+        const Accessor &accessor = model->accessors[size_t(attrib.second)];
+        // Only float attributes are quantized.
+        if ((accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT) ||
+            (accessor.count == 0)) {
+          continue;
+        }
+        Input input;
+        input.name = name;
+        input.accessor = attrib.second;
+        input.num_components = size_t(
+            GetNumComponentsInType(static_cast<uint32_t>(accessor.type)));
+        if ((is_position || is_normal) && (input.num_components != 3)) {
+          continue;
+        }
+        if ((is_tangent && (input.num_components != 4)) ||
+            (is_texcoord && (input.num_components != 2))) {
+          continue;
+        }
+        input.values.resize(accessor.count * input.num_components);
+        std::vector<AccessorFloatTarget> targets(1);
+        targets[0].accessor = attrib.second;
+        targets[0].dst = input.values.data();
+        targets[0].element_stride = input.num_components;
+        if (!ConvertAccessorsToFloat(*model, targets, &task.err, 1)) {
+          task.ok = false;
+          return;
+        }
+        if (is_texcoord) {
+          const auto range =
+              std::minmax_element(input.values.begin(), input.values.end());
+          if ((*range.first < 0.0f) || (*range.second > 1.0f)) {
+            continue;
+          }
+        }
+        if (is_position) {
+          has_position = true;
+          for (size_t i = 0; i < accessor.count; i++) {
+            for (size_t c = 0; c < 3; c++) {
+              const double v = double(input.values[3 * i + c]);
+              bmin[c] = (std::min)(bmin[c], v);
+              bmax[c] = (std::max)(bmax[c], v);
+            }
+          }
+        }
+        inputs[p].push_back(std::move(input));
+      }
+    }
+
+    // Uniform scale keeps normals valid under the node transform.
+    if (has_position) {
+      const double extent = (std::max)(
+          (std::max)(bmax[0] - bmin[0], bmax[1] - bmin[1]), bmax[2] - bmin[2]);
+      const double qmax = double((1 << options.position_bits) - 1);
+      task.quantize_positions = true;
+      task.scale = (extent > 0.0) ? extent / qmax : 1.0;
+      for (int c = 0; c < 3; c++) {
+        task.offset[c] = bmin[c];
+      }
+    }
+
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+      PrimitiveStreams prim;
+      prim.primitive = p;
+      for (Input &input : inputs[p]) {
+        QuantizedStream stream;
+        stream.source = input.accessor;
+        const size_t count = input.values.size() / input.num_components;
+        task.bytes_before += input.values.size() * sizeof(float);
+        if (input.name == "POSITION") {
+          std::vector<float> scaled(input.values.size());
+          for (size_t i = 0; i < input.values.size(); i++) {
+            scaled[i] = float((double(input.values[i]) - task.offset[i % 3]) /
+                              task.scale);
+          }
+          if (options.position_bits <= 8) {
+            stream.component_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+            QuantizeComponents<uint8_t>(scaled.data(), count, 3, false,
+                                        &stream);
+          } else {
+            stream.component_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+            QuantizeComponents<uint16_t>(scaled.data(), count, 3, false,
+                                         &stream);
+          }
+          // Error of the dequantized position.
+          const size_t csize = (options.position_bits <= 8) ? 1 : 2;
+          for (size_t i = 0; i < count; i++) {
+            for (size_t c = 0; c < 3; c++) {
+              uint16_t q = 0;
+              std::memcpy(&q, stream.data.data() + i * stream.stride + c * csize,
+                          csize);
+              const double v = double(q) * task.scale + task.offset[c];
+              task.errors[0] = (std::max)(
+                  task.errors[0], std::fabs(v - double(input.values[3 * i + c])));
+            }
+          }
+        } else {
+          const bool is_texcoord = (input.name != "NORMAL") &&
+                                   (input.name != "TANGENT");
+          const int bits = (input.name == "NORMAL")    ? options.normal_bits
+                           : (input.name == "TANGENT") ? options.tangent_bits
+                                                       : options.texcoord_bits;
+          double e;
+          stream.normalized = true;
+          if (is_texcoord) {
+            if (bits <= 8) {
+              stream.component_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+              e = QuantizeComponents<uint8_t>(input.values.data(), count, 2,
+                                              true, &stream);
+            } else {
+              stream.component_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+              e = QuantizeComponents<uint16_t>(input.values.data(), count, 2,
+                                               true, &stream);
+            }
+          } else {
+            if (bits <= 8) {
+              stream.component_type = TINYGLTF_COMPONENT_TYPE_BYTE;
+              e = QuantizeComponents<int8_t>(input.values.data(), count,
+                                             input.num_components, true,
+                                             &stream);
+            } else {
+              stream.component_type = TINYGLTF_COMPONENT_TYPE_SHORT;
+              e = QuantizeComponents<int16_t>(input.values.data(), count,
+                                              input.num_components, true,
+                                              &stream);
+            }
+          }
+          const int slot = (input.name == "NORMAL")    ? 1
+                           : (input.name == "TANGENT") ? 2
+                                                       : 3;
+          task.errors[slot] = (std::max)(task.errors[slot], e);
+        }
+        task.bytes_after += stream.data.size();
+        prim.attributes.emplace_back(input.name, std::move(stream));
+      }
+      if (!prim.attributes.empty()) {
+        task.primitives.push_back(std::move(prim));
+      }
+    }
+  });
+
+  bool success = true;
+  QuantizationReport r;
+  r.skipped_meshes = skipped;
+  std::vector<bool> animated(model->nodes.size(), false);
+  for (const Animation &animation : model->animations) {
+    for (const AnimationChannel &channel : animation.channels) {
+      if ((channel.target_node >= 0) &&
+          (size_t(channel.target_node) < animated.size())) {
+        animated[size_t(channel.target_node)] = true;
+      }
+    }
+  }
+  for (Task &task : tasks) {
+    if (!task.ok) {
+      success = false;
+      if (err) {
+        (*err) += "mesh[" + std::to_string(task.mesh) + "]: " + task.err;
+      }
+      continue;
+    }
+    if (task.primitives.empty()) {
+      continue;
+    }
+    r.meshes++;
+    r.bytes_before += task.bytes_before;
+    r.bytes_after += task.bytes_after;
+    r.max_position_error = (std::max)(r.max_position_error, task.errors[0]);
+    r.max_normal_error = (std::max)(r.max_normal_error, task.errors[1]);
+    r.max_tangent_error = (std::max)(r.max_tangent_error, task.errors[2]);
+    r.max_texcoord_error = (std::max)(r.max_texcoord_error, task.errors[3]);
+
+    for (PrimitiveStreams &prim : task.primitives) {
+      Primitive &primitive = model->meshes[task.mesh].primitives[prim.primitive];
+      for (auto &item : prim.attributes) {
+        const QuantizedStream &stream = item.second;
+        const Accessor &src = model->accessors[size_t(stream.source)];
+        Accessor accessor;
+        accessor.name = src.name;
+        accessor.componentType = stream.component_type;
+        accessor.normalized = stream.normalized;
+        accessor.type = src.type;
+        accessor.count = stream.count;
+        accessor.bufferView =
+            AppendBufferView(model, stream.data.data(), stream.data.size(),
+                             TINYGLTF_TARGET_ARRAY_BUFFER);
+        const size_t elem_size =
+            size_t(GetComponentSizeInBytes(uint32_t(stream.component_type))) *
+            stream.num_components;
+        if (stream.stride != elem_size) {
+          model->bufferViews.back().byteStride = stream.stride;
+        }
+        const bool has_bounds =
+            (item.first == "POSITION") || !src.minValues.empty();
+        model->accessors.emplace_back(std::move(accessor));
+        const int accessor_idx = int(model->accessors.size() - 1);
+        if (has_bounds) {
+          AccessorBounds bounds;
+          if (ComputeAccessorBounds(*model, accessor_idx, &bounds, err, 1)) {
+            model->accessors.back().minValues = bounds.min;
+            model->accessors.back().maxValues = bounds.max;
+          }
+        }
+        primitive.attributes[item.first] = accessor_idx;
+      }
     }
 
-    {
-      std::vector<int> values;
-      std::transform(accessor.maxValues.begin(), accessor.maxValues.end(),
-                     std::back_inserter(values),
-                     [](double v) { return static_cast<int>(v); });
-
-      SerializeNumberArrayProperty<int>("max", values, o);
+    // Dequantization transform of positions.
+    if (!task.quantize_positions) {
+      continue;
+    }
+    const size_t num_nodes = model->nodes.size();
+    for (size_t n = 0; n < num_nodes; n++) {
+      if (model->nodes[n].mesh != int(task.mesh)) {
+        continue;
+      }
+      Node &node = model->nodes[n];
+      const bool fold = (n < animated.size()) && !animated[n] &&
+                        node.children.empty() &&
+                        (node.camera < 0) && (node.light < 0) &&
+                        (node.emitter < 0);
+      if (!fold) {
+        Node child;
+        child.name = node.name;
+        child.mesh = node.mesh;
+        child.weights = node.weights;
+        child.translation.assign(task.offset, task.offset + 3);
+        child.scale.assign(3, task.scale);
+        node.mesh = -1;
+        node.weights.clear();
+        node.children.push_back(int(model->nodes.size()));
+        model->nodes.emplace_back(std::move(child));
+        continue;
+      }
+      if (node.matrix.size() == 16) {
+        // M * T(offset) * S(scale), column major.
+        std::vector<double> &mat = node.matrix;
+        for (int row = 0; row < 4; row++) {
+          mat[12 + row] += mat[row] * task.offset[0] +
+                           mat[4 + row] * task.offset[1] +
+                           mat[8 + row] * task.offset[2];
+        }
+        for (int i = 0; i < 12; i++) {
+          mat[size_t(i)] *= task.scale;
+        }
+        continue;
+      }
+      // T * R * S * T(offset) * S(scale)
+      double s[3] = {1.0, 1.0, 1.0};
+      if (node.scale.size() == 3) {
+        s[0] = node.scale[0];
+        s[1] = node.scale[1];
+        s[2] = node.scale[2];
+      }
+      const double q[4] = {
+          node.rotation.size() == 4 ? node.rotation[0] : 0.0,
+          node.rotation.size() == 4 ? node.rotation[1] : 0.0,
+          node.rotation.size() == 4 ? node.rotation[2] : 0.0,
+          node.rotation.size() == 4 ? node.rotation[3] : 1.0};
+      const double so[3] = {s[0] * task.offset[0], s[1] * task.offset[1],
+                            s[2] * task.offset[2]};
+      double rso[3];
+      RotateByQuaternion(q, so, rso);
+      if (node.translation.size() != 3) {
+        node.translation.assign(3, 0.0);
+      }
+      for (int c = 0; c < 3; c++) {
+        node.translation[size_t(c)] += rso[c];
+      }
+      node.scale.assign(s, s + 3);
+      for (double &v : node.scale) {
+        v *= task.scale;
+      }
     }
   }
 
-  if (accessor.normalized)
-    SerializeValue("normalized", Value(accessor.normalized), o);
-  std::string type;
-  switch (accessor.type) {
-    case TINYGLTF_TYPE_SCALAR:
-      type = "SCALAR";
-      break;
-    case TINYGLTF_TYPE_VEC2:
-      type = "VEC2";
-      break;
-    case TINYGLTF_TYPE_VEC3:
-      type = "VEC3";
-      break;
-    case TINYGLTF_TYPE_VEC4:
-      type = "VEC4";
-      break;
-    case TINYGLTF_TYPE_MAT2:
-      type = "MAT2";
-      break;
-    case TINYGLTF_TYPE_MAT3:
-      type = "MAT3";
-      break;
-    case TINYGLTF_TYPE_MAT4:
-      type = "MAT4";
-      break;
+  if (r.meshes > 0) {
+    const char *ext = "KHR_mesh_quantization";
+    if (std::find(model->extensionsUsed.begin(), model->extensionsUsed.end(),
+                  ext) == model->extensionsUsed.end()) {
+      model->extensionsUsed.push_back(ext);
+    }
+    if (std::find(model->extensionsRequired.begin(),
+                  model->extensionsRequired.end(),
+                  ext) == model->extensionsRequired.end()) {
+      model->extensionsRequired.push_back(ext);
+    }
+  }
+  if (r.bytes_after > 0) {
+    r.compression_ratio = double(r.bytes_before) / double(r.bytes_after);
   }
 
-  SerializeStringProperty("type", type, o);
-  if (!accessor.name.empty()) SerializeStringProperty("name", accessor.name, o);
+  if (success && options.compact_buffers) {
+    success = CompactBuffers(model, &references, err);
+  }
+  if (report) {
+    *report = r;
+  }
+  return success;
+}
 
-  SerializeExtrasAndExtensions(accessor, o);
 
-  // sparse
-  if (accessor.sparse.isSparse) {
-    detail::json sparse;
-    SerializeNumberProperty<int>("count", accessor.sparse.count, sparse);
-    {
-      detail::json indices;
-      SerializeNumberProperty<int>("bufferView",
-                                   accessor.sparse.indices.bufferView, indices);
-      SerializeNumberProperty<size_t>("byteOffset",
-                                   accessor.sparse.indices.byteOffset, indices);
-      SerializeNumberProperty<int>(
-          "componentType", accessor.sparse.indices.componentType, indices);
-      SerializeExtrasAndExtensions(accessor.sparse.indices, indices);
-      detail::JsonAddMember(sparse, "indices", std::move(indices));
-    }
-    {
-      detail::json values;
-      SerializeNumberProperty<int>("bufferView",
-                                   accessor.sparse.values.bufferView, values);
-      SerializeNumberProperty<size_t>("byteOffset",
-                                   accessor.sparse.values.byteOffset, values);
-      SerializeExtrasAndExtensions(accessor.sparse.values, values);
-      detail::JsonAddMember(sparse, "values", std::move(values));
-    }
-    SerializeExtrasAndExtensions(accessor.sparse, sparse);
-    detail::JsonAddMember(o, "sparse", std::move(sparse));
+//
+// 4-wide float vector for code which runs on SSE2, NEON(AArch64 has vector
+// sqrt/div) or plain floats. Used by the meshopt filters and the animation
+// sampler.
+//
+#if defined(TINYGLTF_INTERNAL_SSE2)
+typedef __m128 SimdF4;
+static inline SimdF4 F4Set(float v) { return _mm_set1_ps(v); }
+static inline SimdF4 F4Load(const int32_t *p) {
+  return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+}
+static inline void F4StoreTrunc(SimdF4 v, int32_t *p) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_cvttps_epi32(v));
+}
+static inline SimdF4 F4LoadFloat(const float *p) { return _mm_loadu_ps(p); }
+static inline void F4StoreFloat(SimdF4 v, float *p) { _mm_storeu_ps(p, v); }
+static inline SimdF4 F4Add(SimdF4 a, SimdF4 b) {
+  return _mm_add_ps(a, b);
+}
+static inline SimdF4 F4Sub(SimdF4 a, SimdF4 b) {
+  return _mm_sub_ps(a, b);
+}
+static inline SimdF4 F4Mul(SimdF4 a, SimdF4 b) {
+  return _mm_mul_ps(a, b);
+}
+static inline SimdF4 F4Div(SimdF4 a, SimdF4 b) {
+  return _mm_div_ps(a, b);
+}
+static inline SimdF4 F4Sqrt(SimdF4 a) { return _mm_sqrt_ps(a); }
+static inline SimdF4 F4Abs(SimdF4 a) {
+  return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+static inline SimdF4 F4Min(SimdF4 a, SimdF4 b) {
+  return _mm_min_ps(a, b);
+}
+static inline SimdF4 F4Max(SimdF4 a, SimdF4 b) {
+  return _mm_max_ps(a, b);
+}
+// x >= 0 ? a : b
+static inline SimdF4 F4SelectNonNeg(SimdF4 x, SimdF4 a, SimdF4 b) {
+  const __m128 mask = _mm_cmpge_ps(x, _mm_setzero_ps());
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#elif defined(TINYGLTF_INTERNAL_NEON) && defined(__aarch64__)
+typedef float32x4_t SimdF4;
+static inline SimdF4 F4Set(float v) { return vdupq_n_f32(v); }
+static inline SimdF4 F4Load(const int32_t *p) {
+  return vcvtq_f32_s32(vld1q_s32(p));
+}
+static inline void F4StoreTrunc(SimdF4 v, int32_t *p) {
+  vst1q_s32(p, vcvtq_s32_f32(v));
+}
+static inline SimdF4 F4LoadFloat(const float *p) { return vld1q_f32(p); }
+static inline void F4StoreFloat(SimdF4 v, float *p) { vst1q_f32(p, v); }
+static inline SimdF4 F4Add(SimdF4 a, SimdF4 b) {
+  return vaddq_f32(a, b);
+}
+static inline SimdF4 F4Sub(SimdF4 a, SimdF4 b) {
+  return vsubq_f32(a, b);
+}
+static inline SimdF4 F4Mul(SimdF4 a, SimdF4 b) {
+  return vmulq_f32(a, b);
+}
+static inline SimdF4 F4Div(SimdF4 a, SimdF4 b) {
+  return vdivq_f32(a, b);
+}
+static inline SimdF4 F4Sqrt(SimdF4 a) { return vsqrtq_f32(a); }
+static inline SimdF4 F4Abs(SimdF4 a) { return vabsq_f32(a); }
+static inline SimdF4 F4Min(SimdF4 a, SimdF4 b) {
+  return vminq_f32(a, b);
+}
+static inline SimdF4 F4Max(SimdF4 a, SimdF4 b) {
+  return vmaxq_f32(a, b);
+}
+static inline SimdF4 F4SelectNonNeg(SimdF4 x, SimdF4 a, SimdF4 b) {
+  return vbslq_f32(vcgeq_f32(x, vdupq_n_f32(0.0f)), a, b);
+}
+#else
+struct SimdF4 {
+  float v[4];
+};
+#define TINYGLTF_F4_OP(name, expr)                        \
+  static inline SimdF4 name(SimdF4 a, SimdF4 b) {       \
+    SimdF4 r;                                                 \
+    for (int i = 0; i < 4; i++) r.v[i] = (expr);                 \
+    return r;                                                    \
+  }
+TINYGLTF_F4_OP(F4Add, a.v[i] + b.v[i])
+TINYGLTF_F4_OP(F4Sub, a.v[i] - b.v[i])
+TINYGLTF_F4_OP(F4Mul, a.v[i] * b.v[i])
+TINYGLTF_F4_OP(F4Div, a.v[i] / b.v[i])
+TINYGLTF_F4_OP(F4Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+TINYGLTF_F4_OP(F4Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef TINYGLTF_F4_OP
+static inline SimdF4 F4Set(float v) {
+  SimdF4 r = {{v, v, v, v}};
+  return r;
+}
+static inline SimdF4 F4Load(const int32_t *p) {
+  SimdF4 r;
+  for (int i = 0; i < 4; i++) r.v[i] = float(p[i]);
+  return r;
+}
+static inline void F4StoreTrunc(SimdF4 v, int32_t *p) {
+  for (int i = 0; i < 4; i++) {
+    // NaN(zero length octahedral input) maps to 0
+    p[i] = v.v[i] == v.v[i] ? int32_t(v.v[i]) : 0;
   }
 }
+static inline SimdF4 F4LoadFloat(const float *p) {
+  SimdF4 r = {{p[0], p[1], p[2], p[3]}};
+  return r;
+}
+static inline void F4StoreFloat(SimdF4 v, float *p) {
+  for (int i = 0; i < 4; i++) p[i] = v.v[i];
+}
+static inline SimdF4 F4Sqrt(SimdF4 a) {
+  for (int i = 0; i < 4; i++) a.v[i] = std::sqrt(a.v[i]);
+  return a;
+}
+static inline SimdF4 F4Abs(SimdF4 a) {
+  for (int i = 0; i < 4; i++) a.v[i] = std::fabs(a.v[i]);
+  return a;
+}
+static inline SimdF4 F4SelectNonNeg(SimdF4 x, SimdF4 a, SimdF4 b) {
+  SimdF4 r;
+  for (int i = 0; i < 4; i++) r.v[i] = x.v[i] >= 0.0f ? a.v[i] : b.v[i];
+  return r;
+}
+#endif
 
-static void SerializeGltfAnimationChannel(const AnimationChannel &channel,
-                                          detail::json &o) {
-  SerializeNumberProperty("sampler", channel.sampler, o);
-  {
-    detail::json target;
+//
+// Decoded geometry cache.
+//
 
-    if (channel.target_node >= 0) {
-      SerializeNumberProperty("node", channel.target_node, target);
-    }
+#if defined(TINYGLTF_ENABLE_DRACO) || defined(TINYGLTF_ENABLE_MESHOPT)
+// Key of a cache entry: hash of the compressed bytes, mixed with a
+// description of the decode options.
+static uint64_t GeometryCacheKey(const unsigned char *data, size_t size,
+                                 const std::string &options) {
+  return HashBytes64(reinterpret_cast<const unsigned char *>(options.data()),
+                     options.size(), HashBytes64(data, size));
+}
 
-    SerializeStringProperty("path", channel.target_path, target);
+// An entry starts with the identity of the decoded data: the compressed byte
+// length, the length of the decode options and the options. The key is only
+// a hash, so the identity is compared on lookup.
+static void WriteGeometryCacheIdentity(size_t compressed_size,
+                                       const std::string &options,
+                                       std::vector<unsigned char> *entry) {
+  const uint64_t header[2] = {compressed_size, options.size()};
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(header);
+  entry->insert(entry->end(), bytes, bytes + sizeof(header));
+  entry->insert(entry->end(), options.begin(), options.end());
+}
 
-    SerializeExtensionMap(channel.target_extensions, target);
-    SerializeExtras(channel.target_extras, target);
+// Returns the offset of the decoded data in `entry`, 0 when the identity of
+// `entry` does not match.
+static size_t CheckGeometryCacheIdentity(
+    const std::vector<unsigned char> &entry, size_t compressed_size,
+    const std::string &options) {
+  uint64_t header[2];
+  if (entry.size() < sizeof(header)) {
+    return 0;
+  }
+  memcpy(header, entry.data(), sizeof(header));
+  if (header[0] != compressed_size || header[1] != options.size() ||
+      options.size() > entry.size() - sizeof(header) ||
+      !std::equal(options.begin(), options.end(),
+                  entry.begin() + std::ptrdiff_t(sizeof(header)))) {
+    return 0;
+  }
+  return sizeof(header) + options.size();
+}
+#endif
 
-    detail::JsonAddMember(o, "target", std::move(target));
+bool LookupMemoryGeometryCache(uint64_t key, std::vector<unsigned char> *data,
+                               void *user_data) {
+  MemoryGeometryCache *cache = static_cast<MemoryGeometryCache *>(user_data);
+  if (!cache || !data) {
+    return false;
+  }
+  auto it = cache->entries.find(key);
+  if (it == cache->entries.end()) {
+    return false;
   }
+  *data = it->second;
+  return true;
+}
 
-  SerializeExtrasAndExtensions(channel, o);
+void StoreMemoryGeometryCache(uint64_t key,
+                              const std::vector<unsigned char> &data,
+                              void *user_data) {
+  MemoryGeometryCache *cache = static_cast<MemoryGeometryCache *>(user_data);
+  if (!cache || (cache->max_bytes > 0 && data.size() > cache->max_bytes)) {
+    return;
+  }
+  auto it = cache->entries.find(key);
+  if (it != cache->entries.end()) {
+    cache->bytes -= it->second.size();
+    cache->entries.erase(it);
+    cache->order.erase(
+        std::find(cache->order.begin(), cache->order.end(), key));
+  }
+  cache->entries[key] = data;
+  cache->order.push_back(key);
+  cache->bytes += data.size();
+
+  // Evict the oldest entries. The new entry alone fits in `max_bytes`.
+  size_t evicted = 0;
+  while (cache->max_bytes > 0 && cache->bytes > cache->max_bytes) {
+    auto old = cache->entries.find(cache->order[evicted++]);
+    cache->bytes -= old->second.size();
+    cache->entries.erase(old);
+  }
+  cache->order.erase(cache->order.begin(),
+                     cache->order.begin() + std::ptrdiff_t(evicted));
 }
 
-static void SerializeGltfAnimationSampler(const AnimationSampler &sampler,
-                                          detail::json &o) {
-  SerializeNumberProperty("input", sampler.input, o);
-  SerializeNumberProperty("output", sampler.output, o);
-  SerializeStringProperty("interpolation", sampler.interpolation, o);
+#ifndef TINYGLTF_NO_FS
+// A file of the disk cache is a 32 byte header('TGGC', version, key, data
+// size and data hash) followed by the data.
+static const size_t kDiskGeometryCacheHeaderSize = 32;
+static const uint32_t kDiskGeometryCacheVersion = 2;
+
+std::string GetDiskGeometryCachePath(const std::string &directory,
+                                     uint64_t key) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string name(16, '0');
+  for (size_t i = 0; i < 16; i++) {
+    name[15 - i] = kHex[(key >> (4 * i)) & 0xf];
+  }
+  std::string path = directory;
+  if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+    path += '/';
+  }
+  return path + name + ".tgcache";
+}
 
-  SerializeExtrasAndExtensions(sampler, o);
+bool LookupDiskGeometryCache(uint64_t key, std::vector<unsigned char> *data,
+                             void *user_data) {
+  const DiskGeometryCache *cache =
+      static_cast<const DiskGeometryCache *>(user_data);
+  if (!cache || !data) {
+    return false;
+  }
+  const std::string path = GetDiskGeometryCachePath(cache->directory, key);
+  if (!FileExists(path, nullptr)) {
+    return false;
+  }
+  std::vector<unsigned char> file;
+  std::string err;
+  if (!ReadWholeFile(&file, &err, path, nullptr) ||
+      file.size() < kDiskGeometryCacheHeaderSize) {
+    return false;
+  }
+  uint32_t version;
+  uint64_t file_key, size, hash;
+  memcpy(&version, file.data() + 4, sizeof(uint32_t));
+  memcpy(&file_key, file.data() + 8, sizeof(uint64_t));
+  memcpy(&size, file.data() + 16, sizeof(uint64_t));
+  memcpy(&hash, file.data() + 24, sizeof(uint64_t));
+  const unsigned char *payload = file.data() + kDiskGeometryCacheHeaderSize;
+  if (memcmp(file.data(), "TGGC", 4) != 0 ||
+      version != kDiskGeometryCacheVersion || file_key != key ||
+      size != file.size() - kDiskGeometryCacheHeaderSize ||
+      hash != HashBytes64(payload, size_t(size))) {
+    return false;
+  }
+  data->assign(payload, payload + size);
+  return true;
 }
 
-static void SerializeGltfAnimation(const Animation &animation,
-                                   detail::json &o) {
-  if (!animation.name.empty())
-    SerializeStringProperty("name", animation.name, o);
+void StoreDiskGeometryCache(uint64_t key,
+                            const std::vector<unsigned char> &data,
+                            void *user_data) {
+  const DiskGeometryCache *cache =
+      static_cast<const DiskGeometryCache *>(user_data);
+  if (!cache) {
+    return;
+  }
+  std::vector<unsigned char> file(kDiskGeometryCacheHeaderSize);
+  const uint64_t size = data.size();
+  const uint64_t hash = HashBytes64(data.data(), data.size());
+  memcpy(file.data(), "TGGC", 4);
+  memcpy(file.data() + 4, &kDiskGeometryCacheVersion, sizeof(uint32_t));
+  memcpy(file.data() + 8, &key, sizeof(uint64_t));
+  memcpy(file.data() + 16, &size, sizeof(uint64_t));
+  memcpy(file.data() + 24, &hash, sizeof(uint64_t));
+  file.insert(file.end(), data.begin(), data.end());
+  std::string err;
+  WriteWholeFile(&err, GetDiskGeometryCachePath(cache->directory, key), file,
+                 nullptr);
+}
+#endif  // TINYGLTF_NO_FS
 
-  {
-    detail::json channels;
-    detail::JsonReserveArray(channels, animation.channels.size());
-    for (unsigned int i = 0; i < animation.channels.size(); ++i) {
-      detail::json channel;
-      AnimationChannel gltfChannel = animation.channels[i];
-      SerializeGltfAnimationChannel(gltfChannel, channel);
-      detail::JsonPushBack(channels, std::move(channel));
-    }
+#ifdef TINYGLTF_ENABLE_MESHOPT
+//
+// EXT_meshopt_compression decoders. The bitstreams are described in the
+// extension specification:
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Vendor/EXT_meshopt_compression
+//
 
-    detail::JsonAddMember(o, "channels", std::move(channels));
-  }
+static unsigned char MeshoptUnzigzag8(unsigned char v) {
+  return static_cast<unsigned char>((0 - (v & 1)) ^ (v >> 1));
+}
 
-  {
-    detail::json samplers;
-    detail::JsonReserveArray(samplers, animation.samplers.size());
-    for (unsigned int i = 0; i < animation.samplers.size(); ++i) {
-      detail::json sampler;
-      AnimationSampler gltfSampler = animation.samplers[i];
-      SerializeGltfAnimationSampler(gltfSampler, sampler);
-      detail::JsonPushBack(samplers, std::move(sampler));
+static const unsigned char *MeshoptDecodeBytesGroup(const unsigned char *data,
+                                                    unsigned char *buffer,
+                                                    int bitslog2) {
+  if (bitslog2 == 0) {
+    memset(buffer, 0, 16);
+    return data;
+  }
+  if (bitslog2 == 3) {
+    memcpy(buffer, data, 16);
+    return data + 16;
+  }
+
+  // 2 or 4 bit values packed MSB first, followed by the escaped(all bits
+  // set) values as literal bytes.
+  const int bits = bitslog2 == 1 ? 2 : 4;
+  const unsigned int escape = (1u << bits) - 1;
+  const unsigned char *data_var = data + bits * 2;
+  for (int i = 0; i < 16; i++) {
+    const unsigned int byte = data[(i * bits) / 8];
+    const unsigned int enc =
+        (byte >> (8 - bits - ((i * bits) % 8))) & escape;
+    if (enc == escape) {
+      buffer[i] = *data_var++;
+    } else {
+      buffer[i] = static_cast<unsigned char>(enc);
     }
-    detail::JsonAddMember(o, "samplers", std::move(samplers));
   }
-
-  SerializeExtrasAndExtensions(animation, o);
+  return data_var;
 }
 
-static void SerializeGltfAsset(const Asset &asset, detail::json &o) {
-  if (!asset.generator.empty()) {
-    SerializeStringProperty("generator", asset.generator, o);
+static const unsigned char *MeshoptDecodeBytes(const unsigned char *data,
+                                               const unsigned char *data_end,
+                                               unsigned char *buffer,
+                                               size_t buffer_size) {
+  // 2 bit header per group of 16 bytes
+  const size_t header_size = (buffer_size / 16 + 3) / 4;
+  if (size_t(data_end - data) < header_size) {
+    return nullptr;
+  }
+  const unsigned char *header = data;
+  data += header_size;
+
+  for (size_t i = 0; i < buffer_size; i += 16) {
+    // Each group reads at most 16 + 8 bytes; the tail guarantees this for
+    // valid streams.
+    if (size_t(data_end - data) < 24) {
+      return nullptr;
+    }
+    const size_t header_offset = i / 16;
+    const int bitslog2 =
+        (header[header_offset / 4] >> ((header_offset % 4) * 2)) & 3;
+    data = MeshoptDecodeBytesGroup(data, buffer + i, bitslog2);
   }
+  return data;
+}
 
-  if (!asset.copyright.empty()) {
-    SerializeStringProperty("copyright", asset.copyright, o);
+bool DecodeMeshoptVertexBuffer(unsigned char *dst, size_t count,
+                               size_t byte_stride, const unsigned char *src,
+                               size_t src_size) {
+  if (byte_stride == 0 || byte_stride > 256 || (byte_stride % 4) != 0) {
+    return false;
   }
-
-  auto version = asset.version;
-  if (version.empty()) {
-    // Just in case
-    // `version` must be defined
-    version = "2.0";
+  if (src_size < 1 + byte_stride) {
+    return false;
   }
+  const unsigned char *data = src;
+  const unsigned char *data_end = src + src_size;
 
-  // TODO(syoyo): Do we need to check if `version` is greater or equal to 2.0?
-  SerializeStringProperty("version", version, o);
-
-  SerializeExtrasAndExtensions(asset, o);
-}
+  // Only version 0 of the codec is defined by EXT_meshopt_compression.
+  if (*data++ != 0xa0) {
+    return false;
+  }
 
-static void SerializeGltfBufferBin(const Buffer &buffer, detail::json &o,
-                                   std::vector<unsigned char> &binBuffer) {
-  SerializeNumberProperty("byteLength", buffer.data.size(), o);
-  binBuffer = buffer.data;
+  unsigned char last_vertex[256];
+  memcpy(last_vertex, data_end - byte_stride, byte_stride);
 
-  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
+  size_t block_size = (8192 / byte_stride) & ~size_t(15);
+  if (block_size > 256) {
+    block_size = 256;
+  }
 
-  SerializeExtrasAndExtensions(buffer, o);
-}
+  unsigned char buffer[256];
+  std::vector<unsigned char> transposed(block_size * byte_stride);
 
-static void SerializeGltfBuffer(const Buffer &buffer, detail::json &o) {
-  SerializeNumberProperty("byteLength", buffer.data.size(), o);
-  SerializeGltfBufferData(buffer.data, o);
+  for (size_t offset = 0; offset < count; offset += block_size) {
+    const size_t n = std::min(block_size, count - offset);
+    const size_t n_aligned = (n + 15) & ~size_t(15);
 
-  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
+    for (size_t k = 0; k < byte_stride; k++) {
+      data = MeshoptDecodeBytes(data, data_end, buffer, n_aligned);
+      if (!data) {
+        return false;
+      }
+      unsigned char p = last_vertex[k];
+      for (size_t i = 0; i < n; i++) {
+        p = static_cast<unsigned char>(MeshoptUnzigzag8(buffer[i]) + p);
+        transposed[i * byte_stride + k] = p;
+      }
+      last_vertex[k] = p;
+    }
+    memcpy(dst + offset * byte_stride, transposed.data(), n * byte_stride);
+  }
 
-  SerializeExtrasAndExtensions(buffer, o);
+  const size_t tail_size = byte_stride < 32 ? 32 : byte_stride;
+  return size_t(data_end - data) == tail_size;
 }
 
-static bool SerializeGltfBuffer(const Buffer &buffer, detail::json &o,
-                                const std::string &binFilename,
-                                const std::string &binUri) {
-  if (!SerializeGltfBufferData(buffer.data, binFilename)) return false;
-  SerializeNumberProperty("byteLength", buffer.data.size(), o);
-  SerializeStringProperty("uri", binUri, o);
-
-  if (buffer.name.size()) SerializeStringProperty("name", buffer.name, o);
+static unsigned int MeshoptDecodeVByte(const unsigned char *&data) {
+  const unsigned char lead = *data++;
+  if (lead < 128) {
+    return lead;
+  }
+  unsigned int result = lead & 127;
+  unsigned int shift = 7;
+  for (int i = 0; i < 4; i++) {
+    const unsigned char group = *data++;
+    result |= unsigned(group & 127) << shift;
+    shift += 7;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
 
-  SerializeExtrasAndExtensions(buffer, o);
-  return true;
+static unsigned int MeshoptDecodeIndex(const unsigned char *&data,
+                                       unsigned int last) {
+  const unsigned int v = MeshoptDecodeVByte(data);
+  return last + ((v >> 1) ^ (0u - (v & 1)));
 }
 
-static void SerializeGltfBufferView(const BufferView &bufferView,
-                                    detail::json &o) {
-  SerializeNumberProperty("buffer", bufferView.buffer, o);
-  SerializeNumberProperty<size_t>("byteLength", bufferView.byteLength, o);
+static void MeshoptWriteIndex(unsigned char *dst, size_t i, size_t index_size,
+                              unsigned int v) {
+  if (index_size == 2) {
+    const unsigned short s = static_cast<unsigned short>(v);
+    memcpy(dst + i * 2, &s, 2);
+  } else {
+    memcpy(dst + i * 4, &v, 4);
+  }
+}
 
-  // byteStride is optional, minimum allowed is 4
-  if (bufferView.byteStride >= 4) {
-    SerializeNumberProperty<size_t>("byteStride", bufferView.byteStride, o);
+bool DecodeMeshoptIndexBuffer(unsigned char *dst, size_t count,
+                              size_t index_size, const unsigned char *src,
+                              size_t src_size) {
+  if ((count % 3) != 0 || (index_size != 2 && index_size != 4)) {
+    return false;
   }
-  // byteOffset is optional, default is 0
-  if (bufferView.byteOffset > 0) {
-    SerializeNumberProperty<size_t>("byteOffset", bufferView.byteOffset, o);
+  // header, one code byte per triangle and the 16 byte codeaux table
+  if (src_size < 1 + count / 3 + 16) {
+    return false;
   }
-  // Target is optional, check if it contains a valid value
-  if (bufferView.target == TINYGLTF_TARGET_ARRAY_BUFFER ||
-      bufferView.target == TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER) {
-    SerializeNumberProperty("target", bufferView.target, o);
+  if ((src[0] & 0xf0) != 0xe0) {
+    return false;
   }
-  if (bufferView.name.size()) {
-    SerializeStringProperty("name", bufferView.name, o);
+  const int version = src[0] & 0x0f;
+  if (version > 1) {
+    return false;
   }
 
-  SerializeExtrasAndExtensions(bufferView, o);
-}
+  unsigned int edge_fifo[16][2];
+  unsigned int vertex_fifo[16];
+  memset(edge_fifo, -1, sizeof(edge_fifo));
+  memset(vertex_fifo, -1, sizeof(vertex_fifo));
+  size_t edge_offset = 0;
+  size_t vertex_offset = 0;
 
-static void SerializeGltfImage(const Image &image, const std::string &uri,
-                               detail::json &o) {
-  // From 2.7.0, we look for `uri` parameter, not `Image.uri`
-  // if uri is empty, the mimeType and bufferview should be set
-  if (uri.empty()) {
-    SerializeStringProperty("mimeType", image.mimeType, o);
-    SerializeNumberProperty<int>("bufferView", image.bufferView, o);
-  } else {
-    SerializeStringProperty("uri", uri, o);
-  }
+  const auto push_edge = [&](unsigned int a, unsigned int b) {
+    edge_fifo[edge_offset][0] = a;
+    edge_fifo[edge_offset][1] = b;
+    edge_offset = (edge_offset + 1) & 15;
+  };
+  const auto push_vertex = [&](unsigned int v, bool cond) {
+    vertex_fifo[vertex_offset] = v;
+    vertex_offset = (vertex_offset + (cond ? 1 : 0)) & 15;
+  };
 
-  if (image.name.size()) {
-    SerializeStringProperty("name", image.name, o);
-  }
+  unsigned int next = 0;
+  unsigned int last = 0;
+  const int fecmax = version >= 1 ? 13 : 15;
 
-  SerializeExtrasAndExtensions(image, o);
-}
+  const unsigned char *code = src + 1;
+  const unsigned char *data = code + count / 3;
+  const unsigned char *data_safe_end = src + src_size - 16;
+  const unsigned char *codeaux_table = data_safe_end;
 
-static void SerializeGltfTextureInfo(const TextureInfo &texinfo,
-                                     detail::json &o) {
-  SerializeNumberProperty("index", texinfo.index, o);
+  for (size_t i = 0; i < count; i += 3) {
+    // A triangle reads at most 16 bytes of data, which the codeaux table
+    // guarantees to be readable.
+    if (data > data_safe_end) {
+      return false;
+    }
+    const unsigned char codetri = *code++;
+    unsigned int a, b, c;
+
+    if (codetri < 0xf0) {
+      const size_t fe = codetri >> 4;
+      a = edge_fifo[(edge_offset - 1 - fe) & 15][0];
+      b = edge_fifo[(edge_offset - 1 - fe) & 15][1];
+
+      const int fec = codetri & 15;
+      if (fec < fecmax) {
+        c = fec == 0 ? next++
+                     : vertex_fifo[(vertex_offset - 1 - size_t(fec)) & 15];
+        push_vertex(c, fec == 0);
+      } else {
+        // 13, 14 encode -1, +1 deltas(version 1), 15 a free index
+        last = c = fec != 15 ? last + unsigned(fec - (fec ^ 3))
+                             : MeshoptDecodeIndex(data, last);
+        push_vertex(c, true);
+      }
+      push_edge(c, b);
+      push_edge(a, c);
+    } else {
+      int fea, feb, fec;
+      if (codetri < 0xfe) {
+        const unsigned char codeaux = codeaux_table[codetri & 15];
+        fea = 0;
+        feb = codeaux >> 4;
+        fec = codeaux & 15;
+      } else {
+        const unsigned char codeaux = *data++;
+        fea = codetri == 0xfe ? 0 : 15;
+        feb = codeaux >> 4;
+        fec = codeaux & 15;
+        if (codeaux == 0) {
+          next = 0;
+        }
+      }
 
-  if (texinfo.texCoord != 0) {
-    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
+      a = fea == 0 ? next++ : 0;
+      b = feb == 0 ? next++
+                   : vertex_fifo[(vertex_offset - size_t(feb)) & 15];
+      c = fec == 0 ? next++
+                   : vertex_fifo[(vertex_offset - size_t(fec)) & 15];
+      if (fea == 15) {
+        last = a = MeshoptDecodeIndex(data, last);
+      }
+      if (feb == 15) {
+        last = b = MeshoptDecodeIndex(data, last);
+      }
+      if (fec == 15) {
+        last = c = MeshoptDecodeIndex(data, last);
+      }
+
+      push_vertex(a, true);
+      push_vertex(b, feb == 0 || feb == 15);
+      push_vertex(c, fec == 0 || fec == 15);
+      push_edge(b, a);
+      push_edge(c, b);
+      push_edge(a, c);
+    }
+
+    MeshoptWriteIndex(dst, i + 0, index_size, a);
+    MeshoptWriteIndex(dst, i + 1, index_size, b);
+    MeshoptWriteIndex(dst, i + 2, index_size, c);
   }
 
-  SerializeExtrasAndExtensions(texinfo, o);
+  // All data must be consumed up to the codeaux table.
+  return data == data_safe_end;
 }
 
-static void SerializeGltfNormalTextureInfo(const NormalTextureInfo &texinfo,
-                                           detail::json &o) {
-  SerializeNumberProperty("index", texinfo.index, o);
-
-  if (texinfo.texCoord != 0) {
-    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
+bool DecodeMeshoptIndexSequence(unsigned char *dst, size_t count,
+                                size_t index_size, const unsigned char *src,
+                                size_t src_size) {
+  if (index_size != 2 && index_size != 4) {
+    return false;
   }
-
-  if (!TINYGLTF_DOUBLE_EQUAL(texinfo.scale, 1.0)) {
-    SerializeNumberProperty("scale", texinfo.scale, o);
+  // header, at least one byte per index and a 4 byte tail
+  if (src_size < 1 + count + 4) {
+    return false;
+  }
+  if ((src[0] & 0xf0) != 0xd0 || (src[0] & 0x0f) > 1) {
+    return false;
   }
 
-  SerializeExtrasAndExtensions(texinfo, o);
+  const unsigned char *data = src + 1;
+  const unsigned char *data_safe_end = src + src_size - 4;
+  unsigned int last[2] = {0, 0};
+
+  for (size_t i = 0; i < count; i++) {
+    // An index reads at most 5 bytes, which the tail guarantees.
+    if (data >= data_safe_end) {
+      return false;
+    }
+    unsigned int v = MeshoptDecodeVByte(data);
+    const unsigned int current = v & 1;
+    v >>= 1;
+    const unsigned int index = last[current] + ((v >> 1) ^ (0u - (v & 1)));
+    last[current] = index;
+    MeshoptWriteIndex(dst, i, index_size, index);
+  }
+  return data == data_safe_end;
 }
 
-static void SerializeGltfOcclusionTextureInfo(
-    const OcclusionTextureInfo &texinfo, detail::json &o) {
-  SerializeNumberProperty("index", texinfo.index, o);
+// Rounded(away from zero) float to int.
+static inline void F4StoreRound(SimdF4 v, int32_t *p) {
+  F4StoreTrunc(F4Add(v, F4SelectNonNeg(v, F4Set(0.5f), F4Set(-0.5f))), p);
+}
 
-  if (texinfo.texCoord != 0) {
-    SerializeNumberProperty("texCoord", texinfo.texCoord, o);
+template <typename T>
+static void MeshoptFilterOct(T *data, size_t count) {
+  const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+  const SimdF4 zero = F4Set(0.0f);
+  for (size_t i = 0; i < count; i += 4) {
+    const size_t n = std::min(size_t(4), count - i);
+    // unused lanes get a unit vector
+    int32_t cx[4] = {0, 0, 0, 0}, cy[4] = {0, 0, 0, 0}, cz[4] = {1, 1, 1, 1};
+    for (size_t j = 0; j < n; j++) {
+      cx[j] = data[(i + j) * 4 + 0];
+      cy[j] = data[(i + j) * 4 + 1];
+      cz[j] = data[(i + j) * 4 + 2];
+    }
+    SimdF4 x = F4Load(cx);
+    SimdF4 y = F4Load(cy);
+    const SimdF4 z = F4Sub(F4Sub(F4Load(cz), F4Abs(x)), F4Abs(y));
+
+    // fold back the lower hemisphere
+    const SimdF4 t = F4Min(z, zero);
+    x = F4Add(x, F4SelectNonNeg(x, t, F4Sub(zero, t)));
+    y = F4Add(y, F4SelectNonNeg(y, t, F4Sub(zero, t)));
+
+    const SimdF4 l =
+        F4Sqrt(F4Add(F4Add(F4Mul(x, x), F4Mul(y, y)), F4Mul(z, z)));
+    const SimdF4 s = F4Div(F4Set(max), l);
+    F4StoreRound(F4Mul(x, s), cx);
+    F4StoreRound(F4Mul(y, s), cy);
+    F4StoreRound(F4Mul(z, s), cz);
+    for (size_t j = 0; j < n; j++) {
+      data[(i + j) * 4 + 0] = T(cx[j]);
+      data[(i + j) * 4 + 1] = T(cy[j]);
+      data[(i + j) * 4 + 2] = T(cz[j]);
+    }
   }
+}
 
-  if (!TINYGLTF_DOUBLE_EQUAL(texinfo.strength, 1.0)) {
-    SerializeNumberProperty("strength", texinfo.strength, o);
+static void MeshoptFilterQuat(int16_t *data, size_t count) {
+  const float scale = 1.0f / std::sqrt(2.0f);
+  const SimdF4 one = F4Set(1.0f);
+  const SimdF4 qmax = F4Set(32767.0f);
+  for (size_t i = 0; i < count; i += 4) {
+    const size_t n = std::min(size_t(4), count - i);
+    int32_t cx[4] = {0, 0, 0, 0}, cy[4] = {0, 0, 0, 0}, cz[4] = {0, 0, 0, 0},
+            cw[4] = {3, 3, 3, 3};
+    int32_t sf[4] = {3, 3, 3, 3};
+    for (size_t j = 0; j < n; j++) {
+      cx[j] = data[(i + j) * 4 + 0];
+      cy[j] = data[(i + j) * 4 + 1];
+      cz[j] = data[(i + j) * 4 + 2];
+      cw[j] = data[(i + j) * 4 + 3];
+      // the scale is stored in the high bits of the 4th component
+      sf[j] = cw[j] | 3;
+    }
+    const SimdF4 ss = F4Div(F4Set(scale), F4Load(sf));
+    const SimdF4 x = F4Mul(F4Load(cx), ss);
+    const SimdF4 y = F4Mul(F4Load(cy), ss);
+    const SimdF4 z = F4Mul(F4Load(cz), ss);
+    const SimdF4 ww =
+        F4Sub(F4Sub(F4Sub(one, F4Mul(x, x)), F4Mul(y, y)), F4Mul(z, z));
+    const SimdF4 w = F4Sqrt(F4Max(ww, F4Set(0.0f)));
+
+    int32_t qx[4], qy[4], qz[4], qw[4];
+    F4StoreRound(F4Mul(x, qmax), qx);
+    F4StoreRound(F4Mul(y, qmax), qy);
+    F4StoreRound(F4Mul(z, qmax), qz);
+    F4StoreTrunc(F4Add(F4Mul(w, qmax), F4Set(0.5f)), qw);
+    for (size_t j = 0; j < n; j++) {
+      // the 2 low bits of the 4th component select the reconstructed one
+      const size_t qc = size_t(cw[j] & 3);
+      int16_t *q = data + (i + j) * 4;
+      q[(qc + 1) & 3] = int16_t(qx[j]);
+      q[(qc + 2) & 3] = int16_t(qy[j]);
+      q[(qc + 3) & 3] = int16_t(qz[j]);
+      q[qc] = int16_t(qw[j]);
+    }
   }
-
-  SerializeExtrasAndExtensions(texinfo, o);
 }
 
-static void SerializeGltfPbrMetallicRoughness(const PbrMetallicRoughness &pbr,
-                                              detail::json &o) {
-  std::vector<double> default_baseColorFactor = {1.0, 1.0, 1.0, 1.0};
-  if (!Equals(pbr.baseColorFactor, default_baseColorFactor)) {
-    SerializeNumberArrayProperty<double>("baseColorFactor", pbr.baseColorFactor,
-                                         o);
+static void MeshoptFilterExp(uint32_t *data, size_t count) {
+  size_t i = 0;
+#if defined(TINYGLTF_INTERNAL_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    const __m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+    const __m128i e = _mm_srai_epi32(v, 24);
+    const __m128 s = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+    const __m128 r = _mm_mul_ps(s, _mm_cvtepi32_ps(m));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i),
+                     _mm_castps_si128(r));
+  }
+#elif defined(TINYGLTF_INTERNAL_NEON)
+  for (; i + 4 <= count; i += 4) {
+    const int32x4_t v = vreinterpretq_s32_u32(vld1q_u32(data + i));
+    const int32x4_t m = vshrq_n_s32(vshlq_n_s32(v, 8), 8);
+    const int32x4_t e = vshrq_n_s32(v, 24);
+    const float32x4_t s = vreinterpretq_f32_s32(
+        vshlq_n_s32(vaddq_s32(e, vdupq_n_s32(127)), 23));
+    const float32x4_t r = vmulq_f32(s, vcvtq_f32_s32(m));
+    vst1q_u32(data + i, vreinterpretq_u32_f32(r));
   }
-
-  if (!TINYGLTF_DOUBLE_EQUAL(pbr.metallicFactor, 1.0)) {
-    SerializeNumberProperty("metallicFactor", pbr.metallicFactor, o);
+#endif
+  for (; i < count; i++) {
+    const uint32_t v = data[i];
+    // 24 bit signed mantissa, 8 bit signed exponent
+    const int32_t m = int32_t(v << 8) >> 8;
+    const int32_t e = int32_t(v) >> 24;
+    float s;
+    const uint32_t bits = uint32_t(e + 127) << 23;
+    memcpy(&s, &bits, sizeof(float));
+    s *= float(m);
+    memcpy(&data[i], &s, sizeof(float));
   }
+}
 
-  if (!TINYGLTF_DOUBLE_EQUAL(pbr.roughnessFactor, 1.0)) {
-    SerializeNumberProperty("roughnessFactor", pbr.roughnessFactor, o);
+bool ApplyMeshoptFilter(unsigned char *data, size_t count, size_t byte_stride,
+                        const std::string &filter) {
+  if (filter.empty() || filter == "NONE") {
+    return true;
   }
-
-  if (pbr.baseColorTexture.index > -1) {
-    detail::json texinfo;
-    SerializeGltfTextureInfo(pbr.baseColorTexture, texinfo);
-    detail::JsonAddMember(o, "baseColorTexture", std::move(texinfo));
+  if (filter == "OCTAHEDRAL") {
+    if (byte_stride == 4) {
+      MeshoptFilterOct(reinterpret_cast<int8_t *>(data), count);
+      return true;
+    } else if (byte_stride == 8) {
+      MeshoptFilterOct(reinterpret_cast<int16_t *>(data), count);
+      return true;
+    }
+    return false;
   }
-
-  if (pbr.metallicRoughnessTexture.index > -1) {
-    detail::json texinfo;
-    SerializeGltfTextureInfo(pbr.metallicRoughnessTexture, texinfo);
-    detail::JsonAddMember(o, "metallicRoughnessTexture", std::move(texinfo));
+  if (filter == "QUATERNION") {
+    if (byte_stride != 8) {
+      return false;
+    }
+    MeshoptFilterQuat(reinterpret_cast<int16_t *>(data), count);
+    return true;
   }
-
-  SerializeExtrasAndExtensions(pbr, o);
+  if (filter == "EXPONENTIAL") {
+    if ((byte_stride % 4) != 0) {
+      return false;
+    }
+    MeshoptFilterExp(reinterpret_cast<uint32_t *>(data),
+                     count * (byte_stride / 4));
+    return true;
+  }
+  return false;
 }
 
-static void SerializeGltfMaterial(const Material &material, detail::json &o) {
-  if (material.name.size()) {
-    SerializeStringProperty("name", material.name, o);
-  }
+bool DecodeMeshoptCompression(Model *model, std::string *err,
+                              int num_threads,
+                              const GeometryCacheCallbacks *cache) {
+  struct DecodeTask {
+    size_t view;
+    const unsigned char *src;
+    size_t src_size;
+    unsigned char *dst;
+    size_t count;
+    size_t stride;
+    std::string mode;
+    std::string filter;
+    std::string options;  // Cache entry identity
+    uint64_t key;
+    bool cached;
+  };
+  std::vector<DecodeTask> tasks;
 
-  // QUESTION(syoyo): Write material parameters regardless of its default value?
+  const auto get_size = [](const Value &ext, const char *key, size_t *out,
+                           bool required) {
+    if (!ext.Has(key)) {
+      return !required;
+    }
+    const Value &v = ext.Get(key);
+    if (!v.IsNumber() || v.GetNumberAsDouble() < 0.0) {
+      return false;
+    }
+    *out = size_t(v.GetNumberAsDouble());
+    return true;
+  };
 
-  if (!TINYGLTF_DOUBLE_EQUAL(material.alphaCutoff, 0.5)) {
-    SerializeNumberProperty("alphaCutoff", material.alphaCutoff, o);
-  }
+  for (size_t i = 0; i < model->bufferViews.size(); i++) {
+    BufferView &view = model->bufferViews[i];
+    auto it = view.extensions.find("EXT_meshopt_compression");
+    if (it == view.extensions.end()) {
+      continue;
+    }
+    const Value &ext = it->second;
+    std::stringstream prefix;
+    prefix << "bufferView[" << i << "].EXT_meshopt_compression: ";
+
+    DecodeTask task;
+    task.view = i;
+    size_t buffer = 0, byte_offset = 0, byte_length = 0;
+    if (!ext.IsObject() || !get_size(ext, "buffer", &buffer, true) ||
+        !get_size(ext, "byteOffset", &byte_offset, false) ||
+        !get_size(ext, "byteLength", &byte_length, true) ||
+        !get_size(ext, "byteStride", &task.stride, true) ||
+        !get_size(ext, "count", &task.count, true) || !ext.Has("mode") ||
+        !ext.Get("mode").IsString()) {
+      if (err) {
+        (*err) += prefix.str() + "missing or invalid property.\n";
+      }
+      return false;
+    }
+    task.mode = ext.Get("mode").Get<std::string>();
+    if (ext.Has("filter") && ext.Get("filter").IsString()) {
+      task.filter = ext.Get("filter").Get<std::string>();
+    }
 
-  if (material.alphaMode.compare("OPAQUE") != 0) {
-    SerializeStringProperty("alphaMode", material.alphaMode, o);
+    if (buffer >= model->buffers.size() ||
+        byte_offset > model->buffers[buffer].data.size() ||
+        byte_length > model->buffers[buffer].data.size() - byte_offset) {
+      if (err) {
+        (*err) += prefix.str() + "compressed data is out of range.\n";
+      }
+      return false;
+    }
+    task.src = model->buffers[buffer].data.data() + byte_offset;
+    task.src_size = byte_length;
+
+    if (view.buffer < 0 || size_t(view.buffer) >= model->buffers.size() ||
+        task.stride == 0 ||
+        task.count > std::numeric_limits<size_t>::max() / task.stride ||
+        task.count * task.stride > view.byteLength ||
+        view.byteOffset > model->buffers[size_t(view.buffer)].data.size() ||
+        view.byteLength >
+            model->buffers[size_t(view.buffer)].data.size() - view.byteOffset) {
+      if (err) {
+        (*err) += prefix.str() + "decoded data does not fit the bufferView.\n";
+      }
+      return false;
+    }
+    task.dst = model->buffers[size_t(view.buffer)].data.data() + view.byteOffset;
+    task.key = 0;
+    task.cached = false;
+    tasks.push_back(task);
+  }
+
+  const bool use_cache = cache && (cache->Lookup || cache->Store);
+  if (use_cache) {
+    std::vector<unsigned char> data;
+    for (DecodeTask &task : tasks) {
+      std::stringstream options;
+      options << "EXT_meshopt_compression;mode=" << task.mode
+              << ";filter=" << task.filter << ";count=" << task.count
+              << ";byteStride=" << task.stride;
+      task.options = options.str();
+      task.key = GeometryCacheKey(task.src, task.src_size, task.options);
+      if (!cache->Lookup || !cache->Lookup(task.key, &data, cache->user_data)) {
+        continue;
+      }
+      const size_t pos =
+          CheckGeometryCacheIdentity(data, task.src_size, task.options);
+      if (pos > 0 && data.size() - pos == task.count * task.stride) {
+        if (data.size() > pos) {
+          memcpy(task.dst, data.data() + pos, data.size() - pos);
+        }
+        task.cached = true;
+      }
+    }
   }
 
-  if (material.doubleSided != false)
-    detail::JsonAddMember(o, "doubleSided", detail::json(material.doubleSided));
+  std::vector<std::string> errors(tasks.size());
+  detail::ParallelFor(tasks.size(), num_threads, [&](size_t t) {
+    const DecodeTask &task = tasks[t];
+    if (task.cached) {
+      return;
+    }
+    bool ok = false;
+    if (task.mode == "ATTRIBUTES") {
+      ok = DecodeMeshoptVertexBuffer(task.dst, task.count, task.stride,
+                                     task.src, task.src_size);
+    } else if (task.mode == "TRIANGLES") {
+      ok = DecodeMeshoptIndexBuffer(task.dst, task.count, task.stride,
+                                    task.src, task.src_size);
+    } else if (task.mode == "INDICES") {
+      ok = DecodeMeshoptIndexSequence(task.dst, task.count, task.stride,
+                                      task.src, task.src_size);
+    } else {
+      errors[t] = "unknown mode '" + task.mode + "'";
+      return;
+    }
+    if (!ok) {
+      errors[t] = "failed to decode " + task.mode + " data";
+      return;
+    }
+    if (task.mode == "ATTRIBUTES" &&
+        !ApplyMeshoptFilter(task.dst, task.count, task.stride, task.filter)) {
+      errors[t] = "unsupported filter '" + task.filter + "'";
+    }
+  });
 
-  if (material.normalTexture.index > -1) {
-    detail::json texinfo;
-    SerializeGltfNormalTextureInfo(material.normalTexture, texinfo);
-    detail::JsonAddMember(o, "normalTexture", std::move(texinfo));
+  bool success = true;
+  for (size_t t = 0; t < tasks.size(); t++) {
+    if (!errors[t].empty()) {
+      if (err) {
+        std::stringstream ss;
+        ss << "bufferView[" << tasks[t].view
+           << "].EXT_meshopt_compression: " << errors[t] << ".\n";
+        (*err) += ss.str();
+      }
+      success = false;
+    } else if (use_cache && cache->Store && !tasks[t].cached) {
+      const DecodeTask &task = tasks[t];
+      std::vector<unsigned char> data;
+      WriteGeometryCacheIdentity(task.src_size, task.options, &data);
+      data.insert(data.end(), task.dst, task.dst + task.count * task.stride);
+      cache->Store(task.key, data, cache->user_data);
+    }
   }
+  return success;
+}
 
-  if (material.occlusionTexture.index > -1) {
-    detail::json texinfo;
-    SerializeGltfOcclusionTextureInfo(material.occlusionTexture, texinfo);
-    detail::JsonAddMember(o, "occlusionTexture", std::move(texinfo));
+static unsigned char MeshoptZigzag8(unsigned char v) {
+  return static_cast<unsigned char>((static_cast<signed char>(v) >> 7) ^
+                                    (v << 1));
+}
+
+static void MeshoptEncodeVByte(std::vector<unsigned char> *dst,
+                               unsigned int v) {
+  while (v >= 128) {
+    dst->push_back(static_cast<unsigned char>((v & 127) | 128));
+    v >>= 7;
   }
+  dst->push_back(static_cast<unsigned char>(v));
+}
 
-  if (material.emissiveTexture.index > -1) {
-    detail::json texinfo;
-    SerializeGltfTextureInfo(material.emissiveTexture, texinfo);
-    detail::JsonAddMember(o, "emissiveTexture", std::move(texinfo));
+static unsigned int MeshoptReadIndex(const unsigned char *src, size_t i,
+                                     size_t index_size) {
+  if (index_size == 2) {
+    unsigned short s;
+    memcpy(&s, src + i * 2, 2);
+    return s;
   }
+  unsigned int v;
+  memcpy(&v, src + i * 4, 4);
+  return v;
+}
 
-  std::vector<double> default_emissiveFactor = {0.0, 0.0, 0.0};
-  if (!Equals(material.emissiveFactor, default_emissiveFactor)) {
-    SerializeNumberArrayProperty<double>("emissiveFactor",
-                                         material.emissiveFactor, o);
+// Appends the smallest encoding of 16 bytes and returns its mode.
+static int MeshoptEncodeBytesGroup(std::vector<unsigned char> *dst,
+                                   const unsigned char *buffer) {
+  size_t sizes[4] = {0, 4, 8, 16};
+  for (int i = 0; i < 16; i++) {
+    if (buffer[i] != 0) {
+      sizes[0] = 17;
+    }
+    sizes[1] += buffer[i] >= 3 ? 1 : 0;
+    sizes[2] += buffer[i] >= 15 ? 1 : 0;
+  }
+  int bitslog2 = 0;
+  for (int b = 1; b < 4; b++) {
+    if (sizes[b] < sizes[bitslog2]) {
+      bitslog2 = b;
+    }
   }
 
-  {
-    detail::json pbrMetallicRoughness;
-    SerializeGltfPbrMetallicRoughness(material.pbrMetallicRoughness,
-                                      pbrMetallicRoughness);
-    // Issue 204
-    // Do not serialize `pbrMetallicRoughness` if pbrMetallicRoughness has all
-    // default values(json is null). Otherwise it will serialize to
-    // `pbrMetallicRoughness : null`, which cannot be read by other glTF
-    // importers (and validators).
-    //
-    if (!detail::JsonIsNull(pbrMetallicRoughness)) {
-      detail::JsonAddMember(o, "pbrMetallicRoughness",
-                            std::move(pbrMetallicRoughness));
+  if (bitslog2 == 3) {
+    dst->insert(dst->end(), buffer, buffer + 16);
+  } else if (bitslog2 != 0) {
+    const int bits = bitslog2 == 1 ? 2 : 4;
+    const unsigned int escape = (1u << bits) - 1;
+    const size_t packed = dst->size();
+    dst->resize(packed + size_t(bits) * 2, 0);
+    for (int i = 0; i < 16; i++) {
+      const unsigned int enc = (std::min)(unsigned(buffer[i]), escape);
+      (*dst)[packed + size_t((i * bits) / 8)] |= static_cast<unsigned char>(
+          enc << (8 - bits - ((i * bits) % 8)));
+    }
+    for (int i = 0; i < 16; i++) {
+      if (buffer[i] >= escape) {
+        dst->push_back(buffer[i]);
+      }
     }
   }
+  return bitslog2;
+}
 
-#if 0  // legacy way. just for the record.
-  if (material.values.size()) {
-    detail::json pbrMetallicRoughness;
-    SerializeParameterMap(material.values, pbrMetallicRoughness);
-    detail::JsonAddMember(o, "pbrMetallicRoughness", std::move(pbrMetallicRoughness));
+bool EncodeMeshoptVertexBuffer(std::vector<unsigned char> *dst,
+                               const unsigned char *src, size_t count,
+                               size_t byte_stride) {
+  if (!dst || byte_stride == 0 || byte_stride > 256 ||
+      (byte_stride % 4) != 0 || (count > 0 && !src)) {
+    return false;
   }
+  dst->push_back(0xa0);
 
-  SerializeParameterMap(material.additionalValues, o);
-#endif
+  // The first vertex is the baseline.
+  unsigned char last_vertex[256] = {};
+  if (count > 0) {
+    memcpy(last_vertex, src, byte_stride);
+  }
+  unsigned char baseline[256];
+  memcpy(baseline, last_vertex, byte_stride);
 
-  SerializeExtrasAndExtensions(material, o);
+  size_t block_size = (8192 / byte_stride) & ~size_t(15);
+  if (block_size > 256) {
+    block_size = 256;
+  }
 
-  // MSFT_lod
-  if (!material.lods.empty()) {
-    detail::json_iterator it;
-    if (!detail::FindMember(o, "extensions", it)) {
-      detail::json extensions;
-      detail::JsonSetObject(extensions);
-      detail::JsonAddMember(o, "extensions", std::move(extensions));
-      detail::FindMember(o, "extensions", it);
-    }
-    auto &extensions = detail::GetValue(it);
-    if (!detail::FindMember(extensions, "MSFT_lod", it)) {
-      detail::json lod;
-      detail::JsonSetObject(lod);
-      detail::JsonAddMember(extensions, "MSFT_lod", std::move(lod));
-      detail::FindMember(extensions, "MSFT_lod", it);
-    }
-    SerializeNumberArrayProperty<int>("ids", material.lods, detail::GetValue(it));
-  } else {
-    detail::json_iterator ext_it;
-    if (detail::FindMember(o, "extensions", ext_it)) {
-      auto &extensions = detail::GetValue(ext_it);
-      detail::json_iterator lp_it;
-      if (detail::FindMember(extensions, "MSFT_lod", lp_it)) {
-        detail::Erase(extensions, lp_it);
+  unsigned char buffer[256];
+  for (size_t offset = 0; offset < count; offset += block_size) {
+    const size_t n = std::min(block_size, count - offset);
+    const size_t n_aligned = (n + 15) & ~size_t(15);
+    const unsigned char *block = src + offset * byte_stride;
+
+    for (size_t k = 0; k < byte_stride; k++) {
+      unsigned char p = last_vertex[k];
+      for (size_t i = 0; i < n; i++) {
+        const unsigned char v = block[i * byte_stride + k];
+        buffer[i] = MeshoptZigzag8(static_cast<unsigned char>(v - p));
+        p = v;
       }
-      if (detail::IsEmpty(extensions)) {
-        detail::Erase(o, ext_it);
+      memset(buffer + n, 0, n_aligned - n);
+
+      const size_t header = dst->size();
+      const size_t header_size = (n_aligned / 16 + 3) / 4;
+      dst->resize(header + header_size, 0);
+      for (size_t g = 0; g < n_aligned / 16; g++) {
+        const int bitslog2 = MeshoptEncodeBytesGroup(dst, buffer + g * 16);
+        (*dst)[header + g / 4] |=
+            static_cast<unsigned char>(bitslog2 << ((g % 4) * 2));
       }
     }
+    memcpy(last_vertex, block + (n - 1) * byte_stride, byte_stride);
   }
+
+  // The tail is padded so that the decoder can read groups without bounds
+  // checks, and ends with the baseline vertex.
+  const size_t tail_size = byte_stride < 32 ? 32 : byte_stride;
+  dst->resize(dst->size() + tail_size - byte_stride, 0);
+  dst->insert(dst->end(), baseline, baseline + byte_stride);
+  return true;
 }
 
-static void SerializeGltfMesh(const Mesh &mesh, detail::json &o) {
-  detail::json primitives;
-  detail::JsonReserveArray(primitives, mesh.primitives.size());
-  for (unsigned int i = 0; i < mesh.primitives.size(); ++i) {
-    detail::json primitive;
-    const Primitive &gltfPrimitive = mesh.primitives[i];  // don't make a copy
-    {
-      detail::json attributes;
-      for (auto attrIt = gltfPrimitive.attributes.begin();
-           attrIt != gltfPrimitive.attributes.end(); ++attrIt) {
-        SerializeNumberProperty<int>(attrIt->first, attrIt->second, attributes);
+bool EncodeMeshoptIndexBuffer(std::vector<unsigned char> *dst,
+                              const unsigned char *src, size_t count,
+                              size_t index_size) {
+  if (!dst || (count % 3) != 0 || (index_size != 2 && index_size != 4) ||
+      (count > 0 && !src)) {
+    return false;
+  }
+  // codeaux values(feb << 4 | fec) of triangles with two or three new
+  // vertices, referenced by codes 0xf0-0xfd.
+  static const unsigned char kCodeAuxTable[16] = {
+      0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86,
+      0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00};
+
+  unsigned int edge_fifo[16][2];
+  unsigned int vertex_fifo[16];
+  memset(edge_fifo, -1, sizeof(edge_fifo));
+  memset(vertex_fifo, -1, sizeof(vertex_fifo));
+  size_t edge_offset = 0;
+  size_t vertex_offset = 0;
+
+  const auto push_edge = [&](unsigned int a, unsigned int b) {
+    edge_fifo[edge_offset][0] = a;
+    edge_fifo[edge_offset][1] = b;
+    edge_offset = (edge_offset + 1) & 15;
+  };
+  const auto push_vertex = [&](unsigned int v, bool cond) {
+    vertex_fifo[vertex_offset] = v;
+    vertex_offset = (vertex_offset + (cond ? 1 : 0)) & 15;
+  };
+  // Returns i where vertex_fifo[(vertex_offset - 1 - i) & 15] == v, or -1.
+  const auto find_vertex = [&](unsigned int v) {
+    for (int i = 0; i < 16; i++) {
+      if (vertex_fifo[(vertex_offset - 1 - size_t(i)) & 15] == v) {
+        return i;
       }
+    }
+    return -1;
+  };
 
-      detail::JsonAddMember(primitive, "attributes", std::move(attributes));
+  unsigned int next = 0;
+  unsigned int last = 0;
+  const int fecmax = 13;  // version 1
+
+  std::vector<unsigned char> codes;
+  std::vector<unsigned char> data;
+  codes.reserve(count / 3);
+
+  const auto encode_free = [&](unsigned int v) {
+    const unsigned int d = v - last;
+    MeshoptEncodeVByte(&data, (d << 1) ^ (0u - (d >> 31)));
+    last = v;
+  };
+
+  const auto find_edge = [&](unsigned int a, unsigned int b) {
+    for (int e = 0; e < 15; e++) {
+      const size_t idx = (edge_offset - 1 - size_t(e)) & 15;
+      if (edge_fifo[idx][0] == a && edge_fifo[idx][1] == b) {
+        return e;
+      }
     }
+    return -1;
+  };
 
-    // Indices is optional
-    if (gltfPrimitive.indices > -1) {
-      SerializeNumberProperty<int>("indices", gltfPrimitive.indices, primitive);
+  for (size_t i = 0; i < count; i += 3) {
+    const unsigned int tri[3] = {MeshoptReadIndex(src, i + 0, index_size),
+                                 MeshoptReadIndex(src, i + 1, index_size),
+                                 MeshoptReadIndex(src, i + 2, index_size)};
+
+    // Rotate the triangle(keeping the winding) so that an edge is in the
+    // edge fifo and the third vertex is cheap to encode, or otherwise so that
+    // the first vertex is the next new one.
+    int rotation = 0;
+    int best = 4;
+    for (int r = 0; r < 3; r++) {
+      const unsigned int ra = tri[r], rb = tri[(r + 1) % 3],
+                         rc = tri[(r + 2) % 3];
+      int cost = 4;
+      if (find_edge(ra, rb) >= 0) {
+        const int fc = find_vertex(rc);
+        cost = (rc == next || (fc >= 1 && fc < fecmax))
+                   ? 0
+                   : ((rc == last - 1 || rc == last + 1) ? 1 : 2);
+      } else if (ra == next) {
+        cost = 3;
+      }
+      if (cost < best) {
+        best = cost;
+        rotation = r;
+      }
     }
-    // Material is optional
-    if (gltfPrimitive.material > -1) {
-      SerializeNumberProperty<int>("material", gltfPrimitive.material,
-                                   primitive);
+    const unsigned int a = tri[rotation];
+    const unsigned int b = tri[(rotation + 1) % 3];
+    const unsigned int c = tri[(rotation + 2) % 3];
+
+    const int fe = find_edge(a, b);
+
+    if (fe >= 0) {
+      const int fc = find_vertex(c);
+      int fec;
+      if (c == next) {
+        fec = 0;
+        next++;
+        push_vertex(c, true);
+      } else if (fc >= 1 && fc < fecmax) {
+        fec = fc;
+        push_vertex(c, false);
+      } else {
+        if (c == last - 1) {
+          fec = 13;
+          last = c;
+        } else if (c == last + 1) {
+          fec = 14;
+          last = c;
+        } else {
+          fec = 15;
+          encode_free(c);
+        }
+        push_vertex(c, true);
+      }
+      codes.push_back(static_cast<unsigned char>((fe << 4) | fec));
+      push_edge(c, b);
+      push_edge(a, c);
+      continue;
     }
-    SerializeNumberProperty<int>("mode", gltfPrimitive.mode, primitive);
 
-    // Morph targets
-    if (gltfPrimitive.targets.size()) {
-      detail::json targets;
-      detail::JsonReserveArray(targets, gltfPrimitive.targets.size());
-      for (unsigned int k = 0; k < gltfPrimitive.targets.size(); ++k) {
-        detail::json targetAttributes;
-        std::map<std::string, int> targetData = gltfPrimitive.targets[k];
-        for (std::map<std::string, int>::iterator attrIt = targetData.begin();
-             attrIt != targetData.end(); ++attrIt) {
-          SerializeNumberProperty<int>(attrIt->first, attrIt->second,
-                                       targetAttributes);
+    // a, b and c are each the next new vertex(0), in the vertex fifo(1-14)
+    // or a free index(15).
+    unsigned int n = next;
+    const int fea = a == n ? 0 : 15;
+    n += fea == 0 ? 1 : 0;
+    int feb;
+    const int fb = find_vertex(b);
+    // codeaux 0 resets `next` in the 0xff path.
+    if (b == n && fea == 0) {
+      feb = 0;
+      n++;
+    } else if (fb >= 0 && fb < 14) {
+      feb = fb + 1;
+    } else {
+      feb = 15;
+    }
+    int fec;
+    const int fc = find_vertex(c);
+    if (c == n) {
+      fec = 0;
+      n++;
+    } else if (fc >= 0 && fc < 14) {
+      fec = fc + 1;
+    } else {
+      fec = 15;
+    }
+    next = n;
+
+    const unsigned char codeaux = static_cast<unsigned char>((feb << 4) | fec);
+    int table = -1;
+    if (fea == 0) {
+      for (int t = 0; t < 14; t++) {
+        if (kCodeAuxTable[t] == codeaux) {
+          table = t;
+          break;
         }
-        detail::JsonPushBack(targets, std::move(targetAttributes));
       }
-      detail::JsonAddMember(primitive, "targets", std::move(targets));
+    }
+    if (table >= 0) {
+      codes.push_back(static_cast<unsigned char>(0xf0 | table));
+    } else {
+      codes.push_back(fea == 0 ? 0xfe : 0xff);
+      data.push_back(codeaux);
+    }
+    if (fea == 15) {
+      encode_free(a);
+    }
+    if (feb == 15) {
+      encode_free(b);
+    }
+    if (fec == 15) {
+      encode_free(c);
     }
 
-    SerializeExtrasAndExtensions(gltfPrimitive, primitive);
-
-    detail::JsonPushBack(primitives, std::move(primitive));
+    push_vertex(a, true);
+    push_vertex(b, feb == 0 || feb == 15);
+    push_vertex(c, fec == 0 || fec == 15);
+    push_edge(b, a);
+    push_edge(c, b);
+    push_edge(a, c);
   }
 
-  detail::JsonAddMember(o, "primitives", std::move(primitives));
+  dst->push_back(0xe1);
+  dst->insert(dst->end(), codes.begin(), codes.end());
+  dst->insert(dst->end(), data.begin(), data.end());
+  dst->insert(dst->end(), kCodeAuxTable, kCodeAuxTable + 16);
+  return true;
+}
 
-  if (mesh.weights.size()) {
-    SerializeNumberArrayProperty<double>("weights", mesh.weights, o);
+bool EncodeMeshoptIndexSequence(std::vector<unsigned char> *dst,
+                                const unsigned char *src, size_t count,
+                                size_t index_size) {
+  if (!dst || (index_size != 2 && index_size != 4) || (count > 0 && !src)) {
+    return false;
   }
-
-  if (mesh.name.size()) {
-    SerializeStringProperty("name", mesh.name, o);
+  const size_t begin = dst->size();
+  dst->push_back(0xd1);
+  unsigned int last[2] = {0, 0};
+  for (size_t i = 0; i < count; i++) {
+    const unsigned int index = MeshoptReadIndex(src, i, index_size);
+    unsigned int zz[2];
+    for (int b = 0; b < 2; b++) {
+      const unsigned int d = index - last[b];
+      zz[b] = (d << 1) ^ (0u - (d >> 31));
+    }
+    // delta from the closer of the two baselines
+    const unsigned int current = zz[1] < zz[0] ? 1 : 0;
+    if (zz[current] >= (1u << 31)) {
+      dst->resize(begin);
+      return false;
+    }
+    MeshoptEncodeVByte(dst, (zz[current] << 1) | current);
+    last[current] = index;
   }
-
-  SerializeExtrasAndExtensions(mesh, o);
+  dst->resize(dst->size() + 4, 0);
+  return true;
 }
 
-static void SerializeSpotLight(const SpotLight &spot, detail::json &o) {
-  SerializeNumberProperty("innerConeAngle", spot.innerConeAngle, o);
-  SerializeNumberProperty("outerConeAngle", spot.outerConeAngle, o);
-  SerializeExtrasAndExtensions(spot, o);
+static int MeshoptQuantizeSnorm(float v, int max) {
+  v = (std::max)(-1.0f, (std::min)(1.0f, v));
+  return int(v * float(max) + (v >= 0.0f ? 0.5f : -0.5f));
 }
 
-static void SerializeGltfLight(const Light &light, detail::json &o) {
-  if (!light.name.empty()) SerializeStringProperty("name", light.name, o);
-  SerializeNumberProperty("intensity", light.intensity, o);
-  if (light.range > 0.0) {
-    SerializeNumberProperty("range", light.range, o);
-  }
-  SerializeNumberArrayProperty("color", light.color, o);
-  SerializeStringProperty("type", light.type, o);
-  if (light.type == "spot") {
-    detail::json spot;
-    SerializeSpotLight(light.spot, spot);
-    detail::JsonAddMember(o, "spot", std::move(spot));
+template <typename T>
+static void MeshoptEncodeOct(T *data, size_t count) {
+  const int max = (1 << (sizeof(T) * 8 - 1)) - 1;
+  for (size_t i = 0; i < count; i++) {
+    T *n = data + i * 4;
+    float nx = float(n[0]), ny = float(n[1]);
+    const float nz = float(n[2]);
+    const float nl = std::fabs(nx) + std::fabs(ny) + std::fabs(nz);
+    const float ns = nl == 0.0f ? 0.0f : 1.0f / nl;
+    nx *= ns;
+    ny *= ns;
+    const float u =
+        nz >= 0.0f ? nx : (1.0f - std::fabs(ny)) * (nx >= 0.0f ? 1.0f : -1.0f);
+    const float v =
+        nz >= 0.0f ? ny : (1.0f - std::fabs(nx)) * (ny >= 0.0f ? 1.0f : -1.0f);
+    // the 4th component(padding or tangent sign) is kept as is
+    n[0] = T(MeshoptQuantizeSnorm(u, max));
+    n[1] = T(MeshoptQuantizeSnorm(v, max));
+    n[2] = T(max);
   }
-  SerializeExtrasAndExtensions(light, o);
 }
 
-static void SerializeGltfPositionalEmitter(const PositionalEmitter &positional,
-                                           detail::json &o) {
-  if (!TINYGLTF_DOUBLE_EQUAL(positional.coneInnerAngle, 6.283185307179586))
-    SerializeNumberProperty("coneInnerAngle", positional.coneInnerAngle, o);
-  if (!TINYGLTF_DOUBLE_EQUAL(positional.coneOuterAngle, 6.283185307179586))
-    SerializeNumberProperty("coneOuterAngle", positional.coneOuterAngle, o);
-  if (positional.coneOuterGain > 0.0)
-    SerializeNumberProperty("coneOuterGain", positional.coneOuterGain, o);
-  if (!TINYGLTF_DOUBLE_EQUAL(positional.maxDistance, 100.0))
-    SerializeNumberProperty("maxDistance", positional.maxDistance, o);
-  if (!TINYGLTF_DOUBLE_EQUAL(positional.refDistance, 1.0))
-    SerializeNumberProperty("refDistance", positional.refDistance, o);
-  if (!TINYGLTF_DOUBLE_EQUAL(positional.rolloffFactor, 1.0))
-    SerializeNumberProperty("rolloffFactor", positional.rolloffFactor, o);
+static void MeshoptEncodeQuat(int16_t *data, size_t count) {
+  const float scaler = std::sqrt(2.0f);
+  const int max = 32767;
+  for (size_t i = 0; i < count; i++) {
+    int16_t *d = data + i * 4;
+    float q[4];
+    float l = 0.0f;
+    for (int c = 0; c < 4; c++) {
+      q[c] = float(d[c]);
+      l += q[c] * q[c];
+    }
+    l = l > 0.0f ? 1.0f / std::sqrt(l) : 0.0f;
+    int qc = 0;
+    for (int c = 0; c < 4; c++) {
+      q[c] *= l;
+      if (std::fabs(q[c]) > std::fabs(q[qc])) {
+        qc = c;
+      }
+    }
+    // q and -q are the same rotation: the largest component is positive and
+    // the others fit in [-1/sqrt(2), 1/sqrt(2)].
+    const float sign = q[qc] < 0.0f ? -1.0f : 1.0f;
+    d[0] = int16_t(MeshoptQuantizeSnorm(q[(qc + 1) & 3] * scaler * sign, max));
+    d[1] = int16_t(MeshoptQuantizeSnorm(q[(qc + 2) & 3] * scaler * sign, max));
+    d[2] = int16_t(MeshoptQuantizeSnorm(q[(qc + 3) & 3] * scaler * sign, max));
+    d[3] = int16_t((max & ~3) | qc);
+  }
+}
 
-  SerializeExtrasAndExtensions(positional, o);
+static void MeshoptEncodeExp(uint32_t *data, size_t count, int bits) {
+  const int mmax = (1 << (bits - 1)) - 1;
+  for (size_t i = 0; i < count; i++) {
+    float v;
+    memcpy(&v, &data[i], sizeof(float));
+    if (!std::isfinite(v)) {
+      v = 0.0f;
+    }
+    int e = 0;
+    std::frexp(v, &e);
+    // v = m * 2^exp with |m| <= mmax
+    int exp = (std::max)(-100, e - (bits - 1));
+    double m = std::round(std::ldexp(double(v), -exp));
+    if (std::fabs(m) > double(mmax)) {
+      exp++;
+      m = std::round(std::ldexp(double(v), -exp));
+    }
+    data[i] = (uint32_t(exp) << 24) | (uint32_t(int32_t(m)) & 0xffffff);
+  }
 }
 
-static void SerializeGltfAudioEmitter(const AudioEmitter &emitter,
-                                      detail::json &o) {
-  if (!emitter.name.empty()) SerializeStringProperty("name", emitter.name, o);
-  if (!TINYGLTF_DOUBLE_EQUAL(emitter.gain, 1.0))
-    SerializeNumberProperty("gain", emitter.gain, o);
-  if (emitter.loop) SerializeNumberProperty("loop", emitter.loop, o);
-  if (emitter.playing) SerializeNumberProperty("playing", emitter.playing, o);
-  if (!emitter.type.empty()) SerializeStringProperty("type", emitter.type, o);
-  if (!emitter.distanceModel.empty())
-    SerializeStringProperty("distanceModel", emitter.distanceModel, o);
-  if (emitter.type == "positional") {
-    detail::json positional;
-    SerializeGltfPositionalEmitter(emitter.positional, positional);
-    detail::JsonAddMember(o, "positional", std::move(positional));
+bool EncodeMeshoptFilter(unsigned char *data, size_t count, size_t byte_stride,
+                         const std::string &filter, int exponential_bits) {
+  if (filter.empty() || filter == "NONE") {
+    return true;
   }
-  SerializeNumberProperty("source", emitter.source, o);
-  SerializeExtrasAndExtensions(emitter, o);
+  if (filter == "OCTAHEDRAL") {
+    if (byte_stride == 4) {
+      MeshoptEncodeOct(reinterpret_cast<int8_t *>(data), count);
+      return true;
+    } else if (byte_stride == 8) {
+      MeshoptEncodeOct(reinterpret_cast<int16_t *>(data), count);
+      return true;
+    }
+    return false;
+  }
+  if (filter == "QUATERNION") {
+    if (byte_stride != 8) {
+      return false;
+    }
+    MeshoptEncodeQuat(reinterpret_cast<int16_t *>(data), count);
+    return true;
+  }
+  if (filter == "EXPONENTIAL") {
+    if ((byte_stride % 4) != 0 || exponential_bits < 1 ||
+        exponential_bits > 24) {
+      return false;
+    }
+    MeshoptEncodeExp(reinterpret_cast<uint32_t *>(data),
+                     count * (byte_stride / 4), exponential_bits);
+    return true;
+  }
+  return false;
 }
 
-static void SerializeGltfAudioSource(const AudioSource &source,
-                                     detail::json &o) {
-  std::string name;
-  std::string uri;
-  std::string mimeType;  // (required if no uri) ["audio/mp3", "audio/ogg",
-                         // "audio/wav", "audio/m4a"]
+bool EncodeMeshoptCompression(Model *model,
+                              const MeshoptEncodeOptions &options,
+                              std::string *err, MeshoptEncodeReport *report) {
+  const char *kExtension = "EXT_meshopt_compression";
+  if (options.exponential_bits < 0 || options.exponential_bits > 24) {
+    if (err) {
+      (*err) += "exponential_bits must be in [0, 24].\n";
+    }
+    return false;
+  }
 
-  if (!source.name.empty()) SerializeStringProperty("name", source.name, o);
-  if (source.uri.empty()) {
-    SerializeStringProperty("mimeType", source.mimeType, o);
-    SerializeNumberProperty<int>("bufferView", source.bufferView, o);
-  } else {
-    SerializeStringProperty("uri", source.uri, o);
+  // Bytes and buffers this pass moves to the fallback buffer are reclaimed
+  // afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+
+  // How accessors are used.
+  const unsigned char kIndex = 1;
+  const unsigned char kNonTriangleIndex = 2;
+  const unsigned char kVertex = 4;
+  const unsigned char kDirection = 8;  // NORMAL/TANGENT
+  const unsigned char kMorph = 16;
+  const unsigned char kRotation = 32;  // rotation animation output
+  std::vector<unsigned char> roles(model->accessors.size(), 0);
+  const auto mark = [&](int idx, unsigned char role) {
+    if (idx >= 0 && size_t(idx) < roles.size()) {
+      roles[size_t(idx)] |= role;
+    }
+  };
+
+  // bufferViews which must not be compressed
+  std::vector<bool> excluded(model->bufferViews.size(), false);
+  const auto exclude = [&](int idx) {
+    if (idx >= 0 && size_t(idx) < excluded.size()) {
+      excluded[size_t(idx)] = true;
+    }
+  };
+
+  for (const Mesh &mesh : model->meshes) {
+    for (const Primitive &primitive : mesh.primitives) {
+      const bool triangles = primitive.mode == TINYGLTF_MODE_TRIANGLES ||
+                             primitive.mode == -1;
+      mark(primitive.indices,
+           triangles ? kIndex : (kIndex | kNonTriangleIndex));
+      for (const auto &attrib : primitive.attributes) {
+        const bool direction =
+            attrib.first == "NORMAL" || attrib.first == "TANGENT";
+        mark(attrib.second, direction ? (kVertex | kDirection) : kVertex);
+      }
+      for (const auto &target : primitive.targets) {
+        for (const auto &attrib : target) {
+          mark(attrib.second, kVertex | kMorph);
+        }
+      }
+      auto draco = primitive.extensions.find("KHR_draco_mesh_compression");
+      if (draco != primitive.extensions.end()) {
+        exclude(ExtensionIndex(draco->second, "bufferView"));
+      }
+      auto meshlets = primitive.extensions.find(kMeshletExtension);
+      if (meshlets != primitive.extensions.end()) {
+        for (const char *key : kMeshletViews) {
+          exclude(ExtensionIndex(meshlets->second, key));
+        }
+      }
+    }
+  }
+  for (const Animation &animation : model->animations) {
+    for (const AnimationChannel &channel : animation.channels) {
+      if (channel.target_path == "rotation" && channel.sampler >= 0 &&
+          size_t(channel.sampler) < animation.samplers.size()) {
+        mark(animation.samplers[size_t(channel.sampler)].output, kRotation);
+      }
+    }
+  }
+  for (const Image &image : model->images) {
+    exclude(image.bufferView);
   }
-  SerializeExtrasAndExtensions(source, o);
-}
 
-static void SerializeGltfNode(const Node &node, detail::json &o) {
-  if (node.translation.size() > 0) {
-    SerializeNumberArrayProperty<double>("translation", node.translation, o);
+  std::vector<std::vector<size_t>> view_accessors(model->bufferViews.size());
+  for (size_t i = 0; i < model->accessors.size(); i++) {
+    const Accessor &accessor = model->accessors[i];
+    if (accessor.sparse.isSparse) {
+      exclude(accessor.sparse.indices.bufferView);
+      exclude(accessor.sparse.values.bufferView);
+    }
+    if (accessor.bufferView >= 0 &&
+        size_t(accessor.bufferView) < view_accessors.size()) {
+      view_accessors[size_t(accessor.bufferView)].push_back(i);
+    }
   }
-  if (node.rotation.size() > 0) {
-    SerializeNumberArrayProperty<double>("rotation", node.rotation, o);
+
+  struct EncodeTask {
+    size_t view;
+    size_t count;
+    size_t stride;
+    std::string mode;
+    std::string filter;
+    std::vector<unsigned char> stream;
+    std::vector<unsigned char> decoded;  // filtered data, as decoded
+    bool ok;
+  };
+  std::vector<EncodeTask> tasks;
+
+  for (size_t v = 0; v < model->bufferViews.size(); v++) {
+    const BufferView &view = model->bufferViews[v];
+    const std::vector<size_t> &accessors = view_accessors[v];
+    if (excluded[v] || accessors.empty() ||
+        view.extensions.count(kExtension) ||
+        view.extensions.count("KHR_meshopt_compression") || view.buffer < 0 ||
+        size_t(view.buffer) >= model->buffers.size()) {
+      continue;
+    }
+    const Buffer &buffer = model->buffers[size_t(view.buffer)];
+    if (view.byteOffset > buffer.data.size() ||
+        view.byteLength > buffer.data.size() - view.byteOffset ||
+        view.byteLength == 0) {
+      continue;
+    }
+
+    size_t num_index = 0;
+    bool triangles = true;
+    size_t elem_size = 0;
+    bool same_size = true;
+    for (size_t a : accessors) {
+      const Accessor &accessor = model->accessors[a];
+      num_index += (roles[a] & kIndex) ? 1 : 0;
+      triangles = triangles && !(roles[a] & kNonTriangleIndex);
+      const int32_t component_size =
+          GetComponentSizeInBytes(uint32_t(accessor.componentType));
+      const int32_t num_components =
+          GetNumComponentsInType(uint32_t(accessor.type));
+      if (component_size <= 0 || num_components <= 0) {
+        same_size = false;
+        break;
+      }
+      const size_t size = size_t(component_size) * size_t(num_components);
+      same_size = same_size && (elem_size == 0 || elem_size == size);
+      elem_size = size;
+    }
+    if (!same_size && view.byteStride == 0) {
+      continue;
+    }
+
+    EncodeTask task;
+    task.view = v;
+    task.ok = false;
+    if (num_index > 0) {
+      // index views are compressed only when used as indices alone
+      if (num_index != accessors.size() || !options.compress_indices ||
+          (elem_size != 2 && elem_size != 4) || !same_size) {
+        continue;
+      }
+      task.stride = elem_size;
+      if ((view.byteLength % task.stride) != 0) {
+        continue;
+      }
+      task.count = view.byteLength / task.stride;
+      task.mode =
+          (triangles && (task.count % 3) == 0) ? "TRIANGLES" : "INDICES";
+    } else {
+      if (!options.compress_attributes) {
+        continue;
+      }
+      task.stride = view.byteStride > 0 ? view.byteStride : elem_size;
+      if ((task.stride % 4) != 0 || task.stride > 256 ||
+          (view.byteLength % task.stride) != 0) {
+        continue;
+      }
+      task.count = view.byteLength / task.stride;
+
+      bool oct = options.octahedral_filter;
+      bool quat = options.quaternion_filter;
+      bool exp = options.exponential_bits > 0;
+      for (size_t a : accessors) {
+        const Accessor &accessor = model->accessors[a];
+        const bool aligned = (accessor.byteOffset % task.stride) == 0;
+        oct = oct && aligned && accessor.normalized &&
+              (roles[a] & kDirection) && !(roles[a] & kMorph) &&
+              (accessor.type == TINYGLTF_TYPE_VEC3 ||
+               accessor.type == TINYGLTF_TYPE_VEC4) &&
+              ((accessor.componentType == TINYGLTF_COMPONENT_TYPE_BYTE &&
+                task.stride == 4) ||
+               (accessor.componentType == TINYGLTF_COMPONENT_TYPE_SHORT &&
+                task.stride == 8));
+        quat = quat && aligned && accessor.normalized &&
+               (roles[a] & kRotation) &&
+               accessor.type == TINYGLTF_TYPE_VEC4 &&
+               accessor.componentType == TINYGLTF_COMPONENT_TYPE_SHORT &&
+               task.stride == 8;
+        exp = exp && (roles[a] & kVertex) && (accessor.byteOffset % 4) == 0 &&
+              accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT;
+      }
+      task.mode = "ATTRIBUTES";
+      task.filter = oct ? "OCTAHEDRAL"
+                        : (quat ? "QUATERNION" : (exp ? "EXPONENTIAL" : ""));
+    }
+    tasks.push_back(std::move(task));
+  }
+
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    EncodeTask &task = tasks[t];
+    const BufferView &view = model->bufferViews[task.view];
+    const unsigned char *src =
+        model->buffers[size_t(view.buffer)].data.data() + view.byteOffset;
+    if (task.mode == "ATTRIBUTES") {
+      if (task.filter.empty()) {
+        task.ok = EncodeMeshoptVertexBuffer(&task.stream, src, task.count,
+                                            task.stride);
+      } else {
+        std::vector<unsigned char> filtered(src, src + view.byteLength);
+        task.ok = EncodeMeshoptFilter(filtered.data(), task.count,
+                                      task.stride, task.filter,
+                                      options.exponential_bits) &&
+                  EncodeMeshoptVertexBuffer(&task.stream, filtered.data(),
+                                            task.count, task.stride);
+        task.decoded = std::move(filtered);
+        task.ok = task.ok && ApplyMeshoptFilter(task.decoded.data(),
+                                                task.count, task.stride,
+                                                task.filter);
+      }
+    } else if (task.mode == "TRIANGLES") {
+      // triangles may be rotated: the fallback gets the decoded order
+      task.decoded.resize(view.byteLength);
+      task.ok = EncodeMeshoptIndexBuffer(&task.stream, src, task.count,
+                                         task.stride) &&
+                DecodeMeshoptIndexBuffer(task.decoded.data(), task.count,
+                                         task.stride, task.stream.data(),
+                                         task.stream.size());
+    } else {
+      task.ok = EncodeMeshoptIndexSequence(&task.stream, src, task.count,
+                                           task.stride);
+    }
+  });
+
+  // Compressed streams go to buffers[0], unless it is a fallback buffer.
+  MeshoptEncodeReport r;
+  size_t target = 0;
+  std::vector<int> refresh_bounds;
+  std::vector<size_t> compressed;
+  for (EncodeTask &task : tasks) {
+    BufferView &view = model->bufferViews[task.view];
+    if (!task.ok || task.stream.size() >= view.byteLength) {
+      continue;
+    }
+    if (compressed.empty() && IsMeshoptFallbackBuffer(model->buffers[0])) {
+      model->buffers.emplace_back();
+      target = model->buffers.size() - 1;
+    }
+    if (!task.decoded.empty()) {
+      memcpy(model->buffers[size_t(view.buffer)].data.data() + view.byteOffset,
+             task.decoded.data(), task.decoded.size());
+    }
+    if (!task.filter.empty()) {
+      for (size_t a : view_accessors[task.view]) {
+        if (!model->accessors[a].minValues.empty() ||
+            !model->accessors[a].maxValues.empty()) {
+          refresh_bounds.push_back(int(a));
+        }
+      }
+    }
+
+    std::vector<unsigned char> &data = model->buffers[target].data;
+    data.resize((data.size() + 3) & ~size_t(3));
+    Value::Object ext;
+    ext["buffer"] = Value(int(target));
+    ext["byteOffset"] = Value(int(data.size()));
+    ext["byteLength"] = Value(int(task.stream.size()));
+    ext["byteStride"] = Value(int(task.stride));
+    ext["count"] = Value(int(task.count));
+    ext["mode"] = Value(task.mode);
+    if (!task.filter.empty()) {
+      ext["filter"] = Value(task.filter);
+    }
+    view.extensions[kExtension] = Value(std::move(ext));
+    data.insert(data.end(), task.stream.begin(), task.stream.end());
+
+    compressed.push_back(task.view);
+    r.views++;
+    r.bytes_before += view.byteLength;
+    r.bytes_after += task.stream.size();
+  }
+
+  bool success = true;
+  if (!refresh_bounds.empty()) {
+    AccessorBoundsOptions bounds_options;
+    bounds_options.accessors = refresh_bounds;
+    bounds_options.num_threads = options.num_threads;
+    success = ComputeAccessorBounds(model, bounds_options, err);
+  }
+
+  if (!compressed.empty()) {
+    if (!options.keep_fallback) {
+      // Move the uncompressed data to a fallback buffer, which is written
+      // without data.
+      Buffer fallback;
+      for (size_t v : compressed) {
+        BufferView &view = model->bufferViews[v];
+        const std::vector<unsigned char> &src =
+            model->buffers[size_t(view.buffer)].data;
+        const size_t offset = (fallback.data.size() + 15) & ~size_t(15);
+        fallback.data.resize(offset);
+        fallback.data.insert(
+            fallback.data.end(), src.begin() + std::ptrdiff_t(view.byteOffset),
+            src.begin() + std::ptrdiff_t(view.byteOffset + view.byteLength));
+        view.buffer = int(model->buffers.size());
+        view.byteOffset = offset;
+      }
+      Value::Object ext;
+      ext["fallback"] = Value(true);
+      fallback.extensions[kExtension] = Value(std::move(ext));
+      model->buffers.emplace_back(std::move(fallback));
+    }
+
+    if (std::find(model->extensionsUsed.begin(), model->extensionsUsed.end(),
+                  kExtension) == model->extensionsUsed.end()) {
+      model->extensionsUsed.push_back(kExtension);
+    }
+    if (!options.keep_fallback &&
+        std::find(model->extensionsRequired.begin(),
+                  model->extensionsRequired.end(),
+                  kExtension) == model->extensionsRequired.end()) {
+      model->extensionsRequired.push_back(kExtension);
+    }
   }
-  if (node.scale.size() > 0) {
-    SerializeNumberArrayProperty<double>("scale", node.scale, o);
+  if (r.bytes_after > 0) {
+    r.compression_ratio = double(r.bytes_before) / double(r.bytes_after);
   }
-  if (node.matrix.size() > 0) {
-    SerializeNumberArrayProperty<double>("matrix", node.matrix, o);
+
+  if (success && options.compact_buffers && !compressed.empty()) {
+    success = CompactBuffers(model, &references, err);
+  }
+  if (report) {
+    *report = r;
+  }
+  return success;
+}
+#endif  // TINYGLTF_ENABLE_MESHOPT
+
+
+#ifdef TINYGLTF_ENABLE_DRACO
+static bool DecodeDracoPrimitives(Model *model, std::string *err,
+                                  std::string *warn,
+                                  ParseStrictness strictness,
+                                  const GeometryCacheCallbacks *cache,
+                                  int num_threads) {
+  struct DracoOutput {
+    int accessor;
+    std::string attribute;  // Empty for indices
+    int unique_id;          // Draco attribute id
+    int component_type;
+    size_t num_components;
+    size_t count;
+    size_t size;
+    int target;
+    int buffer;
+    size_t offset;
+    size_t cache_offset;  // Offset of the data in `DracoJob::cache_entry`
+  };
+  struct DracoJob {
+    int view;
+    std::vector<std::pair<size_t, size_t>> primitives;  // (mesh, primitive)
+    std::vector<DracoOutput> outputs;
+    std::string warn;
+    std::string err;
+    std::string options;  // Cache entry identity
+    uint64_t key;
+    bool cached;
+    std::vector<unsigned char> cache_entry;
+    std::unique_ptr<draco::Mesh> mesh;
+  };
+
+  // A compressed bufferView may be shared by primitives: decode it once.
+  std::vector<DracoJob> jobs;
+  std::map<int, size_t> view_jobs;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const Primitive &primitive = model->meshes[m].primitives[p];
+      auto it = primitive.extensions.find("KHR_draco_mesh_compression");
+      if (it == primitive.extensions.end()) {
+        continue;
+      }
+      const Value &ext = it->second;
+      if (!ext.Get("bufferView").IsInt() || !ext.Get("attributes").IsObject()) {
+        continue;
+      }
+      const int view = ext.Get("bufferView").Get<int>();
+      if (view < 0 || size_t(view) >= model->bufferViews.size() ||
+          model->bufferViews[size_t(view)].buffer < 0 ||
+          size_t(model->bufferViews[size_t(view)].buffer) >=
+              model->buffers.size()) {
+        if (err) {
+          (*err) += "mesh[" + std::to_string(m) + "].primitives[" +
+                    std::to_string(p) +
+                    "]: invalid KHR_draco_mesh_compression bufferView.\n";
+        }
+        return false;
+      }
+      const BufferView &bufferView = model->bufferViews[size_t(view)];
+      const Buffer &buffer = model->buffers[size_t(bufferView.buffer)];
+      if (bufferView.byteOffset > buffer.data.size() ||
+          bufferView.byteLength > buffer.data.size() - bufferView.byteOffset) {
+        if (err) {
+          (*err) += "bufferView[" + std::to_string(view) +
+                    "]: KHR_draco_mesh_compression data is out of range.\n";
+        }
+        return false;
+      }
+      auto job = view_jobs.find(view);
+      if (job == view_jobs.end()) {
+        job = view_jobs.emplace(view, jobs.size()).first;
+        jobs.emplace_back();
+        jobs.back().view = view;
+        jobs.back().key = 0;
+        jobs.back().cached = false;
+      }
+      jobs[job->second].primitives.emplace_back(m, p);
+    }
   }
-  if (node.mesh != -1) {
-    SerializeNumberProperty<int>("mesh", node.mesh, o);
+  if (jobs.empty()) {
+    return true;
   }
 
-  if (node.skin != -1) {
-    SerializeNumberProperty<int>("skin", node.skin, o);
-  }
+  // The outputs are planned from their accessors(glTF requires the accessor
+  // count to match the decoded mesh). The accessor counts are untrusted, so
+  // nothing is allocated from them: the packed buffers are allocated after
+  // the counts are checked against the decoded meshes or cache entries.
+  for (DracoJob &job : jobs) {
+    // Draco decodes every attribute for all points of the mesh.
+    size_t num_points = 0;
+    for (const auto &mp : job.primitives) {
+      const Primitive &primitive =
+          model->meshes[mp.first].primitives[mp.second];
+      for (const auto &attribute : primitive.attributes) {
+        if (attribute.second >= 0 &&
+            size_t(attribute.second) < model->accessors.size()) {
+          num_points = (std::max)(
+              num_points, model->accessors[size_t(attribute.second)].count);
+        }
+      }
+    }
 
-  if (node.camera != -1) {
-    SerializeNumberProperty<int>("camera", node.camera, o);
-  }
+    const auto planned = [&job](int accessor) {
+      for (const DracoOutput &out : job.outputs) {
+        if (out.accessor == accessor) return true;
+      }
+      return false;
+    };
+    const auto plan = [&](DracoOutput &out) {
+      const int32_t component_size =
+          GetComponentSizeInBytes(uint32_t(out.component_type));
+      if (component_size <= 0 ||
+          (out.num_components > 0 &&
+           out.count > (std::numeric_limits<size_t>::max)() /
+                           (out.num_components * size_t(component_size)))) {
+        return false;
+      }
+      out.size = out.count * out.num_components * size_t(component_size);
+      job.outputs.emplace_back(std::move(out));
+      return true;
+    };
+
+    for (const auto &mp : job.primitives) {
+      const Primitive &primitive =
+          model->meshes[mp.first].primitives[mp.second];
+      if (primitive.indices >= 0 &&
+          size_t(primitive.indices) < model->accessors.size() &&
+          !planned(primitive.indices)) {
+        const Accessor &accessor = model->accessors[size_t(primitive.indices)];
+        int componentType = accessor.componentType;
+        if (strictness == ParseStrictness::Permissive) {
+          // handle the situation where the stored component type does not
+          // match the required type for the actual number of stored points
+          int supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+          if (num_points < size_t(std::numeric_limits<uint8_t>::max())) {
+            supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+          } else if (num_points <
+                     size_t(std::numeric_limits<uint16_t>::max())) {
+            supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+          } else {
+            supposedComponentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+          }
+          if (supposedComponentType > componentType) {
+            job.warn += "GLTF component type " +
+                        std::to_string(componentType) +
+                        " is not sufficient for number of stored points,"
+                        " treating as " +
+                        std::to_string(supposedComponentType) + "\n";
+            componentType = supposedComponentType;
+          }
+        }
+        const int32_t componentSize =
+            GetComponentSizeInBytes(uint32_t(componentType));
+        if (componentSize != 1 && componentSize != 2 && componentSize != 4) {
+          job.err = "invalid index component type";
+          break;
+        }
+        DracoOutput out;
+        out.accessor = primitive.indices;
+        out.unique_id = -1;
+        out.component_type = componentType;
+        out.num_components = 1;
+        out.count = accessor.count;
+        out.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+        if (!plan(out)) {
+          job.err = "indices are too large";
+          break;
+        }
+      }
 
-  if (node.weights.size() > 0) {
-    SerializeNumberArrayProperty<double>("weights", node.weights, o);
+      for (const auto &attribute :
+           primitive.extensions.find("KHR_draco_mesh_compression")
+               ->second.Get("attributes")
+               .Get<Value::Object>()) {
+        auto primitiveAttribute = primitive.attributes.find(attribute.first);
+        if (!attribute.second.IsInt() ||
+            primitiveAttribute == primitive.attributes.end() ||
+            primitiveAttribute->second < 0 ||
+            size_t(primitiveAttribute->second) >= model->accessors.size()) {
+          job.err = "invalid attribute '" + attribute.first + "'";
+          break;
+        }
+        if (planned(primitiveAttribute->second)) {
+          continue;
+        }
+        const Accessor &accessor =
+            model->accessors[size_t(primitiveAttribute->second)];
+        const int32_t num_components =
+            GetNumComponentsInType(uint32_t(accessor.type));
+        DracoOutput out;
+        out.accessor = primitiveAttribute->second;
+        out.attribute = attribute.first;
+        out.unique_id = attribute.second.Get<int>();
+        out.component_type = accessor.componentType;
+        out.num_components = size_t(num_components);
+        out.count = accessor.count;
+        out.target = TINYGLTF_TARGET_ARRAY_BUFFER;
+        if (num_components < 1 || num_components > 4 || !plan(out)) {
+          job.err = "invalid accessor for '" + attribute.first + "'";
+          break;
+        }
+      }
+      if (!job.err.empty()) {
+        break;
+      }
+    }
+    if (!job.err.empty()) {
+      job.outputs.clear();
+    }
   }
 
-  SerializeExtrasAndExtensions(node, o);
+  // A cache entry holds the outputs of a job after its identity: the output
+  // count, then the component type, count and data of each output. The key
+  // covers the outputs requested by the primitives(in decode order). A valid
+  // entry is kept until it is copied into the packed buffers.
+  const bool use_cache = cache && (cache->Lookup || cache->Store);
+  if (use_cache) {
+    std::vector<unsigned char> data;
+    for (DracoJob &job : jobs) {
+      if (job.outputs.empty()) {
+        continue;
+      }
+      std::stringstream options;
+      options << "KHR_draco_mesh_compression;strictness="
+              << int(strictness);
+      for (const DracoOutput &out : job.outputs) {
+        if (out.attribute.empty()) {
+          options << ";indices:" << out.component_type;
+        } else {
+          options << ";" << out.attribute << ":" << out.unique_id << ":"
+                  << out.component_type;
+        }
+      }
 
-  // Note(agnat): If the asset was loaded from disk, the node may already
-  // contain the KHR_lights_punctual extension. If it was constructed in
-  // memory it does not. In any case we update the JSON property using
-  // the value from the struct. Last, if the node does not have a light
-  // reference but the extension is still present, we remove it.
-  if (node.light != -1) {
-    detail::json_iterator it;
-    if (!detail::FindMember(o, "extensions", it)) {
-      detail::json extensions;
-      detail::JsonSetObject(extensions);
-      detail::JsonAddMember(o, "extensions", std::move(extensions));
-      detail::FindMember(o, "extensions", it);
-    }
-    auto &extensions = detail::GetValue(it);
-    if (!detail::FindMember(extensions, "KHR_lights_punctual", it)) {
-      detail::json lights_punctual;
-      detail::JsonSetObject(lights_punctual);
-      detail::JsonAddMember(extensions, "KHR_lights_punctual",
-                            std::move(lights_punctual));
-      detail::FindMember(extensions, "KHR_lights_punctual", it);
-    }
-    SerializeNumberProperty("light", node.light, detail::GetValue(it));
-  } else {
-    // node has no light ref (any longer)... so we clean up
-    detail::json_iterator ext_it;
-    if (detail::FindMember(o, "extensions", ext_it)) {
-      auto &extensions = detail::GetValue(ext_it);
-      detail::json_iterator lp_it;
-      if (detail::FindMember(extensions, "KHR_lights_punctual", lp_it)) {
-        detail::Erase(extensions, lp_it);
+      const BufferView &view = model->bufferViews[size_t(job.view)];
+      job.options = options.str();
+      job.key = GeometryCacheKey(
+          model->buffers[size_t(view.buffer)].data.data() + view.byteOffset,
+          view.byteLength, job.options);
+      if (!cache->Lookup || !cache->Lookup(job.key, &data, cache->user_data)) {
+        continue;
       }
-      if (detail::IsEmpty(extensions)) {
-        detail::Erase(o, ext_it);
+
+      size_t pos = CheckGeometryCacheIdentity(data, view.byteLength,
+                                              job.options);
+      const auto read = [&](void *dst, size_t size) {
+        if (size > data.size() - pos) return false;
+        if (size > 0) memcpy(dst, data.data() + pos, size);
+        pos += size;
+        return true;
+      };
+      uint64_t num_outputs = 0;
+      bool ok = pos > 0 && read(&num_outputs, sizeof(uint64_t)) &&
+                num_outputs == job.outputs.size();
+      for (size_t i = 0; ok && i < job.outputs.size(); i++) {
+        DracoOutput &out = job.outputs[i];
+        int32_t component_type = 0;
+        uint64_t count = 0, size = 0;
+        ok = read(&component_type, sizeof(int32_t)) &&
+             read(&count, sizeof(uint64_t)) && read(&size, sizeof(uint64_t)) &&
+             component_type == out.component_type && count == out.count &&
+             size == out.size && out.size <= data.size() - pos;
+        out.cache_offset = pos;
+        pos += ok ? out.size : 0;
+      }
+      job.cached = ok && pos == data.size();
+      if (job.cached) {
+        job.cache_entry.swap(data);
       }
     }
   }
 
-  // KHR_audio
-  if (node.emitter != -1) {
-    detail::json_iterator it;
-    if (!detail::FindMember(o, "extensions", it)) {
-      detail::json extensions;
-      detail::JsonSetObject(extensions);
-      detail::JsonAddMember(o, "extensions", std::move(extensions));
-      detail::FindMember(o, "extensions", it);
+  // Decode and check the meshes against the planned outputs.
+  detail::ParallelFor(jobs.size(), num_threads, [&](size_t j) {
+    DracoJob &job = jobs[j];
+    if (job.cached || job.outputs.empty()) {
+      return;
     }
-    auto &extensions = detail::GetValue(it);
-    if (!detail::FindMember(extensions, "KHR_audio", it)) {
-      detail::json audio;
-      detail::JsonSetObject(audio);
-      detail::JsonAddMember(extensions, "KHR_audio", std::move(audio));
-      detail::FindMember(extensions, "KHR_audio", it);
+    const BufferView &view = model->bufferViews[size_t(job.view)];
+    const Buffer &buffer = model->buffers[size_t(view.buffer)];
+
+    draco::DecoderBuffer decoderBuffer;
+    decoderBuffer.Init(
+        reinterpret_cast<const char *>(buffer.data.data() + view.byteOffset),
+        view.byteLength);
+    draco::Decoder decoder;
+    auto decodeResult = decoder.DecodeMeshFromBuffer(&decoderBuffer);
+    if (!decodeResult.ok()) {
+      job.err = "failed to decode Draco mesh";
+      return;
     }
-    SerializeNumberProperty("emitter", node.emitter, detail::GetValue(it));
-  } else {
-    detail::json_iterator ext_it;
-    if (detail::FindMember(o, "extensions", ext_it)) {
-      auto &extensions = detail::GetValue(ext_it);
-      detail::json_iterator lp_it;
-      if (detail::FindMember(extensions, "KHR_audio", lp_it)) {
-        detail::Erase(extensions, lp_it);
+    std::unique_ptr<draco::Mesh> mesh = std::move(decodeResult).value();
+
+    for (const DracoOutput &out : job.outputs) {
+      if (out.attribute.empty()) {
+        if (out.count != size_t(mesh->num_faces()) * 3) {
+          job.err = "index count does not match the accessor";
+          return;
+        }
+        continue;
       }
-      if (detail::IsEmpty(extensions)) {
-        detail::Erase(o, ext_it);
+      const draco::PointAttribute *pAttribute =
+          mesh->GetAttributeByUniqueId(out.unique_id);
+      if (!pAttribute ||
+          size_t(pAttribute->num_components()) != out.num_components) {
+        job.err = "missing or invalid Draco attribute for '" + out.attribute +
+                  "'";
+        return;
+      }
+      if (out.count != size_t(mesh->num_points())) {
+        job.err = "point count of '" + out.attribute +
+                  "' does not match the accessor";
+        return;
+      }
+    }
+    job.mesh = std::move(mesh);
+  });
+
+  // Pack the outputs of the jobs which were decoded or found in the cache
+  // into a few large buffers instead of one buffer per attribute. Each
+  // bufferView starts at a 4 byte aligned offset.
+  const size_t kMaxPackedBufferSize = size_t(1) << 28;
+  std::vector<size_t> packed_sizes;
+  for (DracoJob &job : jobs) {
+    if (!job.err.empty()) {
+      continue;
+    }
+    for (DracoOutput &out : job.outputs) {
+      if (packed_sizes.empty() ||
+          (packed_sizes.back() > 0 &&
+           packed_sizes.back() + out.size > kMaxPackedBufferSize)) {
+        packed_sizes.push_back(0);
       }
+      out.buffer = int(model->buffers.size() + packed_sizes.size() - 1);
+      out.offset = packed_sizes.back();
+      packed_sizes.back() = (out.offset + out.size + 3) & ~size_t(3);
     }
   }
+  for (size_t size : packed_sizes) {
+    model->buffers.emplace_back();
+    model->buffers.back().data.resize(size);
+  }
 
-  // MSFT_lod
-  if (!node.lods.empty()) {
-    detail::json_iterator it;
-    if (!detail::FindMember(o, "extensions", it)) {
-      detail::json extensions;
-      detail::JsonSetObject(extensions);
-      detail::JsonAddMember(o, "extensions", std::move(extensions));
-      detail::FindMember(o, "extensions", it);
+  detail::ParallelFor(jobs.size(), num_threads, [&](size_t j) {
+    DracoJob &job = jobs[j];
+    if (!job.err.empty()) {
+      return;
     }
-    auto &extensions = detail::GetValue(it);
-    if (!detail::FindMember(extensions, "MSFT_lod", it)) {
-      detail::json lod;
-      detail::JsonSetObject(lod);
-      detail::JsonAddMember(extensions, "MSFT_lod", std::move(lod));
-      detail::FindMember(extensions, "MSFT_lod", it);
+    for (const DracoOutput &out : job.outputs) {
+      uint8_t *dst =
+          model->buffers[size_t(out.buffer)].data.data() + out.offset;
+      if (job.cached) {
+        if (out.size > 0) {
+          memcpy(dst, job.cache_entry.data() + out.cache_offset, out.size);
+        }
+      } else if (out.attribute.empty()) {
+        DecodeIndexBuffer(job.mesh.get(),
+                          size_t(GetComponentSizeInBytes(
+                              uint32_t(out.component_type))),
+                          dst);
+      } else if (!GetAttributeForAllPoints(
+                     uint32_t(out.component_type), job.mesh.get(),
+                     job.mesh->GetAttributeByUniqueId(out.unique_id), dst)) {
+        job.err = "failed to convert attribute '" + out.attribute + "'";
+        break;
+      }
     }
-    SerializeNumberArrayProperty<int>("ids", node.lods, detail::GetValue(it));
-  } else {
-    detail::json_iterator ext_it;
-    if (detail::FindMember(o, "extensions", ext_it)) {
-      auto &extensions = detail::GetValue(ext_it);
-      detail::json_iterator lp_it;
-      if (detail::FindMember(extensions, "MSFT_lod", lp_it)) {
-        detail::Erase(extensions, lp_it);
+    job.mesh.reset();
+    std::vector<unsigned char>().swap(job.cache_entry);
+  });
+
+  for (DracoJob &job : jobs) {
+    if (warn) {
+      (*warn) += job.warn;
+    }
+    if (!job.err.empty()) {
+      // The space reserved for the job in the packed buffers stays unused.
+      if (warn) {
+        (*warn) += "bufferView[" + std::to_string(job.view) +
+                   "]: KHR_draco_mesh_compression: " + job.err + ".\n";
       }
-      if (detail::IsEmpty(extensions)) {
-        detail::Erase(o, ext_it);
+      continue;
+    }
+    if (use_cache && cache->Store && !job.cached) {
+      std::vector<unsigned char> data;
+      const auto write = [&data](const void *src, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(src);
+        data.insert(data.end(), bytes, bytes + size);
+      };
+      WriteGeometryCacheIdentity(
+          model->bufferViews[size_t(job.view)].byteLength, job.options, &data);
+      const uint64_t num_outputs = job.outputs.size();
+      write(&num_outputs, sizeof(uint64_t));
+      for (const DracoOutput &out : job.outputs) {
+        const int32_t component_type = out.component_type;
+        const uint64_t count = out.count, size = out.size;
+        write(&component_type, sizeof(int32_t));
+        write(&count, sizeof(uint64_t));
+        write(&size, sizeof(uint64_t));
+        write(model->buffers[size_t(out.buffer)].data.data() + out.offset,
+              out.size);
       }
+      cache->Store(job.key, data, cache->user_data);
+    }
+    model->bufferViews[size_t(job.view)].dracoDecoded = true;
+    for (const DracoOutput &out : job.outputs) {
+      BufferView view;
+      view.buffer = out.buffer;
+      view.byteOffset = out.offset;
+      view.byteLength = out.size;
+      view.target = out.target;
+      model->bufferViews.emplace_back(std::move(view));
+
+      Accessor &accessor = model->accessors[size_t(out.accessor)];
+      accessor.bufferView = int(model->bufferViews.size() - 1);
+      accessor.byteOffset = 0;
+      accessor.componentType = out.component_type;
     }
   }
 
-  if (!node.name.empty()) SerializeStringProperty("name", node.name, o);
-  SerializeNumberArrayProperty<int>("children", node.children, o);
+  return true;
 }
 
-static void SerializeGltfSampler(const Sampler &sampler, detail::json &o) {
-  if (!sampler.name.empty()) {
-    SerializeStringProperty("name", sampler.name, o);
-  }
-  if (sampler.magFilter != -1) {
-    SerializeNumberProperty("magFilter", sampler.magFilter, o);
-  }
-  if (sampler.minFilter != -1) {
-    SerializeNumberProperty("minFilter", sampler.minFilter, o);
+static bool GetDracoDataType(int component_type, draco::DataType *type) {
+  switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+      *type = draco::DT_INT8;
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      *type = draco::DT_UINT8;
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+      *type = draco::DT_INT16;
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+      *type = draco::DT_UINT16;
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+      *type = draco::DT_UINT32;
+      return true;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+      *type = draco::DT_FLOAT32;
+      return true;
+    default:
+      return false;
   }
-  // SerializeNumberProperty("wrapR", sampler.wrapR, o);
-  SerializeNumberProperty("wrapS", sampler.wrapS, o);
-  SerializeNumberProperty("wrapT", sampler.wrapT, o);
-
-  SerializeExtrasAndExtensions(sampler, o);
 }
 
-static void SerializeGltfOrthographicCamera(const OrthographicCamera &camera,
-                                            detail::json &o) {
-  SerializeNumberProperty("zfar", camera.zfar, o);
-  SerializeNumberProperty("znear", camera.znear, o);
-  SerializeNumberProperty("xmag", camera.xmag, o);
-  SerializeNumberProperty("ymag", camera.ymag, o);
+bool EncodeDracoCompression(Model *model, const DracoEncodeOptions &options,
+                            std::string *err) {
+  const char *kExtension = "KHR_draco_mesh_compression";
+  struct DracoAttributeResult {
+    std::string name;
+    int unique_id;
+    AccessorBounds bounds;  // POSITION only
+  };
+  struct DracoEncodeTask {
+    size_t mesh;
+    size_t primitive;
+    std::vector<std::pair<size_t, size_t>> users;  // (mesh, primitive)
+    DracoQuantization quantization;
+    std::vector<char> data;
+    size_t num_points;
+    size_t num_faces;
+    std::vector<DracoAttributeResult> attributes;
+    bool ok;
+    std::string err;
+  };
 
-  SerializeExtrasAndExtensions(camera, o);
-}
+  // Accessors, bufferViews and bytes of the replaced attributes are reclaimed
+  // afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+
+  // Primitives with the same geometry and quantization share the result.
+  std::vector<DracoEncodeTask> tasks;
+  std::map<std::vector<int>, size_t> task_keys;
+  for (size_t m = 0; m < model->meshes.size(); m++) {
+    for (size_t p = 0; p < model->meshes[m].primitives.size(); p++) {
+      const Primitive &primitive = model->meshes[m].primitives[p];
+      const int mode =
+          primitive.mode < 0 ? TINYGLTF_MODE_TRIANGLES : primitive.mode;
+      if ((mode != TINYGLTF_MODE_TRIANGLES &&
+           mode != TINYGLTF_MODE_TRIANGLE_STRIP &&
+           mode != TINYGLTF_MODE_TRIANGLE_FAN) ||
+          !primitive.targets.empty() || primitive.attributes.empty() ||
+          primitive.extensions.count(kExtension)) {
+        continue;
+      }
+      DracoQuantization quantization = options.quantization;
+      auto q = options.primitive_quantization.find(
+          std::make_pair(int(m), int(p)));
+      if (q != options.primitive_quantization.end()) {
+        quantization = q->second;
+      }
 
-static void SerializeGltfPerspectiveCamera(const PerspectiveCamera &camera,
-                                           detail::json &o) {
-  SerializeNumberProperty("zfar", camera.zfar, o);
-  SerializeNumberProperty("znear", camera.znear, o);
-  if (camera.aspectRatio > 0) {
-    SerializeNumberProperty("aspectRatio", camera.aspectRatio, o);
+      std::vector<int> key = {
+          mode,
+          primitive.indices,
+          quantization.position_bits,
+          quantization.normal_bits,
+          quantization.texcoord_bits,
+          quantization.color_bits,
+          quantization.generic_bits};
+      for (const auto &attrib : primitive.attributes) {
+        key.push_back(attrib.second);
+      }
+      auto it = task_keys.find(key);
+      if (it == task_keys.end()) {
+        it = task_keys.emplace(key, tasks.size()).first;
+        DracoEncodeTask task;
+        task.mesh = m;
+        task.primitive = p;
+        task.quantization = quantization;
+        task.num_points = 0;
+        task.num_faces = 0;
+        task.ok = false;
+        tasks.emplace_back(std::move(task));
+      }
+      tasks[it->second].users.emplace_back(m, p);
+    }
   }
-
-  if (camera.yfov > 0) {
-    SerializeNumberProperty("yfov", camera.yfov, o);
+  if (tasks.empty()) {
+    return true;
   }
 
-  SerializeExtrasAndExtensions(camera, o);
-}
+  detail::ParallelFor(tasks.size(), options.num_threads, [&](size_t t) {
+    DracoEncodeTask &task = tasks[t];
+    const Model &src = *model;
+    const Primitive &primitive =
+        src.meshes[task.mesh].primitives[task.primitive];
 
-static void SerializeGltfCamera(const Camera &camera, detail::json &o) {
-  SerializeStringProperty("type", camera.type, o);
-  if (!camera.name.empty()) {
-    SerializeStringProperty("name", camera.name, o);
-  }
+    std::vector<uint32_t> triangles;
+    if (!GetTriangleIndices(src, primitive, &triangles, &task.err)) {
+      return;
+    }
 
-  if (camera.type.compare("orthographic") == 0) {
-    detail::json orthographic;
-    SerializeGltfOrthographicCamera(camera.orthographic, orthographic);
-    detail::JsonAddMember(o, "orthographic", std::move(orthographic));
-  } else if (camera.type.compare("perspective") == 0) {
-    detail::json perspective;
-    SerializeGltfPerspectiveCamera(camera.perspective, perspective);
-    detail::JsonAddMember(o, "perspective", std::move(perspective));
-  } else {
-    // ???
-  }
+    draco::Mesh mesh;
+    size_t num_points = 0;
+    std::vector<std::pair<int, int>> quantized;  // (attribute id, bits)
+    for (const auto &attrib : primitive.attributes) {
+      std::vector<unsigned char> data;
+      if (!MaterializeAccessor(src, attrib.second, &data, &task.err)) {
+        return;
+      }
+      const Accessor &accessor = src.accessors[size_t(attrib.second)];
+      const int num_components = GetNumComponentsInType(uint32_t(accessor.type));
+      draco::DataType data_type;
+      if (num_components < 1 || num_components > 4 ||
+          !GetDracoDataType(accessor.componentType, &data_type)) {
+        task.err = "attribute '" + attrib.first +
+                   "' can not be encoded with Draco";
+        return;
+      }
+      if (num_points == 0) {
+        num_points = accessor.count;
+        mesh.set_num_points(uint32_t(num_points));
+      } else if (accessor.count != num_points) {
+        task.err = "attributes have different counts";
+        return;
+      }
 
-  SerializeExtrasAndExtensions(camera, o);
-}
+      const std::string &name = attrib.first;
+      draco::GeometryAttribute::Type type = draco::GeometryAttribute::GENERIC;
+      int bits = task.quantization.generic_bits;
+      if (name == "POSITION") {
+        type = draco::GeometryAttribute::POSITION;
+        bits = task.quantization.position_bits;
+      } else if (name == "NORMAL") {
+        type = draco::GeometryAttribute::NORMAL;
+        bits = task.quantization.normal_bits;
+      } else if (name == "TANGENT") {
+        bits = task.quantization.normal_bits;
+      } else if (name.compare(0, 9, "TEXCOORD_") == 0) {
+        type = draco::GeometryAttribute::TEX_COORD;
+        bits = task.quantization.texcoord_bits;
+      } else if (name.compare(0, 6, "COLOR_") == 0) {
+        type = draco::GeometryAttribute::COLOR;
+        bits = task.quantization.color_bits;
+      }
 
-static void SerializeGltfScene(const Scene &scene, detail::json &o) {
-  SerializeNumberArrayProperty<int>("nodes", scene.nodes, o);
+      const size_t elem_size =
+          size_t(GetComponentSizeInBytes(uint32_t(accessor.componentType))) *
+          size_t(num_components);
+      draco::GeometryAttribute attribute;
+      attribute.Init(type, nullptr, int8_t(num_components), data_type,
+                     accessor.normalized, int64_t(elem_size), 0);
+      const int id = mesh.AddAttribute(attribute, true, uint32_t(num_points));
+      if (id < 0) {
+        task.err = "failed to add attribute '" + name + "'";
+        return;
+      }
+      mesh.attribute(id)->buffer()->Write(0, data.data(), data.size());
+      if (data_type == draco::DT_FLOAT32 && bits > 0) {
+        quantized.emplace_back(id, bits);
+      }
 
-  if (scene.name.size()) {
-    SerializeStringProperty("name", scene.name, o);
-  }
-  SerializeExtrasAndExtensions(scene, o);
+      DracoAttributeResult result;
+      result.name = name;
+      result.unique_id = int(mesh.attribute(id)->unique_id());
+      if (name == "POSITION" &&
+          (accessor.minValues.empty() || accessor.maxValues.empty()) &&
+          !ComputeAccessorBounds(src, attrib.second, &result.bounds,
+                                 &task.err)) {
+        return;
+      }
+      task.attributes.emplace_back(std::move(result));
+    }
 
-  // KHR_audio
-  if (!scene.audioEmitters.empty()) {
-    detail::json_iterator it;
-    if (!detail::FindMember(o, "extensions", it)) {
-      detail::json extensions;
-      detail::JsonSetObject(extensions);
-      detail::JsonAddMember(o, "extensions", std::move(extensions));
-      detail::FindMember(o, "extensions", it);
+    mesh.SetNumFaces(triangles.size() / 3);
+    for (size_t f = 0; f < triangles.size() / 3; f++) {
+      draco::Mesh::Face face;
+      for (int k = 0; k < 3; k++) {
+        if (triangles[f * 3 + size_t(k)] >= num_points) {
+          task.err = "index out of range";
+          return;
+        }
+        face[k] = draco::PointIndex(triangles[f * 3 + size_t(k)]);
+      }
+      mesh.SetFace(draco::FaceIndex(uint32_t(f)), face);
     }
-    auto &extensions = detail::GetValue(it);
-    if (!detail::FindMember(extensions, "KHR_audio", it)) {
-      detail::json audio;
-      detail::JsonSetObject(audio);
-      detail::JsonAddMember(extensions, "KHR_audio", std::move(audio));
-      detail::FindMember(o, "KHR_audio", it);
+
+    draco::ExpertEncoder encoder(mesh);
+    encoder.SetSpeedOptions(options.encode_speed, options.decode_speed);
+    encoder.SetEncodingMethod(draco::MESH_EDGEBREAKER_ENCODING);
+    for (const auto &q : quantized) {
+      encoder.SetAttributeQuantization(q.first, q.second);
     }
-    SerializeNumberArrayProperty("emitters", scene.audioEmitters,
-                                 detail::GetValue(it));
-  } else {
-    detail::json_iterator ext_it;
-    if (detail::FindMember(o, "extensions", ext_it)) {
-      auto &extensions = detail::GetValue(ext_it);
-      detail::json_iterator lp_it;
-      if (detail::FindMember(extensions, "KHR_audio", lp_it)) {
-        detail::Erase(extensions, lp_it);
+    draco::EncoderBuffer buffer;
+    const draco::Status status = encoder.EncodeToBuffer(&buffer);
+    if (!status.ok()) {
+      task.err = std::string("Draco encoding failed: ") +
+                 status.error_msg_string();
+      return;
+    }
+
+    // The decoded mesh may have a different number of points(e.g.
+    // non-manifold vertices are split), which the accessor stubs must match.
+    draco::DecoderBuffer decoderBuffer;
+    decoderBuffer.Init(buffer.data(), buffer.size());
+    draco::Decoder decoder;
+    auto decodeResult = decoder.DecodeMeshFromBuffer(&decoderBuffer);
+    if (!decodeResult.ok()) {
+      task.err = "failed to decode the encoded Draco mesh";
+      return;
+    }
+    task.num_points = size_t(decodeResult.value()->num_points());
+    task.num_faces = size_t(decodeResult.value()->num_faces());
+    task.data.assign(buffer.data(), buffer.data() + buffer.size());
+    task.ok = true;
+  });
+
+  bool success = true;
+  bool encoded = false;
+  for (DracoEncodeTask &task : tasks) {
+    if (!task.ok) {
+      if (err) {
+        (*err) += "mesh[" + std::to_string(task.mesh) + "].primitives[" +
+                  std::to_string(task.primitive) + "]: " + task.err + "\n";
       }
-      if (detail::IsEmpty(extensions)) {
-        detail::Erase(o, ext_it);
+      success = false;
+      continue;
+    }
+
+    encoded = true;
+    const int view = AppendBufferView(
+        model, reinterpret_cast<const unsigned char *>(task.data.data()),
+        task.data.size(), 0);
+
+    // Accessors without bufferView: count and type only.
+    const Primitive &first = model->meshes[task.mesh].primitives[task.primitive];
+    std::map<std::string, int> attributes;
+    Value::Object ids;
+    for (const DracoAttributeResult &result : task.attributes) {
+      Accessor stub = model->accessors[size_t(first.attributes.at(result.name))];
+      stub.bufferView = -1;
+      stub.byteOffset = 0;
+      stub.count = task.num_points;
+      stub.sparse = Accessor::Sparse();
+      stub.sparse.isSparse = false;
+      if (result.name == "POSITION" &&
+          (stub.minValues.empty() || stub.maxValues.empty())) {
+        stub.minValues = result.bounds.min;
+        stub.maxValues = result.bounds.max;
       }
+      model->accessors.emplace_back(std::move(stub));
+      attributes[result.name] = int(model->accessors.size() - 1);
+      ids[result.name] = Value(result.unique_id);
+    }
+    Accessor indices;
+    indices.type = TINYGLTF_TYPE_SCALAR;
+    indices.componentType = GetSmallestIndexComponentType(task.num_points);
+    indices.count = task.num_faces * 3;
+    model->accessors.emplace_back(std::move(indices));
+    const int indices_accessor = int(model->accessors.size() - 1);
+
+    Value::Object ext;
+    ext["bufferView"] = Value(view);
+    ext["attributes"] = Value(std::move(ids));
+    const Value ext_value(std::move(ext));
+    for (const auto &user : task.users) {
+      Primitive &primitive = model->meshes[user.first].primitives[user.second];
+      primitive.attributes = attributes;
+      primitive.indices = indices_accessor;
+      primitive.mode = TINYGLTF_MODE_TRIANGLES;
+      primitive.extensions[kExtension] = ext_value;
     }
   }
-}
-
-static void SerializeGltfSkin(const Skin &skin, detail::json &o) {
-  // required
-  SerializeNumberArrayProperty<int>("joints", skin.joints, o);
 
-  if (skin.inverseBindMatrices >= 0) {
-    SerializeNumberProperty("inverseBindMatrices", skin.inverseBindMatrices, o);
+  if (encoded) {
+    if (std::find(model->extensionsUsed.begin(), model->extensionsUsed.end(),
+                  kExtension) == model->extensionsUsed.end()) {
+      model->extensionsUsed.push_back(kExtension);
+    }
+    if (std::find(model->extensionsRequired.begin(),
+                  model->extensionsRequired.end(),
+                  kExtension) == model->extensionsRequired.end()) {
+      model->extensionsRequired.push_back(kExtension);
+    }
   }
 
-  if (skin.skeleton >= 0) {
-    SerializeNumberProperty("skeleton", skin.skeleton, o);
+  if (success && encoded && options.compact_buffers) {
+    success = CompactBuffers(model, &references, err);
   }
+  return success;
+}
+#endif  // TINYGLTF_ENABLE_DRACO
 
-  if (skin.name.size()) {
-    SerializeStringProperty("name", skin.name, o);
-  }
+//
+// Scene flattening.
+//
 
-  SerializeExtrasAndExtensions(skin, o);
+// Column major T * R * S.
+static void ComposeTRS(const double t[3], const double q[4], const double s[3],
+                       double m[16]) {
+  const double x = q[0], y = q[1], z = q[2], w = q[3];
+  m[0] = (1.0 - 2.0 * (y * y + z * z)) * s[0];
+  m[1] = 2.0 * (x * y + w * z) * s[0];
+  m[2] = 2.0 * (x * z - w * y) * s[0];
+  m[3] = 0.0;
+  m[4] = 2.0 * (x * y - w * z) * s[1];
+  m[5] = (1.0 - 2.0 * (x * x + z * z)) * s[1];
+  m[6] = 2.0 * (y * z + w * x) * s[1];
+  m[7] = 0.0;
+  m[8] = 2.0 * (x * z + w * y) * s[2];
+  m[9] = 2.0 * (y * z - w * x) * s[2];
+  m[10] = (1.0 - 2.0 * (x * x + y * y)) * s[2];
+  m[11] = 0.0;
+  m[12] = t[0];
+  m[13] = t[1];
+  m[14] = t[2];
+  m[15] = 1.0;
 }
 
-static void SerializeGltfTexture(const Texture &texture, detail::json &o) {
-  if (texture.sampler > -1) {
-    SerializeNumberProperty("sampler", texture.sampler, o);
-  }
-  if (texture.source > -1) {
-    SerializeNumberProperty("source", texture.source, o);
-  }
-  if (texture.name.size()) {
-    SerializeStringProperty("name", texture.name, o);
+// c = a * b, column major.
+static void MultiplyMatrices(const double a[16], const double b[16],
+                             double c[16]) {
+  for (int j = 0; j < 4; j++) {
+    for (int i = 0; i < 4; i++) {
+      c[4 * j + i] = a[i] * b[4 * j] + a[4 + i] * b[4 * j + 1] +
+                     a[8 + i] * b[4 * j + 2] + a[12 + i] * b[4 * j + 3];
+    }
   }
-  SerializeExtrasAndExtensions(texture, o);
 }
 
-///
-/// Serialize all properties except buffers and images.
-///
-static void SerializeGltfModel(const Model *model, detail::json &o) {
-  // ACCESSORS
-  if (model->accessors.size()) {
-    detail::json accessors;
-    detail::JsonReserveArray(accessors, model->accessors.size());
-    for (unsigned int i = 0; i < model->accessors.size(); ++i) {
-      detail::json accessor;
-      SerializeGltfAccessor(model->accessors[i], accessor);
-      detail::JsonPushBack(accessors, std::move(accessor));
+bool FlattenScene(const Model &model, int scene, FlatScene *flat,
+                  const FlattenSceneOptions &options, std::string *err) {
+  if (!flat) {
+    return false;
+  }
+  if (scene < 0) {
+    scene = model.defaultScene >= 0 ? model.defaultScene : 0;
+  }
+  if (size_t(scene) >= model.scenes.size()) {
+    if (err) {
+      (*err) += "scene[" + std::to_string(scene) + "] does not exist.\n";
     }
-    detail::JsonAddMember(o, "accessors", std::move(accessors));
+    return false;
   }
 
-  // ANIMATIONS
-  if (model->animations.size()) {
-    detail::json animations;
-    detail::JsonReserveArray(animations, model->animations.size());
-    for (unsigned int i = 0; i < model->animations.size(); ++i) {
-      if (model->animations[i].channels.size()) {
-        detail::json animation;
-        SerializeGltfAnimation(model->animations[i], animation);
-        detail::JsonPushBack(animations, std::move(animation));
+  // Breadth first traversal: the entries come out sorted by depth.
+  FlatScene out;
+  out.node_entries.assign(model.nodes.size(), -1);
+  const auto add = [&](int node, int parent) {
+    if (node < 0 || size_t(node) >= model.nodes.size()) {
+      if (err) {
+        (*err) += "invalid node index " + std::to_string(node) + ".\n";
       }
+      return false;
+    }
+    if (out.node_entries[size_t(node)] >= 0) {
+      if (err) {
+        (*err) += "node[" + std::to_string(node) +
+                  "] has several parents or is part of a cycle.\n";
+      }
+      return false;
+    }
+    out.node_entries[size_t(node)] = int(out.nodes.size());
+    out.nodes.push_back(node);
+    out.parents.push_back(parent);
+    return true;
+  };
+  out.level_offsets.push_back(0);
+  for (int node : model.scenes[size_t(scene)].nodes) {
+    if (!add(node, -1)) {
+      return false;
     }
-
-    detail::JsonAddMember(o, "animations", std::move(animations));
   }
+  for (size_t begin = 0; begin < out.nodes.size();) {
+    const size_t end = out.nodes.size();
+    out.level_offsets.push_back(end);
+    for (size_t e = begin; e < end; e++) {
+      for (int child : model.nodes[size_t(out.nodes[e])].children) {
+        if (!add(child, int(e))) {
+          return false;
+        }
+      }
+    }
+    begin = end;
+  }
+
+  const size_t n = out.nodes.size();
+  out.translations.resize(3 * n);
+  out.rotations.resize(4 * n);
+  out.scales.resize(3 * n);
+  out.has_matrix.resize(n);
+  out.local_matrices.resize(16 * n);
+  out.world_matrices.resize(16 * n);
+  out.dirty.assign(n, 1);
+  if (options.float_matrices) {
+    out.world_matrices_f.resize(16 * n);
+  }
+  const size_t kChunk = 1024;
+  detail::ParallelFor((n + kChunk - 1) / kChunk, options.num_threads,
+                      options.executor, [&](size_t c) {
+    const size_t end = std::min(n, (c + 1) * kChunk);
+    for (size_t e = c * kChunk; e < end; e++) {
+      const Node &node = model.nodes[size_t(out.nodes[e])];
+      const bool has_t = node.translation.size() == 3;
+      const bool has_r = node.rotation.size() == 4;
+      const bool has_s = node.scale.size() == 3;
+      for (size_t i = 0; i < 3; i++) {
+        out.translations[3 * e + i] = has_t ? node.translation[i] : 0.0;
+        out.scales[3 * e + i] = has_s ? node.scale[i] : 1.0;
+      }
+      for (size_t i = 0; i < 4; i++) {
+        out.rotations[4 * e + i] = has_r ? node.rotation[i] : (i == 3 ? 1.0 : 0.0);
+      }
+      out.has_matrix[e] = node.matrix.size() == 16;
+      if (out.has_matrix[e]) {
+        std::copy(node.matrix.begin(), node.matrix.end(),
+                  out.local_matrices.begin() + std::ptrdiff_t(16 * e));
+      }
+    }
+  });
 
-  // ASSET
-  detail::json asset;
-  SerializeGltfAsset(model->asset, asset);
-  detail::JsonAddMember(o, "asset", std::move(asset));
+  UpdateFlatSceneTransforms(&out, options);
+  *flat = std::move(out);
+  return true;
+}
 
-  // BUFFERVIEWS
-  if (model->bufferViews.size()) {
-    detail::json bufferViews;
-    detail::JsonReserveArray(bufferViews, model->bufferViews.size());
-    for (unsigned int i = 0; i < model->bufferViews.size(); ++i) {
-      detail::json bufferView;
-      SerializeGltfBufferView(model->bufferViews[i], bufferView);
-      detail::JsonPushBack(bufferViews, std::move(bufferView));
-    }
-    detail::JsonAddMember(o, "bufferViews", std::move(bufferViews));
+void UpdateFlatSceneTransforms(FlatScene *flat,
+                               const FlattenSceneOptions &options) {
+  if (!flat) {
+    return;
+  }
+  FlatScene &f = *flat;
+  const size_t n = f.nodes.size();
+  f.dirty.resize(n, 0);
+  // Float matrices are kept up to date once they exist.
+  const bool floats =
+      options.float_matrices || f.world_matrices_f.size() == 16 * n;
+  const bool all_floats = floats && f.world_matrices_f.size() != 16 * n;
+  if (all_floats) {
+    f.world_matrices_f.resize(16 * n);
+  }
+
+  // A child of an updated entry is updated too: the parents are in earlier
+  // levels, so their `dirty` flag is final when a level is processed.
+  const size_t kChunk = 1024;
+  for (size_t d = 0; d + 1 < f.level_offsets.size(); d++) {
+    const size_t begin = f.level_offsets[d];
+    const size_t end = f.level_offsets[d + 1];
+    detail::ParallelFor(
+        (end - begin + kChunk - 1) / kChunk, options.num_threads,
+        options.executor, [&](size_t c) {
+          const size_t chunk_end = std::min(end, begin + (c + 1) * kChunk);
+          for (size_t e = begin + c * kChunk; e < chunk_end; e++) {
+            const int parent = f.parents[e];
+            if (!f.dirty[e] && (parent < 0 || !f.dirty[size_t(parent)])) {
+              continue;
+            }
+            f.dirty[e] = 1;
+            double *local = &f.local_matrices[16 * e];
+            double *world = &f.world_matrices[16 * e];
+            if (!f.has_matrix[e]) {
+              ComposeTRS(&f.translations[3 * e], &f.rotations[4 * e],
+                         &f.scales[3 * e], local);
+            }
+            if (parent < 0) {
+              std::copy(local, local + 16, world);
+            } else {
+              MultiplyMatrices(&f.world_matrices[16 * size_t(parent)], local,
+                               world);
+            }
+            if (floats && !all_floats) {
+              for (size_t i = 0; i < 16; i++) {
+                f.world_matrices_f[16 * e + i] = float(world[i]);
+              }
+            }
+          }
+        });
   }
 
-  // Extensions required
-  if (model->extensionsRequired.size()) {
-    SerializeStringArrayProperty("extensionsRequired",
-                                 model->extensionsRequired, o);
+  if (all_floats) {
+    for (size_t i = 0; i < 16 * n; i++) {
+      f.world_matrices_f[i] = float(f.world_matrices[i]);
+    }
   }
+  std::fill(f.dirty.begin(), f.dirty.end(), static_cast<unsigned char>(0));
+}
 
-  // MATERIALS
-  if (model->materials.size()) {
-    detail::json materials;
-    detail::JsonReserveArray(materials, model->materials.size());
-    for (unsigned int i = 0; i < model->materials.size(); ++i) {
-      detail::json material;
-      SerializeGltfMaterial(model->materials[i], material);
+//
+// Animation sampling.
+//
 
-      if (detail::JsonIsNull(material)) {
-        // Issue 294.
-        // `material` does not have any required parameters
-        // so the result may be null(unmodified) when all material parameters
-        // have default value.
-        //
-        // null is not allowed thus we create an empty JSON object.
-        detail::JsonSetObject(material);
-      }
-      detail::JsonPushBack(materials, std::move(material));
+bool CompileAnimation(const Model &model, int animation, AnimationClip *clip,
+                      std::string *err) {
+  if (!clip) {
+    return false;
+  }
+  if (animation < 0 || size_t(animation) >= model.animations.size()) {
+    if (err) {
+      (*err) += "animation[" + std::to_string(animation) +
+                "] does not exist.\n";
     }
-    detail::JsonAddMember(o, "materials", std::move(materials));
+    return false;
   }
+  const Animation &anim = model.animations[size_t(animation)];
+  const auto fail = [&](size_t channel, const std::string &msg) {
+    if (err) {
+      (*err) += "animation[" + std::to_string(animation) + "].channels[" +
+                std::to_string(channel) + "]: " + msg + ".\n";
+    }
+    return false;
+  };
 
-  // MESHES
-  if (model->meshes.size()) {
-    detail::json meshes;
-    detail::JsonReserveArray(meshes, model->meshes.size());
-    for (unsigned int i = 0; i < model->meshes.size(); ++i) {
-      detail::json mesh;
-      SerializeGltfMesh(model->meshes[i], mesh);
-      detail::JsonPushBack(meshes, std::move(mesh));
+  AnimationClip out;
+  std::map<int, size_t> inputs;   // accessor -> offset in `times`
+  std::map<int, size_t> outputs;  // accessor -> offset in `values`
+  size_t num_times = 0, num_values = 0;
+  for (size_t c = 0; c < anim.channels.size(); c++) {
+    const AnimationChannel &channel = anim.channels[c];
+    if (channel.target_node < 0) {
+      continue;  // e.g. KHR_animation_pointer
     }
-    detail::JsonAddMember(o, "meshes", std::move(meshes));
+    AnimationClipChannel ch;
+    ch.node = channel.target_node;
+    if (channel.target_path == "translation") {
+      ch.path = ANIMATION_PATH_TRANSLATION;
+    } else if (channel.target_path == "rotation") {
+      ch.path = ANIMATION_PATH_ROTATION;
+    } else if (channel.target_path == "scale") {
+      ch.path = ANIMATION_PATH_SCALE;
+    } else if (channel.target_path == "weights") {
+      ch.path = ANIMATION_PATH_WEIGHTS;
+    } else {
+      continue;
+    }
+    if (size_t(channel.target_node) >= model.nodes.size()) {
+      return fail(c, "invalid target node");
+    }
+    if (channel.sampler < 0 || size_t(channel.sampler) >= anim.samplers.size()) {
+      return fail(c, "invalid sampler");
+    }
+    const AnimationSampler &sampler = anim.samplers[size_t(channel.sampler)];
+    if (sampler.interpolation == "LINEAR") {
+      ch.interpolation = ANIMATION_INTERPOLATION_LINEAR;
+    } else if (sampler.interpolation == "STEP") {
+      ch.interpolation = ANIMATION_INTERPOLATION_STEP;
+    } else if (sampler.interpolation == "CUBICSPLINE") {
+      ch.interpolation = ANIMATION_INTERPOLATION_CUBICSPLINE;
+    } else {
+      return fail(c, "unsupported interpolation '" + sampler.interpolation +
+                         "'");
+    }
+    if (sampler.input < 0 || size_t(sampler.input) >= model.accessors.size() ||
+        sampler.output < 0 ||
+        size_t(sampler.output) >= model.accessors.size()) {
+      return fail(c, "invalid sampler accessor");
+    }
+    const Accessor &input = model.accessors[size_t(sampler.input)];
+    const Accessor &output = model.accessors[size_t(sampler.output)];
+    const size_t per_key =
+        ch.interpolation == ANIMATION_INTERPOLATION_CUBICSPLINE ? 3 : 1;
+    if (input.type != TINYGLTF_TYPE_SCALAR || input.count == 0) {
+      return fail(c, "invalid sampler input");
+    }
+    ch.num_keys = input.count;
+    const int expected_type =
+        ch.path == ANIMATION_PATH_ROTATION
+            ? TINYGLTF_TYPE_VEC4
+            : (ch.path == ANIMATION_PATH_WEIGHTS ? TINYGLTF_TYPE_SCALAR
+                                                 : TINYGLTF_TYPE_VEC3);
+    if (output.type != expected_type) {
+      return fail(c, "invalid sampler output type");
+    }
+    if (ch.path == ANIMATION_PATH_WEIGHTS) {
+      ch.components = output.count / (ch.num_keys * per_key);
+    } else {
+      ch.components = size_t(GetNumComponentsInType(uint32_t(output.type)));
+    }
+    if (ch.components == 0 ||
+        output.count * size_t(GetNumComponentsInType(uint32_t(output.type))) !=
+            ch.num_keys * per_key * ch.components) {
+      return fail(c, "sampler input and output counts do not match");
+    }
+
+    auto in = inputs.find(sampler.input);
+    if (in == inputs.end()) {
+      in = inputs.emplace(sampler.input, num_times).first;
+      num_times += input.count;
+    }
+    ch.input = in->second;
+    auto out_values = outputs.find(sampler.output);
+    if (out_values == outputs.end()) {
+      out_values = outputs.emplace(sampler.output, num_values).first;
+      num_values += ch.num_keys * per_key * ch.components;
+    }
+    ch.output = out_values->second;
+    ch.pose_offset = out.pose_size;
+    out.pose_size += ch.components;
+    if (ch.path == ANIMATION_PATH_ROTATION &&
+        ch.interpolation == ANIMATION_INTERPOLATION_LINEAR) {
+      out.slerp_channels.push_back(out.channels.size());
+    }
+    out.channels.push_back(ch);
   }
 
-  // NODES
-  if (model->nodes.size()) {
-    detail::json nodes;
-    detail::JsonReserveArray(nodes, model->nodes.size());
-    for (unsigned int i = 0; i < model->nodes.size(); ++i) {
-      detail::json node;
-      SerializeGltfNode(model->nodes[i], node);
+  out.times.resize(num_times);
+  out.values.resize(num_values);
+  std::vector<AccessorFloatTarget> targets;
+  for (const auto &in : inputs) {
+    AccessorFloatTarget target;
+    target.accessor = in.first;
+    target.dst = out.times.data() + in.second;
+    targets.push_back(target);
+  }
+  for (const auto &o : outputs) {
+    AccessorFloatTarget target;
+    target.accessor = o.first;
+    target.dst = out.values.data() + o.second;
+    targets.push_back(target);
+  }
+  if (!ConvertAccessorsToFloat(model, targets, err, 1)) {
+    return false;
+  }
+  if (!out.times.empty()) {
+    out.start_time = *std::min_element(out.times.begin(), out.times.end());
+    out.end_time = *std::max_element(out.times.begin(), out.times.end());
+  }
+  *clip = std::move(out);
+  return true;
+}
 
-      if (detail::JsonIsNull(node)) {
-        // Issue 457.
-        // `node` does not have any required parameters,
-        // so the result may be null(unmodified) when all node parameters
-        // have default value.
-        //
-        // null is not allowed thus we create an empty JSON object.
-        detail::JsonSetObject(node);
+//
+// Returns `k` in [0, n - 2] with times[k] <= time < times[k + 1](clamped at
+// both ends). Starts from the key of the previous lookup: a few linear steps
+// forward, then a binary search.
+//
+static size_t FindAnimationKey(const float *times, size_t n, float time,
+                               size_t hint) {
+  if (time <= times[0]) {
+    return 0;
+  }
+  if (time >= times[n - 1]) {
+    return n - 2;
+  }
+  size_t k = hint < n - 1 ? hint : 0;
+  if (times[k] <= time) {
+    for (int step = 0; step < 4; step++, k++) {
+      if (time < times[k + 1]) {
+        return k;
       }
-      detail::JsonPushBack(nodes, std::move(node));
     }
-    detail::JsonAddMember(o, "nodes", std::move(nodes));
+    k = size_t(std::upper_bound(times + k, times + n, time) - times) - 1;
+  } else {
+    k = size_t(std::upper_bound(times, times + k + 1, time) - times);
+    k = k > 0 ? k - 1 : 0;
   }
+  return (std::min)(k, n - 2);
+}
 
-  // SCENE
-  if (model->defaultScene > -1) {
-    SerializeNumberProperty<int>("scene", model->defaultScene, o);
+// sin(x) for x in [0, pi/2](Taylor series, error < 6e-8).
+static inline SimdF4 F4SinHalfPi(SimdF4 x) {
+  const SimdF4 x2 = F4Mul(x, x);
+  SimdF4 p = F4Set(-2.5052108e-8f);
+  p = F4Add(F4Mul(p, x2), F4Set(2.7557319e-6f));
+  p = F4Add(F4Mul(p, x2), F4Set(-1.9841270e-4f));
+  p = F4Add(F4Mul(p, x2), F4Set(8.3333333e-3f));
+  p = F4Add(F4Mul(p, x2), F4Set(-1.6666667e-1f));
+  p = F4Add(F4Mul(p, x2), F4Set(1.0f));
+  return F4Mul(p, x);
+}
+
+//
+// Slerp of 4 quaternion pairs in SoA layout(x[4], y[4], z[4], w[4]) with
+// weights `t`. Nearly identical rotations fall back to normalized lerp.
+//
+static void SlerpQuaternions4(const float *q0, const float *q1,
+                              const float *t, float *out) {
+  const SimdF4 one = F4Set(1.0f);
+  SimdF4 a[4], b[4];
+  for (int i = 0; i < 4; i++) {
+    a[i] = F4LoadFloat(q0 + 4 * i);
+    b[i] = F4LoadFloat(q1 + 4 * i);
+  }
+  const SimdF4 u = F4LoadFloat(t);
+  SimdF4 d = F4Mul(a[0], b[0]);
+  for (int i = 1; i < 4; i++) {
+    d = F4Add(d, F4Mul(a[i], b[i]));
+  }
+  // Shortest path: negate q1 when the dot product is negative.
+  const SimdF4 sign = F4SelectNonNeg(d, one, F4Set(-1.0f));
+  d = F4Min(F4Abs(d), one);
+
+  // acos(d) for d in [0, 1](Abramowitz and Stegun 4.4.46, error < 2e-8).
+  SimdF4 p = F4Set(-0.0012624911f);
+  p = F4Add(F4Mul(p, d), F4Set(0.0066700901f));
+  p = F4Add(F4Mul(p, d), F4Set(-0.0170881256f));
+  p = F4Add(F4Mul(p, d), F4Set(0.0308918810f));
+  p = F4Add(F4Mul(p, d), F4Set(-0.0501743046f));
+  p = F4Add(F4Mul(p, d), F4Set(0.0889789874f));
+  p = F4Add(F4Mul(p, d), F4Set(-0.2145988016f));
+  p = F4Add(F4Mul(p, d), F4Set(1.5707963050f));
+  const SimdF4 theta = F4Mul(F4Sqrt(F4Sub(one, d)), p);
+
+  const SimdF4 sin_theta = F4SinHalfPi(theta);
+  SimdF4 s0 = F4Div(F4SinHalfPi(F4Mul(F4Sub(one, u), theta)), sin_theta);
+  SimdF4 s1 = F4Div(F4SinHalfPi(F4Mul(u, theta)), sin_theta);
+  const SimdF4 nearly_parallel = F4Sub(d, F4Set(0.9995f));
+  s0 = F4SelectNonNeg(nearly_parallel, F4Sub(one, u), s0);
+  s1 = F4Mul(F4SelectNonNeg(nearly_parallel, u, s1), sign);
+
+  SimdF4 r[4];
+  SimdF4 len2 = F4Set(0.0f);
+  for (int i = 0; i < 4; i++) {
+    r[i] = F4Add(F4Mul(a[i], s0), F4Mul(b[i], s1));
+    len2 = F4Add(len2, F4Mul(r[i], r[i]));
+  }
+  const SimdF4 inv_len = F4Div(one, F4Sqrt(len2));
+  for (int i = 0; i < 4; i++) {
+    F4StoreFloat(F4Mul(r[i], inv_len), out + 4 * i);
   }
+}
 
-  // SCENES
-  if (model->scenes.size()) {
-    detail::json scenes;
-    detail::JsonReserveArray(scenes, model->scenes.size());
-    for (unsigned int i = 0; i < model->scenes.size(); ++i) {
-      detail::json currentScene;
-      SerializeGltfScene(model->scenes[i], currentScene);
-      if (detail::JsonIsNull(currentScene)) {
-        // Issue 464.
-        // `scene` does not have any required parameters,
-        // so the result may be null(unmodified) when all scene parameters
-        // have default value.
-        //
-        // null is not allowed thus we create an empty JSON object.
-        detail::JsonSetObject(currentScene);
+void SampleAnimation(const AnimationClip &clip, float time,
+                     AnimationCursor *cursor, float *pose) {
+  if (!cursor || !pose) {
+    return;
+  }
+  cursor->keys.resize(clip.channels.size(), 0);
+  cursor->from.resize(clip.pose_size);
+  cursor->to.resize(clip.pose_size);
+  cursor->weights.resize(clip.pose_size);
+
+  // Key lookup per channel. Every channel is expressed as a lerp from `from`
+  // to `to` by `weights`: STEP and CUBICSPLINE channels are evaluated here
+  // and get weight 0.
+  for (size_t c = 0; c < clip.channels.size(); c++) {
+    const AnimationClipChannel &ch = clip.channels[c];
+    const float *times = clip.times.data() + ch.input;
+    const size_t nc = ch.components;
+    size_t k = 0;
+    float u = 0.0f, dt = 0.0f;
+    if (ch.num_keys > 1) {
+      k = FindAnimationKey(times, ch.num_keys, time, cursor->keys[c]);
+      cursor->keys[c] = k;
+      dt = times[k + 1] - times[k];
+      u = dt > 0.0f ? (time - times[k]) / dt : 0.0f;
+      u = (std::min)((std::max)(u, 0.0f), 1.0f);
+    }
+    float *from = cursor->from.data() + ch.pose_offset;
+    float *to = cursor->to.data() + ch.pose_offset;
+    float *w = cursor->weights.data() + ch.pose_offset;
+    const bool cubic = ch.interpolation == ANIMATION_INTERPOLATION_CUBICSPLINE;
+    const size_t stride = (cubic ? 3 : 1) * nc;
+    const float *v0 = clip.values.data() + ch.output + k * stride;
+    const float *v1 = ch.num_keys > 1 ? v0 + stride : v0;
+
+    if (ch.interpolation == ANIMATION_INTERPOLATION_LINEAR) {
+      std::copy(v0, v0 + nc, from);
+      std::copy(v1, v1 + nc, to);
+      std::fill(w, w + nc, u);
+      continue;
+    }
+    if (!cubic) {
+      const float *v = u >= 1.0f ? v1 : v0;
+      std::copy(v, v + nc, from);
+    } else {
+      // Hermite spline of (value k, out-tangent k, value k + 1,
+      // in-tangent k + 1).
+      const float u2 = u * u, u3 = u2 * u;
+      const float h00 = 2.0f * u3 - 3.0f * u2 + 1.0f;
+      const float h10 = (u3 - 2.0f * u2 + u) * dt;
+      const float h01 = -2.0f * u3 + 3.0f * u2;
+      const float h11 = (u3 - u2) * dt;
+      for (size_t i = 0; i < nc; i++) {
+        from[i] = h00 * v0[nc + i] + h10 * v0[2 * nc + i] +
+                  h01 * v1[nc + i] + h11 * v1[i];
+      }
+      if (ch.path == ANIMATION_PATH_ROTATION) {
+        const float len = std::sqrt(from[0] * from[0] + from[1] * from[1] +
+                                    from[2] * from[2] + from[3] * from[3]);
+        if (len > 0.0f) {
+          for (size_t i = 0; i < 4; i++) {
+            from[i] /= len;
+          }
+        }
+      }
+    }
+    std::copy(from, from + nc, to);
+    std::fill(w, w + nc, 0.0f);
+  }
+
+  // Lerp of all values, 4 at a time.
+  const float *from = cursor->from.data();
+  const float *to = cursor->to.data();
+  const float *weights = cursor->weights.data();
+  size_t i = 0;
+  for (; i + 4 <= clip.pose_size; i += 4) {
+    const SimdF4 a = F4LoadFloat(from + i);
+    F4StoreFloat(
+        F4Add(a, F4Mul(F4LoadFloat(weights + i),
+                       F4Sub(F4LoadFloat(to + i), a))),
+        pose + i);
+  }
+  for (; i < clip.pose_size; i++) {
+    pose[i] = from[i] + weights[i] * (to[i] - from[i]);
+  }
+
+  // Slerp of LINEAR rotations, 4 channels at a time(unused lanes repeat the
+  // first channel of the group).
+  for (size_t g = 0; g < clip.slerp_channels.size(); g += 4) {
+    float q0[16], q1[16], t[4], r[16];
+    size_t offsets[4];
+    for (size_t lane = 0; lane < 4; lane++) {
+      const size_t c = g + lane < clip.slerp_channels.size() ? g + lane : g;
+      offsets[lane] = clip.channels[clip.slerp_channels[c]].pose_offset;
+      for (size_t j = 0; j < 4; j++) {
+        q0[4 * j + lane] = from[offsets[lane] + j];
+        q1[4 * j + lane] = to[offsets[lane] + j];
+      }
+      t[lane] = weights[offsets[lane]];
+    }
+    SlerpQuaternions4(q0, q1, t, r);
+    const size_t lanes = (std::min)(size_t(4), clip.slerp_channels.size() - g);
+    for (size_t lane = 0; lane < lanes; lane++) {
+      for (size_t j = 0; j < 4; j++) {
+        pose[offsets[lane] + j] = r[4 * j + lane];
       }
-      detail::JsonPushBack(scenes, std::move(currentScene));
     }
-    detail::JsonAddMember(o, "scenes", std::move(scenes));
   }
+}
 
-  // SKINS
-  if (model->skins.size()) {
-    detail::json skins;
-    detail::JsonReserveArray(skins, model->skins.size());
-    for (unsigned int i = 0; i < model->skins.size(); ++i) {
-      detail::json skin;
-      SerializeGltfSkin(model->skins[i], skin);
-      detail::JsonPushBack(skins, std::move(skin));
+void ApplyAnimationPose(const AnimationClip &clip, const float *pose,
+                        Model *model) {
+  if (!pose || !model) {
+    return;
+  }
+  for (const AnimationClipChannel &ch : clip.channels) {
+    if (ch.node < 0 || size_t(ch.node) >= model->nodes.size()) {
+      continue;
     }
-    detail::JsonAddMember(o, "skins", std::move(skins));
+    Node &node = model->nodes[size_t(ch.node)];
+    std::vector<double> *dst = &node.translation;
+    if (ch.path == ANIMATION_PATH_ROTATION) {
+      dst = &node.rotation;
+    } else if (ch.path == ANIMATION_PATH_SCALE) {
+      dst = &node.scale;
+    } else if (ch.path == ANIMATION_PATH_WEIGHTS) {
+      dst = &node.weights;
+    }
+    dst->assign(pose + ch.pose_offset, pose + ch.pose_offset + ch.components);
+  }
+}
+
+void ApplyAnimationPose(const AnimationClip &clip, const float *pose,
+                        FlatScene *scene) {
+  if (!pose || !scene) {
+    return;
+  }
+  scene->dirty.resize(scene->nodes.size(), 0);
+  for (const AnimationClipChannel &ch : clip.channels) {
+    if (ch.path == ANIMATION_PATH_WEIGHTS || ch.node < 0 ||
+        size_t(ch.node) >= scene->node_entries.size() ||
+        scene->node_entries[size_t(ch.node)] < 0) {
+      continue;
+    }
+    const size_t e = size_t(scene->node_entries[size_t(ch.node)]);
+    double *dst = &scene->translations[3 * e];
+    if (ch.path == ANIMATION_PATH_ROTATION) {
+      dst = &scene->rotations[4 * e];
+    } else if (ch.path == ANIMATION_PATH_SCALE) {
+      dst = &scene->scales[3 * e];
+    }
+    std::copy(pose + ch.pose_offset, pose + ch.pose_offset + ch.components,
+              dst);
+    scene->dirty[e] = 1;
   }
+}
 
-  // TEXTURES
-  if (model->textures.size()) {
-    detail::json textures;
-    detail::JsonReserveArray(textures, model->textures.size());
-    for (unsigned int i = 0; i < model->textures.size(); ++i) {
-      detail::json texture;
-      SerializeGltfTexture(model->textures[i], texture);
-      detail::JsonPushBack(textures, std::move(texture));
+//
+// Animation keyframe reduction.
+//
+
+// Slerp of unit quaternions in double precision.
+static void SlerpQuaternion(const double *a, const double *b, double u,
+                            double *out) {
+  double d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  const double sign = d < 0.0 ? -1.0 : 1.0;
+  d = (std::min)(std::fabs(d), 1.0);
+  double w0 = 1.0 - u, w1 = u;
+  if (d < 0.9995) {
+    const double theta = std::acos(d);
+    const double sin_theta = std::sin(theta);
+    w0 = std::sin((1.0 - u) * theta) / sin_theta;
+    w1 = std::sin(u * theta) / sin_theta;
+  }
+  double len2 = 0.0;
+  for (int i = 0; i < 4; i++) {
+    out[i] = w0 * a[i] + sign * w1 * b[i];
+    len2 += out[i] * out[i];
+  }
+  if (len2 > 0.0) {
+    const double inv_len = 1.0 / std::sqrt(len2);
+    for (int i = 0; i < 4; i++) {
+      out[i] *= inv_len;
     }
-    detail::JsonAddMember(o, "textures", std::move(textures));
   }
+}
 
-  // SAMPLERS
-  if (model->samplers.size()) {
-    detail::json samplers;
-    detail::JsonReserveArray(samplers, model->samplers.size());
-    for (unsigned int i = 0; i < model->samplers.size(); ++i) {
-      detail::json sampler;
-      SerializeGltfSampler(model->samplers[i], sampler);
-      detail::JsonPushBack(samplers, std::move(sampler));
+// Value between keys `a` and `b`(`u` in [0, 1]) of a LINEAR or STEP sampler.
+static void InterpolateKeyValues(const double *a, const double *b, double u,
+                                 size_t nc, AnimationPath path, bool step,
+                                 double *out) {
+  if (step || u <= 0.0) {
+    std::copy(a, a + nc, out);
+  } else if (path == ANIMATION_PATH_ROTATION) {
+    SlerpQuaternion(a, b, u, out);
+  } else {
+    for (size_t i = 0; i < nc; i++) {
+      out[i] = a[i] + u * (b[i] - a[i]);
     }
-    detail::JsonAddMember(o, "samplers", std::move(samplers));
   }
+}
 
-  // CAMERAS
-  if (model->cameras.size()) {
-    detail::json cameras;
-    detail::JsonReserveArray(cameras, model->cameras.size());
-    for (unsigned int i = 0; i < model->cameras.size(); ++i) {
-      detail::json camera;
-      SerializeGltfCamera(model->cameras[i], camera);
-      detail::JsonPushBack(cameras, std::move(camera));
+// Error of `value` against the original `expected`, in the metric of `path`.
+static double KeyValueError(const double *value, const double *expected,
+                            size_t nc, AnimationPath path) {
+  if (path == ANIMATION_PATH_ROTATION) {
+    double d = 0.0, l0 = 0.0, l1 = 0.0;
+    for (size_t i = 0; i < 4; i++) {
+      d += value[i] * expected[i];
+      l0 += value[i] * value[i];
+      l1 += expected[i] * expected[i];
     }
-    detail::JsonAddMember(o, "cameras", std::move(cameras));
+    if (l0 <= 0.0 || l1 <= 0.0) {
+      return l0 == l1 ? 0.0 : 3.14159265358979;
+    }
+    return 2.0 * std::acos((std::min)(std::fabs(d) / std::sqrt(l0 * l1), 1.0));
   }
+  double e = 0.0;
+  for (size_t i = 0; i < nc; i++) {
+    const double diff = value[i] - expected[i];
+    e = path == ANIMATION_PATH_WEIGHTS ? (std::max)(e, std::fabs(diff))
+                                       : e + diff * diff;
+  }
+  return path == ANIMATION_PATH_WEIGHTS ? e : std::sqrt(e);
+}
 
-  // EXTRAS & EXTENSIONS
-  SerializeExtrasAndExtensions(*model, o);
-
-  auto extensionsUsed = model->extensionsUsed;
+bool OptimizeAnimations(Model *model, const AnimationOptimizeOptions &options,
+                        std::string *err, AnimationOptimizeReport *report) {
+  if (!model) {
+    return false;
+  }
+  struct Track {
+    size_t animation;
+    size_t sampler;
+    AnimationPath path;
+    bool step;
+    size_t components;
+    int type;
+    std::vector<double> values;  // `components` per key
+  };
+  struct Group {
+    int input;
+    std::vector<Track> tracks;
+    bool skip;
+    std::vector<double> times;
+    bool changed;
+  };
 
-  // LIGHTS as KHR_lights_punctual
-  if (model->lights.size()) {
-    detail::json lights;
-    detail::JsonReserveArray(lights, model->lights.size());
-    for (unsigned int i = 0; i < model->lights.size(); ++i) {
-      detail::json light;
-      SerializeGltfLight(model->lights[i], light);
-      detail::JsonPushBack(lights, std::move(light));
+  const auto buffer_bytes = [model]() {
+    size_t bytes = 0;
+    for (const Buffer &buffer : model->buffers) {
+      bytes += buffer.data.size();
     }
-    detail::json khr_lights_cmn;
-    detail::JsonAddMember(khr_lights_cmn, "lights", std::move(lights));
-    detail::json ext_j;
-
-    {
-      detail::json_const_iterator it;
-      if (detail::FindMember(o, "extensions", it)) {
-        detail::JsonAssign(ext_j, detail::GetValue(it));
+    return bytes;
+  };
+  AnimationOptimizeReport r;
+  r.bytes_before = buffer_bytes();
+
+  // The input/output accessors of rewritten samplers are reclaimed
+  // afterwards.
+  BufferReferences references;
+  if (options.compact_buffers) {
+    CollectBufferReferences(*model, &references);
+  }
+
+  // Samplers grouped by input accessor. The target path of a sampler comes
+  // from the channels which use it.
+  std::vector<Group> groups;
+  std::map<int, size_t> input_groups;
+  for (size_t a = 0; a < model->animations.size(); a++) {
+    const Animation &animation = model->animations[a];
+    std::vector<int> paths(animation.samplers.size(), -1);
+    for (const AnimationChannel &channel : animation.channels) {
+      int path = -1;
+      if (channel.target_path == "translation") {
+        path = ANIMATION_PATH_TRANSLATION;
+      } else if (channel.target_path == "rotation") {
+        path = ANIMATION_PATH_ROTATION;
+      } else if (channel.target_path == "scale") {
+        path = ANIMATION_PATH_SCALE;
+      } else if (channel.target_path == "weights") {
+        path = ANIMATION_PATH_WEIGHTS;
+      }
+      if (channel.sampler < 0 ||
+          size_t(channel.sampler) >= animation.samplers.size()) {
+        if (err) {
+          (*err) += "animation[" + std::to_string(a) +
+                    "]: invalid channel sampler.\n";
+        }
+        return false;
+      }
+      int &sampler_path = paths[size_t(channel.sampler)];
+      // A sampler used with several paths(or KHR_animation_pointer) is kept.
+      sampler_path = (sampler_path == -1 || sampler_path == path) ? path : -2;
+      if (path < 0) {
+        sampler_path = -2;
       }
     }
-
-    detail::JsonAddMember(ext_j, "KHR_lights_punctual",
-                          std::move(khr_lights_cmn));
-
-    detail::JsonAddMember(o, "extensions", std::move(ext_j));
-
-    // Also add "KHR_lights_punctual" to `extensionsUsed`
-    {
-      auto has_khr_lights_punctual =
-          std::find_if(extensionsUsed.begin(), extensionsUsed.end(),
-                       [](const std::string &s) {
-                         return (s.compare("KHR_lights_punctual") == 0);
-                       });
-
-      if (has_khr_lights_punctual == extensionsUsed.end()) {
-        extensionsUsed.push_back("KHR_lights_punctual");
+    for (size_t s = 0; s < animation.samplers.size(); s++) {
+      const AnimationSampler &sampler = animation.samplers[s];
+      if (sampler.input < 0 || size_t(sampler.input) >= model->accessors.size() ||
+          sampler.output < 0 ||
+          size_t(sampler.output) >= model->accessors.size()) {
+        if (err) {
+          (*err) += "animation[" + std::to_string(a) + "].samplers[" +
+                    std::to_string(s) + "]: invalid accessor.\n";
+        }
+        return false;
+      }
+      auto it = input_groups.find(sampler.input);
+      if (it == input_groups.end()) {
+        it = input_groups.emplace(sampler.input, groups.size()).first;
+        groups.emplace_back();
+        groups.back().input = sampler.input;
+        groups.back().skip = false;
+        groups.back().changed = false;
+      }
+      Group &group = groups[it->second];
+      const Accessor &input = model->accessors[size_t(sampler.input)];
+      const Accessor &output = model->accessors[size_t(sampler.output)];
+      const int num_components = GetNumComponentsInType(uint32_t(output.type));
+      Track track;
+      track.animation = a;
+      track.sampler = s;
+      track.path = AnimationPath(paths[s] < 0 ? 0 : paths[s]);
+      track.step = sampler.interpolation == "STEP";
+      track.type = output.type;
+      track.components =
+          track.path == ANIMATION_PATH_WEIGHTS && input.count > 0
+              ? output.count / input.count
+              : size_t(num_components > 0 ? num_components : 0);
+      if (paths[s] < 0 ||
+          (!track.step && sampler.interpolation != "LINEAR") ||
+          input.type != TINYGLTF_TYPE_SCALAR || input.count == 0 ||
+          input.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+          output.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+          track.components == 0 ||
+          output.count * size_t(num_components) !=
+              input.count * track.components) {
+        group.skip = true;
       }
+      group.tracks.emplace_back(std::move(track));
     }
   }
 
-  // KHR_audio
-  if (!model->audioEmitters.empty() || !model->audioSources.empty()) {
-    detail::json emitters;
-    detail::JsonReserveArray(emitters, model->audioEmitters.size());
-    for (unsigned int i = 0; i < model->audioEmitters.size(); ++i) {
-      detail::json emitter;
-      SerializeGltfAudioEmitter(model->audioEmitters[i], emitter);
-      detail::JsonPushBack(emitters, std::move(emitter));
+  std::vector<std::string> errors(groups.size());
+  detail::ParallelFor(groups.size(), options.num_threads, [&](size_t g) {
+    Group &group = groups[g];
+    if (group.skip) {
+      return;
     }
-    detail::json khr_audio_cmn;
-    detail::JsonAddMember(khr_audio_cmn, "emitters", std::move(emitters));
-
-    detail::json sources;
-    detail::JsonReserveArray(sources, model->audioSources.size());
-    for (unsigned int i = 0; i < model->audioSources.size(); ++i) {
-      detail::json source;
-      SerializeGltfAudioSource(model->audioSources[i], source);
-      detail::JsonPushBack(sources, std::move(source));
+    const size_t n = model->accessors[size_t(group.input)].count;
+    std::vector<float> data(n);
+    std::vector<AccessorFloatTarget> targets(1);
+    targets[0].accessor = group.input;
+    targets[0].dst = data.data();
+    if (!ConvertAccessorsToFloat(*model, targets, &errors[g], 1)) {
+      return;
     }
-    detail::JsonAddMember(khr_audio_cmn, "sources", std::move(sources));
-
-    detail::json ext_j;
-    {
-      detail::json_const_iterator it;
-      if (detail::FindMember(o, "extensions", it)) {
-        detail::JsonAssign(ext_j, detail::GetValue(it));
+    group.times.assign(data.begin(), data.end());
+    for (Track &track : group.tracks) {
+      data.resize(n * track.components);
+      targets[0].accessor =
+          model->animations[track.animation].samplers[track.sampler].output;
+      targets[0].dst = data.data();
+      if (!ConvertAccessorsToFloat(*model, targets, &errors[g], 1)) {
+        return;
       }
+      track.values.assign(data.begin(), data.end());
     }
 
-    detail::JsonAddMember(ext_j, "KHR_audio", std::move(khr_audio_cmn));
-
-    detail::JsonAddMember(o, "extensions", std::move(ext_j));
-
-    // Also add "KHR_audio" to `extensionsUsed`
-    {
-      auto has_khr_audio = std::find_if(
-          extensionsUsed.begin(), extensionsUsed.end(),
-          [](const std::string &s) { return (s.compare("KHR_audio") == 0); });
-
-      if (has_khr_audio == extensionsUsed.end()) {
-        extensionsUsed.push_back("KHR_audio");
+    // Resampling to a uniform grid(STEP samplers are not resampled).
+    bool has_step = false;
+    for (const Track &track : group.tracks) {
+      has_step = has_step || track.step;
+    }
+    const double duration = group.times.back() - group.times.front();
+    if (options.resample_rate > 0.0 && !has_step && duration > 0.0) {
+      const size_t intervals =
+          size_t(std::ceil(duration * options.resample_rate - 1e-9));
+      if (intervals + 1 < n) {
+        std::vector<double> times(intervals + 1);
+        for (size_t i = 0; i <= intervals; i++) {
+          times[i] = group.times.front() + duration * double(i) /
+                                               double(intervals);
+        }
+        times.back() = group.times.back();
+        for (Track &track : group.tracks) {
+          const size_t nc = track.components;
+          std::vector<double> values(times.size() * nc);
+          size_t k = 0;
+          for (size_t i = 0; i < times.size(); i++) {
+            while (k + 2 < n && group.times[k + 1] <= times[i]) {
+              k++;
+            }
+            const double t0 = group.times[k], t1 = group.times[k + 1];
+            double u = t1 > t0 ? (times[i] - t0) / (t1 - t0) : 0.0;
+            u = (std::min)((std::max)(u, 0.0), 1.0);
+            InterpolateKeyValues(&track.values[k * nc],
+                                 &track.values[(k + 1) * nc], u, nc,
+                                 track.path, false, &values[i * nc]);
+          }
+          track.values.swap(values);
+        }
+        group.times.swap(times);
+        group.changed = true;
       }
     }
-  }
-
-  // MSFT_lod
-
-  // Look if there is a node that employs MSFT_lod
-  auto msft_lod_nodes_it = std::find_if(
-    model->nodes.begin(), model->nodes.end(),
-    [](const Node& node) { return !node.lods.empty(); });
-
-  // Look if there is a material that employs MSFT_lod
-  auto msft_lod_materials_it = std::find_if(
-    model->materials.begin(), model->materials.end(),
-    [](const Material& material) {return !material.lods.empty(); });
 
-  // If either a node or a material employ MSFT_lod, then we need
-  // to add MSFT_lod to the list of used extensions.
-  if (msft_lod_nodes_it != model->nodes.end() || msft_lod_materials_it != model->materials.end()) {
-    // First check if MSFT_lod is already registered as used extension
-    auto has_msft_lod = std::find_if(
-      extensionsUsed.begin(), extensionsUsed.end(),
-      [](const std::string &s) { return (s.compare("MSFT_lod") == 0); });
+    // Greedy reduction: extend the segment from the last kept key while every
+    // sampler reproduces the skipped keys.
+    const size_t num_keys = group.times.size();
+    std::vector<double> value;
+    const auto segment_fits = [&](size_t a, size_t b) {
+      const double ta = group.times[a], tb = group.times[b];
+      for (const Track &track : group.tracks) {
+        const size_t nc = track.components;
+        const double tolerance =
+            track.path == ANIMATION_PATH_TRANSLATION
+                ? options.translation_tolerance
+                : (track.path == ANIMATION_PATH_ROTATION
+                       ? options.rotation_tolerance
+                       : (track.path == ANIMATION_PATH_SCALE
+                              ? options.scale_tolerance
+                              : options.weights_tolerance));
+        value.resize(nc);
+        for (size_t k = a + 1; k < b; k++) {
+          const double u = tb > ta ? (group.times[k] - ta) / (tb - ta) : 0.0;
+          InterpolateKeyValues(&track.values[a * nc], &track.values[b * nc],
+                               u, nc, track.path, track.step, value.data());
+          if (KeyValueError(value.data(), &track.values[k * nc], nc,
+                            track.path) > tolerance) {
+            return false;
+          }
+        }
+      }
+      return true;
+    };
+    std::vector<size_t> kept(1, 0);
+    for (size_t a = 0; a + 1 < num_keys;) {
+      size_t b = a + 1;
+      while (b + 1 < num_keys && segment_fits(a, b + 1)) {
+        b++;
+      }
+      kept.push_back(b);
+      a = b;
+    }
+    if (kept.size() == num_keys) {
+      return;
+    }
+    std::vector<double> times(kept.size());
+    for (size_t i = 0; i < kept.size(); i++) {
+      times[i] = group.times[kept[i]];
+    }
+    group.times.swap(times);
+    for (Track &track : group.tracks) {
+      const size_t nc = track.components;
+      std::vector<double> values(kept.size() * nc);
+      for (size_t i = 0; i < kept.size(); i++) {
+        std::copy(&track.values[kept[i] * nc],
+                  &track.values[kept[i] * nc] + nc, &values[i * nc]);
+      }
+      track.values.swap(values);
+    }
+    group.changed = true;
+  });
 
-    // If MSFT_lod is not registered yet, add it
-    if (has_msft_lod == extensionsUsed.end()) {
-      extensionsUsed.push_back("MSFT_lod");
+  bool success = true;
+  for (size_t g = 0; g < groups.size(); g++) {
+    Group &group = groups[g];
+    if (!errors[g].empty()) {
+      if (err) {
+        (*err) += errors[g];
+      }
+      success = false;
+      continue;
+    }
+    if (group.skip || !group.changed) {
+      continue;
+    }
+    const size_t keys_before = model->accessors[size_t(group.input)].count;
+    const size_t keys_after = group.times.size();
+
+    std::vector<float> data(group.times.begin(), group.times.end());
+    Accessor input;
+    input.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    input.type = TINYGLTF_TYPE_SCALAR;
+    input.count = keys_after;
+    input.minValues.push_back(double(data.front()));
+    input.maxValues.push_back(double(data.back()));
+    input.bufferView =
+        AppendBufferView(model, reinterpret_cast<const unsigned char *>(
+                                    data.data()),
+                         data.size() * sizeof(float), 0);
+    model->accessors.emplace_back(std::move(input));
+    const int input_idx = int(model->accessors.size() - 1);
+
+    for (const Track &track : group.tracks) {
+      data.assign(track.values.begin(), track.values.end());
+      Accessor output;
+      output.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+      output.type = track.type;
+      output.count = data.size() / size_t(GetNumComponentsInType(
+                                       uint32_t(track.type)));
+      output.bufferView =
+          AppendBufferView(model, reinterpret_cast<const unsigned char *>(
+                                      data.data()),
+                           data.size() * sizeof(float), 0);
+      model->accessors.emplace_back(std::move(output));
+      AnimationSampler &sampler =
+          model->animations[track.animation].samplers[track.sampler];
+      sampler.input = input_idx;
+      sampler.output = int(model->accessors.size() - 1);
+
+      r.samplers++;
+      r.keys_before += keys_before;
+      r.keys_after += keys_after;
     }
   }
 
-  // Extensions used
-  if (extensionsUsed.size()) {
-    SerializeStringArrayProperty("extensionsUsed", extensionsUsed, o);
+  if (success && options.compact_buffers && r.samplers > 0) {
+    success = CompactBuffers(model, &references, err);
   }
+  r.bytes_after = buffer_bytes();
+  if (r.bytes_after > 0) {
+    r.compression_ratio = double(r.bytes_before) / double(r.bytes_after);
+  }
+  if (report) {
+    *report = r;
+  }
+  return success;
 }
 
-static bool WriteGltfStream(std::ostream &stream, const std::string &content) {
-  stream << content << std::endl;
-  return stream.good();
-}
-
-static bool WriteGltfFile(const std::string &output,
-                          const std::string &content) {
-#ifdef _WIN32
-#if defined(_MSC_VER)
-  std::ofstream gltfFile(UTF8ToWchar(output).c_str());
-#elif defined(__GLIBCXX__)
-  int file_descriptor = _wopen(UTF8ToWchar(output).c_str(),
-                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(
-      file_descriptor, std::ios_base::out | std::ios_base::binary);
-  std::ostream gltfFile(&wfile_buf);
-  if (!wfile_buf.is_open()) return false;
-#else
-  std::ofstream gltfFile(output.c_str());
-  if (!gltfFile.is_open()) return false;
-#endif
-#else
-  std::ofstream gltfFile(output.c_str());
-  if (!gltfFile.is_open()) return false;
-#endif
-  return WriteGltfStream(gltfFile, content);
-}
-
-static bool WriteBinaryGltfStream(std::ostream &stream,
-                                  const std::string &content,
-                                  const std::vector<unsigned char> &binBuffer) {
-  const std::string header = "glTF";
-  const int version = 2;
-
-  const uint32_t content_size = uint32_t(content.size());
-  const uint32_t binBuffer_size = uint32_t(binBuffer.size());
-  // determine number of padding bytes required to ensure 4 byte alignment
-  const uint32_t content_padding_size =
-      content_size % 4 == 0 ? 0 : 4 - content_size % 4;
-  const uint32_t bin_padding_size =
-      binBuffer_size % 4 == 0 ? 0 : 4 - binBuffer_size % 4;
-
-  // 12 bytes for header, JSON content length, 8 bytes for JSON chunk info.
-  // Chunk data must be located at 4-byte boundary, which may require padding
-  const uint32_t length =
-      12 + 8 + content_size + content_padding_size +
-      (binBuffer_size ? (8 + binBuffer_size + bin_padding_size) : 0);
-
-  stream.write(header.c_str(), std::streamsize(header.size()));
-  stream.write(reinterpret_cast<const char *>(&version), sizeof(version));
-  stream.write(reinterpret_cast<const char *>(&length), sizeof(length));
-
-  // JSON chunk info, then JSON data
-  const uint32_t model_length = uint32_t(content.size()) + content_padding_size;
-  const uint32_t model_format = 0x4E4F534A;
-  stream.write(reinterpret_cast<const char *>(&model_length),
-               sizeof(model_length));
-  stream.write(reinterpret_cast<const char *>(&model_format),
-               sizeof(model_format));
-  stream.write(content.c_str(), std::streamsize(content.size()));
+//
+// Skinning palettes.
+//
 
-  // Chunk must be multiplies of 4, so pad with spaces
-  if (content_padding_size > 0) {
-    const std::string padding = std::string(size_t(content_padding_size), ' ');
-    stream.write(padding.c_str(), std::streamsize(padding.size()));
+bool PrepareSkinPalettes(const Model &model, SkinPaletteData *data,
+                         std::string *err) {
+  if (!data) {
+    return false;
   }
-  if (binBuffer.size() > 0) {
-    // BIN chunk info, then BIN data
-    const uint32_t bin_length = uint32_t(binBuffer.size()) + bin_padding_size;
-    const uint32_t bin_format = 0x004e4942;
-    stream.write(reinterpret_cast<const char *>(&bin_length),
-                 sizeof(bin_length));
-    stream.write(reinterpret_cast<const char *>(&bin_format),
-                 sizeof(bin_format));
-    stream.write(reinterpret_cast<const char *>(binBuffer.data()),
-                 std::streamsize(binBuffer.size()));
-    // Chunksize must be multiplies of 4, so pad with zeroes
-    if (bin_padding_size > 0) {
-      const std::vector<unsigned char> padding =
-          std::vector<unsigned char>(size_t(bin_padding_size), 0);
-      stream.write(reinterpret_cast<const char *>(padding.data()),
-                   std::streamsize(padding.size()));
+  SkinPaletteData out;
+  out.skin_offsets.push_back(0);
+  std::vector<std::vector<float>> matrices(model.skins.size());
+  std::vector<AccessorFloatTarget> targets;
+  for (size_t s = 0; s < model.skins.size(); s++) {
+    const Skin &skin = model.skins[s];
+    for (int joint : skin.joints) {
+      if (joint < 0 || size_t(joint) >= model.nodes.size()) {
+        if (err) {
+          (*err) += "skin[" + std::to_string(s) + "]: invalid joint node " +
+                    std::to_string(joint) + ".\n";
+        }
+        return false;
+      }
+    }
+    if (skin.inverseBindMatrices >= 0) {
+      if (size_t(skin.inverseBindMatrices) >= model.accessors.size() ||
+          model.accessors[size_t(skin.inverseBindMatrices)].type !=
+              TINYGLTF_TYPE_MAT4 ||
+          model.accessors[size_t(skin.inverseBindMatrices)].count <
+              skin.joints.size()) {
+        if (err) {
+          (*err) += "skin[" + std::to_string(s) +
+                    "]: invalid inverseBindMatrices.\n";
+        }
+        return false;
+      }
+      // The accessor may have more elements than joints.
+      matrices[s].resize(
+          16 * model.accessors[size_t(skin.inverseBindMatrices)].count);
+      AccessorFloatTarget target;
+      target.accessor = skin.inverseBindMatrices;
+      target.dst = matrices[s].data();
+      targets.push_back(target);
     }
+    out.joints.insert(out.joints.end(), skin.joints.begin(), skin.joints.end());
+    out.skin_offsets.push_back(out.joints.size());
+  }
+  if (!ConvertAccessorsToFloat(model, targets, err, 1)) {
+    return false;
   }
 
-  stream.flush();
-  return stream.good();
+  out.inverse_bind_matrices.resize(16 * out.joints.size());
+  for (size_t s = 0; s < model.skins.size(); s++) {
+    float *dst = out.inverse_bind_matrices.data() + 16 * out.skin_offsets[s];
+    const size_t num_joints = out.skin_offsets[s + 1] - out.skin_offsets[s];
+    if (!matrices[s].empty()) {
+      std::copy(matrices[s].begin(),
+                matrices[s].begin() + std::ptrdiff_t(16 * num_joints), dst);
+      continue;
+    }
+    for (size_t j = 0; j < num_joints; j++) {
+      for (size_t i = 0; i < 16; i++) {
+        dst[16 * j + i] = (i % 5) == 0 ? 1.0f : 0.0f;
+      }
+    }
+  }
+  *data = std::move(out);
+  return true;
 }
 
-static bool WriteBinaryGltfFile(const std::string &output,
-                                const std::string &content,
-                                const std::vector<unsigned char> &binBuffer) {
-#ifdef _WIN32
-#if defined(_MSC_VER)
-  std::ofstream gltfFile(UTF8ToWchar(output).c_str(), std::ios::binary);
-#elif defined(__GLIBCXX__)
-  int file_descriptor = _wopen(UTF8ToWchar(output).c_str(),
-                               _O_CREAT | _O_WRONLY | _O_TRUNC | _O_BINARY, _S_IWRITE);
-  __gnu_cxx::stdio_filebuf<char> wfile_buf(
-      file_descriptor, std::ios_base::out | std::ios_base::binary);
-  std::ostream gltfFile(&wfile_buf);
-#else
-  std::ofstream gltfFile(output.c_str(), std::ios::binary);
-#endif
-#else
-  std::ofstream gltfFile(output.c_str(), std::ios::binary);
-#endif
-  return WriteBinaryGltfStream(gltfFile, content, binBuffer);
+// c = a * b, column major 4x4 float matrices.
+static inline void MultiplyMatrices4x4(const float *a, const float *b,
+                                       float *c) {
+  const SimdF4 a0 = F4LoadFloat(a);
+  const SimdF4 a1 = F4LoadFloat(a + 4);
+  const SimdF4 a2 = F4LoadFloat(a + 8);
+  const SimdF4 a3 = F4LoadFloat(a + 12);
+  for (int j = 0; j < 4; j++) {
+    SimdF4 r = F4Mul(a0, F4Set(b[4 * j]));
+    r = F4Add(r, F4Mul(a1, F4Set(b[4 * j + 1])));
+    r = F4Add(r, F4Mul(a2, F4Set(b[4 * j + 2])));
+    r = F4Add(r, F4Mul(a3, F4Set(b[4 * j + 3])));
+    F4StoreFloat(r, c + 4 * j);
+  }
 }
 
-bool TinyGLTF::WriteGltfSceneToStream(const Model *model, std::ostream &stream,
-                                      bool prettyPrint = true,
-                                      bool writeBinary = false) {
-  detail::JsonDocument output;
+//
+// Calls `func(begin, end)` on chunks of the joints of all skins, in parallel.
+//
+template <typename Func>
+static void ForEachJointChunk(size_t num_joints, int num_threads,
+                              const TaskExecutorFunction &executor,
+                              const Func &func) {
+  const size_t kChunk = 256;
+  detail::ParallelFor((num_joints + kChunk - 1) / kChunk, num_threads,
+                      executor, [&](size_t c) {
+                        func(c * kChunk,
+                             (std::min)(num_joints, (c + 1) * kChunk));
+                      });
+}
 
-  /// Serialize all properties except buffers and images.
-  SerializeGltfModel(model, output);
+void ComputeSkinPalettes(const SkinPaletteData &data,
+                         const float *world_matrices, float *palettes,
+                         int num_threads,
+                         const TaskExecutorFunction &executor) {
+  if (!world_matrices || !palettes) {
+    return;
+  }
+  ForEachJointChunk(data.joints.size(), num_threads, executor,
+                    [&](size_t begin, size_t end) {
+    for (size_t j = begin; j < end; j++) {
+      MultiplyMatrices4x4(world_matrices + 16 * size_t(data.joints[j]),
+                          &data.inverse_bind_matrices[16 * j],
+                          palettes + 16 * j);
+    }
+  });
+}
 
-  // BUFFERS
-  std::vector<unsigned char> binBuffer;
-  if (model->buffers.size()) {
-    detail::json buffers;
-    detail::JsonReserveArray(buffers, model->buffers.size());
-    for (unsigned int i = 0; i < model->buffers.size(); ++i) {
-      detail::json buffer;
-      if (writeBinary && i == 0 && model->buffers[i].uri.empty()) {
-        SerializeGltfBufferBin(model->buffers[i], buffer, binBuffer);
+void ComputeSkinPalettes(const SkinPaletteData &data, const FlatScene &scene,
+                         float *palettes, int num_threads,
+                         const TaskExecutorFunction &executor) {
+  if (!palettes) {
+    return;
+  }
+  const bool has_floats =
+      scene.world_matrices_f.size() == 16 * scene.nodes.size();
+  ForEachJointChunk(data.joints.size(), num_threads, executor,
+                    [&](size_t begin, size_t end) {
+    float world[16];
+    for (size_t j = begin; j < end; j++) {
+      const size_t node = size_t(data.joints[j]);
+      const int entry =
+          node < scene.node_entries.size() ? scene.node_entries[node] : -1;
+      const float *ibm = &data.inverse_bind_matrices[16 * j];
+      if (entry < 0) {
+        std::copy(ibm, ibm + 16, palettes + 16 * j);
+        continue;
+      }
+      const float *w = world;
+      if (has_floats) {
+        w = &scene.world_matrices_f[16 * size_t(entry)];
       } else {
-        SerializeGltfBuffer(model->buffers[i], buffer);
+        for (size_t i = 0; i < 16; i++) {
+          world[i] = float(scene.world_matrices[16 * size_t(entry) + i]);
+        }
       }
-      detail::JsonPushBack(buffers, std::move(buffer));
+      MultiplyMatrices4x4(w, ibm, palettes + 16 * j);
     }
-    detail::JsonAddMember(output, "buffers", std::move(buffers));
+  });
+}
+
+//
+// CPU morph targets and skinning.
+//
+
+std::vector<float> GetMorphWeights(const Model &model, int node) {
+  std::vector<float> weights;
+  if (node < 0 || size_t(node) >= model.nodes.size()) {
+    return weights;
+  }
+  const Node &n = model.nodes[size_t(node)];
+  const std::vector<double> *src = &n.weights;
+  if (src->empty() && n.mesh >= 0 && size_t(n.mesh) < model.meshes.size()) {
+    src = &model.meshes[size_t(n.mesh)].weights;
   }
+  weights.assign(src->begin(), src->end());
+  return weights;
+}
 
-  // IMAGES
-  if (model->images.size()) {
-    detail::json images;
-    detail::JsonReserveArray(images, model->images.size());
-    for (unsigned int i = 0; i < model->images.size(); ++i) {
-      detail::json image;
+//
+// Calls `func(begin, end)` on chunks of `count` vertices, in parallel.
+//
+template <typename Func>
+static void ForEachVertexChunk(size_t count, int num_threads,
+                               const TaskExecutorFunction &executor,
+                               const Func &func) {
+  const size_t kChunk = 2048;
+  detail::ParallelFor((count + kChunk - 1) / kChunk, num_threads, executor,
+                      [&](size_t c) {
+                        func(c * kChunk, (std::min)(count, (c + 1) * kChunk));
+                      });
+}
 
-      std::string dummystring;
-      // UpdateImageObject need baseDir but only uses it if embeddedImages is
-      // enabled, since we won't write separate images when writing to a stream
-      // we
-      std::string uri;
-      if (!UpdateImageObject(model->images[i], dummystring, int(i), true,
-                             &fs, &uri_cb, this->WriteImageData,
-                             this->write_image_user_data_, &uri)) {
-        return false;
-      }
-      SerializeGltfImage(model->images[i], uri, image);
-      detail::JsonPushBack(images, std::move(image));
+// dst[i] += w * src[i]
+static void AddScaledFloats(float *dst, const float *src, float w, size_t n) {
+  const SimdF4 vw = F4Set(w);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    F4StoreFloat(F4Add(F4LoadFloat(dst + i), F4Mul(vw, F4LoadFloat(src + i))),
+                 dst + i);
+  }
+  for (; i < n; i++) {
+    dst[i] += w * src[i];
+  }
+}
+
+//
+// Adds `w` * the sparse values of morph target accessor `accessor_idx`(which
+// has no bufferView) to `dst`(`dst_stride` floats per vertex).
+//
+static bool AddSparseMorphTarget(const Model &model, int accessor_idx,
+                                 float w, float *dst, size_t dst_stride,
+                                 size_t count, std::string *err) {
+  const Accessor &accessor = model.accessors[size_t(accessor_idx)];
+  const std::string name = "accessor[" + std::to_string(accessor_idx) + "]";
+  const Accessor::Sparse &sparse = accessor.sparse;
+  if (sparse.count <= 0) {
+    return true;
+  }
+  const size_t num_values = size_t(sparse.count);
+  const int component_size =
+      GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType));
+  if (component_size <= 0) {
+    if (err) {
+      (*err) += name + ": invalid componentType.\n";
     }
-    detail::JsonAddMember(output, "images", std::move(images));
+    return false;
+  }
+  const size_t elem_size = 3 * size_t(component_size);
+  const unsigned char *indices = nullptr;
+  const unsigned char *values = nullptr;
+  int index_size = 0;
+  if (!GetSparseIndicesAndValues(model, accessor, elem_size, name, &indices,
+                                 &index_size, &values, err)) {
+    return false;
   }
 
-  if (writeBinary) {
-    return WriteBinaryGltfStream(stream, detail::JsonToString(output),
-                                 binBuffer);
-  } else {
-    return WriteGltfStream(stream,
-                           detail::JsonToString(output, prettyPrint ? 2 : -1));
+  float scale;
+  bool snorm;
+  GetFloatConversionScale(accessor.componentType, accessor.normalized, &scale,
+                          &snorm);
+  std::vector<float> deltas(3 * num_values);
+  ConvertComponentsToFloat(accessor.componentType, values, elem_size,
+                           num_values, 3, scale, snorm, deltas.data(), 3, 1);
+  if (!ForEachSparseIndex(indices, index_size, num_values, count,
+                          [&](size_t i, size_t idx) {
+                            float *d = dst + idx * dst_stride;
+                            d[0] += w * deltas[3 * i];
+                            d[1] += w * deltas[3 * i + 1];
+                            d[2] += w * deltas[3 * i + 2];
+                          })) {
+    if (err) {
+      (*err) += name + ": sparse index out of range.\n";
+    }
+    return false;
   }
+  return true;
 }
 
-bool TinyGLTF::WriteGltfSceneToFile(const Model *model,
-                                    const std::string &filename,
-                                    bool embedImages = false,
-                                    bool embedBuffers = false,
-                                    bool prettyPrint = true,
-                                    bool writeBinary = false) {
-  detail::JsonDocument output;
-  std::string defaultBinFilename = GetBaseFilename(filename);
-  std::string defaultBinFileExt = ".bin";
-  std::string::size_type pos =
-      defaultBinFilename.rfind('.', defaultBinFilename.length());
+static void NormalizeVectors3(float *v, size_t stride, size_t begin,
+                              size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    float *p = v + i * stride;
+    const float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    if (len > 0.0f) {
+      p[0] /= len;
+      p[1] /= len;
+      p[2] /= len;
+    }
+  }
+}
 
-  if (pos != std::string::npos) {
-    defaultBinFilename = defaultBinFilename.substr(0, pos);
+bool PosePrimitive(const Model &model, int mesh, int primitive,
+                   const float *weights, size_t num_weights,
+                   const float *palette, size_t num_joints,
+                   PosedPrimitive *out, const PosePrimitiveOptions &options,
+                   std::string *err) {
+  if (!out) {
+    return false;
   }
-  std::string baseDir = GetBaseDir(filename);
-  if (baseDir.empty()) {
-    baseDir = "./";
+  if (mesh < 0 || size_t(mesh) >= model.meshes.size() || primitive < 0 ||
+      size_t(primitive) >= model.meshes[size_t(mesh)].primitives.size()) {
+    if (err) {
+      (*err) += "Invalid mesh " + std::to_string(mesh) + " primitive " +
+                std::to_string(primitive) + ".\n";
+    }
+    return false;
   }
-  /// Serialize all properties except buffers and images.
-  SerializeGltfModel(model, output);
+  const Primitive &prim = model.meshes[size_t(mesh)].primitives[size_t(primitive)];
+  const std::string name = "mesh[" + std::to_string(mesh) + "].primitives[" +
+                           std::to_string(primitive) + "]";
+
+  // Attribute accessor of `attribute` with `type`, -1 when absent, -2 when
+  // invalid.
+  auto find_attribute = [&](const std::map<std::string, int> &attributes,
+                            const std::string &attribute, int type,
+                            size_t count) -> int {
+    std::map<std::string, int>::const_iterator it =
+        attributes.find(attribute);
+    if (it == attributes.end()) {
+      return -1;
+    }
+    if (it->second < 0 || size_t(it->second) >= model.accessors.size() ||
+        model.accessors[size_t(it->second)].type != type ||
+        model.accessors[size_t(it->second)].count != count) {
+      if (err) {
+        (*err) += name + ": invalid " + attribute + " accessor.\n";
+      }
+      return -2;
+    }
+    return it->second;
+  };
 
-  // BUFFERS
-  std::vector<std::string> usedFilenames;
-  std::vector<unsigned char> binBuffer;
-  if (model->buffers.size()) {
-    detail::json buffers;
-    detail::JsonReserveArray(buffers, model->buffers.size());
-    for (unsigned int i = 0; i < model->buffers.size(); ++i) {
-      detail::json buffer;
-      if (writeBinary && i == 0 && model->buffers[i].uri.empty()) {
-        SerializeGltfBufferBin(model->buffers[i], buffer, binBuffer);
-      } else if (embedBuffers) {
-        SerializeGltfBuffer(model->buffers[i], buffer);
-      } else {
-        std::string binSavePath;
-        std::string binFilename;
-        std::string binUri;
-        if (!model->buffers[i].uri.empty() &&
-            !IsDataURI(model->buffers[i].uri)) {
-          binUri = model->buffers[i].uri;
-          if (!uri_cb.decode(binUri, &binFilename, uri_cb.user_data)) {
-            return false;
-          }
-        } else {
-          binFilename = defaultBinFilename + defaultBinFileExt;
-          bool inUse = true;
-          int numUsed = 0;
-          while (inUse) {
-            inUse = false;
-            for (const std::string &usedName : usedFilenames) {
-              if (binFilename.compare(usedName) != 0) continue;
-              inUse = true;
-              binFilename = defaultBinFilename + std::to_string(numUsed++) +
-                            defaultBinFileExt;
-              break;
-            }
-          }
+  std::map<std::string, int>::const_iterator pos_it =
+      prim.attributes.find("POSITION");
+  if (pos_it == prim.attributes.end() || pos_it->second < 0 ||
+      size_t(pos_it->second) >= model.accessors.size()) {
+    if (err) {
+      (*err) += name + ": no valid POSITION attribute.\n";
+    }
+    return false;
+  }
+  const size_t count = model.accessors[size_t(pos_it->second)].count;
+  const int position = find_attribute(prim.attributes, "POSITION",
+                                      TINYGLTF_TYPE_VEC3, count);
+  const int normal =
+      find_attribute(prim.attributes, "NORMAL", TINYGLTF_TYPE_VEC3, count);
+  const int tangent =
+      find_attribute(prim.attributes, "TANGENT", TINYGLTF_TYPE_VEC4, count);
+  if (position < 0 || normal == -2 || tangent == -2) {
+    return false;
+  }
 
-          if (uri_cb.encode) {
-            if (!uri_cb.encode(binFilename, "buffer", &binUri,
-                               uri_cb.user_data)) {
-              return false;
-            }
-          } else {
-            binUri = binFilename;
-          }
-        }
-        usedFilenames.push_back(binFilename);
-        binSavePath = JoinPath(baseDir, binFilename);
-        if (!SerializeGltfBuffer(model->buffers[i], buffer, binSavePath,
-                                 binUri)) {
+  PosedPrimitive posed;
+  posed.positions.resize(3 * count);
+  std::vector<AccessorFloatTarget> targets(1);
+  targets[0].accessor = position;
+  targets[0].dst = posed.positions.data();
+  if (normal >= 0) {
+    posed.normals.resize(3 * count);
+    targets.emplace_back();
+    targets.back().accessor = normal;
+    targets.back().dst = posed.normals.data();
+  }
+  if (tangent >= 0) {
+    posed.tangents.resize(4 * count);
+    targets.emplace_back();
+    targets.back().accessor = tangent;
+    targets.back().dst = posed.tangents.data();
+  }
+  if (!ConvertAccessorsToFloat(model, targets, err, options.num_threads,
+                               options.executor)) {
+    return false;
+  }
+
+  //
+  // Morph targets. Dense deltas of all active targets are converted together,
+  // then added in one pass over vertex chunks. TANGENT deltas(VEC3) are
+  // converted with a stride of 4 so that the w deltas are zero.
+  //
+  const char *morph_attributes[3] = {"POSITION", "NORMAL", "TANGENT"};
+  float *morph_dst[3] = {posed.positions.data(),
+                         normal >= 0 ? posed.normals.data() : nullptr,
+                         tangent >= 0 ? posed.tangents.data() : nullptr};
+  const size_t morph_stride[3] = {3, 3, 4};
+  for (size_t a = 0; a < 3; a++) {
+    if (!morph_dst[a]) {
+      continue;
+    }
+    std::vector<float> target_weights;
+    std::vector<std::vector<float>> deltas;
+    std::vector<AccessorFloatTarget> delta_targets;
+    deltas.reserve(prim.targets.size());
+    for (size_t t = 0; t < prim.targets.size(); t++) {
+      const float w = t < num_weights && weights ? weights[t] : 0.0f;
+      if (w == 0.0f) {
+        continue;
+      }
+      const int accessor = find_attribute(prim.targets[t], morph_attributes[a],
+                                          TINYGLTF_TYPE_VEC3, count);
+      if (accessor == -1) {
+        continue;
+      }
+      if (accessor == -2) {
+        return false;
+      }
+      const Accessor &acc = model.accessors[size_t(accessor)];
+      if (acc.sparse.isSparse && acc.bufferView < 0) {
+        if (!AddSparseMorphTarget(model, accessor, w, morph_dst[a],
+                                  morph_stride[a], count, err)) {
           return false;
         }
+        continue;
       }
-      detail::JsonPushBack(buffers, std::move(buffer));
+      target_weights.push_back(w);
+      deltas.emplace_back(morph_stride[a] * count, 0.0f);
+      AccessorFloatTarget target;
+      target.accessor = accessor;
+      target.dst = deltas.back().data();
+      target.element_stride = morph_stride[a];
+      delta_targets.push_back(target);
     }
-    detail::JsonAddMember(output, "buffers", std::move(buffers));
+    if (delta_targets.empty()) {
+      continue;
+    }
+    if (!ConvertAccessorsToFloat(model, delta_targets, err,
+                                 options.num_threads, options.executor)) {
+      return false;
+    }
+    const size_t stride = morph_stride[a];
+    float *dst = morph_dst[a];
+    ForEachVertexChunk(count, options.num_threads, options.executor,
+                       [&](size_t begin, size_t end) {
+      for (size_t t = 0; t < deltas.size(); t++) {
+        AddScaledFloats(dst + stride * begin, &deltas[t][stride * begin],
+                        target_weights[t], stride * (end - begin));
+      }
+    });
   }
 
-  // IMAGES
-  if (model->images.size()) {
-    detail::json images;
-    detail::JsonReserveArray(images, model->images.size());
-    for (unsigned int i = 0; i < model->images.size(); ++i) {
-      detail::json image;
-
-      std::string uri;
-      if (!UpdateImageObject(model->images[i], baseDir, int(i), embedImages,
-                             &fs, &uri_cb, this->WriteImageData,
-                             this->write_image_user_data_, &uri)) {
+  //
+  // Linear blend skinning. Each vertex blends the columns of its joint
+  // matrices, transforms the position, and transforms the normal with the
+  // cofactor matrix(inverse transpose up to scale).
+  //
+  std::vector<std::vector<float>> joints, joint_weights;
+  if (palette) {
+    for (int set = 0;; set++) {
+      const std::string suffix = std::to_string(set);
+      const int j = find_attribute(prim.attributes, "JOINTS_" + suffix,
+                                   TINYGLTF_TYPE_VEC4, count);
+      const int w = find_attribute(prim.attributes, "WEIGHTS_" + suffix,
+                                   TINYGLTF_TYPE_VEC4, count);
+      if (j == -2 || w == -2) {
+        return false;
+      }
+      if (j < 0 || w < 0) {
+        break;
+      }
+      joints.emplace_back(4 * count);
+      joint_weights.emplace_back(4 * count);
+      std::vector<AccessorFloatTarget> skin_targets(2);
+      skin_targets[0].accessor = j;
+      skin_targets[0].dst = joints.back().data();
+      skin_targets[1].accessor = w;
+      skin_targets[1].dst = joint_weights.back().data();
+      if (!ConvertAccessorsToFloat(model, skin_targets, err,
+                                   options.num_threads, options.executor)) {
         return false;
       }
-      SerializeGltfImage(model->images[i], uri, image);
-      detail::JsonPushBack(images, std::move(image));
     }
-    detail::JsonAddMember(output, "images", std::move(images));
   }
 
-  if (writeBinary) {
-    return WriteBinaryGltfFile(filename, detail::JsonToString(output),
-                               binBuffer);
-  } else {
-    return WriteGltfFile(filename,
-                         detail::JsonToString(output, (prettyPrint ? 2 : -1)));
-  }
+  const bool skinned = !joints.empty();
+  ForEachVertexChunk(count, options.num_threads, options.executor,
+                     [&](size_t begin, size_t end) {
+    for (size_t v = begin; v < end && skinned; v++) {
+      SimdF4 col[4] = {F4Set(0.0f), F4Set(0.0f), F4Set(0.0f), F4Set(0.0f)};
+      bool influenced = false;
+      for (size_t s = 0; s < joints.size(); s++) {
+        for (size_t i = 0; i < 4; i++) {
+          const float w = joint_weights[s][4 * v + i];
+          const float j = joints[s][4 * v + i];
+          if (w == 0.0f || !(j >= 0.0f) || size_t(j) >= num_joints) {
+            continue;
+          }
+          const float *m = palette + 16 * size_t(j);
+          const SimdF4 vw = F4Set(w);
+          col[0] = F4Add(col[0], F4Mul(vw, F4LoadFloat(m)));
+          col[1] = F4Add(col[1], F4Mul(vw, F4LoadFloat(m + 4)));
+          col[2] = F4Add(col[2], F4Mul(vw, F4LoadFloat(m + 8)));
+          col[3] = F4Add(col[3], F4Mul(vw, F4LoadFloat(m + 12)));
+          influenced = true;
+        }
+      }
+      if (!influenced) {
+        continue;
+      }
+      float r[4];
+      float *p = &posed.positions[3 * v];
+      F4StoreFloat(F4Add(F4Add(F4Mul(col[0], F4Set(p[0])),
+                               F4Mul(col[1], F4Set(p[1]))),
+                         F4Add(F4Mul(col[2], F4Set(p[2])), col[3])),
+                   r);
+      p[0] = r[0];
+      p[1] = r[1];
+      p[2] = r[2];
+
+      if (normal < 0 && tangent < 0) {
+        continue;
+      }
+      float m[12];
+      F4StoreFloat(col[0], m);
+      F4StoreFloat(col[1], m + 4);
+      F4StoreFloat(col[2], m + 8);
+      if (tangent >= 0) {
+        float *t = &posed.tangents[4 * v];
+        F4StoreFloat(F4Add(F4Add(F4Mul(col[0], F4Set(t[0])),
+                                 F4Mul(col[1], F4Set(t[1]))),
+                           F4Mul(col[2], F4Set(t[2]))),
+                     r);
+        t[0] = r[0];
+        t[1] = r[1];
+        t[2] = r[2];
+      }
+      if (normal >= 0) {
+        // Columns of the cofactor matrix: b x c, c x a, a x b.
+        const float *a = m, *b = m + 4, *c = m + 8;
+        float cof[12] = {b[1] * c[2] - b[2] * c[1],
+                         b[2] * c[0] - b[0] * c[2],
+                         b[0] * c[1] - b[1] * c[0],
+                         0.0f,
+                         c[1] * a[2] - c[2] * a[1],
+                         c[2] * a[0] - c[0] * a[2],
+                         c[0] * a[1] - c[1] * a[0],
+                         0.0f,
+                         a[1] * b[2] - a[2] * b[1],
+                         a[2] * b[0] - a[0] * b[2],
+                         a[0] * b[1] - a[1] * b[0],
+                         0.0f};
+        const float det = a[0] * cof[0] + a[1] * cof[1] + a[2] * cof[2];
+        const float sign = det < 0.0f ? -1.0f : 1.0f;
+        float *n = &posed.normals[3 * v];
+        F4StoreFloat(F4Add(F4Add(F4Mul(F4LoadFloat(cof), F4Set(sign * n[0])),
+                                 F4Mul(F4LoadFloat(cof + 4),
+                                       F4Set(sign * n[1]))),
+                           F4Mul(F4LoadFloat(cof + 8), F4Set(sign * n[2]))),
+                     r);
+        n[0] = r[0];
+        n[1] = r[1];
+        n[2] = r[2];
+      }
+    }
+    if (options.normalize_normals) {
+      if (normal >= 0) {
+        NormalizeVectors3(posed.normals.data(), 3, begin, end);
+      }
+      if (tangent >= 0) {
+        NormalizeVectors3(posed.tangents.data(), 4, begin, end);
+      }
+    }
+  });
+
+  *out = std::move(posed);
+  return true;
 }
 
 }  // namespace tinygltf